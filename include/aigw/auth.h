@@ -15,6 +15,7 @@
 #ifndef AIGW_AUTH_H
 #define AIGW_AUTH_H
 
+#include <stdint.h>
 #include "protocols/http.h"
 #include "iot_basic.h"
 #include "iot/dynreg.h"
@@ -41,4 +42,45 @@ aigw_auth_header_t *aigw_auth_header_new(iot_dynamic_register_basic_param_t *par
 
 void aigw_auth_header_free(aigw_auth_header_t *header);
 
+#define AIGW_AUTH_TOKEN_TTL_S 300           // 签名复用窗口
+#define AIGW_AUTH_TOKEN_REFRESH_AHEAD_S 30  // 窗口到期前提前刷新
+#define AIGW_AUTH_SIGNATURE_LEN 48          // base64(HMAC-SHA256) 44字节 + '\0'
+#define AIGW_AUTH_NUM_LEN 24
+
+/**
+ * @brief 某一时间窗口内的设备签名，除设备信息外的动态请求头
+ */
+typedef struct {
+    char signature[AIGW_AUTH_SIGNATURE_LEN];
+    char random_num[AIGW_AUTH_NUM_LEN];
+    char timestamp[AIGW_AUTH_NUM_LEN];
+} aigw_auth_token_t;
+
+/**
+ * @brief 设备签名缓存，按(设备, 时间窗口)复用签名，线程安全
+ */
+typedef struct aigw_auth_cache aigw_auth_cache_t;
+
+/**
+ * @brief 创建签名缓存并计算硬件ID
+ * @return 成功返回缓存对象，失败返回NULL
+ */
+aigw_auth_cache_t *aigw_auth_cache_new(void);
+
+void aigw_auth_cache_free(aigw_auth_cache_t *cache);
+
+// 创建时计算的硬件ID，获取失败时为NULL
+const char *aigw_auth_cache_hardware_id(const aigw_auth_cache_t *cache);
+
+/**
+ * @brief 获取当前时间窗口的签名，缓存失效、即将到期或设备变化时重新签名
+ * @param cache 签名缓存
+ * @param config 设备配置
+ * @param now 当前unix时间戳（秒）
+ * @param token 输出签名
+ * @return VOLC_OK 成功，其他为错误码
+ */
+int aigw_auth_cache_get(aigw_auth_cache_t *cache, const iot_basic_config_t *config,
+                        uint64_t now, aigw_auth_token_t *token);
+
 #endif // AIGW_AUTH_H
\ No newline at end of file
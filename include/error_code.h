@@ -51,6 +51,7 @@
 
 #define VOLC_ERR_MQTT_SUB    -10000  // MQTT订阅失败
 #define VOLC_ERR_MQTT_PUB    -10001  // MQTT发布失败
+#define VOLC_ERR_MQTT_PUB_QUEUE_FULL -10002  // MQTT待发布队列已满
 
 /** start ota error code **/
 #define VOLC_ERR_OTA_DOWNLOAD_FILE_SIZE -501
@@ -62,6 +63,16 @@
 
 #define VOLC_ERR_TM_USER_INPUT_OUT_RANGE -601
 #define VOLC_ERR_DM_PUBLISH_TYPE_UNKNOWN -602
+#define VOLC_ERR_TM_SHADOW_STALE_VERSION -603   // 影子版本不新于本地缓存，消息已过期
+#define VOLC_ERR_TM_GATEWAY_REPLY_TIMEOUT -604  // 网关请求重发后仍未收到回复
+#define VOLC_ERR_TM_GATEWAY_NO_SECRET -605      // 子设备没有签名所需的密钥
+#define VOLC_ERR_TM_REPLY_TIMEOUT -606          // 请求超时未收到服务端回复
+#define VOLC_ERR_TM_REPLY_CANCELLED -607        // 等待回复时模块被释放
+#define VOLC_ERR_TM_NTP_NOT_SYNCED -608         // 尚未与服务端同步时间
+#define VOLC_ERR_TM_WEBSHELL_UNSUPPORTED -609   // 当前平台不支持伪终端webshell
+#define VOLC_ERR_TM_WEBSHELL_SESSION_LIMIT -610 // webshell会话数已达上限
+#define VOLC_ERR_TM_IN_SERVICE_THREAD -611     // 阻塞接口在事件循环线程（回调）中调用，等待会卡住事件循环
+#define VOLC_ERR_TM_WEBSHELL_INPUT_FULL -612    // 子进程不读取终端输入，排队的输入已达上限
 
 // HTTP模块统一错误码
 
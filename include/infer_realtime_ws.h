@@ -22,14 +22,45 @@
 #include <stdbool.h>
 #include "iot_basic.h"
 #include "aigw/llm.h"
+#include "aigw/auth.h"
+#include "aws/common/byte_buf.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define AIGW_WS_RECONNECT_BASE_MS 500     // 默认重连初始间隔
+#define AIGW_WS_RECONNECT_MAX_MS 30000    // 重连退避上限
+
 // 响应回调类型
 typedef void (*aigw_ws_message_cb)(const char* message, size_t len, void* userdata);
 
+typedef enum {
+    AIGW_WS_POLL_ADD,
+    AIGW_WS_POLL_DEL,
+    AIGW_WS_POLL_CHANGE,
+} aigw_ws_poll_op_t;
+
+/**
+ * @brief 外部事件循环的fd变更通知，events为POLLIN/POLLOUT组合
+ * @note 在服务线程中回调；接入epoll/libuv等外部循环时据此增删监听fd，
+ *       就绪后调用aigw_ws_loop_service_fd。需要lws开启LWS_WITH_EXTERNAL_POLL（随SDK构建默认开启）
+ */
+typedef void (*aigw_ws_poll_cb)(aigw_ws_poll_op_t op, int fd, short events, void* userdata);
+
+/**
+ * @brief 事件循环，可被多个会话共享（同一lws_context，单线程服务）
+ */
+typedef struct aigw_ws_loop {
+    struct lws_context* lws_ctx;            // 首个会话加入时按其CA创建
+    platform_mutex_t lock;                  // 保护sessions
+    lws_dll2_owner_t sessions;              // 挂在此循环上的aigw_ws_ctx_t
+    int refcount;
+    aigw_ws_poll_cb poll_cb;
+    void* poll_userdata;
+    lws_sorted_usec_list_t sul_wait;        // aigw_ws_loop_service_once的等待上限
+} aigw_ws_loop_t;
+
 /**
  * @brief 协议连接配置（可扩展）
  */
@@ -37,33 +68,74 @@ typedef struct {
     const char* url;              // 目标地址（ws://）
     const char* path;             // 目标路径
     const char* api_key;          // 认证密钥
-    int reconnect_interval_ms;    // 断线重连间隔
+    int reconnect_interval_ms;    // 断线重连初始间隔，按指数退避增长，<=0 使用默认值
     bool verify_ssl;              // 是否验证SSL证书
     const char* ca;               // CA内容
     bool send_ping;              // 是否发送ping
     int ping_interval_s;          // ping间隔
+    int pong_timeout_s;           // 发送ping后等待pong的超时时间，<=0 不检测
+    aigw_ws_loop_t* loop;         // 共享事件循环，NULL 时会话独占一个
 } aigw_ws_config_t;
 
 void aigw_ws_config_deinit(aigw_ws_config_t *config);
 
+// 发送队列元素，value前预留LWS_PRE
+typedef struct my_item {
+    void *value;
+    size_t len;
+    bool session_update;                    // session.update消息，发送后留存用于重连恢复
+} my_item_t;
+
 /**
  * @brief 上下文对象（线程安全设计）
  */
 typedef struct {
-    struct lws_context* lws_ctx;            // LWS主上下文
+    struct lws_context* lws_ctx;            // LWS主上下文，即loop->lws_ctx
+    aigw_ws_loop_t* loop;                   // 所属事件循环
+    lws_dll2_t loop_node;                   // loop->sessions链表节点
     struct lws* active_conn;                // 当前活跃连接
     aigw_ws_config_t* config;               // 连接配置
     iot_basic_config_t *iot_device_config;  // 设备配置
+    aigw_auth_cache_t *auth_cache;          // 握手签名缓存
     aigw_ws_message_cb callback;            // 消息回调
     void* userdata;                         // 用户透传数据
     struct lws_ring* send_ring;             // 环形发送缓冲区（线程安全）
     platform_mutex_t lock;                   // 连接状态锁
     volatile bool connected;                // 连接活跃标志
-    volatile bool try_connect;              // 断连后尝试重连标志，在发送请求的时候判断
+    volatile bool closing;                  // 用户主动断开，不再重连
     uint32_t tail;
-    int32_t ping_count;
+    lws_sorted_usec_list_t sul_reconnect;    // 重连调度
+    uint16_t retry_count;                    // 连续重连次数，连接建立后清零
+    my_item_t last_session;                  // 最近一次已发送的session.update，重连后重放
+    bool resume_pending;                     // 下一次writable先重放last_session
+    lws_sorted_usec_list_t sul_ping;         // ping调度
+    lws_sorted_usec_list_t sul_pong_timeout; // pong超时检测
+    bool ping_pending;                       // 下一次writable优先发送ping
 } aigw_ws_ctx_t;
 
+/**
+ * @brief 创建可共享的事件循环
+ * @param poll_cb 外部事件循环fd通知，NULL 时使用aigw_ws_loop_service_once内部poll
+ * @param userdata poll_cb透传数据
+ * @return 循环对象，失败返回NULL
+ * @note 创建者持有一个引用，用aigw_ws_loop_release释放；每个加入的会话各持有一个引用
+ */
+aigw_ws_loop_t* aigw_ws_loop_create(aigw_ws_poll_cb poll_cb, void* userdata);
+
+void aigw_ws_loop_release(aigw_ws_loop_t* loop);
+
+/**
+ * @brief 服务一次循环上所有会话，最多阻塞timeout_ms，<=0 不等待
+ * @return >=0 成功，<0 循环已销毁或出错
+ */
+int aigw_ws_loop_service_once(aigw_ws_loop_t* loop, int timeout_ms);
+
+/**
+ * @brief 外部事件循环在fd就绪时调用；fd<0 时只处理定时器和超时，
+ *       外部循环应至少每秒调用一次以驱动ping与重连
+ */
+int aigw_ws_loop_service_fd(aigw_ws_loop_t* loop, int fd, short revents);
+
 /**
  * @brief 可配置的上下文参数
  */
@@ -95,17 +167,26 @@ int aigw_ws_init(aigw_ws_ctx_t* ctx, const aigw_ws_config_t* config);
 
 /**
  * @brief 销毁上下文并释放资源
+ * @note 共享循环时需在服务线程中调用，或在停止服务循环后调用
  */
 void aigw_ws_deinit(aigw_ws_ctx_t* ctx);
 
+/**
+ * @brief 第retry_count次重连前的等待：初始间隔按2的幂增长，不超过AIGW_WS_RECONNECT_MAX_MS，
+ *        结果的一半固定、一半由random决定
+ * @param base_ms 初始间隔，<=0 使用AIGW_WS_RECONNECT_BASE_MS
+ */
+uint32_t aigw_ws_reconnect_delay_ms(int base_ms, uint16_t retry_count, uint32_t random);
+
 /**
  * @brief 启动连接（非阻塞）
- * @note 实际连接状态通过回调通知
+ * @note 实际连接状态通过回调通知；连接异常断开后按指数退避自动重连，
+ *       重连成功后重放最近一次session.update并继续发送排队消息
  */
 int aigw_ws_connect(aigw_ws_ctx_t* ctx);
 
 /**
- * @brief 主动断开连接
+ * @brief 主动断开连接，断开后不再自动重连，再次调用aigw_ws_connect恢复
  */
 void aigw_ws_disconnect(aigw_ws_ctx_t* ctx);
 
@@ -129,18 +210,36 @@ typedef struct {
     char* type;
     char* name;
     char* description;
-    char* parameters;
+    char* parameters;                   // JSON Schema字符串，原样下发，不是合法JSON时会话配置返回VOLC_ERR_INVALID_PARAM
 } aigw_ws_session_tools_t;
 
+/**
+ * @brief 服务端轮次检测（VAD）配置，数值<=0的字段不下发，使用服务端默认值
+ */
+typedef struct {
+    const char* type;                   // 例如："server_vad"
+    double threshold;
+    int prefix_padding_ms;
+    int silence_duration_ms;
+} aigw_ws_turn_detection_t;
+
+#define AIGW_WS_DEFAULT_TEMPERATURE 0.8
+
 typedef struct {
     const char* instructions;
     const char* voice;
     const char* input_audio_format;
     const char* output_audio_format;
-    bool input_audio_transcription;
+    bool input_audio_transcription;     // false 下发null关闭输入转写；早期版本忽略该字段，总是下发{"model":"any"}
     bool modality_audio_enabled;
     bool modality_text_enabled;
-    aigw_ws_session_tools_t* tools;
+    aigw_ws_session_tools_t* tools;     // 工具数组
+    size_t num_tools;                   // tools数组长度，tools非空且为0时按1个处理
+    const char* tool_choice;            // NULL 为 "auto"
+    const aigw_ws_turn_detection_t* turn_detection; // NULL 下发null，关闭服务端VAD
+    const char* transcription_model;    // NULL 为 "any"
+    double temperature;                 // <=0 使用AIGW_WS_DEFAULT_TEMPERATURE
+    int max_response_output_tokens;     // <=0 不限制
 } aigw_ws_session_t;
 
 #define DEFAULT_SESSION \
@@ -152,7 +251,13 @@ typedef struct {
         .input_audio_transcription = true, \
         .modality_audio_enabled = true, \
         .modality_text_enabled = false, \
-        .tools = NULL \
+        .tools = NULL, \
+        .num_tools = 0, \
+        .tool_choice = "auto", \
+        .turn_detection = NULL, \
+        .transcription_model = "any", \
+        .temperature = AIGW_WS_DEFAULT_TEMPERATURE, \
+        .max_response_output_tokens = 0 \
     }
 
 typedef struct {
@@ -188,6 +293,14 @@ typedef struct {
  */
 int aigw_ws_session_update(aigw_ws_ctx_t* ctx, const aigw_ws_session_t* session);
 
+/**
+ * @brief 将会话配置序列化为session.update消息
+ * @param session 会话配置
+ * @param out 输出缓冲区，需由aws_byte_buf_init初始化，结果以'\0'结尾
+ * @return VOLC_OK 成功，其他为错误码
+ */
+int aigw_ws_session_update_to_json(const aigw_ws_session_t* session, struct aws_byte_buf* out);
+
 /**
  * @brief 传输音频字节到缓冲区
  * @param ctx 上下文对象
@@ -226,6 +339,23 @@ int aigw_ws_input_audio_done(aigw_ws_ctx_t* ctx);
  */
 int aigw_ws_conversation_item_create(aigw_ws_ctx_t* ctx, char* func_call_id);
 
+/**
+ * @brief 回传函数调用结果
+ * @param ctx 上下文对象
+ * @param call_id 函数调用ID
+ * @param output_json 函数执行结果，合法JSON，原样作为output下发
+ * @return VOLC_OK 成功，output_json不是合法JSON时返回VOLC_ERR_INVALID_PARAM
+ */
+int aigw_ws_conversation_item_create_function_output(aigw_ws_ctx_t* ctx, const char* call_id,
+                                                     const char* output_json);
+
+/**
+ * @brief 将函数调用结果序列化为conversation_item.create消息
+ * @param out 输出缓冲区，需由aws_byte_buf_init初始化，结果以'\0'结尾
+ * @return VOLC_OK 成功，其他为错误码
+ */
+int aigw_ws_function_output_to_json(const char* call_id, const char* output_json, struct aws_byte_buf* out);
+
 /**
  * @brief 创建响应
  * @param ctx 上下文对象
@@ -248,17 +378,12 @@ void aigw_ws_register_callback(aigw_ws_ctx_t* ctx, aigw_ws_message_cb cb, void*
 /**
  * @brief 运行事件循环（应在独立线程中调用）
  * @param ctx 上下文对象
+ * @note 共享循环时会一并服务同一循环上的其他会话
  * @param timeout_ms 事件循环超时时间
  */
 int aigw_ws_run_event_loop(aigw_ws_ctx_t* ctx, int timeout_ms);
 
 
-typedef struct my_item {
-    void *value;
-    size_t len;
-} my_item_t;
-
-
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,57 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ONESDK_IOT_LATENCY_HIST_H
+#define ONESDK_IOT_LATENCY_HIST_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IOT_LATENCY_HIST_SUB_BITS 5     // 每个2的幂区间分32格，相对误差不超过1/32
+#define IOT_LATENCY_HIST_BUCKETS ((32 - IOT_LATENCY_HIST_SUB_BITS + 1) << IOT_LATENCY_HIST_SUB_BITS)
+
+/**
+ * HDR风格的对数-线性直方图，记录微秒级延迟，0~2^32-1us（约71分钟），超出按上限记录
+ * 小于64us的值精确记录，更大的值按所在2的幂区间等分，内存固定，记录与查询不分配
+ * @note 非线程安全，由调用方加锁
+ */
+typedef struct {
+    uint32_t counts[IOT_LATENCY_HIST_BUCKETS];
+    uint64_t total;
+    uint64_t sum_us;
+    uint32_t min_us;
+    uint32_t max_us;
+} iot_latency_hist_t;
+
+void iot_latency_hist_reset(iot_latency_hist_t *hist);
+
+void iot_latency_hist_record(iot_latency_hist_t *hist, uint64_t value_us);
+
+/**
+ * 第percentile百分位的值，返回所在格的上界，与真实值的误差不超过1/32
+ * @param percentile 0~100
+ * @return 没有记录时返回0
+ */
+uint32_t iot_latency_hist_percentile(const iot_latency_hist_t *hist, double percentile);
+
+uint32_t iot_latency_hist_mean(const iot_latency_hist_t *hist);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ONESDK_IOT_LATENCY_HIST_H
@@ -0,0 +1,146 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ONESDK_IOT_MQTT_PUB_QUEUE_H
+#define ONESDK_IOT_MQTT_PUB_QUEUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <libwebsockets.h>
+#include "util/mem_pool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 队列满时的处理策略
+typedef enum {
+    IOT_MQTT_OVERFLOW_REJECT,       // 返回VOLC_ERR_MQTT_PUB_QUEUE_FULL
+    IOT_MQTT_OVERFLOW_DROP_OLDEST,  // 丢弃最早的待发送消息（在途消息不丢）
+    IOT_MQTT_OVERFLOW_BLOCK,        // 发布方限时等待空位，由iot_mqtt_publish实现，服务线程中按REJECT
+} iot_mqtt_overflow_policy_t;
+
+typedef struct iot_mqtt_buf iot_mqtt_buf_t;
+
+typedef void (*iot_mqtt_buf_release_fn)(iot_mqtt_buf_t *buf, void *userdata);
+
+/**
+ * 调用方持有的发布缓冲，payload前预留LWS_PRE字节供lws直接发送，发布时不再拷贝payload。
+ * 引用计数，创建时为1；每条引用它的消息持有一个引用，QoS0写出或QoS1收到PUBACK后归还，
+ * 最后一个引用归还时调用release
+ */
+struct iot_mqtt_buf {
+    uint8_t *data;                  // payload起始，之前有LWS_PRE字节可写空间
+    size_t len;                     // payload长度
+    size_t cap;                     // data起的可用容量
+    long refcount;
+    iot_mqtt_buf_release_fn release;    // 可为NULL
+    void *userdata;
+};
+
+/**
+ * 使用调用方的存储，storage前LWS_PRE字节留给lws
+ * @return VOLC_OK 成功；storage_len不足LWS_PRE返回VOLC_ERR_INVALID_PARAM
+ */
+int iot_mqtt_buf_init(iot_mqtt_buf_t *buf, uint8_t *storage, size_t storage_len,
+                      iot_mqtt_buf_release_fn release, void *userdata);
+
+// 堆上分配容量为cap的缓冲，与描述符同一块内存，引用归零时释放
+iot_mqtt_buf_t *iot_mqtt_buf_new(size_t cap);
+
+void iot_mqtt_buf_ref(iot_mqtt_buf_t *buf);
+
+// 归还一个引用，归零时调用release
+void iot_mqtt_buf_unref(iot_mqtt_buf_t *buf);
+
+/**
+ * 待发布消息，pending和inflight两条侵入式链表共用list节点，
+ * 从待发送转为在途只移动节点，不拷贝topic/payload
+ */
+typedef struct iot_mqtt_msg {
+    lws_dll2_t list;
+    lws_mqtt_publish_param_t pub;   // topic与payload同在一个池化块中；带buf时payload指向buf->data
+    iot_mqtt_buf_t *buf;            // 零拷贝发布时引用的调用方缓冲，NULL 表示payload已拷贝
+    bool resend;                    // 重连或PUBACK超时后需带DUP重发
+    uint32_t spool_seq;             // 来自离线缓存时的序号，送达后据此标记，0 表示非缓存消息
+} iot_mqtt_msg_t;
+
+typedef struct {
+    lws_dll2_owner_t pending;       // 待发送，FIFO
+    lws_dll2_owner_t inflight;      // 已发送待PUBACK，按发送顺序，头部最早
+    lws_dll2_owner_t free;          // 空闲描述符
+    iot_mqtt_msg_t *descs;          // 初始化时一次性分配capacity个描述符
+    uint16_t window;                // 最多同时在途的QoS1消息数
+    uint32_t capacity;              // 待发送与在途消息总数上限
+    iot_mqtt_overflow_policy_t overflow;
+    mem_pool_t pool;                // topic+payload按大小分级复用
+    uint32_t dropped;               // DROP_OLDEST累计丢弃数
+    uint64_t copied_bytes;          // 入队时累计拷贝的topic与payload字节数
+} iot_mqtt_pub_queue_t;
+
+int iot_mqtt_pub_queue_init(iot_mqtt_pub_queue_t *q, uint16_t window, uint32_t capacity,
+                            iot_mqtt_overflow_policy_t overflow);
+
+// 释放队列及其中所有消息
+void iot_mqtt_pub_queue_deinit(iot_mqtt_pub_queue_t *q);
+
+/**
+ * 取空闲描述符并拷贝topic与payload，稳态下不调用malloc
+ * @param out 成功时返回消息，尚未入队
+ * @return VOLC_OK 成功；队列满返回VOLC_ERR_MQTT_PUB_QUEUE_FULL（DROP_OLDEST会先丢弃最早的待发送消息）；
+ *         内存不足返回VOLC_ERR_MALLOC
+ */
+int iot_mqtt_pub_queue_alloc(iot_mqtt_pub_queue_t *q, const char *topic, const uint8_t *payload,
+                             size_t len, int qos, iot_mqtt_msg_t **out);
+
+/**
+ * 同iot_mqtt_pub_queue_alloc，但只拷贝topic，payload引用buf并持有一个引用
+ */
+int iot_mqtt_pub_queue_alloc_buf(iot_mqtt_pub_queue_t *q, const char *topic, iot_mqtt_buf_t *buf,
+                                 int qos, iot_mqtt_msg_t **out);
+
+// 消息发送完成（QoS0）或被确认（QoS1）后归还，同时归还对buf的引用，msg须已不在pending/inflight中
+void iot_mqtt_pub_queue_release(iot_mqtt_pub_queue_t *q, iot_mqtt_msg_t *msg);
+
+void iot_mqtt_pub_queue_push(iot_mqtt_pub_queue_t *q, iot_mqtt_msg_t *msg);
+
+// 下一条待发送消息，不出队
+iot_mqtt_msg_t *iot_mqtt_pub_queue_peek(iot_mqtt_pub_queue_t *q);
+
+bool iot_mqtt_pub_queue_window_full(const iot_mqtt_pub_queue_t *q);
+
+/**
+ * 消息发送后转入在途，msg->pub.packet_id须已由lws分配
+ * @return 0 成功，窗口已满返回-1
+ */
+int iot_mqtt_pub_queue_inflight_add(iot_mqtt_pub_queue_t *q, iot_mqtt_msg_t *msg);
+
+/**
+ * 确认最早发送的在途消息，O(1)。lws的MQTT_ACK不带packet_id，按MQTT 3.1.1 4.6的发送顺序确认
+ * @return 被确认的消息，调用方用iot_mqtt_pub_queue_release归还；没有在途消息返回NULL
+ */
+iot_mqtt_msg_t *iot_mqtt_pub_queue_ack_oldest(iot_mqtt_pub_queue_t *q);
+
+// 最早发送且未确认的消息
+iot_mqtt_msg_t *iot_mqtt_pub_queue_oldest(iot_mqtt_pub_queue_t *q);
+
+// 标记全部在途消息待重发
+void iot_mqtt_pub_queue_mark_resend(iot_mqtt_pub_queue_t *q);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ONESDK_IOT_MQTT_PUB_QUEUE_H
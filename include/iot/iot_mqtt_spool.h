@@ -0,0 +1,109 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ONESDK_IOT_MQTT_SPOOL_H
+#define ONESDK_IOT_MQTT_SPOOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IOT_MQTT_SPOOL_DEFAULT_MAX_BYTES (1024 * 1024)
+
+typedef struct {
+    const char *path;               // 缓存文件路径，NULL 不启用
+    uint32_t max_bytes;             // 文件大小上限，0 使用默认值；超出时丢弃最早的未发送消息
+    uint32_t retention_s[2];        // 按QoS的保留时长（秒），超时的消息不再发送，0 不限
+    uint16_t drain_rate;            // 重连后每秒最多补发条数，0 不限
+    uint32_t (*now)(void);          // 取当前unix时间（秒），NULL 使用系统时间，测试时可替换
+} iot_mqtt_spool_config_t;
+
+typedef struct {
+    uint32_t seq;
+    uint32_t timestamp;
+    uint32_t offset;                // 记录在文件中的偏移
+    uint32_t size;                  // 记录总长度，含头部
+    uint8_t qos;
+} iot_mqtt_spool_entry_t;
+
+/**
+ * 离线发布缓存，只追加写的文件，每条记录带CRC32。
+ * 发布记录之后追加一条consumed记录表示已送达，打开时重放文件恢复未送达的消息，
+ * 遇到不完整或校验失败的记录即视为崩溃时的残尾并丢弃。已送达记录过多或超出大小上限时整体重写压缩。
+ * @note 非线程安全，由调用方加锁
+ */
+typedef struct {
+    iot_mqtt_spool_config_t config;
+    char *path;
+    FILE *fp;
+    iot_mqtt_spool_entry_t *entries;    // 按seq升序，均未送达
+    size_t count;
+    size_t cap;
+    size_t cursor;                      // 下一条待补发的下标，之前的已交给发送队列
+    uint32_t next_seq;
+    uint32_t file_size;
+    uint32_t live_bytes;                // 未送达记录的总长度
+    uint32_t dropped;                   // 因超时或超出上限丢弃的条数
+    uint8_t *scratch;                   // 读取记录的缓冲
+    size_t scratch_cap;
+} iot_mqtt_spool_t;
+
+/**
+ * 打开或新建缓存文件并恢复未送达的消息
+ * @return VOLC_OK 成功；文件无法打开返回VOLC_ERR_FILE_OPEN；内存不足返回VOLC_ERR_MALLOC
+ */
+int iot_mqtt_spool_open(iot_mqtt_spool_t *spool, const iot_mqtt_spool_config_t *config);
+
+void iot_mqtt_spool_close(iot_mqtt_spool_t *spool);
+
+/**
+ * 追加一条消息并刷到文件
+ * @param seq_out 可为NULL
+ * @return VOLC_OK 成功；单条消息超过上限返回VOLC_ERR_INVALID_PARAM；
+ *         全部空间被已补发待确认的消息占满返回VOLC_ERR_MQTT_PUB_QUEUE_FULL；写文件失败返回VOLC_ERR_FILE_WRITE
+ */
+int iot_mqtt_spool_append(iot_mqtt_spool_t *spool, const char *topic, const uint8_t *payload,
+                          size_t len, int qos, uint32_t *seq_out);
+
+// 尚未交给发送队列的条数
+size_t iot_mqtt_spool_pending(const iot_mqtt_spool_t *spool);
+
+/**
+ * 取下一条待补发的消息并前移游标，超过保留时长的消息直接丢弃
+ * topic与payload指向内部缓冲，下次调用前有效
+ * @return VOLC_OK 成功；没有待补发消息返回VOLC_ERR_INVALID_PARAM
+ */
+int iot_mqtt_spool_next(iot_mqtt_spool_t *spool, uint32_t *seq, const char **topic,
+                        const uint8_t **payload, size_t *len, int *qos);
+
+/**
+ * 退回刚由iot_mqtt_spool_next取出的消息，游标回到该条，下次补发时重新取出
+ * 用于取出后无法放入发送队列的情况
+ * @return VOLC_OK 成功；seq不是最近取出的一条返回VOLC_ERR_INVALID_PARAM
+ */
+int iot_mqtt_spool_unget(iot_mqtt_spool_t *spool, uint32_t seq);
+
+// 消息已送达（QoS0已发出或QoS1收到PUBACK），追加consumed记录
+int iot_mqtt_spool_consume(iot_mqtt_spool_t *spool, uint32_t seq);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ONESDK_IOT_MQTT_SPOOL_H
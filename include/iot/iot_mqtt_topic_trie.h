@@ -0,0 +1,78 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ONESDK_IOT_MQTT_TOPIC_TRIE_H
+#define ONESDK_IOT_MQTT_TOPIC_TRIE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct iot_mqtt_topic_node iot_mqtt_topic_node_t;
+
+/**
+ * 按'/'分级的topic过滤器前缀树，支持任意层级的'+'和末尾的'#'，
+ * 每个节点挂一组值（一般是订阅的回调），匹配开销只与topic层级数有关
+ * @note 非线程安全，由调用方加锁
+ */
+typedef struct {
+    iot_mqtt_topic_node_t *root;
+    size_t count;                   // 值的总数
+} iot_mqtt_topic_trie_t;
+
+typedef void (*iot_mqtt_topic_visit_cb)(void *value, void *userdata);
+
+int iot_mqtt_topic_trie_init(iot_mqtt_topic_trie_t *trie);
+
+// free_value非空时对每个值调用一次
+void iot_mqtt_topic_trie_deinit(iot_mqtt_topic_trie_t *trie, iot_mqtt_topic_visit_cb free_value, void *userdata);
+
+// 校验订阅过滤器：'+'须独占一级，'#'须独占最后一级
+bool iot_mqtt_topic_filter_valid(const char *filter);
+
+/**
+ * 在filter对应的节点追加一个值，同一filter可挂多个值
+ * @return VOLC_OK 成功；过滤器非法返回VOLC_ERR_INVALID_PARAM；内存不足返回VOLC_ERR_MALLOC
+ */
+int iot_mqtt_topic_trie_insert(iot_mqtt_topic_trie_t *trie, const char *filter, void *value);
+
+// 按filter原文精确查找（不做通配匹配），返回该节点第一个值，不存在返回NULL
+void *iot_mqtt_topic_trie_find(iot_mqtt_topic_trie_t *trie, const char *filter);
+
+/**
+ * 从filter对应的节点移除value，节点为空时一并回收
+ * @return VOLC_OK 成功，未找到返回VOLC_ERR_INVALID_PARAM
+ */
+int iot_mqtt_topic_trie_remove(iot_mqtt_topic_trie_t *trie, const char *filter, void *value);
+
+/**
+ * 按MQTT规则匹配发布的topic，对每个命中的值调用cb
+ * 以'$'开头的topic不匹配首级的'+'和'#'
+ * @param topic 不要求以'\0'结尾
+ * @return 命中的值个数
+ */
+size_t iot_mqtt_topic_trie_match(iot_mqtt_topic_trie_t *trie, const char *topic, size_t topic_len,
+                                 iot_mqtt_topic_visit_cb cb, void *userdata);
+
+// 遍历全部值，遍历过程中不能修改前缀树
+void iot_mqtt_topic_trie_foreach(iot_mqtt_topic_trie_t *trie, iot_mqtt_topic_visit_cb cb, void *userdata);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ONESDK_IOT_MQTT_TOPIC_TRIE_H
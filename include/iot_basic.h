@@ -56,9 +56,11 @@ typedef struct iot_basic_config {
     char *ssl_ca_path;      // CA证书路径
 } iot_basic_config_t;
 
+struct aigw_auth_cache;
+
 typedef struct iot_basic_ctx {
     iot_basic_config_t *config;
-    
+    struct aigw_auth_cache *auth_cache;   // 设备签名和硬件ID缓存
 } iot_basic_ctx_t;
 
 int onesdk_iot_basic_init(iot_basic_ctx_t *, const iot_basic_config_t *config);
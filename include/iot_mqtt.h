@@ -22,8 +22,26 @@
 #include "platform_compat.h"
 #include "iot_basic.h"
 #include "aws/common/string.h"
+#include "iot/iot_mqtt_pub_queue.h"
+#include "iot/iot_mqtt_topic_trie.h"
+#include "iot/iot_mqtt_spool.h"
+#include "iot/iot_latency_hist.h"
 
 #define IOT_DEFAULT_PING_INTERVAL_S 60 // 60s
+// QoS1在途窗口，逐条等待PUBACK：lws 4.3每个连接只跟踪一条未确认的QoS1消息，
+// MQTT_ACK也不带packet_id，无法确认乱序的PUBACK，因此不提供配置
+#define IOT_MQTT_MAX_INFLIGHT 1
+#define IOT_MQTT_DEFAULT_PUB_QUEUE_CAPACITY 64 // 待发送与在途消息总数，初始化时预分配
+// 未收到SUBACK的SUBSCRIBE包数，逐批等待SUBACK：lws同一时间只处理一个packet id的确认，
+// 其余SUBACK会被跳过，因此不提供配置
+#define IOT_MQTT_MAX_INFLIGHT_SUBS 1
+#define IOT_MQTT_MAX_TOPICS_PER_SUBSCRIBE 7 // lws单个SUBSCRIBE包最多支持7个topic
+#define IOT_MQTT_DEFAULT_SUB_PACKET_MAX_BYTES 4000 // lws在4096字节的服务缓冲内组包
+#define IOT_MQTT_DEFAULT_PINGRESP_TIMEOUT_S 5 // PINGREQ发出后等待PINGRESP的时限
+#define IOT_MQTT_DEFAULT_PUB_BLOCK_TIMEOUT_MS 1000 // BLOCK策略下未配置等待时间时的上限
+#define IOT_MQTT_RTT_MIN_SAMPLES 5 // RTT样本达到该数后才参与PINGRESP时限的计算
+#define IOT_MQTT_RTT_TIMEOUT_FACTOR 4 // PINGRESP时限不小于RTT p99的倍数，慢链路上不会误判断线
+#define IOT_MQTT_RTT_MAX_PINGRESP_TIMEOUT_S 60
 
 typedef struct {
     const char *mqtt_host;
@@ -34,6 +52,16 @@ typedef struct {
     bool auto_reconnect;
     int32_t ping_interval;
     bool enable_mqtts;
+    uint32_t pub_queue_capacity;    // 发布队列容量（待发送与在途消息总数），0 使用默认值
+    iot_mqtt_overflow_policy_t pub_overflow_policy; // 队列满时的策略，默认REJECT
+    int32_t pub_block_timeout_ms;   // BLOCK策略下最长等待时间，<=0 使用默认值；在服务线程中不等待
+    iot_mqtt_spool_config_t spool;  // 离线缓存，spool.path为NULL时不启用
+    uint32_t sub_packet_max_bytes;  // 单个SUBSCRIBE包的最大字节数（broker限制），0 使用默认值
+    bool persistent_session;        // clean_session=0，断线期间broker保留QoS1消息；重连后仍重新订阅
+    uint16_t pingresp_timeout_s;    // 等待PINGRESP的时限，超时断开并触发重连，0 使用默认值
+    uint16_t ping_interval_max_s;   // 持续收到broker报文时ping间隔逐次加倍的上限，0 固定使用ping_interval
+    uint16_t tcp_keepalive_s;       // TCP keepalive空闲多久开始探测（探测3次，间隔为其1/3），0 不启用
+    uint32_t tcp_user_timeout_ms;   // 已发送数据最长未被确认时间（Linux TCP_USER_TIMEOUT），0 不设置
 } iot_mqtt_config_t;
 
 typedef enum {
@@ -46,6 +74,11 @@ typedef enum {
     MQTT_EVENT_ERROR,
 } iot_mqtt_event_type_t;
 
+typedef enum {
+    IOT_MQTT_LINK_PUBACK_TIMEOUT,   // QoS1消息超时未收到PUBACK，连接可能已不通，lws即将重发
+    IOT_MQTT_LINK_LOST,             // 连接非主动断开：PINGRESP超时、TCP超时或broker断开，随后自动重连
+} iot_mqtt_link_suspect_reason_t;
+
 typedef enum {
     IOT_MQTT_QOS0,
     IOT_MQTT_QOS1,
@@ -54,6 +87,24 @@ typedef enum {
 
 typedef void (*message_callback)(const char* topic, const uint8_t *payload, size_t len, void *user_data);
 typedef void (*event_callback)(iot_mqtt_event_type_t event_type, void *user_data);
+// 链路疑似中断时回调，应用可据此切换网络
+typedef void (*iot_mqtt_link_suspect_fn)(iot_mqtt_link_suspect_reason_t reason, void *user_data);
+// 每次事件循环前调用，返回距下次需要调用的毫秒数，<0 不限制
+typedef int32_t (*iot_mqtt_loop_hook_fn)(void *user_data);
+
+// 本连接的RTT统计，单位微秒
+typedef struct {
+    uint64_t count;                 // 连接建立以来的样本数
+    uint64_t lost;                  // 超时未回复的探测数
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t mean_us;
+    uint32_t p50_us;
+    uint32_t p90_us;
+    uint32_t p99_us;
+    uint32_t srtt_us;               // 平滑RTT，每个样本权重1/8
+    uint16_t pingresp_timeout_s;    // 当前生效的PINGRESP时限
+} iot_mqtt_rtt_stats_t;
 
 typedef struct {
     const char *topic;
@@ -69,28 +120,43 @@ typedef struct {
     size_t count;
 } iot_mqtt_pending_sub_list_t;
 
-typedef struct {
-    lws_mqtt_publish_param_t *publish_params;
-    bool *sent_list;
-    size_t count;
-} iot_mqtt_pending_pub_list_t;
-
 typedef struct {
     iot_mqtt_config_t *config;
     struct lws *wsi;
 
     struct lws_context *context;
     struct lws_client_connect_info ccinfo;
-    iot_mqtt_topic_map_t *sub_topic_maps;
-    size_t sub_topic_count;
+    iot_mqtt_topic_trie_t sub_topics;       // 已订阅的topic过滤器，值为iot_mqtt_topic_map_t*
     iot_mqtt_pending_sub_list_t *pending_sub_list;
-    iot_mqtt_pending_pub_list_t *pending_pub_list;
+    iot_mqtt_pub_queue_t pub_queue;         // 待发布与QoS1在途消息
     platform_mutex_t sub_topic_mutex;
     platform_mutex_t pub_topic_mutex;
     bool is_connected;
     void *user_data;
-    volatile bool waiting_for_suback;
-    volatile bool waiting_for_puback;
+    volatile uint16_t subacks_pending;      // 已发出未收到SUBACK的SUBSCRIBE包数
+    int64_t established_us;                 // 连接建立时间，用于统计订阅就绪耗时
+    uint32_t connections;                   // 累计建立连接的次数，上层比较前后值发现重连
+    bool sending_qos0;                      // QoS0发送时lws会同步回调MQTT_ACK，需与PUBACK区分
+    iot_mqtt_spool_t *spool;                // 断线期间的发布写入离线缓存，重连后补发
+    int64_t drain_window_us;                // 补发限速的当前1秒窗口起点
+    uint16_t drained_in_window;
+    lws_retry_bo_t retry;                   // 本连接的ping与挂断时限，lws每次重新计时时读取
+    uint16_t ping_interval_s;               // 当前ping间隔，自适应时在ping_interval与ping_interval_max_s之间调整
+    int64_t ping_adapted_us;                // 上次调整ping间隔的时间
+    int64_t last_rx_us;                     // 最近一次收到broker报文（CONNACK、SUBACK、PUBACK、PUBLISH）
+    bool link_suspect;                      // 已上报PUBACK超时，收到报文后清除
+    iot_mqtt_link_suspect_fn link_suspect_cb;
+    void *link_suspect_user_data;
+    iot_mqtt_loop_hook_fn loop_hook;        // 上层的定时任务，如属性合并的窗口到期发送
+    void *loop_hook_user_data;
+    lws_sorted_usec_list_t sul_loop_hook;   // 在钩子返回的到期时间再次运行钩子，lws_service不按超时参数返回
+    iot_latency_hist_t *rtt_hist;           // 本连接的RTT样本，首次记录时创建，连接建立时清空
+    uint32_t srtt_us;
+    uint64_t rtt_lost;
+    uint16_t rtt_pingresp_timeout_s;        // 由RTT p99得到的PINGRESP时限下限，0 样本不足
+    platform_mutex_t rtt_mutex;
+    platform_thread_id_t service_thread;    // 运行iot_mqtt_run_event_loop的线程，回调都在该线程执行
+    volatile bool service_thread_valid;
 } iot_mqtt_ctx_t;
 
 int iot_mqtt_init(iot_mqtt_ctx_t *ctx, iot_mqtt_config_t *config);
@@ -106,9 +172,69 @@ int iot_mqtt_reconnect(iot_mqtt_ctx_t *ctx);
 int iot_mqtt_publish(iot_mqtt_ctx_t *ctx, const char *topic, 
                 const uint8_t *payload, size_t len, int qos);
 
+/**
+ * 零拷贝发布，payload为buf->data起的buf->len字节
+ * 成功入队时持有buf的一个引用，QoS0写出或QoS1收到PUBACK后归还；调用方发布后归还自己的引用即可。
+ * 断线写入离线缓存时payload被拷贝，不持有引用
+ */
+int iot_mqtt_publish_buf(iot_mqtt_ctx_t *ctx, const char *topic, iot_mqtt_buf_t *buf, int qos);
+
 int iot_mqtt_subscribe(iot_mqtt_ctx_t *ctx, iot_mqtt_topic_map_t *topic_map);
 
 int iot_mqtt_run_event_loop(iot_mqtt_ctx_t* ctx, int timeout_ms);
 
+/**
+ * 当前线程是否为运行 iot_mqtt_run_event_loop 的服务线程（含其中的回调与loop hook）
+ * 在服务线程中阻塞等待发送或回复会卡住事件循环，阻塞接口据此直接返回错误
+ */
+bool iot_mqtt_in_service_thread(iot_mqtt_ctx_t *ctx);
+
+// 唤醒阻塞在 iot_mqtt_run_event_loop 中的服务线程，loop hook随即重新计算到期时间，可在任意线程调用
+void iot_mqtt_wakeup(iot_mqtt_ctx_t *ctx);
+
+// 设置链路疑似中断的回调
+void iot_mqtt_set_link_suspect_callback(iot_mqtt_ctx_t *ctx, iot_mqtt_link_suspect_fn cb, void *user_data);
+
+/**
+ * 设置事件循环钩子，在服务线程中每次进入事件循环时运行，并由lws定时器在钩子返回的毫秒数后再次运行；返回-1表示没有待办的定时任务
+ * 其他线程新增了更早到期的任务时需调用 iot_mqtt_wakeup 让钩子重新计算
+ */
+void iot_mqtt_set_loop_hook(iot_mqtt_ctx_t *ctx, iot_mqtt_loop_hook_fn hook, void *user_data);
+
+/**
+ * 记录一次应用层往返（如时间同步请求到回复）的RTT，样本足够后PINGRESP时限不小于p99的IOT_MQTT_RTT_TIMEOUT_FACTOR倍
+ * @note 在事件循环中调用，一般由收到回复的回调调用
+ */
+void iot_mqtt_record_rtt(iot_mqtt_ctx_t *ctx, uint64_t rtt_us);
+
+// 记录一次超时未回复的探测
+void iot_mqtt_record_rtt_loss(iot_mqtt_ctx_t *ctx);
+
+// 取本连接的RTT统计，没有样本时各分位为0
+int iot_mqtt_get_rtt_stats(iot_mqtt_ctx_t *ctx, iot_mqtt_rtt_stats_t *stats);
+
+/**
+ * 待订阅列表头部可以放进一个SUBSCRIBE包的topic数：不超过IOT_MQTT_MAX_TOPICS_PER_SUBSCRIBE，
+ * 包大小不超过max_bytes；单个超长的topic单独成批，由lws校验
+ */
+size_t iot_mqtt_sub_batch_size(const iot_mqtt_pending_sub_list_t *list, uint32_t max_bytes);
+
+// 以下为连接保活策略，由事件循环在对应事件时调用，应用一般无需直接调用
+
+// 设置当前ping间隔，并据此更新lws的ping与挂断时限（间隔加PINGRESP时限）
+void iot_mqtt_apply_ping_interval(iot_mqtt_ctx_t *ctx, uint16_t interval_s);
+
+// 距上次调整满一个ping间隔时调整：期间收到过broker报文则加倍，不超过ping_interval_max_s与keep_alive，否则回到ping_interval
+void iot_mqtt_adapt_ping_interval(iot_mqtt_ctx_t *ctx, int64_t now_us);
+
+// 收到broker报文，清除疑似中断标记
+void iot_mqtt_on_broker_rx(iot_mqtt_ctx_t *ctx, int64_t now_us);
+
+// QoS1消息PUBACK超时，到下次收到broker报文前只回调一次IOT_MQTT_LINK_PUBACK_TIMEOUT
+void iot_mqtt_on_puback_timeout(iot_mqtt_ctx_t *ctx);
+
+// 连接关闭，已建立的连接断开时回调IOT_MQTT_LINK_LOST
+void iot_mqtt_on_link_closed(iot_mqtt_ctx_t *ctx);
+
 #endif //ONESDK_IOT_MQTT_H
 #endif //ONESDK_ENABLE_IOT
\ No newline at end of file
@@ -35,6 +35,7 @@
 #include "infer_inner_chat.h"
 #include "infer_realtime_ws.h"
 #define PING_INTERVAL_S 110
+#define PONG_TIMEOUT_S 10
 #endif
 
 #ifdef ONESDK_ENABLE_IOT
@@ -67,6 +68,8 @@ typedef struct onesdk_config {
     const char* aigw_path;
     bool send_ping;
     int ping_interval_s;
+    int pong_timeout_s;     // 0 使用默认值，<0 不检测pong超时
+    aigw_ws_loop_t *rt_loop; // 多个会话共享的事件循环，NULL 时独占
 #endif
 
 } onesdk_config_t;
@@ -191,11 +194,15 @@ void onesdk_chat_release_context(onesdk_ctx_t *ctx);
 #ifdef ONESDK_ENABLE_AI_REALTIME
 int onesdk_rt_set_event_cb(onesdk_ctx_t *ctx, onesdk_rt_event_cb_t *cb);
 int onesdk_rt_session_keepalive(onesdk_ctx_t *ctx);
+// 非阻塞服务：嵌入已有事件循环或单线程驱动多个会话
+int onesdk_rt_service_once(onesdk_ctx_t *ctx, int timeout_ms);
+int onesdk_rt_service_fd(onesdk_ctx_t *ctx, int fd, short revents);
 
 // chat_agent interfaces
 int onesdk_rt_session_update(onesdk_ctx_t *ctx, aigw_ws_session_t *session);
 int onesdk_rt_audio_send(onesdk_ctx_t *ctx, const char *audio_data, size_t len, bool commit);
 int onesdk_rt_audio_response_cancel(onesdk_ctx_t *ctx);
+int onesdk_rt_function_output(onesdk_ctx_t *ctx, const char *call_id, const char *output_json);
 
 // translation_agent interfaces
 int onesdk_rt_translation_session_update(onesdk_ctx_t *ctx, aigw_ws_translation_session_t *session);
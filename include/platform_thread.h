@@ -1,27 +1,37 @@
-#ifndef PLATFORM_THREAD_H
-#define PLATFORM_THREAD_H
-
-#ifdef _WIN32
-#include <windows.h>
-#include <process.h>
-
-typedef CRITICAL_SECTION platform_mutex_t;
-
-#define platform_mutex_init(mutex) InitializeCriticalSection(&(mutex))
-#define platform_mutex_destroy(mutex) DeleteCriticalSection(&(mutex))
-#define platform_mutex_lock(mutex) EnterCriticalSection(&(mutex))
-#define platform_mutex_unlock(mutex) LeaveCriticalSection(&(mutex))
-
-#else
-#include <pthread.h>
-
-typedef pthread_mutex_t platform_mutex_t;
-
-#define platform_mutex_init(mutex) pthread_mutex_init(&(mutex), NULL)
-#define platform_mutex_destroy(mutex) pthread_mutex_destroy(&(mutex))
-#define platform_mutex_lock(mutex) pthread_mutex_lock(&(mutex))
-#define platform_mutex_unlock(mutex) pthread_mutex_unlock(&(mutex))
-
-#endif
-
+#ifndef PLATFORM_THREAD_H
+#define PLATFORM_THREAD_H
+
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+
+typedef CRITICAL_SECTION platform_mutex_t;
+
+#define platform_mutex_init(mutex) InitializeCriticalSection(&(mutex))
+#define platform_mutex_destroy(mutex) DeleteCriticalSection(&(mutex))
+#define platform_mutex_lock(mutex) EnterCriticalSection(&(mutex))
+#define platform_mutex_unlock(mutex) LeaveCriticalSection(&(mutex))
+
+typedef DWORD platform_thread_id_t;
+
+#define platform_thread_self() GetCurrentThreadId()
+#define platform_thread_equal(a, b) ((a) == (b))
+
+#else
+#include <pthread.h>
+
+typedef pthread_mutex_t platform_mutex_t;
+
+#define platform_mutex_init(mutex) pthread_mutex_init(&(mutex), NULL)
+#define platform_mutex_destroy(mutex) pthread_mutex_destroy(&(mutex))
+#define platform_mutex_lock(mutex) pthread_mutex_lock(&(mutex))
+#define platform_mutex_unlock(mutex) pthread_mutex_unlock(&(mutex))
+
+typedef pthread_t platform_thread_id_t;
+
+#define platform_thread_self() pthread_self()
+#define platform_thread_equal(a, b) pthread_equal(a, b)
+
+#endif
+
 #endif // PLATFORM_THREAD_H 
\ No newline at end of file
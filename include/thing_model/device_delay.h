@@ -19,6 +19,27 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "aws/common/byte_buf.h"
+
+#define IOT_TM_RTT_PROBE_MIN_INTERVAL_MS 1000
+
+/**
+ * 设备主动测量RTT：按interval_ms发出时间同步请求，请求到回复扣除服务端处理时间即一次往返
+ * 时间同步请求本身也计入RTT统计，interval_ms为0时只统计它们
+ */
+typedef struct {
+    uint32_t interval_ms;               // 探测间隔，不小于IOT_TM_RTT_PROBE_MIN_INTERVAL_MS，0 不主动探测
+    const char *report_identifier;      // 定期上报RTT统计的属性标识符，如 "default:LinkRtt"，NULL 不上报
+    uint32_t report_interval_ms;        // 上报间隔，0 不上报
+} iot_tm_rtt_probe_config_t;
+
+typedef struct {
+    uint32_t interval_ms;
+    uint64_t next_ms;
+    char *report_identifier;
+    uint32_t report_interval_ms;
+    uint64_t next_report_ms;
+} iot_tm_rtt_probe_t;
 
 /**
  * 订阅 设备延迟弹窗 topic
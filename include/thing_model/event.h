@@ -26,8 +26,8 @@ typedef struct {
     const char* version;
     const char* module_key;
     const char* identifier;
-    void* params;
-    void* payloadRoot;
+    void* params;           // iot_tm_members_t，加入参数时直接序列化
+    void* payloadRoot;      // iot_tm_msg_event_post_payload 解析出的aws_json_value，仅兼容旧接口
 } iot_tm_msg_event_post_t;
 
 
@@ -14,247 +14,201 @@
 
 
 
-// #ifndef ARENAL_IOT_GATEWAY_H
-// #define ARENAL_IOT_GATEWAY_H
-
-// #include <stdint.h>
-
-// typedef struct {
-//     const char* product_key;
-//     const char* device_name;
-//     const char* product_secret;
-// } iot_tm_msg_gateway_add_topo_item_t ;
-
-// typedef struct {
-//     const char* id;
-//     const char* version;
-//     const void* gateway_topo_list;
-//     const void* payload_root;
-// } iot_tm_msg_gateway_add_topo_t;
-
-// typedef struct {
-
-// } iot_tm_msg_gateway_add_topo_reply_t;
-
-// typedef struct {
-//     const char* id;
-//     const char* version;
-//     void* gateway_topo_list;
-//     void* payload_root;
-// } iot_tm_msg_gateway_delete_topo_t;
-
-// typedef struct {
-//     const char* product_key;
-//     const char* device_name;
-// } iot_tm_msg_gateway_delete_topo_item_t;
-
-// typedef struct {
-
-// } iot_tm_msg_gateway_delete_topo_reply_t;
-
-// typedef struct {
-//     const char* id ;
-//     const char* version;
-//     void* payload_root;
-// } iot_tm_msg_gateway_get_topo_t;
-
-// typedef struct {
-//     const char* product_key;
-//     const char* device_name;
-// } iot_tm_msg_gateway_get_topo_item_t;
-
-// typedef struct {
-//     iot_tm_msg_gateway_get_topo_item_t** gateway_topo_list;
-// } iot_tm_msg_gateway_get_topo_reply_t;
-
-// typedef struct {
-//     const char* product_key;
-//     const char* device_name;
-
-// } iot_tm_msg_gateway_get_device_secret_item_t;
-
-// typedef struct {
-//     const char* id ;
-//     const char* version;
-//     const char* uuid; // topic fmt need
-//     void* gateway_topo_list;
-//     void* payload_root;
-
-// } iot_tm_msg_gateway_get_device_secret_t;
-
-// typedef struct {
-
-// } iot_tm_msg_gateway_get_device_secret_reply_t;
-
-// typedef struct {
-//     const char* product_key;
-//     const char* device_name;
-// } iot_tm_msg_gateway_sub_device_login_item_t;
-
-// typedef struct {
-//     const char* id;
-//     const char* version;
-//     void* gateway_topo_list;
-//     void* payload_root;
-
-// } iot_tm_msg_gateway_sub_device_login_t;
-
-// typedef struct {
-
-// } iot_tm_msg_gateway_sub_device_login_reply_t;
-
-// typedef struct {
-//     const char* product_key;
-//     const char* device_name;
-
-// } iot_tm_msg_gateway_sub_device_logout_item_t;
-
-// typedef struct {
-//     const char* id;
-//     const char* version;
-//     void* gateway_topo_list;
-//     void* payload_root;
-
-// } iot_tm_msg_gateway_sub_device_logout_t;
-
-
-// typedef struct {
-
-// } iot_tm_msg_gateway_sub_device_logout_reply_t;
-
-// typedef struct {
-//     struct aws_string* product_key;
-//     struct aws_string* device_name;
-
-// } iot_tm_msg_gateway_sub_device_discovery_item_t;
-
-// typedef struct {
-//     const char* id;
-//     const char* version;
-//     void* gateway_topo_list;
-//     void* payload_root;
-
-// } iot_tm_msg_gateway_sub_device_discovery_t;
-
-
-// typedef struct {
-
-// } iot_tm_msg_gateway_sub_device_discovery_reply_t;
-
-// typedef struct {
-//     const char* product_key;
-//     const char* device_name;
-// } iot_tm_recv_gateway_add_topo_notify_item_t;
-
-// typedef struct {
-//     iot_tm_recv_gateway_add_topo_notify_item_t** gateway_topo_list;
-// } iot_tm_recv_gateway_add_topo_notify_t;
-
-
-// typedef enum {
-//     IOT_GATEWAY_TOPO_CHANGE_TYPE_CREATE ,
-//     IOT_GATEWAY_TOPO_CHANGE_TYPE_DELETE,
-//     IOT_GATEWAY_TOPO_CHANGE_TYPE_ENABLE,
-//     IOT_GATEWAY_TOPO_CHANGE_TYPE_DISABLE,
-// } iot_gateway_topo_change_type_t;
-
-// typedef enum {
-//     IOT_GATEWAY_SUB_DEVICE_CHANGE_TYPE_CREATE ,
-//     IOT_GATEWAY_SUB_DEVICE_CHANGE_TYPE_DELETE,
-//     IOT_GATEWAY_SUB_DEVICE_CHANGE_TYPE_ENABLE,
-//     IOT_GATEWAY_SUB_DEVICE_CHANGE_TYPE_DISABLE,
-// } iot_gateway_sub_device_change_type_t;
-
-// typedef struct {
-//     const char* product_key;
-//     const char* device_name;
-//     const char* device_secrt;
-// } iot_tm_recv_gateway_topo_change_notify_item_t;
-
-// typedef struct {
-//     iot_gateway_topo_change_type_t change_type;
-//     iot_tm_recv_gateway_topo_change_notify_item_t** gateway_topo_list;
-// } iot_tm_recv_gateway_topo_change_notify_t;
-
-
-// typedef struct {
-//     const char* product_key;
-//     const char* device_name;
-// } iot_tm_recv_gateway_sub_device_change_notify_item_t;
-
-// typedef struct {
-//     iot_gateway_sub_device_change_type_t change_type;
-//     iot_tm_recv_gateway_sub_device_change_notify_item_t** gateway_topo_list;
-// } iot_tm_recv_gateway_sub_device_change_notify_t;
-
-// typedef struct {
-//     const char* id;
-//     int32_t code;
-//     int64_t time_stamp;
-//     const char* trace_id;
-//     void *payload_root;
-// } iot_tm_msg_gateway_add_topo_notify_reply_t;
-
-// typedef struct {
-//     const char* id;
-//     int32_t code;
-//     void* payload_root;
-// } iot_tm_msg_gateway_topo_change_notify_reply_t;
-
-// typedef struct {
-//     const char* id;
-//     int32_t code;
-//     void* payload_root;
-// } iot_tm_msg_gateway_sub_device_change_notify_reply_t;
-
-
-// void iot_gateway_add_topo_init(iot_tm_msg_gateway_add_topo_t** pty);
-
-// int32_t iot_gateway_add_topo_item(iot_tm_msg_gateway_add_topo_t* pty,const char* device_name, const char* product_key, const char* product_secret);
-
-// void iot_gateway_add_topo_free(iot_tm_msg_gateway_add_topo_t* pty);
-
-
-// void iot_gateway_delete_topo_init(iot_tm_msg_gateway_delete_topo_t** pty);
-
-// void iot_gateway_delete_topo_item(iot_tm_msg_gateway_delete_topo_t* pty, const char* device_name, const char* product_key);
-
-// void iot_gateway_delete_topo_free(iot_tm_msg_gateway_delete_topo_t* pty);
-
-
-// void iot_gateway_get_topo_init(iot_tm_msg_gateway_get_topo_t** pty);
-
-// void iot_gateway_get_topo_init_with_id(iot_tm_msg_gateway_get_topo_t** pty, const char* id);
-
-// void iot_gateway_get_topo_free(iot_tm_msg_gateway_get_topo_t* pty);
-
-
-// void iot_gateway_get_device_secret_init(iot_tm_msg_gateway_get_device_secret_t** pty);
-
-// int32_t iot_gateway_get_device_secret_item(iot_tm_msg_gateway_get_device_secret_t* pty, const char* device_name, const char* product_key);
-
-// void iot_gateway_get_device_secret_free(iot_tm_msg_gateway_get_device_secret_t* pty);
-
-
-// void iot_gateway_sub_device_login_init(iot_tm_msg_gateway_sub_device_login_t** pty);
-
-// int32_t iot_gateway_sub_device_login_item(iot_tm_msg_gateway_sub_device_login_t* pty, const char* device_name, const char* product_key);
-
-// void iot_gateway_sub_device_login_free(iot_tm_msg_gateway_sub_device_login_t* pty);
-
-
-// void iot_gateway_sub_device_logout_init(iot_tm_msg_gateway_sub_device_logout_t** pty);
-
-// int32_t iot_gateway_sub_device_logout_item(iot_tm_msg_gateway_sub_device_logout_t* pty, const char* device_name, const char* product_key);
-
-// void iot_gateway_sub_device_logout_free(iot_tm_msg_gateway_sub_device_logout_t* pty);
-
-
-// void iot_gateway_sub_device_discovery_init(iot_tm_msg_gateway_sub_device_discovery_t** pty);
-
-// int32_t iot_gateway_sub_device_discovery_item(iot_tm_msg_gateway_sub_device_discovery_t* pty, const char* device_name, const char* product_key);
-
-// void iot_gateway_sub_device_discovery_free(iot_tm_msg_gateway_sub_device_discovery_t* pty);
-
-
-// #endif // ARENAL_IOT_GATEWAY_H
\ No newline at end of file
+#ifndef ARENAL_IOT_GATEWAY_H
+#define ARENAL_IOT_GATEWAY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "platform_thread.h"
+#include "aws/common/hash_table.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IOT_GATEWAY_DEFAULT_BATCH_MAX_DEVICES 50     // 单条拓扑、登录、登出请求的子设备数上限
+#define IOT_GATEWAY_DEFAULT_BATCH_MAX_BYTES 8192     // 单条请求payload的字节上限
+#define IOT_GATEWAY_DEFAULT_MAX_INFLIGHT 2           // 同时等待回复的请求数
+#define IOT_GATEWAY_DEFAULT_MIN_INTERVAL_MS 200      // 相邻两条请求的最小间隔，即每秒最多5条
+#define IOT_GATEWAY_DEFAULT_REPLY_TIMEOUT_MS 10000
+#define IOT_GATEWAY_DEFAULT_MAX_ATTEMPTS 3           // 超时未回复时重发，超过次数后按失败回调
+#define IOT_GATEWAY_ID_SIZE 24
+
+/**
+ * 网关代子设备发出的批量请求，枚举顺序即同时有多类请求待发时的发送顺序：
+ * 先添加拓扑再登录，先登出再删除拓扑
+ */
+typedef enum {
+    IOT_GATEWAY_OP_ADD_TOPO,
+    IOT_GATEWAY_OP_LOGIN,
+    IOT_GATEWAY_OP_LOGOUT,
+    IOT_GATEWAY_OP_DELETE_TOPO,
+    IOT_GATEWAY_OP_DISCOVERY,
+    IOT_GATEWAY_OP_MAX,
+} iot_gateway_op_t;
+
+typedef enum {
+    IOT_GATEWAY_SUB_UNKNOWN,        // 未通过网关请求过的子设备
+    IOT_GATEWAY_SUB_OFFLINE,
+    IOT_GATEWAY_SUB_LOGGING_IN,     // 登录请求排队中或等待回复
+    IOT_GATEWAY_SUB_ONLINE,
+    IOT_GATEWAY_SUB_LOGGING_OUT,
+} iot_gateway_sub_state_t;
+
+typedef enum {
+    IOT_GATEWAY_TOPO_CHANGE_TYPE_CREATE,
+    IOT_GATEWAY_TOPO_CHANGE_TYPE_DELETE,
+    IOT_GATEWAY_TOPO_CHANGE_TYPE_ENABLE,
+    IOT_GATEWAY_TOPO_CHANGE_TYPE_DISABLE,
+    IOT_GATEWAY_TOPO_CHANGE_TYPE_UNKNOWN,
+} iot_gateway_topo_change_type_t;
+
+/**
+ * 请求中的子设备
+ * 添加拓扑与登录需要签名：有device_secret时使用device_secret，否则使用product_secret；
+ * 添加拓扑回复中下发的设备密钥会保存下来，之后登录可以不再提供
+ */
+typedef struct {
+    const char *product_key;
+    const char *device_name;
+    const char *device_secret;
+    const char *product_secret;
+} iot_gateway_sub_device_t;
+
+typedef struct {
+    const char *product_key;
+    const char *device_name;
+} iot_gateway_device_id_t;
+
+/**
+ * 网关请求的服务端回复与拓扑查询结果
+ * 批量请求按批回调，devices为该批的子设备；超时未回复时code为VOLC_ERR_TM_GATEWAY_REPLY_TIMEOUT
+ */
+typedef struct {
+    const char *id;
+    int32_t code;
+    const iot_gateway_device_id_t *devices;
+    size_t count;
+} iot_tm_recv_gateway_reply_t;
+
+// 服务端下发的拓扑关系或子设备状态变化
+typedef struct {
+    const char *id;
+    iot_gateway_topo_change_type_t change_type;
+    const iot_gateway_device_id_t *devices;
+    size_t count;
+} iot_tm_recv_gateway_change_notify_t;
+
+// 0 使用默认值
+typedef struct {
+    uint32_t batch_max_devices;
+    uint32_t batch_max_bytes;
+    uint32_t max_inflight;
+    uint32_t min_interval_ms;
+    uint32_t reply_timeout_ms;
+    uint32_t max_attempts;
+} iot_gateway_limits_t;
+
+/**
+ * 发出一条请求，payload为 {"ID":..,"Version":..,"params":[...]}，回调返回后失效
+ * 返回非VOLC_OK时该请求按超时重发
+ */
+typedef int (*iot_gateway_send_fn)(iot_gateway_op_t op, const char *payload, size_t len, void *userdata);
+
+// 一批请求完成（收到回复或重发后仍超时），code为服务端回复的Code或错误码
+typedef void (*iot_gateway_result_fn)(iot_gateway_op_t op, const char *id, int32_t code,
+                                      const iot_gateway_device_id_t *devices, size_t count, void *userdata);
+
+typedef struct iot_gateway_sub iot_gateway_sub_t;
+
+typedef struct {
+    iot_gateway_sub_t **subs;
+    size_t count;
+    size_t cap;
+} iot_gateway_queue_t;
+
+typedef struct {
+    iot_gateway_op_t op;
+    char id[IOT_GATEWAY_ID_SIZE];
+    iot_gateway_sub_t **subs;
+    size_t count;
+    uint64_t sent_ms;
+} iot_gateway_batch_t;
+
+/**
+ * 网关子设备管理：一个网关连接代N个子设备收发消息
+ * 请求按操作排队，每次发送时取同一操作的多个子设备合成一条请求，
+ * 批大小、在途请求数与请求间隔不超过limits，避免超出broker的限制；
+ * 同一子设备同时只有一个请求在途，登录未发出时登出会取消登录，反之亦然
+ * 发送与结果回调在锁外调用
+ */
+typedef struct {
+    iot_gateway_limits_t limits;
+    char *gateway_secret;               // 解密添加拓扑回复中的子设备密钥
+    struct aws_hash_table subs;         // "product_key/device_name" -> iot_gateway_sub_t*
+    iot_gateway_queue_t queues[IOT_GATEWAY_OP_MAX];
+    iot_gateway_batch_t *inflight;
+    size_t inflight_count;
+    uint64_t next_send_ms;
+    uint32_t seq;
+    size_t online;                      // 已登录的子设备数
+    iot_gateway_send_fn send;
+    iot_gateway_result_fn on_result;
+    void *userdata;
+    platform_mutex_t mutex;
+    uint64_t requests_out;              // 累计发出的请求数（含重发）
+    uint64_t devices_out;               // 累计发出的子设备条目数
+    uint64_t timeouts;                  // 累计超时的请求数
+} iot_gateway_t;
+
+/**
+ * @param limits NULL 全部使用默认值
+ * @param gateway_secret 网关的设备密钥，可为NULL
+ */
+int iot_gateway_init(iot_gateway_t *gw, const iot_gateway_limits_t *limits, const char *gateway_secret,
+                     iot_gateway_send_fn send, iot_gateway_result_fn on_result, void *userdata);
+
+void iot_gateway_deinit(iot_gateway_t *gw);
+
+/**
+ * 子设备请求排队，由iot_gateway_poll发出
+ * @return VOLC_OK 成功；设备名不合法返回VOLC_ERR_INVALID_PARAM；
+ *         添加拓扑或登录没有可用的密钥返回VOLC_ERR_TM_GATEWAY_NO_SECRET，此时整批都不排队
+ */
+int iot_gateway_request(iot_gateway_t *gw, iot_gateway_op_t op, const iot_gateway_sub_device_t *devices, size_t count);
+
+/**
+ * 处理服务端回复，按ID找到在途的请求
+ * @return VOLC_OK 成功；找不到对应请求（如超时重发后旧请求的回复）返回VOLC_ERR_INVALID_PARAM
+ */
+int iot_gateway_on_reply(iot_gateway_t *gw, iot_gateway_op_t op, const char *payload, size_t len);
+
+/**
+ * 服务端通知子设备被删除或禁用，标记为离线并取消排队中的请求
+ */
+void iot_gateway_mark_offline(iot_gateway_t *gw, const char *product_key, const char *device_name);
+
+/**
+ * 网关的MQTT连接重建：断线时服务端已让子设备下线，在线的子设备标记为离线并排队重新登录，
+ * 按批由iot_gateway_poll发出；等待登出的子设备只标记离线。断线前在途的请求到期后按超时重发
+ * @return 排队重新登录的子设备数
+ */
+size_t iot_gateway_on_reconnect(iot_gateway_t *gw);
+
+/**
+ * 发出到期的请求并处理超时，由事件循环定期调用
+ * @return 距下次需要调用的毫秒数，没有排队与在途的请求时返回-1
+ */
+int32_t iot_gateway_poll(iot_gateway_t *gw, uint64_t now_ms);
+
+iot_gateway_sub_state_t iot_gateway_sub_state(iot_gateway_t *gw, const char *product_key, const char *device_name);
+
+// 已登录的子设备数
+size_t iot_gateway_online_count(iot_gateway_t *gw);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ARENAL_IOT_GATEWAY_H
@@ -17,19 +17,84 @@
 #ifndef IOT_SDK_IOT_NTP_H
 #define IOT_SDK_IOT_NTP_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include "iot_mqtt.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IOT_NTP_FILTER_SIZE 5               // 取最近几次采样偏差的中位数，单次不对称延迟不影响时钟
+#define IOT_NTP_STEP_THRESHOLD_MS 1000      // 偏差变化超过该值时直接跳变，否则缓慢调整
+#define IOT_NTP_SLEW_RATE_DIVISOR 2000      // 缓慢调整时每经过2000ms最多调整1ms，时间不会回退
+#define IOT_NTP_BURST_INTERVAL_MS 1000      // 开始同步时连发IOT_NTP_FILTER_SIZE次请求的间隔
+#define IOT_NTP_REPLY_TIMEOUT_MS 5000
+
 typedef struct {
     uint64_t server_time_mil;
 } iot_tm_recv_npt_server_time_t;
 
+/**
+ * 服务端时间与本地单调时钟的偏差：服务端时间 = 单调时钟 + 偏差
+ * 以单调时钟为基准，本地系统时间被修改或没有RTC时不受影响
+ */
+typedef struct {
+    int64_t offsets[IOT_NTP_FILTER_SIZE];   // 最近几次采样的偏差，环形
+    size_t count;
+    size_t next;
+    bool synced;
+    int64_t target_offset;                  // 采样偏差的中位数
+    int64_t slew_from;                      // 开始调整时的偏差
+    uint64_t slew_start_ms;
+    int64_t last_delay_ms;                  // 最近一次采样的往返延迟
+    uint64_t samples;
+    uint64_t steps;                         // 跳变次数
+} iot_ntp_clock_t;
+
+// 开始同步时连发几次请求，之后按interval_ms定期请求
+typedef struct {
+    uint32_t interval_ms;
+    uint32_t burst_left;
+    uint64_t next_ms;
+} iot_ntp_sync_t;
 
+void iot_ntp_clock_init(iot_ntp_clock_t *clock);
 
-int tm_ntp_get_server_time(iot_mqtt_ctx_t *mqtt_ctx, uint64_t* server_time_mil);
+/**
+ * 加入一次请求的四个时间戳
+ * @param t1 请求发出时的单调时钟
+ * @param t2 服务端收到请求的时间
+ * @param t3 服务端发出回复的时间
+ * @param t4 收到回复时的单调时钟
+ * @return 时间戳不合法（延迟为负）返回VOLC_ERR_INVALID_PARAM
+ */
+int iot_ntp_clock_add_sample(iot_ntp_clock_t *clock, uint64_t t1, uint64_t t2, uint64_t t3, uint64_t t4);
 
+// mono_ms时刻使用的偏差，缓慢调整中的偏差按经过的时间逐步接近中位数
+int64_t iot_ntp_clock_offset(const iot_ntp_clock_t *clock, uint64_t mono_ms);
 
+/**
+ * 物模型时间戳（毫秒）：同步后为单调时钟加服务端时间偏差，未同步时为本地系统时间
+ */
+uint64_t iot_now_ms(void);
+
+bool iot_ntp_synced(void);
+
+/**
+ * 取同步后的服务端时间
+ * @return 尚未同步返回VOLC_ERR_TM_NTP_NOT_SYNCED
+ */
+int tm_ntp_get_server_time(iot_mqtt_ctx_t *mqtt_ctx, uint64_t* server_time_mil);
+
+/**
+ * 发出一次时间同步请求，回复按ID关联后加入采样，再以 IOT_TM_RECV_NTP_SERVER_TIME 回调
+ */
 int32_t tm_send_device_npt_request(void *handler);
 
+#ifdef __cplusplus
+}
+#endif
+
 
 #endif //IOT_SDK_IOT_NTP_H
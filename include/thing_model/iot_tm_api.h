@@ -20,10 +20,14 @@
 #include "property.h"
 #include "shadow.h"
 #include "gateway.h"
+#include "tm_pending.h"
 #include "webshell.h"
+#include "tm_webshell.h"
+#include "tm_custom_router.h"
 #include "event.h"
 #include "service.h"
 #include "iot_ntp.h"
+#include "device_delay.h"
 #include "custom_topic.h"
 
 
@@ -61,57 +65,6 @@ typedef enum {
      */
     IOT_TM_MSG_SHADOW_CLEAR,
 
-    // /**
-    //  * @brief 子设备添加网络拓扑关系
-    //  */
-    // IOT_TM_MSG_GATEWAY_ADD_TOPO,
-
-    // /**
-    //  * @brief 删除子设备网络拓扑关系
-    //  */
-    // IOT_TM_MSG_GATEWAY_DELETE_TOPO,
-
-    // /**
-    //  * @brief 获取网络拓扑关系
-    //  */
-    // IOT_TM_MSG_GATEWAY_GET_TOPO,
-
-    // /**
-    //  * @brief 获取设备secret
-    //  */
-    // IOT_TM_MSG_GATEWAY_GET_DEVICE_SECRET,
-
-    // /**
-    //  * @brief 子设备登录
-    //  */
-    // IOT_TM_MSG_GATEWAY_SUB_DEVICE_LOGIN,
-
-    // /**
-    //  * @brief 子设备登出
-    //  */
-    // IOT_TM_MSG_GATEWAY_SUB_DEVICE_LOGOUT,
-
-    // /**
-    // * @brief 子设备发现上报
-    // */
-    // IOT_TM_MSG_GATEWAY_SUB_DEVICE_DISCOVERY,
-
-
-    // /**
-    // * @brief 回复服务端下发网络拓扑关系增加的通知后
-    // */
-    // IOT_TM_MSG_GATEWAY_ADD_TOPO_NOTIFY_REPLY,
-
-    // /**
-    // * @brief 回复服务端下发网络拓扑关系变化的通知后
-    // */
-    // IOT_TM_MSG_GATEWAY_TOPO_CHANGE_NOTIFY_REPLY,
-
-    // /**
-    // * @brief 回复服务端下发网络拓扑关系变化的通知后
-    // */
-    // IOT_TM_MSG_GATEWAY_SUB_DEVICE_CHANGE_NOTIFY_REPLY,
-
     /**
     * @brief 回复服务端下发的webshell命令
     */
@@ -165,16 +118,6 @@ typedef struct {
     union {
         iot_tm_msg_webshell_command_pong_t* webshell_command_pong;
         iot_tm_recv_webshell_command_reply_t* webshell_command_reply;
-        // iot_tm_msg_gateway_sub_device_change_notify_reply_t* gateway_sub_device_notify_reply;
-        // iot_tm_msg_gateway_topo_change_notify_reply_t* gateway_topo_change_notify_reply;
-        // iot_tm_msg_gateway_add_topo_notify_reply_t* gateway_add_topo_notify_reply;
-        // iot_tm_msg_gateway_sub_device_discovery_t* gateway_sub_device_discovery;
-        // iot_tm_msg_gateway_sub_device_logout_t* gateway_sub_device_logout;
-        // iot_tm_msg_gateway_sub_device_login_t* gateway_sub_device_login;
-        // iot_tm_msg_gateway_get_device_secret_t* gateway_get_device_secret;
-        // iot_tm_msg_gateway_add_topo_reply_t* gateway_get_topo;
-        // iot_tm_msg_gateway_delete_topo_t* gateway_delete_topo;
-        // iot_tm_msg_gateway_add_topo_t* gateway_add_topo;
         iot_tm_msg_shadow_post_t* shadow_post;
         iot_tm_msg_shadow_get_t* shadow_get;
         iot_tm_msg_shadow_clear_post_t* shadow_clear;
@@ -327,10 +270,8 @@ typedef struct {
         iot_tm_recv_shadow_post_reply_t shadow_post_reply;
         iot_tm_recv_shadow_get_reply_t shadow_get_reply;
         iot_tm_recv_shadow_set_t shadow_set;
-        // iot_tm_msg_gateway_get_topo_reply_t gateway_get;
-        // iot_tm_recv_gateway_add_topo_notify_t gateway_add_topo_notify;
-        // iot_tm_recv_gateway_topo_change_notify_t gateway_topo_change_notify;
-        // iot_tm_recv_gateway_sub_device_change_notify_t gateway_sub_device_change_notify;
+        iot_tm_recv_gateway_reply_t gateway_reply;     // 网关请求回复与拓扑查询
+        iot_tm_recv_gateway_change_notify_t gateway_change_notify;
         iot_tm_recv_event_post_reply_t event_post_reply;
         iot_tm_recv_service_call_t service_call;
         iot_tm_recv_custom_topic_t custom_topic;
@@ -382,6 +323,163 @@ void iot_tm_set_tm_recv_handler_t(iot_tm_handler_t *handle, iot_tm_recv_handler_
  */
 int32_t iot_tm_send(iot_tm_handler_t *handle, const iot_tm_msg_t *msg);
 
+/**
+ * 发送 TM 数据并按消息ID等待服务端回复，收到回复、超时或 iot_tm_deinit 时回调一次 cb
+ * 支持属性上报、事件上报与影子上报、获取、清除；属性上报不经合并与上报策略，影子上报不按缓存取增量，
+ * 保证发出的消息ID即回复中的ID；回复同样交给recv_handler
+ * 超时由 iot_mqtt_run_event_loop 驱动
+ * @param handle
+ * @param msg
+ * @param timeout_ms 等待回复的时长，0 使用默认值 IOT_TM_PENDING_DEFAULT_TIMEOUT_MS
+ * @param cb 在事件循环线程中调用，不能阻塞
+ * @param userdata
+ * @return 发送失败时不回调；消息类型没有回复或没有消息ID返回VOLC_ERR_INVALID_PARAM
+ */
+int32_t iot_tm_send_async(iot_tm_handler_t *handle, const iot_tm_msg_t *msg, uint32_t timeout_ms,
+                          iot_tm_reply_fn cb, void *userdata);
+
+/**
+ * 发送 TM 数据并阻塞等待服务端回复，iot_mqtt_run_event_loop 需要在其他线程运行
+ * 回复由事件循环收取，在运行事件循环的线程（消息回调、定时任务）中调用时不发送，直接返回错误，应改用 iot_tm_send_async
+ * @param handle
+ * @param msg 同 iot_tm_send_async
+ * @param timeout_ms 0 使用默认值 IOT_TM_PENDING_DEFAULT_TIMEOUT_MS
+ * @param code 输出服务端回复的Code，可为NULL
+ * @param reply_json 输出完整的回复payload，调用方free，可为NULL
+ * @return VOLC_OK 收到回复；超时返回VOLC_ERR_TM_REPLY_TIMEOUT；在事件循环线程中调用返回VOLC_ERR_TM_IN_SERVICE_THREAD
+ */
+int32_t iot_tm_send_and_wait(iot_tm_handler_t *handle, const iot_tm_msg_t *msg, uint32_t timeout_ms,
+                             int32_t *code, char **reply_json);
+
+/**
+ * 开启属性上报合并：window_ms 内多次属性上报合并为一条消息发出，减少高频上报的消息数与协议开销
+ * 同一属性在窗口内再次上报、合并后超过 max_bytes 时提前发出；事件等其他消息发送前先发出已合并的属性
+ * 窗口到期由 iot_mqtt_run_event_loop 驱动
+ * @param handle
+ * @param window_ms 合并窗口，0 关闭合并并立即发出已合并的属性
+ * @param max_bytes 合并后params的字节上限，0 使用默认值 IOT_TM_COALESCE_DEFAULT_MAX_BYTES
+ * @return
+ */
+int32_t iot_tm_set_property_coalesce(iot_tm_handler_t *handle, uint32_t window_ms, uint32_t max_bytes);
+
+/**
+ * 设置属性上报策略：属性按死区判断是否变化，按最短/最长间隔与心跳决定何时上报，未变化的采样不再发送
+ * 到期的属性由 iot_mqtt_run_event_loop 驱动，同一topic需要上报的属性合并为一条属性上报
+ * @param handle
+ * @param identifier 属性标识符，与 iot_property_post_add_param_* 的key一致，如 "default:Temperature"；NULL 设置默认策略
+ * @param policy 上报策略，NULL 删除该属性的策略，之后直接上报
+ * @return
+ */
+int32_t iot_tm_set_property_report_policy(iot_tm_handler_t *handle, const char *identifier,
+                                          const iot_tm_property_policy_t *policy);
+
+struct iot_kv_ctx;
+
+/**
+ * 开启设备影子本地缓存：按设备缓存desired与服务端已确认的reported，影子上报只发出变化的字段，
+ * 上报在收到成功回复后才记为已确认；版本不新于缓存的影子set与get回复视为过期，不再回调给业务，
+ * 从kv恢复的版本除外，启动后首个下发的desired总会应用
+ * @param handle
+ * @param kv 缓存写入kv，重启后恢复，启动时可用 iot_tm_get_shadow_desired 代替 shadow get；NULL 只缓存在内存中
+ * @return
+ */
+int32_t iot_tm_set_shadow_cache(iot_tm_handler_t *handle, struct iot_kv_ctx *kv);
+
+/**
+ * 取缓存的设备影子desired
+ * @param handle
+ * @param desired_json 输出desired的JSON字符串，调用方free
+ * @param version 输出desired的版本，可为NULL
+ * @return 没有该设备已知版本的缓存时返回VOLC_ERR_INVALID_PARAM
+ */
+int32_t iot_tm_get_shadow_desired(iot_tm_handler_t *handle, const char *product_key, const char *device_name,
+                                  char **desired_json, int64_t *version);
+
+/**
+ * 开启网关子设备管理：子设备共用本设备的MQTT连接，添加拓扑、登录、登出等请求排队后按批发出，
+ * 批大小、在途请求数与发送间隔不超过limits；排队的请求由 iot_mqtt_run_event_loop 驱动发出
+ * 每批的结果通过recv_handler回调，类型为 IOT_TM_RECV_GATEWAY_*，数据为 gateway_reply
+ * 子设备的物模型下发topic在此以 sys/+/+/... 订阅一次，只转发已登录子设备的消息；
+ * 与本设备的订阅重叠，broker按每个匹配的订阅各发一份时本设备的消息会重复收到
+ * MQTT重连后，断线前在线的子设备自动按批重新登录
+ * @param handle
+ * @param limits NULL 使用默认值
+ * @return
+ */
+int32_t iot_tm_gateway_enable(iot_tm_handler_t *handle, const iot_gateway_limits_t *limits);
+
+/**
+ * 子设备请求排队，登录成功后可通过 iot_tm_msg_t 的product_key、device_name发送子设备消息
+ * @param handle
+ * @param op 添加拓扑、登录、登出、删除拓扑或发现上报
+ * @param devices 子设备，添加拓扑与登录需要device_secret或product_secret用于签名
+ * @param count
+ * @return 未开启网关返回VOLC_ERR_NULL_POINTER
+ */
+int32_t iot_tm_gateway_request(iot_tm_handler_t *handle, iot_gateway_op_t op,
+                               const iot_gateway_sub_device_t *devices, size_t count);
+
+/**
+ * 查询网关的拓扑关系，结果以 IOT_TM_RECV_GATEWAY_GET_TOPO_REPLY 回调
+ */
+int32_t iot_tm_gateway_get_topo(iot_tm_handler_t *handle);
+
+iot_gateway_sub_state_t iot_tm_gateway_sub_state(iot_tm_handler_t *handle, const char *product_key,
+                                                 const char *device_name);
+
+/**
+ * 开始与服务端同步时间：先连发 IOT_NTP_FILTER_SIZE 次请求，之后每 interval_ms 请求一次，由 iot_mqtt_run_event_loop 驱动
+ * 同步后属性、事件等物模型时间戳使用 iot_now_ms，本地系统时间不准或被修改时不受影响
+ * @param handle
+ * @param interval_ms 之后定期请求的间隔，0 只在开始时同步
+ * @return
+ */
+int32_t iot_tm_ntp_sync(iot_tm_handler_t *handle, uint32_t interval_ms);
+
+/**
+ * 开始主动测量RTT，样本记入当前MQTT连接的直方图（重连后清空），并用于放宽慢链路上的PINGRESP时限
+ * 设置report_identifier时按report_interval_ms把 {"P50","P90","P99","Count","Lost"}（毫秒）作为属性上报
+ * @param handle
+ * @param config NULL 停止探测与上报，时间同步请求仍计入统计
+ * @return interval_ms小于IOT_TM_RTT_PROBE_MIN_INTERVAL_MS时返回VOLC_ERR_INVALID_PARAM
+ */
+int32_t iot_tm_rtt_probe(iot_tm_handler_t *handle, const iot_tm_rtt_probe_config_t *config);
+
+/**
+ * 取当前MQTT连接的RTT统计
+ */
+int32_t iot_tm_rtt_stats(iot_tm_handler_t *handle, iot_mqtt_rtt_stats_t *stats);
+
+/**
+ * 开启webshell：服务端下发的终端输入在伪终端中的shell里执行，输出由 iot_mqtt_run_event_loop 定期读取，
+ * 按config的分帧大小与间隔发往服务端；未开启时只回复服务端，不执行任何命令
+ * 设置allowed_commands只允许执行白名单内的命令，restrict_child可在子进程中降权或加载seccomp规则
+ * @param handle
+ * @param config NULL 使用默认值
+ * @return 不支持伪终端的平台返回VOLC_ERR_TM_WEBSHELL_UNSUPPORTED
+ */
+int32_t iot_tm_webshell_enable(iot_tm_handler_t *handle, const iot_webshell_config_t *config);
+
+/**
+ * 结束webshell会话，剩余输出与退出通知随后发往服务端
+ */
+int32_t iot_tm_webshell_kill(iot_tm_handler_t *handle, const char *uid);
+
+/**
+ * 为自定义topic的后缀过滤器注册处理函数，首次注册某个过滤器时订阅 sys/{pk}/{dn}/custom/{suffix_pattern}
+ * 过滤器可含'+'与'#'，收到消息后经前缀树一次匹配，调用全部命中的处理函数，不再经过recv_handler
+ * 过滤器重叠时，每收到一个PUBLISH报文，每个命中的处理函数调用一次；
+ * broker若为每个重叠的订阅各发一份（MQTT 3.1.1 3.3.5允许），处理函数按收到的份数调用，需要时注册不重叠的过滤器
+ * @param handle
+ * @param suffix_pattern 如 "sensor/+/temp"、"cmd/#"
+ * @param flags IOT_TM_CUSTOM_TOPIC_PARSE_JSON 分发前解析payload
+ * @param handler 在MQTT事件循环中调用，payload直接指向接收缓冲
+ * @param userdata
+ * @return 过滤器已由tm_sub_custom_topic订阅或不合法时返回VOLC_ERR_INVALID_PARAM
+ */
+int32_t iot_tm_custom_topic_register(iot_tm_handler_t *handle, const char *suffix_pattern, uint32_t flags,
+                                     iot_tm_custom_topic_handler_t handler, void *userdata);
+
 /**
  * 释放 TM 模块
  * @param handle
@@ -26,8 +26,18 @@
 #include "thing_model/shadow.h"
 #include "thing_model/webshell.h"
 #include "thing_model/iot_tm_api.h"
+#include "thing_model/tm_coalescer.h"
+#include "thing_model/tm_custom_router.h"
+#include "thing_model/tm_property_cache.h"
+#include "thing_model/tm_pending.h"
+#include "thing_model/tm_shadow_cache.h"
+#include "thing_model/tm_topic_table.h"
+#include "thing_model/tm_webshell.h"
+#include "thing_model/tm_payload.h"
 #include "iot_mqtt.h"
 
+struct aws_json_value;
+
 // custom_topic.c
 
 char* iot_tm_msg_aiot_tm_msg_custom_topic_post_payload(iot_tm_msg_custom_topic_post_t *custom_topic_post);
@@ -43,6 +53,10 @@ void _tm_recv_custom_topic(const char* topic, const uint8_t *payload, size_t len
 
 
 // event.c
+void* iot_tm_msg_event_post_payload(iot_tm_msg_event_post_t *event);
+
+iot_mqtt_buf_t *_tm_event_post_payload_buf(iot_tm_msg_event_post_t *event);
+
 /**
  * 发送 event
  */
@@ -54,127 +68,31 @@ int32_t _tm_send_event_post(void *handler, const char *topic, const void *msg_p)
 void _tm_recv_event_post_reply(const char* topic, const uint8_t *payload, size_t len, void *pUserData);
 
 
-// gateway.c
-// int mapForeach(void *context, struct aws_hash_element *p_element);
-
-bool _check_device_name_legality(const char* device_name);
-
-void to_lowercase(const char* cstr, char* output);
-
-// void* iot_gateway_add_topo_payload(iot_tm_msg_gateway_add_topo_t* pty);
-
-
-// int32_t _tm_send_gateway_add_topo(void* handler, const char* topic, const void* msg_p);
-
-// void _tm_recv_gateway_add_topo_reply_handler(const char* topic, const uint8_t *payload, size_t len, void *pUserData);
-
-
-// void* iot_gateway_delete_topo_payload(iot_tm_msg_gateway_delete_topo_t* pty);
-
-
-// int32_t _tm_send_gateway_delete_topo(void* handler, const char* topic, const void* msg_p);
-
-// /*
-// static void _tm_recv_gateway_unsubscribe_topic_handler(struct aws_mqtt_client_connection *connection,
-//                                                        uint16_t packet_id,
-//                                                        int error_code,
-//                                                        void *userdata);
-//                                                       */
-
-// void _tm_recv_gateway_delete_topo_reply_handler(const char* topic, const uint8_t *payload, size_t len, void *pUserData);
-
-
-// void* iot_gateway_get_topo_payload(iot_tm_msg_gateway_get_topo_t* pty);
-
-// int32_t _tm_send_gateway_get_topo(void* handler, const char* topic, const void* msg_p);
-
-// void _tm_recv_gateway_get_topo_reply_handler(const char* topic, const uint8_t *payload, size_t len, void *pUserData);
-
-
-// void* iot_gateway_get_device_secret_payload(iot_tm_msg_gateway_get_device_secret_t* pty);
-
-// int32_t _tm_send_gateway_get_device_secret(void* handler, const char* topic, const void* msg_p);
-
-// void _tm_recv_gateway_get_device_secret_reply_handler(const char* topic, const uint8_t *payload, size_t len, void *pUserData);
-
-
-// void* iot_gateway_sub_device_login_payload(iot_tm_msg_gateway_sub_device_login_t* pty);
-
-// int32_t _tm_send_gateway_sub_device_login(void* handler, const char* topic, const void* msg_p);
-
-// void _tm_recv_gateway_sub_device_login_reply_handler(const char* topic, const uint8_t *payload, size_t len, void *pUserData);
-
-
-// void* iot_gateway_sub_device_logout_payload(iot_tm_msg_gateway_sub_device_logout_t* pty);
-
-// int32_t _tm_send_gateway_sub_device_logout(void* handler, const char* topic, const void* msg_p);
-
-// void _tm_recv_gateway_sub_device_logout_reply_handler(const char* topic, const uint8_t *payload, size_t len, void *pUserData);
-
-
-// void* iot_gateway_sub_device_discovery_payload(iot_tm_msg_gateway_sub_device_discovery_t* pty);
-
-// int32_t _tm_send_gateway_sub_device_discovery(void* handler, const char* topic, const void* msg_p);
-
-// void _tm_recv_gateway_sub_device_discovery_reply_handler(const char* topic, const uint8_t *payload, size_t len, void *pUserData);
-
-
-// // recv server add topo notify 's msg
-// void _tm_recv_gateway_add_topo_notify_handler(const char* topic, const uint8_t *payload, size_t len, void *pUserData);
-
-// // reply server add topo notify
-// void __send_gateway_add_topo_notify_reply(void* handle, const char* id, int64_t time_stamp, const char* trace_id);
-
-// int32_t _tm_send_gateway_add_topo_notify_reply(void* handler, const char* topic, const void* msg_p);
-
-
-// void iot_gateway_add_topo_notify_reply_init(iot_tm_msg_gateway_add_topo_notify_reply_t** pty, const char* id, int64_t time_stamp, const char* trace_id);
-
-// void iot_gateway_add_topo_notify_reply_free(iot_tm_msg_gateway_add_topo_notify_reply_t* pty);
-
-// void* iot_gateway_add_topo_notify_reply_payload(iot_tm_msg_gateway_add_topo_notify_reply_t* pty);
-
-
-// // reply server topo change notify
-// void __send_gateway_topo_change_notify_reply(void* handle, const char* id);
-
-// // recv server topo change notify 's msg
-// void _tm_recv_gateway_topo_change_notify_handler(const char* topic, const uint8_t *payload, size_t len, void *pUserData);
-
-// void iot_gateway_topo_change_notify_reply_init(iot_tm_msg_gateway_topo_change_notify_reply_t** pty, const char* id);
-
-// void* iot_gateway_topo_change_notify_reply_payload(iot_tm_msg_gateway_topo_change_notify_reply_t* pty);
-
-// void iot_gateway_topo_change_notify_reply_free(iot_tm_msg_gateway_topo_change_notify_reply_t* pty);
-
-// int32_t _tm_send_gateway_topo_change_notify_reply(void* handler, const char* topic, const void* msg_p);
-
-
-// // reply server sub device status change notify
-// void __send_gateway_sub_device_change_notify_reply(void* handle, const char* id);
-
-// // recv server sub device status change notify 's msg
-// void _tm_recv_gateway_sub_device_change_notify_handler(const char* topic, const uint8_t *payload, size_t len, void *pUserData);
-
-// void iot_gateway_sub_device_change_notify_reply_init(iot_tm_msg_gateway_sub_device_change_notify_reply_t** pty, const char* id);
-
-// void* iot_gateway_sub_device_change_notify_reply_payload(iot_tm_msg_gateway_sub_device_change_notify_reply_t* pty);
-
-// void iot_gateway_sub_device_change_notify_reply_free(iot_tm_msg_gateway_sub_device_change_notify_reply_t* pty);
-
-// int32_t _tm_send_gateway_sub_device_change_notify_reply(void* handler, const char* topic, const void* msg_p);
+// iot_ntp.c
+void _tm_recv_device_ntp_info(const char* topic, const uint8_t *payload, size_t len, void *pUserData);
 
+// 按iot_tm_ntp_sync的设置发出到期的时间同步请求，返回距下次的毫秒数，未开启时返回-1
+int32_t _tm_ntp_poll(iot_tm_handler_t *handle, uint64_t now_ms);
 
 
-// iot_ntp.c
-void _tm_recv_device_ntp_info(const char* topic, const uint8_t *payload, size_t len, void *pUserData);
+// device_delay.c
+// 按iot_tm_rtt_probe的设置发出到期的探测与统计上报，返回距下次的毫秒数，未开启时返回-1
+int32_t _tm_rtt_probe_poll(iot_tm_handler_t *handle, uint64_t now_ms);
 
 
 // property.c
 void* iot_property_post_payload(iot_tm_msg_property_post_t *pty);
 
+iot_mqtt_buf_t *_tm_property_post_payload_buf(iot_tm_msg_property_post_t *pty);
+
 int32_t _tm_send_property_post(void *handle, const char *topic, const void *msg);
 
+// 不经上报策略与合并直接发出，保证服务端回复的ID即请求的ID，供iot_tm_send_async使用
+int32_t _tm_send_property_post_direct(void *handle, const char *topic, const void *msg);
+
+// 属性上报缓存的发送回调，合并后的属性按属性上报发出
+int _tm_property_cache_send(const char *topic, const iot_tm_members_t *params, void *userdata);
+
 int32_t _tm_send_property_set_post_reply(void *handle, const char *topic, const void *msg);
 
 void _tm_recv_property_set_handler(const char* topic, const uint8_t *payload, size_t len, void *pUserData);
@@ -207,8 +125,13 @@ void iot_shadow_post_add_param_object(iot_tm_msg_shadow_post_t* pty, const char*
 
 void* iot_shadow_post_payload(iot_tm_msg_shadow_post_t* pty);
 
+iot_mqtt_buf_t *_tm_shadow_post_payload_buf(iot_tm_msg_shadow_post_t* pty);
+
 int32_t _tm_send_shadow_post(void* handler, const char* topic, const void* msg_p);
 
+// 不按缓存计算增量，完整上报，供iot_tm_send_async使用
+int32_t _tm_send_shadow_post_direct(void* handler, const char* topic, const void* msg_p);
+
 void _tm_recv_shadow_report_reply_handler(const char* topic, const uint8_t *payload, size_t len, void *pUserData);
 
 
@@ -244,20 +167,71 @@ void __send_webshell_command_pong(void* handle, const char* uid, const char* pon
 
 int32_t _tm_send_webshell_command_pong(void* handler, const char* topic, const void* msg_p);
 
+// webshell会话的发送回调，输出与退出帧发往会话uid的post_reply topic
+int _tm_webshell_send(const iot_webshell_frame_t *frame, void *userdata);
+
 
 // iot_tm_api.c
+// 子设备下发topic通配订阅的转发项，作为订阅的user_data
+typedef struct iot_tm_recv_route {
+    struct iot_tm_handler *handle;
+    OnMessageHandler func;                      // 本设备同一topic的处理函数
+} iot_tm_recv_route_t;
+
 typedef struct iot_tm_handler{
     iot_mqtt_ctx_t *mqtt_handle;
     void *mqtt_client;
     struct aws_allocator *allocator;
     iot_tm_recv_handler_t *recv_handler;
     void *userdata;
+    iot_tm_coalescer_t *coalescer;  // 属性上报合并，iot_tm_set_property_coalesce开启后创建
+    iot_tm_property_cache_t *property_cache;    // 属性上报策略，iot_tm_set_property_report_policy设置后创建
+    iot_tm_shadow_cache_t *shadow_cache;        // 设备影子本地缓存，iot_tm_set_shadow_cache开启后创建
+    iot_gateway_t *gateway;                     // 网关子设备管理，iot_tm_gateway_enable开启后创建
+    uint32_t gateway_connections;               // 网关上次看到的MQTT连接次数，变化时重新登录子设备
+    iot_tm_recv_route_t *sub_device_routes;     // 子设备下发topic的转发项，与g_dm_recv_topic_mapping一一对应
+    iot_tm_pending_t *pending;                  // 等待回复的请求，首次iot_tm_send_async时创建
+    iot_ntp_sync_t ntp_sync;                    // 定期时间同步，iot_tm_ntp_sync设置
+    iot_tm_rtt_probe_t rtt_probe;               // 主动RTT探测与统计上报，iot_tm_rtt_probe设置
+    iot_webshell_t *webshell;                   // 伪终端会话，iot_tm_webshell_enable开启后创建
+    iot_tm_custom_router_t *custom_router;      // 自定义topic路由，首次iot_tm_custom_topic_register时创建
+    iot_tm_topic_table_t *topic_tables[IOT_TM_TOPIC_TABLE_MAX_DEVICES]; // [0]一般为本设备，其后为网关子设备，首次发送时建立
+    size_t topic_table_count;
+    platform_mutex_t topic_table_mutex;
 } iot_tm_handler_t;
 
 int _s_tm_set_up_mqtt_topic(iot_tm_handler_t *iot_tm_handler);
 
 int __s_tm_set_up_mqtt_topic(iot_tm_handler_t *iot_tm_handler, struct aws_string* product_key, struct aws_string* device_name);
 
+// 子设备的下发topic以 sys/+/+/... 订阅一次，收到后交给route按topic中的子设备转发，已订阅时直接返回
+int __s_tm_set_up_sub_device_topic(iot_tm_handler_t *iot_tm_handler, OnMessageHandler route);
+
+// 把JSON直接序列化到发布缓冲，交给iot_mqtt_publish_buf，不再经过aws_byte_buf中转
+iot_mqtt_buf_t *_tm_json_to_mqtt_buf(struct aws_json_value *json);
+
+// 事件循环使用的单调时钟（毫秒），用于合并窗口计时
+uint64_t _tm_now_ms(void);
+
+// 按回复中的ID完成iot_tm_send_async登记的请求，各回复topic的处理函数在交给recv_handler前调用
+void _tm_pending_on_reply(iot_tm_handler_t *handle, const uint8_t *payload, size_t len);
+
+// 创建请求表并挂上定时任务，已创建时直接返回
+int32_t _tm_pending_enable(iot_tm_handler_t *handle);
+
+// gateway.c
+bool _check_device_name_legality(const char* device_name);
+
+// 网关请求发布到本设备的网关topic，供iot_gateway_t调用
+int _tm_gateway_send(iot_gateway_op_t op, const char *payload, size_t len, void *userdata);
+
+// 批量请求完成，交给recv_handler
+void _tm_gateway_result(iot_gateway_op_t op, const char *id, int32_t code,
+                        const iot_gateway_device_id_t *devices, size_t count, void *userdata);
+
+// 订阅本设备的网关回复与通知topic，以及子设备的通配下发topic
+int _tm_gateway_set_up_mqtt_topic(iot_tm_handler_t *handle);
+
 /*
 typedef struct {
     iot_tm_handler_t *handle;
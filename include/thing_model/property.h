@@ -22,8 +22,8 @@
 typedef struct {
     const char* id;
     const char *version;
-    void* params;
-    void* payload_root;
+    void* params;           // iot_tm_members_t，加入属性时直接序列化
+    void* payload_root;     // iot_property_post_payload 解析出的aws_json_value，仅兼容旧接口
 } iot_tm_msg_property_post_t;
 
 
@@ -51,6 +51,18 @@ void iot_property_post_add_param_string(iot_tm_msg_property_post_t *pty,const ch
 
 void iot_property_post_free(iot_tm_msg_property_post_t *pty);
 
+/**
+ * 属性上报策略，各项为0时不生效
+ * 数值属性与上次上报值之差同时超过绝对死区与百分比死区时为有效变化；非数值属性序列化结果不同即为有效变化
+ */
+typedef struct {
+    double deadband_abs;        // 绝对死区
+    double deadband_pct;        // 百分比死区，相对上次上报值，如 5 表示 5%
+    uint32_t min_interval_ms;   // 两次上报的最短间隔，期间的有效变化暂存，到期后上报最新值
+    uint32_t max_interval_ms;   // 死区内的变化最迟在上次上报后该时间上报，限制上报值的陈旧程度
+    uint32_t heartbeat_ms;      // 该时间内没有上报时重发当前值
+} iot_tm_property_policy_t;
+
 
 typedef struct {
     /**
@@ -22,9 +22,9 @@
 typedef struct {
     const char* id;
     const char* version;
-    void* params;
-    void* report;
-    void* payload_root;
+    void* params;           // 未使用，params在生成payload时写入
+    void* report;           // iot_tm_members_t，加入参数时直接序列化
+    void* payload_root;     // iot_shadow_post_payload 解析出的aws_json_value，仅兼容旧接口
 } iot_tm_msg_shadow_post_t;
 
 typedef struct {
@@ -0,0 +1,116 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ARENAL_IOT_TM_COALESCER_H
+#define ARENAL_IOT_TM_COALESCER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "platform_thread.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IOT_TM_COALESCE_DEFAULT_MAX_BYTES 4096
+
+/**
+ * 发出一条合并后的消息
+ * @param params 合并后的JSON对象，如 {"k1":{...},"k2":{...}}，回调返回后失效
+ * @param members 合并的成员数
+ */
+typedef int (*iot_tm_coalescer_send_fn)(const char *topic, const char *params, size_t len,
+                                        uint32_t members, void *userdata);
+
+// 空批加入首个成员时调用，唤醒阻塞在事件循环中的服务线程重新计算超时
+typedef void (*iot_tm_coalescer_wake_fn)(void *userdata);
+
+typedef struct {
+    uint32_t window_ms;     // 批中首个成员最长等待时间，0 不合并
+    uint32_t max_bytes;     // 合并后params的字节上限，0 使用默认值
+} iot_tm_coalesce_policy_t;
+
+typedef struct {
+    uint32_t off;           // 成员key在params中的偏移
+    uint32_t len;
+} iot_tm_coalesce_key_t;
+
+typedef struct {
+    char *topic;
+    iot_tm_coalesce_policy_t policy;
+    char *params;           // "{"开头、逗号分隔的成员，发出时补"}"
+    size_t len;
+    size_t cap;
+    iot_tm_coalesce_key_t *keys;
+    size_t key_count;
+    size_t key_cap;
+    uint64_t deadline_ms;   // 窗口到期时间，批为空时为0
+} iot_tm_coalesce_batch_t;
+
+/**
+ * 按topic合并属性上报。物模型属性上报的params是以属性标识符为key的JSON对象，
+ * 同一topic在窗口内的多次上报合并为一个params发出；同一属性再次出现时先发出当前批，
+ * 不丢失采样点，也不改变同一属性的上报顺序
+ * 发送回调在锁外调用，可以阻塞
+ */
+typedef struct {
+    iot_tm_coalesce_batch_t *batches;   // 按topic，设置策略后不删除
+    size_t count;
+    iot_tm_coalescer_send_fn send;
+    iot_tm_coalescer_wake_fn wake;      // 可为NULL
+    void *userdata;
+    platform_mutex_t mutex;
+    uint64_t members_in;                // 累计加入的成员数
+    uint64_t messages_out;              // 累计发出的消息数
+    uint64_t bytes_out;                 // 累计发出的params字节数
+} iot_tm_coalescer_t;
+
+int iot_tm_coalescer_init(iot_tm_coalescer_t *c, iot_tm_coalescer_send_fn send, void *userdata);
+
+// 设置唤醒回调，与发送回调共用userdata
+void iot_tm_coalescer_set_wake(iot_tm_coalescer_t *c, iot_tm_coalescer_wake_fn wake);
+
+// 先发出未到期的批再释放
+void iot_tm_coalescer_deinit(iot_tm_coalescer_t *c);
+
+/**
+ * 设置topic的合并策略，window_ms为0时关闭该topic的合并并发出已合并的成员
+ * @return VOLC_OK 成功；内存不足返回VOLC_ERR_MALLOC
+ */
+int iot_tm_coalescer_set_policy(iot_tm_coalescer_t *c, const char *topic, const iot_tm_coalesce_policy_t *policy);
+
+bool iot_tm_coalescer_enabled(iot_tm_coalescer_t *c, const char *topic);
+
+/**
+ * 加入一个成员 "key":value，value为序列化后的JSON
+ * topic未开启合并、同一key已在批中、超出字节上限时立即发出
+ */
+int iot_tm_coalescer_add(iot_tm_coalescer_t *c, const char *topic, const char *key, size_t key_len,
+                         const char *value, size_t value_len, uint64_t now_ms);
+
+// 发出topic已合并的成员，topic为NULL时发出全部，用于事件等需要立即发送的消息之前保证顺序
+int iot_tm_coalescer_flush(iot_tm_coalescer_t *c, const char *topic);
+
+/**
+ * 发出窗口已到期的批，由事件循环定期调用
+ * @return 距最近一批到期的毫秒数；没有待发的批返回-1，之后加入首个成员时通过wake回调唤醒
+ */
+int32_t iot_tm_coalescer_poll(iot_tm_coalescer_t *c, uint64_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ARENAL_IOT_TM_COALESCER_H
@@ -0,0 +1,109 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+
+#ifndef ARENAL_IOT_TM_CUSTOM_ROUTER_H
+#define ARENAL_IOT_TM_CUSTOM_ROUTER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "platform_thread.h"
+#include "iot/iot_mqtt_topic_trie.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IOT_TM_CUSTOM_TOPIC_PARSE_JSON 0x1      // 分发前把payload解析为JSON
+
+struct aws_json_value;
+
+/**
+ * 自定义topic消息，topic与payload直接指向MQTT接收缓冲，回调返回后失效
+ */
+typedef struct {
+    const char *topic;                  // 完整topic sys/{pk}/{dn}/custom/{suffix}
+    size_t topic_len;
+    const char *suffix;                 // custom/之后的部分，指向topic内，不以'\0'结尾
+    size_t suffix_len;
+    const uint8_t *payload;
+    size_t payload_len;
+    /**
+     * 注册时带IOT_TM_CUSTOM_TOPIC_PARSE_JSON且payload是合法JSON时非NULL，否则为NULL
+     * 同一条消息只解析一次，各处理函数共用，只读
+     */
+    const struct aws_json_value *json;
+} iot_tm_custom_topic_msg_t;
+
+typedef void (*iot_tm_custom_topic_handler_t)(const iot_tm_custom_topic_msg_t *msg, void *userdata);
+
+// 一个订阅的后缀过滤器，作为MQTT订阅的user_data
+typedef struct iot_tm_custom_sub iot_tm_custom_sub_t;
+
+/**
+ * 自定义topic路由：后缀过滤器（可含'+'与'#'）注册时插入前缀树，收到消息后一次匹配找出全部处理函数
+ * 过滤器重叠时MQTT层把收到的一个PUBLISH交给每个匹配的订阅，只由其中最早注册的订阅分发，
+ * 每个命中的处理函数对该PUBLISH调用一次；broker为重叠的订阅各发一份时，每一份都会分发
+ */
+typedef struct {
+    iot_mqtt_topic_trie_t routes;       // 后缀过滤器 -> iot_tm_custom_route_t*
+    iot_tm_custom_sub_t **subs;         // 按注册顺序，下标即订阅序号
+    size_t sub_count;
+    size_t sub_cap;
+    uint32_t route_count;
+    platform_mutex_t mutex;
+    bool inited;
+    uint64_t dispatched;                // 累计分发的消息数
+    uint64_t json_errors;               // 要求预解析但不是合法JSON的消息数
+} iot_tm_custom_router_t;
+
+int iot_tm_custom_router_init(iot_tm_custom_router_t *router);
+
+void iot_tm_custom_router_deinit(iot_tm_custom_router_t *router);
+
+/**
+ * 注册处理函数，同一过滤器可注册多个，按注册顺序调用
+ * @param sub_out 过滤器首次注册时输出新的订阅，调用方以它作为user_data订阅MQTT；已有订阅时输出NULL
+ * @return VOLC_OK 成功；过滤器非法返回VOLC_ERR_INVALID_PARAM
+ */
+int iot_tm_custom_router_add(iot_tm_custom_router_t *router, const char *suffix_pattern, uint32_t flags,
+                             iot_tm_custom_topic_handler_t handler, void *userdata, iot_tm_custom_sub_t **sub_out);
+
+/**
+ * 移除订阅及挂在它上面的全部处理函数，用于MQTT订阅失败时撤销iot_tm_custom_router_add
+ * 调用后sub不能再使用
+ */
+void iot_tm_custom_router_remove_sub(iot_tm_custom_router_t *router, iot_tm_custom_sub_t *sub);
+
+// 按过滤器原文查找已有的订阅，没有时返回NULL
+iot_tm_custom_sub_t *iot_tm_custom_router_find(iot_tm_custom_router_t *router, const char *suffix_pattern);
+
+// 订阅对应的后缀过滤器
+const char *iot_tm_custom_sub_pattern(const iot_tm_custom_sub_t *sub);
+
+/**
+ * 分发经sub送达的一条消息，在锁外调用处理函数
+ * @param topic 完整topic，不要求以'\0'结尾
+ * @return 调用的处理函数个数；sub不是命中的订阅中最早注册的（该PUBLISH由那个订阅分发）时返回0
+ */
+size_t iot_tm_custom_router_dispatch(iot_tm_custom_sub_t *sub, const char *topic, size_t topic_len,
+                                     const uint8_t *payload, size_t payload_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ARENAL_IOT_TM_CUSTOM_ROUTER_H
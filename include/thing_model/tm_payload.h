@@ -0,0 +1,110 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ARENAL_IOT_TM_PAYLOAD_H
+#define ARENAL_IOT_TM_PAYLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "aws/common/byte_buf.h"
+#include "util/json_writer.h"
+#include "iot/iot_mqtt_pub_queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IOT_TM_MEMBERS_INIT_SIZE 256
+
+struct aws_json_value;
+
+typedef struct {
+    uint32_t key_off;       // 转义后的key（不含引号）在buf中的偏移
+    uint32_t key_len;
+    uint32_t value_off;     // 序列化后的value在buf中的偏移
+    uint32_t value_len;
+    uint32_t key_hash;      // 忽略大小写的key哈希，查重时先比较
+} iot_tm_member_t;
+
+/**
+ * 物模型上报中params等JSON对象的成员，加入时直接序列化追加到buf，不构建aws_json_value树。
+ * buf中为逗号分隔的 "k":v ，不含外层括号，由json_writer_members嵌入payload。
+ * 成员按加入顺序输出；key重复（不区分大小写）时保留先加入的值，与aws_json_value_add_to_object一致
+ */
+typedef struct {
+    struct aws_byte_buf buf;
+    json_writer_t writer;   // 指向buf，结构体初始化后不可移动
+    iot_tm_member_t *members;
+    size_t count;
+    size_t cap;
+    size_t pending_off;     // begin时buf的长度
+    int error;
+} iot_tm_members_t;
+
+iot_tm_members_t *iot_tm_members_new(void);
+
+void iot_tm_members_destroy(iot_tm_members_t *m);
+
+// 清空成员，保留缓冲复用
+void iot_tm_members_reset(iot_tm_members_t *m);
+
+/**
+ * 开始一个成员，写入key
+ * @return 用于写入value的写入器，之后必须调用iot_tm_members_end；key已存在或已出错时返回NULL
+ */
+json_writer_t *iot_tm_members_begin(iot_tm_members_t *m, const char *key);
+
+void iot_tm_members_end(iot_tm_members_t *m);
+
+/**
+ * 加入已序列化的成员，key为转义后的内容（不含引号），value为序列化后的JSON
+ * @return VOLC_OK 成功；key已存在返回VOLC_ERR_INVALID_PARAM；内存不足返回VOLC_ERR_MALLOC
+ */
+int iot_tm_members_add_raw(iot_tm_members_t *m, const char *key, size_t key_len, const char *value, size_t value_len);
+
+// 加入已解析的JSON值，value为NULL时不加入
+void iot_tm_members_add_json(iot_tm_members_t *m, const char *key, const struct aws_json_value *value);
+
+/**
+ * 用JSON对象字符串的各成员替换当前成员
+ * @return VOLC_OK 成功；json不是合法的JSON对象时返回VOLC_ERR_INVALID_PARAM，成员清空
+ */
+int iot_tm_members_set_json_str(iot_tm_members_t *m, const char *json);
+
+// 成员作为对象值写入w
+void iot_tm_members_write(const iot_tm_members_t *m, json_writer_t *w);
+
+/**
+ * 在新分配的定长发布缓冲上初始化写入器，cap为payload长度上限（不含'\0'）
+ * 写完后调用iot_tm_payload_finish
+ */
+iot_mqtt_buf_t *iot_tm_payload_begin(json_writer_t *w, struct aws_byte_buf *view, size_t cap);
+
+/**
+ * 结束payload写入
+ * @return 成功时设置len并返回buf；失败时释放buf返回NULL
+ */
+iot_mqtt_buf_t *iot_tm_payload_finish(json_writer_t *w, struct aws_byte_buf *view, iot_mqtt_buf_t *buf);
+
+// 已解析的JSON值序列化后写入w
+void iot_tm_json_write_value(json_writer_t *w, const struct aws_json_value *value);
+
+// 字符串写成JSON字符串后的长度上限（含引号）
+size_t iot_tm_json_str_bound(const char *str);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ARENAL_IOT_TM_PAYLOAD_H
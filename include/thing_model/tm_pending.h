@@ -0,0 +1,88 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+
+#ifndef ARENAL_IOT_TM_PENDING_H
+#define ARENAL_IOT_TM_PENDING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "platform_thread.h"
+#include "aws/common/hash_table.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IOT_TM_PENDING_DEFAULT_TIMEOUT_MS 10000
+
+/**
+ * 请求的完成回调，收到回复、超时或取消时调用一次，在锁外调用
+ * @param code 服务端回复的Code；超时为VOLC_ERR_TM_REPLY_TIMEOUT，取消为VOLC_ERR_TM_REPLY_CANCELLED
+ * @param payload 完整的回复payload，超时与取消时为NULL，回调返回后失效
+ */
+typedef void (*iot_tm_reply_fn)(const char *msg_id, int32_t code, const char *payload, size_t len, void *userdata);
+
+/**
+ * 等待回复的请求表：按消息ID关联上行请求与服务端回复
+ * 到期时间由事件循环定期检查，只有最早的请求到期时才遍历整表
+ */
+typedef struct {
+    struct aws_hash_table entries;      // msg_id -> iot_tm_pending_entry_t*
+    uint64_t next_deadline_ms;          // 最早的到期时间，没有请求时为UINT64_MAX
+    platform_mutex_t mutex;
+    bool inited;
+    uint64_t registered;                // 累计登记的请求数
+    uint64_t completed;                 // 累计收到回复的请求数
+    uint64_t timeouts;                  // 累计超时的请求数
+} iot_tm_pending_t;
+
+int iot_tm_pending_init(iot_tm_pending_t *p);
+
+// 仍在等待的请求按VOLC_ERR_TM_REPLY_CANCELLED回调
+void iot_tm_pending_deinit(iot_tm_pending_t *p);
+
+/**
+ * 登记一条请求，须在发出前登记，避免回复先于登记到达
+ * @return VOLC_OK 成功；消息ID已在等待中返回VOLC_ERR_INVALID_PARAM
+ */
+int iot_tm_pending_add(iot_tm_pending_t *p, const char *msg_id, uint64_t deadline_ms,
+                       iot_tm_reply_fn cb, void *userdata);
+
+/**
+ * 按ID完成请求并回调
+ * @return 有对应的请求返回true；不是经请求表发出的消息返回false
+ */
+bool iot_tm_pending_complete(iot_tm_pending_t *p, const char *msg_id, int32_t code,
+                             const char *payload, size_t len);
+
+// 取消登记，不回调，用于请求发送失败
+void iot_tm_pending_remove(iot_tm_pending_t *p, const char *msg_id);
+
+/**
+ * 到期的请求按VOLC_ERR_TM_REPLY_TIMEOUT回调，由事件循环定期调用
+ * @return 距下一个到期时间的毫秒数，没有等待中的请求时返回-1
+ */
+int32_t iot_tm_pending_poll(iot_tm_pending_t *p, uint64_t now_ms);
+
+// 等待中的请求数
+size_t iot_tm_pending_count(iot_tm_pending_t *p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ARENAL_IOT_TM_PENDING_H
@@ -0,0 +1,126 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ARENAL_IOT_TM_PROPERTY_CACHE_H
+#define ARENAL_IOT_TM_PROPERTY_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "platform_thread.h"
+#include "thing_model/property.h"
+#include "thing_model/tm_payload.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * 发出一条合并后的属性上报
+ * @param params 上报的属性成员，回调返回后失效
+ */
+typedef int (*iot_tm_property_cache_send_fn)(const char *topic, const iot_tm_members_t *params, void *userdata);
+
+typedef struct {
+    char *value;            // 序列化后的value，以'\0'结尾；len为0表示上报中没有value
+    size_t len;
+    size_t cap;
+    bool is_num;
+    double num;
+    int64_t time;           // 成员中的time（unix毫秒）
+    uint64_t mono_ms;       // 采样时的单调时钟
+} iot_tm_property_sample_t;
+
+typedef struct {
+    char *key;              // 转义后的属性标识符
+    size_t key_len;
+    iot_tm_property_sample_t reported;  // 上次上报的值
+    iot_tm_property_sample_t pending;   // 尚未上报的最新值，dirty时有效
+    bool has_reported;
+    bool dirty;
+    bool significant;       // pending相对reported超出死区
+    uint64_t last_report_ms;
+    uint64_t dirty_since_ms;    // 首个未上报变化的时间
+} iot_tm_property_entry_t;
+
+typedef struct {
+    char *topic;
+    iot_tm_property_entry_t *entries;
+    size_t count;
+    size_t cap;
+} iot_tm_property_topic_t;
+
+typedef struct {
+    char *identifier;       // NULL 为默认策略
+    iot_tm_property_policy_t policy;
+} iot_tm_property_rule_t;
+
+/**
+ * 属性上报缓存。按属性标识符设置策略，每次上报的属性先与缓存的上次上报值比较，
+ * 死区内的变化与最短间隔内的变化暂存不发；需要上报时同一topic的到期属性与可以上报的暂存属性合并为一条消息。
+ * 没有策略的属性直接上报。发送回调在锁外调用
+ */
+typedef struct {
+    iot_tm_property_rule_t *rules;
+    size_t rule_count;
+    iot_tm_property_topic_t *topics;    // 按topic，不删除
+    size_t topic_count;
+    iot_tm_property_cache_send_fn send;
+    void *userdata;
+    platform_mutex_t mutex;
+    uint64_t samples_in;                // 累计经过策略的属性采样数
+    uint64_t members_out;               // 累计上报的属性数（含直接上报的）
+    uint64_t messages_out;              // 累计发出的消息数
+    uint64_t max_staleness_ms;          // 属性变化到上报的最长延迟
+    uint64_t last_now_ms;               // 最近一次post/poll的时间，deinit时使用
+} iot_tm_property_cache_t;
+
+int iot_tm_property_cache_init(iot_tm_property_cache_t *c, iot_tm_property_cache_send_fn send, void *userdata);
+
+// 先上报暂存的属性再释放
+void iot_tm_property_cache_deinit(iot_tm_property_cache_t *c);
+
+/**
+ * 设置属性的上报策略
+ * @param identifier 属性标识符，与上报中的key一致，如 "default:Temperature"；NULL 设置默认策略
+ * @param policy NULL 删除策略，之后该属性直接上报
+ * @return VOLC_OK 成功；内存不足返回VOLC_ERR_MALLOC
+ */
+int iot_tm_property_cache_set_policy(iot_tm_property_cache_t *c, const char *identifier,
+                                     const iot_tm_property_policy_t *policy);
+
+// 是否设置了任何策略
+bool iot_tm_property_cache_enabled(iot_tm_property_cache_t *c);
+
+/**
+ * 一次属性上报经过缓存。成员的value须为属性上报格式 {"value":v,"time":t}，其他格式直接上报
+ * 需要上报的属性合并为一条消息，通过发送回调发出
+ */
+int iot_tm_property_cache_post(iot_tm_property_cache_t *c, const char *topic, const iot_tm_members_t *params,
+                               uint64_t now_ms);
+
+// 立即上报所有暂存的属性
+int iot_tm_property_cache_flush(iot_tm_property_cache_t *c, uint64_t now_ms);
+
+/**
+ * 上报到期的属性，由事件循环定期调用
+ * @return 距下次到期的毫秒数，没有待上报的属性返回-1
+ */
+int32_t iot_tm_property_cache_poll(iot_tm_property_cache_t *c, uint64_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ARENAL_IOT_TM_PROPERTY_CACHE_H
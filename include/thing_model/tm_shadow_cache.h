@@ -0,0 +1,116 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ARENAL_IOT_TM_SHADOW_CACHE_H
+#define ARENAL_IOT_TM_SHADOW_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "platform_thread.h"
+#include "thing_model/tm_payload.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct iot_kv_ctx;
+
+#define IOT_TM_SHADOW_KV_PREFIX "shadow/"
+#define IOT_TM_SHADOW_MAX_PENDING_REPORTS 8     // 每个设备等待回复的上报数，超出时放弃最早的，其字段下次重新上报
+
+typedef struct {
+    char *key;              // 转义后的key（不含引号）
+    size_t key_len;
+    char *value;            // 序列化后的JSON
+    size_t value_len;
+} iot_tm_shadow_field_t;
+
+typedef struct {
+    iot_tm_shadow_field_t *fields;
+    size_t count;
+    size_t cap;
+} iot_tm_shadow_fields_t;
+
+typedef struct {
+    char *id;                       // 上报消息ID
+    iot_tm_shadow_fields_t fields;  // 本次上报发出的字段，收到成功回复后记为已上报
+} iot_tm_shadow_pending_report_t;
+
+typedef struct {
+    char *device;                   // "product_key/device_name"
+    int64_t version;                // 最近应用的desired版本，has_version为false时未知
+    bool has_version;
+    bool version_restored;          // 版本从kv恢复，尚未经服务端确认，服务端重置影子后版本可能回退
+    iot_tm_shadow_fields_t desired;
+    iot_tm_shadow_fields_t reported;    // 服务端已确认的上报值，上报时只发出与之不同的字段
+    iot_tm_shadow_pending_report_t pending[IOT_TM_SHADOW_MAX_PENDING_REPORTS];  // 按发出顺序
+    size_t pending_count;
+} iot_tm_shadow_doc_t;
+
+/**
+ * 设备影子的本地缓存，按设备保存desired、reported与版本
+ * 下发的desired按版本应用，版本不大于已应用版本的set/get回复视为过期丢弃；从kv恢复的版本只作参考，
+ * 启动后服务端下发的第一个desired不论版本都接受，服务端重置影子后版本回退也能继续同步。
+ * 上报只发出与已确认上报值不同的字段，收到成功回复后才记为已上报并写入kv，发送失败或服务端拒绝时下次重新上报。
+ * 设置kv时，变化后写入kv，启动时从kv恢复，无需先get
+ */
+typedef struct {
+    iot_tm_shadow_doc_t **docs;
+    size_t count;
+    struct iot_kv_ctx *kv;
+    platform_mutex_t mutex;
+} iot_tm_shadow_cache_t;
+
+// kv为NULL时只缓存在内存中
+int iot_tm_shadow_cache_init(iot_tm_shadow_cache_t *c, struct iot_kv_ctx *kv);
+
+void iot_tm_shadow_cache_deinit(iot_tm_shadow_cache_t *c);
+
+/**
+ * 应用服务端下发的desired
+ * @param device "product_key/device_name"
+ * @param desired JSON对象，值为null的字段删除；replace为true时（get回复）整体替换，否则（set）合并
+ * @return VOLC_OK 已应用；版本过期返回VOLC_ERR_TM_SHADOW_STALE_VERSION；desired不是JSON对象返回VOLC_ERR_INVALID_PARAM
+ */
+int iot_tm_shadow_cache_apply_desired(iot_tm_shadow_cache_t *c, const char *device, int64_t version,
+                                      const char *desired, size_t len, bool replace);
+
+/**
+ * 计算上报的增量：report中与已确认上报值不同的字段写入delta，记为以id等待回复的上报
+ * 发送后由 iot_tm_shadow_cache_end_report 按回复确认或放弃
+ * @return delta中加入的字段数，出错时返回负的错误码
+ */
+int iot_tm_shadow_cache_diff_reported(iot_tm_shadow_cache_t *c, const char *device, const char *id,
+                                      const iot_tm_members_t *report, iot_tm_members_t *delta);
+
+/**
+ * 结束以id等待回复的上报：accepted为true时（服务端回复成功）字段记为已上报并写入kv，否则（发送失败、服务端拒绝）丢弃
+ * id不是等待中的上报时忽略
+ */
+void iot_tm_shadow_cache_end_report(iot_tm_shadow_cache_t *c, const char *device, const char *id, bool accepted);
+
+/**
+ * 取缓存的desired
+ * @param desired_json 输出JSON对象字符串，调用方free
+ * @return VOLC_OK 成功；没有该设备已知版本的缓存返回VOLC_ERR_INVALID_PARAM
+ */
+int iot_tm_shadow_cache_get_desired(iot_tm_shadow_cache_t *c, const char *device, char **desired_json,
+                                    int64_t *version);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ARENAL_IOT_TM_SHADOW_CACHE_H
@@ -0,0 +1,68 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ARENAL_IOT_TM_TOPIC_TABLE_H
+#define ARENAL_IOT_TM_TOPIC_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IOT_TM_TOPIC_PARAMETRISED UINT32_MAX
+#define IOT_TM_TOPIC_SCRATCH_SIZE 256      // 参数化topic的格式化缓冲，超出时临时分配
+#define IOT_TM_TOPIC_TABLE_MAX_DEVICES 64  // 缓存topic表的设备数上限（本设备与网关子设备）
+
+/**
+ * 一个设备的固定topic表。格式串 "sys/%s/%s/..." 中只有product_key与device_name两个参数的topic
+ * 在建表时一次格式化，连续存放在strings中，按下标（消息类型）直接取用；
+ * 还带有模块、标识符等参数的topic标记为参数化，发送时再格式化
+ */
+typedef struct {
+    const char *product_key;    // 指向strings
+    const char *device_name;
+    char *strings;              // product_key、device_name与各topic，以'\0'分隔
+    uint32_t *offsets;          // topic在strings中的偏移，参数化的为IOT_TM_TOPIC_PARAMETRISED
+    size_t count;
+} iot_tm_topic_table_t;
+
+/**
+ * 建表
+ * @param fmts 按下标的topic格式串，可为NULL（该下标视为参数化）
+ * @return VOLC_OK 成功；内存不足返回VOLC_ERR_MALLOC
+ */
+int iot_tm_topic_table_build(iot_tm_topic_table_t *table, const char *const *fmts, size_t count,
+                             const char *product_key, const char *device_name);
+
+void iot_tm_topic_table_free(iot_tm_topic_table_t *table);
+
+// 固定topic，参数化或越界时返回NULL
+const char *iot_tm_topic_table_get(const iot_tm_topic_table_t *table, size_t index);
+
+/**
+ * 格式化参数化topic，fmt依次使用product_key、device_name与p1~p3
+ * 优先写入scratch，放不下时分配*heap（调用方free）
+ * @return 格式化后的topic，失败返回NULL
+ */
+const char *iot_tm_topic_format(char *scratch, size_t cap, char **heap, const char *fmt,
+                                const char *product_key, const char *device_name,
+                                const char *p1, const char *p2, const char *p3);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ARENAL_IOT_TM_TOPIC_TABLE_H
@@ -0,0 +1,142 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+
+#ifndef ARENAL_IOT_TM_WEBSHELL_H
+#define ARENAL_IOT_TM_WEBSHELL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "platform_thread.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IOT_WEBSHELL_UID_MAX 64
+#define IOT_WEBSHELL_LINE_MAX 512
+#define IOT_WEBSHELL_POLL_INTERVAL_MS 20        // 有会话时读取终端输出的间隔
+#define IOT_WEBSHELL_KILL_GRACE_MS 1000         // SIGHUP后仍未退出时改发SIGKILL的等待时间
+#define IOT_WEBSHELL_DEFAULT_IDLE_TIMEOUT_MS 600000
+#define IOT_WEBSHELL_DEFAULT_CHUNK_BYTES 4096
+#define IOT_WEBSHELL_DEFAULT_CHUNK_INTERVAL_MS 50
+#define IOT_WEBSHELL_DEFAULT_MAX_SESSIONS 2
+#define IOT_WEBSHELL_DEFAULT_MAX_BUFFER_BYTES (64 * 1024)
+
+/**
+ * webshell会话配置，数值为0时使用默认值
+ */
+typedef struct {
+    const char *shell;                  // NULL 使用/bin/sh
+    uint32_t idle_timeout_ms;           // 无输入输出超过该时间结束会话
+    uint32_t max_lifetime_ms;           // 会话最长存活时间，0 不限制
+    uint32_t chunk_bytes;               // 每帧输出的最大字节数
+    uint32_t chunk_interval_ms;         // 同一会话两帧输出之间的最小间隔
+    uint32_t max_sessions;
+    uint32_t max_buffer_bytes;          // 每个会话暂存的输出上限，满后暂停读取终端，由终端阻塞子进程；也是排队输入的上限
+    /**
+     * 允许执行的命令，以NULL结尾；NULL 不限制
+     * 设置后输入按行转发，首个词须在列表中，且不能含有 ; | & ` $ < > ( ) { } 等组合命令的字符与控制字符
+     * 只限制要执行的命令，参数不做检查，其中的通配符与引号由shell照常展开
+     */
+    const char *const *allowed_commands;
+    /**
+     * 在子进程exec shell之前调用，可在此降权、设置rlimit或加载seccomp规则，返回非0时子进程退出
+     * 运行在fork出的子进程中，只能调用async-signal-safe的函数；shell的环境在fork前确定，不能在此修改
+     */
+    int (*restrict_child)(void *userdata);
+    void *userdata;
+} iot_webshell_config_t;
+
+typedef enum {
+    IOT_WEBSHELL_FRAME_OUTPUT = 0,
+    IOT_WEBSHELL_FRAME_EXIT,
+} iot_webshell_frame_type_t;
+
+typedef enum {
+    IOT_WEBSHELL_EXIT_NORMAL = 0,       // shell自行退出
+    IOT_WEBSHELL_EXIT_TIMEOUT,          // 空闲或存活时间超限
+    IOT_WEBSHELL_EXIT_KILLED,           // iot_webshell_kill或服务端结束会话
+} iot_webshell_exit_reason_t;
+
+/**
+ * 发往服务端的一帧，同一会话的seq从0开始连续递增，退出帧是会话的最后一帧
+ */
+typedef struct {
+    iot_webshell_frame_type_t type;
+    const char *uid;
+    uint32_t seq;
+    const uint8_t *data;                // 输出内容，回调返回后失效
+    size_t len;
+    int32_t exit_code;                  // 退出码，被信号结束时为128+信号
+    iot_webshell_exit_reason_t reason;
+} iot_webshell_frame_t;
+
+/**
+ * 发送一帧，在锁内调用
+ * @return VOLC_OK 已发出；其他值保留该帧，下次poll重发
+ */
+typedef int (*iot_webshell_send_fn)(const iot_webshell_frame_t *frame, void *userdata);
+
+struct iot_webshell_session;
+
+/**
+ * 伪终端webshell：每个uid对应一个shell会话，输出由事件循环定期非阻塞读取，按限速分帧发出
+ * 仅支持Linux与macOS，其他平台初始化返回VOLC_ERR_TM_WEBSHELL_UNSUPPORTED
+ */
+typedef struct {
+    iot_webshell_config_t config;
+    iot_webshell_send_fn send;
+    void *send_userdata;
+    struct iot_webshell_session **sessions;     // 长度为config.max_sessions
+    platform_mutex_t mutex;
+    bool inited;
+    uint64_t frames;                    // 累计发出的输出帧数
+    uint64_t denied;                    // 累计拒绝的命令数
+    uint64_t input_dropped;             // 终端长时间不读取，排队也放不下而丢弃的输入字节数
+} iot_webshell_t;
+
+int iot_webshell_init(iot_webshell_t *ws, const iot_webshell_config_t *config,
+                      iot_webshell_send_fn send, void *userdata);
+
+// 结束所有会话，不再发送退出帧
+void iot_webshell_deinit(iot_webshell_t *ws);
+
+/**
+ * 向会话写入终端输入，uid没有会话时先创建；不阻塞，终端写不下的部分排队，由poll继续写入
+ * @return VOLC_ERR_TM_WEBSHELL_SESSION_LIMIT 会话数已达上限；会话正在结束时返回VOLC_ERR_INVALID_PARAM；
+ *         排队的输入超过max_buffer_bytes时丢弃本次写不下的部分，返回VOLC_ERR_TM_WEBSHELL_INPUT_FULL
+ */
+int iot_webshell_input(iot_webshell_t *ws, const char *uid, const uint8_t *data, size_t len, uint64_t now_ms);
+
+int iot_webshell_resize(iot_webshell_t *ws, const char *uid, uint16_t rows, uint16_t columns);
+
+// 结束会话的整个进程组，剩余输出与退出帧由之后的poll发出
+int iot_webshell_kill(iot_webshell_t *ws, const char *uid);
+
+/**
+ * 读取终端输出、按限速发出、检查超时与退出，由事件循环定期调用
+ * @return 距下次需要调用的毫秒数，没有会话时返回-1
+ */
+int32_t iot_webshell_poll(iot_webshell_t *ws, uint64_t now_ms);
+
+size_t iot_webshell_session_count(iot_webshell_t *ws);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ARENAL_IOT_TM_WEBSHELL_H
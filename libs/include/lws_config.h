@@ -169,7 +169,7 @@
 #define LWS_HAVE_NET_ETHERNET_H
 /* #undef LWS_HAVE_EVBACKEND_LINUXAIO */
 /* #undef LWS_HAVE_EVBACKEND_IOURING */
-/* #undef LWS_WITH_EXTERNAL_POLL */
+#define LWS_WITH_EXTERNAL_POLL
 #define LWS_WITH_FILE_OPS
 /* #undef LWS_WITH_FSMOUNT */
 /* #undef LWS_WITH_FTS */
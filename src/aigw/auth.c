@@ -13,59 +13,84 @@
 // limitations under the License.
 
 #include "onesdk_config.h"
+#include <inttypes.h>
 #include "aws/common/string.h"
+#include "aws/common/encoding.h"
+#include "error_code.h"
 #include "iot/dynreg.h"
 #include "util/util.h"
 #include "aigw/auth.h"
+#include "util/hmac_sha256.h"
+#include "platform_thread.h"
 #include "protocols/private_http_libs.h"
 #include "plat/platform.h"
 
 
 #define MAX_TIMESTAMP_LEN 20
 
+// 设备签名缓存
+struct aigw_auth_cache {
+    platform_mutex_t lock;
+    char *hardware_id;                 // 初始化时计算一次
+    uint32_t ttl_s;                    // 0 表示每次重新签名
+    uint32_t refresh_ahead_s;
+
+    // 缓存键：设备信息变化时重新计算HMAC密钥
+    char *product_key;
+    char *device_name;
+    char *device_secret;
+    onesdk_auth_type_t auth_type;
+    onesdk_hmac_sha256_ctx_t hmac;     // 预计算的ipad/opad状态
+
+    bool valid;
+    uint64_t issued_at;                // 当前签名的时间戳（秒）
+    aigw_auth_token_t token;
+};
+
+static int aigw_auth_cache_sign(aigw_auth_cache_t *cache, const iot_basic_config_t *config,
+                                uint64_t now, aigw_auth_token_t *token);
+static void aigw_auth_cache_reset(aigw_auth_cache_t *cache);
+
 http_request_context_t *device_auth_client(http_request_context_t *http_ctx, iot_basic_ctx_t *iot_basic_ctx) {
     if (http_ctx == NULL) {
         http_ctx = new_http_ctx();
     }
-    int32_t rnd = random_num();
-    uint64_t ts = unix_timestamp();
-    struct aws_allocator *alloc = aws_alloc();
-    aws_common_library_init(alloc);
-
-    struct iot_dynamic_register_basic_param registerParam = {
-        .instance_id = iot_basic_ctx->config->instance_id,
-        .auth_type = iot_basic_ctx->config->auth_type,
-        .timestamp = ts,
-        .random_num = rnd,
-        .product_key = iot_basic_ctx->config->product_key,
-        .device_name = iot_basic_ctx->config->device_name
-    };
-
-
     if (iot_basic_ctx->config->device_secret == NULL) {
         int ret = dynamic_register(iot_basic_ctx);
         if (ret != 0) {
             return NULL;
         }
     }
-    struct aws_string *sign = iot_hmac_sha256_encrypt(alloc, &registerParam, iot_basic_ctx->config->device_secret);
-    const char *signature = aws_string_c_str(sign);
 
+    aigw_auth_token_t token;
+    if (iot_basic_ctx->auth_cache != NULL) {
+        if (aigw_auth_cache_get(iot_basic_ctx->auth_cache, iot_basic_ctx->config, unix_timestamp(), &token) != VOLC_OK) {
+            return NULL;
+        }
+    } else {
+        // 未初始化缓存时退化为一次性签名
+        aigw_auth_cache_t cache;
+        memset(&cache, 0, sizeof(cache));
+        int ret = aigw_auth_cache_sign(&cache, iot_basic_ctx->config, unix_timestamp(), &token);
+        aigw_auth_cache_reset(&cache);
+        if (ret != VOLC_OK) {
+            return NULL;
+        }
+    }
 
-    http_ctx_add_header(http_ctx, (char *)HEADER_SIGNATURE, (char *)signature);
+    http_ctx_add_header(http_ctx, (char *)HEADER_SIGNATURE, token.signature);
     http_ctx_add_header(http_ctx, (char *)HEADER_AUTH_TYPE, (char *)iot_auth_type_c_str(iot_basic_ctx->config->auth_type));
     http_ctx_add_header(http_ctx, (char *)HEADER_DEVICE_NAME, (char *)iot_basic_ctx->config->device_name);
     http_ctx_add_header(http_ctx, (char *)HEADER_PRODUCT_KEY, (char *)iot_basic_ctx->config->product_key);
-    char str[MAX_TIMESTAMP_LEN];
-    sprintf(str, "%ld", rnd);
-    http_ctx_add_header(http_ctx, HEADER_RANDOM_NUM, str);
-    sprintf(str, "%llu", ts);
-    http_ctx_add_header(http_ctx, HEADER_TIMESTAMP, str);
-    char *hw_id = plat_hardware_id();
-    http_ctx_add_header(http_ctx, HEADER_AIGW_HARDWARE_ID, hw_id);
-
-    free(hw_id);
-    aws_string_destroy(sign);
+    http_ctx_add_header(http_ctx, HEADER_RANDOM_NUM, token.random_num);
+    http_ctx_add_header(http_ctx, HEADER_TIMESTAMP, token.timestamp);
+    if (iot_basic_ctx->auth_cache != NULL && iot_basic_ctx->auth_cache->hardware_id != NULL) {
+        http_ctx_add_header(http_ctx, HEADER_AIGW_HARDWARE_ID, iot_basic_ctx->auth_cache->hardware_id);
+    } else {
+        char *hw_id = plat_hardware_id();
+        http_ctx_add_header(http_ctx, HEADER_AIGW_HARDWARE_ID, hw_id);
+        free(hw_id);
+    }
     return http_ctx;
 }
 
@@ -97,4 +122,133 @@ void aigw_auth_header_free(aigw_auth_header_t *header) {
     free(header->random_num);
     free(header->timestamp);
     free(header);
-}
\ No newline at end of file
+}
+
+aigw_auth_cache_t *aigw_auth_cache_new(void) {
+    aigw_auth_cache_t *cache = malloc(sizeof(aigw_auth_cache_t));
+    if (cache == NULL) {
+        return NULL;
+    }
+    memset(cache, 0, sizeof(aigw_auth_cache_t));
+    platform_mutex_init(cache->lock);
+    cache->ttl_s = AIGW_AUTH_TOKEN_TTL_S;
+    cache->refresh_ahead_s = AIGW_AUTH_TOKEN_REFRESH_AHEAD_S;
+    cache->hardware_id = plat_hardware_id();
+    return cache;
+}
+
+void aigw_auth_cache_free(aigw_auth_cache_t *cache) {
+    if (cache == NULL) {
+        return;
+    }
+    aigw_auth_cache_reset(cache);
+    free(cache->hardware_id);
+    platform_mutex_destroy(cache->lock);
+    free(cache);
+}
+
+const char *aigw_auth_cache_hardware_id(const aigw_auth_cache_t *cache) {
+    return cache != NULL ? cache->hardware_id : NULL;
+}
+
+// 清空缓存键和签名，密钥相关内容一并擦除
+static void aigw_auth_cache_reset(aigw_auth_cache_t *cache) {
+    free(cache->product_key);
+    free(cache->device_name);
+    if (cache->device_secret != NULL) {
+        memset(cache->device_secret, 0, strlen(cache->device_secret));
+        free(cache->device_secret);
+    }
+    cache->product_key = NULL;
+    cache->device_name = NULL;
+    cache->device_secret = NULL;
+    memset(&cache->hmac, 0, sizeof(cache->hmac));
+    memset(&cache->token, 0, sizeof(cache->token));
+    cache->valid = false;
+}
+
+static bool str_equal(const char *a, const char *b) {
+    if (a == NULL || b == NULL) {
+        return a == b;
+    }
+    return strcmp(a, b) == 0;
+}
+
+static bool aigw_auth_cache_key_match(const aigw_auth_cache_t *cache, const iot_basic_config_t *config) {
+    return cache->device_secret != NULL &&
+           cache->auth_type == config->auth_type &&
+           str_equal(cache->product_key, config->product_key) &&
+           str_equal(cache->device_name, config->device_name) &&
+           str_equal(cache->device_secret, config->device_secret);
+}
+
+// 重新签名：设备变化时先重建HMAC密钥状态，再对当前时间戳签名
+static int aigw_auth_cache_sign(aigw_auth_cache_t *cache, const iot_basic_config_t *config,
+                                uint64_t now, aigw_auth_token_t *token) {
+    if (config->device_secret == NULL || config->product_key == NULL || config->device_name == NULL) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    if (!aigw_auth_cache_key_match(cache, config)) {
+        aigw_auth_cache_reset(cache);
+        cache->product_key = strdup(config->product_key);
+        cache->device_name = strdup(config->device_name);
+        cache->device_secret = strdup(config->device_secret);
+        cache->auth_type = config->auth_type;
+        if (cache->product_key == NULL || cache->device_name == NULL || cache->device_secret == NULL) {
+            aigw_auth_cache_reset(cache);
+            return VOLC_ERR_MALLOC;
+        }
+        onesdk_hmac_sha256_init(&cache->hmac, config->device_secret, strlen(config->device_secret));
+    }
+
+    struct iot_dynamic_register_basic_param param = {
+        .instance_id = config->instance_id,
+        .auth_type = config->auth_type,
+        .timestamp = now,
+        .random_num = random_num(),
+        .product_key = config->product_key,
+        .device_name = config->device_name
+    };
+    char content[256];
+    int n = iot_hmac_sign_content(content, sizeof(content), &param);
+    if (n < 0 || (size_t)n >= sizeof(content)) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+
+    uint8_t hmac[SHA256_HASH_SIZE];
+    onesdk_hmac_sha256_sign(&cache->hmac, content, (size_t)n, hmac, sizeof(hmac));
+    struct aws_byte_cursor hmac_cur = aws_byte_cursor_from_array(hmac, sizeof(hmac));
+    struct aws_byte_buf sign_buf = aws_byte_buf_from_empty_array(cache->token.signature,
+                                                                sizeof(cache->token.signature) - 1);
+    if (aws_base64_encode(&hmac_cur, &sign_buf) != AWS_OP_SUCCESS) {
+        cache->valid = false;
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    cache->token.signature[sign_buf.len] = '\0';
+    snprintf(cache->token.random_num, sizeof(cache->token.random_num), "%" PRId32, param.random_num);
+    snprintf(cache->token.timestamp, sizeof(cache->token.timestamp), "%" PRIu64, now);
+    cache->issued_at = now;
+    cache->valid = true;
+    *token = cache->token;
+    return VOLC_OK;
+}
+
+int aigw_auth_cache_get(aigw_auth_cache_t *cache, const iot_basic_config_t *config,
+                        uint64_t now, aigw_auth_token_t *token) {
+    if (cache == NULL || config == NULL || token == NULL) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    int ret = VOLC_OK;
+    platform_mutex_lock(cache->lock);
+    // 时钟回拨、窗口即将到期或设备变化时重新签名
+    if (cache->valid && cache->ttl_s > cache->refresh_ahead_s &&
+        now >= cache->issued_at &&
+        now < cache->issued_at + cache->ttl_s - cache->refresh_ahead_s &&
+        aigw_auth_cache_key_match(cache, config)) {
+        *token = cache->token;
+    } else {
+        ret = aigw_auth_cache_sign(cache, config, now, token);
+    }
+    platform_mutex_unlock(cache->lock);
+    return ret;
+}
@@ -30,41 +30,195 @@
 
 #include "error_code.h"
 #include "cJSON.h"
+#include "util/json_writer.h"
 
-#define MAX_RECONNECT_TIMES 3
+void destroy_item(void *data) {
+    my_item_t *item = (my_item_t *) data;
+    if (item->value) {
+        free(item->value);
+        item->value = NULL;
+    }
+}
+
+static void aigw_ws_schedule_reconnect(aigw_ws_ctx_t *ctx);
+
+// 指数退避，取一半固定一半随机，避免大量设备同时重连
+uint32_t aigw_ws_reconnect_delay_ms(int base_ms, uint16_t retry_count, uint32_t random) {
+    uint64_t base = base_ms > 0 ? (uint64_t)base_ms : AIGW_WS_RECONNECT_BASE_MS;
+    uint64_t delay = AIGW_WS_RECONNECT_MAX_MS;
+    if (retry_count < 16 && (base << retry_count) < AIGW_WS_RECONNECT_MAX_MS) {
+        delay = base << retry_count;
+    }
+    return (uint32_t)(delay / 2 + random % (delay / 2 + 1));
+}
+
+static void aigw_ws_reconnect_cb(lws_sorted_usec_list_t *sul) {
+    aigw_ws_ctx_t *ctx = lws_container_of(sul, aigw_ws_ctx_t, sul_reconnect);
+    if (ctx->closing || ctx->connected) {
+        return;
+    }
+    lwsl_user("Reconnecting... %d\n", ctx->retry_count);
+    // 连接失败由CONNECTION_ERROR回调安排下一次重连；lws同步失败时也会先回调，
+    // 只有未回调就返回失败（如参数错误）时才在这里安排，避免重复计数和重复定时
+    if (aigw_ws_connect(ctx) != VOLC_OK && lws_dll2_is_detached(&ctx->sul_reconnect.list)) {
+        aigw_ws_schedule_reconnect(ctx);
+    }
+}
+
+static void aigw_ws_schedule_reconnect(aigw_ws_ctx_t *ctx) {
+    if (ctx->closing) {
+        return;
+    }
+    uint32_t delay_ms = aigw_ws_reconnect_delay_ms(ctx->config->reconnect_interval_ms, ctx->retry_count,
+                                                   (uint32_t)random_num());
+    if (ctx->retry_count < UINT16_MAX) {
+        ctx->retry_count++;
+    }
+    lwsl_user("%s: retry %d in %ums\n", __func__, ctx->retry_count, delay_ms);
+    lws_sul_schedule(ctx->lws_ctx, 0, &ctx->sul_reconnect, aigw_ws_reconnect_cb,
+                     (lws_usec_t)delay_ms * LWS_US_PER_MS);
+}
+
+static void aigw_ws_pong_timeout_cb(lws_sorted_usec_list_t *sul) {
+    aigw_ws_ctx_t *ctx = lws_container_of(sul, aigw_ws_ctx_t, sul_pong_timeout);
+    lwsl_err("%s: no pong in %ds, drop connection\n", __func__, ctx->config->pong_timeout_s);
+    ctx->connected = false;
+    if (ctx->active_conn) {
+        // 连接已不可用，交给lws异步关闭，随后走CLIENT_CLOSED流程
+        lws_set_timeout(ctx->active_conn, PENDING_TIMEOUT_USER_OK, LWS_TO_KILL_ASYNC);
+    }
+}
+
+static void aigw_ws_ping_cb(lws_sorted_usec_list_t *sul) {
+    aigw_ws_ctx_t *ctx = lws_container_of(sul, aigw_ws_ctx_t, sul_ping);
+    if (!ctx->connected || !ctx->active_conn) {
+        return;
+    }
+    // ping在WRITEABLE中发出，这里只负责调度
+    ctx->ping_pending = true;
+    lws_callback_on_writable(ctx->active_conn);
+    lws_sul_schedule(ctx->lws_ctx, 0, &ctx->sul_ping, aigw_ws_ping_cb,
+                     (lws_usec_t)ctx->config->ping_interval_s * LWS_US_PER_SEC);
+}
+
+static void aigw_ws_cancel_timers(aigw_ws_ctx_t *ctx) {
+    lws_sul_cancel(&ctx->sul_ping);
+    lws_sul_cancel(&ctx->sul_pong_timeout);
+    ctx->ping_pending = false;
+}
+
+static int aigw_ws_write_ping(aigw_ws_ctx_t *ctx) {
+    unsigned char ping[LWS_PRE + 4];
+    memset(ping, 0, sizeof(ping));
+    memcpy(ping + LWS_PRE, "ping", 4);
+    ctx->ping_pending = false;
+    lwsl_user("Sending ping message\n");
+    if (lws_write(ctx->active_conn, ping + LWS_PRE, 4, LWS_WRITE_PING) < 4) {
+        lwsl_err("Failed to send ping message\n");
+        return -1;
+    }
+    if (ctx->config->pong_timeout_s > 0 && lws_dll2_is_detached(&ctx->sul_pong_timeout.list)) {
+        lws_sul_schedule(ctx->lws_ctx, 0, &ctx->sul_pong_timeout, aigw_ws_pong_timeout_cb,
+                         (lws_usec_t)ctx->config->pong_timeout_s * LWS_US_PER_SEC);
+    }
+    return 0;
+}
+
+// 其他线程入队后通过lws_cancel_service唤醒事件循环，这里在服务线程里申请writable
+static int aigw_ws_wakeup_one(struct lws_dll2 *d, void *user) {
+    aigw_ws_ctx_t *ctx = lws_container_of(d, aigw_ws_ctx_t, loop_node);
+    (void)user;
+    if (ctx->closing) {
+        // 用户主动断开：取消重连，在WRITEABLE中关闭连接
+        lws_sul_cancel(&ctx->sul_reconnect);
+        if (ctx->active_conn) {
+            lws_callback_on_writable(ctx->active_conn);
+        }
+        return 0;
+    }
+    if (!ctx->connected || !ctx->active_conn) {
+        return 0;
+    }
+    lws_pthread_mutex_lock(&ctx->lock);
+    if (lws_ring_get_element(ctx->send_ring, &ctx->tail)) {
+        lws_callback_on_writable(ctx->active_conn);
+    }
+    lws_pthread_mutex_unlock(&ctx->lock);
+    return 0;
+}
 
-static int reconnect_times = 0;
+static void aigw_ws_loop_poll_notify(aigw_ws_loop_t *loop, aigw_ws_poll_op_t op, const struct lws_pollargs *pa) {
+    if (loop && loop->poll_cb && pa) {
+        loop->poll_cb(op, pa->fd, (short)pa->events, loop->poll_userdata);
+    }
+}
 
 static int aigw_lws_callback(struct lws* wsi, enum lws_callback_reasons reason,
                 void* user, void* in, size_t len) {
     aigw_ws_ctx_t* ctx = user;
+    aigw_ws_loop_t* loop;
+    // 循环级事件：wsi没有会话user
+    switch (reason) {
+        case LWS_CALLBACK_EVENT_WAIT_CANCELLED:
+            loop = lws_context_user(lws_get_context(wsi));
+            if (loop) {
+                lws_pthread_mutex_lock(&loop->lock);
+                lws_dll2_foreach_safe(&loop->sessions, NULL, aigw_ws_wakeup_one);
+                lws_pthread_mutex_unlock(&loop->lock);
+            }
+            return 0;
+        case LWS_CALLBACK_ADD_POLL_FD:
+            aigw_ws_loop_poll_notify(lws_context_user(lws_get_context(wsi)), AIGW_WS_POLL_ADD, in);
+            return 0;
+        case LWS_CALLBACK_DEL_POLL_FD:
+            aigw_ws_loop_poll_notify(lws_context_user(lws_get_context(wsi)), AIGW_WS_POLL_DEL, in);
+            return 0;
+        case LWS_CALLBACK_CHANGE_MODE_POLL_FD:
+            aigw_ws_loop_poll_notify(lws_context_user(lws_get_context(wsi)), AIGW_WS_POLL_CHANGE, in);
+            return 0;
+        default:
+            break;
+    }
+    if (!ctx) {
+        // 会话已销毁，连接正在异步关闭
+        return 0;
+    }
     switch (reason) {
         case LWS_CALLBACK_CLIENT_ESTABLISHED:
             lwsl_user("%s: established\n", __func__);
+            ctx->active_conn = wsi;
             ctx->connected = true;
-            ctx->try_connect = true;
+            ctx->retry_count = 0;
+            // 重连后先恢复会话配置，再发送断连期间排队的消息
+            ctx->resume_pending = (ctx->last_session.value != NULL);
             lws_callback_on_writable(ctx->active_conn);
-            lws_set_timer_usecs(wsi, 1000000);
-            ctx->ping_count = 0;
-            reconnect_times = 0;
+            if (ctx->config->send_ping && ctx->config->ping_interval_s > 0) {
+                lws_sul_schedule(ctx->lws_ctx, 0, &ctx->sul_ping, aigw_ws_ping_cb,
+                                 (lws_usec_t)ctx->config->ping_interval_s * LWS_US_PER_SEC);
+            }
             break;
         case LWS_CALLBACK_CLIENT_CONNECTION_ERROR:
             lwsl_err("CLIENT_CONNECTION_ERROR: %s\n", in ? (char*)in : "(null)");
             ctx->connected = false;
-            if (reconnect_times < MAX_RECONNECT_TIMES) {
-                lwsl_user("Reconnecting... %d\n", reconnect_times++);
-                aigw_ws_connect(ctx);
-            } else {
-                lwsl_err("Reconnect failed\n");
-            }
+            ctx->active_conn = NULL;
+            aigw_ws_cancel_timers(ctx);
+            aigw_ws_schedule_reconnect(ctx);
             break;
         case LWS_CALLBACK_CLIENT_CLOSED:
             lwsl_user("CLIENT_CONNECTION_CLOSED\n");
             ctx->connected = false;
+            ctx->active_conn = NULL;
+            aigw_ws_cancel_timers(ctx);
+            aigw_ws_schedule_reconnect(ctx);
             break;
         case LWS_CALLBACK_CLOSED:
             lwsl_user("LWS_CALLBACK_CLOSED\n");
             ctx->connected = false;
+            ctx->active_conn = NULL;
+            aigw_ws_cancel_timers(ctx);
+            break;
+        case LWS_CALLBACK_CLIENT_RECEIVE_PONG:
+            lws_sul_cancel(&ctx->sul_pong_timeout);
             break;
         case LWS_CALLBACK_CLIENT_RECEIVE:
             // lwsl_hexdump_notice(in, len);
@@ -77,6 +231,33 @@ static int aigw_lws_callback(struct lws* wsi, enum lws_callback_reasons reason,
                 lwsl_err("Connection closed\n");
                 return -1;
             }
+            if (ctx->closing) {
+                lws_close_reason(wsi, LWS_CLOSE_STATUS_GOINGAWAY, (unsigned char *)"seeya", 5);
+                return -1;
+            }
+            if (ctx->ping_pending) {
+                if (aigw_ws_write_ping(ctx)) {
+                    return -1;
+                }
+                // 一次writable只能写一帧，待重放的会话配置和剩余消息等下一次
+                if (ctx->resume_pending || lws_ring_get_element(ctx->send_ring, &ctx->tail)) {
+                    lws_callback_on_writable(ctx->active_conn);
+                }
+                break;
+            }
+            if (ctx->resume_pending) {
+                ctx->resume_pending = false;
+                lwsl_user("Replay session.update after reconnect\n");
+                if (lws_write(ctx->active_conn, (unsigned char *)ctx->last_session.value + LWS_PRE,
+                    ctx->last_session.len, LWS_WRITE_TEXT) < (int)ctx->last_session.len) {
+                    lwsl_err("Failed to replay session.update\n");
+                    return -1;
+                }
+                if (lws_ring_get_element(ctx->send_ring, &ctx->tail)) {
+                    lws_callback_on_writable(ctx->active_conn);
+                }
+                break;
+            }
             lws_pthread_mutex_lock(&ctx->lock);
             const my_item_t* msg = lws_ring_get_element(ctx->send_ring, &ctx->tail);
             if (!msg) {
@@ -90,7 +271,13 @@ static int aigw_lws_callback(struct lws* wsi, enum lws_callback_reasons reason,
                 lwsl_err("Failed to send message\n");
                 return -1;
             } else {
-                lwsl_user("Sent message: %.*s\n", (int)msg->len, (char*)msg->value);
+                lwsl_user("Sent message: %.*s\n", (int)msg->len, (char*)msg->value + LWS_PRE);
+                if (msg->session_update) {
+                    // 接管已发送的session.update缓冲区，供重连后重放
+                    destroy_item(&ctx->last_session);
+                    ctx->last_session = *msg;
+                    ((my_item_t *)msg)->value = NULL;
+                }
             }
 skip:
             lws_ring_consume_single_tail(ctx->send_ring, &ctx->tail, 1);
@@ -113,66 +300,33 @@ skip:
                 lwsl_err("Failed to add header\n");
                 return -1;
             }
-            int32_t rnd = random_num();
-            uint64_t ts = unix_timestamp();
-
-            struct aws_allocator *alloc = aws_alloc();
-            aws_common_library_init(alloc);
-
-            struct iot_dynamic_register_basic_param registerParam = {
-                .instance_id = ctx->iot_device_config->instance_id,
-                .auth_type = ctx->iot_device_config->auth_type,
-                .timestamp = ts,
-                .random_num = rnd,
-                .product_key = ctx->iot_device_config->product_key,
-                .device_name = ctx->iot_device_config->device_name
-            };
-
-            aigw_auth_header_t *auth_header = aigw_auth_header_new(&registerParam,
-                ctx->iot_device_config->device_secret);
-
-            lws_add_http_header_by_name(wsi, (const unsigned char *)HEADER_SIGNATURE, (const unsigned char *)auth_header->signature,
-                strlen(auth_header->signature), p, end);
-            lws_add_http_header_by_name(wsi, (const unsigned char *)HEADER_AUTH_TYPE, (const unsigned char *)auth_header->auth_type,
-                strlen(auth_header->auth_type), p, end);
-            lws_add_http_header_by_name(wsi, (const unsigned char *)HEADER_DEVICE_NAME, (const unsigned char *)auth_header->device_name,
-                strlen(auth_header->device_name), p, end);
-            lws_add_http_header_by_name(wsi, (const unsigned char *)HEADER_PRODUCT_KEY, (const unsigned char *)auth_header->product_key,
-                strlen(auth_header->product_key), p, end);
-            lws_add_http_header_by_name(wsi, (const unsigned char *)HEADER_RANDOM_NUM, (const unsigned char *)auth_header->random_num,
-                strlen(auth_header->random_num), p, end);
-            lws_add_http_header_by_name(wsi, (const unsigned char *)HEADER_TIMESTAMP, (const unsigned char *)auth_header->timestamp,
-                strlen(auth_header->timestamp), p, end);
-            
-            aigw_auth_header_free(auth_header);
-
-            char *hw_id = plat_hardware_id();
-            lwsl_user("hardware_id: %s\n", hw_id);
-            lws_add_http_header_by_name(wsi, (const unsigned char *)HEADER_AIGW_HARDWARE_ID, (const unsigned char *)hw_id, strlen(hw_id), p, end);
-            free(hw_id);
+            // 重连时复用同一时间窗口内的签名
+            aigw_auth_token_t token;
+            if (!ctx->auth_cache || aigw_auth_cache_get(ctx->auth_cache, ctx->iot_device_config, unix_timestamp(), &token) != VOLC_OK) {
+                lwsl_err("Failed to sign handshake\n");
+                return -1;
+            }
+            const char *auth_type = iot_auth_type_c_str(ctx->iot_device_config->auth_type);
+            lws_add_http_header_by_name(wsi, (const unsigned char *)HEADER_SIGNATURE, (const unsigned char *)token.signature,
+                strlen(token.signature), p, end);
+            lws_add_http_header_by_name(wsi, (const unsigned char *)HEADER_AUTH_TYPE, (const unsigned char *)auth_type,
+                strlen(auth_type), p, end);
+            lws_add_http_header_by_name(wsi, (const unsigned char *)HEADER_DEVICE_NAME, (const unsigned char *)ctx->iot_device_config->device_name,
+                strlen(ctx->iot_device_config->device_name), p, end);
+            lws_add_http_header_by_name(wsi, (const unsigned char *)HEADER_PRODUCT_KEY, (const unsigned char *)ctx->iot_device_config->product_key,
+                strlen(ctx->iot_device_config->product_key), p, end);
+            lws_add_http_header_by_name(wsi, (const unsigned char *)HEADER_RANDOM_NUM, (const unsigned char *)token.random_num,
+                strlen(token.random_num), p, end);
+            lws_add_http_header_by_name(wsi, (const unsigned char *)HEADER_TIMESTAMP, (const unsigned char *)token.timestamp,
+                strlen(token.timestamp), p, end);
 
-            break;
-        }
-        case LWS_CALLBACK_TIMER:
-            if (ctx->connected) {
-                if (ctx->config->send_ping && ctx->ping_count++ == ctx->config->ping_interval_s) {
-                    ctx->ping_count = 0;
-                    lwsl_user("Sending ping message\n");
-                    char ping[LWS_PRE+4];
-                    memset(ping, 0, LWS_PRE+4);
-                    memcpy(ping+4, "ping", 4);
-                    int m = lws_write(ctx->active_conn, (unsigned char *)ping, 4, LWS_WRITE_PING);
-                    if (m < 4) {
-                        lwsl_err("Failed to send ping message\n");
-                    }
-                }
-                // 每秒触发writable，及时消费ring
-                lws_set_timer_usecs(wsi, 1000000);
-                if (lws_ring_get_element(ctx->send_ring, &ctx->tail)) {
-                    lws_callback_on_writable(ctx->active_conn);
-                }    
+            const char *hw_id = aigw_auth_cache_hardware_id(ctx->auth_cache);
+            if (hw_id) {
+                lws_add_http_header_by_name(wsi, (const unsigned char *)HEADER_AIGW_HARDWARE_ID, (const unsigned char *)hw_id, strlen(hw_id), p, end);
             }
+
             break;
+        }
         default:
             break;
     }
@@ -212,39 +366,127 @@ static int copy_config(aigw_ws_config_t *dst, const aigw_ws_config_t *src) {
     dst->verify_ssl = src->verify_ssl;
     dst->send_ping = src->send_ping;
     dst->ping_interval_s = src->ping_interval_s;
+    dst->pong_timeout_s = src->pong_timeout_s;
     return VOLC_OK;
 }
 
-void destroy_item(void *data) {
-    my_item_t *item = (my_item_t *) data;
-    if (item->value) {
-        free(item->value);
-        item->value = NULL;
+aigw_ws_loop_t* aigw_ws_loop_create(aigw_ws_poll_cb poll_cb, void* userdata) {
+    aigw_ws_loop_t *loop = malloc(sizeof(aigw_ws_loop_t));
+    if (!loop) {
+        return NULL;
     }
+    memset(loop, 0, sizeof(aigw_ws_loop_t));
+    loop->refcount = 1;
+    loop->poll_cb = poll_cb;
+    loop->poll_userdata = userdata;
+    lws_pthread_mutex_init(&loop->lock);
+    return loop;
 }
 
-int aigw_ws_init(aigw_ws_ctx_t *ctx, const aigw_ws_config_t *config) {
-    if (!ctx) {
-        ctx = malloc(sizeof(aigw_ws_ctx_t));
-        if (!ctx) {
-            return VOLC_ERR_MALLOC;
-        }
+// lws_context的CA是上下文级的，同一循环上的会话连接同一网关，按首个会话的配置创建
+static int aigw_ws_loop_start(aigw_ws_loop_t *loop, const aigw_ws_config_t *config) {
+    struct lws_context_creation_info info;
+    if (loop->lws_ctx) {
+        return VOLC_OK;
     }
-    memset(ctx, 0, sizeof(aigw_ws_ctx_t));
-
-    struct lws_context_creation_info info;;
     memset(&info, 0, sizeof(info));
     // if (config->verify_ssl) {
         info.options = LWS_SERVER_OPTION_DO_SSL_GLOBAL_INIT;
     // }
     info.port = CONTEXT_PORT_NO_LISTEN;
     info.protocols = protocols;
+    info.user = loop;  // 循环级回调没有wsi user，通过context user找回loop
     if (config->ca) {
         info.client_ssl_ca_mem = config->ca;
         info.client_ssl_ca_mem_len = strlen(config->ca);
     }
     // info.fd_limit_per_thread = 1 + 1 + 1 + 1;
-    ctx->lws_ctx = lws_create_context(&info);
+    loop->lws_ctx = lws_create_context(&info);
+    if (!loop->lws_ctx) {
+        return VOLC_ERR_INIT;
+    }
+    return VOLC_OK;
+}
+
+void aigw_ws_loop_release(aigw_ws_loop_t* loop) {
+    if (!loop) {
+        return;
+    }
+    lws_pthread_mutex_lock(&loop->lock);
+    int refcount = --loop->refcount;
+    lws_pthread_mutex_unlock(&loop->lock);
+    if (refcount > 0) {
+        return;
+    }
+    if (loop->lws_ctx) {
+        lws_context_destroy(loop->lws_ctx);
+    }
+    lws_pthread_mutex_destroy(&loop->lock);
+    free(loop);
+}
+
+static void aigw_ws_loop_wait_cb(lws_sorted_usec_list_t *sul) {
+    // 只用于让lws_service在等待上限返回
+    (void)sul;
+}
+
+int aigw_ws_loop_service_once(aigw_ws_loop_t* loop, int timeout_ms) {
+    if (!loop || !loop->lws_ctx) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    if (timeout_ms <= 0) {
+        return lws_service(loop->lws_ctx, -1);
+    }
+    // lws 4.x忽略非负的timeout，一直等到下一个事件或sul到期，用sul限定等待时间
+    lws_sul_schedule(loop->lws_ctx, 0, &loop->sul_wait, aigw_ws_loop_wait_cb,
+                     (lws_usec_t)timeout_ms * LWS_US_PER_MS);
+    int ret = lws_service(loop->lws_ctx, 0);
+    lws_sul_cancel(&loop->sul_wait);
+    return ret;
+}
+
+int aigw_ws_loop_service_fd(aigw_ws_loop_t* loop, int fd, short revents) {
+    struct lws_pollfd pfd;
+    if (!loop || !loop->lws_ctx) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    if (fd < 0) {
+        // lws 4.x的lws_service_fd不接受NULL，不等待地服务一次以处理到期的定时器
+        return lws_service_tsi(loop->lws_ctx, -1, 0);
+    }
+    pfd.fd = fd;
+    pfd.events = revents;
+    pfd.revents = revents;
+    return lws_service_fd(loop->lws_ctx, &pfd);
+}
+
+int aigw_ws_init(aigw_ws_ctx_t *ctx, const aigw_ws_config_t *config) {
+    if (!ctx) {
+        ctx = malloc(sizeof(aigw_ws_ctx_t));
+        if (!ctx) {
+            return VOLC_ERR_MALLOC;
+        }
+    }
+    memset(ctx, 0, sizeof(aigw_ws_ctx_t));
+
+    aigw_ws_loop_t *loop = config->loop;
+    if (loop) {
+        lws_pthread_mutex_lock(&loop->lock);
+        loop->refcount++;
+        lws_pthread_mutex_unlock(&loop->lock);
+    } else {
+        loop = aigw_ws_loop_create(NULL, NULL);
+        if (!loop) {
+            return VOLC_ERR_MALLOC;
+        }
+    }
+    ctx->loop = loop;
+    if (aigw_ws_loop_start(loop, config) != VOLC_OK) {
+        aigw_ws_loop_release(loop);
+        ctx->loop = NULL;
+        return VOLC_ERR_INIT;
+    }
+    ctx->lws_ctx = loop->lws_ctx;
     ctx->config = malloc(sizeof(aigw_ws_config_t));
     if (!ctx->config) {
         return VOLC_ERR_MALLOC;
@@ -253,6 +495,10 @@ int aigw_ws_init(aigw_ws_ctx_t *ctx, const aigw_ws_config_t *config) {
     copy_config(ctx->config, config);
     ctx->send_ring = lws_ring_create(sizeof(my_item_t), 50, destroy_item);
     lws_pthread_mutex_init(&ctx->lock);
+
+    lws_pthread_mutex_lock(&loop->lock);
+    lws_dll2_add_tail(&ctx->loop_node, &loop->sessions);
+    lws_pthread_mutex_unlock(&loop->lock);
     return VOLC_OK;
 }
 
@@ -301,7 +547,23 @@ void iot_device_config_free(iot_basic_config_t * iot_device_config) {
 }
 
 void aigw_ws_deinit(aigw_ws_ctx_t* ctx) {
-    lws_context_destroy(ctx->lws_ctx);
+    ctx->closing = true;
+    aigw_ws_cancel_timers(ctx);
+    lws_sul_cancel(&ctx->sul_reconnect);
+    if (ctx->loop) {
+        lws_pthread_mutex_lock(&ctx->loop->lock);
+        lws_dll2_remove(&ctx->loop_node);
+        lws_pthread_mutex_unlock(&ctx->loop->lock);
+        if (ctx->active_conn) {
+            // 共享循环不随会话销毁，解除wsi与ctx的关联后由lws异步关闭
+            lws_set_wsi_user(ctx->active_conn, NULL);
+            lws_set_timeout(ctx->active_conn, PENDING_TIMEOUT_USER_OK, LWS_TO_KILL_ASYNC);
+            ctx->active_conn = NULL;
+        }
+        aigw_ws_loop_release(ctx->loop);
+        ctx->loop = NULL;
+    }
+    destroy_item(&ctx->last_session);
     if (ctx->send_ring) {
         lws_ring_destroy(ctx->send_ring);
     }
@@ -311,12 +573,14 @@ void aigw_ws_deinit(aigw_ws_ctx_t* ctx) {
     if (ctx->iot_device_config) {
         iot_device_config_free(ctx->iot_device_config);
     }
+    aigw_auth_cache_free(ctx->auth_cache);
     lws_pthread_mutex_destroy(&ctx->lock);
     free(ctx);
     ctx = NULL;
 }
 
 int aigw_ws_connect(aigw_ws_ctx_t* ctx) {
+    ctx->closing = false;
     struct lws_client_connect_info ccinfo;
     memset(&ccinfo, 0, sizeof(ccinfo));
     const char *address, *prot, *path;
@@ -338,7 +602,7 @@ int aigw_ws_connect(aigw_ws_ctx_t* ctx) {
         ccinfo.ssl_connection |= LCCSCF_ALLOW_EXPIRED; // 允许过期证书
         ccinfo.ssl_connection |= LCCSCF_ALLOW_INSECURE; // 不验证证书
    }
-    ccinfo.pwsi = &ctx->active_conn;
+    // 不设置pwsi：lws在wsi释放时会写*pwsi，会话销毁后wsi仍可能在共享循环上异步关闭
     ccinfo.userdata = ctx;
     free(url);
     ctx->active_conn = lws_client_connect_via_info(&ccinfo);
@@ -351,22 +615,17 @@ int aigw_ws_connect(aigw_ws_ctx_t* ctx) {
 }
 
 void aigw_ws_disconnect(aigw_ws_ctx_t* ctx) {
-    if (!ctx->connected) {
-        return;
-    }
-    lws_close_reason(ctx->active_conn, LWS_CLOSE_STATUS_GOINGAWAY, (unsigned char *)"seeya", 5);
+    ctx->closing = true;
+    // 关闭和取消重连都需要在服务线程中完成
+    lws_cancel_service(ctx->lws_ctx);
 }
 
-int aigw_ws_send_request(aigw_ws_ctx_t* ctx, const char* json_str) {
+static int aigw_ws_enqueue(aigw_ws_ctx_t* ctx, const char* json_str, bool session_update) {
     if (json_str == NULL) {
         return VOLC_OK;
     }
 
-    if (!ctx->connected && ctx->try_connect) {
-        aigw_ws_connect(ctx);
-        ctx->try_connect = false;
-        sleep(1);
-    }
+    // 断连期间只入队，由重连流程在连接建立后发送，不阻塞调用线程
     my_item_t msg;
     // need to add LWS_PRE before json_str
     size_t json_len = strlen(json_str);
@@ -377,7 +636,8 @@ int aigw_ws_send_request(aigw_ws_ctx_t* ctx, const char* json_str) {
     }
     memset((char*)msg.value, 0, json_len + LWS_PRE);
     memcpy((char*)msg.value+LWS_PRE, json_str, json_len);
-    msg.len = strlen(json_str);
+    msg.len = json_len;
+    msg.session_update = session_update;
     lws_pthread_mutex_lock(&ctx->lock);
     int n = (int)lws_ring_insert(ctx->send_ring, &msg, 1);
     if (n != 1) {
@@ -386,11 +646,16 @@ int aigw_ws_send_request(aigw_ws_ctx_t* ctx, const char* json_str) {
     }
     lws_pthread_mutex_unlock(&ctx->lock);
     if (ctx->connected) {
-        lws_callback_on_writable(ctx->active_conn);
+        // lws_callback_on_writable不能跨线程调用，唤醒服务线程后在EVENT_WAIT_CANCELLED中申请
+        lws_cancel_service(ctx->lws_ctx);
     }
     return VOLC_OK;
 }
 
+int aigw_ws_send_request(aigw_ws_ctx_t* ctx, const char* json_str) {
+    return aigw_ws_enqueue(ctx, json_str, false);
+}
+
 void aigw_ws_set_option(aigw_ws_ctx_t *ctx, aigw_ws_option_t option, void* value) {
     switch (option) {
         case AIGW_WS_URL:
@@ -417,76 +682,136 @@ void aigw_ws_set_option(aigw_ws_ctx_t *ctx, aigw_ws_option_t option, void* value
             break;
         case AIGW_WS_IOT_CONFIG:
             ctx->iot_device_config = iot_config_dup((iot_basic_config_t*)value);
+            if (ctx->auth_cache == NULL) {
+                ctx->auth_cache = aigw_auth_cache_new();
+            }
             break;
         default:
             break;
     }
 }
 
-int aigw_ws_session_update(aigw_ws_ctx_t* ctx, const aigw_ws_session_t* session) {
-    if (!session) {
-        return VOLC_ERR_INVALID_PARAM;
+// 原样下发的JSON片段先校验，避免拼出服务端无法解析的帧
+static bool session_json_valid(const char *json) {
+    cJSON *parsed = cJSON_ParseWithOpts(json, NULL, 1);
+    if (parsed == NULL) {
+        return false;
     }
-    // 创建根 JSON 对象
-    cJSON* root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "type", "session.update");
+    cJSON_Delete(parsed);
+    return true;
+}
 
-    // 创建 "session" 对象
-    cJSON* session_obj = cJSON_CreateObject();
-    cJSON_AddItemToObject(root, "session", session_obj);
+// NULL字段不下发，与服务端默认值保持一致
+static void session_kv_string(json_writer_t *w, const char *key, const char *value) {
+    if (value != NULL) {
+        json_writer_kv_string(w, key, value);
+    }
+}
 
-    // 添加 "modalities" 数组
-    cJSON* modalities_array = cJSON_CreateArray();
+int aigw_ws_session_update_to_json(const aigw_ws_session_t* session, struct aws_byte_buf* out) {
+    if (!session || !out) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    size_t num_tools = session->num_tools;
+    if (session->tools != NULL && num_tools == 0) {
+        num_tools = 1;
+    }
+    for (size_t i = 0; session->tools != NULL && i < num_tools; i++) {
+        if (session->tools[i].parameters != NULL && !session_json_valid(session->tools[i].parameters)) {
+            lwsl_err("%s: tool %zu parameters is not valid JSON\n", __func__, i);
+            return VOLC_ERR_INVALID_PARAM;
+        }
+    }
+    json_writer_t w;
+    json_writer_init(&w, out);
+    json_writer_begin_object(&w);
+    json_writer_kv_string(&w, "type", "session.update");
+    json_writer_key(&w, "session");
+    json_writer_begin_object(&w);
+
+    json_writer_key(&w, "modalities");
+    json_writer_begin_array(&w);
     if (session->modality_audio_enabled) {
-        cJSON_AddItemToArray(modalities_array, cJSON_CreateString("audio"));
+        json_writer_string(&w, "audio");
     }
     if (session->modality_text_enabled) {
-        cJSON_AddItemToArray(modalities_array, cJSON_CreateString("text"));
+        json_writer_string(&w, "text");
     }
-    cJSON_AddItemToObject(session_obj, "modalities", modalities_array);
-
-    // 添加其他字段
-    cJSON_AddStringToObject(session_obj, "instructions", session->instructions);
-    cJSON_AddStringToObject(session_obj, "voice", session->voice);
-    cJSON_AddStringToObject(session_obj, "input_audio_format", session->input_audio_format);
-    cJSON_AddStringToObject(session_obj, "output_audio_format", session->output_audio_format);
-    cJSON_AddStringToObject(session_obj, "tool_choice", "auto");
-    cJSON_AddNullToObject(session_obj, "turn_detection");
-
-    // 添加 "input_audio_transcription" 对象
-    cJSON* transcription_obj = cJSON_CreateObject();
-    cJSON_AddStringToObject(transcription_obj, "model", "any");
-    cJSON_AddItemToObject(session_obj, "input_audio_transcription", transcription_obj);
+    json_writer_end_array(&w);
 
-    // 添加 "tools" 数组
-    cJSON* tools_array = cJSON_CreateArray();
-    if (session->tools != NULL) {
-        cJSON* tool_obj = cJSON_CreateObject();
-        cJSON_AddStringToObject(tool_obj, "type", session->tools->type);
-        cJSON_AddStringToObject(tool_obj, "name", session->tools->name);
-        cJSON_AddStringToObject(tool_obj, "description", session->tools->description);
+    session_kv_string(&w, "instructions", session->instructions);
+    session_kv_string(&w, "voice", session->voice);
+    session_kv_string(&w, "input_audio_format", session->input_audio_format);
+    session_kv_string(&w, "output_audio_format", session->output_audio_format);
+    json_writer_kv_string(&w, "tool_choice", session->tool_choice ? session->tool_choice : "auto");
 
-        // 解析 "parameters" 字符串为 JSON 对象
-        cJSON* parameters_obj = cJSON_Parse(session->tools->parameters);
-        cJSON_AddItemToObject(tool_obj, "parameters", parameters_obj);
-
-        cJSON_AddItemToArray(tools_array, tool_obj);
+    const aigw_ws_turn_detection_t *td = session->turn_detection;
+    if (td == NULL) {
+        json_writer_kv_null(&w, "turn_detection");
+    } else {
+        json_writer_key(&w, "turn_detection");
+        json_writer_begin_object(&w);
+        json_writer_kv_string(&w, "type", td->type ? td->type : "server_vad");
+        if (td->threshold > 0) {
+            json_writer_kv_double(&w, "threshold", td->threshold);
+        }
+        if (td->prefix_padding_ms > 0) {
+            json_writer_kv_int(&w, "prefix_padding_ms", td->prefix_padding_ms);
+        }
+        if (td->silence_duration_ms > 0) {
+            json_writer_kv_int(&w, "silence_duration_ms", td->silence_duration_ms);
+        }
+        json_writer_end_object(&w);
     }
-    cJSON_AddItemToObject(session_obj, "tools", tools_array);
 
-    // 添加 "temperature" 字段
-    cJSON_AddNumberToObject(session_obj, "temperature", 0.8);
+    if (session->input_audio_transcription) {
+        json_writer_key(&w, "input_audio_transcription");
+        json_writer_begin_object(&w);
+        json_writer_kv_string(&w, "model",
+            session->transcription_model ? session->transcription_model : "any");
+        json_writer_end_object(&w);
+    } else {
+        json_writer_kv_null(&w, "input_audio_transcription");
+    }
 
-    // 生成 JSON 字符串
-    char * json_str = NULL;
-    json_str = cJSON_PrintUnformatted(root);
+    json_writer_key(&w, "tools");
+    json_writer_begin_array(&w);
+    for (size_t i = 0; session->tools != NULL && i < num_tools; i++) {
+        const aigw_ws_session_tools_t *tool = &session->tools[i];
+        json_writer_begin_object(&w);
+        json_writer_kv_string(&w, "type", tool->type ? tool->type : "function");
+        session_kv_string(&w, "name", tool->name);
+        session_kv_string(&w, "description", tool->description);
+        if (tool->parameters != NULL) {
+            json_writer_kv_raw(&w, "parameters", tool->parameters);
+        }
+        json_writer_end_object(&w);
+    }
+    json_writer_end_array(&w);
 
-    // 释放内存
-    cJSON_Delete(root);
+    json_writer_kv_double(&w, "temperature",
+        session->temperature > 0 ? session->temperature : AIGW_WS_DEFAULT_TEMPERATURE);
+    if (session->max_response_output_tokens > 0) {
+        json_writer_kv_int(&w, "max_response_output_tokens", session->max_response_output_tokens);
+    }
+    json_writer_end_object(&w);
+    json_writer_end_object(&w);
+    return json_writer_finish(&w);
+}
 
-    int ret = aigw_ws_send_request(ctx, json_str);
-    if (json_str)
-        free(json_str);
+int aigw_ws_session_update(aigw_ws_ctx_t* ctx, const aigw_ws_session_t* session) {
+    if (!session) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    struct aws_byte_buf buf;
+    if (aws_byte_buf_init(&buf, aws_alloc(), 512) != AWS_OP_SUCCESS) {
+        return VOLC_ERR_MALLOC;
+    }
+    int ret = aigw_ws_session_update_to_json(session, &buf);
+    if (ret == VOLC_OK) {
+        ret = aigw_ws_enqueue(ctx, (const char *)buf.buffer, true);
+    }
+    aws_byte_buf_clean_up(&buf);
     return ret;
 }
 
@@ -594,7 +919,7 @@ int aigw_ws_translation_session_update(aigw_ws_ctx_t* ctx, const aigw_ws_transla
     // 释放内存
     cJSON_Delete(root);
 
-    int ret = aigw_ws_send_request(ctx, json_str);
+    int ret = aigw_ws_enqueue(ctx, json_str, true);
     if (json_str) {
         free(json_str);
     }
@@ -614,30 +939,42 @@ int aigw_ws_input_audio_done(aigw_ws_ctx_t* ctx) {
     return ret;
 }
 
-int aigw_ws_conversation_item_create(aigw_ws_ctx_t* ctx, char* func_call_id) {
-    // 创建根 JSON 对象
-    cJSON* root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "type", "conversation_item.create");
-    // 创建 "item" 对象
-    cJSON* item_obj = cJSON_CreateObject();
-    cJSON_AddItemToObject(root, "item", item_obj);
-    // 添加 "call_id" 字段
-    cJSON_AddStringToObject(item_obj, "call_id", func_call_id);
-    cJSON_AddStringToObject(item_obj, "type", "function_call_output");
-    // 创建 "output" 对象
-    cJSON* output_obj = cJSON_CreateObject();
-    cJSON_AddItemToObject(item_obj, "output", output_obj);
-    // 添加 "output_type" 字段
-    cJSON_AddStringToObject(output_obj, "result", "打开成功");
-    // 生成 JSON 字符串
-    const char* json_str = cJSON_PrintUnformatted(root);
-    // 释放内存
-    cJSON_Delete(root);
-    int ret = aigw_ws_send_request(ctx, json_str);
-    free((void*)json_str);
+int aigw_ws_function_output_to_json(const char* call_id, const char* output_json, struct aws_byte_buf* out) {
+    if (!call_id || !out || (output_json && !session_json_valid(output_json))) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    json_writer_t w;
+    json_writer_init(&w, out);
+    json_writer_begin_object(&w);
+    json_writer_kv_string(&w, "type", "conversation_item.create");
+    json_writer_key(&w, "item");
+    json_writer_begin_object(&w);
+    json_writer_kv_string(&w, "call_id", call_id);
+    json_writer_kv_string(&w, "type", "function_call_output");
+    json_writer_kv_raw(&w, "output", output_json ? output_json : "{}");
+    json_writer_end_object(&w);
+    json_writer_end_object(&w);
+    return json_writer_finish(&w);
+}
+
+int aigw_ws_conversation_item_create_function_output(aigw_ws_ctx_t* ctx, const char* call_id,
+                                                     const char* output_json) {
+    struct aws_byte_buf buf;
+    if (aws_byte_buf_init(&buf, aws_alloc(), 256) != AWS_OP_SUCCESS) {
+        return VOLC_ERR_MALLOC;
+    }
+    int ret = aigw_ws_function_output_to_json(call_id, output_json, &buf);
+    if (ret == VOLC_OK) {
+        ret = aigw_ws_send_request(ctx, (const char *)buf.buffer);
+    }
+    aws_byte_buf_clean_up(&buf);
     return ret;
 }
 
+int aigw_ws_conversation_item_create(aigw_ws_ctx_t* ctx, char* func_call_id) {
+    return aigw_ws_conversation_item_create_function_output(ctx, func_call_id, "{\"result\":\"打开成功\"}");
+}
+
 int aigw_ws_response_create(aigw_ws_ctx_t* ctx) {
     // 创建根 JSON 对象
     cJSON* root = cJSON_CreateObject();
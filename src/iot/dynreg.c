@@ -158,13 +158,18 @@ int dynamic_register(iot_basic_ctx_t *ctx) {
     return ret;
 }
 
+int iot_hmac_sign_content(char *buf, size_t size, const struct iot_dynamic_register_basic_param *registerBasicParam)
+{
+    return snprintf(buf, size, "auth_type=%" PRId32 "&device_name=%s&random_num=%" PRId32 "&product_key=%s&timestamp=%" PRIu64,
+            (int32_t)registerBasicParam->auth_type, registerBasicParam->device_name, (int32_t)registerBasicParam->random_num,
+            registerBasicParam->product_key, (uint64_t)registerBasicParam->timestamp);
+}
+
 struct aws_string *iot_hmac_sha256_encrypt(struct aws_allocator *allocator,
                                                    const struct iot_dynamic_register_basic_param *registerBasicParam, const char *secret)
 {
     char inputStr[256] = {0};
-    sprintf(inputStr, "auth_type=%" PRId32 "&device_name=%s&random_num=%" PRId32 "&product_key=%s&timestamp=%" PRIu64,
-            (int32_t)registerBasicParam->auth_type, registerBasicParam->device_name, (int32_t)registerBasicParam->random_num,
-            registerBasicParam->product_key, (uint64_t)registerBasicParam->timestamp);
+    iot_hmac_sign_content(inputStr, sizeof(inputStr), registerBasicParam);
 
     struct aws_byte_cursor secretBuff = aws_byte_cursor_from_c_str(secret);
     struct aws_byte_cursor inputBuff = aws_byte_cursor_from_c_str(inputStr);
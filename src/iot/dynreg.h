@@ -54,6 +54,12 @@ typedef struct iot_dynamic_register_basic_param {
     onesdk_auth_type_t auth_type;
 } iot_dynamic_register_basic_param_t;
 
+/**
+ * @brief 拼接签名原文 auth_type=..&device_name=..&random_num=..&product_key=..&timestamp=..
+ * @return 写入长度，buf不足时返回值>=size
+ */
+int iot_hmac_sign_content(char *buf, size_t size, const struct iot_dynamic_register_basic_param *registerBasicParam);
+
 struct aws_string *iot_hmac_sha256_encrypt(struct aws_allocator *allocator,
     const struct iot_dynamic_register_basic_param *registerBasicParam, const char *secret);
 
@@ -0,0 +1,114 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "onesdk_config.h"
+#ifdef ONESDK_ENABLE_IOT
+
+#include <string.h>
+
+#include "iot/iot_latency_hist.h"
+
+#define _SUB_COUNT (1u << IOT_LATENCY_HIST_SUB_BITS)
+
+static int _msb(uint32_t v) {
+    int n = 0;
+    while (v >>= 1) {
+        n++;
+    }
+    return n;
+}
+
+// 小于2*_SUB_COUNT的值每格1us；之后第b段（b>=1）每格2^b us，段内仍是_SUB_COUNT格
+static uint32_t _bucket_index(uint32_t v) {
+    if (v < 2 * _SUB_COUNT) {
+        return v;
+    }
+    uint32_t shift = (uint32_t) (_msb(v) - IOT_LATENCY_HIST_SUB_BITS);
+    return shift * _SUB_COUNT + (v >> shift);
+}
+
+// 格内的最大值
+static uint32_t _bucket_upper(uint32_t index) {
+    if (index < 2 * _SUB_COUNT) {
+        return index;
+    }
+    uint32_t shift = index / _SUB_COUNT - 1;
+    uint64_t lower = (uint64_t) (index - shift * _SUB_COUNT) << shift;
+    uint64_t upper = lower + ((uint64_t) 1 << shift) - 1;
+    return upper > UINT32_MAX ? UINT32_MAX : (uint32_t) upper;
+}
+
+void iot_latency_hist_reset(iot_latency_hist_t *hist) {
+    if (hist == NULL) {
+        return;
+    }
+    memset(hist, 0, sizeof(iot_latency_hist_t));
+    hist->min_us = UINT32_MAX;
+}
+
+void iot_latency_hist_record(iot_latency_hist_t *hist, uint64_t value_us) {
+    if (hist == NULL) {
+        return;
+    }
+    uint32_t v = value_us > UINT32_MAX ? UINT32_MAX : (uint32_t) value_us;
+    uint32_t index = _bucket_index(v);
+    if (hist->counts[index] < UINT32_MAX) {
+        hist->counts[index]++;
+    }
+    hist->total++;
+    hist->sum_us += v;
+    if (v < hist->min_us) {
+        hist->min_us = v;
+    }
+    if (v > hist->max_us) {
+        hist->max_us = v;
+    }
+}
+
+uint32_t iot_latency_hist_percentile(const iot_latency_hist_t *hist, double percentile) {
+    if (hist == NULL || hist->total == 0) {
+        return 0;
+    }
+    if (percentile < 0) {
+        percentile = 0;
+    } else if (percentile > 100) {
+        percentile = 100;
+    }
+    // 第rank个样本（从1计）所在的格，rank至少为1
+    uint64_t rank = (uint64_t) (percentile / 100.0 * (double) hist->total + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    } else if (rank > hist->total) {
+        rank = hist->total;
+    }
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < IOT_LATENCY_HIST_BUCKETS; i++) {
+        seen += hist->counts[i];
+        if (seen >= rank) {
+            // 上界不超过实际记录到的最大值
+            uint32_t upper = _bucket_upper(i);
+            return upper > hist->max_us ? hist->max_us : upper;
+        }
+    }
+    return hist->max_us;
+}
+
+uint32_t iot_latency_hist_mean(const iot_latency_hist_t *hist) {
+    if (hist == NULL || hist->total == 0) {
+        return 0;
+    }
+    return (uint32_t) (hist->sum_us / hist->total);
+}
+
+#endif //ONESDK_ENABLE_IOT
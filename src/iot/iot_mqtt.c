@@ -17,6 +17,11 @@
 #ifdef ONESDK_ENABLE_IOT
 
 #include <stdlib.h>
+#if defined(__linux__)
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
 #include "aws/common/byte_buf.h"
 #include "aws/common/encoding.h"
 
@@ -26,6 +31,279 @@
 #include "iot_mqtt.h"
 #include "libwebsockets.h"
 #include "error_code.h"
+#include "platform_compat.h"
+
+// 按发送顺序带DUP重发，packet_id保持不变
+static void _iot_mqtt_resend_inflight(iot_mqtt_ctx_t *ctx, struct lws *wsi) {
+    for (struct lws_dll2 *d = lws_dll2_get_head(&ctx->pub_queue.inflight); d; d = d->next) {
+        iot_mqtt_msg_t *msg = lws_container_of(d, iot_mqtt_msg_t, list);
+        if (!msg->resend) {
+            continue;
+        }
+        msg->pub.dup = 1;
+        if (lws_mqtt_client_send_publish(wsi, &msg->pub,
+            msg->pub.payload, msg->pub.payload_len, true)) {
+            lwsl_err("%s: resend packet id %u failed\n", __func__, msg->pub.packet_id);
+            return;
+        }
+        msg->resend = false;
+    }
+}
+
+static void _iot_mqtt_dispatch(void *value, void *userdata) {
+    iot_mqtt_topic_map_t *sub = (iot_mqtt_topic_map_t *)value;
+    lws_mqtt_publish_param_t *pub = (lws_mqtt_publish_param_t *)userdata;
+    sub->message_callback(pub->topic, pub->payload, pub->payload_len, sub->user_data);
+}
+
+static void _iot_mqtt_free_sub(void *value, void *userdata) {
+    iot_mqtt_topic_map_t *sub = (iot_mqtt_topic_map_t *)value;
+    free((void *)sub->topic);
+    free(sub);
+}
+
+// 消息送达后归还，来自离线缓存的同时标记为已送达
+static void _iot_mqtt_msg_done(iot_mqtt_ctx_t *ctx, iot_mqtt_msg_t *msg) {
+    if (msg != NULL && msg->spool_seq != 0 && ctx->spool != NULL) {
+        iot_mqtt_spool_consume(ctx->spool, msg->spool_seq);
+    }
+    iot_mqtt_pub_queue_release(&ctx->pub_queue, msg);
+}
+
+// 按drain_rate把离线缓存转入发送队列，调用方持有pub_topic_mutex
+static void _iot_mqtt_drain_spool(iot_mqtt_ctx_t *ctx, struct lws *wsi) {
+    if (ctx->spool == NULL) {
+        return;
+    }
+    uint16_t rate = ctx->spool->config.drain_rate;
+    lws_usec_t now = lws_now_usecs();
+    if (now - ctx->drain_window_us >= LWS_US_PER_SEC) {
+        ctx->drain_window_us = now;
+        ctx->drained_in_window = 0;
+    }
+    while (iot_mqtt_spool_pending(ctx->spool) > 0 && ctx->pub_queue.free.count > 0) {
+        if (rate > 0 && ctx->drained_in_window >= rate) {
+            // 本窗口额度用完，定时器到期后继续
+            lws_set_timer_usecs(wsi, ctx->drain_window_us + LWS_US_PER_SEC - now);
+            return;
+        }
+        uint32_t seq;
+        const char *topic;
+        const uint8_t *payload;
+        size_t len;
+        int qos;
+        iot_mqtt_msg_t *msg = NULL;
+        if (iot_mqtt_spool_next(ctx->spool, &seq, &topic, &payload, &len, &qos) != VOLC_OK) {
+            return;
+        }
+        if (iot_mqtt_pub_queue_alloc(&ctx->pub_queue, topic, payload, len, qos, &msg) != VOLC_OK) {
+            // 放不进发送队列时退回游标，下次可写时重新补发，不丢消息
+            iot_mqtt_spool_unget(ctx->spool, seq);
+            return;
+        }
+        msg->spool_seq = seq;
+        iot_mqtt_pub_queue_push(&ctx->pub_queue, msg);
+        ctx->drained_in_window++;
+    }
+}
+
+// 配置的时限，RTT样本足够时不小于由RTT p99得到的下限
+static uint16_t _iot_mqtt_pingresp_timeout(iot_mqtt_ctx_t *ctx) {
+    uint16_t timeout_s = ctx->config->pingresp_timeout_s > 0 ?
+        ctx->config->pingresp_timeout_s : IOT_MQTT_DEFAULT_PINGRESP_TIMEOUT_S;
+    return ctx->rtt_pingresp_timeout_s > timeout_s ? ctx->rtt_pingresp_timeout_s : timeout_s;
+}
+
+// PINGREQ在链路空闲interval_s秒后发出，再过pingresp_timeout_s仍未收到PINGRESP时lws断开连接
+void iot_mqtt_apply_ping_interval(iot_mqtt_ctx_t *ctx, uint16_t interval_s) {
+    uint16_t timeout_s = _iot_mqtt_pingresp_timeout(ctx);
+    ctx->ping_interval_s = interval_s;
+    ctx->retry.secs_since_valid_ping = interval_s;
+    ctx->retry.secs_since_valid_hangup = (uint16_t)(interval_s + timeout_s);
+}
+
+// 收到broker的报文，链路可用
+void iot_mqtt_on_broker_rx(iot_mqtt_ctx_t *ctx, int64_t now_us) {
+    ctx->last_rx_us = now_us;
+    ctx->link_suspect = false;
+}
+
+// 每个ping间隔调整一次：期间收到过broker报文时间隔加倍，空闲时回到ping_interval
+void iot_mqtt_adapt_ping_interval(iot_mqtt_ctx_t *ctx, int64_t now_us) {
+    uint16_t base = ctx->config->ping_interval > UINT16_MAX ? UINT16_MAX : (uint16_t)ctx->config->ping_interval;
+    uint16_t max = ctx->config->ping_interval_max_s;
+    // 超过keep_alive不发报文会被broker断开
+    if (ctx->config->keep_alive > 0 && max > ctx->config->keep_alive) {
+        max = ctx->config->keep_alive;
+    }
+    if (max <= base) {
+        return;
+    }
+    if (now_us - ctx->ping_adapted_us < (int64_t)ctx->ping_interval_s * LWS_US_PER_SEC) {
+        return;
+    }
+    uint32_t next = ctx->last_rx_us > ctx->ping_adapted_us ? (uint32_t)ctx->ping_interval_s * 2 : base;
+    if (next > max) {
+        next = max;
+    }
+    ctx->ping_adapted_us = now_us;
+    if (next != ctx->ping_interval_s) {
+        lwsl_info("%s: ping interval %u -> %u s\n", __func__, ctx->ping_interval_s, (unsigned)next);
+        iot_mqtt_apply_ping_interval(ctx, (uint16_t)next);
+    }
+}
+
+static void _iot_mqtt_set_socket_options(iot_mqtt_ctx_t *ctx, struct lws *wsi) {
+#if defined(TCP_USER_TIMEOUT)
+    if (ctx->config->tcp_user_timeout_ms == 0) {
+        return;
+    }
+    // MQTT连接挂在网络连接之下，socket属于网络连接
+    struct lws *nwsi = lws_get_network_wsi(wsi);
+    lws_sockfd_type fd = lws_get_socket_fd(nwsi != NULL ? nwsi : wsi);
+    unsigned int timeout_ms = ctx->config->tcp_user_timeout_ms;
+    if (fd < 0 || setsockopt(fd, IPPROTO_TCP, TCP_USER_TIMEOUT, &timeout_ms, sizeof(timeout_ms)) != 0) {
+        lwsl_warn("%s: set TCP_USER_TIMEOUT failed\n", __func__);
+    }
+#else
+    (void)ctx;
+    (void)wsi;
+#endif
+}
+
+static void _iot_mqtt_link_suspect(iot_mqtt_ctx_t *ctx, iot_mqtt_link_suspect_reason_t reason) {
+    lwsl_warn("%s: link suspect, reason %d, last rx %lld ms ago\n", __func__, reason,
+        (long long)((lws_now_usecs() - ctx->last_rx_us) / 1000));
+    if (ctx->link_suspect_cb != NULL) {
+        ctx->link_suspect_cb(reason, ctx->link_suspect_user_data);
+    }
+}
+
+// PUBACK超时，每次链路恢复后只上报一次
+void iot_mqtt_on_puback_timeout(iot_mqtt_ctx_t *ctx) {
+    if (!ctx->link_suspect) {
+        ctx->link_suspect = true;
+        _iot_mqtt_link_suspect(ctx, IOT_MQTT_LINK_PUBACK_TIMEOUT);
+    }
+}
+
+// 连接关闭，已建立的连接非主动断开时上报
+void iot_mqtt_on_link_closed(iot_mqtt_ctx_t *ctx) {
+    if (ctx->is_connected) {
+        _iot_mqtt_link_suspect(ctx, IOT_MQTT_LINK_LOST);
+    }
+    ctx->is_connected = false;
+}
+
+// 调用方持有sub_topic_mutex
+static int _iot_mqtt_append_sub_topic(iot_mqtt_ctx_t *ctx, iot_mqtt_topic_map_t *topic_map) {
+    // 将topic_map存入待订阅列表
+    if (ctx->pending_sub_list == NULL) {
+        ctx->pending_sub_list = (iot_mqtt_pending_sub_list_t *)malloc(sizeof(iot_mqtt_pending_sub_list_t));
+        if (ctx->pending_sub_list == NULL) {
+            return VOLC_ERR_MALLOC;
+        }
+        ctx->pending_sub_list->topic_maps = NULL;
+        ctx->pending_sub_list->count = 0;
+    }
+    // copy topic_map
+    iot_mqtt_topic_map_t topic_map_copy;
+    memset(&topic_map_copy, 0, sizeof(iot_mqtt_topic_map_t));
+    topic_map_copy.topic = strdup(topic_map->topic);
+    if (topic_map_copy.topic == NULL) {
+        return VOLC_ERR_MALLOC;
+    }
+    topic_map_copy.message_callback = topic_map->message_callback;
+    topic_map_copy.event_callback = topic_map->event_callback;
+    topic_map_copy.user_data = topic_map->user_data;
+    topic_map_copy.qos = topic_map->qos;
+
+    iot_mqtt_topic_map_t *new_maps = (iot_mqtt_topic_map_t *)realloc(ctx->pending_sub_list->topic_maps, (ctx->pending_sub_list->count + 1) * sizeof(iot_mqtt_topic_map_t));
+    if (new_maps == NULL) {
+        free((void*)topic_map_copy.topic);
+        return VOLC_ERR_MALLOC;
+    }
+    ctx->pending_sub_list->topic_maps = new_maps;
+    ctx->pending_sub_list->topic_maps[ctx->pending_sub_list->count] = topic_map_copy;
+    ctx->pending_sub_list->count++;
+    return VOLC_OK;
+}
+
+static void _iot_mqtt_resubscribe(void *value, void *userdata) {
+    (void)_iot_mqtt_append_sub_topic((iot_mqtt_ctx_t *)userdata, (iot_mqtt_topic_map_t *)value);
+}
+
+// 按topic数与包大小上限确定本批订阅数，单个超长的topic单独成批，由lws校验
+size_t iot_mqtt_sub_batch_size(const iot_mqtt_pending_sub_list_t *list, uint32_t max_bytes) {
+    uint32_t bytes = 5 + 2; // 固定头（剩余长度最多4字节）与packet id
+    size_t n = 0;
+    while (n < list->count && n < IOT_MQTT_MAX_TOPICS_PER_SUBSCRIBE) {
+        uint32_t topic_bytes = 2 + (uint32_t)strlen(list->topic_maps[n].topic) + 1; // 长度前缀、topic与QoS
+        if (n > 0 && bytes + topic_bytes > max_bytes) {
+            break;
+        }
+        bytes += topic_bytes;
+        n++;
+    }
+    return n;
+}
+
+// 发出一批待订阅topic；调用方持有sub_topic_mutex
+static void _iot_mqtt_send_sub_batch(iot_mqtt_ctx_t *ctx, struct lws *wsi) {
+    iot_mqtt_pending_sub_list_t *list = ctx->pending_sub_list;
+    uint32_t max_bytes = ctx->config->sub_packet_max_bytes > 0 ?
+        ctx->config->sub_packet_max_bytes : IOT_MQTT_DEFAULT_SUB_PACKET_MAX_BYTES;
+    size_t num_to_subscribe = iot_mqtt_sub_batch_size(list, max_bytes);
+    lws_mqtt_topic_elem_t topics[IOT_MQTT_MAX_TOPICS_PER_SUBSCRIBE];
+
+    memset(topics, 0, sizeof(topics));
+    for (size_t i = 0; i < num_to_subscribe; i++) {
+        topics[i].name = list->topic_maps[i].topic;
+        topics[i].qos = list->topic_maps[i].qos;
+    }
+    lws_mqtt_subscribe_param_t sub_param = {
+        .topic = topics,
+        .num_topics = num_to_subscribe,
+    };
+    if (lws_mqtt_client_send_subcribe(wsi, &sub_param)) {
+        // 不返回错误以免断开连接，下次可写时重试
+        lwsl_err("%s: subscribe failed\n", __func__);
+        return;
+    }
+    ctx->subacks_pending++;
+
+    // 将已发出订阅请求的topic移入sub_topics
+    for (size_t i = 0; i < num_to_subscribe; i++) {
+        iot_mqtt_topic_map_t *topic_map = &list->topic_maps[i];
+
+        // 已订阅过的topic（如重连后重新订阅）不重复添加
+        if (iot_mqtt_topic_trie_find(&ctx->sub_topics, topic_map->topic) != NULL) {
+            free((void *)topic_map->topic);
+            continue;
+        }
+
+        // strdup 在 _iot_mqtt_append_sub_topic 中已经完成，这里直接转移所有权
+        iot_mqtt_topic_map_t *sub = (iot_mqtt_topic_map_t *)malloc(sizeof(iot_mqtt_topic_map_t));
+        if (sub == NULL || iot_mqtt_topic_trie_insert(&ctx->sub_topics, topic_map->topic, sub) != VOLC_OK) {
+            lwsl_err("%s: add '%s' to sub_topics failed\n", __func__, topic_map->topic);
+            free(sub);
+            free((void *)topic_map->topic);
+            continue;
+        }
+        *sub = *topic_map;
+    }
+
+    // 从待订阅列表中移除已发出的topic
+    list->count -= num_to_subscribe;
+    if (list->count > 0) {
+        memmove(list->topic_maps, &list->topic_maps[num_to_subscribe],
+                list->count * sizeof(iot_mqtt_topic_map_t));
+    } else {
+        free(list->topic_maps);
+        free(list);
+        ctx->pending_sub_list = NULL;
+    }
+}
 
 static int callback_mqtt(struct lws *wsi, enum lws_callback_reasons reason,
         void *user, void *in, size_t len)
@@ -49,7 +327,7 @@ static int callback_mqtt(struct lws *wsi, enum lws_callback_reasons reason,
 
     case LWS_CALLBACK_MQTT_CLIENT_CLOSED:
         lwsl_err("%s: CLIENT_CLOSED\n", __func__);
-        ctx->is_connected = false;
+        iot_mqtt_on_link_closed(ctx);
         if (ctx->config->auto_reconnect) {
             iot_mqtt_reconnect(ctx);
         }
@@ -58,19 +336,48 @@ static int callback_mqtt(struct lws *wsi, enum lws_callback_reasons reason,
     case LWS_CALLBACK_MQTT_CLIENT_ESTABLISHED:
         lwsl_info("%s: MQTT_CLIENT_ESTABLISHED\n", __func__);
         ctx->is_connected = true;
-        ctx->waiting_for_puback = 0;
-        ctx->waiting_for_suback = 0;
+        ctx->connections++;
+        ctx->subacks_pending = 0;
+        ctx->established_us = lws_now_usecs();
+        iot_mqtt_on_broker_rx(ctx, ctx->established_us);
+        ctx->ping_adapted_us = ctx->established_us;
+        // RTT按连接统计，重连后的链路可能完全不同
+        lws_pthread_mutex_lock(&ctx->rtt_mutex);
+        iot_latency_hist_reset(ctx->rtt_hist);
+        ctx->srtt_us = 0;
+        ctx->rtt_lost = 0;
+        ctx->rtt_pingresp_timeout_s = 0;
+        lws_pthread_mutex_unlock(&ctx->rtt_mutex);
+        iot_mqtt_apply_ping_interval(ctx, ctx->config->ping_interval > UINT16_MAX ?
+            UINT16_MAX : (uint16_t)ctx->config->ping_interval);
+        _iot_mqtt_set_socket_options(ctx, wsi);
+        // lws 4.3不上报CONNACK的session present标志，broker切换、重启或会话过期后订阅可能已丢失，
+        // 每次连接建立都重新订阅全部topic；会话仍在时broker按MQTT 3.1.1 3.8.4替换原订阅，不会重复
+        lws_pthread_mutex_lock(&ctx->sub_topic_mutex);
+        iot_mqtt_topic_trie_foreach(&ctx->sub_topics, _iot_mqtt_resubscribe, ctx);
+        lws_pthread_mutex_unlock(&ctx->sub_topic_mutex);
+        lws_pthread_mutex_lock(&ctx->pub_topic_mutex);
+        iot_mqtt_pub_queue_mark_resend(&ctx->pub_queue);
+        lws_pthread_mutex_unlock(&ctx->pub_topic_mutex);
         lws_callback_on_writable(wsi);
-        lws_set_timer_usecs(wsi, ctx->config->ping_interval*1000000);
+        lws_set_timer_usecs(wsi, (lws_usec_t)ctx->ping_interval_s * LWS_US_PER_SEC);
         
         return 0;
 
     case LWS_CALLBACK_MQTT_SUBSCRIBED:
         lwsl_info("%s: MQTT_SUBSCRIBED\n", __func__);
-        ctx->waiting_for_suback = 0;
+        iot_mqtt_on_broker_rx(ctx, lws_now_usecs());
         // 检查是否还有待处理的订阅
         lws_pthread_mutex_lock(&ctx->sub_topic_mutex);
+        if (ctx->subacks_pending > 0) {
+            ctx->subacks_pending--;
+        }
         bool has_pending_subs = (ctx->pending_sub_list != NULL && ctx->pending_sub_list->count > 0);
+        if (!has_pending_subs && ctx->subacks_pending == 0 && ctx->established_us != 0) {
+            lwsl_notice("%s: %zu topics subscribed, ready %lld ms after connect\n", __func__,
+                ctx->sub_topics.count, (long long)((lws_now_usecs() - ctx->established_us) / 1000));
+            ctx->established_us = 0;
+        }
         lws_pthread_mutex_unlock(&ctx->sub_topic_mutex);
 
         if (has_pending_subs) {
@@ -78,7 +385,8 @@ static int callback_mqtt(struct lws *wsi, enum lws_callback_reasons reason,
         }
 
         lws_pthread_mutex_lock(&ctx->pub_topic_mutex);
-        bool has_pending_pubs = (ctx->pending_pub_list != NULL && ctx->pending_pub_list->count > 0);
+        bool has_pending_pubs = ctx->pub_queue.pending.count > 0 ||
+            (ctx->spool != NULL && iot_mqtt_spool_pending(ctx->spool) > 0);
         lws_pthread_mutex_unlock(&ctx->pub_topic_mutex);
         if (has_pending_pubs) {
             lws_callback_on_writable(wsi);
@@ -89,188 +397,55 @@ static int callback_mqtt(struct lws *wsi, enum lws_callback_reasons reason,
     case LWS_CALLBACK_MQTT_CLIENT_WRITEABLE:
         lwsl_info("%s: MQTT_CLIENT_WRITEABLE\n", __func__);
         
-        // 处理待订阅列表
+        // 处理待订阅列表，最多IOT_MQTT_MAX_INFLIGHT_SUBS个SUBSCRIBE包同时等待SUBACK
         if (!ctx) break;
-        if (ctx->waiting_for_suback) break;
-            
         lws_pthread_mutex_lock(&ctx->sub_topic_mutex);
         if (ctx->pending_sub_list != NULL && ctx->pending_sub_list->count > 0) {
-            // 确定本次订阅的数量，最多8个
-            size_t num_to_subscribe = ctx->pending_sub_list->count > 7 ? 7 : ctx->pending_sub_list->count;
-
-            lws_mqtt_topic_elem_t *topics = (lws_mqtt_topic_elem_t *)malloc(
-                num_to_subscribe * sizeof(lws_mqtt_topic_elem_t));
-            if (topics == NULL) {
-                lws_pthread_mutex_unlock(&ctx->sub_topic_mutex);
-                return VOLC_ERR_MALLOC;
-            }
-            memset(topics, 0, num_to_subscribe * sizeof(lws_mqtt_topic_elem_t));
-            // 填充本次要订阅的topic
-            for (size_t i = 0; i < num_to_subscribe; i++) {
-                topics[i].name = ctx->pending_sub_list->topic_maps[i].topic;
-                topics[i].qos = ctx->pending_sub_list->topic_maps[i].qos;
-            }
-            lws_mqtt_subscribe_param_t sub_param = {
-                .topic = topics,
-                .num_topics = num_to_subscribe,
-            };
-            // 发送订阅请求
-            if (lws_mqtt_client_send_subcribe(wsi, &sub_param)) {
-                lwsl_err("%s: subscribe failed\n", __func__);
-                free(topics);
+            if (ctx->subacks_pending >= IOT_MQTT_MAX_INFLIGHT_SUBS) {
+                // 等待SUBACK后再继续订阅，发布也排在订阅之后
                 lws_pthread_mutex_unlock(&ctx->sub_topic_mutex);
-                // 返回错误可能导致连接断开，这里可以选择不返回错误，下次重试
-                // return VOLC_ERR_MQTT_SUB; // 或者其他合适的错误码
-                return 0; // 暂时不返回错误，允许后续操作
-            }
-            // 释放临时的topic_elem_t数组
-            free(topics);
-
-            ctx->waiting_for_suback = 1; 
-
-            // 将成功发送订阅请求的topic移入sub_topic_maps
-            for (size_t i = 0; i < num_to_subscribe; i++) {
-                iot_mqtt_topic_map_t *topic_map = &ctx->pending_sub_list->topic_maps[i];
-                
-                // 检查是否已存在于 sub_topic_maps
-                bool is_duplicate = false;
-                for (size_t j = 0; j < ctx->sub_topic_count; j++) {
-                    // 使用 strcmp 进行精确匹配
-                    if (!strcmp(topic_map->topic, ctx->sub_topic_maps[j].topic)) {
-                        lwsl_notice("%s: topic '%s' already subscribed, skipping add to sub_topic_maps\n", __func__, topic_map->topic);
-                        is_duplicate = true;
-                        break;
-                    }
-                }
-                // 如果是重复的，则释放待处理列表中的 topic 内存并跳过
-                if (is_duplicate) {
-                    free((void*)topic_map->topic); // 释放重复 topic 的内存
-                    topic_map->topic = NULL;
-                    continue;
-                }
-
-                // 扩容 sub_topic_maps 数组
-                iot_mqtt_topic_map_t *new_sub_topic_maps = (iot_mqtt_topic_map_t *)realloc(ctx->sub_topic_maps, 
-                    (ctx->sub_topic_count + 1) * sizeof(iot_mqtt_topic_map_t));
-                if (new_sub_topic_maps == NULL) {
-                    // realloc 失败，保留原有 sub_topic_maps
-                    lwsl_err("%s: realloc sub_topic_maps failed\\n", __func__);
-                    // 释放当前 topic_map 的 topic 内存，因为它无法被添加
-                    free((void*)topic_map->topic);
-                    topic_map->topic = NULL;
-                    // 这里不直接返回错误，允许处理剩余的 topic，但记录下内存问题
-                    continue; // 继续处理下一个 topic
-                }
-                ctx->sub_topic_maps = new_sub_topic_maps;
-
-                // 添加新的订阅信息到 sub_topic_maps
-                // 注意：strdup 在 _iot_mqtt_append_sub_topic 中已经完成，这里直接转移所有权
-                ctx->sub_topic_maps[ctx->sub_topic_count].topic = topic_map->topic; // 直接使用已分配的内存
-                ctx->sub_topic_maps[ctx->sub_topic_count].message_callback = topic_map->message_callback;
-                ctx->sub_topic_maps[ctx->sub_topic_count].event_callback = topic_map->event_callback;
-                ctx->sub_topic_maps[ctx->sub_topic_count].user_data = topic_map->user_data;
-                ctx->sub_topic_maps[ctx->sub_topic_count].qos = topic_map->qos; // 保存 qos
-                ctx->sub_topic_count++;
-            }
-
-            // 从 pending_sub_list 中移除已处理的 topic
-            size_t remaining_count = ctx->pending_sub_list->count - num_to_subscribe;
-            if (remaining_count > 0) {
-                // 将未处理的 topic 向前移动
-                memmove(ctx->pending_sub_list->topic_maps, 
-                        &ctx->pending_sub_list->topic_maps[num_to_subscribe], 
-                        remaining_count * sizeof(iot_mqtt_topic_map_t));
-                
-                // 重新分配内存以缩小数组
-                iot_mqtt_topic_map_t *shrunk_maps = (iot_mqtt_topic_map_t *)realloc(ctx->pending_sub_list->topic_maps, 
-                                                                remaining_count * sizeof(iot_mqtt_topic_map_t));
-                // 如果 realloc 成功或 remaining_count 为 0（此时 shrunk_maps 可能为 NULL），则更新指针
-                if (shrunk_maps != NULL || remaining_count == 0) {
-                     ctx->pending_sub_list->topic_maps = shrunk_maps;
-                } else {
-                    // realloc 失败，保留原有内存块，但 count 已更新
-                    lwsl_warn("%s: realloc pending_sub_list->topic_maps failed, potential memory leak\n", __func__);
-                }
-            } else {
-                // 所有 topic 都已处理，释放整个列表
-                free(ctx->pending_sub_list->topic_maps);
-                free(ctx->pending_sub_list);
-                ctx->pending_sub_list = NULL;
+                break;
             }
-
-            // 更新待处理列表计数
-            if (ctx->pending_sub_list) {
-                ctx->pending_sub_list->count = remaining_count;
-                // 如果还有待处理的订阅，请求再次变为可写状态
-                if (remaining_count > 0) {
-                    lws_callback_on_writable(wsi);
-                }
+            _iot_mqtt_send_sub_batch(ctx, wsi);
+            if (ctx->pending_sub_list != NULL && ctx->subacks_pending < IOT_MQTT_MAX_INFLIGHT_SUBS) {
+                lws_callback_on_writable(wsi);
             }
-
             lws_pthread_mutex_unlock(&ctx->sub_topic_mutex);
             return 0; // 一次只能处理一类事件，否则收到包id会被跳过。
         }
         lws_pthread_mutex_unlock(&ctx->sub_topic_mutex);
 
         lws_pthread_mutex_lock(&ctx->pub_topic_mutex);
-        // 处理待发布列表
-        if (ctx->pending_pub_list != NULL && !ctx->waiting_for_puback) {
-            size_t i;
-            for (i = 0; i < ctx->pending_pub_list->count; i++) {
-                if (ctx->pending_pub_list->sent_list[i]) continue; // 跳过已发送的消息
-
-                lwsl_debug("%s: publish start\n", __func__);
-                lws_mqtt_publish_param_t *pub_param = &ctx->pending_pub_list->publish_params[i];
-                if (pub_param->qos == QOS0) {
-                    // 直接发送QOS0消息
-                    if (lws_mqtt_client_send_publish(wsi, pub_param, 
-                        pub_param->payload, pub_param->payload_len, true)) {
-                        lwsl_err("%s: publish failed\n", __func__);
-                    } else {
-                        ctx->pending_pub_list->sent_list[i] = 1; // 标记为已发送
-                    }
-                } else if (pub_param->qos == QOS1) {
-                    // 发送QOS1消息
-                    if (lws_mqtt_client_send_publish(wsi, pub_param,
-                        pub_param->payload, pub_param->payload_len, true)) {
-                        lwsl_err("%s: publish failed\n", __func__);
-                    } else {
-                        ctx->waiting_for_puback = 1;
-                        ctx->pending_pub_list->sent_list[i] = 1; // 标记为已发送
-                        break; // 一次只发送一个QoS1消息
-                    }
+        // 先重发未确认的在途消息，保持发送顺序
+        _iot_mqtt_resend_inflight(ctx, wsi);
+        _iot_mqtt_drain_spool(ctx, wsi);
+        // 处理待发布队列
+        iot_mqtt_msg_t *msg;
+        while ((msg = iot_mqtt_pub_queue_peek(&ctx->pub_queue)) != NULL) {
+            lwsl_debug("%s: publish start\n", __func__);
+            if (msg->pub.qos == QOS0) {
+                // 直接发送QOS0消息
+                ctx->sending_qos0 = true;
+                int rc = lws_mqtt_client_send_publish(wsi, &msg->pub,
+                    msg->pub.payload, msg->pub.payload_len, true);
+                ctx->sending_qos0 = false;
+                if (rc) {
+                    lwsl_err("%s: publish failed\n", __func__);
+                    break;
                 }
-            }
-            // Clean up sent QoS0 messages and compact the list
-            if (ctx->pending_pub_list) {
-                size_t new_count = 0;
-                for (i = 0; i < ctx->pending_pub_list->count; i++) {
-                    bool is_sent_qos0 = ctx->pending_pub_list->sent_list[i] &&
-                                        (ctx->pending_pub_list->publish_params[i].qos == QOS0);
-
-                    if (is_sent_qos0) {
-                        // Free resources for this sent QoS0 message
-                        free((void *)ctx->pending_pub_list->publish_params[i].topic);
-                        free((void *)ctx->pending_pub_list->publish_params[i].payload);
-                    } else {
-                        // Keep this message (either unsent or in-flight QoS1)
-                        if (new_count != i) {
-                            ctx->pending_pub_list->publish_params[new_count] = ctx->pending_pub_list->publish_params[i];
-                            ctx->pending_pub_list->sent_list[new_count] = ctx->pending_pub_list->sent_list[i];
-                        }
-                        new_count++;
-                    }
+                lws_dll2_remove(&msg->list);
+                _iot_mqtt_msg_done(ctx, msg);
+            } else {
+                if (iot_mqtt_pub_queue_window_full(&ctx->pub_queue)) {
+                    break; // 窗口已满，等待PUBACK，后续消息保持顺序
                 }
-
-                if (new_count < ctx->pending_pub_list->count) {
-                    ctx->pending_pub_list->count = new_count;
-                    if (ctx->pending_pub_list->count == 0) {
-                        free(ctx->pending_pub_list->publish_params);
-                        free(ctx->pending_pub_list->sent_list);
-                        free(ctx->pending_pub_list);
-                        ctx->pending_pub_list = NULL;
-                    }
+                // 发送QOS1消息，packet_id由lws分配并回写到msg->pub
+                if (lws_mqtt_client_send_publish(wsi, &msg->pub,
+                    msg->pub.payload, msg->pub.payload_len, true)) {
+                    lwsl_err("%s: publish failed\n", __func__);
+                    break;
                 }
+                iot_mqtt_pub_queue_inflight_add(&ctx->pub_queue, msg);
             }
         }
 
@@ -279,45 +454,15 @@ static int callback_mqtt(struct lws *wsi, enum lws_callback_reasons reason,
 
     case LWS_CALLBACK_MQTT_ACK:
         lwsl_info("%s: MQTT_ACK\n", __func__);
+        if (ctx->sending_qos0) {
+            break; // QoS0发送完成的本地确认
+        }
+        iot_mqtt_on_broker_rx(ctx, lws_now_usecs());
         lws_pthread_mutex_lock(&ctx->pub_topic_mutex);
-        if (ctx->waiting_for_puback) {
-            ctx->waiting_for_puback = 0;
-
-            // Find and remove the acknowledged QoS1 message
-            if (ctx->pending_pub_list) {
-                int acked_idx = -1;
-                for (size_t i = 0; i < ctx->pending_pub_list->count; i++) {
-                    if (ctx->pending_pub_list->sent_list[i] &&
-                        ctx->pending_pub_list->publish_params[i].qos != QOS0) {
-                        acked_idx = i;
-                        break;
-                    }
-                }
-
-                if (acked_idx != -1) {
-                    // Free resources
-                    free((void *)ctx->pending_pub_list->publish_params[acked_idx].topic);
-                    free((void *)ctx->pending_pub_list->publish_params[acked_idx].payload);
-
-                    // Compact the list
-                    if ((size_t)acked_idx < ctx->pending_pub_list->count - 1) {
-                        memmove(&ctx->pending_pub_list->publish_params[acked_idx],
-                                &ctx->pending_pub_list->publish_params[acked_idx + 1],
-                                (ctx->pending_pub_list->count - acked_idx - 1) * sizeof(lws_mqtt_publish_param_t));
-                        memmove(&ctx->pending_pub_list->sent_list[acked_idx],
-                                &ctx->pending_pub_list->sent_list[acked_idx + 1],
-                                (ctx->pending_pub_list->count - acked_idx - 1) * sizeof(bool));
-                    }
-                    ctx->pending_pub_list->count--;
-
-                    if (ctx->pending_pub_list->count == 0) {
-                        free(ctx->pending_pub_list->publish_params);
-                        free(ctx->pending_pub_list->sent_list);
-                        free(ctx->pending_pub_list);
-                        ctx->pending_pub_list = NULL;
-                    }
-                }
-            }
+        // lws不上报PUBACK的packet_id，在途窗口为1，确认的就是唯一的在途消息
+        iot_mqtt_msg_t *acked = iot_mqtt_pub_queue_ack_oldest(&ctx->pub_queue);
+        if (acked) {
+            _iot_mqtt_msg_done(ctx, acked);
         }
         lws_pthread_mutex_unlock(&ctx->pub_topic_mutex);
         lws_callback_on_writable(wsi);
@@ -325,28 +470,24 @@ static int callback_mqtt(struct lws *wsi, enum lws_callback_reasons reason,
 
     case LWS_CALLBACK_MQTT_RESEND:
         lwsl_info("%s: MQTT_RESEND\n", __func__);
+        // PUBACK超时，重发最早的在途消息
+        iot_mqtt_on_puback_timeout(ctx);
+        lws_pthread_mutex_lock(&ctx->pub_topic_mutex);
+        iot_mqtt_msg_t *unacked = iot_mqtt_pub_queue_oldest(&ctx->pub_queue);
+        if (unacked) {
+            unacked->resend = true;
+        }
+        lws_pthread_mutex_unlock(&ctx->pub_topic_mutex);
         lws_callback_on_writable(wsi);
         break;
 
     case LWS_CALLBACK_MQTT_CLIENT_RX:
         lwsl_info("%s: MQTT_CLIENT_RX\n", __func__);
         pub = (lws_mqtt_publish_param_t *)in;
+        iot_mqtt_on_broker_rx(ctx, lws_now_usecs());
         
-        for (size_t i = 0; i < ctx->sub_topic_count; i++) {
-            if (!strncmp(pub->topic, ctx->sub_topic_maps[i].topic, pub->topic_len)) {
-                ctx->sub_topic_maps[i].message_callback(pub->topic, 
-                    pub->payload, pub->payload_len, ctx->sub_topic_maps[i].user_data);
-                break;
-            }
-            // match topic，以+号结尾的topic需要匹配
-            // pub->topic是完整的topic，sub_topic_maps可能以+结尾，需要模糊匹配
-            if (ctx->sub_topic_maps[i].topic[strlen(ctx->sub_topic_maps[i].topic)-1] == '+' && !strncmp(pub->topic, ctx->sub_topic_maps[i].topic, strlen(ctx->sub_topic_maps[i].topic)-1)) {
-                ctx->sub_topic_maps[i].message_callback(pub->topic,
-                    pub->payload, pub->payload_len, ctx->sub_topic_maps[i].user_data);
-                break;
-            }
-    
-        }        
+        // 按MQTT通配规则分发给所有匹配的订阅
+        iot_mqtt_topic_trie_match(&ctx->sub_topics, pub->topic, pub->topic_len, _iot_mqtt_dispatch, pub);
 
         lwsl_hexdump_notice(pub->topic, pub->topic_len);
         lwsl_hexdump_notice(pub->payload, pub->payload_len);
@@ -356,7 +497,8 @@ static int callback_mqtt(struct lws *wsi, enum lws_callback_reasons reason,
     case LWS_CALLBACK_TIMER:
         lwsl_debug("timer\n");
         if (ctx->is_connected) {
-            lws_set_timer_usecs(wsi, ctx->config->ping_interval*1000000);
+            iot_mqtt_adapt_ping_interval(ctx, lws_now_usecs());
+            lws_set_timer_usecs(wsi, (lws_usec_t)ctx->ping_interval_s * LWS_US_PER_SEC);
             lws_callback_on_writable(wsi);
             lws_cancel_service(ctx->context);
         }
@@ -421,11 +563,6 @@ static struct aws_string *_iot_mqtt_get_password(iot_basic_config_t *basic_confi
     return aws_string_new_from_c_str(alloc, values);
 }
 
-static lws_retry_bo_t retry = {
-    .secs_since_valid_ping		= IOT_DEFAULT_PING_INTERVAL_S, /* if idle, PINGREQ after secs */
-    .secs_since_valid_hangup	= 65, /* hangup if still idle secs */
-};
-
 int iot_mqtt_init(iot_mqtt_ctx_t *ctx, iot_mqtt_config_t *config) {
     int ret = VOLC_OK;
     if (ctx == NULL || config == NULL) {
@@ -442,6 +579,8 @@ int iot_mqtt_init(iot_mqtt_ctx_t *ctx, iot_mqtt_config_t *config) {
     if (config->ping_interval <= 0) {
         ctx->config->ping_interval = IOT_DEFAULT_PING_INTERVAL_S;
     }
+    iot_mqtt_apply_ping_interval(ctx, config->ping_interval > UINT16_MAX ?
+        UINT16_MAX : (uint16_t)config->ping_interval);
 
     // init lws context
     struct lws_context_creation_info info;
@@ -450,7 +589,12 @@ int iot_mqtt_init(iot_mqtt_ctx_t *ctx, iot_mqtt_config_t *config) {
     info.protocols = protocols;
     // info.fd_limit_per_thread = 1 + 1 + 1;
     // info.register_notifier_list = na;
-    info.retry_and_idle_policy = &retry;
+    info.retry_and_idle_policy = &ctx->retry;
+    if (config->tcp_keepalive_s > 0) {
+        info.ka_time = config->tcp_keepalive_s;
+        info.ka_probes = 3;
+        info.ka_interval = config->tcp_keepalive_s >= 3 ? config->tcp_keepalive_s / 3 : 1;
+    }
     info.user = (void*)ctx;
     // info.client_ssl_ca_filepath = NULL;
     struct lws_context *context = lws_create_context(&info);
@@ -460,8 +604,28 @@ int iot_mqtt_init(iot_mqtt_ctx_t *ctx, iot_mqtt_config_t *config) {
     }
     ctx->context = context;
     
+    uint32_t capacity = config->pub_queue_capacity > 0 ? config->pub_queue_capacity : IOT_MQTT_DEFAULT_PUB_QUEUE_CAPACITY;
+    if (iot_mqtt_pub_queue_init(&ctx->pub_queue, IOT_MQTT_MAX_INFLIGHT, capacity, config->pub_overflow_policy) != VOLC_OK ||
+        iot_mqtt_topic_trie_init(&ctx->sub_topics) != VOLC_OK) {
+        iot_mqtt_pub_queue_deinit(&ctx->pub_queue);
+        lws_context_destroy(context);
+        ctx->context = NULL;
+        return VOLC_ERR_MALLOC;
+    }
+
+    if (config->spool.path != NULL) {
+        ctx->spool = (iot_mqtt_spool_t *)malloc(sizeof(iot_mqtt_spool_t));
+        if (ctx->spool == NULL || iot_mqtt_spool_open(ctx->spool, &config->spool) != VOLC_OK) {
+            // 离线缓存不可用不影响在线发布
+            lwsl_err("%s: open spool %s failed, offline publishes disabled\n", __func__, config->spool.path);
+            free(ctx->spool);
+            ctx->spool = NULL;
+        }
+    }
+
     lws_pthread_mutex_init(&ctx->sub_topic_mutex);
     lws_pthread_mutex_init(&ctx->pub_topic_mutex);
+    lws_pthread_mutex_init(&ctx->rtt_mutex);
 
     return ret;
 }
@@ -473,17 +637,16 @@ void iot_mqtt_deinit(iot_mqtt_ctx_t *ctx) {
     aws_string_destroy_secure(ctx->config->username);
     aws_string_destroy_secure(ctx->config->password);
 
+    // 主动释放时断开连接不再上报
+    ctx->link_suspect_cb = NULL;
+    ctx->loop_hook = NULL;
     if (ctx->context) {
+        lws_sul_cancel(&ctx->sul_loop_hook);
         lws_context_destroy(ctx->context);
     }
 
     // Free subscribed topics
-    for (size_t i = 0; i < ctx->sub_topic_count; i++) {
-        free((void *)ctx->sub_topic_maps[i].topic);
-    }
-    free(ctx->sub_topic_maps);
-    ctx->sub_topic_maps = NULL;
-    ctx->sub_topic_count = 0;
+    iot_mqtt_topic_trie_deinit(&ctx->sub_topics, _iot_mqtt_free_sub, NULL);
 
     // Free pending subscription list
     if (ctx->pending_sub_list) {
@@ -495,20 +658,21 @@ void iot_mqtt_deinit(iot_mqtt_ctx_t *ctx) {
         ctx->pending_sub_list = NULL;
     }
 
-    // Free pending publish list
-    if (ctx->pending_pub_list) {
-        for (size_t i = 0; i < ctx->pending_pub_list->count; i++) {
-            free((void *)ctx->pending_pub_list->publish_params[i].topic);
-            free((void *)ctx->pending_pub_list->publish_params[i].payload);
-        }
-        free(ctx->pending_pub_list->publish_params);
-        free(ctx->pending_pub_list->sent_list);
-        free(ctx->pending_pub_list);
-        ctx->pending_pub_list = NULL;
+    // Free pending and unacknowledged publishes
+    iot_mqtt_pub_queue_deinit(&ctx->pub_queue);
+    // 未送达的消息留在缓存文件中，下次启动后补发
+    if (ctx->spool != NULL) {
+        iot_mqtt_spool_close(ctx->spool);
+        free(ctx->spool);
+        ctx->spool = NULL;
     }
 
+    free(ctx->rtt_hist);
+    ctx->rtt_hist = NULL;
+
     lws_pthread_mutex_destroy(&ctx->sub_topic_mutex);
     lws_pthread_mutex_destroy(&ctx->pub_topic_mutex);
+    lws_pthread_mutex_destroy(&ctx->rtt_mutex);
 }
 
 int iot_mqtt_connect(iot_mqtt_ctx_t *ctx) {
@@ -526,6 +690,7 @@ int iot_mqtt_connect(iot_mqtt_ctx_t *ctx) {
     client_connect_param.username = username;
     client_connect_param.password = password;
     client_connect_param.keep_alive = ctx->config->keep_alive;
+    client_connect_param.clean_start = ctx->config->persistent_session ? 0 : 1;
     
     i.mqtt_cp = &client_connect_param;
     i.address = ctx->config->mqtt_host;
@@ -533,6 +698,7 @@ int iot_mqtt_connect(iot_mqtt_ctx_t *ctx) {
     i.protocol = "mqtt";
     i.context = ctx->context;
     i.method = "MQTT";
+    i.retry_and_idle_policy = &ctx->retry;
     i.alpn = "mqtt";
     i.port = 1883;
 
@@ -558,43 +724,6 @@ int iot_mqtt_disconnect(iot_mqtt_ctx_t *ctx) {
     return ret;
 }
 
-static void _iot_mqtt_append_sub_topic(iot_mqtt_ctx_t *ctx, iot_mqtt_topic_map_t *topic_map) {
-    lws_pthread_mutex_lock(&ctx->sub_topic_mutex);
-    // 将topic_map存入待订阅列表
-    if (ctx->pending_sub_list == NULL) {
-        ctx->pending_sub_list = (iot_mqtt_pending_sub_list_t *)malloc(sizeof(iot_mqtt_pending_sub_list_t));
-        if (ctx->pending_sub_list == NULL) {
-            lws_pthread_mutex_unlock(&ctx->sub_topic_mutex);
-            return;
-        }
-        ctx->pending_sub_list->topic_maps = NULL;
-        ctx->pending_sub_list->count = 0;
-    }
-    // copy topic_map
-    iot_mqtt_topic_map_t topic_map_copy;
-    memset(&topic_map_copy, 0, sizeof(iot_mqtt_topic_map_t));
-    topic_map_copy.topic = strdup(topic_map->topic);
-    if (topic_map_copy.topic == NULL) {
-        lws_pthread_mutex_unlock(&ctx->sub_topic_mutex);
-        return;
-    }
-    topic_map_copy.message_callback = topic_map->message_callback;
-    topic_map_copy.event_callback = topic_map->event_callback;
-    topic_map_copy.user_data = topic_map->user_data;
-    topic_map_copy.qos = topic_map->qos;
-
-    iot_mqtt_topic_map_t *new_maps = (iot_mqtt_topic_map_t *)realloc(ctx->pending_sub_list->topic_maps, (ctx->pending_sub_list->count + 1) * sizeof(iot_mqtt_topic_map_t));
-    if (new_maps == NULL) {
-        free((void*)topic_map_copy.topic);
-        lws_pthread_mutex_unlock(&ctx->sub_topic_mutex);
-        return;
-    }
-    ctx->pending_sub_list->topic_maps = new_maps;
-    ctx->pending_sub_list->topic_maps[ctx->pending_sub_list->count] = topic_map_copy;
-    ctx->pending_sub_list->count++;
-    lws_pthread_mutex_unlock(&ctx->sub_topic_mutex);
-}
-
 int iot_mqtt_reconnect(iot_mqtt_ctx_t *ctx) {
     int ret = VOLC_OK;
 
@@ -612,99 +741,83 @@ int iot_mqtt_reconnect(iot_mqtt_ctx_t *ctx) {
         return ret;
     }
 
-    // 重新订阅topic
-    for (int i = 0; i < ctx->sub_topic_count; i++) {
-        iot_mqtt_topic_map_t *topic_map = &ctx->sub_topic_maps[i];
-        _iot_mqtt_append_sub_topic(ctx, topic_map);
-    }
+    // 重新订阅在连接建立（MQTT_CLIENT_ESTABLISHED）后根据会话是否保留处理
 
     return ret;
 }
 
-int iot_mqtt_publish(iot_mqtt_ctx_t *ctx, const char *topic, const uint8_t *payload, size_t len, int qos) {
-    int ret = VOLC_OK;
-
-    // 组装pub_param，放入pending_pub_list
-    lws_mqtt_publish_param_t pub_param;
-    memset(&pub_param, 0, sizeof(lws_mqtt_publish_param_t));
-    pub_param.topic = strdup(topic);
-    if (!pub_param.topic) {
-        lwsl_err("%s: Memory allocation failed for topic\n", __func__);
-        return VOLC_ERR_MALLOC;
+// buf非NULL时payload引用buf，否则拷贝payload
+static int _iot_mqtt_queue_alloc(iot_mqtt_ctx_t *ctx, const char *topic, const uint8_t *payload, size_t len,
+                                 iot_mqtt_buf_t *buf, int qos, iot_mqtt_msg_t **msg) {
+    if (buf != NULL) {
+        return iot_mqtt_pub_queue_alloc_buf(&ctx->pub_queue, topic, buf, qos, msg);
     }
-    pub_param.topic_len = strlen(topic);
+    return iot_mqtt_pub_queue_alloc(&ctx->pub_queue, topic, payload, len, qos, msg);
+}
 
-    if (len > 0) {
-        pub_param.payload = malloc(len);
-        if (pub_param.payload == NULL) {
-            lwsl_err("%s: Memory allocation failed for payload\n", __func__);
-            free((void*)pub_param.topic);
-            return VOLC_ERR_MALLOC;
-        }
-        memcpy((void*)pub_param.payload, payload, len);
-    } else {
-        pub_param.payload = NULL;
-    }
-    
-    pub_param.payload_len = len;
-    pub_param.qos = qos;
+static int _iot_mqtt_publish(iot_mqtt_ctx_t *ctx, const char *topic, const uint8_t *payload, size_t len,
+                             iot_mqtt_buf_t *buf, int qos) {
+    int ret = VOLC_OK;
+    iot_mqtt_msg_t *msg = NULL;
+    int32_t waited_ms = 0;
 
     lws_pthread_mutex_lock(&ctx->pub_topic_mutex);
-    if (ctx->pending_pub_list == NULL) {
-        ctx->pending_pub_list = (iot_mqtt_pending_pub_list_t *)malloc(sizeof(iot_mqtt_pending_pub_list_t));
-        if (ctx->pending_pub_list == NULL) {
-            lwsl_err("%s: Memory allocation failed for pending_pub_list\n", __func__);
-            ret = VOLC_ERR_MALLOC;
-            goto finish_with_free;
+    // 断线期间或缓存尚未补发完时写入离线缓存，保证补发顺序
+    if (ctx->spool != NULL && (!ctx->is_connected || iot_mqtt_spool_pending(ctx->spool) > 0)) {
+        ret = iot_mqtt_spool_append(ctx->spool, topic, payload, len, qos, NULL);
+        lws_pthread_mutex_unlock(&ctx->pub_topic_mutex);
+        if (ret != VOLC_OK) {
+            lwsl_err("%s: spool publish failed, ret %d\n", __func__, ret);
+        } else if (ctx->is_connected) {
+            lws_callback_on_writable(ctx->wsi);
+            lws_cancel_service(ctx->context);
         }
-        ctx->pending_pub_list->publish_params = NULL;
-        ctx->pending_pub_list->sent_list = NULL;
-        ctx->pending_pub_list->count = 0;
+        return ret;
     }
-    
-    // 限制最大发布数量
-    if (ctx->pending_pub_list->count > 10) {
-        ret = VOLC_ERR_MQTT_PUB;
-        lwsl_err("%s: publish failed\n", __func__);
-        goto finish_with_free;
+    ret = _iot_mqtt_queue_alloc(ctx, topic, payload, len, buf, qos, &msg);
+    // BLOCK策略：释放锁等待服务线程发出或确认消息，最多等待block_timeout_ms；
+    // 服务线程（回调、loop hook）中等待不会有空位，按REJECT直接返回
+    int32_t block_timeout_ms = ctx->config->pub_block_timeout_ms > 0 ?
+        ctx->config->pub_block_timeout_ms : IOT_MQTT_DEFAULT_PUB_BLOCK_TIMEOUT_MS;
+    if (ctx->pub_queue.overflow == IOT_MQTT_OVERFLOW_BLOCK && iot_mqtt_in_service_thread(ctx)) {
+        block_timeout_ms = 0;
     }
-        
-    lws_mqtt_publish_param_t *new_params = (lws_mqtt_publish_param_t *)realloc(ctx->pending_pub_list->publish_params, (ctx->pending_pub_list->count + 1) * sizeof(lws_mqtt_publish_param_t));
-    if (new_params == NULL) {
-        ret = VOLC_ERR_MALLOC;
-        goto finish_with_free;
+    while (ret == VOLC_ERR_MQTT_PUB_QUEUE_FULL && ctx->pub_queue.overflow == IOT_MQTT_OVERFLOW_BLOCK &&
+           waited_ms < block_timeout_ms) {
+        lws_pthread_mutex_unlock(&ctx->pub_topic_mutex);
+        if (ctx->is_connected) {
+            lws_cancel_service(ctx->context);
+        }
+        usleep(1000);
+        waited_ms++;
+        lws_pthread_mutex_lock(&ctx->pub_topic_mutex);
+        ret = _iot_mqtt_queue_alloc(ctx, topic, payload, len, buf, qos, &msg);
     }
-    ctx->pending_pub_list->publish_params = new_params;
-
-    bool *new_sent_list = (bool *)realloc(ctx->pending_pub_list->sent_list, (ctx->pending_pub_list->count + 1) * sizeof(bool));
-    if (new_sent_list == NULL) {
-        ret = VOLC_ERR_MALLOC;
-        goto finish_with_free;
+    if (ret == VOLC_OK) {
+        iot_mqtt_pub_queue_push(&ctx->pub_queue, msg);
+    } else {
+        lwsl_err("%s: publish failed, ret %d\n", __func__, ret);
     }
-    ctx->pending_pub_list->sent_list = new_sent_list;
-    
-    ctx->pending_pub_list->publish_params[ctx->pending_pub_list->count] = pub_param;
-    ctx->pending_pub_list->sent_list[ctx->pending_pub_list->count] = false;
-    ctx->pending_pub_list->count++;
-
     lws_pthread_mutex_unlock(&ctx->pub_topic_mutex);
-    if (ctx->is_connected) {
+
+    if (ret == VOLC_OK && ctx->is_connected) {
         lws_callback_on_writable(ctx->wsi);
         lws_cancel_service(ctx->context);
     }
 
     return ret;
+}
 
-finish_with_free:
-    free((void*)pub_param.topic);
-    free((void*)pub_param.payload);
-    lws_pthread_mutex_unlock(&ctx->pub_topic_mutex);
-    if (ctx->is_connected) {
-        lws_callback_on_writable(ctx->wsi);
-        lws_cancel_service(ctx->context);
-    }
+int iot_mqtt_publish(iot_mqtt_ctx_t *ctx, const char *topic, const uint8_t *payload, size_t len, int qos) {
+    return _iot_mqtt_publish(ctx, topic, payload, len, NULL, qos);
+}
 
-    return ret;
+int iot_mqtt_publish_buf(iot_mqtt_ctx_t *ctx, const char *topic, iot_mqtt_buf_t *buf, int qos) {
+    if (ctx == NULL || topic == NULL || buf == NULL) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    // 写入离线缓存时拷贝payload，不持有buf
+    return _iot_mqtt_publish(ctx, topic, buf->data, buf->len, buf, qos);
 }
 
 int iot_mqtt_subscribe(iot_mqtt_ctx_t *ctx, iot_mqtt_topic_map_t *topic_map) {
@@ -712,22 +825,144 @@ int iot_mqtt_subscribe(iot_mqtt_ctx_t *ctx, iot_mqtt_topic_map_t *topic_map) {
         return VOLC_ERR_INVALID_PARAM;
     }
     
+    if (!iot_mqtt_topic_filter_valid(topic_map->topic) || topic_map->message_callback == NULL) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    // 服务线程在同一把锁下把订阅写入trie，其他线程的查找与入队需要持锁
+    lws_pthread_mutex_lock(&ctx->sub_topic_mutex);
+    int ret = VOLC_OK;
     // 检查topic是否已经订阅
-    for (size_t i = 0; i < ctx->sub_topic_count; i++) {
-        if (!strcmp(topic_map->topic, ctx->sub_topic_maps[i].topic)) {
-            return VOLC_OK;
-        }
+    if (iot_mqtt_topic_trie_find(&ctx->sub_topics, topic_map->topic) == NULL) {
+        ret = _iot_mqtt_append_sub_topic(ctx, topic_map);
     }
+    lws_pthread_mutex_unlock(&ctx->sub_topic_mutex);
+    return ret;
+}
 
-    _iot_mqtt_append_sub_topic(ctx, topic_map);
+static void _iot_mqtt_loop_hook_cb(lws_sorted_usec_list_t *sul);
 
-    return 0;
+// 运行loop hook并把定时器设在它返回的到期时间；lws_service的超时参数只区分等待与不等待，到期靠定时器唤醒
+static void _iot_mqtt_run_loop_hook(iot_mqtt_ctx_t *ctx) {
+    iot_mqtt_loop_hook_fn hook = ctx->loop_hook;
+    if (hook == NULL) {
+        lws_sul_cancel(&ctx->sul_loop_hook);
+        return;
+    }
+    int32_t next_ms = hook(ctx->loop_hook_user_data);
+    if (next_ms < 0) {
+        lws_sul_cancel(&ctx->sul_loop_hook);
+        return;
+    }
+    lws_sul_schedule(ctx->context, 0, &ctx->sul_loop_hook, _iot_mqtt_loop_hook_cb, (lws_usec_t) next_ms * LWS_US_PER_MS);
+}
+
+static void _iot_mqtt_loop_hook_cb(lws_sorted_usec_list_t *sul) {
+    iot_mqtt_ctx_t *ctx = lws_container_of(sul, iot_mqtt_ctx_t, sul_loop_hook);
+    _iot_mqtt_run_loop_hook(ctx);
 }
 
 int iot_mqtt_run_event_loop(iot_mqtt_ctx_t* ctx, int timeout_ms) {
     if (ctx == NULL) {
         return VOLC_ERR_INVALID_PARAM;
     }
+    if (!ctx->service_thread_valid) {
+        ctx->service_thread = platform_thread_self();
+        ctx->service_thread_valid = true;
+    }
+    // 被 iot_mqtt_wakeup 唤醒后钩子可能有更早的到期时间，每次进入都重新计算
+    _iot_mqtt_run_loop_hook(ctx);
     return lws_service(ctx->context, timeout_ms);
 }
+
+bool iot_mqtt_in_service_thread(iot_mqtt_ctx_t *ctx) {
+    return ctx != NULL && ctx->service_thread_valid && platform_thread_equal(ctx->service_thread, platform_thread_self());
+}
+
+void iot_mqtt_wakeup(iot_mqtt_ctx_t *ctx) {
+    if (ctx == NULL || ctx->context == NULL) {
+        return;
+    }
+    lws_cancel_service(ctx->context);
+}
+
+void iot_mqtt_set_link_suspect_callback(iot_mqtt_ctx_t *ctx, iot_mqtt_link_suspect_fn cb, void *user_data) {
+    if (ctx == NULL) {
+        return;
+    }
+    ctx->link_suspect_cb = cb;
+    ctx->link_suspect_user_data = user_data;
+}
+
+void iot_mqtt_set_loop_hook(iot_mqtt_ctx_t *ctx, iot_mqtt_loop_hook_fn hook, void *user_data) {
+    if (ctx == NULL) {
+        return;
+    }
+    ctx->loop_hook = hook;
+    ctx->loop_hook_user_data = user_data;
+    // 定时器只能在服务线程上设置，唤醒服务线程立即运行新的钩子
+    iot_mqtt_wakeup(ctx);
+}
+
+void iot_mqtt_record_rtt(iot_mqtt_ctx_t *ctx, uint64_t rtt_us) {
+    if (ctx == NULL) {
+        return;
+    }
+    lws_pthread_mutex_lock(&ctx->rtt_mutex);
+    if (ctx->rtt_hist == NULL) {
+        ctx->rtt_hist = (iot_latency_hist_t *)malloc(sizeof(iot_latency_hist_t));
+        if (ctx->rtt_hist == NULL) {
+            lws_pthread_mutex_unlock(&ctx->rtt_mutex);
+            return;
+        }
+        iot_latency_hist_reset(ctx->rtt_hist);
+    }
+    iot_latency_hist_record(ctx->rtt_hist, rtt_us);
+    uint32_t sample = rtt_us > UINT32_MAX ? UINT32_MAX : (uint32_t)rtt_us;
+    ctx->srtt_us = ctx->srtt_us == 0 ? sample : ctx->srtt_us - ctx->srtt_us / 8 + sample / 8;
+    uint16_t timeout_s = 0;
+    if (ctx->rtt_hist->total >= IOT_MQTT_RTT_MIN_SAMPLES) {
+        uint64_t p99_us = iot_latency_hist_percentile(ctx->rtt_hist, 99);
+        uint64_t secs = (p99_us * IOT_MQTT_RTT_TIMEOUT_FACTOR + LWS_US_PER_SEC - 1) / LWS_US_PER_SEC;
+        timeout_s = secs > IOT_MQTT_RTT_MAX_PINGRESP_TIMEOUT_S ? IOT_MQTT_RTT_MAX_PINGRESP_TIMEOUT_S : (uint16_t)secs;
+    }
+    bool changed = timeout_s != ctx->rtt_pingresp_timeout_s;
+    ctx->rtt_pingresp_timeout_s = timeout_s;
+    lws_pthread_mutex_unlock(&ctx->rtt_mutex);
+    if (changed) {
+        // lws下次重新计时时使用新的挂断时限
+        iot_mqtt_apply_ping_interval(ctx, ctx->ping_interval_s);
+    }
+}
+
+void iot_mqtt_record_rtt_loss(iot_mqtt_ctx_t *ctx) {
+    if (ctx == NULL) {
+        return;
+    }
+    lws_pthread_mutex_lock(&ctx->rtt_mutex);
+    ctx->rtt_lost++;
+    lws_pthread_mutex_unlock(&ctx->rtt_mutex);
+}
+
+int iot_mqtt_get_rtt_stats(iot_mqtt_ctx_t *ctx, iot_mqtt_rtt_stats_t *stats) {
+    if (ctx == NULL || stats == NULL) {
+        return VOLC_ERR_NULL_POINTER;
+    }
+    memset(stats, 0, sizeof(iot_mqtt_rtt_stats_t));
+    lws_pthread_mutex_lock(&ctx->rtt_mutex);
+    const iot_latency_hist_t *hist = ctx->rtt_hist;
+    if (hist != NULL && hist->total > 0) {
+        stats->count = hist->total;
+        stats->min_us = hist->min_us;
+        stats->max_us = hist->max_us;
+        stats->mean_us = iot_latency_hist_mean(hist);
+        stats->p50_us = iot_latency_hist_percentile(hist, 50);
+        stats->p90_us = iot_latency_hist_percentile(hist, 90);
+        stats->p99_us = iot_latency_hist_percentile(hist, 99);
+    }
+    stats->srtt_us = ctx->srtt_us;
+    stats->lost = ctx->rtt_lost;
+    stats->pingresp_timeout_s = _iot_mqtt_pingresp_timeout(ctx);
+    lws_pthread_mutex_unlock(&ctx->rtt_mutex);
+    return VOLC_OK;
+}
 #endif // ONESDK_ENABLE_IOT
\ No newline at end of file
@@ -0,0 +1,229 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "onesdk_config.h"
+#ifdef ONESDK_ENABLE_IOT
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "iot/iot_mqtt_pub_queue.h"
+#include "error_code.h"
+#include "platform_compat.h"
+
+int iot_mqtt_buf_init(iot_mqtt_buf_t *buf, uint8_t *storage, size_t storage_len,
+                      iot_mqtt_buf_release_fn release, void *userdata) {
+    if (buf == NULL || storage == NULL || storage_len < LWS_PRE) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    buf->data = storage + LWS_PRE;
+    buf->len = 0;
+    buf->cap = storage_len - LWS_PRE;
+    buf->refcount = 1;
+    buf->release = release;
+    buf->userdata = userdata;
+    return VOLC_OK;
+}
+
+static void _iot_mqtt_buf_free(iot_mqtt_buf_t *buf, void *userdata) {
+    (void)userdata;
+    free(buf);
+}
+
+iot_mqtt_buf_t *iot_mqtt_buf_new(size_t cap) {
+    iot_mqtt_buf_t *buf = (iot_mqtt_buf_t *)malloc(sizeof(iot_mqtt_buf_t) + LWS_PRE + cap);
+    if (buf == NULL) {
+        return NULL;
+    }
+    iot_mqtt_buf_init(buf, (uint8_t *)(buf + 1), LWS_PRE + cap, _iot_mqtt_buf_free, NULL);
+    return buf;
+}
+
+void iot_mqtt_buf_ref(iot_mqtt_buf_t *buf) {
+    atomic_add_long(&buf->refcount, 1);
+}
+
+void iot_mqtt_buf_unref(iot_mqtt_buf_t *buf) {
+    if (buf == NULL) {
+        return;
+    }
+    // 各平台atomic_sub_long返回值语义不同，用CAS取得减之前的值
+    long cur = atomic_load_long(&buf->refcount);
+    while (!atomic_compare_exchange_long(&buf->refcount, &cur, cur - 1)) {
+    }
+    if (cur == 1 && buf->release != NULL) {
+        buf->release(buf, buf->userdata);
+    }
+}
+
+int iot_mqtt_pub_queue_init(iot_mqtt_pub_queue_t *q, uint16_t window, uint32_t capacity,
+                            iot_mqtt_overflow_policy_t overflow) {
+    if (q == NULL || window == 0 || capacity == 0) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    memset(q, 0, sizeof(iot_mqtt_pub_queue_t));
+    q->descs = (iot_mqtt_msg_t *)calloc(capacity, sizeof(iot_mqtt_msg_t));
+    if (q->descs == NULL) {
+        return VOLC_ERR_MALLOC;
+    }
+    for (uint32_t i = 0; i < capacity; i++) {
+        lws_dll2_add_tail(&q->descs[i].list, &q->free);
+    }
+    q->window = window;
+    q->capacity = capacity;
+    q->overflow = overflow;
+    // 每级最多缓存capacity块，队列满载后不再向系统申请
+    mem_pool_init(&q->pool, capacity);
+    return VOLC_OK;
+}
+
+void iot_mqtt_pub_queue_deinit(iot_mqtt_pub_queue_t *q) {
+    if (q == NULL || q->descs == NULL) {
+        return;
+    }
+    for (uint32_t i = 0; i < q->capacity; i++) {
+        mem_pool_free(&q->pool, (void *)q->descs[i].pub.topic);
+        iot_mqtt_buf_unref(q->descs[i].buf);
+    }
+    mem_pool_deinit(&q->pool);
+    free(q->descs);
+    memset(q, 0, sizeof(iot_mqtt_pub_queue_t));
+}
+
+// 取空闲描述符并分配topic块，extra为紧随topic之后的payload长度
+static int _pub_queue_take(iot_mqtt_pub_queue_t *q, const char *topic, size_t extra, int qos,
+                           iot_mqtt_msg_t **out) {
+    size_t topic_len = strlen(topic);
+    struct lws_dll2 *d = lws_dll2_get_head(&q->free);
+    if (d == NULL && q->overflow == IOT_MQTT_OVERFLOW_DROP_OLDEST) {
+        iot_mqtt_msg_t *oldest = iot_mqtt_pub_queue_peek(q);
+        if (oldest != NULL) {
+            lws_dll2_remove(&oldest->list);
+            iot_mqtt_pub_queue_release(q, oldest);
+            q->dropped++;
+            d = lws_dll2_get_head(&q->free);
+        }
+    }
+    if (d == NULL) {
+        return VOLC_ERR_MQTT_PUB_QUEUE_FULL;
+    }
+    // topic以'\0'结尾，payload紧随其后
+    char *buf = mem_pool_alloc(&q->pool, topic_len + 1 + extra);
+    if (buf == NULL) {
+        return VOLC_ERR_MALLOC;
+    }
+    memcpy(buf, topic, topic_len + 1);
+    q->copied_bytes += topic_len + 1 + extra;
+
+    iot_mqtt_msg_t *msg = lws_container_of(d, iot_mqtt_msg_t, list);
+    lws_dll2_remove(d);
+    memset(&msg->pub, 0, sizeof(msg->pub));
+    msg->pub.topic = buf;
+    msg->pub.topic_len = (uint16_t)topic_len;
+    msg->pub.qos = (lws_mqtt_qos_levels_t)qos;
+    msg->buf = NULL;
+    msg->resend = false;
+    msg->spool_seq = 0;
+    *out = msg;
+    return VOLC_OK;
+}
+
+int iot_mqtt_pub_queue_alloc(iot_mqtt_pub_queue_t *q, const char *topic, const uint8_t *payload,
+                             size_t len, int qos, iot_mqtt_msg_t **out) {
+    iot_mqtt_msg_t *msg = NULL;
+    int ret = _pub_queue_take(q, topic, len, qos, &msg);
+    if (ret != VOLC_OK) {
+        return ret;
+    }
+    if (len > 0) {
+        char *payload_copy = (char *)msg->pub.topic + msg->pub.topic_len + 1;
+        memcpy(payload_copy, payload, len);
+        msg->pub.payload = payload_copy;
+    }
+    msg->pub.payload_len = (uint32_t)len;
+    *out = msg;
+    return VOLC_OK;
+}
+
+int iot_mqtt_pub_queue_alloc_buf(iot_mqtt_pub_queue_t *q, const char *topic, iot_mqtt_buf_t *buf,
+                                 int qos, iot_mqtt_msg_t **out) {
+    iot_mqtt_msg_t *msg = NULL;
+    int ret = _pub_queue_take(q, topic, 0, qos, &msg);
+    if (ret != VOLC_OK) {
+        return ret;
+    }
+    iot_mqtt_buf_ref(buf);
+    msg->buf = buf;
+    msg->pub.payload = buf->len > 0 ? buf->data : NULL;
+    msg->pub.payload_len = (uint32_t)buf->len;
+    *out = msg;
+    return VOLC_OK;
+}
+
+void iot_mqtt_pub_queue_release(iot_mqtt_pub_queue_t *q, iot_mqtt_msg_t *msg) {
+    if (msg == NULL) {
+        return;
+    }
+    mem_pool_free(&q->pool, (void *)msg->pub.topic);
+    memset(&msg->pub, 0, sizeof(msg->pub));
+    iot_mqtt_buf_t *buf = msg->buf;
+    msg->buf = NULL;
+    lws_dll2_add_tail(&msg->list, &q->free);
+    // 最后归还引用，release回调中可以再次发布
+    iot_mqtt_buf_unref(buf);
+}
+
+void iot_mqtt_pub_queue_push(iot_mqtt_pub_queue_t *q, iot_mqtt_msg_t *msg) {
+    lws_dll2_add_tail(&msg->list, &q->pending);
+}
+
+iot_mqtt_msg_t *iot_mqtt_pub_queue_peek(iot_mqtt_pub_queue_t *q) {
+    struct lws_dll2 *head = lws_dll2_get_head(&q->pending);
+    return head ? lws_container_of(head, iot_mqtt_msg_t, list) : NULL;
+}
+
+bool iot_mqtt_pub_queue_window_full(const iot_mqtt_pub_queue_t *q) {
+    return q->inflight.count >= q->window;
+}
+
+int iot_mqtt_pub_queue_inflight_add(iot_mqtt_pub_queue_t *q, iot_mqtt_msg_t *msg) {
+    if (iot_mqtt_pub_queue_window_full(q)) {
+        return -1;
+    }
+    lws_dll2_remove(&msg->list);
+    lws_dll2_add_tail(&msg->list, &q->inflight);
+    msg->resend = false;
+    return 0;
+}
+
+iot_mqtt_msg_t *iot_mqtt_pub_queue_oldest(iot_mqtt_pub_queue_t *q) {
+    struct lws_dll2 *head = lws_dll2_get_head(&q->inflight);
+    return head ? lws_container_of(head, iot_mqtt_msg_t, list) : NULL;
+}
+
+iot_mqtt_msg_t *iot_mqtt_pub_queue_ack_oldest(iot_mqtt_pub_queue_t *q) {
+    iot_mqtt_msg_t *msg = iot_mqtt_pub_queue_oldest(q);
+    if (msg != NULL) {
+        lws_dll2_remove(&msg->list);
+    }
+    return msg;
+}
+
+void iot_mqtt_pub_queue_mark_resend(iot_mqtt_pub_queue_t *q) {
+    lws_start_foreach_dll(struct lws_dll2 *, d, lws_dll2_get_head(&q->inflight)) {
+        lws_container_of(d, iot_mqtt_msg_t, list)->resend = true;
+    } lws_end_foreach_dll(d);
+}
+
+#endif // ONESDK_ENABLE_IOT
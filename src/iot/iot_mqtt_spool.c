@@ -0,0 +1,444 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "onesdk_config.h"
+#ifdef ONESDK_ENABLE_IOT
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "iot/iot_mqtt_spool.h"
+#include "util/crc32.h"
+#include "error_code.h"
+
+/*
+ * 记录格式（小端）：
+ * magic(1) type(1) qos(1) reserved(1) seq(4) timestamp(4) topic_len(2) payload_len(4) crc32(4)
+ * topic topic_len字节，后跟'\0'；payload payload_len字节
+ * crc32覆盖crc字段之前的头部以及topic、'\0'、payload
+ */
+#define SPOOL_MAGIC         0xA5
+#define SPOOL_REC_PUBLISH   'P'
+#define SPOOL_REC_CONSUMED  'C'
+#define SPOOL_HEADER_LEN    22
+#define SPOOL_CRC_OFFSET    18
+
+static void _put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void _put_u32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint16_t _get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t _get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t _spool_now(iot_mqtt_spool_t *spool) {
+    return spool->config.now ? spool->config.now() : (uint32_t)time(NULL);
+}
+
+static int _spool_reserve_scratch(iot_mqtt_spool_t *spool, size_t size) {
+    if (spool->scratch_cap >= size) {
+        return VOLC_OK;
+    }
+    uint8_t *buf = (uint8_t *)realloc(spool->scratch, size);
+    if (buf == NULL) {
+        return VOLC_ERR_MALLOC;
+    }
+    spool->scratch = buf;
+    spool->scratch_cap = size;
+    return VOLC_OK;
+}
+
+// 读取offset处size字节的完整记录到scratch并校验
+static int _spool_read_record(iot_mqtt_spool_t *spool, uint32_t offset, uint32_t size) {
+    if (_spool_reserve_scratch(spool, size) != VOLC_OK) {
+        return VOLC_ERR_MALLOC;
+    }
+    if (fseek(spool->fp, (long)offset, SEEK_SET) != 0 ||
+        fread(spool->scratch, 1, size, spool->fp) != size) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    uint32_t crc = crc32_update(0, spool->scratch, SPOOL_CRC_OFFSET);
+    crc = crc32_update(crc, spool->scratch + SPOOL_HEADER_LEN, size - SPOOL_HEADER_LEN);
+    return crc == _get_u32(spool->scratch + SPOOL_CRC_OFFSET) ? VOLC_OK : VOLC_ERR_INVALID_PARAM;
+}
+
+static int _spool_write_record(iot_mqtt_spool_t *spool, uint8_t type, uint8_t qos, uint32_t seq,
+                               const char *topic, uint16_t topic_len, const uint8_t *payload, uint32_t payload_len) {
+    uint8_t header[SPOOL_HEADER_LEN];
+    uint8_t nul = 0;
+    size_t body_len = type == SPOOL_REC_PUBLISH ? (size_t)topic_len + 1 + payload_len : 0;
+
+    header[0] = SPOOL_MAGIC;
+    header[1] = type;
+    header[2] = qos;
+    header[3] = 0;
+    _put_u32(header + 4, seq);
+    _put_u32(header + 8, _spool_now(spool));
+    _put_u16(header + 12, topic_len);
+    _put_u32(header + 14, payload_len);
+    uint32_t crc = crc32_update(0, header, SPOOL_CRC_OFFSET);
+    if (body_len > 0) {
+        crc = crc32_update(crc, topic, topic_len);
+        crc = crc32_update(crc, &nul, 1);
+        crc = crc32_update(crc, payload, payload_len);
+    }
+    _put_u32(header + SPOOL_CRC_OFFSET, crc);
+
+    // "a+"模式下写总是追加，但读写切换前须重新定位
+    fseek(spool->fp, 0, SEEK_END);
+    bool ok = fwrite(header, 1, SPOOL_HEADER_LEN, spool->fp) == SPOOL_HEADER_LEN;
+    if (ok && body_len > 0) {
+        ok = fwrite(topic, 1, topic_len, spool->fp) == topic_len &&
+             fwrite(&nul, 1, 1, spool->fp) == 1 &&
+             (payload_len == 0 || fwrite(payload, 1, payload_len, spool->fp) == payload_len);
+    }
+    // 进程被杀时已进入内核的数据不会丢
+    if (fflush(spool->fp) != 0 || !ok) {
+        return VOLC_ERR_FILE_WRITE;
+    }
+    spool->file_size += (uint32_t)(SPOOL_HEADER_LEN + body_len);
+    return VOLC_OK;
+}
+
+static size_t _spool_find(const iot_mqtt_spool_t *spool, uint32_t seq, bool *found) {
+    size_t lo = 0;
+    size_t hi = spool->count;
+    *found = false;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (spool->entries[mid].seq == seq) {
+            *found = true;
+            return mid;
+        }
+        if (spool->entries[mid].seq < seq) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static int _spool_entry_add(iot_mqtt_spool_t *spool, const iot_mqtt_spool_entry_t *entry) {
+    if (spool->count == spool->cap) {
+        size_t cap = spool->cap ? spool->cap * 2 : 64;
+        iot_mqtt_spool_entry_t *entries = (iot_mqtt_spool_entry_t *)realloc(spool->entries,
+            cap * sizeof(iot_mqtt_spool_entry_t));
+        if (entries == NULL) {
+            return VOLC_ERR_MALLOC;
+        }
+        spool->entries = entries;
+        spool->cap = cap;
+    }
+    spool->entries[spool->count++] = *entry;
+    spool->live_bytes += entry->size;
+    return VOLC_OK;
+}
+
+static void _spool_entry_remove(iot_mqtt_spool_t *spool, size_t idx) {
+    spool->live_bytes -= spool->entries[idx].size;
+    memmove(&spool->entries[idx], &spool->entries[idx + 1],
+        (spool->count - idx - 1) * sizeof(iot_mqtt_spool_entry_t));
+    spool->count--;
+    if (idx < spool->cursor) {
+        spool->cursor--;
+    }
+}
+
+// 只保留未送达的记录重写文件，写临时文件后rename，中途失败不影响原文件
+static int _spool_compact(iot_mqtt_spool_t *spool) {
+    size_t path_len = strlen(spool->path);
+    char *tmp_path = (char *)malloc(path_len + 5);
+    if (tmp_path == NULL) {
+        return VOLC_ERR_MALLOC;
+    }
+    memcpy(tmp_path, spool->path, path_len);
+    memcpy(tmp_path + path_len, ".tmp", 5);
+
+    int ret = VOLC_OK;
+    FILE *tmp = fopen(tmp_path, "wb");
+    if (tmp == NULL) {
+        free(tmp_path);
+        return VOLC_ERR_FILE_OPEN;
+    }
+    for (size_t i = 0; i < spool->count && ret == VOLC_OK; i++) {
+        iot_mqtt_spool_entry_t *e = &spool->entries[i];
+        if (_spool_reserve_scratch(spool, e->size) != VOLC_OK) {
+            ret = VOLC_ERR_MALLOC;
+        } else if (fseek(spool->fp, (long)e->offset, SEEK_SET) != 0 ||
+                   fread(spool->scratch, 1, e->size, spool->fp) != e->size ||
+                   fwrite(spool->scratch, 1, e->size, tmp) != e->size) {
+            ret = VOLC_ERR_FILE_WRITE;
+        }
+    }
+    if (fflush(tmp) != 0) {
+        ret = VOLC_ERR_FILE_WRITE;
+    }
+    fclose(tmp);
+    if (ret != VOLC_OK) {
+        remove(tmp_path);
+        free(tmp_path);
+        return ret;
+    }
+
+    fclose(spool->fp);
+#ifdef _WIN32
+    remove(spool->path);
+#endif
+    if (rename(tmp_path, spool->path) != 0) {
+        ret = VOLC_ERR_FILE_WRITE;
+        remove(tmp_path);
+    }
+    free(tmp_path);
+    spool->fp = fopen(spool->path, "a+b");
+    if (spool->fp == NULL) {
+        return VOLC_ERR_FILE_OPEN;
+    }
+    if (ret != VOLC_OK) {
+        return ret;
+    }
+
+    uint32_t offset = 0;
+    for (size_t i = 0; i < spool->count; i++) {
+        spool->entries[i].offset = offset;
+        offset += spool->entries[i].size;
+    }
+    spool->file_size = offset;
+    return VOLC_OK;
+}
+
+// 重放文件，返回最后一条完整记录之后的偏移
+static uint32_t _spool_load(iot_mqtt_spool_t *spool) {
+    uint32_t offset = 0;
+    uint8_t header[SPOOL_HEADER_LEN];
+
+    fseek(spool->fp, 0, SEEK_SET);
+    while (fread(header, 1, SPOOL_HEADER_LEN, spool->fp) == SPOOL_HEADER_LEN) {
+        uint8_t type = header[1];
+        uint32_t seq = _get_u32(header + 4);
+        uint32_t size = SPOOL_HEADER_LEN;
+        if (header[0] != SPOOL_MAGIC || header[2] > 1 ||
+            (type != SPOOL_REC_PUBLISH && type != SPOOL_REC_CONSUMED)) {
+            break;
+        }
+        if (type == SPOOL_REC_PUBLISH) {
+            uint64_t body = (uint64_t)_get_u16(header + 12) + 1 + _get_u32(header + 14);
+            if (body > spool->config.max_bytes) {
+                break;
+            }
+            size += (uint32_t)body;
+        }
+        if (_spool_read_record(spool, offset, size) != VOLC_OK) {
+            break;
+        }
+
+        bool found;
+        size_t idx = _spool_find(spool, seq, &found);
+        if (type == SPOOL_REC_PUBLISH) {
+            iot_mqtt_spool_entry_t entry = {
+                .seq = seq,
+                .timestamp = _get_u32(header + 8),
+                .offset = offset,
+                .size = size,
+                .qos = header[2],
+            };
+            if (found || idx != spool->count || _spool_entry_add(spool, &entry) != VOLC_OK) {
+                break;
+            }
+            spool->next_seq = seq + 1;
+        } else if (found) {
+            _spool_entry_remove(spool, idx);
+        }
+        offset += size;
+        // _spool_read_record移动了读位置
+        fseek(spool->fp, (long)offset, SEEK_SET);
+    }
+    return offset;
+}
+
+int iot_mqtt_spool_open(iot_mqtt_spool_t *spool, const iot_mqtt_spool_config_t *config) {
+    if (spool == NULL || config == NULL || config->path == NULL) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    memset(spool, 0, sizeof(iot_mqtt_spool_t));
+    spool->config = *config;
+    if (spool->config.max_bytes == 0) {
+        spool->config.max_bytes = IOT_MQTT_SPOOL_DEFAULT_MAX_BYTES;
+    }
+    spool->path = strdup(config->path);
+    if (spool->path == NULL) {
+        return VOLC_ERR_MALLOC;
+    }
+    spool->config.path = spool->path;
+    spool->next_seq = 1;
+    spool->fp = fopen(spool->path, "a+b");
+    if (spool->fp == NULL) {
+        free(spool->path);
+        spool->path = NULL;
+        return VOLC_ERR_FILE_OPEN;
+    }
+
+    uint32_t valid_end = _spool_load(spool);
+    fseek(spool->fp, 0, SEEK_END);
+    long real_end = ftell(spool->fp);
+    spool->file_size = valid_end;
+    // 截掉崩溃留下的残尾，同时回收已送达的记录
+    if (real_end != (long)valid_end || spool->live_bytes < spool->file_size / 2) {
+        _spool_compact(spool);
+    }
+    return spool->fp != NULL ? VOLC_OK : VOLC_ERR_FILE_OPEN;
+}
+
+void iot_mqtt_spool_close(iot_mqtt_spool_t *spool) {
+    if (spool == NULL) {
+        return;
+    }
+    if (spool->fp != NULL) {
+        fclose(spool->fp);
+    }
+    free(spool->entries);
+    free(spool->scratch);
+    free(spool->path);
+    memset(spool, 0, sizeof(iot_mqtt_spool_t));
+}
+
+int iot_mqtt_spool_append(iot_mqtt_spool_t *spool, const char *topic, const uint8_t *payload,
+                          size_t len, int qos, uint32_t *seq_out) {
+    if (spool == NULL || spool->fp == NULL || topic == NULL) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    size_t topic_len = strlen(topic);
+    uint64_t size = (uint64_t)SPOOL_HEADER_LEN + topic_len + 1 + len;
+    if (topic_len > 0xffff || size > spool->config.max_bytes) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+
+    if (spool->file_size + size > spool->config.max_bytes) {
+        // 先丢弃最早的尚未补发的消息，已交给发送队列的等待确认
+        while (spool->live_bytes + size > spool->config.max_bytes && spool->cursor < spool->count) {
+            _spool_entry_remove(spool, spool->cursor);
+            spool->dropped++;
+        }
+        if (spool->live_bytes + size > spool->config.max_bytes) {
+            return VOLC_ERR_MQTT_PUB_QUEUE_FULL;
+        }
+        int ret = _spool_compact(spool);
+        if (ret != VOLC_OK) {
+            return ret;
+        }
+    }
+
+    iot_mqtt_spool_entry_t entry = {
+        .seq = spool->next_seq,
+        .timestamp = _spool_now(spool),
+        .offset = spool->file_size,
+        .size = (uint32_t)size,
+        .qos = (uint8_t)(qos ? 1 : 0),
+    };
+    if (_spool_entry_add(spool, &entry) != VOLC_OK) {
+        return VOLC_ERR_MALLOC;
+    }
+    int ret = _spool_write_record(spool, SPOOL_REC_PUBLISH, entry.qos, entry.seq,
+        topic, (uint16_t)topic_len, payload, (uint32_t)len);
+    if (ret != VOLC_OK) {
+        // 去掉写了一半的残尾
+        _spool_entry_remove(spool, spool->count - 1);
+        _spool_compact(spool);
+        return ret;
+    }
+    spool->next_seq++;
+    if (seq_out != NULL) {
+        *seq_out = entry.seq;
+    }
+    return VOLC_OK;
+}
+
+size_t iot_mqtt_spool_pending(const iot_mqtt_spool_t *spool) {
+    return spool != NULL ? spool->count - spool->cursor : 0;
+}
+
+static int _spool_consume_idx(iot_mqtt_spool_t *spool, size_t idx) {
+    uint32_t seq = spool->entries[idx].seq;
+    _spool_entry_remove(spool, idx);
+    int ret = _spool_write_record(spool, SPOOL_REC_CONSUMED, 0, seq, NULL, 0, NULL, 0);
+    // 已送达的记录占一半以上且超过上限的一半时压缩
+    if (ret == VOLC_OK && spool->file_size > spool->config.max_bytes / 2 &&
+        spool->live_bytes < spool->file_size / 2) {
+        ret = _spool_compact(spool);
+    }
+    return ret;
+}
+
+int iot_mqtt_spool_next(iot_mqtt_spool_t *spool, uint32_t *seq, const char **topic,
+                        const uint8_t **payload, size_t *len, int *qos) {
+    if (spool == NULL || spool->fp == NULL) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    uint32_t now = _spool_now(spool);
+    while (spool->cursor < spool->count) {
+        iot_mqtt_spool_entry_t *e = &spool->entries[spool->cursor];
+        uint32_t retention = spool->config.retention_s[e->qos];
+        if ((retention > 0 && now > e->timestamp && now - e->timestamp > retention) ||
+            _spool_read_record(spool, e->offset, e->size) != VOLC_OK) {
+            // 超过保留时长，或文件被外部损坏
+            _spool_consume_idx(spool, spool->cursor);
+            spool->dropped++;
+            continue;
+        }
+        uint16_t topic_len = _get_u16(spool->scratch + 12);
+        *seq = e->seq;
+        *qos = e->qos;
+        *topic = (const char *)spool->scratch + SPOOL_HEADER_LEN;
+        *payload = spool->scratch + SPOOL_HEADER_LEN + topic_len + 1;
+        *len = _get_u32(spool->scratch + 14);
+        spool->cursor++;
+        return VOLC_OK;
+    }
+    return VOLC_ERR_INVALID_PARAM;
+}
+
+int iot_mqtt_spool_unget(iot_mqtt_spool_t *spool, uint32_t seq) {
+    if (spool == NULL || spool->cursor == 0 || spool->entries[spool->cursor - 1].seq != seq) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    spool->cursor--;
+    return VOLC_OK;
+}
+
+int iot_mqtt_spool_consume(iot_mqtt_spool_t *spool, uint32_t seq) {
+    if (spool == NULL || spool->fp == NULL) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    bool found;
+    size_t idx = _spool_find(spool, seq, &found);
+    if (!found) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    return _spool_consume_idx(spool, idx);
+}
+
+#endif // ONESDK_ENABLE_IOT
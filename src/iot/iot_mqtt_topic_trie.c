@@ -0,0 +1,376 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "onesdk_config.h"
+#ifdef ONESDK_ENABLE_IOT
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "iot/iot_mqtt_topic_trie.h"
+#include "error_code.h"
+
+struct iot_mqtt_topic_node {
+    iot_mqtt_topic_node_t *parent;
+    iot_mqtt_topic_node_t **children;   // 普通层级，按level排序，二分查找
+    size_t child_count;
+    size_t child_cap;
+    iot_mqtt_topic_node_t *plus;        // '+'
+    iot_mqtt_topic_node_t *hash;        // '#'
+    void **values;
+    size_t value_count;
+    size_t value_cap;
+    size_t level_len;
+    char level[];
+};
+
+typedef struct {
+    iot_mqtt_topic_visit_cb cb;
+    void *userdata;
+    size_t hits;
+} _topic_match_ctx_t;
+
+// 取当前一级，返回其长度；*next指向下一级起点，已是最后一级时为NULL
+static size_t _next_level(const char *s, const char *end, const char **next) {
+    const char *slash = memchr(s, '/', (size_t)(end - s));
+    if (slash == NULL) {
+        *next = NULL;
+        return (size_t)(end - s);
+    }
+    *next = slash + 1;
+    return (size_t)(slash - s);
+}
+
+static bool _is_wildcard(const char *level, size_t len, char wildcard) {
+    return len == 1 && level[0] == wildcard;
+}
+
+static int _level_cmp(const iot_mqtt_topic_node_t *node, const char *level, size_t len) {
+    size_t n = node->level_len < len ? node->level_len : len;
+    int c = memcmp(node->level, level, n);
+    if (c != 0) {
+        return c;
+    }
+    return node->level_len < len ? -1 : (node->level_len > len ? 1 : 0);
+}
+
+// 返回level在children中的位置，未找到时为应插入的位置
+static size_t _child_pos(const iot_mqtt_topic_node_t *node, const char *level, size_t len, bool *found) {
+    size_t lo = 0;
+    size_t hi = node->child_count;
+    *found = false;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int c = _level_cmp(node->children[mid], level, len);
+        if (c == 0) {
+            *found = true;
+            return mid;
+        }
+        if (c < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static iot_mqtt_topic_node_t *_node_new(iot_mqtt_topic_node_t *parent, const char *level, size_t len) {
+    iot_mqtt_topic_node_t *node = (iot_mqtt_topic_node_t *)calloc(1, sizeof(iot_mqtt_topic_node_t) + len + 1);
+    if (node == NULL) {
+        return NULL;
+    }
+    node->parent = parent;
+    node->level_len = len;
+    memcpy(node->level, level, len);
+    return node;
+}
+
+static iot_mqtt_topic_node_t *_node_child(iot_mqtt_topic_node_t *node, const char *level, size_t len, bool create) {
+    iot_mqtt_topic_node_t **slot = NULL;
+    if (_is_wildcard(level, len, '+')) {
+        slot = &node->plus;
+    } else if (_is_wildcard(level, len, '#')) {
+        slot = &node->hash;
+    }
+    if (slot != NULL) {
+        if (*slot == NULL && create) {
+            *slot = _node_new(node, level, len);
+        }
+        return *slot;
+    }
+
+    bool found;
+    size_t pos = _child_pos(node, level, len, &found);
+    if (found) {
+        return node->children[pos];
+    }
+    if (!create) {
+        return NULL;
+    }
+    if (node->child_count == node->child_cap) {
+        size_t cap = node->child_cap ? node->child_cap * 2 : 4;
+        iot_mqtt_topic_node_t **children = (iot_mqtt_topic_node_t **)realloc(node->children,
+            cap * sizeof(iot_mqtt_topic_node_t *));
+        if (children == NULL) {
+            return NULL;
+        }
+        node->children = children;
+        node->child_cap = cap;
+    }
+    iot_mqtt_topic_node_t *child = _node_new(node, level, len);
+    if (child == NULL) {
+        return NULL;
+    }
+    memmove(&node->children[pos + 1], &node->children[pos],
+        (node->child_count - pos) * sizeof(iot_mqtt_topic_node_t *));
+    node->children[pos] = child;
+    node->child_count++;
+    return child;
+}
+
+static bool _node_empty(const iot_mqtt_topic_node_t *node) {
+    return node->value_count == 0 && node->child_count == 0 && node->plus == NULL && node->hash == NULL;
+}
+
+static void _node_free(iot_mqtt_topic_node_t *node, iot_mqtt_topic_visit_cb free_value, void *userdata) {
+    if (node == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < node->child_count; i++) {
+        _node_free(node->children[i], free_value, userdata);
+    }
+    _node_free(node->plus, free_value, userdata);
+    _node_free(node->hash, free_value, userdata);
+    if (free_value != NULL) {
+        for (size_t i = 0; i < node->value_count; i++) {
+            free_value(node->values[i], userdata);
+        }
+    }
+    free(node->children);
+    free(node->values);
+    free(node);
+}
+
+// 自下而上回收不再挂值也没有子节点的节点，根节点保留
+static void _node_prune(iot_mqtt_topic_node_t *node) {
+    while (node->parent != NULL && _node_empty(node)) {
+        iot_mqtt_topic_node_t *parent = node->parent;
+        if (parent->plus == node) {
+            parent->plus = NULL;
+        } else if (parent->hash == node) {
+            parent->hash = NULL;
+        } else {
+            bool found;
+            size_t pos = _child_pos(parent, node->level, node->level_len, &found);
+            memmove(&parent->children[pos], &parent->children[pos + 1],
+                (parent->child_count - pos - 1) * sizeof(iot_mqtt_topic_node_t *));
+            parent->child_count--;
+        }
+        _node_free(node, NULL, NULL);
+        node = parent;
+    }
+}
+
+static iot_mqtt_topic_node_t *_node_lookup(iot_mqtt_topic_trie_t *trie, const char *filter) {
+    const char *end = filter + strlen(filter);
+    const char *p = filter;
+    iot_mqtt_topic_node_t *node = trie->root;
+    while (p != NULL && node != NULL) {
+        const char *next;
+        size_t len = _next_level(p, end, &next);
+        node = _node_child(node, p, len, false);
+        p = next;
+    }
+    return node;
+}
+
+int iot_mqtt_topic_trie_init(iot_mqtt_topic_trie_t *trie) {
+    if (trie == NULL) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    trie->count = 0;
+    trie->root = _node_new(NULL, "", 0);
+    return trie->root != NULL ? VOLC_OK : VOLC_ERR_MALLOC;
+}
+
+void iot_mqtt_topic_trie_deinit(iot_mqtt_topic_trie_t *trie, iot_mqtt_topic_visit_cb free_value, void *userdata) {
+    if (trie == NULL) {
+        return;
+    }
+    _node_free(trie->root, free_value, userdata);
+    trie->root = NULL;
+    trie->count = 0;
+}
+
+bool iot_mqtt_topic_filter_valid(const char *filter) {
+    if (filter == NULL || filter[0] == '\0' || strlen(filter) > 0xffff) {
+        return false;
+    }
+    const char *end = filter + strlen(filter);
+    const char *p = filter;
+    while (p != NULL) {
+        const char *next;
+        size_t len = _next_level(p, end, &next);
+        for (size_t i = 0; i < len; i++) {
+            if ((p[i] == '+' || p[i] == '#') && len != 1) {
+                return false;
+            }
+        }
+        if (_is_wildcard(p, len, '#') && next != NULL) {
+            return false;
+        }
+        p = next;
+    }
+    return true;
+}
+
+int iot_mqtt_topic_trie_insert(iot_mqtt_topic_trie_t *trie, const char *filter, void *value) {
+    if (trie == NULL || trie->root == NULL || !iot_mqtt_topic_filter_valid(filter)) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    const char *end = filter + strlen(filter);
+    const char *p = filter;
+    iot_mqtt_topic_node_t *node = trie->root;
+    while (p != NULL) {
+        const char *next;
+        size_t len = _next_level(p, end, &next);
+        iot_mqtt_topic_node_t *child = _node_child(node, p, len, true);
+        if (child == NULL) {
+            _node_prune(node);
+            return VOLC_ERR_MALLOC;
+        }
+        node = child;
+        p = next;
+    }
+    if (node->value_count == node->value_cap) {
+        size_t cap = node->value_cap ? node->value_cap * 2 : 1;
+        void **values = (void **)realloc(node->values, cap * sizeof(void *));
+        if (values == NULL) {
+            _node_prune(node);
+            return VOLC_ERR_MALLOC;
+        }
+        node->values = values;
+        node->value_cap = cap;
+    }
+    node->values[node->value_count++] = value;
+    trie->count++;
+    return VOLC_OK;
+}
+
+void *iot_mqtt_topic_trie_find(iot_mqtt_topic_trie_t *trie, const char *filter) {
+    if (trie == NULL || filter == NULL) {
+        return NULL;
+    }
+    iot_mqtt_topic_node_t *node = _node_lookup(trie, filter);
+    return node != NULL && node->value_count > 0 ? node->values[0] : NULL;
+}
+
+int iot_mqtt_topic_trie_remove(iot_mqtt_topic_trie_t *trie, const char *filter, void *value) {
+    if (trie == NULL || filter == NULL) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    iot_mqtt_topic_node_t *node = _node_lookup(trie, filter);
+    if (node == NULL) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    for (size_t i = 0; i < node->value_count; i++) {
+        if (node->values[i] == value) {
+            memmove(&node->values[i], &node->values[i + 1], (node->value_count - i - 1) * sizeof(void *));
+            node->value_count--;
+            trie->count--;
+            _node_prune(node);
+            return VOLC_OK;
+        }
+    }
+    return VOLC_ERR_INVALID_PARAM;
+}
+
+static void _match_emit(const iot_mqtt_topic_node_t *node, _topic_match_ctx_t *m) {
+    for (size_t i = 0; i < node->value_count; i++) {
+        m->cb(node->values[i], m->userdata);
+    }
+    m->hits += node->value_count;
+}
+
+// node已匹配topic的前几级，p指向下一级
+static void _match_level(const iot_mqtt_topic_node_t *node, const char *p, const char *end,
+                         bool first, _topic_match_ctx_t *m) {
+    const char *next;
+    size_t len = _next_level(p, end, &next);
+    // '$'开头的系统topic不参与首级通配
+    bool wildcard_ok = !(first && len > 0 && p[0] == '$');
+
+    const iot_mqtt_topic_node_t *candidates[2] = {NULL, NULL};
+    if (wildcard_ok) {
+        if (node->hash != NULL) {
+            _match_emit(node->hash, m);
+        }
+        candidates[0] = node->plus;
+    }
+    bool found;
+    size_t pos = _child_pos(node, p, len, &found);
+    if (found) {
+        candidates[1] = node->children[pos];
+    }
+
+    for (int i = 0; i < 2; i++) {
+        const iot_mqtt_topic_node_t *child = candidates[i];
+        if (child == NULL) {
+            continue;
+        }
+        if (next != NULL) {
+            _match_level(child, next, end, false, m);
+            continue;
+        }
+        // 已到最后一级，"a/#"同样匹配"a"
+        _match_emit(child, m);
+        if (child->hash != NULL) {
+            _match_emit(child->hash, m);
+        }
+    }
+}
+
+size_t iot_mqtt_topic_trie_match(iot_mqtt_topic_trie_t *trie, const char *topic, size_t topic_len,
+                                 iot_mqtt_topic_visit_cb cb, void *userdata) {
+    if (trie == NULL || trie->root == NULL || topic == NULL || topic_len == 0 || cb == NULL) {
+        return 0;
+    }
+    _topic_match_ctx_t m = {cb, userdata, 0};
+    _match_level(trie->root, topic, topic + topic_len, true, &m);
+    return m.hits;
+}
+
+static void _node_foreach(const iot_mqtt_topic_node_t *node, iot_mqtt_topic_visit_cb cb, void *userdata) {
+    if (node == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < node->value_count; i++) {
+        cb(node->values[i], userdata);
+    }
+    for (size_t i = 0; i < node->child_count; i++) {
+        _node_foreach(node->children[i], cb, userdata);
+    }
+    _node_foreach(node->plus, cb, userdata);
+    _node_foreach(node->hash, cb, userdata);
+}
+
+void iot_mqtt_topic_trie_foreach(iot_mqtt_topic_trie_t *trie, iot_mqtt_topic_visit_cb cb, void *userdata) {
+    if (trie == NULL || cb == NULL) {
+        return;
+    }
+    _node_foreach(trie->root, cb, userdata);
+}
+
+#endif // ONESDK_ENABLE_IOT
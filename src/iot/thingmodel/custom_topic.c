@@ -118,6 +118,71 @@ int32_t tm_sub_custom_topic(void *handler, const char *topic_suffix) {
     return 0;
 }
 
+// 经路由注册的过滤器的MQTT回调，pUserData为该过滤器的订阅
+static void _tm_recv_custom_topic_routed(const char* topic, const uint8_t *payload, size_t len, void *pUserData) {
+    iot_tm_custom_router_dispatch((iot_tm_custom_sub_t *) pUserData, topic, strlen(topic), payload, len);
+}
+
+static int32_t _tm_custom_router_enable(iot_tm_handler_t *dm_handle) {
+    // 多个线程可能同时首次注册，复用handler的锁
+    int32_t ret = VOLC_OK;
+    platform_mutex_lock(dm_handle->topic_table_mutex);
+    if (dm_handle->custom_router == NULL) {
+        iot_tm_custom_router_t *router = (iot_tm_custom_router_t *) malloc(sizeof(iot_tm_custom_router_t));
+        if (router == NULL) {
+            ret = VOLC_ERR_MALLOC;
+        } else if ((ret = iot_tm_custom_router_init(router)) != VOLC_OK) {
+            free(router);
+        } else {
+            dm_handle->custom_router = router;
+        }
+    }
+    platform_mutex_unlock(dm_handle->topic_table_mutex);
+    return ret;
+}
+
+int32_t iot_tm_custom_topic_register(iot_tm_handler_t *handle, const char *suffix_pattern, uint32_t flags,
+                                     iot_tm_custom_topic_handler_t handler, void *userdata) {
+    if (NULL == handle || NULL == handle->mqtt_handle || NULL == suffix_pattern || NULL == handler) {
+        return VOLC_ERR_NULL_POINTER;
+    }
+    int32_t ret = _tm_custom_router_enable(handle);
+    if (ret != VOLC_OK) {
+        return ret;
+    }
+    const iot_basic_config_t *config = handle->mqtt_handle->config->basic_config;
+    char scratch[IOT_TM_TOPIC_SCRATCH_SIZE];
+    char *heap = NULL;
+    const char *topic = iot_tm_topic_format(scratch, sizeof(scratch), &heap, "sys/%s/%s/custom/%s",
+                                            config->product_key, config->device_name, suffix_pattern, NULL, NULL);
+    if (topic == NULL) {
+        return VOLC_ERR_MALLOC;
+    }
+    // 已由tm_sub_custom_topic订阅的过滤器，MQTT层不会再挂路由的回调
+    if (iot_tm_custom_router_find(handle->custom_router, suffix_pattern) == NULL &&
+        iot_mqtt_topic_trie_find(&handle->mqtt_handle->sub_topics, topic) != NULL) {
+        free(heap);
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    iot_tm_custom_sub_t *sub = NULL;
+    ret = iot_tm_custom_router_add(handle->custom_router, suffix_pattern, flags, handler, userdata, &sub);
+    if (ret == VOLC_OK && sub != NULL) {
+        // 每个过滤器只订阅一次，同一过滤器的其他处理函数由路由分发
+        ret = iot_mqtt_subscribe(handle->mqtt_handle, &(iot_mqtt_topic_map_t){
+            .topic = topic,
+            .message_callback = _tm_recv_custom_topic_routed,
+            .user_data = (void*)sub,
+            .qos = IOT_MQTT_QOS1,
+        });
+        if (ret != VOLC_OK) {
+            // 没有订阅成功的过滤器收不到消息，撤销路由以便重新注册
+            iot_tm_custom_router_remove_sub(handle->custom_router, sub);
+        }
+    }
+    free(heap);
+    return ret;
+}
+
 void _tm_recv_custom_topic(const char* topic, const uint8_t *payload, size_t len, void *pUserData) {
     struct aws_byte_cursor topic_byte_cursor = aws_byte_cursor_from_array(topic, strlen(topic));
     struct aws_byte_cursor payload_byte_cursor = aws_byte_cursor_from_array(payload, len);
@@ -22,6 +22,7 @@
 #include "thing_model/device_delay.h"
 #include "iot/iot_utils.h"
 #include "error_code.h"
+#include "util/json_writer.h"
 
 // static void _device_delay_mqtt_event_callback(void *pclient, MQTTEventType event_type, void *user_data)
 // {
@@ -120,4 +121,68 @@ int32_t _tm_send_device_delay_reply_data(void *handler, struct aws_byte_cursor *
     aws_string_destroy_secure(device_name);
     return ret;
 }
-#endif
\ No newline at end of file
+
+// RTT统计作为一个对象属性上报，单位毫秒
+static int32_t _tm_rtt_report(iot_tm_handler_t *handle, const char *identifier) {
+    iot_mqtt_rtt_stats_t stats;
+    int32_t ret = iot_mqtt_get_rtt_stats(handle->mqtt_handle, &stats);
+    if (ret != VOLC_OK || stats.count == 0) {
+        return ret;
+    }
+    char value[192];
+    struct aws_byte_buf value_buf = aws_byte_buf_from_empty_array(value, sizeof(value));
+    json_writer_t w;
+    json_writer_init(&w, &value_buf);
+    json_writer_begin_object(&w);
+    json_writer_kv_double(&w, "P50", stats.p50_us / 1000.0);
+    json_writer_kv_double(&w, "P90", stats.p90_us / 1000.0);
+    json_writer_kv_double(&w, "P99", stats.p99_us / 1000.0);
+    json_writer_kv_int(&w, "Count", (int64_t) stats.count);
+    json_writer_kv_int(&w, "Lost", (int64_t) stats.lost);
+    json_writer_end_object(&w);
+    ret = json_writer_finish(&w);
+    if (ret != VOLC_OK) {
+        return ret;
+    }
+
+    iot_tm_msg_property_post_t *property_post = NULL;
+    iot_property_post_init(&property_post);
+    if (property_post == NULL) {
+        return VOLC_ERR_MALLOC;
+    }
+    iot_property_post_add_param_json_str(property_post, identifier, value);
+    iot_tm_msg_t msg = {0};
+    msg.type = IOT_TM_MSG_PROPERTY_POST;
+    msg.data.property_post = property_post;
+    ret = iot_tm_send(handle, &msg);
+    iot_property_post_free(property_post);
+    LOGD(TAG_IOT_MQTT, "_tm_rtt_report %s = %s, ret = %d", identifier, value, ret);
+    return ret;
+}
+
+int32_t _tm_rtt_probe_poll(iot_tm_handler_t *handle, uint64_t now_ms) {
+    iot_tm_rtt_probe_t *probe = &handle->rtt_probe;
+    int32_t next = -1;
+    if (probe->interval_ms > 0) {
+        // 探测即时间同步请求，回复同时加入时钟采样
+        if (now_ms >= probe->next_ms) {
+            tm_send_device_npt_request(handle);
+            probe->next_ms = now_ms + probe->interval_ms;
+        }
+        uint64_t wait_ms = probe->next_ms - now_ms;
+        next = wait_ms > INT32_MAX ? INT32_MAX : (int32_t) wait_ms;
+    }
+    if (probe->report_identifier != NULL) {
+        if (now_ms >= probe->next_report_ms) {
+            _tm_rtt_report(handle, probe->report_identifier);
+            probe->next_report_ms = now_ms + probe->report_interval_ms;
+        }
+        uint64_t wait_ms = probe->next_report_ms - now_ms;
+        int32_t report_next = wait_ms > INT32_MAX ? INT32_MAX : (int32_t) wait_ms;
+        if (next < 0 || report_next < next) {
+            next = report_next;
+        }
+    }
+    return next;
+}
+#endif
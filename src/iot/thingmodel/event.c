@@ -42,7 +42,8 @@ void iot_tm_msg_event_post_init(iot_tm_msg_event_post_t **event_post, const char
     event->version = SDK_VERSION;
     event->module_key = moduleKey;
     event->identifier = identifier;
-    event->params = (void*) aws_json_value_new_object(alloc);
+    event->params = (void*) iot_tm_members_new();
+    event->payloadRoot = NULL;
     *event_post = event;
 }
 
@@ -50,22 +51,35 @@ void iot_tm_msg_event_post_init(iot_tm_msg_event_post_t **event_post, const char
  *  向 aiot_tm_msg_event_post_t.params json 中 添加 value 为 int  的数据
  */
 void iot_tm_msg_event_post_param_add_num(iot_tm_msg_event_post_t *event_post, char *key, double value) {
-
-    aws_json_add_num_val1(aws_alloc(), (struct aws_json_value*)event_post->params, key, value);
+    iot_tm_members_t *params = (iot_tm_members_t *) event_post->params;
+    json_writer_t *w = iot_tm_members_begin(params, key);
+    if (w == NULL) {
+        return;
+    }
+    json_writer_double(w, value);
+    iot_tm_members_end(params);
 }
 
 /**
  *  向 aiot_tm_msg_event_post_t.params json 中 添加 value 为 string  的数据
  */
 void iot_tm_msg_event_post_param_add_string(iot_tm_msg_event_post_t *event_post, char *key, char *value) {
-    aws_json_add_str_val_1(aws_alloc(), (struct aws_json_value*)event_post->params, key, value);
+    iot_tm_members_t *params = (iot_tm_members_t *) event_post->params;
+    if (value == NULL) {
+        return;
+    }
+    json_writer_t *w = iot_tm_members_begin(params, key);
+    if (w == NULL) {
+        return;
+    }
+    json_writer_string(w, value);
+    iot_tm_members_end(params);
 }
 
 void iot_tm_msg_event_post_set_prams_json_str(iot_tm_msg_event_post_t *event_post, char *param_json_str) {
-    if (event_post->params != NULL) {
-        aws_json_value_destroy((struct aws_json_value*)event_post->params);
+    if (iot_tm_members_set_json_str((iot_tm_members_t *) event_post->params, param_json_str) != VOLC_OK) {
+        LOGW(TAG_IOT_MQTT, "event params is not a json object: %s", param_json_str ? param_json_str : "(null)");
     }
-    event_post->params = (void*) aws_json_value_new_from_string(aws_alloc(), aws_byte_cursor_from_c_str(param_json_str));
 }
 
 /**
@@ -74,30 +88,55 @@ void iot_tm_msg_event_post_set_prams_json_str(iot_tm_msg_event_post_t *event_pos
 void iot_tm_msg_event_post_free(iot_tm_msg_event_post_t *event_post) {
     if (event_post->payloadRoot != NULL) {
         aws_json_value_destroy((struct aws_json_value*)event_post->payloadRoot);
-    } else if (event_post->params != NULL) {
-        aws_json_value_destroy((struct aws_json_value*)event_post->params);
     }
+    iot_tm_members_destroy((iot_tm_members_t *) event_post->params);
     aws_mem_release(aws_alloc(), event_post);
 }
 
+iot_mqtt_buf_t *_tm_event_post_payload_buf(iot_tm_msg_event_post_t *event) {
+    iot_tm_members_t *params = (iot_tm_members_t *) event->params;
+    if (params == NULL || params->error != VOLC_OK) {
+        return NULL;
+    }
+    // {"ID":"...","Version":"...","Params":{"Time":123,"Value":{...}}}
+    size_t cap = iot_tm_json_str_bound(event->id) + iot_tm_json_str_bound(event->version) + params->buf.len + 64;
+    json_writer_t w;
+    struct aws_byte_buf view;
+    iot_mqtt_buf_t *buf = iot_tm_payload_begin(&w, &view, cap);
+    if (buf == NULL) {
+        return NULL;
+    }
+    json_writer_begin_object(&w);
+    if (event->id != NULL) {
+        json_writer_kv_string(&w, "ID", event->id);
+    }
+    if (event->version != NULL) {
+        json_writer_kv_string(&w, "Version", event->version);
+    }
+    json_writer_key(&w, "Params");
+    json_writer_begin_object(&w);
+    json_writer_kv_int(&w, "Time", (int64_t) iot_now_ms());
+    json_writer_key(&w, "Value");
+    iot_tm_members_write(params, &w);
+    json_writer_end_object(&w);
+    json_writer_end_object(&w);
+    return iot_tm_payload_finish(&w, &view, buf);
+}
+
 /**
- * aiot_tm_msg_event_post_t 转换成 mqtt payload 数据
+ * aiot_tm_msg_event_post_t 转换成 mqtt payload 数据，兼容旧接口，发送路径直接使用_tm_event_post_payload_buf
  */
 void* iot_tm_msg_event_post_payload(iot_tm_msg_event_post_t *event) {
     if (event->payloadRoot != NULL) {
         aws_json_value_destroy((struct aws_json_value* )event->payloadRoot);
+        event->payloadRoot = NULL;
     }
-    event->payloadRoot = (void*) aws_json_value_new_object(aws_alloc());
-//    struct aws_string *time_str = get_date_format_iso_8601_data_str(aws_alloc());
-    aws_json_add_str_val_1(aws_alloc(), (struct aws_json_value*)event->payloadRoot, "ID", event->id);
-    aws_json_add_str_val_1(aws_alloc(), (struct aws_json_value*)event->payloadRoot, "Version", event->version);
-//    aws_json_add_aws_string_val1(aws_alloc(), (struct aws_json_value*)event->payloadRoot, "time", time_str);
-
-    struct aws_json_value *params = aws_json_value_new_object(aws_alloc());
-    aws_json_add_num_val1(aws_alloc(), params, "Time", (double) get_current_time_mil());
-    aws_json_add_json_obj(params, "Value", (struct aws_json_value*)event->params);
-
-    aws_json_add_json_obj((struct aws_json_value*) event->payloadRoot, "Params", params);
+    iot_mqtt_buf_t *buf = _tm_event_post_payload_buf(event);
+    if (buf == NULL) {
+        return NULL;
+    }
+    event->payloadRoot = (void*) aws_json_value_new_from_string(aws_alloc(), aws_byte_cursor_from_array(buf->data, buf->len));
+    iot_mqtt_buf_unref(buf);
     return event->payloadRoot;
 }
 
@@ -110,25 +149,17 @@ int32_t _tm_send_event_post(void *handler, const char *topic, const void *msg_p)
     iot_tm_msg_t *msg = (iot_tm_msg_t *) msg_p;
 
     int ret = VOLC_OK;
-    struct aws_byte_buf payload_buf = aws_json_obj_to_byte_buf(dm_handle->allocator, (struct aws_json_value* )iot_tm_msg_event_post_payload(msg->data.event_post));
-    struct aws_byte_cursor payload_cur = aws_byte_cursor_from_buf(&payload_buf);
-    // struct aws_byte_cursor public_topic = aws_byte_cursor_from_c_str(topic);
-    // uint16_t packet_id = aws_mqtt_client_connection_publish(dm_handle->mqtt_handle->mqtt_connection, &public_topic,
-    //                                                         AWS_MQTT_QOS_AT_MOST_ONCE, false, &payload_cur,
-    //                                                         _tm_mqtt_post_on_complete_fn,
-    //                                                         NULL);
-    // PublishParams pubParams = DEFAULT_PUB_PARAMS;
-    // pubParams.qos           = QOS1;
-    // pubParams.payload_len   = payload_cur.len;
-    // pubParams.payload       = (void *)payload_cur.ptr;
-    // int packet_id = IOT_MQTT_Publish(dm_handle->mqtt_client, topic, &pubParams);
-    iot_mqtt_publish(dm_handle->mqtt_handle, topic, (uint8_t *)payload_cur.ptr, payload_cur.len, IOT_MQTT_QOS1);
-
-    LOGD(TAG_IOT_MQTT, "_tm_send_event_post call topic = %.*s, payload = %.*s", topic,
-        AWS_BYTE_CURSOR_PRI(payload_cur));
-
-    // 回收内存数据
-    aws_byte_buf_clean_up(&payload_buf);
+    iot_mqtt_buf_t *payload_buf = _tm_event_post_payload_buf(msg->data.event_post);
+    if (payload_buf == NULL) {
+        return VOLC_ERR_MALLOC;
+    }
+
+    LOGD(TAG_IOT_MQTT, "_tm_send_event_post call topic = %s, payload = %.*s", topic,
+        (int) payload_buf->len, (const char *) payload_buf->data);
+    ret = iot_mqtt_publish_buf(dm_handle->mqtt_handle, topic, payload_buf, IOT_MQTT_QOS1);
+
+    // 发布持有自己的引用，送达后释放
+    iot_mqtt_buf_unref(payload_buf);
     return ret;
 }
 
@@ -141,6 +172,7 @@ void _tm_recv_event_post_reply(const char* topic, const uint8_t *payload, size_t
         AWS_BYTE_CURSOR_PRI(topic_byte_cursor), 
         AWS_BYTE_CURSOR_PRI(payload_byte_cursor));
     iot_tm_handler_t *dm_handle = (iot_tm_handler_t *) pUserData;
+    _tm_pending_on_reply(dm_handle, payload, len);
     if (NULL == dm_handle->recv_handler) {
         return;
     }
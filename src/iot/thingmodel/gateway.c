@@ -1,1702 +1,1083 @@
-// /*
-//  * Copyright 2022-2024 Beijing Volcano Engine Technology Ltd.
-//  *
-//  * Licensed under the Apache License, Version 2.0 (the "License");
-//  * you may not use this file except in compliance with the License.
-//  * You may obtain a copy of the License at
-//  *
-//  *    http://www.apache.org/licenses/LICENSE-2.0
-//  *
-//  * Unless required by applicable law or agreed to in writing, software
-//  * distributed under the License is distributed on an "AS IS" BASIS,
-//  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
-//  * See the License for the specific language governing permissions and
-//  * limitations under the License.
-//  */
-
-// #include "thing_model/gateway.h"
-// #include <ctype.h>
-
-// #include "iot/iot_utils.h"
-// #include "iot_log.h"
-// #include "util/util.h"
-// #include "aws/common/string.h"
-// #include "aws/common/json.h"
-// #include "util/aws_json.h"
-
-// #include "thing_model/iot_tm_api.h"
-// #include "thing_model/iot_tm_header.h"
-
-// void iot_gateway_add_topo_init(iot_tm_msg_gateway_add_topo_t** pty) {
-//     iot_tm_msg_gateway_add_topo_t* gatewayP = (iot_tm_msg_gateway_add_topo_t*)malloc(sizeof(iot_tm_msg_gateway_add_topo_t));
-//     const char* id = get_random_string_with_time_suffix(aws_alloc());
-//     gatewayP->id = id;
-//     gatewayP->version = SDK_VERSION;
-//     gatewayP->gateway_topo_list = (void*) aws_json_value_new_array(aws_alloc());
-//     *pty = gatewayP;
-// }
-
-// bool _check_device_name_legality(const char* device_name) {
-//     return device_name != NULL && strlen(device_name) <= 32 && strspn(device_name, "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_-.:@") == strlen(device_name);
-// }
-
-// void to_lowercase(const char* cstr, char* output){
-//     if (cstr == NULL) {
-//         return;
-//     }
-//     int len = sizeof(cstr)/ sizeof (char);
-//     for (int i=0; i < len; ++i ) {
-//         output[i] = tolower(*cstr++);
-//     }
-// }
-
-// int32_t iot_gateway_add_topo_item(iot_tm_msg_gateway_add_topo_t* pty, const char* device_name,const char* product_key, const char* product_secret) {
-//     if (!_check_device_name_legality(device_name)) {
-//         return -1;
-//     }
-//     struct aws_json_value* gateway_topo_list = (struct aws_json_value* )pty->gateway_topo_list;
-//     struct aws_json_value* gateway_topo_item = aws_json_value_new_object(aws_alloc());
-//     aws_json_add_str_val(gateway_topo_item, "device_name", device_name);
-//     aws_json_add_str_val(gateway_topo_item, "product_key", product_key);
-//     aws_json_add_str_val(gateway_topo_item, "product_secret", product_secret);
-//     aws_json_add_array_element(gateway_topo_list, gateway_topo_item);
-//     return 0;
-// }
-
-// void* iot_gateway_add_topo_payload(iot_tm_msg_gateway_add_topo_t* pty) {
-//     if (pty->payload_root == NULL) {
-//         pty->payload_root = (struct aws_json_value*) aws_json_value_new_object(aws_alloc());
-//         aws_json_add_str_val((struct aws_json_value*) pty->payload_root, "ID", pty->id);
-//         aws_json_add_str_val((struct aws_json_value*) pty->payload_root, "Version", pty->version);
-//         struct aws_json_value* params =  aws_json_value_new_array(aws_alloc());
-
-//         // add sub params
-//         for (int i = 0; i < aws_json_get_array_size(((struct aws_json_value*) pty->gateway_topo_list)); ++i) {
-//             struct aws_json_value* gate_topo_item = aws_json_get_array_element(((struct aws_json_value*) pty->gateway_topo_list), i);
-
-//             uint32_t random_num = random_num();
-// //            get_random_num_uint32(&random_num);
-//             uint64_t time_stamp = get_current_time_sec();
-//             struct aws_string* device_name =  aws_json_get_string1_val(aws_alloc(),gate_topo_item ,"device_name");
-//             struct aws_string* product_key =  aws_json_get_string1_val(aws_alloc(),gate_topo_item ,"product_key");
-//             struct aws_string* product_secret =  aws_json_get_string1_val(aws_alloc(),gate_topo_item ,"product_secret");
-
-//             struct aws_string* signature = hmac_sha256_encrypt(aws_alloc(), (int32_t)random_num, time_stamp,
-//                                                                aws_string_c_str(device_name),
-//                                                                aws_string_c_str(product_key),
-//                                                                aws_string_c_str(product_secret));
-//             struct aws_json_value* sub_params = aws_json_value_new_object(aws_alloc());
-//             aws_json_add_str_val(sub_params, "ProductKey", aws_string_c_str(product_key));
-//             aws_json_add_str_val(sub_params, "DeviceName", aws_string_c_str(device_name));
-//             aws_json_add_num_val(sub_params, "random_num", random_num);
-//             aws_json_add_num_val(sub_params, "timestamp", (double)time_stamp);
-//             aws_json_add_str_val(sub_params, "signature", aws_string_c_str(signature));
-//             // aws_json_add_str_val method will alloc new mem for value field，so this mem can release
-//             aws_mem_release(aws_alloc(), device_name);
-//             aws_mem_release(aws_alloc(), product_key);
-//             aws_mem_release(aws_alloc(), product_secret);
-//             aws_mem_release(aws_alloc(), signature);
-//             aws_json_add_array_element(params, sub_params);
-
-//         }
-//         aws_json_add_json_obj((struct aws_json_value*) pty->payload_root, "params", params);
-
-//     }
-//     return (void*)pty->payload_root;
-// }
-
-// void iot_gateway_add_topo_item_free(struct aws_array_list gateway_topo_list) {
-//     if (gateway_topo_list.length <= 0) {
-//         return;
-//     }
-//     for (int i = 0; i < gateway_topo_list.length; ++i) {
-//         iot_tm_msg_gateway_add_topo_item_t* gateway_topo_item = malloc(sizeof(iot_tm_msg_gateway_add_topo_item_t));
-//         aws_array_list_get_at(&gateway_topo_list, gateway_topo_item ,i);
-//         if (gateway_topo_item == NULL) {
-//             continue;
-//         }
-//         if (gateway_topo_item->product_key != NULL) {
-//             aws_mem_release(aws_alloc(), (void*)gateway_topo_item->product_key);
-//         }
-//         if (gateway_topo_item->product_secret != NULL) {
-//             aws_mem_release(aws_alloc(), (void*)gateway_topo_item->product_secret);
-//         }
-//         if (gateway_topo_item->device_name != NULL) {
-//             aws_mem_release(aws_alloc(), (void*)gateway_topo_item->device_name);
-//         }
-//         free(gateway_topo_item);
-//     }
-// }
-
-// void iot_gateway_add_topo_free(iot_tm_msg_gateway_add_topo_t* pty) {
-//     if (pty == NULL) {
-//         return;
-//     }
-//     if (pty->payload_root != NULL) {
-//         aws_mem_release(aws_alloc(),(void*)pty->payload_root);
-//     }
-//     if (pty->gateway_topo_list) {
-//         aws_mem_release(aws_alloc(), (void*)pty->gateway_topo_list);
-//     }
-//     // release item
-// //    iot_gateway_add_topo_item_free(pty->gateway_topo_list);
-//     aws_mem_release(aws_alloc(), (void*)pty->id);
-//     aws_mem_release(aws_alloc(), pty);
-// }
-
-// int32_t _tm_send_gateway_add_topo(void* handler, const char* topic, const void* msg_p) {
-//     iot_tm_handler_t* dm_handle = (iot_tm_handler_t*) handler;
-//     iot_tm_msg_t* msg = (iot_tm_msg_t*) msg_p;
-//     int32_t ret = VOLC_OK;
-//     struct aws_byte_buf payload_buf = aws_json_obj_to_byte_buf(aws_alloc(), (struct aws_json_value*)iot_gateway_add_topo_payload(msg->data.gateway_add_topo));
-//     struct aws_byte_cursor payload_cur = aws_byte_cursor_from_buf(&payload_buf);
-//     // struct aws_byte_cursor public_topic = aws_byte_cursor_from_c_str(topic);
-//     // uint16_t  packet_id = aws_mqtt_client_connection_publish(dm_handle->mqtt_handle->mqtt_connection, &public_topic,
-//     //                                                          AWS_MQTT_QOS_AT_MOST_ONCE, false, &payload_cur,
-//     //                                                          _tm_mqtt_post_on_complete_fn,
-//     //                                                          NULL);
-//     PublishParams pubParams = DEFAULT_PUB_PARAMS;
-//     pubParams.qos           = QOS1;
-//     pubParams.payload_len   = payload_cur.len;
-//     pubParams.payload       = (void *)payload_cur.ptr;
-//     int packet_id = IOT_MQTT_Publish(dm_handle->mqtt_client, topic, &pubParams);
-//     LOGD(TAG_IOT_MQTT, "_tm_send_gateway_add_topo call packet_id = %d, topic = %.*s,  payload = %.*s", packet_id, topic,
-//          AWS_BYTE_CURSOR_PRI(payload_cur));
-//     aws_byte_buf_clean_up(&payload_buf);
-
-//     return ret;
-// }
-
-// void _tm_recv_gateway_add_topo_reply_handler(const char* topic, const uint8_t *payload, size_t len, void *pUserData) {
-//     struct aws_byte_cursor topic_byte_cursor = aws_byte_cursor_from_array(topic, strlen(topic));
-//     struct aws_byte_cursor payload_byte_cursor = aws_byte_cursor_from_array(payload, len);
-
-//     LOGD(TAG_IOT_MQTT, "_tm_recv_gateway_add_topo_handler call topic = %.*s,  payload = %.*s", 
-//         AWS_BYTE_CURSOR_PRI(topic_byte_cursor), 
-//         AWS_BYTE_CURSOR_PRI(payload_byte_cursor));
-//     iot_tm_handler_t* dm_handle = (iot_tm_handler_t*) pUserData;
-//     if (dm_handle == NULL) {
-//         return;
-//     }
-//     if (NULL == dm_handle->recv_handler) {
-//         return;
-//     }
-//     iot_tm_recv_t recv;
-//     AWS_ZERO_STRUCT(recv);
-//     recv.type = IOT_TM_RECV_GATEWAY_ADD_TOPO_REPLY;
-
-//     // parse product_key, device_name, module_key by topic value
-//     struct aws_array_list topic_split_data_list;
-//     aws_array_list_init_dynamic(&topic_split_data_list, dm_handle->allocator, 8,sizeof(struct aws_byte_cursor));
-//     aws_byte_cursor_split_on_char(&topic_byte_cursor, '/',&topic_split_data_list);
-
-//     struct aws_byte_cursor product_key_cur = {0};
-//     aws_array_list_get_at(&topic_split_data_list, &product_key_cur, 1);
-//     struct aws_byte_cursor device_name_cur = {0};
-//     aws_array_list_get_at(&topic_split_data_list, &device_name_cur, 2);
-//     recv.product_key = aws_cur_to_char_str(dm_handle->allocator, &product_key_cur);
-//     recv.device_name = aws_cur_to_char_str(dm_handle->allocator, &device_name_cur);
-
-//     // package business data
-//     iot_tm_msg_gateway_add_topo_reply_t gateway_add_reply;
-//     struct aws_json_value* payload_json = aws_json_value_new_from_string(dm_handle->allocator, payload_byte_cursor);
-//     //    struct aws_byte_cursor id_cur = aws_json_get_str_byte_cur_val(payload_json, "ID");
-//     double error_code = aws_json_get_num_val(payload_json, "Code");
-//     if (error_code != 0) {
-//         goto end;
-//     }
-//     struct aws_json_value* data_json = aws_json_get_json_obj(dm_handle->allocator, payload_json, "data");
-//     size_t data_size = aws_json_get_array_size(data_json);
-//     for (int i = 0; i < data_size; ++i) {
-//         struct aws_json_value* data_item = aws_json_get_array_element(data_json, i);
-//         struct aws_string* product_key = aws_json_get_string1_val(dm_handle->allocator, data_item, "ProductKey");
-//         struct aws_string* device_name = aws_json_get_string1_val(dm_handle->allocator, data_item, "DeviceName");
-//         struct aws_json_value* device_secret = aws_json_get_json_obj(dm_handle->allocator, data_item, "device_secret");
-//         struct aws_string* device_secret_payload = aws_json_get_string1_val(dm_handle->allocator, device_secret, "payload");
-//         struct aws_string* aws_string_secret = aes_decode(dm_handle->allocator, aws_string_c_str(dm_handle->mqtt_handle->device_secret),
-//                                                aws_string_c_str(device_secret_payload));
-//         const char* secret = aws_string_c_str(aws_string_secret);
-//         aws_hash_table_put(&get_iot_core_context()->device_secret_map, aws_string_c_str(get_user_name(dm_handle->allocator, product_key, device_name)),
-//                             secret, NULL);
-// //        aws_hash_table_foreach(&get_iot_core_context()->device_secret_map, mapForeach, NULL);
-
-//         // release
-//         aws_mem_release(dm_handle->allocator, product_key);
-//         aws_mem_release(dm_handle->allocator, device_name);
-//         aws_mem_release(dm_handle->allocator, device_secret);
-//         aws_mem_release(dm_handle->allocator, device_secret_payload);
-//     }
-//     if (data_json!= NULL) {
-//         aws_mem_release(dm_handle->allocator, data_json);
-//     }
-// end:
-//     // release
-//     aws_mem_release(dm_handle->allocator, payload_json);
-// }
-
-
-// void iot_gateway_delete_topo_init(iot_tm_msg_gateway_delete_topo_t** pty) {
-//     if (pty == NULL) {
-//         return;
-//     }
-//     iot_tm_msg_gateway_delete_topo_t* gatewayP = malloc( sizeof(iot_tm_msg_gateway_delete_topo_t));
-//     const char* id = get_random_string_with_time_suffix(aws_alloc());
-//     gatewayP->id = id;
-//     gatewayP->version = SDK_VERSION;
-//     gatewayP->gateway_topo_list = (void*) aws_json_value_new_array(aws_alloc());
-//     *pty = gatewayP;
-// }
-
-// void iot_gateway_delete_topo_item(iot_tm_msg_gateway_delete_topo_t* pty, const char* device_name, const char* product_key) {
-//     struct aws_json_value* gateway_detele_item = aws_json_value_new_object(aws_alloc());
-//     aws_json_add_str_val(gateway_detele_item, "product_key", product_key);
-//     aws_json_add_str_val(gateway_detele_item, "device_name", device_name);
-//     aws_json_add_array_element((struct aws_json_value*) pty->gateway_topo_list, gateway_detele_item);
-// }
-
-// void* iot_gateway_delete_topo_payload(iot_tm_msg_gateway_delete_topo_t* pty) {
-//     if (pty->payload_root == NULL) {
-//         pty->payload_root = aws_json_value_new_object(aws_alloc());
-//         aws_json_add_str_val(pty->payload_root, "ID", pty->id);
-//         aws_json_add_str_val(pty->payload_root, "Version", pty->version);
-//         struct aws_json_value* params = aws_json_value_new_array(aws_alloc());
-//         for (int i = 0; i < aws_json_get_array_size((struct aws_json_value*)pty->gateway_topo_list); ++i) {
-//             struct aws_json_value* gateway_delete_item = aws_json_get_array_element((struct aws_json_value*) pty->gateway_topo_list, i);
-
-//             struct aws_json_value* sub_params = aws_json_value_new_object(aws_alloc());
-//             struct aws_string* product_key = aws_json_get_string1_val(aws_alloc(), gateway_delete_item, "product_key");
-//             struct aws_string* device_name = aws_json_get_string1_val(aws_alloc(), gateway_delete_item, "device_name");
-//             aws_json_add_str_val(sub_params, "ProductKey", aws_string_c_str(product_key));
-//             aws_json_add_str_val(sub_params, "DeviceName", aws_string_c_str(device_name));
-//             aws_json_add_array_element(params, sub_params);
-
-//             // release
-//             aws_mem_release(aws_alloc(), device_name);
-//             aws_mem_release(aws_alloc(), product_key);
-//         }
-//         aws_json_add_json_obj(pty->payload_root, "params", params);
-//     }
-//     return pty->payload_root;
-// }
-
-// void iot_gateway_delete_topo_item_free(struct aws_array_list gateway_topo_list) {
-//     if (gateway_topo_list.length <= 0) {
-//         return;
-//     }
-//     for (int i = 0; i < gateway_topo_list.length; ++i) {
-//         iot_tm_msg_gateway_add_topo_item_t* gateway_topo_item = HAL_Malloc(sizeof(iot_tm_msg_gateway_add_topo_item_t));
-//         aws_array_list_get_at(&gateway_topo_list,gateway_topo_item,i);
-//         if (gateway_topo_item == NULL) {
-//             continue;
-//         }
-//         if (gateway_topo_item->product_key != NULL) {
-//             aws_mem_release(aws_alloc(), gateway_topo_item->product_key);
-//         }
-//         if (gateway_topo_item->device_name != NULL) {
-//             aws_mem_release(aws_alloc(), gateway_topo_item->device_name);
-//         }
-//         HAL_Free(gateway_topo_item);
-//     }
-// }
-
-// void iot_gateway_delete_topo_free(iot_tm_msg_gateway_delete_topo_t * pty) {
-//     if (pty == NULL) {
-//         return;
-//     }
-//     if (pty->payload_root != NULL) {
-//         aws_mem_release(aws_alloc(), pty->payload_root);
-//     }
-//     if (pty->gateway_topo_list != NULL) {
-//         aws_mem_release(aws_alloc(), pty->gateway_topo_list);
-//     }
-// //    iot_gateway_delete_topo_item_free(pty->gateway_topo_list);
-//     aws_mem_release(aws_alloc(), pty->id);
-//     aws_mem_release(aws_alloc(), pty);
-// }
-
-// int32_t _tm_send_gateway_delete_topo(void* handler, const char* topic, const void* msg_p) {
-//     iot_tm_handler_t* dm_handle = (iot_tm_handler_t*) handler;
-//     iot_tm_msg_t* msg = (iot_tm_msg_t*) msg_p;
-//     int32_t ret = VOLC_OK;
-//     struct aws_byte_buf payload_buf = aws_json_obj_to_byte_buf(dm_handle->allocator, ((struct aws_json_value*) iot_gateway_delete_topo_payload(msg->data.gateway_delete_topo)));
-//     struct aws_byte_cursor payload_cur = aws_byte_cursor_from_buf(&payload_buf);
-//     // struct aws_byte_cursor public_topic = aws_byte_cursor_from_c_str(topic);
-//     // uint16_t  packet_id = aws_mqtt_client_connection_publish(dm_handle->mqtt_handle->mqtt_connection, &public_topic,
-//     //                                                          AWS_MQTT_QOS_AT_MOST_ONCE, false, &payload_cur,
-//     //                                                          _tm_mqtt_post_on_complete_fn,
-//     //                                                          NULL);
-//     PublishParams pubParams = DEFAULT_PUB_PARAMS;
-//     pubParams.qos           = QOS1;
-//     pubParams.payload_len   = payload_cur.len;
-//     pubParams.payload       = (void *)payload_cur.ptr;
-//     int packet_id = IOT_MQTT_Publish(dm_handle->mqtt_client, topic, &pubParams);
-
-//     LOGD(TAG_IOT_MQTT, "_tm_send_gateway_delete_topo call packet_id = %d, topic = %.*s,  payload = %.*s", packet_id, topic,
-//          AWS_BYTE_CURSOR_PRI(payload_cur));
-//     aws_byte_buf_clean_up(&payload_buf);
-//     if (packet_id == 0) {
-//         ret = STATE_DM_MQTT_PUBLISH_ERROR;
-//     }
-//     return ret;
-// }
-
-// void _tm_recv_gateway_delete_topo_reply_handler(const char* topic, const uint8_t *payload, size_t len, void *pUserData) {
-//     struct aws_byte_cursor topic_byte_cursor = aws_byte_cursor_from_array(topic, strlen(topic));
-//     struct aws_byte_cursor payload_byte_cursor = aws_byte_cursor_from_array(payload, len);
-
-//     LOGD(TAG_IOT_MQTT, "_tm_recv_gateway_delete_topo_handler call topic = %.*s,  payload = %.*s", 
-//         AWS_BYTE_CURSOR_PRI(topic_byte_cursor), 
-//         AWS_BYTE_CURSOR_PRI(payload_byte_cursor));
-//     iot_tm_handler_t* dm_handle = (iot_tm_handler_t*) pUserData;
-//     if (dm_handle == NULL) {
-//         return;
-//     }
-//     if (NULL == dm_handle->recv_handler) {
-//         return;
-//     }
-//     iot_tm_recv_t recv;
-//     AWS_ZERO_STRUCT(recv);
-//     recv.type = IOT_TM_RECV_GATEWAY_DELETE_TOPO_REPLY;
-
-//     // parse product_key, device_name, module_key by topic value
-//     struct aws_array_list topic_split_data_list;
-//     aws_array_list_init_dynamic(&topic_split_data_list, dm_handle->allocator, 8,sizeof(struct aws_byte_cursor));
-//     aws_byte_cursor_split_on_char(&topic, '/',&topic_split_data_list);
-
-//     struct aws_byte_cursor product_key_cur = {0};
-//     aws_array_list_get_at(&topic_split_data_list, &product_key_cur, 1);
-//     struct aws_byte_cursor device_name_cur = {0};
-//     aws_array_list_get_at(&topic_split_data_list, &device_name_cur, 2);
-//     recv.product_key = aws_cur_to_char_str(dm_handle->allocator, &product_key_cur);
-//     recv.device_name = aws_cur_to_char_str(dm_handle->allocator, &device_name_cur);
-
-//     // package business data
-//     iot_tm_msg_gateway_delete_topo_reply_t gateway_delete_reply;
-//     struct aws_json_value* payload_json = aws_json_value_new_from_string(dm_handle->allocator, payload);
-//     struct aws_byte_cursor id_cur = aws_json_get_str_byte_cur_val(payload_json, "ID");
-//     const char* id = aws_cur_to_char_str(dm_handle->allocator, &id_cur);
-//     double error_code = aws_json_get_num_val(payload_json, "Code");
-//     if (error_code != 0) {
-//         goto end;
-//     }
-//     struct aws_json_value* data_json = aws_json_get_json_obj(dm_handle->allocator, payload_json, "data");
-//     if (data_json == NULL) {
-//         aws_mem_release(dm_handle->allocator, data_json);
-//         goto end;
-//     }
-//     size_t data_size = aws_json_get_array_size(data_json);
-//     for (int i = 0; i < data_size; ++i) {
-//         struct aws_json_value* data_item = aws_json_get_array_element(data_json, i);
-//         struct aws_string* product_key = aws_json_get_string1_val(dm_handle->allocator, data_item, "ProductKey");
-//         struct aws_string* device_name = aws_json_get_string1_val(dm_handle->allocator, data_item, "DeviceName");
-
-//         // unsubscript
-//         char topic[256] = { 0 };
-//         sprintf(topic, "sys/%s/%s/#", aws_string_c_str(product_key), aws_string_c_str(device_name));
-//         // iot_mqtt_unsub(dm_handle->mqtt_handle, topic, 1,
-//         //                _tm_recv_gateway_unsubscribe_topic_handler,(void*) dm_handle);
-//         IOT_MQTT_Unsubscribe(dm_handle->mqtt_client, topic);
-//         // release
-//         aws_mem_release(dm_handle->allocator, product_key);
-//         aws_mem_release(dm_handle->allocator, device_name);
-//     }
-
-//     // release
-//     aws_mem_release(dm_handle->allocator, data_json);
-//     end:
-//     aws_mem_release(dm_handle->allocator, payload_json);
-//     aws_mem_release(dm_handle->allocator, id);
-
-// }
-
-// void iot_gateway_get_topo_init(iot_tm_msg_gateway_get_topo_t** pty) {
-//     iot_gateway_get_topo_init_with_id(pty, NULL);
-// }
-
-// void iot_gateway_get_topo_init_with_id(iot_tm_msg_gateway_get_topo_t** pty, const char* id) {
-//     iot_tm_msg_gateway_get_topo_t* gatewayP = malloc( sizeof(iot_tm_msg_gateway_get_topo_t));
-//     char* real_id = id;
-//     if (id == NULL) {
-//         real_id = get_random_string_with_time_suffix(aws_alloc());
-//     }
-//     gatewayP->id = real_id;
-//     gatewayP->version = SDK_VERSION;
-//     *pty = gatewayP;
-// }
-
-// void* iot_gateway_get_topo_payload(iot_tm_msg_gateway_get_topo_t* pty) {
-//     if (pty->payload_root == NULL) {
-//         pty->payload_root = (void*) aws_json_value_new_object(aws_alloc());
-//         aws_json_add_str_val_1(aws_alloc(), (struct aws_json_value*) pty->payload_root, "ID", pty->id);
-//         aws_json_add_str_val_1(aws_alloc(), (struct aws_json_value*) pty->payload_root, "Version", pty->version);
-//     }
-//     return pty->payload_root;
-// }
-
-// void iot_gateway_get_topo_free(iot_tm_msg_gateway_get_topo_t* pty) {
-//     if (pty == NULL) {
-//         return;
-//     }
-//     if (pty->payload_root != NULL) {
-//         aws_mem_release(aws_alloc(), pty->payload_root);
-//     }
-
-//     aws_mem_release(aws_alloc(), pty->id);
-//     aws_mem_release(aws_alloc(), pty);
-// }
-
-// int32_t _tm_send_gateway_get_topo(void* handler, const char* topic, const void* msg_p) {
-//     iot_tm_handler_t* dm_handle = (iot_tm_handler_t*) handler;
-//     iot_tm_msg_t* msg = (iot_tm_msg_t*) msg_p;
-//     int32_t ret = VOLC_OK;
-//     struct aws_byte_buf payload_buf = aws_json_obj_to_byte_buf(dm_handle->allocator, ((struct aws_json_value*)iot_gateway_get_topo_payload(msg->data.gateway_get_topo)));
-//     struct aws_byte_cursor payload_cur = aws_byte_cursor_from_buf(&payload_buf);
-//     // struct aws_byte_cursor public_topic = aws_byte_cursor_from_c_str(topic);
-//     // uint16_t  packet_id = aws_mqtt_client_connection_publish(dm_handle->mqtt_handle->mqtt_connection, &public_topic,
-//     //                                                          AWS_MQTT_QOS_AT_MOST_ONCE, false, &payload_cur,
-//     //                                                          _tm_mqtt_post_on_complete_fn,
-//     //                                                          NULL);
-//     PublishParams pubParams = DEFAULT_PUB_PARAMS;
-//     pubParams.qos           = QOS1;
-//     pubParams.payload_len   = payload_cur.len;
-//     pubParams.payload       = (void *)payload_cur.ptr;
-//     int packet_id = IOT_MQTT_Publish(dm_handle->mqtt_client, topic, &pubParams);
-
-//     LOGD(TAG_IOT_MQTT, "_tm_send_gateway_get_topo call packet_id = %d, topic = %.*s,  payload = %.*s", packet_id, topic,
-//          AWS_BYTE_CURSOR_PRI(payload_cur));
-//     aws_byte_buf_clean_up(&payload_buf);
-//     if (packet_id == 0) {
-//         ret = STATE_DM_MQTT_PUBLISH_ERROR;
-//     }
-//     return ret;
-// }
-
-// void _tm_recv_gateway_get_topo_reply_handler(const char* topic, const uint8_t *payload, size_t len, void *pUserData) {
-//     struct aws_byte_cursor topic_byte_cursor = aws_byte_cursor_from_array(topic, strlen(topic));
-//     struct aws_byte_cursor payload_byte_cursor = aws_byte_cursor_from_array(payload, len);
-
-//     LOGD(TAG_IOT_MQTT, "_tm_recv_gateway_get_topo_handler call topic = %.*s,  payload = %.*s", 
-//         AWS_BYTE_CURSOR_PRI(topic_byte_cursor), 
-//         AWS_BYTE_CURSOR_PRI(payload_byte_cursor));
-//     iot_tm_handler_t* dm_handle = (iot_tm_handler_t*) pUserData;
-//     if (dm_handle == NULL) {
-//         return;
-//     }
-//     if (NULL == dm_handle->recv_handler) {
-//         return;
-//     }
-//     iot_tm_recv_t recv;
-//     AWS_ZERO_STRUCT(recv);
-//     recv.type = IOT_TM_RECV_GATEWAY_GET_TOPO_REPLY;
-
-//     // parse product_key, device_name, module_key by topic value
-//     struct aws_array_list topic_split_data_list;
-//     aws_array_list_init_dynamic(&topic_split_data_list, dm_handle->allocator, 8,sizeof(struct aws_byte_cursor));
-//     aws_byte_cursor_split_on_char(&topic, '/',&topic_split_data_list);
-
-//     struct aws_byte_cursor product_key_cur = {0};
-//     aws_array_list_get_at(&topic_split_data_list, &product_key_cur, 1);
-//     struct aws_byte_cursor device_name_cur = {0};
-//     aws_array_list_get_at(&topic_split_data_list, &device_name_cur, 2);
-//     recv.product_key = aws_cur_to_char_str(dm_handle->allocator, &product_key_cur);
-//     recv.device_name = aws_cur_to_char_str(dm_handle->allocator, &device_name_cur);
-
-//     // package business data
-//     iot_tm_msg_gateway_get_topo_reply_t gateway_get_reply;
-//     struct aws_json_value* payload_json = aws_json_value_new_from_string(dm_handle->allocator, payload);
-//     struct aws_byte_cursor id_cur = aws_json_get_str_byte_cur_val(payload_json, "ID");
-//     const char* id = aws_cur_to_char_str(dm_handle->allocator, &id_cur);
-//     double error_code = aws_json_get_num_val(payload_json, "Code");
-//     if (error_code != 0) {
-//         goto end;
-//     }
-//     struct aws_json_value* data_json = aws_json_get_json_obj(dm_handle->allocator, payload_json, "data");
-//     if (data_json == NULL) {
-//         aws_mem_release(dm_handle->allocator, data_json);
-//         goto end;
-//     }
-//     const size_t data_size = aws_json_get_array_size(data_json);
-//     iot_tm_msg_gateway_get_topo_item_t* gateway_get_items[64] = {};
-//     for (int i = 0; i < data_size; ++i) {
-//         struct aws_json_value* data_item = aws_json_get_array_element(data_json, i);
-//         struct aws_string* product_key = aws_json_get_string1_val(dm_handle->allocator, data_item, "ProductKey");
-//         struct aws_string* device_name = aws_json_get_string1_val(dm_handle->allocator, data_item, "DeviceName");
-
-//         gateway_get_items[i] = (iot_tm_msg_gateway_get_topo_item_t*) aws_mem_calloc(dm_handle->allocator, 1, sizeof(iot_tm_msg_gateway_get_topo_item_t));
-//         gateway_get_items[i]->product_key = aws_string_c_str(product_key);
-//         gateway_get_items[i]->device_name = aws_string_c_str(device_name);
-//         // release
-//         aws_mem_release(dm_handle->allocator, product_key);
-//         aws_mem_release(dm_handle->allocator, device_name);
-//     }
-//     gateway_get_reply.gateway_topo_list = gateway_get_items;
-//     recv.data.gateway_get = gateway_get_reply;
-
-//     // callback business
-//     dm_handle->recv_handler(dm_handle, &recv, dm_handle->userdata);
-
-//     // release
-//     for (int i = 0; i < data_size; ++i) {
-//         aws_mem_release(dm_handle->allocator, gateway_get_items[i]);
-//     }
-
-//     aws_mem_release(dm_handle->allocator, data_json);
-//     end:
-//     aws_mem_release(dm_handle->allocator, payload_json);
-//     aws_mem_release(dm_handle->allocator, id);
-
-// }
-
-
-// void iot_gateway_get_device_secret_init(iot_tm_msg_gateway_get_device_secret_t** pty) {
-//     iot_tm_msg_gateway_get_device_secret_t* gatewayP = malloc( sizeof(iot_tm_msg_gateway_get_device_secret_t));
-//     const char* id = get_random_string_with_time_suffix(aws_alloc());
-//     gatewayP->id = id;
-//     gatewayP->version = SDK_VERSION;
-//     gatewayP->uuid = get_uuid_c_str(aws_alloc());
-//     gatewayP->gateway_topo_list = (void*) aws_json_value_new_array(aws_alloc());
-//     *pty = gatewayP;
-// }
-
-// int32_t iot_gateway_get_device_secret_item(iot_tm_msg_gateway_get_device_secret_t* pty, const char* device_name, const char* product_key) {
-//     if (!_check_device_name_legality(device_name)) {
-//         return -1;
-//     }
-//     struct aws_json_value* get_device_secret_item = aws_json_value_new_object(aws_alloc());
-//     aws_json_add_str_val(get_device_secret_item, "device_name", device_name);
-//     aws_json_add_str_val(get_device_secret_item, "product_key", product_key);
-//     aws_json_add_array_element((struct aws_json_value*) pty->gateway_topo_list, get_device_secret_item);
-//     return 0;
-// }
-
-// void* iot_gateway_get_device_secret_payload(iot_tm_msg_gateway_get_device_secret_t* pty) {
-//     if (pty->payload_root == NULL) {
-//         pty->payload_root = aws_json_value_new_object(aws_alloc());
-//         aws_json_add_str_val(pty->payload_root, "ID", pty->id);
-//         aws_json_add_str_val(pty->payload_root, "Version", pty->version);
-//         struct aws_json_value* params = aws_json_value_new_array(aws_alloc());
-//         for (int i = 0; i < aws_json_get_array_size(((struct aws_json_value*) pty->gateway_topo_list)); ++i) {
-//             struct aws_json_value* gateway_get_device_secret_item = aws_json_get_array_element((struct aws_json_value*) pty->gateway_topo_list, i);
-
-//             struct aws_string* product_key = aws_json_get_string1_val(aws_alloc(), gateway_get_device_secret_item, "product_key");
-//             struct aws_string* device_name = aws_json_get_string1_val(aws_alloc(), gateway_get_device_secret_item, "device_name");
-//             struct aws_json_value* sub_params = aws_json_value_new_object(aws_alloc());
-//             aws_json_add_str_val(sub_params, "ProductKey", aws_string_c_str(product_key));
-//             aws_json_add_str_val(sub_params, "DeviceName", aws_string_c_str(device_name));
-//             aws_json_add_array_element(params, sub_params);
-
-//             aws_mem_release(aws_alloc(), product_key);
-//             aws_mem_release(aws_alloc(), device_name);
-//         }
-//         aws_json_add_json_obj((struct aws_json_value*) pty->payload_root, "params", params);
-//     }
-//     return pty->payload_root;
-// }
-
-// void iot_gateway_get_device_secret_free(iot_tm_msg_gateway_get_device_secret_t* pty) {
-//     if (pty == NULL) {
-//         return;
-//     }
-//     if (pty->payload_root != NULL) {
-//         aws_mem_release(aws_alloc(), pty->payload_root);
-//     }
-//     if (pty->gateway_topo_list != NULL) {
-//         aws_mem_release(aws_alloc(), pty->gateway_topo_list);
-//     }
-//     aws_mem_release(aws_alloc(), pty->id);
-// //    aws_mem_release(aws_alloc(), pty->uuid);
-//     aws_mem_release(aws_alloc(), pty);
-// }
-
-// int32_t _tm_send_gateway_get_device_secret(void* handler, const char* topic, const void* msg_p) {
-//     iot_tm_handler_t* dm_handle = (iot_tm_handler_t*) handler;
-//     iot_tm_msg_t* msg = (iot_tm_msg_t*) msg_p;
-//     int32_t ret = VOLC_OK;
-//     struct aws_byte_buf payload_buf = aws_json_obj_to_byte_buf(dm_handle->allocator, ((struct aws_json_value*)iot_gateway_get_device_secret_payload(msg->data.gateway_get_device_secret)));
-//     struct aws_byte_cursor payload_cur = aws_byte_cursor_from_buf(&payload_buf);
-//     // struct aws_byte_cursor public_topic = aws_byte_cursor_from_c_str(topic);
-//     // uint16_t  packet_id = aws_mqtt_client_connection_publish(dm_handle->mqtt_handle->mqtt_connection, &public_topic,
-//     //                                                          AWS_MQTT_QOS_AT_MOST_ONCE, false, &payload_cur,
-//     //                                                          _tm_mqtt_post_on_complete_fn,
-//     //                                                          NULL);
-//     PublishParams pubParams = DEFAULT_PUB_PARAMS;
-//     pubParams.qos           = QOS1;
-//     pubParams.payload_len   = payload_cur.len;
-//     pubParams.payload       = (void *)payload_cur.ptr;
-//     int packet_id = IOT_MQTT_Publish(dm_handle->mqtt_client, topic, &pubParams);
-
-//     LOGD(TAG_IOT_MQTT, "_tm_send_gateway_get_device_secret call packet_id = %d, topic = %.*s,  payload = %.*s", packet_id, topic,
-//          AWS_BYTE_CURSOR_PRI(payload_cur));
-//     aws_byte_buf_clean_up(&payload_buf);
-//     if (packet_id == 0) {
-//         ret = STATE_DM_MQTT_PUBLISH_ERROR;
-//     }
-//     return ret;
-// }
-
-// void _tm_recv_gateway_get_device_secret_reply_handler(const char* topic, const uint8_t *payload, size_t len, void *pUserData) {
-//     struct aws_byte_cursor topic_byte_cursor = aws_byte_cursor_from_array(topic, strlen(topic));
-//     struct aws_byte_cursor payload_byte_cursor = aws_byte_cursor_from_array(payload, len);
-
-
-//     LOGD(TAG_IOT_MQTT, "_tm_recv_gateway_get_device_secret_handler call topic = %.*s,  payload = %.*s", 
-//         AWS_BYTE_CURSOR_PRI(topic_byte_cursor), 
-//         AWS_BYTE_CURSOR_PRI(payload_byte_cursor));
-//     iot_tm_handler_t* dm_handle = (iot_tm_handler_t*) pUserData;
-//     if (dm_handle == NULL) {
-//         return;
-//     }
-//     if (NULL == dm_handle->recv_handler) {
-//         return;
-//     }
-//     iot_tm_recv_t recv;
-//     AWS_ZERO_STRUCT(recv);
-//     recv.type = IOT_TM_RECV_GATEWAY_GET_DEVICE_SECRET;
-
-//     // parse product_key, device_name, module_key by topic value
-//     struct aws_array_list topic_split_data_list;
-//     aws_array_list_init_dynamic(&topic_split_data_list, dm_handle->allocator, 8,sizeof(struct aws_byte_cursor));
-//     aws_byte_cursor_split_on_char(&topic, '/',&topic_split_data_list);
-
-//     struct aws_byte_cursor product_key_cur = {0};
-//     aws_array_list_get_at(&topic_split_data_list, &product_key_cur, 1);
-//     struct aws_byte_cursor device_name_cur = {0};
-//     aws_array_list_get_at(&topic_split_data_list, &device_name_cur, 2);
-//     recv.product_key = aws_cur_to_char_str(dm_handle->allocator, &product_key_cur);
-//     recv.device_name = aws_cur_to_char_str(dm_handle->allocator, &device_name_cur);
-
-//     // package business data
-//     iot_tm_msg_gateway_get_device_secret_reply_t gateway_get_device_secret_reply;
-//     struct aws_json_value* payload_json = aws_json_value_new_from_string(dm_handle->allocator, payload);
-//     struct aws_byte_cursor id_cur = aws_json_get_str_byte_cur_val(payload_json, "ID");
-//     const char* id = aws_cur_to_char_str(dm_handle->allocator, &id_cur);
-//     double error_code = aws_json_get_num_val(payload_json, "Code");
-//     if (error_code != 0) {
-//         goto end;
-//     }
-//     struct aws_json_value* data_json = aws_json_get_json_obj(dm_handle->allocator, payload_json, "data");
-//     if (data_json == NULL) {
-//         aws_mem_release(dm_handle->allocator, data_json);
-//         goto end;
-//     }
-//     size_t data_size = aws_json_get_array_size(data_json);
-//     for (int i = 0; i < data_size; ++i) {
-//         struct aws_json_value* data_item = aws_json_get_array_element(data_json, i);
-//         struct aws_string* product_key = aws_json_get_string1_val(dm_handle->allocator, data_item, "ProductKey");
-//         struct aws_string* device_name = aws_json_get_string1_val(dm_handle->allocator, data_item, "DeviceName");
-//         struct aws_json_value* device_secret_json = aws_json_get_json_obj(dm_handle->allocator, data_item, "device_secret");
-//         struct aws_string* device_secret_payload = aws_json_get_string1_val(dm_handle->allocator, device_secret_json, "payload");
-
-//         // save
-//         struct aws_string* secret = aes_decode(dm_handle->allocator, aws_string_c_str(dm_handle->mqtt_handle->device_secret),
-//                                                aws_string_c_str(device_secret_payload));
-//         aws_hash_table_put(&get_iot_core_context()->device_secret_map, aws_string_c_str(get_user_name(dm_handle->allocator, product_key, device_name)),
-//                             aws_string_c_str(secret), NULL);
-
-//         // release
-//         aws_mem_release(dm_handle->allocator, product_key);
-//         aws_mem_release(dm_handle->allocator, device_name);
-//         aws_mem_release(dm_handle->allocator, device_secret_json);
-//         aws_mem_release(dm_handle->allocator, device_secret_payload);
-//     }
-
-//     // release
-//     aws_mem_release(dm_handle->allocator, data_json);
-//     end:
-//     aws_mem_release(dm_handle->allocator, payload_json);
-//     aws_mem_release(dm_handle->allocator, id);
-
-// }
-
-
-// void iot_gateway_sub_device_login_init(iot_tm_msg_gateway_sub_device_login_t** pty) {
-//     iot_tm_msg_gateway_sub_device_login_t* gatewayP = malloc( sizeof (iot_tm_msg_gateway_sub_device_login_t));
-//     const char* id = get_random_string_with_time_suffix(aws_alloc());
-//     gatewayP->id = aws_string_new_from_c_str(aws_alloc(), id);
-//     gatewayP->version = SDK_VERSION;
-//     gatewayP->gateway_topo_list = (void*) aws_json_value_new_array(aws_alloc());
-//     *pty = gatewayP;
-// }
-
-// int32_t iot_gateway_sub_device_login_item(iot_tm_msg_gateway_sub_device_login_t* pty, const char* device_name, const char* product_key) {
-//     if (!_check_device_name_legality(device_name)) {
-//         return -1;
-//     }
-//     struct aws_json_value* gateway_sub_device_login_item = aws_json_value_new_object(aws_alloc());
-//     aws_json_add_str_val(gateway_sub_device_login_item, "device_name",device_name);
-//     aws_json_add_str_val(gateway_sub_device_login_item, "product_key", product_key);
-//     aws_json_add_array_element((struct aws_json_value*) pty->gateway_topo_list, gateway_sub_device_login_item);
-//     return 0;
-// }
-
-// // int mapForeach(void *context, struct aws_hash_element *p_element) {
-// //     const char* key = p_element->key;
-// //     const char* value = p_element->value;
-// //     LOGI("skin", "key = %s, value = %s", key, value);
-// //
-// // }
-
-// void* iot_gateway_sub_device_login_payload(iot_tm_msg_gateway_sub_device_login_t* pty) {
-//     if (pty->payload_root == NULL) {
-//         pty->payload_root = aws_json_value_new_object(aws_alloc());
-//         aws_json_add_str_val(pty->payload_root, "ID", aws_string_c_str(pty->id));
-//         aws_json_add_str_val(pty->payload_root, "Version", pty->version);
-//         struct aws_json_value* params =  aws_json_value_new_array(aws_alloc());
-//         for (int i = 0; i < aws_json_get_array_size(((struct aws_json_value*) pty->gateway_topo_list)); ++i) {
-//             struct aws_json_value* gateway_sub_device_login_item = aws_json_get_array_element((struct aws_json_value*)pty->gateway_topo_list,  i);
-
-//             struct aws_string* product_key = aws_json_get_string1_val(aws_alloc(), gateway_sub_device_login_item, "product_key");
-//             struct aws_string* device_name = aws_json_get_string1_val(aws_alloc(), gateway_sub_device_login_item, "device_name");
-
-//             uint32_t random_num = arenal_get_random_num();
-// //            get_random_num_uint32(&random_num);
-//             uint64_t time_stamp = get_current_time_sec();
-//             // get device secret
-//             struct aws_hash_element* device_secret = NULL;
-//             const char* device_secret_key = aws_string_c_str(get_user_name(aws_alloc(), product_key, device_name));
-//             // aws_hash_table_foreach(&get_iot_core_context()->device_secret_map, mapForeach, NULL);
-//             aws_hash_table_find(&get_iot_core_context()->device_secret_map, device_secret_key,&device_secret);
-//             if (device_secret == NULL) {
-//                 LOGE(TAG_IOT_MQTT, "sub device[%s] no secret", device_secret_key);
-//                 goto end;
-//             }
-//             const char* secret = device_secret->value;
-
-//             LOGD(TAG_IOT_MQTT, "sub device[%s] secret = %s", device_secret_key, secret);
-//             struct aws_string* signature = hmac_sha256_encrypt(aws_alloc(), random_num, time_stamp,
-//                                                                aws_string_c_str(device_name),
-//                                                                aws_string_c_str(product_key),
-//                                                                secret);
-
-//             struct aws_json_value* sub_params = aws_json_value_new_object(aws_alloc());
-//             aws_json_add_str_val(sub_params, "ProductKey", aws_string_c_str(product_key));
-//             aws_json_add_str_val(sub_params, "DeviceName", aws_string_c_str(device_name));
-//             aws_json_add_num_val(sub_params, "random_num", random_num);
-//             aws_json_add_num_val(sub_params, "timestamp", time_stamp);
-//             aws_json_add_str_val(sub_params, "signature", aws_string_c_str(signature));
-//             // aws_json_add_str_val method will alloc new mem for value field，so this mem can release
-// //            aws_mem_release(aws_alloc(), signature);
-//             aws_json_add_array_element(params, sub_params);
-
-//             // release
-//             aws_mem_release(aws_alloc(), product_key);
-//             aws_mem_release(aws_alloc(), device_name);
-//         }
-//         aws_json_add_json_obj(pty->payload_root, "params", params);
-
-
-//     }
-//     end:
-//     return pty->payload_root;
-// }
-
-// void iot_gateway_sub_device_login_free(iot_tm_msg_gateway_sub_device_login_t* pty) {
-//     if(pty == NULL) {
-//         return;
-//     }
-//     if (pty->payload_root != NULL) {
-//         aws_mem_release(aws_alloc(), pty->payload_root);
-//     }
-//     if (pty->gateway_topo_list != NULL){
-//         aws_mem_release(aws_alloc(), pty->gateway_topo_list);
-//     }
-//     aws_mem_release(aws_alloc(), pty->id);
-// }
-
-// int32_t _tm_send_gateway_sub_device_login(void* handler, const char* topic, const void* msg_p) {
-//     iot_tm_handler_t* dm_handle = (iot_tm_handler_t*) handler;
-//     iot_tm_msg_t* msg = (iot_tm_msg_t*) msg_p;
-//     int32_t ret = VOLC_OK;
-//     struct aws_byte_buf payload_buf = aws_json_obj_to_byte_buf(dm_handle->allocator, ((struct aws_json_value*)iot_gateway_sub_device_login_payload(msg->data.gateway_sub_device_login)));
-//     struct aws_byte_cursor payload_cur = aws_byte_cursor_from_buf(&payload_buf);
-//     // struct aws_byte_cursor public_topic = aws_byte_cursor_from_c_str(topic);
-//     // uint16_t  packet_id = aws_mqtt_client_connection_publish(dm_handle->mqtt_handle->mqtt_connection, &public_topic,
-//     //                                                          AWS_MQTT_QOS_AT_MOST_ONCE, false, &payload_cur,
-//     //                                                          _tm_mqtt_post_on_complete_fn,
-//     //                                                          NULL);
-//     PublishParams pubParams = DEFAULT_PUB_PARAMS;
-//     pubParams.qos           = QOS1;
-//     pubParams.payload_len   = payload_cur.len;
-//     pubParams.payload       = (void *)payload_cur.ptr;
-//     int packet_id = IOT_MQTT_Publish(dm_handle->mqtt_client, topic, &pubParams);
-
-//     LOGD(TAG_IOT_MQTT, "_tm_send_gateway_sub_device_login call packet_id = %d, topic = %.*s,  payload = %.*s", packet_id, topic,
-//          AWS_BYTE_CURSOR_PRI(payload_cur));
-//     aws_byte_buf_clean_up(&payload_buf);
-//     if (packet_id == 0) {
-//         ret = STATE_DM_MQTT_PUBLISH_ERROR;
-//     }
-//     return ret;
-// }
-
-// void _tm_recv_gateway_sub_device_login_reply_handler(const char* topic, const uint8_t *payload, size_t len, void *pUserData) {
-//     struct aws_byte_cursor topic_byte_cursor = aws_byte_cursor_from_array(topic, strlen(topic));
-//     struct aws_byte_cursor payload_byte_cursor = aws_byte_cursor_from_array(payload, len);
-
-//     LOGD(TAG_IOT_MQTT, "_tm_recv_gateway_sub_device_login_handler call topic = %.*s,  payload = %.*s", 
-//         AWS_BYTE_CURSOR_PRI(topic_byte_cursor), 
-//         AWS_BYTE_CURSOR_PRI(payload_byte_cursor));
-//     iot_tm_handler_t* dm_handle = (iot_tm_handler_t*) pUserData;
-//     if (dm_handle == NULL) {
-//         return;
-//     }
-//     if (NULL == dm_handle->recv_handler) {
-//         return;
-//     }
-//     iot_tm_recv_t recv;
-//     AWS_ZERO_STRUCT(recv);
-//     recv.type = IOT_TM_RECV_GATEWAY_GET_TOPO_REPLY;
-
-//     // parse product_key, device_name, module_key by topic value
-//     struct aws_array_list topic_split_data_list;
-//     aws_array_list_init_dynamic(&topic_split_data_list, dm_handle->allocator, 8,sizeof(struct aws_byte_cursor));
-//     aws_byte_cursor_split_on_char(&topic, '/',&topic_split_data_list);
-
-//     struct aws_byte_cursor product_key_cur = {0};
-//     aws_array_list_get_at(&topic_split_data_list, &product_key_cur, 1);
-//     struct aws_byte_cursor device_name_cur = {0};
-//     aws_array_list_get_at(&topic_split_data_list, &device_name_cur, 2);
-//     recv.product_key = aws_cur_to_char_str(dm_handle->allocator, &product_key_cur);
-//     recv.device_name = aws_cur_to_char_str(dm_handle->allocator, &device_name_cur);
-
-//     // package business data
-//     iot_tm_msg_gateway_get_topo_reply_t gateway_get_reply;
-//     struct aws_json_value* payload_json = aws_json_value_new_from_string(dm_handle->allocator, payload);
-//     struct aws_byte_cursor id_cur = aws_json_get_str_byte_cur_val(payload_json, "ID");
-//     const char* id = aws_cur_to_char_str(dm_handle->allocator, &id_cur);
-//     double error_code = aws_json_get_num_val(payload_json, "Code");
-//     if (error_code != 0) {
-//         goto end;
-//     }
-//     struct aws_json_value* data_json = aws_json_get_json_obj(dm_handle->allocator, payload_json, "data");
-//     if (data_json == NULL) {
-//         aws_mem_release(dm_handle->allocator, data_json);
-//         goto end;
-//     }
-//     const size_t data_size = aws_json_get_array_size(data_json);
-//     iot_tm_msg_gateway_get_topo_item_t* gateway_get_items[64] = {};
-//     for (int i = 0; i < data_size; ++i) {
-//         struct aws_json_value* data_item = aws_json_get_array_element(data_json, i);
-//         struct aws_string* product_key = aws_json_get_string1_val(dm_handle->allocator, data_item, "ProductKey");
-//         struct aws_string* device_name = aws_json_get_string1_val(dm_handle->allocator, data_item, "DeviceName");
-
-//         // subscribe sub device topic
-//         __s_tm_set_up_mqtt_topic(dm_handle, product_key, device_name);
-
-//         // release
-//         aws_mem_release(dm_handle->allocator, product_key);
-//         aws_mem_release(dm_handle->allocator, device_name);
-//         gateway_get_items[i] = (iot_tm_msg_gateway_get_topo_item_t*) aws_mem_calloc(dm_handle->allocator, 1, sizeof(iot_tm_msg_gateway_get_topo_item_t));
-//         gateway_get_items[i]->product_key = aws_string_c_str(product_key);
-//         gateway_get_items[i]->device_name = aws_string_c_str(device_name);
-//     }
-//     gateway_get_reply.gateway_topo_list = gateway_get_items;
-//     recv.data.gateway_get = gateway_get_reply;
-
-//     // callback business
-//     dm_handle->recv_handler(dm_handle, &recv, dm_handle->userdata);
-
-//     // release
-//     for (int i = 0; i < data_size; ++i) {
-//         aws_mem_release(dm_handle->allocator, gateway_get_items[i]);
-//     }
-
-//     aws_mem_release(dm_handle->allocator, data_json);
-//     end:
-//     aws_mem_release(dm_handle->allocator, payload_json);
-//     aws_mem_release(dm_handle->allocator, id);
-
-// }
-
-// void iot_gateway_sub_device_logout_init(iot_tm_msg_gateway_sub_device_logout_t** pty) {
-//     iot_tm_msg_gateway_sub_device_logout_t* gatewayP = malloc( sizeof(iot_tm_msg_gateway_sub_device_logout_t));
-//     const char* id = get_random_string_with_time_suffix(aws_alloc());
-//     gatewayP->id = id;
-//     gatewayP->version = SDK_VERSION;
-//     gatewayP->gateway_topo_list = (void*) aws_json_value_new_array(aws_alloc());
-//     *pty = gatewayP;
-// }
-
-// int32_t iot_gateway_sub_device_logout_item(iot_tm_msg_gateway_sub_device_logout_t* pty, const char* device_name, const char* product_key) {
-//     if (pty == NULL || !_check_device_name_legality(device_name)) {
-//         return -1;
-//     }
-//     struct aws_json_value* gateway_sub_device_logout_item = aws_json_value_new_object(aws_alloc());
-//     aws_json_add_str_val(gateway_sub_device_logout_item, "device_name", device_name);
-//     aws_json_add_str_val(gateway_sub_device_logout_item, "product_key", product_key);
-//     aws_json_add_array_element((struct aws_json_value*) pty->gateway_topo_list, gateway_sub_device_logout_item);
-//     return 0;
-// }
-
-// void* iot_gateway_sub_device_logout_payload(iot_tm_msg_gateway_sub_device_logout_t* pty) {
-//     if (pty->payload_root == NULL) {
-//         pty->payload_root = aws_json_value_new_object(aws_alloc());
-//         aws_json_add_str_val((struct aws_json_value*) pty->payload_root, "ID", pty->id);
-//         aws_json_add_str_val((struct aws_json_value*) pty->payload_root, "Version", pty->version);
-//         struct aws_json_value* params = aws_json_value_new_array(aws_alloc());
-//         for (int i = 0; i < aws_json_get_array_size((struct aws_json_value*)pty->gateway_topo_list); ++i) {
-//             struct aws_json_value* gateway_sub_device_logout_item = aws_json_get_array_element((struct aws_json_value*)pty->gateway_topo_list, i);
-//             struct aws_string* product_key = aws_json_get_string1_val(aws_alloc(), gateway_sub_device_logout_item, "product_key");
-//             struct aws_string* device_name = aws_json_get_string1_val(aws_alloc(), gateway_sub_device_logout_item, "device_name");
-
-//             struct aws_json_value* sub_params = aws_json_value_new_object(aws_alloc());
-//             aws_json_add_str_val(sub_params, "ProductKey", aws_string_c_str(product_key));
-//             aws_json_add_str_val(sub_params, "DeviceName", aws_string_c_str(device_name));
-//             aws_json_add_array_element(params, sub_params);
-
-//             // release
-//             aws_mem_release(aws_alloc(), product_key);
-//             aws_mem_release(aws_alloc(), device_name);
-//         }
-//         aws_json_add_json_obj((struct aws_json_value*) pty->payload_root, "params", params);
-//     }
-//     return pty->payload_root;
-// }
-
-// void iot_gateway_sub_device_logout_free(iot_tm_msg_gateway_sub_device_logout_t* pty) {
-//     if (pty == NULL) {
-//         return;
-//     }
-//     if (pty->payload_root != NULL) {
-//         aws_mem_release(aws_alloc(), pty->payload_root);
-//     }
-//     if (pty->gateway_topo_list != NULL) {
-//         aws_mem_release(aws_alloc(), pty->gateway_topo_list);
-//     }
-//     aws_mem_release(aws_alloc(), pty->id);
-// }
-
-// int32_t _tm_send_gateway_sub_device_logout(void* handler, const char* topic, const void* msg_p) {
-//     iot_tm_handler_t* dm_handle = (iot_tm_handler_t*) handler;
-//     iot_tm_msg_t* msg = (iot_tm_msg_t*) msg_p;
-//     int32_t ret = VOLC_OK;
-//     struct aws_byte_buf payload_buf = aws_json_obj_to_byte_buf(dm_handle->allocator, ((struct aws_json_value*)iot_gateway_sub_device_logout_payload(msg->data.gateway_sub_device_logout)));
-//     struct aws_byte_cursor payload_cur = aws_byte_cursor_from_buf(&payload_buf);
-//     // struct aws_byte_cursor public_topic = aws_byte_cursor_from_c_str(topic);
-//     // uint16_t  packet_id = aws_mqtt_client_connection_publish(dm_handle->mqtt_handle->mqtt_connection, &public_topic,
-//     //                                                          AWS_MQTT_QOS_AT_MOST_ONCE, false, &payload_cur,
-//     //                                                          _tm_mqtt_post_on_complete_fn,
-//     //                                                          NULL);
-//     PublishParams pubParams = DEFAULT_PUB_PARAMS;
-//     pubParams.qos           = QOS1;
-//     pubParams.payload_len   = payload_cur.len;
-//     pubParams.payload       = (void *)payload_cur.ptr;
-//     int packet_id = IOT_MQTT_Publish(dm_handle->mqtt_client, topic, &pubParams);
-
-//     LOGD(TAG_IOT_MQTT, "_tm_send_gateway_sub_device_logout call packet_id = %d, topic = %.*s,  payload = %.*s", packet_id, topic,
-//          AWS_BYTE_CURSOR_PRI(payload_cur));
-//     aws_byte_buf_clean_up(&payload_buf);
-//     if (packet_id == 0) {
-//         ret = STATE_DM_MQTT_PUBLISH_ERROR;
-//     }
-//     return ret;
-// }
-
-// void _tm_recv_gateway_sub_device_logout_reply_handler(const char* topic, const uint8_t *payload, size_t len, void *pUserData) {
-//     struct aws_byte_cursor topic_byte_cursor = aws_byte_cursor_from_array(topic, strlen(topic));
-//     struct aws_byte_cursor payload_byte_cursor = aws_byte_cursor_from_array(payload, len);
-
-//     LOGD(TAG_IOT_MQTT, "_tm_recv_gateway_sub_device_logout_handler call topic = %.*s,  payload = %.*s", 
-//         AWS_BYTE_CURSOR_PRI(topic_byte_cursor), 
-//         AWS_BYTE_CURSOR_PRI(payload_byte_cursor));
-//     iot_tm_handler_t* dm_handle = (iot_tm_handler_t*) pUserData;
-//     if (dm_handle == NULL) {
-//         return;
-//     }
-//     if (NULL == dm_handle->recv_handler) {
-//         return;
-//     }
-//     iot_tm_recv_t recv;
-//     AWS_ZERO_STRUCT(recv);
-//     recv.type = IOT_TM_RECV_GATEWAY_SUB_DEVICE_LOGOUT;
-
-//     // parse product_key, device_name, module_key by topic value
-//     struct aws_array_list topic_split_data_list;
-//     aws_array_list_init_dynamic(&topic_split_data_list, dm_handle->allocator, 8,sizeof(struct aws_byte_cursor));
-//     aws_byte_cursor_split_on_char(&topic, '/',&topic_split_data_list);
-
-//     struct aws_byte_cursor product_key_cur = {0};
-//     aws_array_list_get_at(&topic_split_data_list, &product_key_cur, 1);
-//     struct aws_byte_cursor device_name_cur = {0};
-//     aws_array_list_get_at(&topic_split_data_list, &device_name_cur, 2);
-//     recv.product_key = aws_cur_to_char_str(dm_handle->allocator, &product_key_cur);
-//     recv.device_name = aws_cur_to_char_str(dm_handle->allocator, &device_name_cur);
-
-//     // package business data
-//     iot_tm_msg_gateway_sub_device_logout_reply_t gateway_sub_device_logout_reply;
-//     struct aws_json_value* payload_json = aws_json_value_new_from_string(dm_handle->allocator, payload);
-//     struct aws_byte_cursor id_cur = aws_json_get_str_byte_cur_val(payload_json, "ID");
-//     const char* id = aws_cur_to_char_str(dm_handle->allocator, &id_cur);
-//     double error_code = aws_json_get_num_val(payload_json, "Code");
-//     if (error_code != 0) {
-//         goto end;
-//     }
-//     struct aws_json_value* data_json = aws_json_get_json_obj(dm_handle->allocator, payload_json, "data");
-//     if (data_json == NULL) {
-//         aws_mem_release(dm_handle->allocator, data_json);
-//         goto end;
-//     }
-//     size_t data_size = aws_json_get_array_size(data_json);
-//     for (int i = 0; i < data_size; ++i) {
-//         struct aws_json_value* data_item = aws_json_get_array_element(data_json, i);
-//         struct aws_string* product_key = aws_json_get_string1_val(dm_handle->allocator, data_item, "ProductKey");
-//         struct aws_string* device_name = aws_json_get_string1_val(dm_handle->allocator, data_item, "DeviceName");
-
-//         // unsubscript
-//         char topic[256] = { 0 };
-//         sprintf(topic, "sys/%s/%s/#", aws_string_c_str(product_key), aws_string_c_str(device_name));
-//         // iot_mqtt_unsub(dm_handle->mqtt_handle, topic, 1,
-//         //                _tm_recv_gateway_unsubscribe_topic_handler,(void*) dm_handle);
-//         IOT_MQTT_Unsubscribe(dm_handle->mqtt_client, topic);
-//         // release
-//         aws_mem_release(dm_handle->allocator, product_key);
-//         aws_mem_release(dm_handle->allocator, device_name);
-//     }
-
-//     // release
-//     aws_mem_release(dm_handle->allocator, data_json);
-//     end:
-//     aws_mem_release(dm_handle->allocator, payload_json);
-//     aws_mem_release(dm_handle->allocator, id);
-
-// }
-
-
-// void iot_gateway_sub_device_discovery_init(iot_tm_msg_gateway_sub_device_discovery_t** pty) {
-//     iot_tm_msg_gateway_sub_device_discovery_t* gatewayP = malloc( sizeof(iot_tm_msg_gateway_sub_device_discovery_t));
-//     const char* id = get_random_string_with_time_suffix(aws_alloc());
-//     gatewayP->id = id;
-//     gatewayP->version = SDK_VERSION;
-//     gatewayP->gateway_topo_list = (void*) aws_json_value_new_array(aws_alloc());
-//     *pty = gatewayP;
-// }
-
-// int32_t iot_gateway_sub_device_discovery_item(iot_tm_msg_gateway_sub_device_discovery_t* pty, const char* device_name, const char* product_key) {
-//     if (pty == NULL || !_check_device_name_legality(device_name)) {
-//         return -1;
-//     }
-//     struct aws_json_value* gateway_sub_device_discovery_item = aws_json_value_new_object(aws_alloc());
-//     aws_json_add_str_val(gateway_sub_device_discovery_item, "device_name", device_name);
-//     aws_json_add_str_val(gateway_sub_device_discovery_item, "product_key", product_key);
-//     aws_json_add_array_element((struct aws_json_value*)pty->gateway_topo_list, gateway_sub_device_discovery_item);
-//     return 0;
-// }
-
-// void* iot_gateway_sub_device_discovery_payload(iot_tm_msg_gateway_sub_device_discovery_t* pty) {
-//     if (pty->payload_root == NULL) {
-//         pty->payload_root = aws_json_value_new_object(aws_alloc());
-//         aws_json_add_str_val((struct aws_json_value*)pty->payload_root, "ID", aws_string_c_str(pty->id));
-//         aws_json_add_str_val((struct aws_json_value*)pty->payload_root, "Version", pty->version);
-//         struct aws_json_value* params = aws_json_value_new_array(aws_alloc());
-//         for (int i = 0; i < aws_json_get_array_size((struct aws_json_value*) pty->gateway_topo_list); ++i) {
-//             struct aws_json_value* gateway_sub_device_discovery_item = aws_json_get_array_element((struct aws_json_value*) pty->gateway_topo_list, i);
-
-//             struct aws_string* product_key = aws_json_get_string1_val(aws_alloc(), gateway_sub_device_discovery_item, "product_key");
-//             struct aws_string* device_name = aws_json_get_string1_val(aws_alloc(), gateway_sub_device_discovery_item, "device_name");
-
-//             struct aws_json_value* sub_params = aws_json_value_new_object(aws_alloc());
-//             aws_json_add_str_val(sub_params, "ProductKey", aws_string_c_str(product_key));
-//             aws_json_add_str_val(sub_params, "DeviceName", aws_string_c_str(device_name));
-//             aws_json_add_array_element(params, sub_params);
-//         }
-//         aws_json_add_json_obj((struct aws_json_value*)pty->payload_root, "params", params);
-//     }
-//     return pty->payload_root;
-// }
-
-// void iot_gateway_sub_device_discovery_free(iot_tm_msg_gateway_sub_device_discovery_t* pty) {
-//     if (pty == NULL) {
-//         return;
-//     }
-//     if (pty->payload_root != NULL) {
-//         aws_mem_release(aws_alloc(), pty->payload_root);
-//     }
-//     if (pty->gateway_topo_list != NULL) {
-//         aws_mem_release(aws_alloc(), pty->gateway_topo_list);
-//     }
-//     aws_mem_release(aws_alloc(), pty->id);
-// }
-
-// int32_t _tm_send_gateway_sub_device_discovery(void* handler, const char* topic, const void* msg_p) {
-//     iot_tm_handler_t* dm_handle = (iot_tm_handler_t*) handler;
-//     iot_tm_msg_t* msg = (iot_tm_msg_t*) msg_p;
-//     int32_t ret = VOLC_OK;
-//     struct aws_byte_buf payload_buf = aws_json_obj_to_byte_buf(dm_handle->allocator, ((struct aws_json_value*)iot_gateway_sub_device_discovery_payload(msg->data.gateway_sub_device_discovery)));
-//     struct aws_byte_cursor payload_cur = aws_byte_cursor_from_buf(&payload_buf);
-//     // struct aws_byte_cursor public_topic = aws_byte_cursor_from_c_str(topic);
-//     // uint16_t  packet_id = aws_mqtt_client_connection_publish(dm_handle->mqtt_handle->mqtt_connection, &public_topic,
-//     //                                                          AWS_MQTT_QOS_AT_MOST_ONCE, false, &payload_cur,
-//     //                                                          _tm_mqtt_post_on_complete_fn,
-//     //                                                          NULL);
-
-//     PublishParams pubParams = DEFAULT_PUB_PARAMS;
-//     pubParams.qos           = QOS1;
-//     pubParams.payload_len   = payload_cur.len;
-//     pubParams.payload       = (void *)payload_cur.ptr;
-//     int packet_id = IOT_MQTT_Publish(dm_handle->mqtt_client, topic, &pubParams);
-
-//     LOGD(TAG_IOT_MQTT, "_tm_send_gateway_sub_device_discovery call packet_id = %d, topic = %.*s,  payload = %.*s", packet_id, topic,
-//          AWS_BYTE_CURSOR_PRI(payload_cur));
-//     aws_byte_buf_clean_up(&payload_buf);
-//     if (packet_id == 0) {
-//         ret = STATE_DM_MQTT_PUBLISH_ERROR;
-//     }
-//     return ret;
-// }
-
-// void _tm_recv_gateway_sub_device_discovery_reply_handler(const char* topic, const uint8_t *payload, size_t len, void *pUserData) {
-//     struct aws_byte_cursor topic_byte_cursor = aws_byte_cursor_from_array(topic, strlen(topic));
-//     struct aws_byte_cursor payload_byte_cursor = aws_byte_cursor_from_array(payload, len);
-
-//     LOGD(TAG_IOT_MQTT, "_tm_recv_gateway_sub_device_discovery_handler call topic = %.*s,  payload = %.*s", 
-//         AWS_BYTE_CURSOR_PRI(topic_byte_cursor), 
-//         AWS_BYTE_CURSOR_PRI(payload_byte_cursor));
-//     iot_tm_handler_t* dm_handle = (iot_tm_handler_t*) pUserData;
-//     if (dm_handle == NULL) {
-//         return;
-//     }
-//     if (NULL == dm_handle->recv_handler) {
-//         return;
-//     }
-//     iot_tm_recv_t recv;
-//     AWS_ZERO_STRUCT(recv);
-//     recv.type = IOT_TM_RECV_GATEWAY_SUB_DEVICE_LOGOUT;
-
-//     // parse product_key, device_name, module_key by topic value
-//     struct aws_array_list topic_split_data_list;
-//     aws_array_list_init_dynamic(&topic_split_data_list, dm_handle->allocator, 8,sizeof(struct aws_byte_cursor));
-//     aws_byte_cursor_split_on_char(&topic, '/',&topic_split_data_list);
-
-//     struct aws_byte_cursor product_key_cur = {0};
-//     aws_array_list_get_at(&topic_split_data_list, &product_key_cur, 1);
-//     struct aws_byte_cursor device_name_cur = {0};
-//     aws_array_list_get_at(&topic_split_data_list, &device_name_cur, 2);
-//     recv.product_key = aws_cur_to_char_str(dm_handle->allocator, &product_key_cur);
-//     recv.device_name = aws_cur_to_char_str(dm_handle->allocator, &device_name_cur);
-
-//     // package business data
-//     iot_tm_msg_gateway_sub_device_logout_reply_t gateway_sub_device_logout_reply;
-//     struct aws_json_value* payload_json = aws_json_value_new_from_string(dm_handle->allocator, payload);
-//     struct aws_byte_cursor id_cur = aws_json_get_str_byte_cur_val(payload_json, "ID");
-//     const char* id = aws_cur_to_char_str(dm_handle->allocator, &id_cur);
-//     double error_code = aws_json_get_num_val(payload_json, "Code");
-//     if (error_code != 0) {
-//         goto end;
-//     }
-//     struct aws_json_value* data_json = aws_json_get_json_obj(dm_handle->allocator, payload_json, "data");
-//     if (data_json == NULL) {
-//         aws_mem_release(dm_handle->allocator, data_json);
-//         goto end;
-//     }
-//     size_t data_size = aws_json_get_array_size(data_json);
-//     for (int i = 0; i < data_size; ++i) {
-//         struct aws_json_value* data_item = aws_json_get_array_element(data_json, i);
-//         struct aws_string* product_key = aws_json_get_string1_val(dm_handle->allocator, data_item, "ProductKey");
-//         struct aws_string* device_name = aws_json_get_string1_val(dm_handle->allocator, data_item, "DeviceName");
-
-//         // release
-//         aws_mem_release(dm_handle->allocator, product_key);
-//         aws_mem_release(dm_handle->allocator, device_name);
-//     }
-
-//     // release
-//     aws_mem_release(dm_handle->allocator, data_json);
-//     end:
-//     aws_mem_release(dm_handle->allocator, payload_json);
-//     aws_mem_release(dm_handle->allocator, id);
-// }
-
-// void _tm_recv_gateway_add_topo_notify_handler(const char* topic, const uint8_t *payload, size_t len, void *pUserData) {
-//     struct aws_byte_cursor topic_byte_cursor = aws_byte_cursor_from_array(topic, strlen(topic));
-//     struct aws_byte_cursor payload_byte_cursor = aws_byte_cursor_from_array(payload, len);
-
-//     LOGD(TAG_IOT_MQTT, "_tm_recv_gateway_add_topo_notify_handler call topic = %.*s,  payload = %.*s", 
-//         AWS_BYTE_CURSOR_PRI(topic_byte_cursor), 
-//         AWS_BYTE_CURSOR_PRI(payload_byte_cursor));
-//     iot_tm_handler_t* dm_handle = (iot_tm_handler_t*) pUserData;
-//     if (dm_handle == NULL) {
-//         return;
-//     }
-//     if (NULL == dm_handle->recv_handler) {
-//         return;
-//     }
-//     iot_tm_recv_t recv;
-//     AWS_ZERO_STRUCT(recv);
-//     recv.type = IOT_TM_RECV_GATEWAY_ADD_TOPO_NOTIFY;
-
-//     // parse product_key, device_name, module_key by topic value
-//     struct aws_array_list topic_split_data_list;
-//     aws_array_list_init_dynamic(&topic_split_data_list, dm_handle->allocator, 8,sizeof(struct aws_byte_cursor));
-//     aws_byte_cursor_split_on_char(&topic, '/',&topic_split_data_list);
-
-//     struct aws_byte_cursor product_key_cur = {0};
-//     aws_array_list_get_at(&topic_split_data_list, &product_key_cur, 1);
-//     struct aws_byte_cursor device_name_cur = {0};
-//     aws_array_list_get_at(&topic_split_data_list, &device_name_cur, 2);
-//     size_t topic_split_data_list_size = aws_array_list_length(&topic_split_data_list);
-//     struct aws_byte_cursor trace_id_cur = {0};
-//     aws_array_list_get_at(&topic_split_data_list, &trace_id_cur, topic_split_data_list_size -1);
-//     recv.product_key = aws_cur_to_char_str(dm_handle->allocator, &product_key_cur);
-//     recv.device_name = aws_cur_to_char_str(dm_handle->allocator, &device_name_cur);
-
-//     // package business data
-//     iot_tm_recv_gateway_add_topo_notify_t gateway_add_topo_notify;
-//     struct aws_json_value* payload_json = aws_json_value_new_from_string(dm_handle->allocator, payload);
-
-// //    double error_code = aws_json_get_num_val(payload_json, "Code");
-// //    if (error_code != 0) {
-// //        goto end;
-// //    }
-//     struct aws_json_value* data_json = aws_json_get_json_obj(dm_handle->allocator, payload_json, "params");
-//     if (data_json == NULL) {
-//         aws_mem_release(dm_handle->allocator, data_json);
-//         goto end;
-//     }
-//     struct aws_byte_cursor id_cur = aws_json_get_str_byte_cur_val(payload_json, "ID");
-//     const char* id = aws_cur_to_char_str(dm_handle->allocator, &id_cur);
-//     double time_stamp = aws_json_get_num_val(payload_json, "timestamp");
-//     const size_t data_size = aws_json_get_array_size(data_json);
-//     iot_tm_recv_gateway_add_topo_notify_item_t* gateway_add_topo_items[64] = {};
-//     for (int i = 0; i < data_size; ++i) {
-//         struct aws_json_value* data_item = aws_json_get_array_element(data_json, i);
-//         struct aws_string* product_key = aws_json_get_string1_val(dm_handle->allocator, data_item, "ProductKey");
-//         struct aws_string* device_name = aws_json_get_string1_val(dm_handle->allocator, data_item, "DeviceName");
-
-//         gateway_add_topo_items[i] = (iot_tm_msg_gateway_get_topo_item_t*) aws_mem_calloc(dm_handle->allocator, 1, sizeof(iot_tm_recv_gateway_add_topo_notify_item_t));
-//         gateway_add_topo_items[i]->product_key = aws_string_c_str(product_key);
-//         gateway_add_topo_items[i]->device_name = aws_string_c_str(device_name);
-
-//     }
-//     gateway_add_topo_notify.gateway_topo_list = gateway_add_topo_items;
-//     recv.data.gateway_add_topo_notify = gateway_add_topo_notify;
-
-//     // callback business
-//     dm_handle->recv_handler(dm_handle, &recv, dm_handle->userdata);
-
-//     // reply server
-//     struct aws_string* trace_id_string = aws_string_new_from_cursor(dm_handle->allocator, &trace_id_cur);
-//     __send_gateway_add_topo_notify_reply(dm_handle, id, (int64_t)time_stamp, aws_string_c_str(trace_id_string));
-//     aws_mem_release(dm_handle->allocator,trace_id_string);
-
-//     // release, don't release
-
-
-//     aws_mem_release(dm_handle->allocator, data_json);
-//     aws_mem_release(dm_handle->allocator, id);
-
-//     end:
-//     aws_mem_release(dm_handle->allocator, payload_json);
-
-// }
-
-// void __send_gateway_add_topo_notify_reply(void* handle, const char* id, int64_t time_stamp, const char* trace_id) {
-//     iot_tm_handler_t* dm_handle = (iot_tm_handler_t*) handle;
-//     iot_tm_msg_t dm_mg = {0};
-//     dm_mg.type = IOT_TM_MSG_GATEWAY_ADD_TOPO_NOTIFY_REPLY;
-//     iot_tm_msg_gateway_add_topo_notify_reply_t* gateway_add_topo_notify_reply;
-//     iot_gateway_add_topo_notify_reply_init(&gateway_add_topo_notify_reply, id, time_stamp, trace_id);
-//     dm_mg.data.gateway_add_topo_notify_reply = gateway_add_topo_notify_reply;
-//     iot_tm_send(dm_handle, &dm_mg);
-//     iot_gateway_add_topo_notify_reply_free(gateway_add_topo_notify_reply);
-// }
-
-// void iot_gateway_add_topo_notify_reply_init(iot_tm_msg_gateway_add_topo_notify_reply_t** pty, const char* id, int64_t time_stamp, const char* trace_id) {
-//     iot_tm_msg_gateway_add_topo_notify_reply_t* gatewayP = malloc( sizeof(iot_tm_msg_gateway_add_topo_notify_reply_t));
-//     gatewayP->id = id;
-//     gatewayP->code = 0;
-//     gatewayP->time_stamp = time_stamp;
-//     gatewayP->trace_id = trace_id;
-//     *pty = gatewayP;
-// }
-
-// void* iot_gateway_add_topo_notify_reply_payload(iot_tm_msg_gateway_add_topo_notify_reply_t* pty) {
-//     if (pty->payload_root == NULL) {
-//         pty->payload_root = aws_json_value_new_object(aws_alloc());
-//         aws_json_add_str_val((struct aws_json_value*) pty->payload_root, "ID", pty->id);
-//         aws_json_add_num_val((struct aws_json_value*) pty->payload_root, "Code", pty->code);
-//         aws_json_add_num_val((struct aws_json_value*) pty->payload_root, "timestamp", pty->time_stamp);
-//     }
-//     return pty->payload_root;
-// }
-
-// void iot_gateway_add_topo_notify_reply_free(iot_tm_msg_gateway_add_topo_notify_reply_t* pty) {
-//     if (pty == NULL) {
-//         return;
-//     }
-//     if (pty->payload_root !=  NULL) {
-//         aws_mem_release(aws_alloc(), pty->payload_root);
-//     }
-// //    aws_mem_release(aws_alloc(), pty->id);
-//     aws_mem_release(aws_alloc(), pty);
-// }
-
-// int32_t _tm_send_gateway_add_topo_notify_reply(void* handler, const char* topic, const void* msg_p) {
-//     iot_tm_handler_t* dm_handle = (iot_tm_handler_t*) handler;
-//     iot_tm_msg_t* msg = (iot_tm_msg_t*) msg_p;
-//     int32_t ret = VOLC_OK;
-//     struct aws_byte_buf payload_buf = aws_json_obj_to_byte_buf(dm_handle->allocator, ((struct aws_json_value*)iot_gateway_add_topo_notify_reply_payload(msg->data.gateway_add_topo_notify_reply)));
-//     struct aws_byte_cursor payload_cur = aws_byte_cursor_from_buf(&payload_buf);
-//     // struct aws_byte_cursor public_topic = aws_byte_cursor_from_c_str(topic);
-//     // uint16_t  packet_id = aws_mqtt_client_connection_publish(dm_handle->mqtt_handle->mqtt_connection, &public_topic,
-//     //                                                          AWS_MQTT_QOS_AT_MOST_ONCE, false, &payload_cur,
-//     //                                                          _tm_mqtt_post_on_complete_fn,
-//     //                                                          NULL);
-
-//     PublishParams pubParams = DEFAULT_PUB_PARAMS;
-//     pubParams.qos           = QOS1;
-//     pubParams.payload_len   = payload_cur.len;
-//     pubParams.payload       = (void *)payload_cur.ptr;
-//     int packet_id = IOT_MQTT_Publish(dm_handle->mqtt_client, topic, &pubParams);
-
-//     LOGD(TAG_IOT_MQTT, "_tm_send_gateway_add_topo_notify_reply call packet_id = %d, topic = %.*s,  payload = %.*s", packet_id, topic,
-//          AWS_BYTE_CURSOR_PRI(payload_cur));
-//     aws_byte_buf_clean_up(&payload_buf);
-//     if (packet_id == 0) {
-//         ret = STATE_DM_MQTT_PUBLISH_ERROR;
-//     }
-//     return ret;
-// }
-
-// void __send_gateway_topo_change_notify_reply(void* handle, const char* id) {
-//     iot_tm_handler_t* dm_handle = (iot_tm_handler_t*)handle;
-//     iot_tm_msg_t dm_mdg = {};
-//     dm_mdg.type = IOT_TM_MSG_GATEWAY_TOPO_CHANGE_NOTIFY_REPLY;
-//     iot_tm_msg_gateway_topo_change_notify_reply_t* gateway_topo_change_notify_reply;
-//     iot_gateway_topo_change_notify_reply_init(&gateway_topo_change_notify_reply, id);
-//     dm_mdg.data.gateway_topo_change_notify_reply = gateway_topo_change_notify_reply;
-//     iot_tm_send(dm_handle, &dm_mdg);
-//     iot_gateway_topo_change_notify_reply_free(gateway_topo_change_notify_reply);
-// }
-
-// void _tm_recv_gateway_topo_change_notify_handler(const char* topic, const uint8_t *payload, size_t len, void *pUserData) {
-//     struct aws_byte_cursor topic_byte_cursor = aws_byte_cursor_from_array(topic, strlen(topic));
-//     struct aws_byte_cursor payload_byte_cursor = aws_byte_cursor_from_array(payload, len);
-
-//     LOGD(TAG_IOT_MQTT, "_tm_recv_gateway_topo_change_notify_handler call topic = %.*s,  payload = %.*s", 
-//         AWS_BYTE_CURSOR_PRI(topic_byte_cursor), 
-//         AWS_BYTE_CURSOR_PRI(payload_byte_cursor));
-//     iot_tm_handler_t* dm_handle = (iot_tm_handler_t*) pUserData;
-//     if (dm_handle == NULL) {
-//         return;
-//     }
-//     if (NULL == dm_handle->recv_handler) {
-//         return;
-//     }
-//     iot_tm_recv_t recv;
-//     AWS_ZERO_STRUCT(recv);
-//     recv.type = IOT_TM_RECV_GATEWAY_TOPO_CHANGE_NOTIFY;
-
-//     // parse product_key, device_name, module_key by topic value
-//     struct aws_array_list topic_split_data_list;
-//     aws_array_list_init_dynamic(&topic_split_data_list, dm_handle->allocator, 8,sizeof(struct aws_byte_cursor));
-//     aws_byte_cursor_split_on_char(&topic, '/',&topic_split_data_list);
-
-//     struct aws_byte_cursor product_key_cur = {0};
-//     aws_array_list_get_at(&topic_split_data_list, &product_key_cur, 1);
-//     struct aws_byte_cursor device_name_cur = {0};
-//     aws_array_list_get_at(&topic_split_data_list, &device_name_cur, 2);
-//     size_t topic_split_data_list_size = aws_json_get_array_size(&topic_split_data_list);
-//     struct aws_byte_cursor trace_id_cur = {0};
-//     aws_array_list_get_at(&topic_split_data_list, &trace_id_cur, topic_split_data_list_size -1);
-//     recv.product_key = aws_cur_to_char_str(dm_handle->allocator, &product_key_cur);
-//     recv.device_name = aws_cur_to_char_str(dm_handle->allocator, &device_name_cur);
-
-//     iot_tm_recv_gateway_topo_change_notify_t gateway_topo_change_notify;
-//     struct aws_json_value* payload_json = aws_json_value_new_from_string(dm_handle->allocator, payload);
-//     struct aws_string* id = aws_json_get_string1_val(dm_handle->allocator, payload_json, "ID");
-//     struct aws_json_value* params = aws_json_get_json_obj(dm_handle->allocator, payload_json, "params");
-
-//     struct aws_string* operate_type_string = aws_json_get_string1_val(dm_handle->allocator, params, "operate_type");
-//     struct aws_json_value* sub_devices = aws_json_get_json_obj(dm_handle->allocator, params, "sub_devices");
-
-//     char operate_type_c_str[16] = {0};
-//     to_lowercase(aws_string_c_str(operate_type_string), operate_type_c_str);
-
-//     if (strcmp(operate_type_c_str, "create") == 0) {
-//         gateway_topo_change_notify.change_type = IOT_GATEWAY_TOPO_CHANGE_TYPE_CREATE;
-//     } else if (strcmp(operate_type_c_str, "delete") == 0) {
-//         gateway_topo_change_notify.change_type = IOT_GATEWAY_TOPO_CHANGE_TYPE_DELETE;
-//     } else if (strcmp(operate_type_c_str, "enable") == 0) {
-//         gateway_topo_change_notify.change_type = IOT_GATEWAY_TOPO_CHANGE_TYPE_ENABLE;
-//     } else if (strcmp(operate_type_c_str, "disable") == 0) {
-//         gateway_topo_change_notify.change_type = IOT_GATEWAY_TOPO_CHANGE_TYPE_DISABLE;
-//     } else {
-//         LOGE(TAG_IOT_MQTT, "recv %s operate type,  unknown type", operate_type_c_str);
-//         return;
-//     }
-//     // try release
-//     aws_mem_release(dm_handle->allocator, operate_type_string);
-
-//     if (sub_devices == NULL) {
-//         goto end;
-//     }
-
-//     size_t sub_device_size = aws_json_get_array_size(sub_devices);
-//     iot_tm_recv_gateway_topo_change_notify_item_t* gateway_topo_change_notify_item_list[64] = {0};
-//     for (int i = 0; i < sub_device_size; ++ i) {
-//         struct aws_json_value* sub_device_json = aws_json_get_array_element(sub_devices, i);
-//         struct aws_string* product_key = aws_json_get_string1_val(dm_handle->allocator, sub_device_json, "ProductKey");
-//         struct aws_string* device_name = aws_json_get_string1_val(dm_handle->allocator, sub_device_json, "DeviceName");
-//         struct aws_json_value* device_secret_json = aws_json_get_string1_val(dm_handle->allocator, sub_device_json, "device_secret");
-//         struct aws_string* device_secret_payload = aws_json_get_string1_val(dm_handle->allocator, device_secret_json, "payload");
-//         struct aws_string* aws_string_secret = aes_decode(dm_handle->allocator, aws_string_c_str(dm_handle->mqtt_handle->device_secret),
-//                                                           aws_string_c_str(device_secret_payload));
-//         gateway_topo_change_notify_item_list[i] = (struct iot_tm_recv_gateway_topo_change_notify_item_t*) aws_mem_calloc(dm_handle->allocator, 1, sizeof(iot_tm_recv_gateway_topo_change_notify_item_t));
-//         gateway_topo_change_notify_item_list[i]->product_key = aws_string_c_str(product_key);
-//         gateway_topo_change_notify_item_list[i]->device_name = aws_string_c_str(device_name);
-//         gateway_topo_change_notify_item_list[i]->device_secrt = aws_string_c_str(aws_string_secret);
-
-//         // release
-//         aws_mem_release(dm_handle->allocator, sub_device_json);
-//         aws_mem_release(dm_handle->allocator, device_secret_payload);
-//     }
-//     gateway_topo_change_notify.gateway_topo_list = gateway_topo_change_notify_item_list;
-//     recv.data.gateway_topo_change_notify = gateway_topo_change_notify;
-
-//     // callback business
-//     dm_handle->recv_handler(dm_handle, &recv, dm_handle->userdata);
-
-//     // reply server
-//     __send_gateway_topo_change_notify_reply(dm_handle, aws_string_c_str(id));
-
-//     // save device info when op_type is create, remove topic when op_type is  delete and disable
-//     for (int i = 0; i < sub_device_size; ++i) {
-//         struct aws_string* product_key = aws_string_new_from_c_str(dm_handle->allocator, gateway_topo_change_notify_item_list[i]->product_key);
-//         struct aws_string* device_name = aws_string_new_from_c_str(dm_handle->allocator, gateway_topo_change_notify_item_list[i]->device_name);
-// //        struct aws_string* device_secret = aws_string_new_from_c_str(dm_handle->allocator, gateway_topo_change_notify_item_list[i]->device_secrt);
-//         if (strcmp(operate_type_c_str, "create") == 0) {
-//             aws_hash_table_put(&get_iot_core_context()->device_secret_map, aws_string_c_str(get_user_name(dm_handle->allocator, product_key, device_name)),
-//                                gateway_topo_change_notify_item_list[i]->device_secrt, NULL);
-
-//         } else if (strcmp(operate_type_c_str, "delete") == 0 || strcmp(operate_type_c_str, "disable") == 0) {
-//             // remove device info from device secret map and un sub topic
-//             aws_hash_table_remove(&get_iot_core_context()->device_secret_map, aws_string_c_str(get_user_name(dm_handle->allocator, product_key, device_name)), NULL, NULL);
-
-//             // hashmap_delete(get_iot_core_context()->device_secret_map, get_user_name(dm_handle->allocator, product_key, device_name));
-
-//             char topic[256] = { 0 };
-//             sprintf(topic, "sys/%s/%s/#", gateway_topo_change_notify_item_list[i]->product_key, gateway_topo_change_notify_item_list[i]->device_name);
-//             // iot_mqtt_unsub(dm_handle->mqtt_handle, topic, 1,
-//             //                _tm_recv_gateway_unsubscribe_topic_handler,(void*) dm_handle);
-//             IOT_MQTT_Unsubscribe(dm_handle->mqtt_client, topic);
-//         }
-//         aws_mem_release(dm_handle->allocator, product_key);
-//         aws_mem_release(dm_handle->allocator, device_name);
-//     }
-
-//     // release, no need release gateway_topo_change_notify_item_list item's params, due to it's char*
-
-//     end:
-//     aws_mem_release(dm_handle->allocator, payload_json);
-//     aws_mem_release(dm_handle->allocator, params);
-//     aws_mem_release(dm_handle->allocator, id);
-// }
-
-// void iot_gateway_topo_change_notify_reply_init(iot_tm_msg_gateway_topo_change_notify_reply_t** pty, const char* id) {
-//     iot_tm_msg_gateway_topo_change_notify_reply_t* gatewayP = malloc( sizeof(iot_tm_msg_gateway_topo_change_notify_reply_t));
-//     gatewayP->id = id;
-//     gatewayP->code = 0;
-//     *pty = gatewayP;
-// }
-
-// void* iot_gateway_topo_change_notify_reply_payload(iot_tm_msg_gateway_topo_change_notify_reply_t* pty) {
-//     if (pty->payload_root == NULL) {
-//         pty->payload_root = aws_json_value_new_object(aws_alloc());
-//         aws_json_add_str_val((struct aws_json_value*) pty->payload_root, "ID", aws_string_c_str(pty->id));
-//         aws_json_add_num_val((struct aws_json_value*) pty->payload_root, "Code", pty->code);
-//     }
-//     return pty->payload_root;
-// //    return aws_json_obj_to_byte_buf(aws_alloc(), pty->payload_root);
-// }
-
-// void iot_gateway_topo_change_notify_reply_free(iot_tm_msg_gateway_topo_change_notify_reply_t* pty) {
-//     if (pty == NULL) {
-//         return;
-//     }
-
-//     if (pty->payload_root != NULL) {
-//         aws_mem_release(aws_alloc(), pty->payload_root);
-//     }
-// //    aws_mem_release(aws_alloc(), pty->id);
-// }
-
-// int32_t _tm_send_gateway_topo_change_notify_reply(void* handler, const char* topic, const void* msg_p) {
-//     iot_tm_handler_t* dm_handle = (iot_tm_handler_t*) handler;
-//     iot_tm_msg_t* msg = (iot_tm_msg_t*) msg_p;
-//     int32_t ret = VOLC_OK;
-//     struct aws_byte_buf payload_buf = aws_json_obj_to_byte_buf(dm_handle->allocator, ((struct aws_json_value*)iot_gateway_topo_change_notify_reply_payload(msg->data.gateway_topo_change_notify_reply)));
-//     struct aws_byte_cursor payload_cur = aws_byte_cursor_from_buf(&payload_buf);
-//     // struct aws_byte_cursor public_topic = aws_byte_cursor_from_c_str(topic);
-//     // uint16_t  packet_id = aws_mqtt_client_connection_publish(dm_handle->mqtt_handle->mqtt_connection, &public_topic,
-//     //                                                          AWS_MQTT_QOS_AT_MOST_ONCE, false, &payload_cur,
-//     //                                                          _tm_mqtt_post_on_complete_fn,
-//     //                                                          NULL);
-
-//     PublishParams pubParams = DEFAULT_PUB_PARAMS;
-//     pubParams.qos           = QOS1;
-//     pubParams.payload_len   = payload_cur.len;
-//     pubParams.payload       = (void *)payload_cur.ptr;
-//     int packet_id = IOT_MQTT_Publish(dm_handle->mqtt_client, topic, &pubParams);
-
-//     LOGD(TAG_IOT_MQTT, "_tm_send_gateway_add_topo_notify_reply call packet_id = %d, topic = %.*s,  payload = %.*s", packet_id, topic,
-//          AWS_BYTE_CURSOR_PRI(payload_cur));
-//     aws_byte_buf_clean_up(&payload_buf);
-//     if (packet_id == 0) {
-//         ret = STATE_DM_MQTT_PUBLISH_ERROR;
-//     }
-//     return ret;
-// }
-
-// void __send_gateway_sub_device_change_notify_reply(void* handle, const char* id) {
-//     iot_tm_handler_t* dm_handle = (iot_tm_handler_t*) handle;
-//     iot_tm_msg_t dm_msg = {0};
-//     dm_msg.type = IOT_TM_MSG_GATEWAY_SUB_DEVICE_CHANGE_NOTIFY_REPLY;
-//     iot_tm_msg_gateway_sub_device_change_notify_reply_t* gateway_sub_device_change;
-//     iot_gateway_sub_device_change_notify_reply_init(&gateway_sub_device_change, id);
-//     dm_msg.data.gateway_sub_device_notify_reply = gateway_sub_device_change;
-//     iot_tm_send(dm_handle, &gateway_sub_device_change);
-//     iot_gateway_sub_device_change_notify_reply_free(gateway_sub_device_change);
-
-// }
-
-// void _tm_recv_gateway_sub_device_change_notify_handler(const char* topic, const uint8_t *payload, size_t len, void *pUserData) {
-//     struct aws_byte_cursor topic_byte_cursor = aws_byte_cursor_from_array(topic, strlen(topic));
-//     struct aws_byte_cursor payload_byte_cursor = aws_byte_cursor_from_array(payload, len);
-
-//     LOGD(TAG_IOT_MQTT, "_tm_recv_gateway_sub_device_change_notify_handler call topic = %.*s,  payload = %.*s", 
-//         AWS_BYTE_CURSOR_PRI(topic_byte_cursor), 
-//         AWS_BYTE_CURSOR_PRI(payload_byte_cursor));
-//     iot_tm_handler_t* dm_handle = (iot_tm_handler_t*) pUserData;
-//     if (dm_handle == NULL) {
-//         return;
-//     }
-//     if (NULL == dm_handle->recv_handler) {
-//         return;
-//     }
-//     iot_tm_recv_t recv;
-//     AWS_ZERO_STRUCT(recv);
-//     recv.type = IOT_TM_RECV_GATEWAY_SUB_DEVICE_CHANGE_NOTIFY;
-
-//     // parse product_key, device_name, module_key by topic value
-//     struct aws_array_list topic_split_data_list;
-//     aws_array_list_init_dynamic(&topic_split_data_list, dm_handle->allocator, 8,sizeof(struct aws_byte_cursor));
-//     aws_byte_cursor_split_on_char(&topic, '/',&topic_split_data_list);
-
-//     struct aws_byte_cursor product_key_cur = {0};
-//     aws_array_list_get_at(&topic_split_data_list, &product_key_cur, 1);
-//     struct aws_byte_cursor device_name_cur = {0};
-//     aws_array_list_get_at(&topic_split_data_list, &device_name_cur, 2);
-//     size_t topic_split_data_list_size = aws_json_get_array_size(&topic_split_data_list);
-//     struct aws_byte_cursor trace_id_cur = {0};
-//     aws_array_list_get_at(&topic_split_data_list, &trace_id_cur, topic_split_data_list_size -1);
-//     recv.product_key = aws_cur_to_char_str(dm_handle->allocator, &product_key_cur);
-//     recv.device_name = aws_cur_to_char_str(dm_handle->allocator, &device_name_cur);
-
-//     iot_tm_recv_gateway_sub_device_change_notify_t gateway_sub_device_change_notify;
-//     struct aws_json_value* payload_json = aws_json_value_new_from_string(dm_handle->allocator, payload);
-//     struct aws_string* id = aws_json_get_string1_val(dm_handle->allocator, payload_json, "ID");
-//     struct aws_json_value* params = aws_json_get_json_obj(dm_handle->allocator, payload_json, "params");
-
-//     struct aws_string* operate_type_string = aws_json_get_string1_val(dm_handle->allocator, params, "operate_type");
-//     struct aws_json_value* sub_devices = aws_json_get_json_obj(dm_handle->allocator, params, "sub_devices");
-
-//     const char* operate_type_c_str = aws_string_c_str(operate_type_string);
-//     // todo operate type
-
-//     // try release
-//     aws_mem_release(dm_handle->allocator, operate_type_c_str);
-
-//     if (sub_devices == NULL) {
-//         goto end;
-//     }
-
-//     size_t sub_device_size = aws_json_get_array_size(sub_devices);
-//     iot_tm_recv_gateway_topo_change_notify_item_t* gateway_topo_change_notify_item_list[64] = {0};
-//     for (int i = 0; i < sub_device_size; ++ i) {
-//         struct aws_json_value* sub_device_json = aws_json_get_array_element(sub_devices, i);
-//         struct aws_string* product_key = aws_json_get_string1_val(dm_handle->allocator, sub_device_json, "ProductKey");
-//         struct aws_string* device_name = aws_json_get_string1_val(dm_handle->allocator, sub_device_json, "DeviceName");
-
-//         gateway_topo_change_notify_item_list[i] = (struct iot_tm_recv_gateway_topo_change_notify_item_t*) aws_mem_calloc(dm_handle->allocator, 1, sizeof(iot_tm_recv_gateway_topo_change_notify_item_t));
-//         gateway_topo_change_notify_item_list[i]->product_key = aws_string_c_str(product_key);
-//         gateway_topo_change_notify_item_list[i]->device_name = aws_string_c_str(device_name);
-
-//         // release
-//         aws_mem_release(dm_handle->allocator, sub_device_json);
-//     }
-//     gateway_sub_device_change_notify.gateway_topo_list = gateway_topo_change_notify_item_list;
-//     recv.data.gateway_sub_device_change_notify = gateway_sub_device_change_notify;
-
-//     // callback business
-//     dm_handle->recv_handler(dm_handle, &recv, dm_handle->userdata);
-
-//     // reply server
-//     __send_gateway_sub_device_change_notify_reply(dm_handle, aws_string_c_str(id));
-
-//     // release
-//     for (int i = 0; i < sub_device_size; ++i ) {
-//         aws_mem_release(dm_handle->allocator, gateway_topo_change_notify_item_list[i]->product_key);
-//         aws_mem_release(dm_handle->allocator, gateway_topo_change_notify_item_list[i]->device_name);
-//         aws_mem_release(dm_handle->allocator, gateway_topo_change_notify_item_list[i]->device_secrt);
-//     }
-
-//     end:
-//     aws_mem_release(dm_handle->allocator, payload_json);
-//     aws_mem_release(dm_handle->allocator, params);
-//     aws_mem_release(dm_handle->allocator, id);
-
-// }
-
-// void iot_gateway_sub_device_change_notify_reply_init(iot_tm_msg_gateway_sub_device_change_notify_reply_t** pty, const char* id) {
-//     iot_tm_msg_gateway_sub_device_change_notify_reply_t* gatewayP = malloc( sizeof(iot_tm_msg_gateway_sub_device_change_notify_reply_t));
-//     gatewayP->id = id;
-//     gatewayP->code = 0;
-//     *pty = gatewayP;
-// }
-
-// void* iot_gateway_sub_device_change_notify_reply_payload(iot_tm_msg_gateway_sub_device_change_notify_reply_t* pty) {
-//     if (pty->payload_root == NULL) {
-//         pty->payload_root = aws_json_value_new_object(aws_alloc());
-//         aws_json_add_str_val((struct aws_json_value*) pty->payload_root, "ID", pty->id);
-//         aws_json_add_num_val((struct aws_json_value*) pty->payload_root, "Code", pty->code);
-//     }
-//     return pty->payload_root;
-// }
-
-// void iot_gateway_sub_device_change_notify_reply_free(iot_tm_msg_gateway_sub_device_change_notify_reply_t* pty) {
-//     if (pty == NULL) {
-//         return;
-//     }
-//     if (pty->payload_root != NULL) {
-//         aws_mem_release(aws_alloc(), pty->payload_root);
-//     }
-//     aws_mem_release(aws_alloc(), pty->id);
-//     aws_mem_release(aws_alloc(), pty);
-// }
-
-// int32_t _tm_send_gateway_sub_device_change_notify_reply(void* handler, const char* topic, const void* msg_p) {
-//     iot_tm_handler_t* dm_handle = (iot_tm_handler_t*) handler;
-//     iot_tm_msg_t* msg = (iot_tm_msg_t*) msg_p;
-//     int32_t ret = VOLC_OK;
-//     struct aws_byte_buf payload_buf = aws_json_obj_to_byte_buf(dm_handle->allocator, ((struct aws_json_value*)iot_gateway_sub_device_change_notify_reply_payload(msg->data.gateway_sub_device_notify_reply)));
-//     struct aws_byte_cursor payload_cur = aws_byte_cursor_from_buf(&payload_buf);
-//     // struct aws_byte_cursor public_topic = aws_byte_cursor_from_c_str(topic);
-//     // uint16_t  packet_id = aws_mqtt_client_connection_publish(dm_handle->mqtt_handle->mqtt_connection, &public_topic,
-//     //                                                          AWS_MQTT_QOS_AT_MOST_ONCE, false, &payload_cur,
-//     //                                                          _tm_mqtt_post_on_complete_fn,
-//     //                                                          NULL);
-
-//     PublishParams pubParams = DEFAULT_PUB_PARAMS;
-//     pubParams.qos           = QOS1;
-//     pubParams.payload_len   = payload_cur.len;
-//     pubParams.payload       = (void *)payload_cur.ptr;
-//     int packet_id = IOT_MQTT_Publish(dm_handle->mqtt_client, topic, &pubParams);
-
-//     LOGD(TAG_IOT_MQTT, "_tm_send_gateway_add_topo_notify_reply call packet_id = %d, topic = %.*s,  payload = %.*s", packet_id, topic,
-//          AWS_BYTE_CURSOR_PRI(payload_cur));
-//     aws_byte_buf_clean_up(&payload_buf);
-//     if (packet_id == 0) {
-//         ret = STATE_DM_MQTT_PUBLISH_ERROR;
-//     }
-//     return ret;
-// }
\ No newline at end of file
+/*
+ * Copyright 2022-2024 Beijing Volcano Engine Technology Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "onesdk_config.h"
+#ifdef ONESDK_ENABLE_IOT
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aws/common/json.h"
+#include "aws/common/string.h"
+#include "error_code.h"
+#include "iot/dynreg.h"
+#include "iot/iot_utils.h"
+#include "iot_log.h"
+#include "thing_model/gateway.h"
+#include "thing_model/iot_tm_api.h"
+#include "thing_model/iot_tm_header.h"
+#include "util/aes_decode.h"
+#include "util/aws_json.h"
+#include "util/json_writer.h"
+#include "util/util.h"
+
+#define GATEWAY_NO_OP (-1)
+#define GATEWAY_KEY_SIZE 160        // "product_key/device_name"
+#define GATEWAY_PAYLOAD_TAIL 2      // 请求末尾的 "]}"
+
+struct iot_gateway_sub {
+    char *key;                      // "product_key/device_name"，同时是哈希表的key
+    char *product_key;
+    char *device_name;
+    char *device_secret;
+    char *product_secret;
+    iot_gateway_sub_state_t state;  // 只记录UNKNOWN/OFFLINE/ONLINE，请求中的状态由queued与inflight_op得出
+    uint8_t queued;                 // 待发的操作，1 << op
+    uint8_t listed;                 // 已在操作队列中，取消时不从队列删除，组批时跳过
+    int8_t inflight_op;             // 在途请求的操作，GATEWAY_NO_OP 表示没有
+    uint8_t attempts;               // 在途操作已超时的次数
+};
+
+bool _check_device_name_legality(const char* device_name) {
+    return device_name != NULL && strlen(device_name) > 0 && strlen(device_name) <= 32 &&
+        strspn(device_name, "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_-.:@") == strlen(device_name);
+}
+
+static uint32_t _gateway_limit_or(uint32_t value, uint32_t def) {
+    return value == 0 ? def : value;
+}
+
+// 相互取消的操作：登录与登出、添加与删除拓扑
+static int _gateway_opposite(iot_gateway_op_t op) {
+    switch (op) {
+        case IOT_GATEWAY_OP_LOGIN:
+            return IOT_GATEWAY_OP_LOGOUT;
+        case IOT_GATEWAY_OP_LOGOUT:
+            return IOT_GATEWAY_OP_LOGIN;
+        case IOT_GATEWAY_OP_ADD_TOPO:
+            return IOT_GATEWAY_OP_DELETE_TOPO;
+        case IOT_GATEWAY_OP_DELETE_TOPO:
+            return IOT_GATEWAY_OP_ADD_TOPO;
+        default:
+            return GATEWAY_NO_OP;
+    }
+}
+
+static void _gateway_sub_destroy(void *value) {
+    iot_gateway_sub_t *sub = (iot_gateway_sub_t *) value;
+    if (sub == NULL) {
+        return;
+    }
+    free(sub->key);
+    free(sub->product_key);
+    free(sub->device_name);
+    free(sub->device_secret);
+    free(sub->product_secret);
+    free(sub);
+}
+
+static bool _gateway_format_key(char *key, const char *product_key, const char *device_name) {
+    int n = snprintf(key, GATEWAY_KEY_SIZE, "%s/%s", product_key, device_name);
+    return n > 0 && n < GATEWAY_KEY_SIZE;
+}
+
+static iot_gateway_sub_t *_gateway_sub_find(iot_gateway_t *gw, const char *key) {
+    struct aws_hash_element *elem = NULL;
+    aws_hash_table_find(&gw->subs, key, &elem);
+    return elem == NULL ? NULL : (iot_gateway_sub_t *) elem->value;
+}
+
+static iot_gateway_sub_t *_gateway_sub_get(iot_gateway_t *gw, const char *product_key, const char *device_name) {
+    char key[GATEWAY_KEY_SIZE];
+    if (!_gateway_format_key(key, product_key, device_name)) {
+        return NULL;
+    }
+    iot_gateway_sub_t *sub = _gateway_sub_find(gw, key);
+    if (sub != NULL) {
+        return sub;
+    }
+    sub = (iot_gateway_sub_t *) calloc(1, sizeof(iot_gateway_sub_t));
+    if (sub == NULL) {
+        return NULL;
+    }
+    sub->key = strdup(key);
+    sub->product_key = strdup(product_key);
+    sub->device_name = strdup(device_name);
+    sub->state = IOT_GATEWAY_SUB_UNKNOWN;
+    sub->inflight_op = GATEWAY_NO_OP;
+    if (sub->key == NULL || sub->product_key == NULL || sub->device_name == NULL ||
+        aws_hash_table_put(&gw->subs, sub->key, sub, NULL) != AWS_OP_SUCCESS) {
+        _gateway_sub_destroy(sub);
+        return NULL;
+    }
+    return sub;
+}
+
+static void _gateway_replace_secret(char **dst, const char *secret) {
+    if (secret == NULL || (*dst != NULL && strcmp(*dst, secret) == 0)) {
+        return;
+    }
+    char *copy = strdup(secret);
+    if (copy != NULL) {
+        free(*dst);
+        *dst = copy;
+    }
+}
+
+// 添加拓扑优先用一型一密的product_secret签名，登录用设备的device_secret
+static const char *_gateway_sign_secret(iot_gateway_op_t op, const char *device_secret, const char *product_secret) {
+    switch (op) {
+        case IOT_GATEWAY_OP_ADD_TOPO:
+            return product_secret != NULL ? product_secret : device_secret;
+        case IOT_GATEWAY_OP_LOGIN:
+            return device_secret;
+        default:
+            return NULL;
+    }
+}
+
+static bool _gateway_needs_secret(iot_gateway_op_t op) {
+    return op == IOT_GATEWAY_OP_ADD_TOPO || op == IOT_GATEWAY_OP_LOGIN;
+}
+
+int iot_gateway_init(iot_gateway_t *gw, const iot_gateway_limits_t *limits, const char *gateway_secret,
+                     iot_gateway_send_fn send, iot_gateway_result_fn on_result, void *userdata) {
+    if (gw == NULL || send == NULL) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    memset(gw, 0, sizeof(iot_gateway_t));
+    iot_gateway_limits_t l = {0};
+    if (limits != NULL) {
+        l = *limits;
+    }
+    gw->limits.batch_max_devices = _gateway_limit_or(l.batch_max_devices, IOT_GATEWAY_DEFAULT_BATCH_MAX_DEVICES);
+    gw->limits.batch_max_bytes = _gateway_limit_or(l.batch_max_bytes, IOT_GATEWAY_DEFAULT_BATCH_MAX_BYTES);
+    gw->limits.max_inflight = _gateway_limit_or(l.max_inflight, IOT_GATEWAY_DEFAULT_MAX_INFLIGHT);
+    gw->limits.min_interval_ms = _gateway_limit_or(l.min_interval_ms, IOT_GATEWAY_DEFAULT_MIN_INTERVAL_MS);
+    gw->limits.reply_timeout_ms = _gateway_limit_or(l.reply_timeout_ms, IOT_GATEWAY_DEFAULT_REPLY_TIMEOUT_MS);
+    gw->limits.max_attempts = _gateway_limit_or(l.max_attempts, IOT_GATEWAY_DEFAULT_MAX_ATTEMPTS);
+
+    gw->inflight = (iot_gateway_batch_t *) calloc(gw->limits.max_inflight, sizeof(iot_gateway_batch_t));
+    if (gw->inflight == NULL) {
+        return VOLC_ERR_MALLOC;
+    }
+    if (aws_hash_table_init(&gw->subs, aws_alloc(), 16, aws_hash_c_string, aws_hash_callback_c_str_eq,
+                            NULL, _gateway_sub_destroy) != AWS_OP_SUCCESS) {
+        free(gw->inflight);
+        gw->inflight = NULL;
+        return VOLC_ERR_MALLOC;
+    }
+    if (gateway_secret != NULL) {
+        gw->gateway_secret = strdup(gateway_secret);
+    }
+    gw->send = send;
+    gw->on_result = on_result;
+    gw->userdata = userdata;
+    platform_mutex_init(gw->mutex);
+    return VOLC_OK;
+}
+
+void iot_gateway_deinit(iot_gateway_t *gw) {
+    if (gw == NULL || gw->send == NULL) {
+        return;
+    }
+    for (int op = 0; op < IOT_GATEWAY_OP_MAX; op++) {
+        free(gw->queues[op].subs);
+    }
+    for (size_t i = 0; i < gw->inflight_count; i++) {
+        free(gw->inflight[i].subs);
+    }
+    free(gw->inflight);
+    aws_hash_table_clean_up(&gw->subs);
+    free(gw->gateway_secret);
+    platform_mutex_destroy(gw->mutex);
+    memset(gw, 0, sizeof(iot_gateway_t));
+}
+
+static int _gateway_queue_push(iot_gateway_queue_t *q, iot_gateway_sub_t *sub) {
+    if (q->count == q->cap) {
+        size_t cap = q->cap == 0 ? 16 : q->cap * 2;
+        iot_gateway_sub_t **subs = (iot_gateway_sub_t **) realloc(q->subs, cap * sizeof(iot_gateway_sub_t *));
+        if (subs == NULL) {
+            return VOLC_ERR_MALLOC;
+        }
+        q->subs = subs;
+        q->cap = cap;
+    }
+    q->subs[q->count++] = sub;
+    return VOLC_OK;
+}
+
+static int _gateway_mark_queued(iot_gateway_t *gw, iot_gateway_sub_t *sub, iot_gateway_op_t op) {
+    uint8_t bit = (uint8_t) (1u << op);
+    if (!(sub->listed & bit)) {
+        if (_gateway_queue_push(&gw->queues[op], sub) != VOLC_OK) {
+            return VOLC_ERR_MALLOC;
+        }
+        sub->listed |= bit;
+    }
+    sub->queued |= bit;
+    return VOLC_OK;
+}
+
+static int _gateway_enqueue(iot_gateway_t *gw, iot_gateway_sub_t *sub, iot_gateway_op_t op) {
+    int opposite = _gateway_opposite(op);
+    if (opposite != GATEWAY_NO_OP) {
+        // 尚未发出的反向请求直接取消
+        sub->queued &= (uint8_t) ~(1u << opposite);
+    }
+    if ((sub->queued & (1u << op)) || sub->inflight_op == (int8_t) op) {
+        return VOLC_OK;
+    }
+    if (op == IOT_GATEWAY_OP_LOGIN && sub->state == IOT_GATEWAY_SUB_ONLINE &&
+        sub->inflight_op != IOT_GATEWAY_OP_LOGOUT) {
+        return VOLC_OK;
+    }
+    if (op == IOT_GATEWAY_OP_LOGOUT && sub->state == IOT_GATEWAY_SUB_OFFLINE &&
+        sub->inflight_op != IOT_GATEWAY_OP_LOGIN) {
+        return VOLC_OK;
+    }
+    return _gateway_mark_queued(gw, sub, op);
+}
+
+int iot_gateway_request(iot_gateway_t *gw, iot_gateway_op_t op, const iot_gateway_sub_device_t *devices, size_t count) {
+    if (gw == NULL || gw->send == NULL || op >= IOT_GATEWAY_OP_MAX || (devices == NULL && count > 0)) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    int ret = VOLC_OK;
+    platform_mutex_lock(gw->mutex);
+    // 先整体校验，有不合法的子设备时整批都不排队
+    for (size_t i = 0; i < count && ret == VOLC_OK; i++) {
+        const iot_gateway_sub_device_t *d = &devices[i];
+        char key[GATEWAY_KEY_SIZE];
+        if (d->product_key == NULL || d->product_key[0] == '\0' || !_check_device_name_legality(d->device_name) ||
+            !_gateway_format_key(key, d->product_key, d->device_name)) {
+            ret = VOLC_ERR_INVALID_PARAM;
+            break;
+        }
+        if (_gateway_needs_secret(op)) {
+            iot_gateway_sub_t *known = _gateway_sub_find(gw, key);
+            const char *device_secret = d->device_secret != NULL ? d->device_secret :
+                                        known != NULL ? known->device_secret : NULL;
+            const char *product_secret = d->product_secret != NULL ? d->product_secret :
+                                         known != NULL ? known->product_secret : NULL;
+            if (_gateway_sign_secret(op, device_secret, product_secret) == NULL) {
+                ret = VOLC_ERR_TM_GATEWAY_NO_SECRET;
+            }
+        }
+    }
+    for (size_t i = 0; i < count && ret == VOLC_OK; i++) {
+        const iot_gateway_sub_device_t *d = &devices[i];
+        iot_gateway_sub_t *sub = _gateway_sub_get(gw, d->product_key, d->device_name);
+        if (sub == NULL) {
+            ret = VOLC_ERR_MALLOC;
+            break;
+        }
+        _gateway_replace_secret(&sub->device_secret, d->device_secret);
+        _gateway_replace_secret(&sub->product_secret, d->product_secret);
+        ret = _gateway_enqueue(gw, sub, op);
+    }
+    platform_mutex_unlock(gw->mutex);
+    return ret;
+}
+
+static void _gateway_write_item(json_writer_t *w, iot_gateway_op_t op, const iot_gateway_sub_t *sub) {
+    json_writer_begin_object(w);
+    json_writer_kv_string(w, "ProductKey", sub->product_key);
+    json_writer_kv_string(w, "DeviceName", sub->device_name);
+    const char *secret = _gateway_sign_secret(op, sub->device_secret, sub->product_secret);
+    if (secret != NULL) {
+        iot_dynamic_register_basic_param_t param = {0};
+        param.product_key = sub->product_key;
+        param.device_name = sub->device_name;
+        param.random_num = random_num();
+        param.timestamp = iot_now_ms() / 1000;
+        param.auth_type = ONESDK_AUTH_DYNAMIC_PRE_REGISTERED;
+        struct aws_string *signature = iot_hmac_sha256_encrypt(aws_alloc(), &param, secret);
+        json_writer_kv_int(w, "random_num", param.random_num);
+        json_writer_kv_int(w, "timestamp", (int64_t) param.timestamp);
+        json_writer_kv_string(w, "signature", signature != NULL ? aws_string_c_str(signature) : NULL);
+        aws_string_destroy_secure(signature);
+    }
+    json_writer_end_object(w);
+}
+
+/**
+ * 从op的队列取一批写入buf，调用时持有锁，batch->subs至少能放batch_max_devices个
+ * 已取消的项移出队列；有请求在途的子设备留在队列中，等在途请求结束后再发
+ */
+static bool _gateway_take_batch(iot_gateway_t *gw, iot_gateway_op_t op, iot_gateway_batch_t *batch,
+                                struct aws_byte_buf *buf, uint64_t now_ms) {
+    iot_gateway_queue_t *q = &gw->queues[op];
+    uint8_t bit = (uint8_t) (1u << op);
+    json_writer_t w;
+    bool full = false;
+    size_t kept = 0;
+    batch->count = 0;
+    for (size_t i = 0; i < q->count; i++) {
+        iot_gateway_sub_t *sub = q->subs[i];
+        if (!(sub->queued & bit)) {
+            sub->listed &= (uint8_t) ~bit;
+            continue;
+        }
+        if (full || sub->inflight_op != GATEWAY_NO_OP || batch->count >= gw->limits.batch_max_devices) {
+            q->subs[kept++] = sub;
+            continue;
+        }
+        if (batch->count == 0) {
+            snprintf(batch->id, sizeof(batch->id), "%" PRIu64 "%05" PRIu32, now_ms, gw->seq++ % 100000);
+            json_writer_init(&w, buf);
+            json_writer_begin_object(&w);
+            json_writer_kv_string(&w, "ID", batch->id);
+            json_writer_kv_string(&w, "Version", SDK_VERSION);
+            json_writer_key(&w, "params");
+            json_writer_begin_array(&w);
+        }
+        json_writer_t saved = w;
+        size_t saved_len = buf->len;
+        _gateway_write_item(&w, op, sub);
+        // 第一项总是放入，之后超出字节上限时回退，留到下一批
+        if (batch->count > 0 && (w.error != 0 || buf->len + GATEWAY_PAYLOAD_TAIL > gw->limits.batch_max_bytes)) {
+            w = saved;
+            buf->len = saved_len;
+            full = true;
+            q->subs[kept++] = sub;
+            continue;
+        }
+        sub->queued &= (uint8_t) ~bit;
+        sub->listed &= (uint8_t) ~bit;
+        sub->inflight_op = (int8_t) op;
+        batch->subs[batch->count++] = sub;
+    }
+    q->count = kept;
+    if (batch->count == 0) {
+        return false;
+    }
+    json_writer_end_array(&w);
+    json_writer_end_object(&w);
+    if (json_writer_finish(&w) != VOLC_OK) {
+        LOGW(TAG_IOT_MQTT, "gateway request %s payload incomplete", batch->id);
+    }
+    batch->op = op;
+    return true;
+}
+
+static iot_gateway_device_id_t *_gateway_device_ids(iot_gateway_sub_t **subs, size_t count) {
+    iot_gateway_device_id_t *ids = (iot_gateway_device_id_t *) malloc(count * sizeof(iot_gateway_device_id_t));
+    if (ids == NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; i < count; i++) {
+        ids[i].product_key = subs[i]->product_key;
+        ids[i].device_name = subs[i]->device_name;
+    }
+    return ids;
+}
+
+static void _gateway_remove_inflight(iot_gateway_t *gw, size_t index) {
+    gw->inflight[index] = gw->inflight[--gw->inflight_count];
+}
+
+// 处理一批超时的请求：未超过重试次数的子设备重新排队，其余按失败回调
+static bool _gateway_expire_one(iot_gateway_t *gw, uint64_t now_ms) {
+    platform_mutex_lock(gw->mutex);
+    size_t index = gw->inflight_count;
+    for (size_t i = 0; i < gw->inflight_count; i++) {
+        if (now_ms >= gw->inflight[i].sent_ms + gw->limits.reply_timeout_ms) {
+            index = i;
+            break;
+        }
+    }
+    if (index == gw->inflight_count) {
+        platform_mutex_unlock(gw->mutex);
+        return false;
+    }
+    iot_gateway_batch_t batch = gw->inflight[index];
+    _gateway_remove_inflight(gw, index);
+    gw->timeouts++;
+    size_t failed = 0;
+    for (size_t i = 0; i < batch.count; i++) {
+        iot_gateway_sub_t *sub = batch.subs[i];
+        int opposite = _gateway_opposite(batch.op);
+        sub->inflight_op = GATEWAY_NO_OP;
+        sub->attempts++;
+        // 等待期间已请求反向操作时不再重发
+        bool retry = sub->attempts < gw->limits.max_attempts &&
+                     (opposite == GATEWAY_NO_OP || !(sub->queued & (1u << opposite)));
+        if (retry && _gateway_mark_queued(gw, sub, batch.op) == VOLC_OK) {
+            continue;
+        }
+        sub->attempts = 0;
+        batch.subs[failed++] = sub;
+    }
+    iot_gateway_device_id_t *ids = failed > 0 ? _gateway_device_ids(batch.subs, failed) : NULL;
+    platform_mutex_unlock(gw->mutex);
+
+    LOGW(TAG_IOT_MQTT, "gateway request %s timeout, %zu of %zu devices failed", batch.id, failed, batch.count);
+    if (ids != NULL && gw->on_result != NULL) {
+        gw->on_result(batch.op, batch.id, VOLC_ERR_TM_GATEWAY_REPLY_TIMEOUT, ids, failed, gw->userdata);
+    }
+    free(ids);
+    free(batch.subs);
+    return true;
+}
+
+// 有可以立即组批的子设备
+static bool _gateway_has_ready(iot_gateway_t *gw) {
+    for (int op = 0; op < IOT_GATEWAY_OP_MAX; op++) {
+        const iot_gateway_queue_t *q = &gw->queues[op];
+        for (size_t i = 0; i < q->count; i++) {
+            if ((q->subs[i]->queued & (1u << op)) && q->subs[i]->inflight_op == GATEWAY_NO_OP) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+int32_t iot_gateway_poll(iot_gateway_t *gw, uint64_t now_ms) {
+    if (gw == NULL || gw->send == NULL) {
+        return -1;
+    }
+    while (_gateway_expire_one(gw, now_ms)) {
+    }
+    for (;;) {
+        platform_mutex_lock(gw->mutex);
+        if (gw->inflight_count >= gw->limits.max_inflight || now_ms < gw->next_send_ms) {
+            platform_mutex_unlock(gw->mutex);
+            break;
+        }
+        iot_gateway_batch_t batch;
+        memset(&batch, 0, sizeof(batch));
+        batch.subs = (iot_gateway_sub_t **) malloc(gw->limits.batch_max_devices * sizeof(iot_gateway_sub_t *));
+        if (batch.subs == NULL) {
+            platform_mutex_unlock(gw->mutex);
+            break;
+        }
+        struct aws_byte_buf buf;
+        aws_byte_buf_init(&buf, aws_alloc(), 512);
+        bool taken = false;
+        for (int op = 0; op < IOT_GATEWAY_OP_MAX && !taken; op++) {
+            taken = _gateway_take_batch(gw, (iot_gateway_op_t) op, &batch, &buf, now_ms);
+        }
+        if (!taken) {
+            platform_mutex_unlock(gw->mutex);
+            free(batch.subs);
+            aws_byte_buf_clean_up(&buf);
+            break;
+        }
+        batch.sent_ms = now_ms;
+        gw->inflight[gw->inflight_count++] = batch;
+        gw->next_send_ms = now_ms + gw->limits.min_interval_ms;
+        gw->requests_out++;
+        gw->devices_out += batch.count;
+        platform_mutex_unlock(gw->mutex);
+
+        // 发送失败时等到超时重发
+        int ret = gw->send(batch.op, (const char *) buf.buffer, buf.len, gw->userdata);
+        if (ret != VOLC_OK) {
+            LOGW(TAG_IOT_MQTT, "gateway request %s send failed, ret = %d", batch.id, ret);
+        }
+        aws_byte_buf_clean_up(&buf);
+    }
+
+    int64_t next = -1;
+    platform_mutex_lock(gw->mutex);
+    for (size_t i = 0; i < gw->inflight_count; i++) {
+        uint64_t due = gw->inflight[i].sent_ms + gw->limits.reply_timeout_ms;
+        int64_t wait = due > now_ms ? (int64_t) (due - now_ms) : 0;
+        if (next < 0 || wait < next) {
+            next = wait;
+        }
+    }
+    if (gw->inflight_count < gw->limits.max_inflight && _gateway_has_ready(gw)) {
+        int64_t wait = gw->next_send_ms > now_ms ? (int64_t) (gw->next_send_ms - now_ms) : 0;
+        if (next < 0 || wait < next) {
+            next = wait;
+        }
+    }
+    platform_mutex_unlock(gw->mutex);
+    return next > INT32_MAX ? INT32_MAX : (int32_t) next;
+}
+
+// 添加拓扑回复中下发的子设备密钥，用网关的设备密钥解密后保存，调用时持有锁
+static void _gateway_store_secrets(iot_gateway_t *gw, struct aws_json_value *data) {
+    if (gw->gateway_secret == NULL || data == NULL || !aws_json_value_is_array(data)) {
+        return;
+    }
+    size_t size = aws_json_get_array_size(data);
+    for (size_t i = 0; i < size; i++) {
+        struct aws_json_value *item = aws_json_get_array_element(data, i);
+        struct aws_byte_cursor pk = aws_json_get_str_byte_cur_val(item, "ProductKey");
+        struct aws_byte_cursor dn = aws_json_get_str_byte_cur_val(item, "DeviceName");
+        struct aws_json_value *secret_json = aws_json_get_json_obj(aws_alloc(), item, "device_secret");
+        struct aws_byte_cursor payload = {0};
+        if (secret_json != NULL) {
+            payload = aws_json_get_str_byte_cur_val(secret_json, "payload");
+        }
+        char key[GATEWAY_KEY_SIZE];
+        int n = snprintf(key, sizeof(key), "%.*s/%.*s", (int) pk.len, (const char *) pk.ptr,
+                         (int) dn.len, (const char *) dn.ptr);
+        if (payload.len == 0 || n <= 0 || n >= (int) sizeof(key)) {
+            continue;
+        }
+        iot_gateway_sub_t *sub = _gateway_sub_find(gw, key);
+        if (sub == NULL) {
+            continue;
+        }
+        char *encrypted = aws_cur_to_char_str(aws_alloc(), &payload);
+        char *secret = encrypted != NULL ? aes_decode(aws_alloc(), gw->gateway_secret, encrypted, false) : NULL;
+        if (secret != NULL) {
+            free(sub->device_secret);
+            sub->device_secret = secret;
+        } else {
+            LOGW(TAG_IOT_MQTT, "gateway decode device secret of %s failed", key);
+        }
+        aws_mem_release(aws_alloc(), encrypted);
+    }
+}
+
+static void _gateway_apply_success(iot_gateway_t *gw, iot_gateway_op_t op, iot_gateway_sub_t *sub) {
+    switch (op) {
+        case IOT_GATEWAY_OP_LOGIN:
+            if (sub->state != IOT_GATEWAY_SUB_ONLINE) {
+                sub->state = IOT_GATEWAY_SUB_ONLINE;
+                gw->online++;
+            }
+            break;
+        case IOT_GATEWAY_OP_LOGOUT:
+        case IOT_GATEWAY_OP_DELETE_TOPO:
+            if (sub->state == IOT_GATEWAY_SUB_ONLINE) {
+                gw->online--;
+            }
+            sub->state = IOT_GATEWAY_SUB_OFFLINE;
+            break;
+        case IOT_GATEWAY_OP_ADD_TOPO:
+            if (sub->state == IOT_GATEWAY_SUB_UNKNOWN) {
+                sub->state = IOT_GATEWAY_SUB_OFFLINE;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+int iot_gateway_on_reply(iot_gateway_t *gw, iot_gateway_op_t op, const char *payload, size_t len) {
+    if (gw == NULL || gw->send == NULL || payload == NULL || op >= IOT_GATEWAY_OP_MAX) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    struct aws_json_value *root = aws_json_value_new_from_string(aws_alloc(),
+        aws_byte_cursor_from_array(payload, len));
+    if (root == NULL) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    struct aws_byte_cursor id = aws_json_get_str_byte_cur_val(root, "ID");
+    struct aws_json_value *code_json = aws_json_value_get_from_object(root, aws_byte_cursor_from_c_str("Code"));
+    double code = 0;
+    if (id.len == 0 || code_json == NULL || aws_json_value_get_number(code_json, &code) != AWS_OP_SUCCESS) {
+        aws_json_value_destroy(root);
+        return VOLC_ERR_INVALID_PARAM;
+    }
+
+    platform_mutex_lock(gw->mutex);
+    size_t index = gw->inflight_count;
+    for (size_t i = 0; i < gw->inflight_count; i++) {
+        const iot_gateway_batch_t *b = &gw->inflight[i];
+        if (b->op == op && strlen(b->id) == id.len && memcmp(b->id, id.ptr, id.len) == 0) {
+            index = i;
+            break;
+        }
+    }
+    if (index == gw->inflight_count) {
+        platform_mutex_unlock(gw->mutex);
+        aws_json_value_destroy(root);
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    iot_gateway_batch_t batch = gw->inflight[index];
+    _gateway_remove_inflight(gw, index);
+    for (size_t i = 0; i < batch.count; i++) {
+        iot_gateway_sub_t *sub = batch.subs[i];
+        sub->inflight_op = GATEWAY_NO_OP;
+        sub->attempts = 0;
+        if (code == 0) {
+            _gateway_apply_success(gw, op, sub);
+        }
+    }
+    if (code == 0 && op == IOT_GATEWAY_OP_ADD_TOPO) {
+        struct aws_json_value *data = aws_json_get_json_obj(aws_alloc(), root, "Data");
+        _gateway_store_secrets(gw, data != NULL ? data : aws_json_get_json_obj(aws_alloc(), root, "data"));
+    }
+    iot_gateway_device_id_t *ids = _gateway_device_ids(batch.subs, batch.count);
+    platform_mutex_unlock(gw->mutex);
+
+    if (gw->on_result != NULL) {
+        gw->on_result(op, batch.id, (int32_t) code, ids, ids != NULL ? batch.count : 0, gw->userdata);
+    }
+    free(ids);
+    free(batch.subs);
+    aws_json_value_destroy(root);
+    return VOLC_OK;
+}
+
+void iot_gateway_mark_offline(iot_gateway_t *gw, const char *product_key, const char *device_name) {
+    char key[GATEWAY_KEY_SIZE];
+    if (gw == NULL || gw->send == NULL || product_key == NULL || device_name == NULL ||
+        !_gateway_format_key(key, product_key, device_name)) {
+        return;
+    }
+    platform_mutex_lock(gw->mutex);
+    iot_gateway_sub_t *sub = _gateway_sub_find(gw, key);
+    if (sub != NULL) {
+        if (sub->state == IOT_GATEWAY_SUB_ONLINE) {
+            gw->online--;
+        }
+        sub->state = IOT_GATEWAY_SUB_OFFLINE;
+        sub->queued = 0;
+    }
+    platform_mutex_unlock(gw->mutex);
+}
+
+size_t iot_gateway_on_reconnect(iot_gateway_t *gw) {
+    if (gw == NULL || gw->send == NULL) {
+        return 0;
+    }
+    uint8_t logout_bit = (uint8_t) (1u << IOT_GATEWAY_OP_LOGOUT);
+    size_t relogin = 0;
+    platform_mutex_lock(gw->mutex);
+    for (struct aws_hash_iter iter = aws_hash_iter_begin(&gw->subs); !aws_hash_iter_done(&iter);
+         aws_hash_iter_next(&iter)) {
+        iot_gateway_sub_t *sub = (iot_gateway_sub_t *) iter.element.value;
+        if (sub->state != IOT_GATEWAY_SUB_ONLINE) {
+            continue;
+        }
+        sub->state = IOT_GATEWAY_SUB_OFFLINE;
+        gw->online--;
+        if ((sub->queued & logout_bit) || sub->inflight_op == IOT_GATEWAY_OP_LOGOUT) {
+            sub->queued &= (uint8_t) ~logout_bit;
+            continue;
+        }
+        if (_gateway_enqueue(gw, sub, IOT_GATEWAY_OP_LOGIN) == VOLC_OK) {
+            relogin++;
+        }
+    }
+    platform_mutex_unlock(gw->mutex);
+    if (relogin > 0) {
+        LOGI(TAG_IOT_MQTT, "gateway reconnected, %zu sub devices queued for login", relogin);
+    }
+    return relogin;
+}
+
+iot_gateway_sub_state_t iot_gateway_sub_state(iot_gateway_t *gw, const char *product_key, const char *device_name) {
+    char key[GATEWAY_KEY_SIZE];
+    if (gw == NULL || gw->send == NULL || product_key == NULL || device_name == NULL ||
+        !_gateway_format_key(key, product_key, device_name)) {
+        return IOT_GATEWAY_SUB_UNKNOWN;
+    }
+    iot_gateway_sub_state_t state = IOT_GATEWAY_SUB_UNKNOWN;
+    platform_mutex_lock(gw->mutex);
+    iot_gateway_sub_t *sub = _gateway_sub_find(gw, key);
+    if (sub != NULL) {
+        state = sub->state;
+        if ((sub->queued & (1u << IOT_GATEWAY_OP_LOGIN)) || sub->inflight_op == IOT_GATEWAY_OP_LOGIN) {
+            state = IOT_GATEWAY_SUB_LOGGING_IN;
+        } else if ((sub->queued & (1u << IOT_GATEWAY_OP_LOGOUT)) || sub->inflight_op == IOT_GATEWAY_OP_LOGOUT) {
+            state = IOT_GATEWAY_SUB_LOGGING_OUT;
+        }
+    }
+    platform_mutex_unlock(gw->mutex);
+    return state;
+}
+
+size_t iot_gateway_online_count(iot_gateway_t *gw) {
+    if (gw == NULL || gw->send == NULL) {
+        return 0;
+    }
+    platform_mutex_lock(gw->mutex);
+    size_t online = gw->online;
+    platform_mutex_unlock(gw->mutex);
+    return online;
+}
+
+
+// 网关请求的topic，按iot_gateway_op_t排列
+static const char *const g_gateway_request_topics[IOT_GATEWAY_OP_MAX] = {
+        "sys/%s/%s/gateway/topo/add",
+        "sys/%s/%s/gateway/sub/login",
+        "sys/%s/%s/gateway/sub/logout",
+        "sys/%s/%s/gateway/topo/delete",
+        "sys/%s/%s/gateway/sub/discovery",
+};
+
+static const iot_tm_recv_type_t g_gateway_reply_types[IOT_GATEWAY_OP_MAX] = {
+        IOT_TM_RECV_GATEWAY_ADD_TOPO_REPLY,
+        IOT_TM_RECV_GATEWAY_SUB_DEVICE_LOGIN,
+        IOT_TM_RECV_GATEWAY_SUB_DEVICE_LOGOUT,
+        IOT_TM_RECV_GATEWAY_DELETE_TOPO_REPLY,
+        IOT_TM_RECV_GATEWAY_SUB_DEVICE_DISCOVERY,
+};
+
+#define GATEWAY_GET_TOPO_TOPIC "sys/%s/%s/gateway/topo/get"
+#define GATEWAY_TOPO_CHANGE_REPLY_TOPIC "sys/%s/%s/gateway/topo/change_reply"
+#define GATEWAY_SUB_CHANGE_REPLY_TOPIC "sys/%s/%s/gateway/sub/change_reply"
+
+static int _tm_gateway_publish(iot_tm_handler_t *handle, const char *fmt, const char *payload, size_t len) {
+    iot_basic_config_t *config = handle->mqtt_handle->config->basic_config;
+    char scratch[IOT_TM_TOPIC_SCRATCH_SIZE];
+    char *heap = NULL;
+    const char *topic = iot_tm_topic_format(scratch, sizeof(scratch), &heap, fmt, config->product_key,
+                                            config->device_name, NULL, NULL, NULL);
+    if (topic == NULL) {
+        return VOLC_ERR_MALLOC;
+    }
+    LOGD(TAG_IOT_MQTT, "_tm_gateway_publish call topic = %s,  payload = %.*s", topic, (int) len, payload);
+    int ret = iot_mqtt_publish(handle->mqtt_handle, topic, (const uint8_t *) payload, len, IOT_MQTT_QOS1);
+    free(heap);
+    return ret < 0 ? ret : VOLC_OK;
+}
+
+int _tm_gateway_send(iot_gateway_op_t op, const char *payload, size_t len, void *userdata) {
+    return _tm_gateway_publish((iot_tm_handler_t *) userdata, g_gateway_request_topics[op], payload, len);
+}
+
+static void _tm_gateway_callback(iot_tm_handler_t *handle, iot_tm_recv_t *recv) {
+    if (handle->recv_handler == NULL) {
+        return;
+    }
+    iot_basic_config_t *config = handle->mqtt_handle->config->basic_config;
+    recv->product_key = config->product_key;
+    recv->device_name = config->device_name;
+    handle->recv_handler(handle, recv, handle->userdata);
+}
+
+void _tm_gateway_result(iot_gateway_op_t op, const char *id, int32_t code,
+                        const iot_gateway_device_id_t *devices, size_t count, void *userdata) {
+    iot_tm_handler_t *handle = (iot_tm_handler_t *) userdata;
+    iot_tm_recv_t recv;
+    memset(&recv, 0, sizeof(recv));
+    recv.type = g_gateway_reply_types[op];
+    recv.data.gateway_reply.id = id;
+    recv.data.gateway_reply.code = code;
+    recv.data.gateway_reply.devices = devices;
+    recv.data.gateway_reply.count = count;
+    _tm_gateway_callback(handle, &recv);
+}
+
+/**
+ * 把JSON数组中的子设备转成device_id，字符串与数组在同一块内存中，调用方free(*devices)
+ * @return 子设备数
+ */
+static size_t _tm_gateway_parse_devices(struct aws_json_value *array, iot_gateway_device_id_t **devices) {
+    *devices = NULL;
+    if (array == NULL || !aws_json_value_is_array(array)) {
+        return 0;
+    }
+    size_t count = aws_json_get_array_size(array);
+    size_t total = count * sizeof(iot_gateway_device_id_t);
+    for (size_t i = 0; i < count; i++) {
+        struct aws_json_value *item = aws_json_get_array_element(array, i);
+        total += aws_json_get_str_byte_cur_val(item, "ProductKey").len + 1;
+        total += aws_json_get_str_byte_cur_val(item, "DeviceName").len + 1;
+    }
+    if (count == 0 || (*devices = (iot_gateway_device_id_t *) malloc(total)) == NULL) {
+        return 0;
+    }
+    char *strings = (char *) (*devices + count);
+    for (size_t i = 0; i < count; i++) {
+        struct aws_json_value *item = aws_json_get_array_element(array, i);
+        struct aws_byte_cursor pk = aws_json_get_str_byte_cur_val(item, "ProductKey");
+        struct aws_byte_cursor dn = aws_json_get_str_byte_cur_val(item, "DeviceName");
+        (*devices)[i].product_key = strings;
+        if (pk.len > 0) {
+            memcpy(strings, pk.ptr, pk.len);
+        }
+        strings[pk.len] = '\0';
+        strings += pk.len + 1;
+        (*devices)[i].device_name = strings;
+        if (dn.len > 0) {
+            memcpy(strings, dn.ptr, dn.len);
+        }
+        strings[dn.len] = '\0';
+        strings += dn.len + 1;
+    }
+    return count;
+}
+
+static void _tm_recv_gateway_reply(iot_gateway_op_t op, const char *topic, const uint8_t *payload, size_t len,
+                                   void *pUserData) {
+    iot_tm_handler_t *handle = (iot_tm_handler_t *) pUserData;
+    LOGD(TAG_IOT_MQTT, "_tm_recv_gateway_reply call topic = %s,  payload = %.*s", topic, (int) len, payload);
+    if (handle == NULL || handle->gateway == NULL) {
+        return;
+    }
+    // 超时重发后，旧请求的回复找不到对应请求
+    if (iot_gateway_on_reply(handle->gateway, op, (const char *) payload, len) != VOLC_OK) {
+        LOGI(TAG_IOT_MQTT, "ignore gateway reply without pending request, topic = %s", topic);
+    }
+}
+
+static void _tm_recv_gateway_add_topo_reply_handler(const char *topic, const uint8_t *payload, size_t len,
+                                                    void *pUserData) {
+    _tm_recv_gateway_reply(IOT_GATEWAY_OP_ADD_TOPO, topic, payload, len, pUserData);
+}
+
+static void _tm_recv_gateway_sub_device_login_reply_handler(const char *topic, const uint8_t *payload, size_t len,
+                                                            void *pUserData) {
+    _tm_recv_gateway_reply(IOT_GATEWAY_OP_LOGIN, topic, payload, len, pUserData);
+}
+
+static void _tm_recv_gateway_sub_device_logout_reply_handler(const char *topic, const uint8_t *payload, size_t len,
+                                                             void *pUserData) {
+    _tm_recv_gateway_reply(IOT_GATEWAY_OP_LOGOUT, topic, payload, len, pUserData);
+}
+
+static void _tm_recv_gateway_delete_topo_reply_handler(const char *topic, const uint8_t *payload, size_t len,
+                                                       void *pUserData) {
+    _tm_recv_gateway_reply(IOT_GATEWAY_OP_DELETE_TOPO, topic, payload, len, pUserData);
+}
+
+static void _tm_recv_gateway_sub_device_discovery_reply_handler(const char *topic, const uint8_t *payload, size_t len,
+                                                                void *pUserData) {
+    _tm_recv_gateway_reply(IOT_GATEWAY_OP_DISCOVERY, topic, payload, len, pUserData);
+}
+
+static void _tm_recv_gateway_get_topo_reply_handler(const char *topic, const uint8_t *payload, size_t len,
+                                                    void *pUserData) {
+    iot_tm_handler_t *handle = (iot_tm_handler_t *) pUserData;
+    LOGD(TAG_IOT_MQTT, "_tm_recv_gateway_get_topo_reply_handler call topic = %s,  payload = %.*s", topic,
+         (int) len, payload);
+    struct aws_json_value *root = aws_json_value_new_from_string(handle->allocator,
+        aws_byte_cursor_from_array(payload, len));
+    if (root == NULL) {
+        return;
+    }
+    struct aws_byte_cursor id_cur = aws_json_get_str_byte_cur_val(root, "ID");
+    struct aws_json_value *data = aws_json_get_json_obj(handle->allocator, root, "Data");
+    iot_gateway_device_id_t *devices = NULL;
+    size_t count = _tm_gateway_parse_devices(data != NULL ? data : aws_json_get_json_obj(handle->allocator, root, "data"),
+                                             &devices);
+    char *id = aws_cur_to_char_str(handle->allocator, &id_cur);
+
+    iot_tm_recv_t recv;
+    memset(&recv, 0, sizeof(recv));
+    recv.type = IOT_TM_RECV_GATEWAY_GET_TOPO_REPLY;
+    recv.data.gateway_reply.id = id;
+    recv.data.gateway_reply.code = (int32_t) aws_json_get_num_val(root, "Code");
+    recv.data.gateway_reply.devices = devices;
+    recv.data.gateway_reply.count = count;
+    _tm_gateway_callback(handle, &recv);
+
+    aws_mem_release(handle->allocator, id);
+    free(devices);
+    aws_json_value_destroy(root);
+}
+
+static iot_gateway_topo_change_type_t _tm_gateway_change_type(struct aws_byte_cursor operate_type) {
+    if (aws_byte_cursor_eq_c_str(&operate_type, "create")) {
+        return IOT_GATEWAY_TOPO_CHANGE_TYPE_CREATE;
+    } else if (aws_byte_cursor_eq_c_str(&operate_type, "delete")) {
+        return IOT_GATEWAY_TOPO_CHANGE_TYPE_DELETE;
+    } else if (aws_byte_cursor_eq_c_str(&operate_type, "enable")) {
+        return IOT_GATEWAY_TOPO_CHANGE_TYPE_ENABLE;
+    } else if (aws_byte_cursor_eq_c_str(&operate_type, "disable")) {
+        return IOT_GATEWAY_TOPO_CHANGE_TYPE_DISABLE;
+    }
+    return IOT_GATEWAY_TOPO_CHANGE_TYPE_UNKNOWN;
+}
+
+// 服务端下发的拓扑或子设备状态变化：删除、禁用的子设备标记为离线，回复后交给recv_handler
+static void _tm_recv_gateway_change_notify(iot_tm_recv_type_t type, const char *reply_topic, const char *topic,
+                                           const uint8_t *payload, size_t len, void *pUserData) {
+    iot_tm_handler_t *handle = (iot_tm_handler_t *) pUserData;
+    LOGD(TAG_IOT_MQTT, "_tm_recv_gateway_change_notify call topic = %s,  payload = %.*s", topic, (int) len, payload);
+    struct aws_json_value *root = aws_json_value_new_from_string(handle->allocator,
+        aws_byte_cursor_from_array(payload, len));
+    if (root == NULL) {
+        return;
+    }
+    struct aws_byte_cursor id_cur = aws_json_get_str_byte_cur_val(root, "ID");
+    struct aws_json_value *params = aws_json_get_json_obj(handle->allocator, root, "params");
+    iot_gateway_topo_change_type_t change_type = IOT_GATEWAY_TOPO_CHANGE_TYPE_UNKNOWN;
+    iot_gateway_device_id_t *devices = NULL;
+    size_t count = 0;
+    if (params != NULL) {
+        change_type = _tm_gateway_change_type(aws_json_get_str_byte_cur_val(params, "operate_type"));
+        count = _tm_gateway_parse_devices(aws_json_get_json_obj(handle->allocator, params, "sub_devices"), &devices);
+    }
+    if (handle->gateway != NULL && (change_type == IOT_GATEWAY_TOPO_CHANGE_TYPE_DELETE ||
+                                    change_type == IOT_GATEWAY_TOPO_CHANGE_TYPE_DISABLE)) {
+        for (size_t i = 0; i < count; i++) {
+            iot_gateway_mark_offline(handle->gateway, devices[i].product_key, devices[i].device_name);
+        }
+    }
+    char *id = aws_cur_to_char_str(handle->allocator, &id_cur);
+
+    struct aws_byte_buf reply;
+    aws_byte_buf_init(&reply, handle->allocator, 64);
+    json_writer_t w;
+    json_writer_init(&w, &reply);
+    json_writer_begin_object(&w);
+    json_writer_kv_string(&w, "ID", id);
+    json_writer_kv_int(&w, "Code", 0);
+    json_writer_end_object(&w);
+    if (json_writer_finish(&w) == VOLC_OK) {
+        _tm_gateway_publish(handle, reply_topic, (const char *) reply.buffer, reply.len);
+    }
+    aws_byte_buf_clean_up(&reply);
+
+    iot_tm_recv_t recv;
+    memset(&recv, 0, sizeof(recv));
+    recv.type = type;
+    recv.data.gateway_change_notify.id = id;
+    recv.data.gateway_change_notify.change_type = change_type;
+    recv.data.gateway_change_notify.devices = devices;
+    recv.data.gateway_change_notify.count = count;
+    _tm_gateway_callback(handle, &recv);
+
+    aws_mem_release(handle->allocator, id);
+    free(devices);
+    aws_json_value_destroy(root);
+}
+
+static void _tm_recv_gateway_topo_change_notify_handler(const char *topic, const uint8_t *payload, size_t len,
+                                                        void *pUserData) {
+    _tm_recv_gateway_change_notify(IOT_TM_RECV_GATEWAY_TOPO_CHANGE_NOTIFY, GATEWAY_TOPO_CHANGE_REPLY_TOPIC,
+                                   topic, payload, len, pUserData);
+}
+
+static void _tm_recv_gateway_sub_device_change_notify_handler(const char *topic, const uint8_t *payload, size_t len,
+                                                              void *pUserData) {
+    _tm_recv_gateway_change_notify(IOT_TM_RECV_GATEWAY_SUB_DEVICE_CHANGE_NOTIFY, GATEWAY_SUB_CHANGE_REPLY_TOPIC,
+                                   topic, payload, len, pUserData);
+}
+
+/**
+ * 子设备下发topic的通配订阅（sys/+/+/...）收到的消息，按topic中的product_key、device_name转给原处理函数
+ * 本设备的topic已单独订阅，这里跳过；未登录的子设备丢弃
+ */
+static void _tm_gateway_route_sub_device(const char *topic, const uint8_t *payload, size_t len, void *pUserData) {
+    const iot_tm_recv_route_t *route = (const iot_tm_recv_route_t *) pUserData;
+    iot_tm_handler_t *handle = route->handle;
+    if (handle->gateway == NULL || strncmp(topic, "sys/", 4) != 0) {
+        return;
+    }
+    const char *product_key = topic + 4;
+    const char *device_name = strchr(product_key, '/');
+    const char *end = device_name != NULL ? strchr(device_name + 1, '/') : NULL;
+    if (end == NULL || device_name - product_key >= GATEWAY_KEY_SIZE || end - device_name >= GATEWAY_KEY_SIZE) {
+        return;
+    }
+    char pk[GATEWAY_KEY_SIZE];
+    char dn[GATEWAY_KEY_SIZE];
+    snprintf(pk, sizeof(pk), "%.*s", (int) (device_name - product_key), product_key);
+    snprintf(dn, sizeof(dn), "%.*s", (int) (end - device_name - 1), device_name + 1);
+    iot_basic_config_t *config = handle->mqtt_handle->config->basic_config;
+    if (strcmp(pk, config->product_key) == 0 && strcmp(dn, config->device_name) == 0) {
+        return;
+    }
+    iot_gateway_sub_state_t state = iot_gateway_sub_state(handle->gateway, pk, dn);
+    if (state != IOT_GATEWAY_SUB_ONLINE && state != IOT_GATEWAY_SUB_LOGGING_OUT) {
+        LOGD(TAG_IOT_MQTT, "drop message of offline sub device, topic = %s", topic);
+        return;
+    }
+    route->func(topic, payload, len, handle);
+}
+
+// 网关本身的下发topic；子设备的物模型topic在开启网关时通配订阅一次，见 _tm_gateway_route_sub_device
+static const struct {
+    const char *topic;
+    OnMessageHandler func;
+} g_gateway_recv_topics[] = {
+        {"sys/%s/%s/gateway/topo/add_reply", _tm_recv_gateway_add_topo_reply_handler},
+        {"sys/%s/%s/gateway/sub/login_reply", _tm_recv_gateway_sub_device_login_reply_handler},
+        {"sys/%s/%s/gateway/sub/logout_reply", _tm_recv_gateway_sub_device_logout_reply_handler},
+        {"sys/%s/%s/gateway/topo/delete_reply", _tm_recv_gateway_delete_topo_reply_handler},
+        {"sys/%s/%s/gateway/sub/discovery_reply", _tm_recv_gateway_sub_device_discovery_reply_handler},
+        {"sys/%s/%s/gateway/topo/get_reply", _tm_recv_gateway_get_topo_reply_handler},
+        {"sys/%s/%s/gateway/topo/change", _tm_recv_gateway_topo_change_notify_handler},
+        {"sys/%s/%s/gateway/sub/change", _tm_recv_gateway_sub_device_change_notify_handler},
+};
+
+int _tm_gateway_set_up_mqtt_topic(iot_tm_handler_t *handle) {
+    iot_basic_config_t *config = handle->mqtt_handle->config->basic_config;
+    for (size_t i = 0; i < sizeof(g_gateway_recv_topics) / sizeof(g_gateway_recv_topics[0]); i++) {
+        char scratch[IOT_TM_TOPIC_SCRATCH_SIZE];
+        char *heap = NULL;
+        iot_mqtt_topic_map_t topic_mapping;
+        memset(&topic_mapping, 0, sizeof(topic_mapping));
+        topic_mapping.topic = iot_tm_topic_format(scratch, sizeof(scratch), &heap, g_gateway_recv_topics[i].topic,
+                                                  config->product_key, config->device_name, NULL, NULL, NULL);
+        if (topic_mapping.topic == NULL) {
+            return VOLC_ERR_MALLOC;
+        }
+        topic_mapping.message_callback = g_gateway_recv_topics[i].func;
+        topic_mapping.user_data = handle;
+        topic_mapping.qos = IOT_MQTT_QOS1;
+        iot_mqtt_subscribe(handle->mqtt_handle, &topic_mapping);
+        free(heap);
+    }
+    return __s_tm_set_up_sub_device_topic(handle, _tm_gateway_route_sub_device);
+}
+
+int32_t iot_tm_gateway_request(iot_tm_handler_t *handle, iot_gateway_op_t op,
+                               const iot_gateway_sub_device_t *devices, size_t count) {
+    if (NULL == handle || NULL == handle->gateway) {
+        return VOLC_ERR_NULL_POINTER;
+    }
+    int32_t ret = iot_gateway_request(handle->gateway, op, devices, count);
+    if (ret == VOLC_OK) {
+        // 没有在途请求时立即发出第一批，其余由事件循环发出
+        iot_gateway_poll(handle->gateway, _tm_now_ms());
+        iot_mqtt_wakeup(handle->mqtt_handle);
+    }
+    return ret;
+}
+
+int32_t iot_tm_gateway_get_topo(iot_tm_handler_t *handle) {
+    if (NULL == handle || NULL == handle->gateway) {
+        return VOLC_ERR_NULL_POINTER;
+    }
+    const char *id = get_random_string_id_c_str(handle->allocator);
+    struct aws_byte_buf payload;
+    aws_byte_buf_init(&payload, handle->allocator, 96);
+    json_writer_t w;
+    json_writer_init(&w, &payload);
+    json_writer_begin_object(&w);
+    json_writer_kv_string(&w, "ID", id);
+    json_writer_kv_string(&w, "Version", SDK_VERSION);
+    json_writer_key(&w, "params");
+    json_writer_begin_object(&w);
+    json_writer_end_object(&w);
+    json_writer_end_object(&w);
+    int32_t ret = json_writer_finish(&w);
+    if (ret == VOLC_OK) {
+        ret = _tm_gateway_publish(handle, GATEWAY_GET_TOPO_TOPIC, (const char *) payload.buffer, payload.len);
+    }
+    aws_byte_buf_clean_up(&payload);
+    aws_mem_release(handle->allocator, (void *) id);
+    return ret;
+}
+
+iot_gateway_sub_state_t iot_tm_gateway_sub_state(iot_tm_handler_t *handle, const char *product_key,
+                                                 const char *device_name) {
+    if (NULL == handle || NULL == handle->gateway) {
+        return IOT_GATEWAY_SUB_UNKNOWN;
+    }
+    return iot_gateway_sub_state(handle->gateway, product_key, device_name);
+}
+
+#endif
@@ -16,198 +16,296 @@
 
 #include "onesdk_config.h"
 #ifdef ONESDK_ENABLE_IOT
+#include <stdlib.h>
+#include <string.h>
+
+#include "aws/common/atomics.h"
 #include "thing_model/iot_tm_api.h"
 #include "thing_model/iot_ntp.h"
 #include "thing_model/iot_tm_header.h"
 #include "error_code.h"
+#include "iot_log.h"
+#include "util/aws_json.h"
+#include "util/json_writer.h"
+#include "util/util.h"
 
 #include "iot/iot_utils.h"
 
-#define GetServerTime_PATH "/2021-12-14/GetServerTime"
-#define SecretTypeProduct "Product"
-#define SecretTypeDevice "Device"
-#define SecretType "SecretType"
+#define NTP_REQUEST_TOPIC "sys/%s/%s/ntp/request"
 
+// 一次请求的发出时刻，回复时既是时钟采样也是一次RTT样本
+typedef struct {
+    iot_tm_handler_t *handle;
+    uint64_t t1_ms;
+    int64_t t1_us;
+} _ntp_exchange_t;
 
-int tm_ntp_get_server_time(iot_mqtt_ctx_t *mqtt_ctx, uint64_t *server_time_mil) {
-    int ret = 0;
-    // int32_t randomNum = arenal_get_random_num();
-    // struct aws_date_time test_time;
-    // aws_date_time_init_now(&test_time);
-    // uint64_t timeMils = aws_date_time_as_millis(&test_time);
-
-    // struct iot_mqtt_dynamic_register_basic_param registerParam = {
-    //         .instance_id = mqtt_ctx->instance_id,
-    //         .auth_type = mqtt_ctx->auth_type,
-    //         .timestamp = timeMils,
-    //         .random_num = randomNum,
-    //         .product_key = aws_string_c_str(mqtt_ctx->product_key),
-    //         .device_name = aws_string_c_str(mqtt_ctx->device_name)
-    // };
-
-    // // json 数据
-    // struct aws_json_value *post_data_json = aws_json_value_new_object(mqtt_ctx->alloc);
-    // aws_json_add_aws_string_val1(mqtt_ctx->alloc, post_data_json, "InstanceID", mqtt_ctx->instance_id);
-    // aws_json_add_aws_string_val1(mqtt_ctx->alloc, post_data_json, "product_key", mqtt_ctx->product_key);
-    // aws_json_add_aws_string_val1(mqtt_ctx->alloc, post_data_json, "device_name", mqtt_ctx->device_name);
-    // aws_json_add_num_val1(mqtt_ctx->alloc, post_data_json, "random_num", registerParam.random_num);
-    // aws_json_add_num_val1(mqtt_ctx->alloc, post_data_json, "timestamp", registerParam.timestamp);
-    // aws_json_add_num_val1(mqtt_ctx->alloc, post_data_json, "auth_type", mqtt_ctx->auth_type);
-    // aws_json_add_num_val1(mqtt_ctx->alloc, post_data_json, "DeviceSendTime", get_current_time_mil());
-
-    // if (mqtt_ctx->device_secret != NULL && aws_string_is_valid(mqtt_ctx->device_secret)) {
-    //     struct aws_string *sign = _iot_mqtt_hmac_sha256_encrypt(mqtt_ctx->alloc, &registerParam, aws_string_c_str(mqtt_ctx->device_secret));
-    //     aws_json_add_aws_string_val1(mqtt_ctx->alloc, post_data_json, "signature", sign);
-    //     aws_string_destroy_secure(sign);
-    //     aws_json_add_str_val(post_data_json, SecretType, SecretTypeDevice);
-
-    // } else {
-    //     struct aws_string *sign = _iot_mqtt_hmac_sha256_encrypt(mqtt_ctx->alloc, &registerParam, aws_string_c_str(mqtt_ctx->product_secret));
-    //     aws_json_add_aws_string_val1(mqtt_ctx->alloc, post_data_json, "signature", sign);
-    //     aws_string_destroy_secure(sign);
-    //     aws_json_add_str_val(post_data_json, SecretType, SecretTypeProduct);
-    // }
-
-    // char url_str[1024];
-    // AWS_ZERO_ARRAY(url_str);
-    // struct aws_byte_buf url_str_buf = aws_byte_buf_from_empty_array(url_str, sizeof(url_str));
-    // aws_byte_buf_write_from_whole_cursor(&url_str_buf, aws_byte_cursor_from_c_str("https://"));
-    // aws_byte_buf_write_from_whole_cursor(&url_str_buf, aws_byte_cursor_from_string(mqtt_ctx->http_host));
-    // aws_byte_buf_write_from_whole_cursor(&url_str_buf, aws_byte_cursor_from_c_str(GetServerTime_PATH));
-    // aws_byte_buf_write_from_whole_cursor(&url_str_buf, aws_byte_cursor_from_c_str("?"));
-    // aws_byte_buf_write_from_whole_cursor(&url_str_buf, aws_byte_cursor_from_c_str(API_ACTION_DYNAMIC_REGISTER));
-    // aws_byte_buf_write_from_whole_cursor(&url_str_buf, aws_byte_cursor_from_c_str("&"));
-    // aws_byte_buf_write_from_whole_cursor(&url_str_buf, aws_byte_cursor_from_c_str(API_VERSION_QUERY_PARAM));
-
-
-    // LOGD(TAG_IOT_MQTT, "tm_ntp_get_server_time url_str_buf = %s", url_str);
-    // struct iot_http_request_context *http_ctx = iot_new_http_ctx(mqtt_ctx->alloc);
-    // iot_http_ctx_set_url(http_ctx, url_str);
-    // iot_http_ctx_set_method(http_ctx, POST);
-    // struct aws_byte_buf post_data_json_buf = aws_json_obj_to_byte_buf(mqtt_ctx->alloc, post_data_json);
-    // char *post_data_str = aws_buf_to_char_str(mqtt_ctx->alloc, &post_data_json_buf);
-    // iot_http_ctx_set_json_body(http_ctx, post_data_str);
-    // struct iot_http_response *response = iot_http_request(http_ctx);
-
-    // // {"ResponseMetadata":{"Action":"DynamicRegister","Version":"2021-12-14","Error":{"CodeN":10000030,"Message":"The parameter %s is invalid."}},"Result":{"DeviceSendTime":0,"ServerRecvTime":0,"ServerSendTime":0}}
-    // // {"ResponseMetadata":{"Action":"DynamicRegister","Version":"2021-12-14"},"Result":{"DeviceSendTime":1682064791116,"ServerRecvTime":1682064791799,"ServerSendTime":1682064791799}}
-    // LOGD(TAG_IOT_MQTT, "tm_ntp_get_server_time response = %s", (response->response_body));
-
-    // if (response->error_code != 0) {
-    //     ret = response->error_code;
-    //     goto done;
-    // }
-
-    // // 判断成功失败
-    // struct aws_byte_cursor response_json_cur = aws_byte_cursor_from_c_str(response->response_body);
-    // struct aws_json_value *response_json = aws_json_value_new_from_string(mqtt_ctx->alloc, response_json_cur);
-    // struct aws_json_value *error_json = aws_json_value_get_from_object(response_json, aws_byte_cursor_from_c_str("Error"));
-    // int error_code = aws_json_get_num_val(error_json, "CodeN");
-    // LOGD(TAG_IOT_MQTT, "tm_ntp_get_server_time error_code = %d", error_code);
-    // if (error_code != 0) {
-    //     ret = error_code;
-    //     goto done;
-    // } else {
-    //     struct aws_json_value *result_json = aws_json_value_get_from_object(response_json, aws_byte_cursor_from_c_str("Result"));
-    //     uint64_t device_send_time = aws_json_get_num_val(result_json, "DeviceSendTime");
-    //     uint64_t server_recv_time = aws_json_get_num_val(result_json, "ServerRecvTime");
-    //     uint64_t server_send_time = aws_json_get_num_val(result_json, "ServerSendTime");
-    //     uint64_t device_recv_time = get_current_time_mil();
-    //     *server_time_mil = (server_recv_time + server_send_time + device_recv_time - device_send_time) / 2;
-    //     LOGD(TAG_IOT_MQTT, "tm_ntp_get_server_time server_time_mil = %ld", *server_time_mil);
-    //     goto done;
-    // }
-
-
-    // done:
-    // aws_byte_buf_clean_up(&url_str_buf);
-    // aws_json_value_destroy(post_data_json);
-    // aws_byte_buf_clean_up(&post_data_json_buf);
-    // aws_mem_release(mqtt_ctx->alloc, post_data_str);
-    // iot_http_response_release(response);
-    return ret;
-
+void iot_ntp_clock_init(iot_ntp_clock_t *clock) {
+    memset(clock, 0, sizeof(iot_ntp_clock_t));
 }
 
-void _tm_recv_device_ntp_info(const char* topic, const uint8_t *payload, size_t len, void *pUserData) {
-    // struct aws_byte_cursor topic_byte_cursor = aws_byte_cursor_from_array(topic, strlen(topic));
-    // struct aws_byte_cursor payload_byte_cursor = aws_byte_cursor_from_array(payload, len);
+static int64_t _ntp_median(const int64_t *values, size_t count) {
+    int64_t sorted[IOT_NTP_FILTER_SIZE];
+    memcpy(sorted, values, count * sizeof(int64_t));
+    for (size_t i = 1; i < count; i++) {
+        int64_t v = sorted[i];
+        size_t j = i;
+        for (; j > 0 && sorted[j - 1] > v; j--) {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = v;
+    }
+    if (count % 2 == 1) {
+        return sorted[count / 2];
+    }
+    return (sorted[count / 2 - 1] + sorted[count / 2]) / 2;
+}
 
+int64_t iot_ntp_clock_offset(const iot_ntp_clock_t *clock, uint64_t mono_ms) {
+    int64_t diff = clock->target_offset - clock->slew_from;
+    int64_t max = mono_ms > clock->slew_start_ms ?
+                  (int64_t) ((mono_ms - clock->slew_start_ms) / IOT_NTP_SLEW_RATE_DIVISOR) : 0;
+    if (diff > max) {
+        diff = max;
+    } else if (diff < -max) {
+        diff = -max;
+    }
+    return clock->slew_from + diff;
+}
 
-    // LOGD(TAG_IOT_MQTT, "_tm_recv_device_ntp_info call topic = %.*s,  payload = %.*s", 
-    //     AWS_BYTE_CURSOR_PRI(topic_byte_cursor), 
-    //     AWS_BYTE_CURSOR_PRI(payload_byte_cursor));
-    // iot_tm_handler_t *dm_handle = (iot_tm_handler_t *) pUserData;
+int iot_ntp_clock_add_sample(iot_ntp_clock_t *clock, uint64_t t1, uint64_t t2, uint64_t t3, uint64_t t4) {
+    if (clock == NULL || t4 < t1 || t3 < t2) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    int64_t delay = (int64_t) (t4 - t1) - (int64_t) (t3 - t2);
+    if (delay < 0) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    // 往返不对称时偏差的误差为两个方向延迟差的一半，由中位数过滤
+    int64_t offset = (((int64_t) t2 - (int64_t) t1) + ((int64_t) t3 - (int64_t) t4)) / 2;
+    clock->offsets[clock->next] = offset;
+    clock->next = (clock->next + 1) % IOT_NTP_FILTER_SIZE;
+    if (clock->count < IOT_NTP_FILTER_SIZE) {
+        clock->count++;
+    }
+    clock->last_delay_ms = delay;
+    clock->samples++;
+
+    int64_t current = iot_ntp_clock_offset(clock, t4);
+    int64_t target = _ntp_median(clock->offsets, clock->count);
+    clock->slew_from = current;
+    clock->slew_start_ms = t4;
+    clock->target_offset = target;
+    if (!clock->synced || target - current > IOT_NTP_STEP_THRESHOLD_MS ||
+        current - target > IOT_NTP_STEP_THRESHOLD_MS) {
+        clock->slew_from = target;
+        clock->synced = true;
+        clock->steps++;
+    }
+    return VOLC_OK;
+}
 
-    // // payload ={"ID":"1811682067929782","Code":0,"Data":{"DeviceSendTime":1682067929781,"ServerRecvTime":1682067930151,"ServerSendTime":1682067930151}}
+// 进程内共用一个时钟；临界区很短，使用可以静态初始化的自旋锁
+static iot_ntp_clock_t s_ntp_clock;
+static struct aws_atomic_var s_ntp_lock = AWS_ATOMIC_INIT_INT(0);
 
-    // struct aws_json_value *payload_json = aws_json_value_new_from_string(dm_handle->allocator, payload);
+static void _ntp_lock(void) {
+    size_t expected = 0;
+    while (!aws_atomic_compare_exchange_int(&s_ntp_lock, &expected, 1)) {
+        expected = 0;
+    }
+}
 
-    // int code = aws_json_get_num_val(payload_json, "Code");
+static void _ntp_unlock(void) {
+    aws_atomic_store_int(&s_ntp_lock, 0);
+}
 
-    // if (code == 0) {
-    //     struct aws_json_value *result_json = aws_json_value_get_from_object(payload_json, aws_byte_cursor_from_c_str("Data"));
-    //     uint64_t device_send_time = aws_json_get_num_val(result_json, "DeviceSendTime");
-    //     uint64_t server_recv_time = aws_json_get_num_val(result_json, "ServerRecvTime");
-    //     uint64_t server_send_time = aws_json_get_num_val(result_json, "ServerSendTime");
-    //     uint64_t device_recv_time = get_current_time_mil();
-    //     uint64_t server_time_mil = (server_recv_time + server_send_time + device_recv_time - device_send_time) / 2;
-    //     LOGD(TAG_IOT_MQTT, "_tm_recv_device_ntp_info server_time_mil = %ld", server_time_mil);
+uint64_t iot_now_ms(void) {
+    uint64_t mono_ms = _tm_now_ms();
+    _ntp_lock();
+    bool synced = s_ntp_clock.synced;
+    int64_t offset = synced ? iot_ntp_clock_offset(&s_ntp_clock, mono_ms) : 0;
+    _ntp_unlock();
+    if (!synced) {
+        return unix_timestamp_ms();
+    }
+    return (uint64_t) ((int64_t) mono_ms + offset);
+}
 
-    //     // 数据封装
-    //     iot_tm_recv_t recv = {0};
-    //     recv.type = IOT_TM_RECV_NTP_SERVER_TIME;
-    //     iot_tm_recv_npt_server_time_t server_time = {0};
-    //     server_time.server_time_mil = server_time_mil;
-    //     recv.data.npt_server_time = server_time;
+bool iot_ntp_synced(void) {
+    _ntp_lock();
+    bool synced = s_ntp_clock.synced;
+    _ntp_unlock();
+    return synced;
+}
 
-    //     // 回调给业务
-    //     dm_handle->recv_handler(dm_handle, &recv, dm_handle->userdata);
+int tm_ntp_get_server_time(iot_mqtt_ctx_t *mqtt_ctx, uint64_t *server_time_mil) {
+    (void) mqtt_ctx;
+    if (server_time_mil == NULL) {
+        return VOLC_ERR_NULL_POINTER;
+    }
+    if (!iot_ntp_synced()) {
+        return VOLC_ERR_TM_NTP_NOT_SYNCED;
+    }
+    *server_time_mil = iot_now_ms();
+    return VOLC_OK;
+}
 
-    // }
+static bool _ntp_get_time(struct aws_json_value *data_json, const char *key, uint64_t *value) {
+    struct aws_json_value *json = aws_json_value_get_from_object(data_json, aws_byte_cursor_from_c_str(key));
+    double number = 0;
+    if (json == NULL || aws_json_value_get_number(json, &number) != AWS_OP_SUCCESS || number < 0) {
+        return false;
+    }
+    *value = (uint64_t) number;
+    return true;
+}
 
-    // aws_json_value_destroy(payload_json);
+// 请求表回调：userdata为_ntp_exchange_t
+static void _tm_ntp_on_reply(const char *msg_id, int32_t code, const char *payload, size_t len, void *userdata) {
+    int64_t t4_us = lws_now_usecs();
+    uint64_t t4 = _tm_now_ms();
+    _ntp_exchange_t *ex = (_ntp_exchange_t *) userdata;
+    iot_mqtt_ctx_t *mqtt_ctx = ex->handle->mqtt_handle;
+    int64_t hold_us = 0;                // 服务端从收到请求到发出回复的时间，不计入RTT
+    if (code == VOLC_ERR_TM_REPLY_TIMEOUT) {
+        iot_mqtt_record_rtt_loss(mqtt_ctx);
+    }
+    if (code == 0 && payload != NULL) {
+        // payload ={"ID":"1811682067929782","Code":0,"Data":{"DeviceSendTime":1682067929781,"ServerRecvTime":1682067930151,"ServerSendTime":1682067930151}}
+        struct aws_json_value *payload_json = aws_json_value_new_from_string(aws_alloc(),
+            aws_byte_cursor_from_array(payload, len));
+        struct aws_json_value *data_json = payload_json == NULL ? NULL :
+            aws_json_value_get_from_object(payload_json, aws_byte_cursor_from_c_str("Data"));
+        uint64_t t2 = 0;
+        uint64_t t3 = 0;
+        if (data_json != NULL && _ntp_get_time(data_json, "ServerRecvTime", &t2) &&
+            _ntp_get_time(data_json, "ServerSendTime", &t3)) {
+            hold_us = t3 >= t2 ? (int64_t) (t3 - t2) * 1000 : 0;
+            _ntp_lock();
+            int ret = iot_ntp_clock_add_sample(&s_ntp_clock, ex->t1_ms, t2, t3, t4);
+            int64_t offset = s_ntp_clock.target_offset;
+            int64_t delay = s_ntp_clock.last_delay_ms;
+            _ntp_unlock();
+            LOGD(TAG_IOT_MQTT, "_tm_ntp_on_reply id = %s, ret = %d, offset = %lld, delay = %lld", msg_id, ret,
+                 (long long) offset, (long long) delay);
+        }
+        if (payload_json != NULL) {
+            aws_json_value_destroy(payload_json);
+        }
+    }
+    if (code != VOLC_ERR_TM_REPLY_TIMEOUT && code != VOLC_ERR_TM_REPLY_CANCELLED) {
+        // 服务端时间为毫秒精度，扣除后可能略小于0
+        int64_t rtt_us = t4_us - ex->t1_us - hold_us;
+        iot_mqtt_record_rtt(mqtt_ctx, rtt_us > 0 ? (uint64_t) rtt_us : 0);
+    }
+    free(ex);
 }
 
+void _tm_recv_device_ntp_info(const char* topic, const uint8_t *payload, size_t len, void *pUserData) {
+    struct aws_byte_cursor topic_byte_cursor = aws_byte_cursor_from_array(topic, strlen(topic));
+    struct aws_byte_cursor payload_byte_cursor = aws_byte_cursor_from_array(payload, len);
+
+    LOGD(TAG_IOT_MQTT, "_tm_recv_device_ntp_info call topic = %.*s,  payload = %.*s",
+        AWS_BYTE_CURSOR_PRI(topic_byte_cursor),
+        AWS_BYTE_CURSOR_PRI(payload_byte_cursor));
+    iot_tm_handler_t *dm_handle = (iot_tm_handler_t *) pUserData;
+    if (dm_handle == NULL) {
+        return;
+    }
+    // 按ID找到请求，四个时间戳加入采样
+    _tm_pending_on_reply(dm_handle, payload, len);
+    if (NULL == dm_handle->recv_handler || !iot_ntp_synced()) {
+        return;
+    }
+
+    iot_tm_recv_t recv;
+    AWS_ZERO_STRUCT(recv);
+    recv.type = IOT_TM_RECV_NTP_SERVER_TIME;
+    recv.data.npt_server_time.server_time_mil = iot_now_ms();
+    dm_handle->recv_handler(dm_handle, &recv, dm_handle->userdata);
+}
 
 int32_t tm_send_device_npt_request(void *handler) {
-    // iot_tm_handler_t *dm_handle = (iot_tm_handler_t *) handler;
-    int ret = VOLC_OK;
-
-    // char *reply_topic = iot_get_common_topic(dm_handle->allocator, "sys/%s/%s/ntp/request",
-    //                                           dm_handle->mqtt_handle->config->basic_config->product_key, dm_handle->mqtt_handle->config->basic_config->device_name);
-
-    // struct aws_json_value *post_data_json = aws_json_value_new_object(dm_handle->allocator);
-    // aws_json_add_num_val1(dm_handle->allocator, post_data_json, "Params", get_current_time_mil());
-    // aws_json_add_str_val_1(dm_handle->allocator, post_data_json, "Version", "1.0");
-    // aws_json_add_str_val_1(dm_handle->allocator, post_data_json, "ID", get_random_string_with_time_suffix(dm_handle->allocator));
-    // struct aws_byte_buf payload_buf = aws_json_obj_to_byte_buf(aws_alloc(), post_data_json);
-    // struct aws_byte_cursor payload_cur = aws_byte_cursor_from_buf(&payload_buf);
-
-    // // struct aws_byte_cursor public_topic = aws_byte_cursor_from_c_str(reply_topic);
-    // // uint16_t packet_id = aws_mqtt_client_connection_publish(dm_handle->mqtt_handle->mqtt_connection, &public_topic,
-    // //                                                         AWS_MQTT_QOS_AT_MOST_ONCE, false, &payload_cur,
-    // //                                                         _tm_mqtt_post_on_complete_fn,
-    // //                                                         NULL);
-
-    // PublishParams pubParams = DEFAULT_PUB_PARAMS;
-    // pubParams.qos           = QOS1;
-    // pubParams.payload_len   = payload_cur.len;
-    // pubParams.payload       = (void *)payload_cur.ptr;
-    // int packet_id = IOT_MQTT_Publish(dm_handle->mqtt_client, reply_topic, &pubParams);
-
-    // LOGD(TAG_IOT_MQTT, "tm_send_device_npt_request call packet_id = %d, topic = %.*s, payload = %.*s", packet_id, reply_topic,
-    //      AWS_BYTE_CURSOR_PRI(payload_cur));
-
-    // // 回收内存数据
-    // aws_mem_release(dm_handle->allocator, reply_topic);
-    // aws_json_value_destroy(post_data_json);
-    // aws_byte_buf_clean_up(&payload_buf);
-
-    // if (packet_id == 0) {
-    //     ret = STATE_DM_MQTT_PUBLISH_ERROR;
-    // }
+    iot_tm_handler_t *dm_handle = (iot_tm_handler_t *) handler;
+    if (dm_handle == NULL || dm_handle->mqtt_handle == NULL || dm_handle->mqtt_handle->config == NULL ||
+        dm_handle->mqtt_handle->config->basic_config == NULL) {
+        return VOLC_ERR_NULL_POINTER;
+    }
+    int32_t ret = _tm_pending_enable(dm_handle);
+    if (ret != VOLC_OK) {
+        return ret;
+    }
+    _ntp_exchange_t *ex = (_ntp_exchange_t *) malloc(sizeof(_ntp_exchange_t));
+    if (ex == NULL) {
+        return VOLC_ERR_MALLOC;
+    }
+    ex->handle = dm_handle;
+    const char *id = get_random_string_id_c_str(dm_handle->allocator);
+
+    // {"ID":"...","Version":"1.0","Params":1682067929781}，Params由服务端在回复中带回DeviceSendTime
+    char payload[160];
+    struct aws_byte_buf payload_buf = aws_byte_buf_from_empty_array(payload, sizeof(payload));
+    json_writer_t w;
+    json_writer_init(&w, &payload_buf);
+    json_writer_begin_object(&w);
+    json_writer_kv_string(&w, "ID", id);
+    json_writer_kv_string(&w, "Version", "1.0");
+    json_writer_kv_int(&w, "Params", (int64_t) unix_timestamp_ms());
+    json_writer_end_object(&w);
+    ret = json_writer_finish(&w);
+
+    char scratch[IOT_TM_TOPIC_SCRATCH_SIZE];
+    char *heap = NULL;
+    const char *topic = NULL;
+    if (ret == VOLC_OK) {
+        const iot_basic_config_t *config = dm_handle->mqtt_handle->config->basic_config;
+        topic = iot_tm_topic_format(scratch, sizeof(scratch), &heap, NTP_REQUEST_TOPIC, config->product_key,
+                                    config->device_name, NULL, NULL, NULL);
+        ret = topic == NULL ? VOLC_ERR_MALLOC : VOLC_OK;
+    }
+    if (ret == VOLC_OK) {
+        // 先登记再发出，回复可能在发送返回前到达
+        ex->t1_us = lws_now_usecs();
+        ex->t1_ms = _tm_now_ms();
+        ret = iot_tm_pending_add(dm_handle->pending, id, ex->t1_ms + IOT_NTP_REPLY_TIMEOUT_MS, _tm_ntp_on_reply, ex);
+    }
+    if (ret == VOLC_OK) {
+        LOGD(TAG_IOT_MQTT, "tm_send_device_npt_request call topic = %s, payload = %.*s", topic,
+             (int) payload_buf.len, payload);
+        int pub_ret = iot_mqtt_publish(dm_handle->mqtt_handle, topic, (const uint8_t *) payload, payload_buf.len,
+                                       IOT_MQTT_QOS1);
+        if (pub_ret < 0) {
+            // 登记已取消，不会再回调
+            iot_tm_pending_remove(dm_handle->pending, id);
+            free(ex);
+            ret = pub_ret;
+        }
+    } else {
+        free(ex);
+    }
+    free(heap);
+    aws_mem_release(dm_handle->allocator, (void *) id);
     return ret;
 }
 
-#endif // ONESDK_ENABLE_IOT
\ No newline at end of file
+int32_t _tm_ntp_poll(iot_tm_handler_t *handle, uint64_t now_ms) {
+    iot_ntp_sync_t *sync = &handle->ntp_sync;
+    if (sync->burst_left == 0 && sync->interval_ms == 0) {
+        return -1;
+    }
+    if (now_ms >= sync->next_ms) {
+        tm_send_device_npt_request(handle);
+        if (sync->burst_left > 0) {
+            sync->burst_left--;
+        }
+        sync->next_ms = now_ms + (sync->burst_left > 0 ? IOT_NTP_BURST_INTERVAL_MS : sync->interval_ms);
+        if (sync->burst_left == 0 && sync->interval_ms == 0) {
+            return -1;
+        }
+    }
+    uint64_t wait_ms = sync->next_ms - now_ms;
+    return wait_ms > INT32_MAX ? INT32_MAX : (int32_t) wait_ms;
+}
+
+#endif // ONESDK_ENABLE_IOT
@@ -24,8 +24,15 @@
 #include "thing_model/device_delay.h"
 #include "thing_model/iot_tm_header.h"
 #include "iot/iot_utils.h"
+#include "iot_log.h"
 #include "util/util.h"
+#include "util/aws_json.h"
+#include "platform_compat.h"
 #include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
 typedef struct {
     iot_tm_recv_type_t type;
@@ -58,46 +65,6 @@ static const tm_send_topic_map_t g_dm_send_topic_mapping[IOT_TM_MSG_MAX] = {
                 // 清除设备影子
                 "sys/%s/%s/shadow/desired/clear",
                 _tm_send_shadow_clear
-        // },{
-        //         // gateway add
-        //         "sys/%s/%s/gateway/topo/add",
-        //         _tm_send_gateway_add_topo
-        // },{
-        //         // gateway delete
-        //         "sys/%s/%s/gateway/topo/delete",
-        //         _tm_send_gateway_delete_topo
-        // },{
-        //         // gateway get
-        //         "sys/%s/%s/gateway/topo/get",
-        //         _tm_send_gateway_get_topo
-        // },{
-        //         // gateway get device secret
-        //         "sys/%s/%s/gateway/sub/secret/get/%s",
-        //         _tm_send_gateway_get_device_secret
-        // },{
-        //         // gateway sub device login
-        //         "sys/%s/%s/gateway/sub/login",
-        //         _tm_send_gateway_sub_device_login
-        // },{
-        //         // gateway sub device logout
-        //         "sys/%s/%s/gateway/sub/logout",
-        //         _tm_send_gateway_sub_device_logout
-        // },{
-        //         // gateway sub device discovery
-        //         "sys/%s/%s/gateway/sub/discovery",
-        //         _tm_send_gateway_sub_device_discovery
-        // },{
-        //         // gateway add topo notify reply
-        //         "sys/%s/%s/gateway/topo/notify_reply/%s",
-        //         _tm_send_gateway_add_topo_notify_reply
-        // },{
-        //         // gateway topo change notify reply
-        //         "sys/%s/%s/gateway/topo/change_reply",
-        //         _tm_send_gateway_topo_change_notify_reply
-        // },{
-        //         // gateway sub device status change notify reply
-        //         "sys/%s/%s/gateway/sub/change_reply",
-        //         _tm_send_gateway_sub_device_change_notify_reply
         },{
                 // webshell command reply
                 "sys/%s/%s/webshell/cmd/%s/post_reply",
@@ -156,56 +123,6 @@ static const tm_recv_topic_map_t g_dm_recv_topic_mapping[] = {
                 "sys/%s/%s/shadow/desired/set",
                 _tm_recv_shadow_set_handler,
         },{
-        //         // 增加子设备网络拓扑关系, 服务端给的回复
-        //         IOT_TM_RECV_GATEWAY_ADD_TOPO_REPLY,
-        //         "sys/%s/%s/gateway/topo/add_reply",
-        //         _tm_recv_gateway_add_topo_reply_handler,
-        // },{
-        //         // 删除子设备网络拓扑关系, 服务端给的回复
-        //         IOT_TM_RECV_GATEWAY_DELETE_TOPO_REPLY,
-        //         "sys/%s/%s/gateway/topo/delete_reply",
-        //         _tm_recv_gateway_delete_topo_reply_handler,
-        // },{
-        //         // 获取网络拓扑关系, 服务端给的回复
-        //         IOT_TM_RECV_GATEWAY_GET_TOPO_REPLY,
-        //         "sys/%s/%s/gateway/topo/get_reply",
-        //         _tm_recv_gateway_get_topo_reply_handler,
-        // },{
-        //         // 获取设备secret, 服务端给的回复
-        //         IOT_TM_RECV_GATEWAY_GET_DEVICE_SECRET,
-        //         "sys/%s/%s/gateway/sub/secret/get_reply/%s",
-        //         _tm_recv_gateway_get_device_secret_reply_handler,
-        // },{
-        //         // 设备登录，服务端给的回复
-        //         IOT_TM_RECV_GATEWAY_SUB_DEVICE_LOGIN,
-        //         "sys/%s/%s/gateway/sub/login_reply",
-        //         _tm_recv_gateway_sub_device_login_reply_handler,
-        // },{
-        //         // 设备登出, 服务端给的回复
-        //         IOT_TM_RECV_GATEWAY_SUB_DEVICE_LOGOUT,
-        //         "sys/%s/%s/gateway/sub/logout_reply",
-        //         _tm_recv_gateway_sub_device_logout_reply_handler,
-        // },{
-        //         // 设备发现上报, 服务端给的回复
-        //         IOT_TM_RECV_GATEWAY_SUB_DEVICE_DISCOVERY,
-        //         "sys/%s/%s/gateway/sub/discovery_reply",
-        //         _tm_recv_gateway_sub_device_discovery_reply_handler,
-        // },{
-        //         // 收到服务端下发的网络拓扑关系增加通知
-        //         IOT_TM_RECV_GATEWAY_ADD_TOPO_NOTIFY,
-        //         "sys/%s/%s/gateway/topo/notify/+",
-        //         _tm_recv_gateway_add_topo_notify_handler,
-        // },{
-        //         // 收到服务端下发的网络拓扑变化通知
-        //         IOT_TM_RECV_GATEWAY_TOPO_CHANGE_NOTIFY,
-        //         "sys/%s/%s/gateway/topo/change",
-        //         _tm_recv_gateway_topo_change_notify_handler,
-        // },{
-        //         // 收到服务端下发的子设备状态变化通知
-        //         IOT_TM_RECV_GATEWAY_SUB_DEVICE_CHANGE_NOTIFY,
-        //         "sys/%s/%s/gateway/sub/change",
-        //         _tm_recv_gateway_sub_device_change_notify_handler,
-        // },{
                 // 收到服务端下发的webshell 命令
                 IOT_TM_RECV_WEBSHELL_COMMAND,
                 "sys/%s/%s/webshell/cmd/+/post",
@@ -237,6 +154,14 @@ static const tm_recv_topic_map_t g_dm_recv_topic_mapping[] = {
         },
 };
 
+// topic表中下发topic排在发送topic之后
+#define TM_RECV_TOPIC_COUNT (sizeof(g_dm_recv_topic_mapping) / sizeof(tm_recv_topic_map_t))
+#define TM_RECV_TOPIC_BASE IOT_TM_MSG_MAX
+#define TM_TOPIC_COUNT (TM_RECV_TOPIC_BASE + TM_RECV_TOPIC_COUNT)
+
+static const iot_tm_topic_table_t *_dm_topic_table(iot_tm_handler_t *dm_handle, const char *product_key,
+                                                   const char *device_name);
+
 
 iot_tm_handler_t *iot_tm_init(void) {
     iot_tm_handler_t *dm_handle = (iot_tm_handler_t *)malloc(sizeof(iot_tm_handler_t));
@@ -245,6 +170,7 @@ iot_tm_handler_t *iot_tm_init(void) {
     }
     memset(dm_handle, 0, sizeof(iot_tm_handler_t));
     dm_handle->allocator = aws_alloc();
+    platform_mutex_init(dm_handle->topic_table_mutex);
     return dm_handle;
 }
 
@@ -252,6 +178,52 @@ void iot_tm_deinit(iot_tm_handler_t *handle) {
     if (handle == NULL) {
         return;
     }
+    if ((handle->coalescer != NULL || handle->property_cache != NULL || handle->gateway != NULL ||
+         handle->pending != NULL || handle->ntp_sync.interval_ms != 0 || handle->ntp_sync.burst_left != 0 ||
+         handle->rtt_probe.interval_ms != 0 || handle->rtt_probe.report_identifier != NULL ||
+         handle->webshell != NULL) &&
+        handle->mqtt_handle != NULL) {
+        iot_mqtt_set_loop_hook(handle->mqtt_handle, NULL, NULL);
+    }
+    if (handle->property_cache != NULL) {
+        // 上报暂存的属性，可能进入合并批，先于合并器释放
+        iot_tm_property_cache_deinit(handle->property_cache);
+        free(handle->property_cache);
+    }
+    if (handle->coalescer != NULL) {
+        // 发出尚未到期的属性
+        iot_tm_coalescer_deinit(handle->coalescer);
+        free(handle->coalescer);
+    }
+    if (handle->shadow_cache != NULL) {
+        iot_tm_shadow_cache_deinit(handle->shadow_cache);
+        free(handle->shadow_cache);
+    }
+    if (handle->gateway != NULL) {
+        iot_gateway_deinit(handle->gateway);
+        free(handle->gateway);
+    }
+    free(handle->sub_device_routes);
+    free(handle->rtt_probe.report_identifier);
+    if (handle->webshell != NULL) {
+        // 结束仍在运行的shell
+        iot_webshell_deinit(handle->webshell);
+        free(handle->webshell);
+    }
+    if (handle->custom_router != NULL) {
+        iot_tm_custom_router_deinit(handle->custom_router);
+        free(handle->custom_router);
+    }
+    if (handle->pending != NULL) {
+        // 仍在等待回复的请求按取消回调
+        iot_tm_pending_deinit(handle->pending);
+        free(handle->pending);
+    }
+    for (size_t i = 0; i < handle->topic_table_count; i++) {
+        iot_tm_topic_table_free(handle->topic_tables[i]);
+        free(handle->topic_tables[i]);
+    }
+    platform_mutex_destroy(handle->topic_table_mutex);
     free(handle);
 }
 
@@ -332,26 +304,71 @@ int _s_tm_set_up_mqtt_topic(iot_tm_handler_t *iot_tm_handler) {
 
 int __s_tm_set_up_mqtt_topic(iot_tm_handler_t *iot_tm_handler, struct aws_string* product_key, struct aws_string* device_name) {
     // 订阅处理
-    int i = 0;
-    for (i = 0; i < sizeof(g_dm_recv_topic_mapping) / sizeof(tm_recv_topic_map_t); i++) {
+    const iot_tm_topic_table_t *table = _dm_topic_table(iot_tm_handler, aws_string_c_str(product_key),
+                                                        aws_string_c_str(device_name));
+    size_t i = 0;
+    for (i = 0; i < TM_RECV_TOPIC_COUNT; i++) {
+        if (g_dm_recv_topic_mapping[i].func == NULL) {
+            continue;
+        }
         iot_mqtt_topic_map_t topic_mapping;
-        topic_mapping.topic = __dm_prepare_rev_topic(iot_tm_handler->allocator, product_key, device_name, g_dm_recv_topic_mapping[i]);
+        memset(&topic_mapping, 0, sizeof(topic_mapping));
+        // 固定topic取topic表，带参数的再单独格式化
+        char *topic = NULL;
+        topic_mapping.topic = iot_tm_topic_table_get(table, TM_RECV_TOPIC_BASE + i);
         if (topic_mapping.topic == NULL) {
-            continue;
+            topic = __dm_prepare_rev_topic(iot_tm_handler->allocator, product_key, device_name, g_dm_recv_topic_mapping[i]);
+            if (topic == NULL) {
+                continue;
+            }
+            topic_mapping.topic = topic;
         }
         topic_mapping.message_callback = g_dm_recv_topic_mapping[i].func;
         topic_mapping.user_data = iot_tm_handler;
-        if (topic_mapping.message_callback == NULL) {
-            aws_mem_release(iot_tm_handler->allocator, (void*)topic_mapping.topic);
-            continue;
-        }
         topic_mapping.qos = IOT_MQTT_QOS1;
 
         iot_mqtt_subscribe(iot_tm_handler->mqtt_handle, &topic_mapping);
 
         // 这里可以回收前面申请的内存
-        aws_mem_release(iot_tm_handler->allocator, (void*)topic_mapping.topic);
+        if (topic != NULL) {
+            aws_mem_release(iot_tm_handler->allocator, topic);
+        }
+    }
+    return VOLC_OK;
+}
+
+int __s_tm_set_up_sub_device_topic(iot_tm_handler_t *iot_tm_handler, OnMessageHandler route) {
+    if (iot_tm_handler->sub_device_routes != NULL) {
+        return VOLC_OK;
+    }
+    iot_tm_recv_route_t *routes = (iot_tm_recv_route_t *) calloc(TM_RECV_TOPIC_COUNT, sizeof(iot_tm_recv_route_t));
+    struct aws_string *any = aws_string_new_from_c_str(iot_tm_handler->allocator, "+");
+    if (routes == NULL || any == NULL) {
+        free(routes);
+        aws_string_destroy(any);
+        return VOLC_ERR_MALLOC;
+    }
+    for (size_t i = 0; i < TM_RECV_TOPIC_COUNT; i++) {
+        if (g_dm_recv_topic_mapping[i].func == NULL) {
+            continue;
+        }
+        char *topic = __dm_prepare_rev_topic(iot_tm_handler->allocator, any, any, g_dm_recv_topic_mapping[i]);
+        if (topic == NULL) {
+            continue;
+        }
+        routes[i].handle = iot_tm_handler;
+        routes[i].func = g_dm_recv_topic_mapping[i].func;
+        iot_mqtt_topic_map_t topic_mapping;
+        memset(&topic_mapping, 0, sizeof(topic_mapping));
+        topic_mapping.topic = topic;
+        topic_mapping.message_callback = route;
+        topic_mapping.user_data = &routes[i];
+        topic_mapping.qos = IOT_MQTT_QOS1;
+        iot_mqtt_subscribe(iot_tm_handler->mqtt_handle, &topic_mapping);
+        aws_mem_release(iot_tm_handler->allocator, topic);
     }
+    aws_string_destroy(any);
+    iot_tm_handler->sub_device_routes = routes;
     return VOLC_OK;
 }
 
@@ -361,105 +378,560 @@ void iot_tm_set_tm_recv_handler_t(iot_tm_handler_t *handle, iot_tm_recv_handler_
 }
 
 
+// 本设备或网关子设备的topic表，首次使用时建立；超出上限或内存不足时返回NULL，由调用方逐次格式化
+static const iot_tm_topic_table_t *_dm_topic_table(iot_tm_handler_t *dm_handle, const char *product_key,
+                                                   const char *device_name) {
+    const iot_tm_topic_table_t *found = NULL;
+    platform_mutex_lock(dm_handle->topic_table_mutex);
+    for (size_t i = 0; i < dm_handle->topic_table_count; i++) {
+        const iot_tm_topic_table_t *table = dm_handle->topic_tables[i];
+        if (strcmp(table->product_key, product_key) == 0 && strcmp(table->device_name, device_name) == 0) {
+            found = table;
+            break;
+        }
+    }
+    if (found == NULL && dm_handle->topic_table_count < IOT_TM_TOPIC_TABLE_MAX_DEVICES) {
+        // 发送topic按消息类型排列，其后是下发topic
+        const char *fmts[TM_TOPIC_COUNT];
+        for (size_t i = 0; i < IOT_TM_MSG_MAX; i++) {
+            fmts[i] = g_dm_send_topic_mapping[i].topic;
+        }
+        for (size_t i = 0; i < TM_RECV_TOPIC_COUNT; i++) {
+            fmts[TM_RECV_TOPIC_BASE + i] = g_dm_recv_topic_mapping[i].topic;
+        }
+        iot_tm_topic_table_t *table = (iot_tm_topic_table_t *) malloc(sizeof(iot_tm_topic_table_t));
+        if (table != NULL && iot_tm_topic_table_build(table, fmts, TM_TOPIC_COUNT, product_key, device_name) == VOLC_OK) {
+            dm_handle->topic_tables[dm_handle->topic_table_count++] = table;
+            found = table;
+        } else {
+            free(table);
+        }
+    }
+    platform_mutex_unlock(dm_handle->topic_table_mutex);
+    return found;
+}
+
 //发送数据给服务端的处理流程
-static int32_t _dm_prepare_send_topic(iot_tm_handler_t *dm_handle, const iot_tm_msg_t *msg, char **topic) {
-    struct aws_string *product_key;
+// 固定topic直接取topic表，带参数的topic格式化到scratch，放不下时分配*heap（调用方free）
+static int32_t _dm_prepare_send_topic(iot_tm_handler_t *dm_handle, const iot_tm_msg_t *msg, char *scratch,
+                                      size_t scratch_cap, char **heap, const char **topic) {
+    *heap = NULL;
+    *topic = NULL;
+    const char *product_key = dm_handle->mqtt_handle->config->basic_config->product_key;
     if (msg->product_key != NULL && secure_strlen(msg->product_key) > 1) {
-        product_key = aws_string_new_from_c_str(dm_handle->allocator, msg->product_key);
-    } else {
-        product_key = aws_string_new_from_c_str(dm_handle->allocator, 
-            dm_handle->mqtt_handle->config->basic_config->product_key);
+        product_key = msg->product_key;
     }
-
-    struct aws_string *device_name;
+    const char *device_name = dm_handle->mqtt_handle->config->basic_config->device_name;
     if (msg->device_name != NULL && secure_strlen(msg->device_name) > 1) {
-        device_name = aws_string_new_from_c_str(dm_handle->allocator, msg->device_name);
-    } else {
-        device_name = aws_string_new_from_c_str(dm_handle->allocator, 
-            dm_handle->mqtt_handle->config->basic_config->device_name);
+        device_name = msg->device_name;
     }
-    int ret = VOLC_OK;
 
+    const iot_tm_topic_table_t *table = _dm_topic_table(dm_handle, product_key, device_name);
+    *topic = iot_tm_topic_table_get(table, msg->type);
+    if (*topic != NULL) {
+        return VOLC_OK;
+    }
+
+    const char *p1 = NULL;
+    const char *p2 = NULL;
+    const char *p3 = NULL;
     switch (msg->type) {
         case IOT_TM_MSG_PROPERTY_POST:
-        case IOT_TM_MSG_PROPERTY_SET_REPLY: {
-            *topic = iot_get_common_topic(dm_handle->allocator, g_dm_send_topic_mapping[msg->type].topic, product_key, device_name);
-        }
-            break;
+        case IOT_TM_MSG_PROPERTY_SET_REPLY:
         case IOT_TM_MSG_SHADOW_REPORT:
         case IOT_TM_MSG_SHADOW_GET:
-        case IOT_TM_MSG_SHADOW_CLEAR:{
-            *topic = iot_get_common_topic(dm_handle->allocator, g_dm_send_topic_mapping[msg->type].topic, product_key, device_name);
-        }
+        case IOT_TM_MSG_SHADOW_CLEAR:
+            // 未能建表时同样逐次格式化
             break;
-        // case IOT_TM_MSG_GATEWAY_ADD_TOPO:
-        // case IOT_TM_MSG_GATEWAY_DELETE_TOPO:
-        // case IOT_TM_MSG_GATEWAY_GET_TOPO:
-        // case IOT_TM_MSG_GATEWAY_SUB_DEVICE_LOGIN:
-        // case IOT_TM_MSG_GATEWAY_SUB_DEVICE_LOGOUT:
-        // case IOT_TM_MSG_GATEWAY_SUB_DEVICE_DISCOVERY:
-        // case IOT_TM_MSG_GATEWAY_TOPO_CHANGE_NOTIFY_REPLY:
-        // case IOT_TM_MSG_GATEWAY_SUB_DEVICE_CHANGE_NOTIFY_REPLY: {
-        //     *topic = iot_get_common_topic(dm_handle->allocator, 
-        //         g_dm_send_topic_mapping[msg->type].topic, product_key, device_name);
-        // }
-        //     break;
-        // case IOT_TM_MSG_GATEWAY_GET_DEVICE_SECRET:{
-        //     *topic = iot_get_topic_with_1_c_str_param(dm_handle->allocator, 
-        //         g_dm_send_topic_mapping[msg->type].topic, product_key, device_name, 
-        //             (char*) msg->data.gateway_get_device_secret->uuid);
-        // }
-        //     break;
-        // case IOT_TM_MSG_GATEWAY_ADD_TOPO_NOTIFY_REPLY: {
-        //     *topic = iot_get_topic_with_1_c_str_param(dm_handle->allocator, 
-        //         g_dm_send_topic_mapping[msg->type].topic, product_key, device_name,
-        //             (char*) msg->data.gateway_add_topo_notify_reply->trace_id);
-        // }
+        case IOT_TM_MSG_WEBSHELL_COMMAND_REPLY:
+            p1 = msg->data.webshell_command_reply->uid;
             break;
-        case IOT_TM_MSG_WEBSHELL_COMMAND_REPLY: {
-            *topic = iot_get_topic_with_1_c_str_param(dm_handle->allocator, 
-                g_dm_send_topic_mapping[msg->type].topic, product_key, device_name, 
-                    (char *)msg->data.webshell_command_reply->uid);
-        }
+        case IOT_TM_MSG_WEBSHELL_COMMAND_PONG:
+            p1 = msg->data.webshell_command_pong->uid;
             break;
-        case IOT_TM_MSG_WEBSHELL_COMMAND_PONG: {
-            *topic = iot_get_topic_with_1_c_str_param(dm_handle->allocator, 
-                g_dm_send_topic_mapping[msg->type].topic, product_key, device_name, 
-                        (char *)msg->data.webshell_command_pong->uid);
-        }
+        case IOT_TM_MSG_EVENT_POST:
+            p1 = msg->data.event_post->module_key;
+            p2 = msg->data.event_post->identifier;
             break;
-        case IOT_TM_MSG_EVENT_POST: {
-            *topic = iot_get_topic_with_2_c_str_param(dm_handle->allocator, 
-                g_dm_send_topic_mapping[msg->type].topic, product_key, device_name,
-                        (char*) msg->data.event_post->module_key,
-                        (char*) msg->data.event_post->identifier);
-        }
+        case IOT_TM_MSG_SERVICE_CALL_REPLY:
+            p1 = msg->data.service_call_reply->module_key;
+            p2 = msg->data.service_call_reply->identifier;
+            p3 = msg->data.service_call_reply->topic_uuid;
             break;
-        case IOT_TM_MSG_SERVICE_CALL_REPLY: {
-            *topic = iot_get_topic_with_3_c_str_param(dm_handle->allocator, g_dm_send_topic_mapping[msg->type].topic,
-                                                      aws_string_c_str(product_key),
-                                                      aws_string_c_str(device_name),
-                                                msg->data.service_call_reply->module_key,
-                                                msg->data.service_call_reply->identifier,
-                                                msg->data.service_call_reply->topic_uuid);
+        case IOT_TM_MSG_CUSTOM_TOPIC:
+            p1 = msg->data.custom_topic_post->custom_topic_suffix;
             break;
+        default:
+            return VOLC_ERR_DM_PUBLISH_TYPE_UNKNOWN;
+    }
+    *topic = iot_tm_topic_format(scratch, scratch_cap, heap, g_dm_send_topic_mapping[msg->type].topic,
+                                 product_key, device_name, p1, p2, p3);
+    return *topic != NULL ? VOLC_OK : VOLC_ERR_MALLOC;
+}
+
+#define TM_JSON_BUF_INIT_SIZE 512
+#define TM_JSON_BUF_MAX_SIZE (256 * 1024)
+
+iot_mqtt_buf_t *_tm_json_to_mqtt_buf(struct aws_json_value *json) {
+    // 长度未知，缓冲不足时加倍重新序列化
+    for (size_t cap = TM_JSON_BUF_INIT_SIZE; cap <= TM_JSON_BUF_MAX_SIZE; cap *= 2) {
+        iot_mqtt_buf_t *buf = iot_mqtt_buf_new(cap);
+        if (buf == NULL) {
+            return NULL;
         }
-        case IOT_TM_MSG_CUSTOM_TOPIC: {
-            *topic = iot_get_topic_with_1_c_str_param(dm_handle->allocator, g_dm_send_topic_mapping[msg->type].topic,
-                                                product_key,
-                                                device_name,
-                                                msg->data.custom_topic_post->custom_topic_suffix);
-            break;
+        if (aws_json_obj_print_to(json, (char *) buf->data, buf->cap)) {
+            buf->len = strlen((const char *) buf->data);
+            return buf;
+        }
+        iot_mqtt_buf_unref(buf);
+    }
+    return NULL;
+}
+
+uint64_t _tm_now_ms(void) {
+    return (uint64_t) lws_now_usecs() / 1000;
+}
+
+// 合并后的属性按属性上报格式封装发出
+static int _tm_coalescer_send(const char *topic, const char *params, size_t len, uint32_t members, void *userdata) {
+    iot_tm_handler_t *handle = (iot_tm_handler_t *) userdata;
+    const char *id = get_random_string_id_c_str(handle->allocator);
+    size_t cap = len + strlen(id) + strlen(SDK_VERSION) + 64;
+    iot_mqtt_buf_t *payload_buf = iot_mqtt_buf_new(cap);
+    if (payload_buf == NULL) {
+        aws_mem_release(handle->allocator, (void *) id);
+        return VOLC_ERR_MALLOC;
+    }
+    payload_buf->len = (size_t) snprintf((char *) payload_buf->data, payload_buf->cap,
+                                         "{\"id\":\"%s\",\"version\":\"%s\",\"params\":%.*s}",
+                                         id, SDK_VERSION, (int) len, params);
+    LOGD(TAG_IOT_MQTT, "_tm_coalescer_send topic = %s, members = %u, payload = %.*s", topic, members,
+         (int) payload_buf->len, (const char *) payload_buf->data);
+    int ret = iot_mqtt_publish_buf(handle->mqtt_handle, topic, payload_buf, IOT_MQTT_QOS1);
+    iot_mqtt_buf_unref(payload_buf);
+    aws_mem_release(handle->allocator, (void *) id);
+    return ret;
+}
+
+// 合并批开始计时，唤醒服务线程按窗口到期时间重新等待
+static void _tm_coalescer_wake(void *userdata) {
+    iot_tm_handler_t *handle = (iot_tm_handler_t *) userdata;
+    iot_mqtt_wakeup(handle->mqtt_handle);
+}
+
+// 属性上报策略、合并窗口、网关请求、时间同步、webshell输出与等待回复的定时任务，返回其中最近的到期时间
+static int32_t _tm_loop_hook(void *userdata) {
+    iot_tm_handler_t *handle = (iot_tm_handler_t *) userdata;
+    uint64_t now_ms = _tm_now_ms();
+    // 策略到期上报的属性可能进入合并批，先处理
+    int32_t next = iot_tm_property_cache_poll(handle->property_cache, now_ms);
+    int32_t coalesce_next = iot_tm_coalescer_poll(handle->coalescer, now_ms);
+    if (coalesce_next >= 0 && (next < 0 || coalesce_next < next)) {
+        next = coalesce_next;
+    }
+    if (handle->gateway != NULL) {
+        // 断线时服务端已让子设备下线，重连后重新登录之前在线的子设备
+        uint32_t connections = handle->mqtt_handle->connections;
+        if (connections != handle->gateway_connections) {
+            if (handle->gateway_connections != 0) {
+                iot_gateway_on_reconnect(handle->gateway);
+            }
+            handle->gateway_connections = connections;
         }
+        int32_t gateway_next = iot_gateway_poll(handle->gateway, now_ms);
+        if (gateway_next >= 0 && (next < 0 || gateway_next < next)) {
+            next = gateway_next;
+        }
+    }
+    int32_t ntp_next = _tm_ntp_poll(handle, now_ms);
+    if (ntp_next >= 0 && (next < 0 || ntp_next < next)) {
+        next = ntp_next;
+    }
+    int32_t probe_next = _tm_rtt_probe_poll(handle, now_ms);
+    if (probe_next >= 0 && (next < 0 || probe_next < next)) {
+        next = probe_next;
+    }
+    if (handle->webshell != NULL) {
+        int32_t webshell_next = iot_webshell_poll(handle->webshell, now_ms);
+        if (webshell_next >= 0 && (next < 0 || webshell_next < next)) {
+            next = webshell_next;
+        }
+    }
+    int32_t pending_next = iot_tm_pending_poll(handle->pending, now_ms);
+    if (pending_next >= 0 && (next < 0 || pending_next < next)) {
+        next = pending_next;
+    }
+    return next;
+}
+
+int32_t iot_tm_set_property_coalesce(iot_tm_handler_t *handle, uint32_t window_ms, uint32_t max_bytes) {
+    if (NULL == handle || NULL == handle->mqtt_handle) {
+        return VOLC_ERR_NULL_POINTER;
+    }
+    if (handle->coalescer == NULL) {
+        if (window_ms == 0) {
+            return VOLC_OK;
+        }
+        handle->coalescer = (iot_tm_coalescer_t *) malloc(sizeof(iot_tm_coalescer_t));
+        if (handle->coalescer == NULL) {
+            return VOLC_ERR_MALLOC;
+        }
+        iot_tm_coalescer_init(handle->coalescer, _tm_coalescer_send, handle);
+        iot_tm_coalescer_set_wake(handle->coalescer, _tm_coalescer_wake);
+        iot_mqtt_set_loop_hook(handle->mqtt_handle, _tm_loop_hook, handle);
+    }
+
+    iot_tm_msg_t msg = {0};
+    msg.type = IOT_TM_MSG_PROPERTY_POST;
+    char scratch[IOT_TM_TOPIC_SCRATCH_SIZE];
+    char *heap = NULL;
+    const char *topic = NULL;
+    int32_t ret = _dm_prepare_send_topic(handle, &msg, scratch, sizeof(scratch), &heap, &topic);
+    if (ret != VOLC_OK) {
+        return ret;
+    }
+    iot_tm_coalesce_policy_t policy = {window_ms, max_bytes};
+    ret = iot_tm_coalescer_set_policy(handle->coalescer, topic, &policy);
+    free(heap);
+    return ret;
+}
+
+int32_t iot_tm_set_property_report_policy(iot_tm_handler_t *handle, const char *identifier,
+                                          const iot_tm_property_policy_t *policy) {
+    if (NULL == handle || NULL == handle->mqtt_handle) {
+        return VOLC_ERR_NULL_POINTER;
+    }
+    if (handle->property_cache == NULL) {
+        if (policy == NULL) {
+            return VOLC_OK;
+        }
+        handle->property_cache = (iot_tm_property_cache_t *) malloc(sizeof(iot_tm_property_cache_t));
+        if (handle->property_cache == NULL) {
+            return VOLC_ERR_MALLOC;
+        }
+        iot_tm_property_cache_init(handle->property_cache, _tm_property_cache_send, handle);
+        iot_mqtt_set_loop_hook(handle->mqtt_handle, _tm_loop_hook, handle);
+    }
+    return iot_tm_property_cache_set_policy(handle->property_cache, identifier, policy);
+}
+
+int32_t iot_tm_set_shadow_cache(iot_tm_handler_t *handle, struct iot_kv_ctx *kv) {
+    if (NULL == handle) {
+        return VOLC_ERR_NULL_POINTER;
+    }
+    if (handle->shadow_cache != NULL) {
+        return VOLC_OK;
+    }
+    handle->shadow_cache = (iot_tm_shadow_cache_t *) malloc(sizeof(iot_tm_shadow_cache_t));
+    if (handle->shadow_cache == NULL) {
+        return VOLC_ERR_MALLOC;
+    }
+    int32_t ret = iot_tm_shadow_cache_init(handle->shadow_cache, kv);
+    if (ret != VOLC_OK) {
+        // 未初始化的缓存不能留给发送与释放路径使用
+        free(handle->shadow_cache);
+        handle->shadow_cache = NULL;
+    }
+    return ret;
+}
+
+int32_t iot_tm_gateway_enable(iot_tm_handler_t *handle, const iot_gateway_limits_t *limits) {
+    if (NULL == handle || NULL == handle->mqtt_handle || NULL == handle->mqtt_handle->config ||
+        NULL == handle->mqtt_handle->config->basic_config) {
+        return VOLC_ERR_NULL_POINTER;
+    }
+    if (handle->gateway != NULL) {
+        return VOLC_OK;
+    }
+    handle->gateway = (iot_gateway_t *) malloc(sizeof(iot_gateway_t));
+    if (handle->gateway == NULL) {
+        return VOLC_ERR_MALLOC;
+    }
+    int32_t ret = iot_gateway_init(handle->gateway, limits, handle->mqtt_handle->config->basic_config->device_secret,
+                                   _tm_gateway_send, _tm_gateway_result, handle);
+    if (ret != VOLC_OK) {
+        free(handle->gateway);
+        handle->gateway = NULL;
+        return ret;
+    }
+    iot_mqtt_set_loop_hook(handle->mqtt_handle, _tm_loop_hook, handle);
+    return _tm_gateway_set_up_mqtt_topic(handle);
+}
+
+int32_t iot_tm_ntp_sync(iot_tm_handler_t *handle, uint32_t interval_ms) {
+    if (NULL == handle || NULL == handle->mqtt_handle) {
+        return VOLC_ERR_NULL_POINTER;
+    }
+    handle->ntp_sync.interval_ms = interval_ms;
+    handle->ntp_sync.burst_left = IOT_NTP_FILTER_SIZE;
+    handle->ntp_sync.next_ms = _tm_now_ms();
+    iot_mqtt_set_loop_hook(handle->mqtt_handle, _tm_loop_hook, handle);
+    return VOLC_OK;
+}
+
+int32_t iot_tm_rtt_probe(iot_tm_handler_t *handle, const iot_tm_rtt_probe_config_t *config) {
+    if (NULL == handle || NULL == handle->mqtt_handle) {
+        return VOLC_ERR_NULL_POINTER;
+    }
+    iot_tm_rtt_probe_t *probe = &handle->rtt_probe;
+    if (config == NULL) {
+        free(probe->report_identifier);
+        memset(probe, 0, sizeof(iot_tm_rtt_probe_t));
+        return VOLC_OK;
+    }
+    if (config->interval_ms > 0 && config->interval_ms < IOT_TM_RTT_PROBE_MIN_INTERVAL_MS) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    char *identifier = NULL;
+    if (config->report_identifier != NULL && config->report_interval_ms > 0) {
+        identifier = strdup(config->report_identifier);
+        if (identifier == NULL) {
+            return VOLC_ERR_MALLOC;
+        }
+    }
+    uint64_t now_ms = _tm_now_ms();
+    free(probe->report_identifier);
+    probe->interval_ms = config->interval_ms;
+    probe->next_ms = now_ms;
+    probe->report_identifier = identifier;
+    probe->report_interval_ms = identifier != NULL ? config->report_interval_ms : 0;
+    probe->next_report_ms = now_ms + probe->report_interval_ms;
+    iot_mqtt_set_loop_hook(handle->mqtt_handle, _tm_loop_hook, handle);
+    return VOLC_OK;
+}
+
+int32_t iot_tm_rtt_stats(iot_tm_handler_t *handle, iot_mqtt_rtt_stats_t *stats) {
+    if (NULL == handle || NULL == handle->mqtt_handle) {
+        return VOLC_ERR_NULL_POINTER;
+    }
+    return iot_mqtt_get_rtt_stats(handle->mqtt_handle, stats);
+}
+
+int32_t iot_tm_webshell_enable(iot_tm_handler_t *handle, const iot_webshell_config_t *config) {
+    if (NULL == handle || NULL == handle->mqtt_handle) {
+        return VOLC_ERR_NULL_POINTER;
+    }
+    if (handle->webshell != NULL) {
+        return VOLC_OK;
+    }
+    iot_webshell_t *webshell = (iot_webshell_t *) malloc(sizeof(iot_webshell_t));
+    if (webshell == NULL) {
+        return VOLC_ERR_MALLOC;
+    }
+    int32_t ret = iot_webshell_init(webshell, config, _tm_webshell_send, handle);
+    if (ret != VOLC_OK) {
+        free(webshell);
+        return ret;
+    }
+    handle->webshell = webshell;
+    iot_mqtt_set_loop_hook(handle->mqtt_handle, _tm_loop_hook, handle);
+    return VOLC_OK;
+}
+
+int32_t iot_tm_webshell_kill(iot_tm_handler_t *handle, const char *uid) {
+    if (NULL == handle || NULL == handle->webshell) {
+        return VOLC_ERR_NULL_POINTER;
+    }
+    return iot_webshell_kill(handle->webshell, uid);
+}
+
+// 回复payload = {"ID":"...","Code":0,"Data":{...}}
+void _tm_pending_on_reply(iot_tm_handler_t *handle, const uint8_t *payload, size_t len) {
+    if (handle == NULL || iot_tm_pending_count(handle->pending) == 0) {
+        return;
+    }
+    struct aws_json_value *root = aws_json_value_new_from_string(handle->allocator,
+        aws_byte_cursor_from_array(payload, len));
+    if (root == NULL) {
+        return;
+    }
+    struct aws_byte_cursor id_cur = aws_json_get_str_byte_cur_val(root, "ID");
+    struct aws_json_value *code_json = aws_json_value_get_from_object(root, aws_byte_cursor_from_c_str("Code"));
+    double code = 0;
+    if (id_cur.len > 0 && code_json != NULL && aws_json_value_get_number(code_json, &code) == AWS_OP_SUCCESS) {
+        char *msg_id = aws_cur_to_char_str(handle->allocator, &id_cur);
+        iot_tm_pending_complete(handle->pending, msg_id, (int32_t) code, (const char *) payload, len);
+        aws_mem_release(handle->allocator, msg_id);
+    }
+    aws_json_value_destroy(root);
+}
+
+// 有回复且回复中带请求ID的消息
+static const char *_tm_msg_request_id(const iot_tm_msg_t *msg) {
+    switch (msg->type) {
+        case IOT_TM_MSG_PROPERTY_POST:
+            return msg->data.property_post == NULL ? NULL : msg->data.property_post->id;
+        case IOT_TM_MSG_EVENT_POST:
+            return msg->data.event_post == NULL ? NULL : msg->data.event_post->id;
+        case IOT_TM_MSG_SHADOW_REPORT:
+            return msg->data.shadow_post == NULL ? NULL : msg->data.shadow_post->id;
+        case IOT_TM_MSG_SHADOW_GET:
+            return msg->data.shadow_get == NULL ? NULL : msg->data.shadow_get->id;
+        case IOT_TM_MSG_SHADOW_CLEAR:
+            return msg->data.shadow_clear == NULL ? NULL : msg->data.shadow_clear->id;
         default:
-            ret = VOLC_ERR_DM_PUBLISH_TYPE_UNKNOWN;
-            break;
+            return NULL;
+    }
+}
+
+int32_t _tm_pending_enable(iot_tm_handler_t *handle) {
+    // 多个线程可能同时首次异步发送，复用handler的锁
+    int32_t ret = VOLC_OK;
+    platform_mutex_lock(handle->topic_table_mutex);
+    if (handle->pending == NULL) {
+        iot_tm_pending_t *pending = (iot_tm_pending_t *) malloc(sizeof(iot_tm_pending_t));
+        if (pending == NULL) {
+            ret = VOLC_ERR_MALLOC;
+        } else if ((ret = iot_tm_pending_init(pending)) != VOLC_OK) {
+            free(pending);
+        } else {
+            handle->pending = pending;
+            iot_mqtt_set_loop_hook(handle->mqtt_handle, _tm_loop_hook, handle);
+        }
+    }
+    platform_mutex_unlock(handle->topic_table_mutex);
+    return ret;
+}
+
+int32_t iot_tm_send_async(iot_tm_handler_t *handle, const iot_tm_msg_t *msg, uint32_t timeout_ms,
+                          iot_tm_reply_fn cb, void *userdata) {
+    if (NULL == handle || NULL == msg || NULL == handle->mqtt_handle) {
+        return VOLC_ERR_NULL_POINTER;
+    }
+    if (msg->type >= IOT_TM_MSG_MAX) {
+        return VOLC_ERR_TM_USER_INPUT_OUT_RANGE;
+    }
+    const char *msg_id = _tm_msg_request_id(msg);
+    if (msg_id == NULL) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    tm_msg_send_func_t send_func = g_dm_send_topic_mapping[msg->type].func;
+    if (msg->type == IOT_TM_MSG_PROPERTY_POST) {
+        // 合并或按策略暂存后发出的消息ID不同，无法关联回复
+        send_func = _tm_send_property_post_direct;
+    } else if (msg->type == IOT_TM_MSG_SHADOW_REPORT) {
+        // 没有变化的增量不会发出，也就没有回复
+        send_func = _tm_send_shadow_post_direct;
+    }
+    int32_t ret = _tm_pending_enable(handle);
+    if (ret != VOLC_OK) {
+        return ret;
+    }
+    if (handle->coalescer != NULL) {
+        // 先发出已合并的属性保证顺序
+        iot_tm_coalescer_flush(handle->coalescer, NULL);
+    }
+
+    char scratch[IOT_TM_TOPIC_SCRATCH_SIZE];
+    char *heap = NULL;
+    const char *topic = NULL;
+    ret = _dm_prepare_send_topic(handle, msg, scratch, sizeof(scratch), &heap, &topic);
+    if (ret != VOLC_OK) {
+        return ret;
+    }
+    // 先登记再发出，回复可能在发送返回前到达
+    if (timeout_ms == 0) {
+        timeout_ms = IOT_TM_PENDING_DEFAULT_TIMEOUT_MS;
+    }
+    ret = iot_tm_pending_add(handle->pending, msg_id, _tm_now_ms() + timeout_ms, cb, userdata);
+    if (ret == VOLC_OK) {
+        ret = send_func(handle, topic, msg);
+        if (ret != VOLC_OK) {
+            iot_tm_pending_remove(handle->pending, msg_id);
+        } else {
+            // 让服务线程按新登记的超时时间重新设置定时器
+            iot_mqtt_wakeup(handle->mqtt_handle);
+        }
+    }
+    free(heap);
+    return ret;
+}
+
+typedef struct {
+    platform_mutex_t mutex;
+    bool done;
+    bool want_reply;
+    int32_t code;
+    char *reply;
+} _tm_reply_waiter_t;
+
+static void _tm_reply_waiter_on_reply(const char *msg_id, int32_t code, const char *payload, size_t len,
+                                      void *userdata) {
+    _tm_reply_waiter_t *waiter = (_tm_reply_waiter_t *) userdata;
+    char *reply = NULL;
+    if (waiter->want_reply && payload != NULL) {
+        reply = (char *) malloc(len + 1);
+        if (reply != NULL) {
+            memcpy(reply, payload, len);
+            reply[len] = '\0';
+        }
+    }
+    platform_mutex_lock(waiter->mutex);
+    waiter->code = code;
+    waiter->reply = reply;
+    waiter->done = true;
+    platform_mutex_unlock(waiter->mutex);
+}
+
+int32_t iot_tm_send_and_wait(iot_tm_handler_t *handle, const iot_tm_msg_t *msg, uint32_t timeout_ms,
+                             int32_t *code, char **reply_json) {
+    if (reply_json != NULL) {
+        *reply_json = NULL;
+    }
+    // 回复只能由事件循环收取，在事件循环线程中等待永远等不到
+    if (handle != NULL && iot_mqtt_in_service_thread(handle->mqtt_handle)) {
+        LOGE(TAG_IOT_MQTT, "iot_tm_send_and_wait called from the event loop thread, use iot_tm_send_async");
+        return VOLC_ERR_TM_IN_SERVICE_THREAD;
+    }
+    _tm_reply_waiter_t waiter;
+    memset(&waiter, 0, sizeof(waiter));
+    waiter.want_reply = reply_json != NULL;
+    platform_mutex_init(waiter.mutex);
+    int32_t ret = iot_tm_send_async(handle, msg, timeout_ms, _tm_reply_waiter_on_reply, &waiter);
+    if (ret != VOLC_OK) {
+        platform_mutex_destroy(waiter.mutex);
+        return ret;
+    }
+    bool done = false;
+    while (!done) {
+        // 事件循环在其他线程收到回复；到期也在这里检查，事件循环阻塞时不会一直等待
+        iot_tm_pending_poll(handle->pending, _tm_now_ms());
+        platform_mutex_lock(waiter.mutex);
+        done = waiter.done;
+        platform_mutex_unlock(waiter.mutex);
+        if (!done) {
+            usleep(1000);
+        }
+    }
+    platform_mutex_destroy(waiter.mutex);
+    if (code != NULL) {
+        *code = waiter.code;
+    }
+    if (reply_json != NULL) {
+        *reply_json = waiter.reply;
+    } else {
+        free(waiter.reply);
+    }
+    if (waiter.code == VOLC_ERR_TM_REPLY_TIMEOUT || waiter.code == VOLC_ERR_TM_REPLY_CANCELLED) {
+        return waiter.code;
     }
-    aws_string_destroy_secure(product_key);
-    aws_string_destroy_secure(device_name);
     return VOLC_OK;
 }
 
+int32_t iot_tm_get_shadow_desired(iot_tm_handler_t *handle, const char *product_key, const char *device_name,
+                                  char **desired_json, int64_t *version) {
+    if (NULL == handle || NULL == handle->shadow_cache || NULL == product_key || NULL == device_name) {
+        return VOLC_ERR_NULL_POINTER;
+    }
+    // 与影子topic中的 {product_key}/{device_name} 一致
+    char device[IOT_TM_TOPIC_SCRATCH_SIZE];
+    int n = snprintf(device, sizeof(device), "%s/%s", product_key, device_name);
+    if (n < 0 || (size_t) n >= sizeof(device)) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    return iot_tm_shadow_cache_get_desired(handle->shadow_cache, device, desired_json, version);
+}
+
 int32_t iot_tm_send(iot_tm_handler_t *handle, const iot_tm_msg_t *msg) {
     // 发送消息
     if (NULL == handle || NULL == msg) {
@@ -474,11 +946,18 @@ int32_t iot_tm_send(iot_tm_handler_t *handle, const iot_tm_msg_t *msg) {
         return VOLC_ERR_NULL_POINTER;
     }
     int32_t ret = VOLC_OK;
-    char *topic = NULL;
-    int32_t prepare_topic_ret = _dm_prepare_send_topic(handle, msg, &topic);
+    if (handle->coalescer != NULL && msg->type != IOT_TM_MSG_PROPERTY_POST) {
+        // 事件、告警等消息立即发送，先发出已合并的属性保证顺序
+        iot_tm_coalescer_flush(handle->coalescer, NULL);
+    }
+    // 参数化topic格式化到栈上的缓冲，发送路径不再为topic分配内存
+    char scratch[IOT_TM_TOPIC_SCRATCH_SIZE];
+    char *heap = NULL;
+    const char *topic = NULL;
+    int32_t prepare_topic_ret = _dm_prepare_send_topic(handle, msg, scratch, sizeof(scratch), &heap, &topic);
     if (prepare_topic_ret == VOLC_OK) {
         ret = g_dm_send_topic_mapping[msg->type].func(handle, topic, msg);
-        aws_mem_release(handle->allocator, topic);
+        free(heap);
         return ret;
     } else {
         return prepare_topic_ret;
@@ -36,60 +36,149 @@ void iot_property_post_init_with_id(iot_tm_msg_property_post_t **pty,const char
     memset(propertyP, 0, sizeof(iot_tm_msg_property_post_t));
     propertyP->id = id;
     propertyP->version = SDK_VERSION;
-    propertyP->params = (void*) aws_json_value_new_object(aws_alloc());
+    propertyP->params = (void*) iot_tm_members_new();
     *pty = propertyP;
 }
 
+// 开始写入 "key":{"value":...,"time":...} ，key已存在时返回NULL，与原先加入aws_json对象一致
+static json_writer_t *_property_post_begin(iot_tm_msg_property_post_t *pty, const char *key) {
+    json_writer_t *w = iot_tm_members_begin((iot_tm_members_t *) pty->params, key);
+    if (w != NULL) {
+        json_writer_begin_object(w);
+    }
+    return w;
+}
+
+static void _property_post_end(iot_tm_msg_property_post_t *pty, json_writer_t *w) {
+    json_writer_kv_int(w, "time", (int64_t) iot_now_ms());
+    json_writer_end_object(w);
+    iot_tm_members_end((iot_tm_members_t *) pty->params);
+}
+
 void iot_property_post_add_param_num(iot_tm_msg_property_post_t *pty, const char *key, double value) {
-    struct aws_json_value *params = aws_json_value_new_object(aws_alloc());
-    aws_json_add_num_val(params, "value", value);
-    aws_json_add_num_val(params, "time", (double) unix_timestamp_ms());
-    aws_json_add_json_obj((struct aws_json_value*) pty->params, key, params);
+    json_writer_t *w = _property_post_begin(pty, key);
+    if (w == NULL) {
+        return;
+    }
+    json_writer_kv_double(w, "value", value);
+    _property_post_end(pty, w);
 }
 
+// 取得value的所有权，value为NULL时只上报time
 void iot_property_post_add_param_object(iot_tm_msg_property_post_t *pty, const char *key, struct aws_json_value *value) {
-    struct aws_json_value *value_data_json = aws_json_value_new_object(aws_alloc());
-    aws_json_add_json_obj(value_data_json, "value", value);
-    aws_json_add_num_val(value_data_json, "time", (double) unix_timestamp_ms());
-    aws_json_add_json_obj((struct aws_json_value*) pty->params, key, value_data_json);
+    json_writer_t *w = _property_post_begin(pty, key);
+    if (w != NULL) {
+        if (value != NULL) {
+            json_writer_key(w, "value");
+            iot_tm_json_write_value(w, value);
+        }
+        _property_post_end(pty, w);
+    }
+    aws_json_value_destroy(value);
 }
 
 void iot_property_post_add_param_json_str(iot_tm_msg_property_post_t *pty, const char *key, const char *json_val) {
-    struct aws_json_value *value_data_json = aws_json_value_new_object(aws_alloc());
+    // 解析后重新序列化，与原先输出一致（去除空白、数字规整）
     struct aws_json_value *json_data = aws_json_value_new_from_string(aws_alloc(), aws_byte_cursor_from_c_str(json_val));
-    aws_json_add_json_obj(value_data_json, "value", json_data);
-    aws_json_add_num_val(value_data_json, "time", (double) unix_timestamp_ms());
-    aws_json_add_json_obj((struct aws_json_value*) pty->params, key, value_data_json);
+    iot_property_post_add_param_object(pty, key, json_data);
 }
 
 void iot_property_post_add_param_string(iot_tm_msg_property_post_t *pty, const char *key, const char *value) {
-    struct aws_json_value *value_data_json = aws_json_value_new_object(aws_alloc());
-    aws_json_add_str_val_1(aws_alloc(), value_data_json, "value", value);
-    aws_json_add_num_val(value_data_json, "time", (double) unix_timestamp_ms());
-    aws_json_add_json_obj((struct aws_json_value*) pty->params, key, value_data_json);
+    json_writer_t *w = _property_post_begin(pty, key);
+    if (w == NULL) {
+        return;
+    }
+    if (value != NULL) {
+        json_writer_kv_string(w, "value", value);
+    }
+    _property_post_end(pty, w);
+}
+
+iot_mqtt_buf_t *_tm_property_post_payload_buf(iot_tm_msg_property_post_t *pty) {
+    iot_tm_members_t *params = (iot_tm_members_t *) pty->params;
+    if (params == NULL || params->error != VOLC_OK) {
+        return NULL;
+    }
+    // {"id":"...","version":"...","params":{...}}
+    size_t cap = iot_tm_json_str_bound(pty->id) + iot_tm_json_str_bound(pty->version) + params->buf.len + 32;
+    json_writer_t w;
+    struct aws_byte_buf view;
+    iot_mqtt_buf_t *buf = iot_tm_payload_begin(&w, &view, cap);
+    if (buf == NULL) {
+        return NULL;
+    }
+    json_writer_begin_object(&w);
+    if (pty->id != NULL) {
+        json_writer_kv_string(&w, "id", pty->id);
+    }
+    if (pty->version != NULL) {
+        json_writer_kv_string(&w, "version", pty->version);
+    }
+    json_writer_key(&w, "params");
+    iot_tm_members_write(params, &w);
+    json_writer_end_object(&w);
+    return iot_tm_payload_finish(&w, &view, buf);
 }
 
 void* iot_property_post_payload(iot_tm_msg_property_post_t *pty) {
+    // 兼容旧接口，发送路径直接使用_tm_property_post_payload_buf
     if (pty->payload_root == NULL) {
-        pty->payload_root = aws_json_value_new_object(aws_alloc());
-        aws_json_add_str_val_1(aws_alloc(), pty->payload_root, "id", pty->id);
-        aws_json_add_str_val_1(aws_alloc(), (struct aws_json_value*) pty->payload_root, "version", pty->version);
-        aws_json_add_json_obj((struct aws_json_value*) pty->payload_root, "params", pty->params);
+        iot_mqtt_buf_t *buf = _tm_property_post_payload_buf(pty);
+        if (buf == NULL) {
+            return NULL;
+        }
+        pty->payload_root = aws_json_value_new_from_string(aws_alloc(), aws_byte_cursor_from_array(buf->data, buf->len));
+        iot_mqtt_buf_unref(buf);
     }
     return pty->payload_root;
-//    return aws_json_obj_to_byte_buf(aws_alloc(), pty->payload_root);
 }
 
 void iot_property_post_free(iot_tm_msg_property_post_t *pty) {
     if (pty->payload_root != NULL) {
         aws_json_value_destroy(pty->payload_root);
-    } else if (pty->params != NULL) {
-        aws_json_value_destroy(pty->params);
     }
+    iot_tm_members_destroy((iot_tm_members_t *) pty->params);
     aws_mem_release(aws_alloc(), (void*)pty->id);
     aws_mem_release(aws_alloc(), pty);
 }
 
+static int32_t _tm_publish_property_post_now(iot_tm_handler_t *dm_handle, const char *topic, iot_tm_msg_property_post_t *pty) {
+    iot_mqtt_buf_t *payload_buf = _tm_property_post_payload_buf(pty);
+    if (payload_buf == NULL) {
+        return VOLC_ERR_MALLOC;
+    }
+
+    LOGD(TAG_IOT_MQTT, "_tm_send_property_post call topic = %s,  payload = %.*s", topic,
+         (int) payload_buf->len, (const char *) payload_buf->data);
+    int32_t ret = iot_mqtt_publish_buf(dm_handle->mqtt_handle, topic, payload_buf, IOT_MQTT_QOS1);
+
+    // 发布持有自己的引用，送达后释放
+    iot_mqtt_buf_unref(payload_buf);
+    return ret;
+}
+
+// 属性上报发出：开启合并时按属性加入合并批，否则直接发布
+static int32_t _tm_publish_property_post(iot_tm_handler_t *dm_handle, const char *topic, iot_tm_msg_property_post_t *pty) {
+    int ret = VOLC_OK;
+    if (iot_tm_coalescer_enabled(dm_handle->coalescer, topic)) {
+        // 按属性拆开加入合并批，由合并器封装id与version发出
+        iot_tm_members_t *params = (iot_tm_members_t *) pty->params;
+        if (params == NULL || params->error != VOLC_OK) {
+            return VOLC_ERR_MALLOC;
+        }
+        uint64_t now_ms = _tm_now_ms();
+        for (size_t i = 0; i < params->count && ret == VOLC_OK; i++) {
+            const iot_tm_member_t *member = &params->members[i];
+            ret = iot_tm_coalescer_add(dm_handle->coalescer, topic,
+                                       (const char *) params->buf.buffer + member->key_off, member->key_len,
+                                       (const char *) params->buf.buffer + member->value_off, member->value_len,
+                                       now_ms);
+        }
+        return ret;
+    }
+    return _tm_publish_property_post_now(dm_handle, topic, pty);
+}
+
 /**
  * 发送属性
  */
@@ -100,15 +189,34 @@ int32_t _tm_send_property_post(void *handler, const char *topic, const void *msg
 
     // 需要这种格式
     // //{"key":{"value", 123, "time" :123}}
-    int ret = VOLC_OK;
-    struct aws_byte_buf payload_buf = aws_json_obj_to_byte_buf(dm_handle->allocator, ((struct aws_json_value*) iot_property_post_payload(msg->data.property_post)));
-    struct aws_byte_cursor payload_cur = aws_byte_cursor_from_buf(&payload_buf);
+    if (iot_tm_property_cache_enabled(dm_handle->property_cache)) {
+        // 经过上报策略过滤，需要上报的属性由_tm_property_cache_send发出
+        iot_tm_members_t *params = (iot_tm_members_t *) msg->data.property_post->params;
+        if (params == NULL) {
+            return VOLC_ERR_MALLOC;
+        }
+        int32_t ret = iot_tm_property_cache_post(dm_handle->property_cache, topic, params, _tm_now_ms());
+        // 暂存的属性有了新的到期时间，唤醒服务线程重新计算
+        iot_mqtt_wakeup(dm_handle->mqtt_handle);
+        return ret;
+    }
+    return _tm_publish_property_post(dm_handle, topic, msg->data.property_post);
+}
 
-    iot_mqtt_publish(dm_handle->mqtt_handle, topic, (uint8_t *)payload_cur.ptr, payload_cur.len, IOT_MQTT_QOS1);
-    LOGD(TAG_IOT_MQTT, "_tm_send_property_post call topic = %s,  payload = %.*s", topic,
-         AWS_BYTE_CURSOR_PRI(payload_cur));
+int32_t _tm_send_property_post_direct(void *handler, const char *topic, const void *msg_p) {
+    iot_tm_handler_t *dm_handle = (iot_tm_handler_t *) handler;
+    const iot_tm_msg_t *msg = (const iot_tm_msg_t *) msg_p;
+    return _tm_publish_property_post_now(dm_handle, topic, msg->data.property_post);
+}
 
-    aws_byte_buf_clean_up(&payload_buf);
+int _tm_property_cache_send(const char *topic, const iot_tm_members_t *params, void *userdata) {
+    iot_tm_handler_t *dm_handle = (iot_tm_handler_t *) userdata;
+    iot_tm_msg_property_post_t post = {0};
+    post.id = get_random_string_id_c_str(dm_handle->allocator);
+    post.version = SDK_VERSION;
+    post.params = (void *) params;
+    int ret = _tm_publish_property_post(dm_handle, topic, &post);
+    aws_mem_release(dm_handle->allocator, (void *) post.id);
     return ret;
 }
 
@@ -161,12 +269,16 @@ int32_t _tm_send_property_set_post_reply(void *handler, const char *topic, const
     // 需要这种格式
     // //{"key":{"value", 123, "time" :123}}
     int ret = VOLC_OK;
-    struct aws_byte_buf payload_buf = aws_json_obj_to_byte_buf(dm_handle->allocator, iot_property_set_post_reply_payload(msg->data.property_set_post_reply));
-    struct aws_byte_cursor payload_cur = aws_byte_cursor_from_buf(&payload_buf);
-    iot_mqtt_publish(dm_handle->mqtt_handle, topic, (uint8_t *)payload_cur.ptr, payload_cur.len, IOT_MQTT_QOS1);
+    iot_mqtt_buf_t *payload_buf = _tm_json_to_mqtt_buf(iot_property_set_post_reply_payload(msg->data.property_set_post_reply));
+    if (payload_buf == NULL) {
+        return VOLC_ERR_MALLOC;
+    }
+
     LOGD(TAG_IOT_MQTT, "_tm_send_property_set_post_reply call topic = %s,  payload = %.*s", topic,
-         AWS_BYTE_CURSOR_PRI(payload_cur));
+         (int) payload_buf->len, (const char *) payload_buf->data);
+    iot_mqtt_publish_buf(dm_handle->mqtt_handle, topic, payload_buf, IOT_MQTT_QOS1);
 
+    iot_mqtt_buf_unref(payload_buf);
     return ret;
 }
 
@@ -247,6 +359,7 @@ void _tm_recv_property_set_post_reply(const char* topic, const uint8_t *payload,
         AWS_BYTE_CURSOR_PRI(payload_byte_cursor));
 
     iot_tm_handler_t *dm_handle = (iot_tm_handler_t *) pUserData;
+    _tm_pending_on_reply(dm_handle, payload, len);
     if (NULL == dm_handle->recv_handler) {
         return;
     }
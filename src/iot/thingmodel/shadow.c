@@ -50,17 +50,24 @@ void iot_shadow_post_init_with_id(iot_tm_msg_shadow_post_t** pty, const char* id
     }
     shadowP->id = real_id;
     shadowP->version = SDK_VERSION;
-    shadowP->params = (void*) aws_json_value_new_object(aws_alloc());
-    shadowP->report = (void*) aws_json_value_new_object(aws_alloc());
+    shadowP->report = (void*) iot_tm_members_new();
     *pty = shadowP;
 }
 
 void iot_shadow_post_add_param_num(iot_tm_msg_shadow_post_t* pty, const char* key, double value) {
-    aws_json_add_num_val((struct aws_json_value*) pty->report, key, value);
+    iot_tm_members_t* report = (iot_tm_members_t*) pty->report;
+    json_writer_t* w = iot_tm_members_begin(report, key);
+    if (w == NULL) {
+        return;
+    }
+    json_writer_double(w, value);
+    iot_tm_members_end(report);
 }
 
+// 取得value的所有权
 void iot_shadow_post_add_param_object(iot_tm_msg_shadow_post_t* pty, const char* key, struct aws_json_value* value) {
-    aws_json_add_json_obj((struct aws_json_value*) pty->report, key, value);
+    iot_tm_members_add_json((iot_tm_members_t*) pty->report, key, value);
+    aws_json_value_destroy(value);
 }
 
 void iot_shadow_post_add_param_json_str(iot_tm_msg_shadow_post_t* pty, const char* key, const char* json_val) {
@@ -70,17 +77,58 @@ void iot_shadow_post_add_param_json_str(iot_tm_msg_shadow_post_t* pty, const cha
 }
 
 void iot_shadow_post_add_param_string(iot_tm_msg_shadow_post_t* pty, const char* key, const char* value) {
-    aws_json_add_str_val((struct aws_json_value*) pty->report, key, value);
+    iot_tm_members_t* report = (iot_tm_members_t*) pty->report;
+    if (value == NULL) {
+        return;
+    }
+    json_writer_t* w = iot_tm_members_begin(report, key);
+    if (w == NULL) {
+        return;
+    }
+    json_writer_string(w, value);
+    iot_tm_members_end(report);
+}
+
+iot_mqtt_buf_t* _tm_shadow_post_payload_buf(iot_tm_msg_shadow_post_t* pty) {
+    iot_tm_members_t* report = (iot_tm_members_t*) pty->report;
+    if (report == NULL || report->error != VOLC_OK) {
+        return NULL;
+    }
+    // {"id":"...","version":"...","params":{"version":123,"report":{...}}}
+    size_t cap = iot_tm_json_str_bound(pty->id) + iot_tm_json_str_bound(pty->version) + report->buf.len + 64;
+    json_writer_t w;
+    struct aws_byte_buf view;
+    iot_mqtt_buf_t* buf = iot_tm_payload_begin(&w, &view, cap);
+    if (buf == NULL) {
+        return NULL;
+    }
+    json_writer_begin_object(&w);
+    if (pty->id != NULL) {
+        json_writer_kv_string(&w, "id", pty->id);
+    }
+    if (pty->version != NULL) {
+        json_writer_kv_string(&w, "version", pty->version);
+    }
+    json_writer_key(&w, "params");
+    json_writer_begin_object(&w);
+    json_writer_kv_int(&w, "version", (int64_t) iot_now_ms());
+    json_writer_key(&w, "report");
+    iot_tm_members_write(report, &w);
+    json_writer_end_object(&w);
+    json_writer_end_object(&w);
+    return iot_tm_payload_finish(&w, &view, buf);
 }
 
+// 兼容旧接口，发送路径直接使用_tm_shadow_post_payload_buf
 void* iot_shadow_post_payload(iot_tm_msg_shadow_post_t* pty) {
     if (pty->payload_root == NULL) {
-        pty->payload_root = (void*) aws_json_value_new_object(aws_alloc());
-        aws_json_add_str_val((struct aws_json_value*) pty->payload_root, "id", pty->id);
-        aws_json_add_str_val((struct aws_json_value*) pty->payload_root, "version", pty->version);
-        aws_json_add_num_val((struct aws_json_value*) pty->params, "version", (double) get_current_time_mil());
-        aws_json_add_json_obj((struct aws_json_value*) pty->params, "report", (struct aws_json_value*) pty->report);
-        aws_json_add_json_obj((struct aws_json_value*) pty->payload_root, "params",(struct aws_json_value*) pty->params);
+        iot_mqtt_buf_t* buf = _tm_shadow_post_payload_buf(pty);
+        if (buf == NULL) {
+            return NULL;
+        }
+        pty->payload_root = (void*) aws_json_value_new_from_string(aws_alloc(),
+                                                                   aws_byte_cursor_from_array(buf->data, buf->len));
+        iot_mqtt_buf_unref(buf);
     }
     return pty->payload_root;
 }
@@ -92,28 +140,112 @@ void iot_shadow_post_free(iot_tm_msg_shadow_post_t* pty) {
     if (pty->payload_root != NULL) {
         aws_json_value_destroy((struct aws_json_value*) pty->payload_root);
     }
-    if (pty->params != NULL) {
-        aws_json_value_destroy((struct aws_json_value*) pty->params);
-    }
+    iot_tm_members_destroy((iot_tm_members_t*) pty->report);
     if (pty->id != NULL) {
         aws_mem_release(aws_alloc(), (void*)pty->id);
     }
     aws_mem_release(aws_alloc(), pty);
 }
 
+// topic为 sys/{product_key}/{device_name}/... ，取出 "product_key/device_name" 作为影子缓存的设备标识
+static bool _shadow_topic_device(const char* topic, char* device, size_t cap) {
+    const char* start = strchr(topic, '/');
+    if (start == NULL) {
+        return false;
+    }
+    start++;
+    const char* end = strchr(start, '/');
+    end = end != NULL ? strchr(end + 1, '/') : NULL;
+    if (end == NULL || (size_t) (end - start) >= cap) {
+        return false;
+    }
+    memcpy(device, start, (size_t) (end - start));
+    device[end - start] = '\0';
+    return true;
+}
+
+static int32_t _tm_publish_shadow_post(iot_tm_handler_t* dm_handle, const char* topic, iot_tm_msg_shadow_post_t* post) {
+    iot_mqtt_buf_t* payload_buf = _tm_shadow_post_payload_buf(post);
+    if (payload_buf == NULL) {
+        return VOLC_ERR_MALLOC;
+    }
+
+    LOGD(TAG_IOT_MQTT, "_tm_send_shadow_post call topic = %s,  payload = %.*s", topic,
+         (int) payload_buf->len, (const char*) payload_buf->data);
+    int32_t ret = iot_mqtt_publish_buf(dm_handle->mqtt_handle, topic, payload_buf, IOT_MQTT_QOS1);
+
+    iot_mqtt_buf_unref(payload_buf);
+    return ret;
+}
+
+// 计算增量并记为等待回复的上报，发布失败时放弃，收到回复后由_tm_recv_shadow_report_reply_handler确认
+static int32_t _tm_publish_shadow_delta(iot_tm_handler_t* dm_handle, const char* topic, const char* device,
+                                        iot_tm_msg_shadow_post_t* post, bool send_unchanged) {
+    iot_tm_members_t* delta = iot_tm_members_new();
+    if (delta == NULL) {
+        return VOLC_ERR_MALLOC;
+    }
+    int changed = iot_tm_shadow_cache_diff_reported(dm_handle->shadow_cache, device, post->id,
+                                                    (iot_tm_members_t*) post->report, delta);
+    int32_t ret = VOLC_OK;
+    if (changed < 0) {
+        ret = changed;
+    } else if (changed > 0 && !send_unchanged) {
+        // 只上报与已确认的值不同的字段
+        iot_tm_msg_shadow_post_t delta_post = *post;
+        delta_post.report = delta;
+        delta_post.payload_root = NULL;
+        ret = _tm_publish_shadow_post(dm_handle, topic, &delta_post);
+    } else if (send_unchanged) {
+        ret = _tm_publish_shadow_post(dm_handle, topic, post);
+    }
+    if (ret != VOLC_OK && changed > 0) {
+        iot_tm_shadow_cache_end_report(dm_handle->shadow_cache, device, post->id, false);
+    }
+    iot_tm_members_destroy(delta);
+    return ret;
+}
+
 int32_t _tm_send_shadow_post(void* handler, const char* topic, const void* msg_p) {
     iot_tm_handler_t* dm_handle = (iot_tm_handler_t*) handler;
     iot_tm_msg_t* msg = (iot_tm_msg_t*) msg_p;
-    int32_t ret = VOLC_OK;
-    struct aws_byte_buf payload_buf = aws_json_obj_to_byte_buf(dm_handle->allocator, ((struct aws_json_value*)iot_shadow_post_payload(msg->data.shadow_post)));
-    struct aws_byte_cursor payload_cur = aws_byte_cursor_from_buf(&payload_buf);
+    iot_tm_msg_shadow_post_t* post = msg->data.shadow_post;
+    char device[IOT_TM_TOPIC_SCRATCH_SIZE];
+    if (dm_handle->shadow_cache != NULL && post->id != NULL && _shadow_topic_device(topic, device, sizeof(device))) {
+        return _tm_publish_shadow_delta(dm_handle, topic, device, post, false);
+    }
+    return _tm_publish_shadow_post(dm_handle, topic, post);
+}
 
-    iot_mqtt_publish(dm_handle->mqtt_handle, topic, (uint8_t *)payload_cur.ptr, payload_cur.len, IOT_MQTT_QOS1);
-    LOGD(TAG_IOT_MQTT, "_tm_send_shadow_post call topic = %s,  payload = %.*s", topic,
-         AWS_BYTE_CURSOR_PRI(payload_cur));
-    aws_byte_buf_clean_up(&payload_buf);
+int32_t _tm_send_shadow_post_direct(void* handler, const char* topic, const void* msg_p) {
+    iot_tm_handler_t* dm_handle = (iot_tm_handler_t*) handler;
+    const iot_tm_msg_t* msg = (const iot_tm_msg_t*) msg_p;
+    iot_tm_msg_shadow_post_t* post = msg->data.shadow_post;
+    char device[IOT_TM_TOPIC_SCRATCH_SIZE];
+    if (dm_handle->shadow_cache != NULL && post->id != NULL && _shadow_topic_device(topic, device, sizeof(device))) {
+        // 完整上报，确认后同样记入已上报的值，之后的增量从这里算起
+        return _tm_publish_shadow_delta(dm_handle, topic, device, post, true);
+    }
+    return _tm_publish_shadow_post(dm_handle, topic, post);
+}
 
-    return ret;
+// 应用下发的desired到本地缓存，版本过期时返回false，消息不再交给业务
+static bool _shadow_cache_apply(iot_tm_handler_t* dm_handle, const char* topic, int64_t version,
+                                const struct aws_byte_buf* desired_buf, bool replace) {
+    char device[IOT_TM_TOPIC_SCRATCH_SIZE];
+    if (dm_handle->shadow_cache == NULL || !_shadow_topic_device(topic, device, sizeof(device))) {
+        return true;
+    }
+    int ret = iot_tm_shadow_cache_apply_desired(dm_handle->shadow_cache, device, version,
+                                                (const char*) desired_buf->buffer, desired_buf->len, replace);
+    if (ret == VOLC_ERR_TM_SHADOW_STALE_VERSION) {
+        LOGI(TAG_IOT_MQTT, "ignore stale shadow desired, topic = %s, version = %lld", topic, (long long) version);
+        return false;
+    }
+    if (ret != VOLC_OK) {
+        LOGW(TAG_IOT_MQTT, "shadow cache apply desired failed, topic = %s, ret = %d", topic, ret);
+    }
+    return true;
 }
 
 // shadow get
@@ -161,7 +293,7 @@ int32_t _tm_send_shadow_get(void* handler, const char* topic, const void* msg_p)
     struct aws_byte_buf payload_buf = aws_json_obj_to_byte_buf(dm_handle->allocator, ((struct aws_json_value*)iot_shadow_get_payload(msg->data.shadow_get)));
     struct aws_byte_cursor payload_cur = aws_byte_cursor_from_buf(&payload_buf);
 
-    iot_mqtt_publish(dm_handle->mqtt_handle, topic, (uint8_t *)payload_cur.ptr, payload_cur.len, IOT_MQTT_QOS1);
+    ret = iot_mqtt_publish(dm_handle->mqtt_handle, topic, (uint8_t *)payload_cur.ptr, payload_cur.len, IOT_MQTT_QOS1);
     LOGD(TAG_IOT_MQTT, "_tm_send_shadow_get call topic = %s,  payload = %.*s", topic,
          AWS_BYTE_CURSOR_PRI(payload_cur));
     aws_byte_buf_clean_up(&payload_buf);
@@ -179,7 +311,21 @@ void _tm_recv_shadow_get_reply_handler(const char* topic, const uint8_t *payload
     if (dm_handle == NULL) {
         return;
     }
-    if (NULL == dm_handle->recv_handler) {
+    _tm_pending_on_reply(dm_handle, payload, len);
+    struct aws_json_value* payload_json = aws_json_value_new_from_string(dm_handle->allocator, payload_byte_cursor);
+    double error_code = aws_json_get_num_val(payload_json, "Code");
+    if (error_code != 0) {
+        aws_json_value_destroy(payload_json);
+        return;
+    }
+    struct aws_json_value* data_json = aws_json_get_json_obj(dm_handle->allocator, payload_json, "Data");
+    double version = aws_json_get_num_val(data_json, "Version");
+    struct aws_byte_buf desired_buf = aws_json_get_json_obj_to_bye_buf(dm_handle->allocator, data_json, "Desired");
+    // get回复是完整的desired，整体替换缓存
+    if (!_shadow_cache_apply(dm_handle, topic, (int64_t) version, &desired_buf, true) ||
+        NULL == dm_handle->recv_handler) {
+        aws_byte_buf_clean_up(&desired_buf);
+        aws_json_value_destroy(payload_json);
         return;
     }
     iot_tm_recv_t recv;
@@ -200,15 +346,7 @@ void _tm_recv_shadow_get_reply_handler(const char* topic, const uint8_t *payload
 
     // package business data
     iot_tm_recv_shadow_get_reply_t shadow_get_data;
-    struct aws_json_value* payload_json = aws_json_value_new_from_string(dm_handle->allocator, payload_byte_cursor);
-    double error_code = aws_json_get_num_val(payload_json, "Code");
-    if (error_code != 0) {
-        return;
-    }
     struct aws_byte_cursor id_cur = aws_json_get_str_byte_cur_val(payload_json, "ID");
-    struct aws_json_value* data_json = aws_json_get_json_obj(dm_handle->allocator, payload_json, "Data");
-    double version = aws_json_get_num_val(data_json, "Version");
-    struct aws_byte_buf desired_buf = aws_json_get_json_obj_to_bye_buf(dm_handle->allocator, data_json, "Desired");
     shadow_get_data.msg_id = aws_cur_to_char_str(dm_handle->allocator, &id_cur);
     shadow_get_data.version = (int64_t) version;
     shadow_get_data.desired_json_str = (char*) desired_buf.buffer;
@@ -222,8 +360,9 @@ void _tm_recv_shadow_get_reply_handler(const char* topic, const uint8_t *payload
     aws_mem_release(dm_handle->allocator, shadow_get_data.msg_id);
     aws_mem_release(dm_handle->allocator, recv.product_key);
     aws_mem_release(dm_handle->allocator, recv.device_name);
-    aws_mem_release(dm_handle->allocator, payload_json);
-    aws_mem_release(dm_handle->allocator, shadow_get_data.desired_json_str);
+    aws_json_value_destroy(payload_json);
+    aws_byte_buf_clean_up(&desired_buf);
+    aws_array_list_clean_up(&topic_split_data_list);
 
     // business need to send clear msg
     iot_mqtt_ctx_t* mqtt_handler = dm_handle->mqtt_handle;
@@ -248,7 +387,7 @@ void iot_shadow_clear_init_with_id(iot_tm_msg_shadow_clear_post_t** pty, const c
     }
     clearP->id = real_id;
     clearP->version = SDK_VERSION;
-    clearP->shadow_version = (int64_t) get_current_time_mil();
+    clearP->shadow_version = (int64_t) iot_now_ms();
     *pty = clearP;
 }
 
@@ -270,7 +409,7 @@ void* iot_shadow_clear_payload(iot_tm_msg_shadow_clear_post_t* pty){
         char* clear_id = get_random_string_with_time_suffix(aws_alloc());
         aws_json_add_str_val( (struct aws_json_value*) pty->payload_root, "ID", clear_id);
         aws_json_add_str_val( (struct aws_json_value*) pty->payload_root, "Version",SDK_VERSION);
-        aws_json_add_num_val( (struct aws_json_value*) pty->payload_root, "Params", (double)get_current_time_mil());
+        aws_json_add_num_val( (struct aws_json_value*) pty->payload_root, "Params", (double)iot_now_ms());
     }
     return pty->payload_root;
 }
@@ -282,7 +421,7 @@ int32_t _tm_send_shadow_clear(void* handler, const char* topic, const void* msg_
     struct aws_byte_buf payload_buf = aws_json_obj_to_byte_buf(dm_handle->allocator, ((struct aws_json_value*)iot_shadow_clear_payload(msg->data.shadow_clear)));
     struct aws_byte_cursor payload_cur = aws_byte_cursor_from_buf(&payload_buf);
 
-    iot_mqtt_publish(dm_handle->mqtt_handle, topic, (uint8_t *)payload_cur.ptr, payload_cur.len, IOT_MQTT_QOS1);
+    ret = iot_mqtt_publish(dm_handle->mqtt_handle, topic, (uint8_t *)payload_cur.ptr, payload_cur.len, IOT_MQTT_QOS1);
     LOGD(TAG_IOT_MQTT, "_tm_send_shadow_clear call topic = %s,  payload = %.*s", topic,
          AWS_BYTE_CURSOR_PRI(payload_cur));
     aws_byte_buf_clean_up(&payload_buf);
@@ -301,7 +440,15 @@ void _tm_recv_shadow_set_handler(const char* topic, const uint8_t *payload, size
     if (dm_handle == NULL) {
         return;
     }
-    if (NULL == dm_handle->recv_handler) {
+    struct aws_json_value* payload_json = aws_json_value_new_from_string(dm_handle->allocator, payload_byte_cursor);
+//    struct aws_byte_cursor id_cur = aws_json_get_str_byte_cur_val(payload_json, "ID");
+    double version = aws_json_get_num_val(payload_json, "Version");
+    struct aws_byte_buf desired_buf = aws_json_get_json_obj_to_bye_buf(dm_handle->allocator, payload_json, "Desired");
+    // set下发的是变化的字段，合并到缓存
+    if (!_shadow_cache_apply(dm_handle, topic, (int64_t) version, &desired_buf, false) ||
+        NULL == dm_handle->recv_handler) {
+        aws_byte_buf_clean_up(&desired_buf);
+        aws_json_value_destroy(payload_json);
         return;
     }
     iot_tm_recv_t recv;
@@ -322,12 +469,7 @@ void _tm_recv_shadow_set_handler(const char* topic, const uint8_t *payload, size
 
     // package business data
     iot_tm_recv_shadow_set_t shadow_set_data;
-    struct aws_json_value* payload_json = aws_json_value_new_from_string(dm_handle->allocator, payload_byte_cursor);
-//    struct aws_byte_cursor id_cur = aws_json_get_str_byte_cur_val(payload_json, "ID");
-    double version = aws_json_get_num_val(payload_json, "Version");
-    struct aws_json_value* params_json = aws_json_get_json_obj(dm_handle->allocator, payload_json, "Params");
     shadow_set_data.shadow_version = (int64_t) version;
-    struct aws_byte_buf desired_buf = aws_json_get_json_obj_to_bye_buf(dm_handle->allocator, payload_json, "Desired");
     shadow_set_data.desired_json_str = (char*) desired_buf.buffer;
     recv.data.shadow_set = shadow_set_data;
 
@@ -337,8 +479,9 @@ void _tm_recv_shadow_set_handler(const char* topic, const uint8_t *payload, size
     // release
     aws_mem_release(dm_handle->allocator, recv.product_key);
     aws_mem_release(dm_handle->allocator, recv.device_name);
-    aws_mem_release(dm_handle->allocator, payload_json);
-    aws_mem_release(dm_handle->allocator, shadow_set_data.desired_json_str);
+    aws_json_value_destroy(payload_json);
+    aws_byte_buf_clean_up(&desired_buf);
+    aws_array_list_clean_up(&topic_split_data_list);
 
 }
 
@@ -354,6 +497,78 @@ void __send_shadow_clear(void* handle) {
 }
 
 void _tm_recv_shadow_report_reply_handler(const char* topic, const uint8_t *payload, size_t len, void *pUserData) {
-    // TODO: implement me
+    struct aws_byte_cursor topic_byte_cursor = aws_byte_cursor_from_array(topic, strlen(topic));
+    struct aws_byte_cursor payload_byte_cursor = aws_byte_cursor_from_array(payload, len);
+
+    // payload = {"ID":"...","Code":0,"Data":{"Version":3}}，影子上报与清除共用
+    LOGD(TAG_IOT_MQTT, "_tm_recv_shadow_report_reply_handler call topic = %.*s,  payload = %.*s",
+        AWS_BYTE_CURSOR_PRI(topic_byte_cursor),
+        AWS_BYTE_CURSOR_PRI(payload_byte_cursor));
+    iot_tm_handler_t* dm_handle = (iot_tm_handler_t*) pUserData;
+    if (dm_handle == NULL) {
+        return;
+    }
+    _tm_pending_on_reply(dm_handle, payload, len);
+    struct aws_json_value* payload_json = aws_json_value_new_from_string(dm_handle->allocator, payload_byte_cursor);
+    if (payload_json == NULL) {
+        return;
+    }
+    char device[IOT_TM_TOPIC_SCRATCH_SIZE];
+    if (dm_handle->shadow_cache != NULL && _shadow_topic_device(topic, device, sizeof(device))) {
+        // 服务端确认后才记为已上报；清除的回复没有对应的上报，忽略
+        struct aws_byte_cursor reply_id_cur = aws_json_get_str_byte_cur_val(payload_json, "ID");
+        char* reply_id = aws_cur_to_char_str(dm_handle->allocator, &reply_id_cur);
+        struct aws_json_value* code_json = aws_json_value_get_from_object(payload_json,
+                                                                          aws_byte_cursor_from_c_str("Code"));
+        double code = -1;
+        if (code_json != NULL) {
+            aws_json_value_get_number(code_json, &code);
+        }
+        if (reply_id != NULL) {
+            iot_tm_shadow_cache_end_report(dm_handle->shadow_cache, device, reply_id, code == 0);
+            aws_mem_release(dm_handle->allocator, reply_id);
+        }
+    }
+    if (NULL == dm_handle->recv_handler) {
+        aws_json_value_destroy(payload_json);
+        return;
+    }
+    iot_tm_recv_t recv;
+    AWS_ZERO_STRUCT(recv);
+    recv.type = IOT_TM_RECV_SHADOW_REPORT_REPLY;
+
+    struct aws_array_list topic_split_data_list;
+    aws_array_list_init_dynamic(&topic_split_data_list, dm_handle->allocator, 8, sizeof(struct aws_byte_cursor));
+    aws_byte_cursor_split_on_char(&topic_byte_cursor, '/', &topic_split_data_list);
+    struct aws_byte_cursor product_key_cur = {0};
+    aws_array_list_get_at(&topic_split_data_list, &product_key_cur, 1);
+    struct aws_byte_cursor device_name_cur = {0};
+    aws_array_list_get_at(&topic_split_data_list, &device_name_cur, 2);
+    recv.product_key = aws_cur_to_char_str(dm_handle->allocator, &product_key_cur);
+    recv.device_name = aws_cur_to_char_str(dm_handle->allocator, &device_name_cur);
+
+    iot_tm_recv_shadow_post_reply_t reply;
+    AWS_ZERO_STRUCT(reply);
+    struct aws_byte_cursor id_cur = aws_json_get_str_byte_cur_val(payload_json, "ID");
+    reply.msg_id = aws_cur_to_char_str(dm_handle->allocator, &id_cur);
+    struct aws_json_value* data_json = aws_json_value_get_from_object(payload_json, aws_byte_cursor_from_c_str("Data"));
+    struct aws_json_value* version_json = data_json == NULL ? NULL :
+            aws_json_value_get_from_object(data_json, aws_byte_cursor_from_c_str("Version"));
+    double version = 0;
+    if (version_json != NULL) {
+        aws_json_value_get_number(version_json, &version);
+    }
+    reply.version = (int64_t) version;
+    reply.reply_json_str = aws_cur_to_char_str(dm_handle->allocator, &payload_byte_cursor);
+    recv.data.shadow_post_reply = reply;
+
+    dm_handle->recv_handler(dm_handle, &recv, dm_handle->userdata);
+
+    aws_mem_release(dm_handle->allocator, reply.msg_id);
+    aws_mem_release(dm_handle->allocator, reply.reply_json_str);
+    aws_mem_release(dm_handle->allocator, recv.product_key);
+    aws_mem_release(dm_handle->allocator, recv.device_name);
+    aws_json_value_destroy(payload_json);
+    aws_array_list_clean_up(&topic_split_data_list);
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,311 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "onesdk_config.h"
+#ifdef ONESDK_ENABLE_IOT
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "thing_model/tm_coalescer.h"
+#include "error_code.h"
+
+// 从批中取出的待发消息，在锁外发送
+typedef struct {
+    const char *topic;
+    char *params;
+    size_t len;
+    uint32_t members;
+} _coalesce_out_t;
+
+int iot_tm_coalescer_init(iot_tm_coalescer_t *c, iot_tm_coalescer_send_fn send, void *userdata) {
+    if (c == NULL || send == NULL) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    memset(c, 0, sizeof(iot_tm_coalescer_t));
+    c->send = send;
+    c->userdata = userdata;
+    platform_mutex_init(c->mutex);
+    return VOLC_OK;
+}
+
+void iot_tm_coalescer_set_wake(iot_tm_coalescer_t *c, iot_tm_coalescer_wake_fn wake) {
+    if (c == NULL) {
+        return;
+    }
+    platform_mutex_lock(c->mutex);
+    c->wake = wake;
+    platform_mutex_unlock(c->mutex);
+}
+
+void iot_tm_coalescer_deinit(iot_tm_coalescer_t *c) {
+    if (c == NULL || c->send == NULL) {
+        return;
+    }
+    iot_tm_coalescer_flush(c, NULL);
+    for (size_t i = 0; i < c->count; i++) {
+        free(c->batches[i].topic);
+        free(c->batches[i].params);
+        free(c->batches[i].keys);
+    }
+    free(c->batches);
+    platform_mutex_destroy(c->mutex);
+    memset(c, 0, sizeof(iot_tm_coalescer_t));
+}
+
+static iot_tm_coalesce_batch_t *_find_batch(iot_tm_coalescer_t *c, const char *topic) {
+    for (size_t i = 0; i < c->count; i++) {
+        if (strcmp(c->batches[i].topic, topic) == 0) {
+            return &c->batches[i];
+        }
+    }
+    return NULL;
+}
+
+static uint32_t _max_bytes(const iot_tm_coalesce_batch_t *batch) {
+    return batch->policy.max_bytes > 0 ? batch->policy.max_bytes : IOT_TM_COALESCE_DEFAULT_MAX_BYTES;
+}
+
+// 交出当前批的params，批清空
+static void _take(iot_tm_coalescer_t *c, iot_tm_coalesce_batch_t *batch, _coalesce_out_t *out) {
+    if (batch->key_count == 0) {
+        return;
+    }
+    batch->params[batch->len++] = '}';
+    batch->params[batch->len] = '\0';
+    out->topic = batch->topic;
+    out->params = batch->params;
+    out->len = batch->len;
+    out->members = (uint32_t)batch->key_count;
+    c->messages_out++;
+    c->bytes_out += batch->len;
+    batch->params = NULL;
+    batch->len = 0;
+    batch->cap = 0;
+    batch->key_count = 0;
+    batch->deadline_ms = 0;
+}
+
+static void _send_out(iot_tm_coalescer_t *c, _coalesce_out_t *out) {
+    if (out->params == NULL) {
+        return;
+    }
+    c->send(out->topic, out->params, out->len, out->members, c->userdata);
+    free(out->params);
+    out->params = NULL;
+}
+
+static bool _has_key(const iot_tm_coalesce_batch_t *batch, const char *key, size_t key_len) {
+    for (size_t i = 0; i < batch->key_count; i++) {
+        if (batch->keys[i].len == key_len && memcmp(batch->params + batch->keys[i].off, key, key_len) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 追加 "key":value，预留结尾"}"与'\0'
+static int _append(iot_tm_coalesce_batch_t *batch, const char *key, size_t key_len,
+                   const char *value, size_t value_len) {
+    size_t need = batch->len + 1 + key_len + 3 + value_len + 2;
+    if (need > batch->cap) {
+        size_t cap = batch->cap > 0 ? batch->cap : 256;
+        while (cap < need) {
+            cap *= 2;
+        }
+        char *params = (char *)realloc(batch->params, cap);
+        if (params == NULL) {
+            return VOLC_ERR_MALLOC;
+        }
+        batch->params = params;
+        batch->cap = cap;
+    }
+    if (batch->key_count == batch->key_cap) {
+        size_t key_cap = batch->key_cap > 0 ? batch->key_cap * 2 : 16;
+        iot_tm_coalesce_key_t *keys = (iot_tm_coalesce_key_t *)realloc(batch->keys, key_cap * sizeof(iot_tm_coalesce_key_t));
+        if (keys == NULL) {
+            return VOLC_ERR_MALLOC;
+        }
+        batch->keys = keys;
+        batch->key_cap = key_cap;
+    }
+    char *p = batch->params + batch->len;
+    *p++ = batch->key_count == 0 ? '{' : ',';
+    *p++ = '"';
+    batch->keys[batch->key_count].off = (uint32_t)(p - batch->params);
+    batch->keys[batch->key_count].len = (uint32_t)key_len;
+    batch->key_count++;
+    memcpy(p, key, key_len);
+    p += key_len;
+    *p++ = '"';
+    *p++ = ':';
+    memcpy(p, value, value_len);
+    p += value_len;
+    batch->len = (size_t)(p - batch->params);
+    return VOLC_OK;
+}
+
+int iot_tm_coalescer_set_policy(iot_tm_coalescer_t *c, const char *topic, const iot_tm_coalesce_policy_t *policy) {
+    if (c == NULL || topic == NULL || policy == NULL) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    _coalesce_out_t out = {0};
+    platform_mutex_lock(c->mutex);
+    iot_tm_coalesce_batch_t *batch = _find_batch(c, topic);
+    if (batch == NULL) {
+        iot_tm_coalesce_batch_t *batches = (iot_tm_coalesce_batch_t *)realloc(c->batches,
+            (c->count + 1) * sizeof(iot_tm_coalesce_batch_t));
+        if (batches == NULL) {
+            platform_mutex_unlock(c->mutex);
+            return VOLC_ERR_MALLOC;
+        }
+        c->batches = batches;
+        batch = &c->batches[c->count];
+        memset(batch, 0, sizeof(iot_tm_coalesce_batch_t));
+        batch->topic = strdup(topic);
+        if (batch->topic == NULL) {
+            platform_mutex_unlock(c->mutex);
+            return VOLC_ERR_MALLOC;
+        }
+        c->count++;
+    }
+    batch->policy = *policy;
+    if (policy->window_ms == 0) {
+        _take(c, batch, &out);
+    }
+    platform_mutex_unlock(c->mutex);
+    _send_out(c, &out);
+    return VOLC_OK;
+}
+
+bool iot_tm_coalescer_enabled(iot_tm_coalescer_t *c, const char *topic) {
+    if (c == NULL || c->send == NULL || topic == NULL) {
+        return false;
+    }
+    platform_mutex_lock(c->mutex);
+    iot_tm_coalesce_batch_t *batch = _find_batch(c, topic);
+    bool enabled = batch != NULL && batch->policy.window_ms > 0;
+    platform_mutex_unlock(c->mutex);
+    return enabled;
+}
+
+int iot_tm_coalescer_add(iot_tm_coalescer_t *c, const char *topic, const char *key, size_t key_len,
+                         const char *value, size_t value_len, uint64_t now_ms) {
+    if (c == NULL || topic == NULL || key == NULL || value == NULL || value_len == 0) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    // 最多两条待发：同key或超限时先发出的旧批，以及加入后达到上限的新批
+    _coalesce_out_t out[2];
+    int ret = VOLC_OK;
+    iot_tm_coalescer_wake_fn wake = NULL;
+    memset(out, 0, sizeof(out));
+
+    platform_mutex_lock(c->mutex);
+    c->members_in++;
+    iot_tm_coalesce_batch_t *batch = _find_batch(c, topic);
+    if (batch == NULL || batch->policy.window_ms == 0) {
+        // 未开启合并，单个成员直接发出
+        iot_tm_coalesce_batch_t single;
+        memset(&single, 0, sizeof(single));
+        single.topic = (char *)topic;
+        ret = _append(&single, key, key_len, value, value_len);
+        if (ret == VOLC_OK) {
+            _take(c, &single, &out[0]);
+        } else {
+            free(single.params);
+        }
+        free(single.keys);
+    } else {
+        uint32_t max_bytes = _max_bytes(batch);
+        size_t member_len = 1 + key_len + 3 + value_len;
+        if (_has_key(batch, key, key_len) ||
+            (batch->key_count > 0 && batch->len + member_len + 1 > max_bytes)) {
+            _take(c, batch, &out[0]);
+        }
+        ret = _append(batch, key, key_len, value, value_len);
+        if (ret == VOLC_OK) {
+            if (batch->key_count == 1) {
+                batch->deadline_ms = now_ms + batch->policy.window_ms;
+            }
+            if (batch->len + 1 >= max_bytes || now_ms >= batch->deadline_ms) {
+                _take(c, batch, &out[1]);
+            } else if (batch->key_count == 1) {
+                // 批从空变为非空，事件循环可能正无限期等待
+                wake = c->wake;
+            }
+        }
+    }
+    platform_mutex_unlock(c->mutex);
+
+    _send_out(c, &out[0]);
+    _send_out(c, &out[1]);
+    if (wake != NULL) {
+        wake(c->userdata);
+    }
+    return ret;
+}
+
+int iot_tm_coalescer_flush(iot_tm_coalescer_t *c, const char *topic) {
+    if (c == NULL) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    // 逐个取出后在锁外发送
+    for (size_t i = 0; ; i++) {
+        _coalesce_out_t out = {0};
+        platform_mutex_lock(c->mutex);
+        if (i >= c->count) {
+            platform_mutex_unlock(c->mutex);
+            break;
+        }
+        if (topic == NULL || strcmp(c->batches[i].topic, topic) == 0) {
+            _take(c, &c->batches[i], &out);
+        }
+        platform_mutex_unlock(c->mutex);
+        _send_out(c, &out);
+    }
+    return VOLC_OK;
+}
+
+int32_t iot_tm_coalescer_poll(iot_tm_coalescer_t *c, uint64_t now_ms) {
+    if (c == NULL || c->send == NULL) {
+        return -1;
+    }
+    int64_t next = -1;
+    for (size_t i = 0; ; i++) {
+        _coalesce_out_t out = {0};
+        platform_mutex_lock(c->mutex);
+        if (i >= c->count) {
+            platform_mutex_unlock(c->mutex);
+            break;
+        }
+        iot_tm_coalesce_batch_t *batch = &c->batches[i];
+        int64_t wait = -1;
+        // 空批不需要定时，加入首个成员时由wake回调唤醒
+        if (batch->key_count > 0) {
+            if (now_ms >= batch->deadline_ms) {
+                _take(c, batch, &out);
+            } else {
+                wait = (int64_t)(batch->deadline_ms - now_ms);
+            }
+        }
+        if (wait >= 0 && (next < 0 || wait < next)) {
+            next = wait;
+        }
+        platform_mutex_unlock(c->mutex);
+        _send_out(c, &out);
+    }
+    return (int32_t)next;
+}
+
+#endif // ONESDK_ENABLE_IOT
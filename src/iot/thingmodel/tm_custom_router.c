@@ -0,0 +1,304 @@
+/*
+ * Copyright 2022-2024 Beijing Volcano Engine Technology Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "onesdk_config.h"
+#ifdef ONESDK_ENABLE_IOT
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "error_code.h"
+#include "thing_model/tm_custom_router.h"
+#include "aws/common/json.h"
+#include "util/util.h"
+
+#define _ROUTER_MATCH_INLINE 16
+#define _CUSTOM_TOPIC_PREFIX_LEVELS 4   // sys/{pk}/{dn}/custom/
+
+struct iot_tm_custom_sub {
+    iot_tm_custom_router_t *router;
+    uint32_t index;                     // 注册顺序
+    char *pattern;
+};
+
+typedef struct {
+    iot_tm_custom_sub_t *sub;
+    uint32_t seq;                       // 注册顺序，决定调用顺序
+    uint32_t flags;
+    iot_tm_custom_topic_handler_t handler;
+    void *userdata;
+} iot_tm_custom_route_t;
+
+typedef struct {
+    iot_tm_custom_route_t *inline_items[_ROUTER_MATCH_INLINE];
+    iot_tm_custom_route_t **items;
+    size_t count;
+    size_t cap;
+    uint32_t min_sub;                   // 命中的订阅中最早注册的
+    bool oom;
+} _router_match_t;
+
+static void _route_free(void *value, void *userdata) {
+    free(value);
+}
+
+int iot_tm_custom_router_init(iot_tm_custom_router_t *router) {
+    if (router == NULL) {
+        return VOLC_ERR_NULL_POINTER;
+    }
+    memset(router, 0, sizeof(iot_tm_custom_router_t));
+    int ret = iot_mqtt_topic_trie_init(&router->routes);
+    if (ret != VOLC_OK) {
+        return ret;
+    }
+    platform_mutex_init(router->mutex);
+    router->inited = true;
+    return VOLC_OK;
+}
+
+void iot_tm_custom_router_deinit(iot_tm_custom_router_t *router) {
+    if (router == NULL || !router->inited) {
+        return;
+    }
+    iot_mqtt_topic_trie_deinit(&router->routes, _route_free, NULL);
+    for (size_t i = 0; i < router->sub_count; i++) {
+        free(router->subs[i]->pattern);
+        free(router->subs[i]);
+    }
+    free(router->subs);
+    platform_mutex_destroy(router->mutex);
+    memset(router, 0, sizeof(iot_tm_custom_router_t));
+}
+
+static iot_tm_custom_sub_t *_router_new_sub(iot_tm_custom_router_t *router, const char *pattern) {
+    if (router->sub_count == router->sub_cap) {
+        size_t cap = router->sub_cap == 0 ? 8 : router->sub_cap * 2;
+        iot_tm_custom_sub_t **subs = (iot_tm_custom_sub_t **) realloc(router->subs, cap * sizeof(*subs));
+        if (subs == NULL) {
+            return NULL;
+        }
+        router->subs = subs;
+        router->sub_cap = cap;
+    }
+    iot_tm_custom_sub_t *sub = (iot_tm_custom_sub_t *) malloc(sizeof(iot_tm_custom_sub_t));
+    if (sub == NULL) {
+        return NULL;
+    }
+    sub->pattern = strdup(pattern);
+    if (sub->pattern == NULL) {
+        free(sub);
+        return NULL;
+    }
+    sub->router = router;
+    sub->index = (uint32_t) router->sub_count;
+    return sub;
+}
+
+int iot_tm_custom_router_add(iot_tm_custom_router_t *router, const char *suffix_pattern, uint32_t flags,
+                             iot_tm_custom_topic_handler_t handler, void *userdata, iot_tm_custom_sub_t **sub_out) {
+    if (router == NULL || !router->inited || suffix_pattern == NULL || handler == NULL) {
+        return VOLC_ERR_NULL_POINTER;
+    }
+    if (sub_out != NULL) {
+        *sub_out = NULL;
+    }
+    if (!iot_mqtt_topic_filter_valid(suffix_pattern) || suffix_pattern[0] == '$') {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    iot_tm_custom_route_t *route = (iot_tm_custom_route_t *) malloc(sizeof(iot_tm_custom_route_t));
+    if (route == NULL) {
+        return VOLC_ERR_MALLOC;
+    }
+    route->flags = flags;
+    route->handler = handler;
+    route->userdata = userdata;
+
+    int ret = VOLC_OK;
+    iot_tm_custom_sub_t *new_sub = NULL;
+    platform_mutex_lock(router->mutex);
+    iot_tm_custom_route_t *existing = (iot_tm_custom_route_t *) iot_mqtt_topic_trie_find(&router->routes,
+                                                                                         suffix_pattern);
+    if (existing != NULL) {
+        route->sub = existing->sub;
+    } else {
+        new_sub = _router_new_sub(router, suffix_pattern);
+        route->sub = new_sub;
+        ret = new_sub == NULL ? VOLC_ERR_MALLOC : VOLC_OK;
+    }
+    if (ret == VOLC_OK) {
+        route->seq = router->route_count;
+        ret = iot_mqtt_topic_trie_insert(&router->routes, suffix_pattern, route);
+    }
+    if (ret == VOLC_OK) {
+        router->route_count++;
+        if (new_sub != NULL) {
+            router->subs[router->sub_count++] = new_sub;
+        }
+    }
+    platform_mutex_unlock(router->mutex);
+    if (ret != VOLC_OK) {
+        if (new_sub != NULL) {
+            free(new_sub->pattern);
+            free(new_sub);
+        }
+        free(route);
+        return ret;
+    }
+    if (sub_out != NULL) {
+        *sub_out = new_sub;
+    }
+    return VOLC_OK;
+}
+
+void iot_tm_custom_router_remove_sub(iot_tm_custom_router_t *router, iot_tm_custom_sub_t *sub) {
+    if (router == NULL || !router->inited || sub == NULL) {
+        return;
+    }
+    platform_mutex_lock(router->mutex);
+    // 同一过滤器的处理函数共用一个订阅，一并移除
+    iot_tm_custom_route_t *route = NULL;
+    while ((route = (iot_tm_custom_route_t *) iot_mqtt_topic_trie_find(&router->routes, sub->pattern)) != NULL &&
+           route->sub == sub) {
+        iot_mqtt_topic_trie_remove(&router->routes, sub->pattern, route);
+        free(route);
+    }
+    // 订阅序号即下标，只回收最后一个；其余留到deinit释放，不再被匹配
+    if (router->sub_count > 0 && router->subs[router->sub_count - 1] == sub) {
+        router->sub_count--;
+        free(sub->pattern);
+        free(sub);
+    }
+    platform_mutex_unlock(router->mutex);
+}
+
+iot_tm_custom_sub_t *iot_tm_custom_router_find(iot_tm_custom_router_t *router, const char *suffix_pattern) {
+    if (router == NULL || !router->inited || suffix_pattern == NULL) {
+        return NULL;
+    }
+    platform_mutex_lock(router->mutex);
+    iot_tm_custom_route_t *route = (iot_tm_custom_route_t *) iot_mqtt_topic_trie_find(&router->routes,
+                                                                                      suffix_pattern);
+    platform_mutex_unlock(router->mutex);
+    return route == NULL ? NULL : route->sub;
+}
+
+const char *iot_tm_custom_sub_pattern(const iot_tm_custom_sub_t *sub) {
+    return sub == NULL ? NULL : sub->pattern;
+}
+
+static void _router_collect(void *value, void *userdata) {
+    _router_match_t *m = (_router_match_t *) userdata;
+    iot_tm_custom_route_t *route = (iot_tm_custom_route_t *) value;
+    if (m->count == m->cap) {
+        size_t cap = m->cap * 2;
+        iot_tm_custom_route_t **items = (iot_tm_custom_route_t **) malloc(cap * sizeof(*items));
+        if (items == NULL) {
+            m->oom = true;
+            return;
+        }
+        memcpy(items, m->items, m->count * sizeof(*items));
+        if (m->items != m->inline_items) {
+            free(m->items);
+        }
+        m->items = items;
+        m->cap = cap;
+    }
+    m->items[m->count++] = route;
+    if (route->sub->index < m->min_sub) {
+        m->min_sub = route->sub->index;
+    }
+}
+
+size_t iot_tm_custom_router_dispatch(iot_tm_custom_sub_t *sub, const char *topic, size_t topic_len,
+                                     const uint8_t *payload, size_t payload_len) {
+    if (sub == NULL || topic == NULL) {
+        return 0;
+    }
+    iot_tm_custom_router_t *router = sub->router;
+    // 跳过sys/{pk}/{dn}/custom/，直接在原topic上匹配后缀
+    size_t offset = 0;
+    for (int level = 0; level < _CUSTOM_TOPIC_PREFIX_LEVELS; level++) {
+        const char *slash = (const char *) memchr(topic + offset, '/', topic_len - offset);
+        if (slash == NULL) {
+            return 0;
+        }
+        offset = (size_t) (slash - topic) + 1;
+    }
+    iot_tm_custom_topic_msg_t msg = {0};
+    msg.topic = topic;
+    msg.topic_len = topic_len;
+    msg.suffix = topic + offset;
+    msg.suffix_len = topic_len - offset;
+    msg.payload = payload;
+    msg.payload_len = payload_len;
+
+    _router_match_t m;
+    m.items = m.inline_items;
+    m.count = 0;
+    m.cap = _ROUTER_MATCH_INLINE;
+    m.min_sub = UINT32_MAX;
+    m.oom = false;
+    platform_mutex_lock(router->mutex);
+    iot_mqtt_topic_trie_match(&router->routes, msg.suffix, msg.suffix_len, _router_collect, &m);
+    // MQTT层把同一个PUBLISH交给每个匹配的订阅，只由最早注册的那个分发
+    bool owner = m.count > 0 && m.min_sub == sub->index;
+    if (owner) {
+        router->dispatched++;
+    }
+    platform_mutex_unlock(router->mutex);
+
+    size_t called = 0;
+    if (owner) {
+        // 按注册顺序调用，命中数一般很少，插入排序即可
+        bool want_json = false;
+        for (size_t i = 1; i < m.count; i++) {
+            iot_tm_custom_route_t *route = m.items[i];
+            size_t j = i;
+            while (j > 0 && m.items[j - 1]->seq > route->seq) {
+                m.items[j] = m.items[j - 1];
+                j--;
+            }
+            m.items[j] = route;
+        }
+        for (size_t i = 0; i < m.count; i++) {
+            want_json = want_json || (m.items[i]->flags & IOT_TM_CUSTOM_TOPIC_PARSE_JSON) != 0;
+        }
+        struct aws_json_value *json = NULL;
+        if (want_json && payload_len > 0) {
+            json = aws_json_value_new_from_string(aws_alloc(), aws_byte_cursor_from_array(payload, payload_len));
+        }
+        if (want_json && json == NULL) {
+            platform_mutex_lock(router->mutex);
+            router->json_errors++;
+            platform_mutex_unlock(router->mutex);
+        }
+        for (size_t i = 0; i < m.count; i++) {
+            iot_tm_custom_route_t *route = m.items[i];
+            msg.json = (route->flags & IOT_TM_CUSTOM_TOPIC_PARSE_JSON) != 0 ? json : NULL;
+            route->handler(&msg, route->userdata);
+            called++;
+        }
+        if (json != NULL) {
+            aws_json_value_destroy(json);
+        }
+    }
+    if (m.items != m.inline_items) {
+        free(m.items);
+    }
+    return called;
+}
+
+#endif //ONESDK_ENABLE_IOT
@@ -0,0 +1,286 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "onesdk_config.h"
+#ifdef ONESDK_ENABLE_IOT
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aws/common/json.h"
+#include "thing_model/tm_payload.h"
+#include "util/util.h"
+#include "error_code.h"
+
+// FNV-1a，先转小写
+static uint32_t _key_hash(const uint8_t *key, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint32_t)tolower(key[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// 与cJSON_HasObjectItem一致，key比较不区分ASCII大小写
+static bool _key_equal(const uint8_t *a, const uint8_t *b, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (tolower(a[i]) != tolower(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+iot_tm_members_t *iot_tm_members_new(void) {
+    iot_tm_members_t *m = (iot_tm_members_t *)calloc(1, sizeof(iot_tm_members_t));
+    if (m == NULL) {
+        return NULL;
+    }
+    if (aws_byte_buf_init(&m->buf, aws_alloc(), IOT_TM_MEMBERS_INIT_SIZE) != AWS_OP_SUCCESS) {
+        free(m);
+        return NULL;
+    }
+    json_writer_init_members(&m->writer, &m->buf);
+    return m;
+}
+
+void iot_tm_members_destroy(iot_tm_members_t *m) {
+    if (m == NULL) {
+        return;
+    }
+    aws_byte_buf_clean_up(&m->buf);
+    free(m->members);
+    free(m);
+}
+
+void iot_tm_members_reset(iot_tm_members_t *m) {
+    m->buf.len = 0;
+    json_writer_init_members(&m->writer, &m->buf);
+    m->count = 0;
+    m->error = VOLC_OK;
+}
+
+static bool _members_reserve(iot_tm_members_t *m) {
+    if (m->count < m->cap) {
+        return true;
+    }
+    size_t cap = m->cap > 0 ? m->cap * 2 : 16;
+    iot_tm_member_t *members = (iot_tm_member_t *)realloc(m->members, cap * sizeof(iot_tm_member_t));
+    if (members == NULL) {
+        m->error = VOLC_ERR_MALLOC;
+        return false;
+    }
+    m->members = members;
+    m->cap = cap;
+    return true;
+}
+
+// 记录新成员的key，key已存在时返回false
+static bool _members_set_key(iot_tm_members_t *m, uint32_t key_off, uint32_t key_len) {
+    iot_tm_member_t *member = &m->members[m->count];
+    member->key_off = key_off;
+    member->key_len = key_len;
+    member->key_hash = _key_hash(m->buf.buffer + key_off, key_len);
+    for (size_t i = 0; i < m->count; i++) {
+        if (m->members[i].key_hash == member->key_hash && m->members[i].key_len == key_len &&
+            _key_equal(m->buf.buffer + m->members[i].key_off, m->buf.buffer + key_off, key_len)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+json_writer_t *iot_tm_members_begin(iot_tm_members_t *m, const char *key) {
+    if (m == NULL || key == NULL || m->error != VOLC_OK || !_members_reserve(m)) {
+        return NULL;
+    }
+    // 先写入key，与已有成员比较转义后的key，重复时回退
+    json_writer_t saved = m->writer;
+    size_t start = m->buf.len;
+    json_writer_key(&m->writer, key);
+    if (m->writer.error != VOLC_OK) {
+        m->error = m->writer.error;
+        return NULL;
+    }
+    uint32_t key_off = (uint32_t)(start + (m->count > 0 ? 1 : 0) + 1);     // 跳过','与'"'
+    if (!_members_set_key(m, key_off, (uint32_t)(m->buf.len - 2 - key_off))) {  // 去掉'"'与':'
+        m->buf.len = start;
+        m->writer = saved;
+        return NULL;
+    }
+    m->members[m->count].value_off = (uint32_t)m->buf.len;
+    m->pending_off = start;
+    return &m->writer;
+}
+
+int iot_tm_members_add_raw(iot_tm_members_t *m, const char *key, size_t key_len, const char *value, size_t value_len) {
+    if (m == NULL || key == NULL || value == NULL || value_len == 0) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    if (m->error != VOLC_OK || !_members_reserve(m)) {
+        return m->error;
+    }
+    size_t start = m->buf.len;
+    struct aws_byte_cursor sep = aws_byte_cursor_from_c_str(m->count > 0 ? ",\"" : "\"");
+    struct aws_byte_cursor colon = aws_byte_cursor_from_c_str("\":");
+    if (aws_byte_buf_append_dynamic(&m->buf, &sep) != AWS_OP_SUCCESS) {
+        m->error = VOLC_ERR_MALLOC;
+        return m->error;
+    }
+    uint32_t key_off = (uint32_t)m->buf.len;
+    struct aws_byte_cursor key_cur = aws_byte_cursor_from_array(key, key_len);
+    struct aws_byte_cursor value_cur = aws_byte_cursor_from_array(value, value_len);
+    if (aws_byte_buf_append_dynamic(&m->buf, &key_cur) != AWS_OP_SUCCESS ||
+        aws_byte_buf_append_dynamic(&m->buf, &colon) != AWS_OP_SUCCESS) {
+        m->buf.len = start;
+        m->error = VOLC_ERR_MALLOC;
+        return m->error;
+    }
+    if (!_members_set_key(m, key_off, (uint32_t)key_len)) {
+        m->buf.len = start;
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    uint32_t value_off = (uint32_t)m->buf.len;
+    if (aws_byte_buf_append_dynamic(&m->buf, &value_cur) != AWS_OP_SUCCESS) {
+        m->buf.len = start;
+        m->error = VOLC_ERR_MALLOC;
+        return m->error;
+    }
+    m->members[m->count].value_off = value_off;
+    m->members[m->count].value_len = (uint32_t)value_len;
+    m->count++;
+    m->writer.has_elem[0] = true;
+    return VOLC_OK;
+}
+
+void iot_tm_members_end(iot_tm_members_t *m) {
+    if (m->writer.error != VOLC_OK) {
+        m->error = m->writer.error;
+        return;
+    }
+    if (m->writer.depth != 1 || m->writer.after_key) {
+        // value未写完整，丢弃该成员
+        m->buf.len = m->pending_off;
+        json_writer_init_members(&m->writer, &m->buf);
+        m->writer.has_elem[0] = m->count > 0;
+        return;
+    }
+    iot_tm_member_t *member = &m->members[m->count];
+    member->value_len = (uint32_t)(m->buf.len - member->value_off);
+    m->count++;
+}
+
+void iot_tm_members_add_json(iot_tm_members_t *m, const char *key, const struct aws_json_value *value) {
+    if (value == NULL) {
+        return;
+    }
+    json_writer_t *w = iot_tm_members_begin(m, key);
+    if (w == NULL) {
+        return;
+    }
+    iot_tm_json_write_value(w, value);
+    iot_tm_members_end(m);
+}
+
+typedef struct {
+    iot_tm_members_t *m;
+    struct aws_byte_buf key;
+} _members_json_ctx_t;
+
+static int _members_add_json_member(const struct aws_byte_cursor *key, const struct aws_json_value *value,
+                                    bool *out_should_continue, void *user_data) {
+    _members_json_ctx_t *ctx = (_members_json_ctx_t *)user_data;
+    // key需要以'\0'结尾
+    ctx->key.len = 0;
+    if (aws_byte_buf_append_dynamic(&ctx->key, key) != AWS_OP_SUCCESS ||
+        aws_byte_buf_reserve_relative(&ctx->key, 1) != AWS_OP_SUCCESS) {
+        ctx->m->error = VOLC_ERR_MALLOC;
+        *out_should_continue = false;
+        return AWS_OP_SUCCESS;
+    }
+    ctx->key.buffer[ctx->key.len] = '\0';
+    iot_tm_members_add_json(ctx->m, (const char *)ctx->key.buffer, value);
+    *out_should_continue = ctx->m->error == VOLC_OK;
+    return AWS_OP_SUCCESS;
+}
+
+int iot_tm_members_set_json_str(iot_tm_members_t *m, const char *json) {
+    if (m == NULL) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    iot_tm_members_reset(m);
+    if (json == NULL) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    struct aws_json_value *root = aws_json_value_new_from_string(aws_alloc(), aws_byte_cursor_from_c_str(json));
+    if (root == NULL || !aws_json_value_is_object(root)) {
+        aws_json_value_destroy(root);
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    _members_json_ctx_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.m = m;
+    aws_byte_buf_init(&ctx.key, aws_alloc(), 64);
+    aws_json_const_iterate_object(root, _members_add_json_member, &ctx);
+    aws_byte_buf_clean_up(&ctx.key);
+    aws_json_value_destroy(root);
+    return m->error;
+}
+
+void iot_tm_members_write(const iot_tm_members_t *m, json_writer_t *w) {
+    json_writer_members(w, (const char *)m->buf.buffer, m->buf.len);
+}
+
+iot_mqtt_buf_t *iot_tm_payload_begin(json_writer_t *w, struct aws_byte_buf *view, size_t cap) {
+    // 预留结尾'\0'，便于日志按字符串打印
+    iot_mqtt_buf_t *buf = iot_mqtt_buf_new(cap + 1);
+    if (buf == NULL) {
+        return NULL;
+    }
+    *view = aws_byte_buf_from_empty_array(buf->data, cap + 1);
+    json_writer_init(w, view);
+    return buf;
+}
+
+iot_mqtt_buf_t *iot_tm_payload_finish(json_writer_t *w, struct aws_byte_buf *view, iot_mqtt_buf_t *buf) {
+    if (json_writer_finish(w) != VOLC_OK) {
+        iot_mqtt_buf_unref(buf);
+        return NULL;
+    }
+    buf->len = view->len;
+    return buf;
+}
+
+void iot_tm_json_write_value(json_writer_t *w, const struct aws_json_value *value) {
+    struct aws_byte_buf tmp;
+    if (aws_byte_buf_init(&tmp, aws_alloc(), 64) != AWS_OP_SUCCESS) {
+        w->error = VOLC_ERR_MALLOC;
+        return;
+    }
+    if (aws_byte_buf_append_json_string(value, &tmp) != AWS_OP_SUCCESS) {
+        w->error = VOLC_ERR_MALLOC;
+    } else {
+        json_writer_raw(w, (const char *)tmp.buffer, tmp.len);
+    }
+    aws_byte_buf_clean_up(&tmp);
+}
+
+size_t iot_tm_json_str_bound(const char *str) {
+    // 控制字符最长转义为 \u00XX
+    return str != NULL ? strlen(str) * 6 + 2 : 4;
+}
+
+#endif // ONESDK_ENABLE_IOT
@@ -0,0 +1,235 @@
+/*
+ * Copyright 2022-2024 Beijing Volcano Engine Technology Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "onesdk_config.h"
+#ifdef ONESDK_ENABLE_IOT
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "error_code.h"
+#include "thing_model/tm_pending.h"
+#include "util/util.h"
+
+typedef struct {
+    char *msg_id;                       // 同时作为表的key
+    uint64_t deadline_ms;
+    iot_tm_reply_fn cb;
+    void *userdata;
+} iot_tm_pending_entry_t;
+
+typedef struct {
+    iot_tm_pending_entry_t **items;
+    size_t count;
+    size_t cap;
+} _pending_list_t;
+
+static void _pending_entry_free(iot_tm_pending_entry_t *entry) {
+    free(entry->msg_id);
+    free(entry);
+}
+
+static void _pending_list_push(_pending_list_t *list, iot_tm_pending_entry_t *entry) {
+    if (list->count == list->cap) {
+        size_t cap = list->cap == 0 ? 8 : list->cap * 2;
+        iot_tm_pending_entry_t **items = (iot_tm_pending_entry_t **) realloc(list->items, cap * sizeof(*items));
+        if (items == NULL) {
+            // 无法回调时至少不泄漏
+            _pending_entry_free(entry);
+            return;
+        }
+        list->items = items;
+        list->cap = cap;
+    }
+    list->items[list->count++] = entry;
+}
+
+// 在锁外回调并释放
+static void _pending_list_fire(_pending_list_t *list, int32_t code) {
+    for (size_t i = 0; i < list->count; i++) {
+        iot_tm_pending_entry_t *entry = list->items[i];
+        if (entry->cb != NULL) {
+            entry->cb(entry->msg_id, code, NULL, 0, entry->userdata);
+        }
+        _pending_entry_free(entry);
+    }
+    free(list->items);
+}
+
+int iot_tm_pending_init(iot_tm_pending_t *p) {
+    if (p == NULL) {
+        return VOLC_ERR_NULL_POINTER;
+    }
+    memset(p, 0, sizeof(iot_tm_pending_t));
+    if (aws_hash_table_init(&p->entries, aws_alloc(), 16, aws_hash_c_string, aws_hash_callback_c_str_eq,
+                            NULL, NULL) != AWS_OP_SUCCESS) {
+        return VOLC_ERR_MALLOC;
+    }
+    p->next_deadline_ms = UINT64_MAX;
+    platform_mutex_init(p->mutex);
+    p->inited = true;
+    return VOLC_OK;
+}
+
+void iot_tm_pending_deinit(iot_tm_pending_t *p) {
+    if (p == NULL || !p->inited) {
+        return;
+    }
+    _pending_list_t cancelled = {0};
+    platform_mutex_lock(p->mutex);
+    for (struct aws_hash_iter iter = aws_hash_iter_begin(&p->entries); !aws_hash_iter_done(&iter);
+         aws_hash_iter_next(&iter)) {
+        _pending_list_push(&cancelled, (iot_tm_pending_entry_t *) iter.element.value);
+    }
+    aws_hash_table_clear(&p->entries);
+    platform_mutex_unlock(p->mutex);
+    _pending_list_fire(&cancelled, VOLC_ERR_TM_REPLY_CANCELLED);
+
+    aws_hash_table_clean_up(&p->entries);
+    platform_mutex_destroy(p->mutex);
+    memset(p, 0, sizeof(iot_tm_pending_t));
+}
+
+int iot_tm_pending_add(iot_tm_pending_t *p, const char *msg_id, uint64_t deadline_ms,
+                       iot_tm_reply_fn cb, void *userdata) {
+    if (p == NULL || !p->inited || msg_id == NULL) {
+        return VOLC_ERR_NULL_POINTER;
+    }
+    iot_tm_pending_entry_t *entry = (iot_tm_pending_entry_t *) malloc(sizeof(iot_tm_pending_entry_t));
+    if (entry == NULL) {
+        return VOLC_ERR_MALLOC;
+    }
+    entry->msg_id = strdup(msg_id);
+    entry->deadline_ms = deadline_ms;
+    entry->cb = cb;
+    entry->userdata = userdata;
+    if (entry->msg_id == NULL) {
+        free(entry);
+        return VOLC_ERR_MALLOC;
+    }
+
+    int ret = VOLC_OK;
+    platform_mutex_lock(p->mutex);
+    struct aws_hash_element *elem = NULL;
+    aws_hash_table_find(&p->entries, entry->msg_id, &elem);
+    if (elem != NULL) {
+        ret = VOLC_ERR_INVALID_PARAM;
+    } else if (aws_hash_table_put(&p->entries, entry->msg_id, entry, NULL) != AWS_OP_SUCCESS) {
+        ret = VOLC_ERR_MALLOC;
+    } else {
+        p->registered++;
+        if (deadline_ms < p->next_deadline_ms) {
+            p->next_deadline_ms = deadline_ms;
+        }
+    }
+    platform_mutex_unlock(p->mutex);
+    if (ret != VOLC_OK) {
+        _pending_entry_free(entry);
+    }
+    return ret;
+}
+
+static iot_tm_pending_entry_t *_pending_take(iot_tm_pending_t *p, const char *msg_id) {
+    struct aws_hash_element removed = {0};
+    int was_present = 0;
+    aws_hash_table_remove(&p->entries, msg_id, &removed, &was_present);
+    if (!was_present) {
+        return NULL;
+    }
+    if (aws_hash_table_get_entry_count(&p->entries) == 0) {
+        p->next_deadline_ms = UINT64_MAX;
+    }
+    // 移除的若是最早到期的请求，next_deadline_ms偏早，只会让下次poll多遍历一次
+    return (iot_tm_pending_entry_t *) removed.value;
+}
+
+bool iot_tm_pending_complete(iot_tm_pending_t *p, const char *msg_id, int32_t code,
+                             const char *payload, size_t len) {
+    if (p == NULL || !p->inited || msg_id == NULL) {
+        return false;
+    }
+    platform_mutex_lock(p->mutex);
+    iot_tm_pending_entry_t *entry = _pending_take(p, msg_id);
+    if (entry != NULL) {
+        p->completed++;
+    }
+    platform_mutex_unlock(p->mutex);
+    if (entry == NULL) {
+        return false;
+    }
+    if (entry->cb != NULL) {
+        entry->cb(entry->msg_id, code, payload, len, entry->userdata);
+    }
+    _pending_entry_free(entry);
+    return true;
+}
+
+void iot_tm_pending_remove(iot_tm_pending_t *p, const char *msg_id) {
+    if (p == NULL || !p->inited || msg_id == NULL) {
+        return;
+    }
+    platform_mutex_lock(p->mutex);
+    iot_tm_pending_entry_t *entry = _pending_take(p, msg_id);
+    platform_mutex_unlock(p->mutex);
+    if (entry != NULL) {
+        _pending_entry_free(entry);
+    }
+}
+
+int32_t iot_tm_pending_poll(iot_tm_pending_t *p, uint64_t now_ms) {
+    if (p == NULL || !p->inited) {
+        return -1;
+    }
+    _pending_list_t expired = {0};
+    platform_mutex_lock(p->mutex);
+    if (p->next_deadline_ms <= now_ms) {
+        // 取出到期的请求并重新计算最早的到期时间
+        uint64_t next = UINT64_MAX;
+        struct aws_hash_iter iter = aws_hash_iter_begin(&p->entries);
+        while (!aws_hash_iter_done(&iter)) {
+            iot_tm_pending_entry_t *entry = (iot_tm_pending_entry_t *) iter.element.value;
+            if (entry->deadline_ms <= now_ms) {
+                _pending_list_push(&expired, entry);
+                aws_hash_iter_delete(&iter, false);
+            } else if (entry->deadline_ms < next) {
+                next = entry->deadline_ms;
+            }
+            aws_hash_iter_next(&iter);
+        }
+        p->next_deadline_ms = next;
+        p->timeouts += expired.count;
+    }
+    int32_t wait_ms = -1;
+    if (p->next_deadline_ms != UINT64_MAX) {
+        uint64_t delta = p->next_deadline_ms - now_ms;
+        wait_ms = delta > INT32_MAX ? INT32_MAX : (int32_t) delta;
+    }
+    platform_mutex_unlock(p->mutex);
+    _pending_list_fire(&expired, VOLC_ERR_TM_REPLY_TIMEOUT);
+    return wait_ms;
+}
+
+size_t iot_tm_pending_count(iot_tm_pending_t *p) {
+    if (p == NULL || !p->inited) {
+        return 0;
+    }
+    platform_mutex_lock(p->mutex);
+    size_t count = aws_hash_table_get_entry_count(&p->entries);
+    platform_mutex_unlock(p->mutex);
+    return count;
+}
+
+#endif //ONESDK_ENABLE_IOT
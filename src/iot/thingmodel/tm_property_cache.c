@@ -0,0 +1,496 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "onesdk_config.h"
+#ifdef ONESDK_ENABLE_IOT
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "thing_model/tm_property_cache.h"
+#include "error_code.h"
+
+#define PROPERTY_DUE_NEVER UINT64_MAX
+#define PROPERTY_VALUE_PREFIX "{\"value\":"
+#define PROPERTY_TIME_KEY "\"time\":"
+
+int iot_tm_property_cache_init(iot_tm_property_cache_t *c, iot_tm_property_cache_send_fn send, void *userdata) {
+    if (c == NULL || send == NULL) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    memset(c, 0, sizeof(iot_tm_property_cache_t));
+    c->send = send;
+    c->userdata = userdata;
+    platform_mutex_init(c->mutex);
+    return VOLC_OK;
+}
+
+void iot_tm_property_cache_deinit(iot_tm_property_cache_t *c) {
+    if (c == NULL || c->send == NULL) {
+        return;
+    }
+    iot_tm_property_cache_flush(c, c->last_now_ms);
+    for (size_t i = 0; i < c->topic_count; i++) {
+        iot_tm_property_topic_t *t = &c->topics[i];
+        for (size_t j = 0; j < t->count; j++) {
+            free(t->entries[j].key);
+            free(t->entries[j].reported.value);
+            free(t->entries[j].pending.value);
+        }
+        free(t->entries);
+        free(t->topic);
+    }
+    free(c->topics);
+    for (size_t i = 0; i < c->rule_count; i++) {
+        free(c->rules[i].identifier);
+    }
+    free(c->rules);
+    platform_mutex_destroy(c->mutex);
+    memset(c, 0, sizeof(iot_tm_property_cache_t));
+}
+
+static iot_tm_property_rule_t *_find_rule(iot_tm_property_cache_t *c, const char *identifier) {
+    for (size_t i = 0; i < c->rule_count; i++) {
+        const char *id = c->rules[i].identifier;
+        if ((id == NULL && identifier == NULL) || (id != NULL && identifier != NULL && strcmp(id, identifier) == 0)) {
+            return &c->rules[i];
+        }
+    }
+    return NULL;
+}
+
+// 属性的策略，没有单独设置时使用默认策略，都没有时返回NULL
+static const iot_tm_property_policy_t *_policy_of(iot_tm_property_cache_t *c, const char *key, size_t key_len) {
+    const iot_tm_property_policy_t *fallback = NULL;
+    for (size_t i = 0; i < c->rule_count; i++) {
+        const char *id = c->rules[i].identifier;
+        if (id == NULL) {
+            fallback = &c->rules[i].policy;
+        } else if (strlen(id) == key_len && memcmp(id, key, key_len) == 0) {
+            return &c->rules[i].policy;
+        }
+    }
+    return fallback;
+}
+
+int iot_tm_property_cache_set_policy(iot_tm_property_cache_t *c, const char *identifier,
+                                     const iot_tm_property_policy_t *policy) {
+    if (c == NULL || c->send == NULL) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    int ret = VOLC_OK;
+    platform_mutex_lock(c->mutex);
+    iot_tm_property_rule_t *rule = _find_rule(c, identifier);
+    if (policy == NULL) {
+        // 已暂存的值在下次poll时上报
+        if (rule != NULL) {
+            free(rule->identifier);
+            size_t index = (size_t)(rule - c->rules);
+            memmove(rule, rule + 1, (c->rule_count - index - 1) * sizeof(iot_tm_property_rule_t));
+            c->rule_count--;
+        }
+    } else if (rule != NULL) {
+        rule->policy = *policy;
+    } else {
+        iot_tm_property_rule_t *rules = (iot_tm_property_rule_t *)realloc(c->rules,
+            (c->rule_count + 1) * sizeof(iot_tm_property_rule_t));
+        char *id = identifier != NULL ? strdup(identifier) : NULL;
+        if (rules != NULL) {
+            c->rules = rules;
+        }
+        if (rules == NULL || (identifier != NULL && id == NULL)) {
+            free(id);
+            ret = VOLC_ERR_MALLOC;
+        } else {
+            c->rules[c->rule_count].identifier = id;
+            c->rules[c->rule_count].policy = *policy;
+            c->rule_count++;
+        }
+    }
+    platform_mutex_unlock(c->mutex);
+    return ret;
+}
+
+bool iot_tm_property_cache_enabled(iot_tm_property_cache_t *c) {
+    if (c == NULL || c->send == NULL) {
+        return false;
+    }
+    platform_mutex_lock(c->mutex);
+    bool enabled = c->rule_count > 0;
+    platform_mutex_unlock(c->mutex);
+    return enabled;
+}
+
+/**
+ * 拆出属性上报成员 {"value":v,"time":t} 中的v与t，没有value时为 {"time":t}
+ * time总是最后一个成员，从后向前找，value本身含time字段时也不会错位
+ */
+static bool _parse_member(const char *s, size_t len, const char **value, size_t *value_len, int64_t *time) {
+    const size_t time_key_len = sizeof(PROPERTY_TIME_KEY) - 1;
+    const size_t prefix_len = sizeof(PROPERTY_VALUE_PREFIX) - 1;
+    if (len < 2 || s[0] != '{' || s[len - 1] != '}') {
+        return false;
+    }
+    size_t end = len - 1;
+    size_t p = end;
+    while (p > 0 && (isdigit((unsigned char)s[p - 1]) || s[p - 1] == '-')) {
+        p--;
+    }
+    if (p == end || end - p >= 24 || p < 1 + time_key_len ||
+        memcmp(s + p - time_key_len, PROPERTY_TIME_KEY, time_key_len) != 0) {
+        return false;
+    }
+    char digits[24];
+    memcpy(digits, s + p, end - p);
+    digits[end - p] = '\0';
+    *time = strtoll(digits, NULL, 10);
+
+    size_t time_key = p - time_key_len;
+    if (time_key == 1) {
+        *value = NULL;
+        *value_len = 0;
+        return true;
+    }
+    if (s[time_key - 1] != ',' || time_key - 1 <= prefix_len || memcmp(s, PROPERTY_VALUE_PREFIX, prefix_len) != 0) {
+        return false;
+    }
+    *value = s + prefix_len;
+    *value_len = time_key - 1 - prefix_len;
+    return true;
+}
+
+static int _sample_set(iot_tm_property_sample_t *sample, const char *value, size_t len, int64_t time, uint64_t now_ms) {
+    if (len + 1 > sample->cap) {
+        char *buf = (char *)realloc(sample->value, len + 1);
+        if (buf == NULL) {
+            return VOLC_ERR_MALLOC;
+        }
+        sample->value = buf;
+        sample->cap = len + 1;
+    }
+    if (len > 0) {
+        memcpy(sample->value, value, len);
+    }
+    sample->value[len] = '\0';
+    sample->len = len;
+    sample->time = time;
+    sample->mono_ms = now_ms;
+    sample->is_num = false;
+    if (len > 0 && (value[0] == '-' || isdigit((unsigned char)value[0]))) {
+        char *num_end = NULL;
+        sample->num = strtod(sample->value, &num_end);
+        sample->is_num = num_end == sample->value + len;
+    }
+    return VOLC_OK;
+}
+
+static bool _sample_equal(const iot_tm_property_sample_t *sample, const char *value, size_t len) {
+    return sample->len == len && (len == 0 || memcmp(sample->value, value, len) == 0);
+}
+
+static bool _significant(const iot_tm_property_sample_t *reported, const iot_tm_property_sample_t *sample,
+                         const iot_tm_property_policy_t *policy) {
+    if (!reported->is_num || !sample->is_num) {
+        return true;
+    }
+    double delta = fabs(sample->num - reported->num);
+    if (delta <= policy->deadband_abs) {
+        return false;
+    }
+    if (policy->deadband_pct > 0 && delta <= fabs(reported->num) * policy->deadband_pct / 100) {
+        return false;
+    }
+    return true;
+}
+
+// 属性下次需要上报的时间
+static uint64_t _entry_due(const iot_tm_property_entry_t *e, const iot_tm_property_policy_t *policy) {
+    if (!e->has_reported || policy == NULL) {
+        return e->dirty ? 0 : PROPERTY_DUE_NEVER;
+    }
+    uint64_t due = PROPERTY_DUE_NEVER;
+    if (e->dirty) {
+        if (e->significant) {
+            due = e->last_report_ms;
+        } else if (policy->max_interval_ms > 0) {
+            due = e->last_report_ms + policy->max_interval_ms;
+        }
+    }
+    if (policy->heartbeat_ms > 0 && e->last_report_ms + policy->heartbeat_ms < due) {
+        due = e->last_report_ms + policy->heartbeat_ms;
+    }
+    if (due != PROPERTY_DUE_NEVER && due < e->last_report_ms + policy->min_interval_ms) {
+        due = e->last_report_ms + policy->min_interval_ms;
+    }
+    return due;
+}
+
+// 已有消息要发时，过了最短间隔的暂存属性一并上报，不额外增加消息
+static bool _entry_eligible(const iot_tm_property_entry_t *e, const iot_tm_property_policy_t *policy, uint64_t now_ms) {
+    return e->dirty && (!e->has_reported || policy == NULL || now_ms >= e->last_report_ms + policy->min_interval_ms);
+}
+
+static iot_tm_property_topic_t *_find_topic(iot_tm_property_cache_t *c, const char *topic) {
+    for (size_t i = 0; i < c->topic_count; i++) {
+        if (strcmp(c->topics[i].topic, topic) == 0) {
+            return &c->topics[i];
+        }
+    }
+    iot_tm_property_topic_t *topics = (iot_tm_property_topic_t *)realloc(c->topics,
+        (c->topic_count + 1) * sizeof(iot_tm_property_topic_t));
+    if (topics == NULL) {
+        return NULL;
+    }
+    c->topics = topics;
+    iot_tm_property_topic_t *t = &c->topics[c->topic_count];
+    memset(t, 0, sizeof(iot_tm_property_topic_t));
+    t->topic = strdup(topic);
+    if (t->topic == NULL) {
+        return NULL;
+    }
+    c->topic_count++;
+    return t;
+}
+
+static iot_tm_property_entry_t *_find_entry(iot_tm_property_topic_t *t, const char *key, size_t key_len) {
+    for (size_t i = 0; i < t->count; i++) {
+        if (t->entries[i].key_len == key_len && memcmp(t->entries[i].key, key, key_len) == 0) {
+            return &t->entries[i];
+        }
+    }
+    if (t->count == t->cap) {
+        size_t cap = t->cap > 0 ? t->cap * 2 : 16;
+        iot_tm_property_entry_t *entries = (iot_tm_property_entry_t *)realloc(t->entries,
+            cap * sizeof(iot_tm_property_entry_t));
+        if (entries == NULL) {
+            return NULL;
+        }
+        t->entries = entries;
+        t->cap = cap;
+    }
+    iot_tm_property_entry_t *e = &t->entries[t->count];
+    memset(e, 0, sizeof(iot_tm_property_entry_t));
+    e->key = (char *)malloc(key_len + 1);
+    if (e->key == NULL) {
+        return NULL;
+    }
+    memcpy(e->key, key, key_len);
+    e->key[key_len] = '\0';
+    e->key_len = key_len;
+    t->count++;
+    return e;
+}
+
+static int _update(iot_tm_property_cache_t *c, iot_tm_property_topic_t *t, const char *key, size_t key_len,
+                   const iot_tm_property_policy_t *policy, const char *value, size_t value_len,
+                   int64_t time, uint64_t now_ms) {
+    iot_tm_property_entry_t *e = _find_entry(t, key, key_len);
+    if (e == NULL) {
+        return VOLC_ERR_MALLOC;
+    }
+    c->samples_in++;
+    if (e->has_reported && _sample_equal(&e->reported, value, value_len)) {
+        // 回到上次上报的值，暂存的变化不再需要上报
+        e->dirty = false;
+        return VOLC_OK;
+    }
+    int ret = _sample_set(&e->pending, value, value_len, time, now_ms);
+    if (ret != VOLC_OK) {
+        return ret;
+    }
+    if (!e->dirty) {
+        e->dirty_since_ms = now_ms;
+        e->dirty = true;
+    }
+    e->significant = !e->has_reported || _significant(&e->reported, &e->pending, policy);
+    return VOLC_OK;
+}
+
+static int _out_add(iot_tm_members_t **out, const char *key, size_t key_len, const char *value, size_t value_len) {
+    if (*out == NULL) {
+        *out = iot_tm_members_new();
+        if (*out == NULL) {
+            return VOLC_ERR_MALLOC;
+        }
+    }
+    return iot_tm_members_add_raw(*out, key, key_len, value, value_len);
+}
+
+// 上报一个属性：有暂存值时上报暂存值，否则为心跳，重发上次的值并按单调时钟推算time
+static int _emit(iot_tm_property_cache_t *c, iot_tm_property_entry_t *e, uint64_t now_ms, iot_tm_members_t **out) {
+    iot_tm_property_sample_t *sample = e->dirty ? &e->pending : &e->reported;
+    int64_t time = e->dirty ? sample->time : sample->time + (int64_t)(now_ms - sample->mono_ms);
+    size_t cap = sample->len + sizeof(PROPERTY_VALUE_PREFIX) + sizeof(PROPERTY_TIME_KEY) + 24;
+    char *member = (char *)malloc(cap);
+    if (member == NULL) {
+        return VOLC_ERR_MALLOC;
+    }
+    int len = sample->len > 0 ?
+        snprintf(member, cap, PROPERTY_VALUE_PREFIX "%s," PROPERTY_TIME_KEY "%lld}", sample->value, (long long)time) :
+        snprintf(member, cap, "{" PROPERTY_TIME_KEY "%lld}", (long long)time);
+    int ret = _out_add(out, e->key, e->key_len, member, (size_t)len);
+    free(member);
+    if (ret != VOLC_OK) {
+        return ret;
+    }
+    if (e->dirty) {
+        if (now_ms - e->dirty_since_ms > c->max_staleness_ms) {
+            c->max_staleness_ms = now_ms - e->dirty_since_ms;
+        }
+        iot_tm_property_sample_t reported = e->reported;
+        e->reported = e->pending;
+        e->pending = reported;
+        e->dirty = false;
+    } else {
+        e->reported.time = time;
+        e->reported.mono_ms = now_ms;
+    }
+    e->has_reported = true;
+    e->last_report_ms = now_ms;
+    c->members_out++;
+    return VOLC_OK;
+}
+
+/**
+ * 取出topic需要上报的属性写入out
+ * 有到期的属性、out中已有直接上报的属性或flush_all时，到期属性与可以上报的暂存属性一起写入
+ */
+static int _take(iot_tm_property_cache_t *c, iot_tm_property_topic_t *t, uint64_t now_ms,
+                 iot_tm_members_t **out, bool flush_all) {
+    bool send = *out != NULL && (*out)->count > 0;
+    for (size_t i = 0; i < t->count && !send; i++) {
+        iot_tm_property_entry_t *e = &t->entries[i];
+        send = (flush_all && e->dirty) || _entry_due(e, _policy_of(c, e->key, e->key_len)) <= now_ms;
+    }
+    if (!send) {
+        return VOLC_OK;
+    }
+    for (size_t i = 0; i < t->count; i++) {
+        iot_tm_property_entry_t *e = &t->entries[i];
+        const iot_tm_property_policy_t *policy = _policy_of(c, e->key, e->key_len);
+        if ((flush_all && e->dirty) || _entry_due(e, policy) <= now_ms || _entry_eligible(e, policy, now_ms)) {
+            int ret = _emit(c, e, now_ms, out);
+            if (ret != VOLC_OK) {
+                return ret;
+            }
+        }
+    }
+    return VOLC_OK;
+}
+
+static int _send_out(iot_tm_property_cache_t *c, const char *topic, iot_tm_members_t *out) {
+    if (out == NULL) {
+        return VOLC_OK;
+    }
+    int ret = out->count > 0 ? c->send(topic, out, c->userdata) : VOLC_OK;
+    iot_tm_members_destroy(out);
+    return ret;
+}
+
+int iot_tm_property_cache_post(iot_tm_property_cache_t *c, const char *topic, const iot_tm_members_t *params,
+                               uint64_t now_ms) {
+    if (c == NULL || c->send == NULL || topic == NULL || params == NULL) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    if (params->error != VOLC_OK) {
+        return params->error;
+    }
+    iot_tm_members_t *out = NULL;
+    int ret = VOLC_OK;
+    platform_mutex_lock(c->mutex);
+    c->last_now_ms = now_ms;
+    iot_tm_property_topic_t *t = _find_topic(c, topic);
+    if (t == NULL) {
+        ret = VOLC_ERR_MALLOC;
+    }
+    const char *base = (const char *)params->buf.buffer;
+    for (size_t i = 0; i < params->count && ret == VOLC_OK; i++) {
+        const iot_tm_member_t *member = &params->members[i];
+        const char *key = base + member->key_off;
+        const char *value = NULL;
+        size_t value_len = 0;
+        int64_t time = 0;
+        const iot_tm_property_policy_t *policy = _policy_of(c, key, member->key_len);
+        if (policy == NULL || !_parse_member(base + member->value_off, member->value_len, &value, &value_len, &time)) {
+            ret = _out_add(&out, key, member->key_len, base + member->value_off, member->value_len);
+            c->members_out++;
+            continue;
+        }
+        ret = _update(c, t, key, member->key_len, policy, value, value_len, time, now_ms);
+    }
+    if (ret == VOLC_OK) {
+        ret = _take(c, t, now_ms, &out, false);
+    }
+    if (out != NULL && out->count > 0) {
+        c->messages_out++;
+    }
+    platform_mutex_unlock(c->mutex);
+
+    int send_ret = _send_out(c, topic, out);
+    return ret != VOLC_OK ? ret : send_ret;
+}
+
+// 逐个topic取出后在锁外发送，flush_all为false时只发到期的，返回距下次到期的毫秒数
+static int32_t _poll(iot_tm_property_cache_t *c, uint64_t now_ms, bool flush_all) {
+    int64_t next = -1;
+    for (size_t i = 0; ; i++) {
+        iot_tm_members_t *out = NULL;
+        platform_mutex_lock(c->mutex);
+        if (i >= c->topic_count) {
+            platform_mutex_unlock(c->mutex);
+            break;
+        }
+        c->last_now_ms = now_ms;
+        iot_tm_property_topic_t *t = &c->topics[i];
+        const char *topic = t->topic;
+        _take(c, t, now_ms, &out, flush_all);
+        if (out != NULL && out->count > 0) {
+            c->messages_out++;
+        }
+        for (size_t j = 0; j < t->count; j++) {
+            iot_tm_property_entry_t *e = &t->entries[j];
+            uint64_t due = _entry_due(e, _policy_of(c, e->key, e->key_len));
+            if (due == PROPERTY_DUE_NEVER) {
+                continue;
+            }
+            int64_t wait = due > now_ms ? (int64_t)(due - now_ms) : 0;
+            if (next < 0 || wait < next) {
+                next = wait;
+            }
+        }
+        platform_mutex_unlock(c->mutex);
+        _send_out(c, topic, out);
+    }
+    return next > INT32_MAX ? INT32_MAX : (int32_t)next;
+}
+
+int iot_tm_property_cache_flush(iot_tm_property_cache_t *c, uint64_t now_ms) {
+    if (c == NULL || c->send == NULL) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    _poll(c, now_ms, true);
+    return VOLC_OK;
+}
+
+int32_t iot_tm_property_cache_poll(iot_tm_property_cache_t *c, uint64_t now_ms) {
+    if (c == NULL || c->send == NULL) {
+        return -1;
+    }
+    return _poll(c, now_ms, false);
+}
+
+#endif // ONESDK_ENABLE_IOT
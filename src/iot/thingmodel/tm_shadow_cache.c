@@ -0,0 +1,488 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "onesdk_config.h"
+#ifdef ONESDK_ENABLE_IOT
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "aws/common/json.h"
+#include "iot/iot_kv.h"
+#include "thing_model/tm_shadow_cache.h"
+#include "util/util.h"
+#include "error_code.h"
+
+int iot_tm_shadow_cache_init(iot_tm_shadow_cache_t *c, struct iot_kv_ctx *kv) {
+    if (c == NULL) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    memset(c, 0, sizeof(iot_tm_shadow_cache_t));
+    c->kv = kv;
+    platform_mutex_init(c->mutex);
+    return VOLC_OK;
+}
+
+static void _fields_clean(iot_tm_shadow_fields_t *fields) {
+    for (size_t i = 0; i < fields->count; i++) {
+        free(fields->fields[i].key);
+        free(fields->fields[i].value);
+    }
+    fields->count = 0;
+}
+
+static void _pending_free(iot_tm_shadow_pending_report_t *pending) {
+    _fields_clean(&pending->fields);
+    free(pending->fields.fields);
+    free(pending->id);
+}
+
+// 移除第index个等待回复的上报，之后的前移
+static void _pending_remove(iot_tm_shadow_doc_t *doc, size_t index) {
+    _pending_free(&doc->pending[index]);
+    memmove(&doc->pending[index], &doc->pending[index + 1],
+            (doc->pending_count - index - 1) * sizeof(iot_tm_shadow_pending_report_t));
+    doc->pending_count--;
+}
+
+void iot_tm_shadow_cache_deinit(iot_tm_shadow_cache_t *c) {
+    if (c == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < c->count; i++) {
+        iot_tm_shadow_doc_t *doc = c->docs[i];
+        _fields_clean(&doc->desired);
+        _fields_clean(&doc->reported);
+        free(doc->desired.fields);
+        free(doc->reported.fields);
+        for (size_t j = 0; j < doc->pending_count; j++) {
+            _pending_free(&doc->pending[j]);
+        }
+        free(doc->device);
+        free(doc);
+    }
+    free(c->docs);
+    platform_mutex_destroy(c->mutex);
+    memset(c, 0, sizeof(iot_tm_shadow_cache_t));
+}
+
+static iot_tm_shadow_field_t *_field_find(iot_tm_shadow_fields_t *fields, const char *key, size_t key_len) {
+    for (size_t i = 0; i < fields->count; i++) {
+        if (fields->fields[i].key_len == key_len && memcmp(fields->fields[i].key, key, key_len) == 0) {
+            return &fields->fields[i];
+        }
+    }
+    return NULL;
+}
+
+static char *_dup(const char *s, size_t len) {
+    char *p = (char *)malloc(len + 1);
+    if (p != NULL) {
+        memcpy(p, s, len);
+        p[len] = '\0';
+    }
+    return p;
+}
+
+// @return 1 值有变化，0 与原值相同，内存不足返回VOLC_ERR_MALLOC
+static int _field_set(iot_tm_shadow_fields_t *fields, const char *key, size_t key_len,
+                      const char *value, size_t value_len) {
+    iot_tm_shadow_field_t *field = _field_find(fields, key, key_len);
+    if (field != NULL && field->value_len == value_len && memcmp(field->value, value, value_len) == 0) {
+        return 0;
+    }
+    char *copy = _dup(value, value_len);
+    if (copy == NULL) {
+        return VOLC_ERR_MALLOC;
+    }
+    if (field == NULL) {
+        if (fields->count == fields->cap) {
+            size_t cap = fields->cap > 0 ? fields->cap * 2 : 8;
+            iot_tm_shadow_field_t *grown = (iot_tm_shadow_field_t *)realloc(fields->fields,
+                cap * sizeof(iot_tm_shadow_field_t));
+            if (grown == NULL) {
+                free(copy);
+                return VOLC_ERR_MALLOC;
+            }
+            fields->fields = grown;
+            fields->cap = cap;
+        }
+        field = &fields->fields[fields->count];
+        field->key = _dup(key, key_len);
+        if (field->key == NULL) {
+            free(copy);
+            return VOLC_ERR_MALLOC;
+        }
+        field->key_len = key_len;
+        field->value = NULL;
+        fields->count++;
+    }
+    free(field->value);
+    field->value = copy;
+    field->value_len = value_len;
+    return 1;
+}
+
+static void _field_remove(iot_tm_shadow_fields_t *fields, const char *key, size_t key_len) {
+    iot_tm_shadow_field_t *field = _field_find(fields, key, key_len);
+    if (field == NULL) {
+        return;
+    }
+    free(field->key);
+    free(field->value);
+    size_t index = (size_t)(field - fields->fields);
+    memmove(field, field + 1, (fields->count - index - 1) * sizeof(iot_tm_shadow_field_t));
+    fields->count--;
+}
+
+// 字段作为JSON对象写入w
+static void _fields_write(const iot_tm_shadow_fields_t *fields, json_writer_t *w) {
+    struct aws_byte_buf members;
+    if (aws_byte_buf_init(&members, aws_alloc(), 256) != AWS_OP_SUCCESS) {
+        w->error = VOLC_ERR_MALLOC;
+        return;
+    }
+    for (size_t i = 0; i < fields->count; i++) {
+        const iot_tm_shadow_field_t *field = &fields->fields[i];
+        struct aws_byte_cursor sep = aws_byte_cursor_from_c_str(i > 0 ? ",\"" : "\"");
+        struct aws_byte_cursor key = aws_byte_cursor_from_array(field->key, field->key_len);
+        struct aws_byte_cursor colon = aws_byte_cursor_from_c_str("\":");
+        struct aws_byte_cursor value = aws_byte_cursor_from_array(field->value, field->value_len);
+        if (aws_byte_buf_append_dynamic(&members, &sep) != AWS_OP_SUCCESS ||
+            aws_byte_buf_append_dynamic(&members, &key) != AWS_OP_SUCCESS ||
+            aws_byte_buf_append_dynamic(&members, &colon) != AWS_OP_SUCCESS ||
+            aws_byte_buf_append_dynamic(&members, &value) != AWS_OP_SUCCESS) {
+            w->error = VOLC_ERR_MALLOC;
+            break;
+        }
+    }
+    json_writer_members(w, (const char *)members.buffer, members.len);
+    aws_byte_buf_clean_up(&members);
+}
+
+typedef struct {
+    iot_tm_shadow_fields_t *fields;
+    struct aws_byte_buf key;
+    struct aws_byte_buf escaped;
+    struct aws_byte_buf value;
+    int ret;
+} _fields_json_ctx_t;
+
+// JSON对象的成员逐个写入字段，值为null时删除该字段
+static int _fields_add_json_member(const struct aws_byte_cursor *key, const struct aws_json_value *value,
+                                   bool *out_should_continue, void *user_data) {
+    _fields_json_ctx_t *ctx = (_fields_json_ctx_t *)user_data;
+    // cJSON解析出的key是转义前的内容，转义后与上报中的key一致
+    ctx->key.len = 0;
+    ctx->escaped.len = 0;
+    ctx->value.len = 0;
+    json_writer_t w;
+    json_writer_init(&w, &ctx->escaped);
+    if (aws_byte_buf_append_dynamic(&ctx->key, key) != AWS_OP_SUCCESS ||
+        aws_byte_buf_reserve_relative(&ctx->key, 1) != AWS_OP_SUCCESS) {
+        ctx->ret = VOLC_ERR_MALLOC;
+        *out_should_continue = false;
+        return AWS_OP_SUCCESS;
+    }
+    ctx->key.buffer[ctx->key.len] = '\0';
+    json_writer_string(&w, (const char *)ctx->key.buffer);
+    if (json_writer_finish(&w) != VOLC_OK) {
+        ctx->ret = VOLC_ERR_MALLOC;
+        *out_should_continue = false;
+        return AWS_OP_SUCCESS;
+    }
+    const char *escaped = (const char *)ctx->escaped.buffer + 1;
+    size_t escaped_len = ctx->escaped.len - 2;
+    if (aws_json_value_is_null(value)) {
+        _field_remove(ctx->fields, escaped, escaped_len);
+    } else if (aws_byte_buf_append_json_string(value, &ctx->value) != AWS_OP_SUCCESS) {
+        ctx->ret = VOLC_ERR_MALLOC;
+    } else {
+        int ret = _field_set(ctx->fields, escaped, escaped_len, (const char *)ctx->value.buffer, ctx->value.len);
+        if (ret < 0) {
+            ctx->ret = ret;
+        }
+    }
+    *out_should_continue = ctx->ret == VOLC_OK;
+    return AWS_OP_SUCCESS;
+}
+
+static int _fields_merge_json(iot_tm_shadow_fields_t *fields, const struct aws_json_value *object) {
+    _fields_json_ctx_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.fields = fields;
+    aws_byte_buf_init(&ctx.key, aws_alloc(), 64);
+    aws_byte_buf_init(&ctx.escaped, aws_alloc(), 64);
+    aws_byte_buf_init(&ctx.value, aws_alloc(), 64);
+    aws_json_const_iterate_object(object, _fields_add_json_member, &ctx);
+    aws_byte_buf_clean_up(&ctx.key);
+    aws_byte_buf_clean_up(&ctx.escaped);
+    aws_byte_buf_clean_up(&ctx.value);
+    return ctx.ret;
+}
+
+static char *_kv_key(const iot_tm_shadow_doc_t *doc) {
+    size_t prefix_len = strlen(IOT_TM_SHADOW_KV_PREFIX);
+    size_t device_len = strlen(doc->device);
+    char *key = (char *)malloc(prefix_len + device_len + 1);
+    if (key != NULL) {
+        memcpy(key, IOT_TM_SHADOW_KV_PREFIX, prefix_len);
+        memcpy(key + prefix_len, doc->device, device_len + 1);
+    }
+    return key;
+}
+
+// 保存为 {"version":1,"desired":{...},"reported":{...}}
+static void _save(iot_tm_shadow_cache_t *c, const iot_tm_shadow_doc_t *doc) {
+    if (c->kv == NULL) {
+        return;
+    }
+    char *key = _kv_key(doc);
+    struct aws_byte_buf buf;
+    if (key == NULL || aws_byte_buf_init(&buf, aws_alloc(), 256) != AWS_OP_SUCCESS) {
+        free(key);
+        return;
+    }
+    json_writer_t w;
+    json_writer_init(&w, &buf);
+    json_writer_begin_object(&w);
+    if (doc->has_version) {
+        json_writer_kv_int(&w, "version", doc->version);
+    }
+    json_writer_key(&w, "desired");
+    _fields_write(&doc->desired, &w);
+    json_writer_key(&w, "reported");
+    _fields_write(&doc->reported, &w);
+    json_writer_end_object(&w);
+    if (json_writer_finish(&w) == VOLC_OK) {
+        iot_add_kv_str(c->kv, key, (char *)buf.buffer);
+    }
+    aws_byte_buf_clean_up(&buf);
+    free(key);
+}
+
+static void _load(iot_tm_shadow_cache_t *c, iot_tm_shadow_doc_t *doc) {
+    char *key = _kv_key(doc);
+    if (key == NULL) {
+        return;
+    }
+    char *saved = NULL;
+    iot_get_kv_str(c->kv, key, &saved);
+    free(key);
+    if (saved == NULL) {
+        return;
+    }
+    struct aws_json_value *root = aws_json_value_new_from_string(aws_alloc(), aws_byte_cursor_from_c_str(saved));
+    aws_mem_release(aws_alloc(), saved);
+    if (root == NULL) {
+        return;
+    }
+    double version = 0;
+    struct aws_json_value *version_json = aws_json_value_get_from_object(root, aws_byte_cursor_from_c_str("version"));
+    if (version_json != NULL && aws_json_value_get_number(version_json, &version) == AWS_OP_SUCCESS) {
+        doc->version = (int64_t)version;
+        doc->has_version = true;
+        doc->version_restored = true;
+    }
+    struct aws_json_value *desired = aws_json_value_get_from_object(root, aws_byte_cursor_from_c_str("desired"));
+    if (desired != NULL && aws_json_value_is_object(desired)) {
+        _fields_merge_json(&doc->desired, desired);
+    }
+    struct aws_json_value *reported = aws_json_value_get_from_object(root, aws_byte_cursor_from_c_str("reported"));
+    if (reported != NULL && aws_json_value_is_object(reported)) {
+        _fields_merge_json(&doc->reported, reported);
+    }
+    aws_json_value_destroy(root);
+}
+
+// 设备的影子文档，首次使用时创建并从kv恢复
+static iot_tm_shadow_doc_t *_doc(iot_tm_shadow_cache_t *c, const char *device) {
+    for (size_t i = 0; i < c->count; i++) {
+        if (strcmp(c->docs[i]->device, device) == 0) {
+            return c->docs[i];
+        }
+    }
+    iot_tm_shadow_doc_t **docs = (iot_tm_shadow_doc_t **)realloc(c->docs, (c->count + 1) * sizeof(iot_tm_shadow_doc_t *));
+    if (docs == NULL) {
+        return NULL;
+    }
+    c->docs = docs;
+    iot_tm_shadow_doc_t *doc = (iot_tm_shadow_doc_t *)calloc(1, sizeof(iot_tm_shadow_doc_t));
+    if (doc == NULL) {
+        return NULL;
+    }
+    doc->device = strdup(device);
+    if (doc->device == NULL) {
+        free(doc);
+        return NULL;
+    }
+    if (c->kv != NULL) {
+        _load(c, doc);
+    }
+    c->docs[c->count++] = doc;
+    return doc;
+}
+
+int iot_tm_shadow_cache_apply_desired(iot_tm_shadow_cache_t *c, const char *device, int64_t version,
+                                      const char *desired, size_t len, bool replace) {
+    if (c == NULL || device == NULL) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    struct aws_json_value *root = NULL;
+    if (desired != NULL && len > 0) {
+        root = aws_json_value_new_from_string(aws_alloc(), aws_byte_cursor_from_array(desired, len));
+        if (root == NULL || !aws_json_value_is_object(root)) {
+            aws_json_value_destroy(root);
+            return VOLC_ERR_INVALID_PARAM;
+        }
+    }
+    int ret = VOLC_OK;
+    platform_mutex_lock(c->mutex);
+    iot_tm_shadow_doc_t *doc = _doc(c, device);
+    if (doc == NULL) {
+        ret = VOLC_ERR_MALLOC;
+    } else if (doc->has_version && !doc->version_restored && version <= doc->version) {
+        // 乱序到达的旧版本或重复的消息
+        ret = VOLC_ERR_TM_SHADOW_STALE_VERSION;
+    } else {
+        // 从kv恢复的版本可能已被服务端重置，以服务端下发的为准
+        doc->version_restored = false;
+        if (replace) {
+            _fields_clean(&doc->desired);
+        }
+        if (root != NULL) {
+            ret = _fields_merge_json(&doc->desired, root);
+        }
+        doc->version = version;
+        doc->has_version = true;
+        _save(c, doc);
+    }
+    platform_mutex_unlock(c->mutex);
+    aws_json_value_destroy(root);
+    return ret;
+}
+
+int iot_tm_shadow_cache_diff_reported(iot_tm_shadow_cache_t *c, const char *device, const char *id,
+                                      const iot_tm_members_t *report, iot_tm_members_t *delta) {
+    if (c == NULL || device == NULL || id == NULL || report == NULL || delta == NULL) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    if (report->error != VOLC_OK) {
+        return report->error;
+    }
+    int ret = VOLC_OK;
+    int added = 0;
+    const char *base = (const char *)report->buf.buffer;
+    iot_tm_shadow_pending_report_t pending;
+    memset(&pending, 0, sizeof(pending));
+    platform_mutex_lock(c->mutex);
+    iot_tm_shadow_doc_t *doc = _doc(c, device);
+    if (doc == NULL) {
+        ret = VOLC_ERR_MALLOC;
+    }
+    for (size_t i = 0; i < report->count && ret == VOLC_OK; i++) {
+        const iot_tm_member_t *member = &report->members[i];
+        const char *key = base + member->key_off;
+        const char *value = base + member->value_off;
+        iot_tm_shadow_field_t *field = _field_find(&doc->reported, key, member->key_len);
+        if (field != NULL && field->value_len == member->value_len && memcmp(field->value, value, member->value_len) == 0) {
+            continue;
+        }
+        ret = _field_set(&pending.fields, key, member->key_len, value, member->value_len);
+        if (ret == 1) {
+            ret = iot_tm_members_add_raw(delta, key, member->key_len, value, member->value_len);
+            added++;
+        } else if (ret == 0) {
+            ret = VOLC_OK;
+        }
+    }
+    if (ret == VOLC_OK && added > 0) {
+        pending.id = strdup(id);
+        ret = pending.id == NULL ? VOLC_ERR_MALLOC : VOLC_OK;
+    }
+    if (ret == VOLC_OK && added > 0) {
+        if (doc->pending_count == IOT_TM_SHADOW_MAX_PENDING_REPORTS) {
+            // 最早的上报一直没有回复，放弃后其字段仍与已确认的值不同，下次重新上报
+            _pending_remove(doc, 0);
+        }
+        doc->pending[doc->pending_count++] = pending;
+    } else {
+        _pending_free(&pending);
+    }
+    platform_mutex_unlock(c->mutex);
+    return ret != VOLC_OK ? ret : added;
+}
+
+void iot_tm_shadow_cache_end_report(iot_tm_shadow_cache_t *c, const char *device, const char *id, bool accepted) {
+    if (c == NULL || device == NULL || id == NULL) {
+        return;
+    }
+    platform_mutex_lock(c->mutex);
+    iot_tm_shadow_doc_t *doc = _doc(c, device);
+    for (size_t i = 0; doc != NULL && i < doc->pending_count; i++) {
+        iot_tm_shadow_pending_report_t *pending = &doc->pending[i];
+        if (strcmp(pending->id, id) != 0) {
+            continue;
+        }
+        if (accepted) {
+            bool changed = false;
+            for (size_t j = 0; j < pending->fields.count; j++) {
+                const iot_tm_shadow_field_t *field = &pending->fields.fields[j];
+                changed = _field_set(&doc->reported, field->key, field->key_len, field->value, field->value_len) == 1 ||
+                          changed;
+            }
+            if (changed) {
+                _save(c, doc);
+            }
+        }
+        _pending_remove(doc, i);
+        break;
+    }
+    platform_mutex_unlock(c->mutex);
+}
+
+int iot_tm_shadow_cache_get_desired(iot_tm_shadow_cache_t *c, const char *device, char **desired_json,
+                                    int64_t *version) {
+    if (c == NULL || device == NULL || desired_json == NULL) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    *desired_json = NULL;
+    struct aws_byte_buf buf;
+    if (aws_byte_buf_init(&buf, aws_alloc(), 256) != AWS_OP_SUCCESS) {
+        return VOLC_ERR_MALLOC;
+    }
+    int ret = VOLC_OK;
+    platform_mutex_lock(c->mutex);
+    iot_tm_shadow_doc_t *doc = _doc(c, device);
+    if (doc == NULL || !doc->has_version) {
+        ret = doc == NULL ? VOLC_ERR_MALLOC : VOLC_ERR_INVALID_PARAM;
+    } else {
+        json_writer_t w;
+        json_writer_init(&w, &buf);
+        _fields_write(&doc->desired, &w);
+        ret = json_writer_finish(&w);
+        if (version != NULL) {
+            *version = doc->version;
+        }
+    }
+    platform_mutex_unlock(c->mutex);
+    if (ret == VOLC_OK) {
+        *desired_json = _dup((const char *)buf.buffer, buf.len);
+        ret = *desired_json != NULL ? VOLC_OK : VOLC_ERR_MALLOC;
+    }
+    aws_byte_buf_clean_up(&buf);
+    return ret;
+}
+
+#endif // ONESDK_ENABLE_IOT
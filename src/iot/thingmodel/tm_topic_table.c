@@ -0,0 +1,121 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "onesdk_config.h"
+#ifdef ONESDK_ENABLE_IOT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "thing_model/tm_topic_table.h"
+#include "error_code.h"
+
+// 只含product_key与device_name两个参数的格式串可以预先格式化
+static int _is_static_fmt(const char *fmt) {
+    int params = 0;
+    for (const char *p = fmt; (p = strchr(p, '%')) != NULL; p += 2) {
+        if (p[1] != 's') {
+            return 0;
+        }
+        params++;
+    }
+    return params == 2;
+}
+
+int iot_tm_topic_table_build(iot_tm_topic_table_t *table, const char *const *fmts, size_t count,
+                             const char *product_key, const char *device_name) {
+    if (table == NULL || fmts == NULL || product_key == NULL || device_name == NULL) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    memset(table, 0, sizeof(iot_tm_topic_table_t));
+    size_t pk_len = strlen(product_key);
+    size_t dn_len = strlen(device_name);
+    // 格式串中的两个"%s"各占2字节，替换后长度为 strlen(fmt) - 4 + pk_len + dn_len
+    size_t total = pk_len + 1 + dn_len + 1;
+    for (size_t i = 0; i < count; i++) {
+        if (fmts[i] != NULL && _is_static_fmt(fmts[i])) {
+            total += strlen(fmts[i]) - 4 + pk_len + dn_len + 1;
+        }
+    }
+    table->strings = (char *)malloc(total);
+    table->offsets = (uint32_t *)malloc(count * sizeof(uint32_t));
+    if (table->strings == NULL || table->offsets == NULL) {
+        iot_tm_topic_table_free(table);
+        return VOLC_ERR_MALLOC;
+    }
+
+    char *p = table->strings;
+    memcpy(p, product_key, pk_len + 1);
+    table->product_key = p;
+    p += pk_len + 1;
+    memcpy(p, device_name, dn_len + 1);
+    table->device_name = p;
+    p += dn_len + 1;
+    for (size_t i = 0; i < count; i++) {
+        if (fmts[i] == NULL || !_is_static_fmt(fmts[i])) {
+            table->offsets[i] = IOT_TM_TOPIC_PARAMETRISED;
+            continue;
+        }
+        table->offsets[i] = (uint32_t)(p - table->strings);
+        int n = snprintf(p, total - (size_t)(p - table->strings), fmts[i], product_key, device_name);
+        p += n + 1;
+    }
+    table->count = count;
+    return VOLC_OK;
+}
+
+void iot_tm_topic_table_free(iot_tm_topic_table_t *table) {
+    if (table == NULL) {
+        return;
+    }
+    free(table->strings);
+    free(table->offsets);
+    memset(table, 0, sizeof(iot_tm_topic_table_t));
+}
+
+const char *iot_tm_topic_table_get(const iot_tm_topic_table_t *table, size_t index) {
+    if (table == NULL || index >= table->count || table->offsets[index] == IOT_TM_TOPIC_PARAMETRISED) {
+        return NULL;
+    }
+    return table->strings + table->offsets[index];
+}
+
+const char *iot_tm_topic_format(char *scratch, size_t cap, char **heap, const char *fmt,
+                                const char *product_key, const char *device_name,
+                                const char *p1, const char *p2, const char *p3) {
+    *heap = NULL;
+    if (fmt == NULL) {
+        return NULL;
+    }
+    // 多余的参数不会被格式串使用
+    p1 = p1 != NULL ? p1 : "";
+    p2 = p2 != NULL ? p2 : "";
+    p3 = p3 != NULL ? p3 : "";
+    int n = snprintf(scratch, cap, fmt, product_key, device_name, p1, p2, p3);
+    if (n < 0) {
+        return NULL;
+    }
+    if ((size_t)n < cap) {
+        return scratch;
+    }
+    *heap = (char *)malloc((size_t)n + 1);
+    if (*heap == NULL) {
+        return NULL;
+    }
+    snprintf(*heap, (size_t)n + 1, fmt, product_key, device_name, p1, p2, p3);
+    return *heap;
+}
+
+#endif // ONESDK_ENABLE_IOT
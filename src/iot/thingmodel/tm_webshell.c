@@ -0,0 +1,624 @@
+/*
+ * Copyright 2022-2024 Beijing Volcano Engine Technology Ltd.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "onesdk_config.h"
+#ifdef ONESDK_ENABLE_IOT
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "error_code.h"
+#include "thing_model/tm_webshell.h"
+
+#if defined(__linux__) || defined(__APPLE__)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <util.h>
+#else
+#include <pty.h>
+#endif
+
+#define _WEBSHELL_DENIED_MSG "\r\nwebshell: command not allowed\r\n"
+#define _WEBSHELL_TERM_ENV "TERM=xterm"
+
+extern char **environ;
+
+typedef struct iot_webshell_session {
+    char uid[IOT_WEBSHELL_UID_MAX];
+    int master_fd;
+    pid_t pid;
+    uint32_t seq;
+    uint8_t *buf;                       // 尚未发出的输出
+    size_t buf_len;
+    uint8_t *in_buf;                    // 终端输入缓冲满时尚未写入的输入，由poll继续写入
+    size_t in_len;
+    bool eof;                           // 终端已关闭，输出读完
+    bool exited;
+    int32_t exit_code;
+    bool terminating;                   // 已发出结束信号
+    iot_webshell_exit_reason_t reason;
+    uint64_t created_ms;
+    uint64_t last_active_ms;            // 最近一次输入或输出
+    uint64_t last_chunk_ms;
+    uint64_t term_ms;                   // 发出SIGHUP的时间
+    uint64_t exit_ms;
+    bool chunk_sent;
+    char line[IOT_WEBSHELL_LINE_MAX];   // 白名单模式下正在输入的行
+    size_t line_len;
+    bool line_overflow;
+} iot_webshell_session_t;
+
+static iot_webshell_session_t *_ws_find(iot_webshell_t *ws, const char *uid, size_t *index) {
+    for (size_t i = 0; i < ws->config.max_sessions; i++) {
+        iot_webshell_session_t *s = ws->sessions[i];
+        if (s != NULL && strcmp(s->uid, uid) == 0) {
+            if (index != NULL) {
+                *index = i;
+            }
+            return s;
+        }
+    }
+    return NULL;
+}
+
+static void _ws_session_free(iot_webshell_session_t *s) {
+    if (s->master_fd >= 0) {
+        close(s->master_fd);
+    }
+    free(s->buf);
+    free(s->in_buf);
+    free(s);
+}
+
+static void _ws_signal(iot_webshell_session_t *s, int sig) {
+    // 交互式shell把前台命令放在单独的进程组，shell与前台命令所在的进程组都要结束
+    pid_t foreground = tcgetpgrp(s->master_fd);
+    if (foreground > 0 && foreground != s->pid) {
+        kill(-foreground, sig);
+    }
+    if (kill(-s->pid, sig) != 0) {
+        kill(s->pid, sig);
+    }
+}
+
+static iot_webshell_session_t *_ws_spawn(iot_webshell_t *ws, const char *uid, uint64_t now_ms, int *err) {
+    size_t slot = ws->config.max_sessions;
+    for (size_t i = 0; i < ws->config.max_sessions; i++) {
+        if (ws->sessions[i] == NULL) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot == ws->config.max_sessions) {
+        *err = VOLC_ERR_TM_WEBSHELL_SESSION_LIMIT;
+        return NULL;
+    }
+    iot_webshell_session_t *s = (iot_webshell_session_t *) calloc(1, sizeof(iot_webshell_session_t));
+    if (s == NULL) {
+        *err = VOLC_ERR_MALLOC;
+        return NULL;
+    }
+    s->master_fd = -1;
+    s->buf = (uint8_t *) malloc(ws->config.max_buffer_bytes);
+    s->in_buf = (uint8_t *) malloc(ws->config.max_buffer_bytes);
+    // 子进程的环境在fork前准备好，fork后只调用async-signal-safe的函数
+    size_t env_count = 0;
+    while (environ != NULL && environ[env_count] != NULL) {
+        env_count++;
+    }
+    char **envp = (char **) malloc((env_count + 2) * sizeof(char *));
+    if (s->buf == NULL || s->in_buf == NULL || envp == NULL) {
+        free(envp);
+        _ws_session_free(s);
+        *err = VOLC_ERR_MALLOC;
+        return NULL;
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < env_count; i++) {
+        if (strncmp(environ[i], "TERM=", 5) != 0) {
+            envp[n++] = environ[i];
+        }
+    }
+    envp[n++] = (char *) _WEBSHELL_TERM_ENV;
+    envp[n] = NULL;
+    char *const argv[] = {(char *) ws->config.shell, NULL};
+    strncpy(s->uid, uid, sizeof(s->uid) - 1);
+
+    struct winsize size = {0};
+    size.ws_row = 24;
+    size.ws_col = 80;
+    int master_fd = -1;
+    pid_t pid = forkpty(&master_fd, NULL, NULL, &size);
+    if (pid == 0) {
+        // 子进程：forkpty已建立新会话并把终端接到标准输入输出
+        if (ws->config.restrict_child != NULL && ws->config.restrict_child(ws->config.userdata) != 0) {
+            _exit(126);
+        }
+        execve(ws->config.shell, argv, envp);
+        _exit(127);
+    }
+    free(envp);
+    if (pid < 0) {
+        _ws_session_free(s);
+        *err = VOLC_ERR_INIT;
+        return NULL;
+    }
+    fcntl(master_fd, F_SETFL, fcntl(master_fd, F_GETFL) | O_NONBLOCK);
+    fcntl(master_fd, F_SETFD, FD_CLOEXEC);
+    s->master_fd = master_fd;
+    s->pid = pid;
+    s->created_ms = now_ms;
+    s->last_active_ms = now_ms;
+    ws->sessions[slot] = s;
+    return s;
+}
+
+static void _ws_append_output(iot_webshell_t *ws, iot_webshell_session_t *s, const char *data, size_t len) {
+    size_t room = ws->config.max_buffer_bytes - s->buf_len;
+    if (len > room) {
+        len = room;
+    }
+    memcpy(s->buf + s->buf_len, data, len);
+    s->buf_len += len;
+}
+
+// 非阻塞写入终端，返回写入的字节数，终端输入缓冲已满时返回0
+static ssize_t _ws_write_some(iot_webshell_session_t *s, const uint8_t *data, size_t len) {
+    size_t written = 0;
+    while (written < len) {
+        ssize_t n = write(s->master_fd, data + written, len - written);
+        if (n > 0) {
+            written += (size_t) n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && errno == EAGAIN) {
+            break;
+        } else {
+            return -1;
+        }
+    }
+    return (ssize_t) written;
+}
+
+// 写入已排队的输入，由poll在终端可写时调用
+static int _ws_flush_input(iot_webshell_session_t *s) {
+    if (s->in_len == 0) {
+        return VOLC_OK;
+    }
+    ssize_t n = _ws_write_some(s, s->in_buf, s->in_len);
+    if (n < 0) {
+        return VOLC_ERR_SEND;
+    }
+    memmove(s->in_buf, s->in_buf + n, s->in_len - (size_t) n);
+    s->in_len -= (size_t) n;
+    return VOLC_OK;
+}
+
+// 写入终端输入，不阻塞：终端写不下的部分排队，由poll继续写入；排队也放不下时丢弃剩余部分，返回错误
+static int _ws_write(iot_webshell_t *ws, iot_webshell_session_t *s, const uint8_t *data, size_t len) {
+    if (_ws_flush_input(s) != VOLC_OK) {
+        return VOLC_ERR_SEND;
+    }
+    if (len == 0) {
+        return VOLC_OK;
+    }
+    size_t written = 0;
+    if (s->in_len == 0) {
+        ssize_t n = _ws_write_some(s, data, len);
+        if (n < 0) {
+            return VOLC_ERR_SEND;
+        }
+        written = (size_t) n;
+    }
+    size_t rest = len - written;
+    if (rest > ws->config.max_buffer_bytes - s->in_len) {
+        // 子进程长时间不读取输入，丢弃超出的部分由服务端重发
+        ws->input_dropped += rest;
+        return VOLC_ERR_TM_WEBSHELL_INPUT_FULL;
+    }
+    memcpy(s->in_buf + s->in_len, data + written, rest);
+    s->in_len += rest;
+    return VOLC_OK;
+}
+
+// 只检查argv[0]；参数原样交给shell，其中的通配符与引号照常展开
+static bool _ws_line_allowed(iot_webshell_t *ws, const char *line, size_t len) {
+    // 终端行规程与shell把控制字符当作编辑键（^U删行、^W删词、^V转义、ESC、Tab补全），转发后实际执行的行与检查的不同
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = (uint8_t) line[i];
+        if (c < 0x20 || c == 0x7f || strchr(";|&`$<>(){}\\", c) != NULL) {
+            return false;
+        }
+    }
+    size_t start = 0;
+    while (start < len && line[start] == ' ') {
+        start++;
+    }
+    if (start == len) {
+        // 空行只是换行
+        return true;
+    }
+    size_t end = start;
+    while (end < len && line[end] != ' ') {
+        end++;
+    }
+    for (const char *const *cmd = ws->config.allowed_commands; *cmd != NULL; cmd++) {
+        if (strlen(*cmd) == end - start && strncmp(*cmd, line + start, end - start) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 白名单模式：退格在本地编辑，Ctrl-C与Ctrl-D直接转发，其余控制字符留在行内使该行被拒绝
+static int _ws_input_filtered(iot_webshell_t *ws, iot_webshell_session_t *s, const uint8_t *data, size_t len) {
+    int ret = VOLC_OK;
+    for (size_t i = 0; i < len && ret == VOLC_OK; i++) {
+        uint8_t c = data[i];
+        if (c == '\r' || c == '\n') {
+            if (!s->line_overflow && _ws_line_allowed(ws, s->line, s->line_len)) {
+                s->line[s->line_len] = '\n';
+                ret = _ws_write(ws, s, (const uint8_t *) s->line, s->line_len + 1);
+            } else {
+                ws->denied++;
+                _ws_append_output(ws, s, _WEBSHELL_DENIED_MSG, strlen(_WEBSHELL_DENIED_MSG));
+            }
+            s->line_len = 0;
+            s->line_overflow = false;
+        } else if (c == 0x7f || c == '\b') {
+            if (s->line_len > 0) {
+                s->line_len--;
+            }
+        } else if (c == 0x03 || c == 0x04) {
+            // Ctrl-C丢弃当前行，Ctrl-D在空行时结束shell
+            s->line_len = 0;
+            s->line_overflow = false;
+            ret = _ws_write(ws, s, &c, 1);
+        } else if (s->line_len + 1 < sizeof(s->line)) {
+            s->line[s->line_len++] = (char) c;
+        } else {
+            s->line_overflow = true;
+        }
+    }
+    return ret;
+}
+
+int iot_webshell_init(iot_webshell_t *ws, const iot_webshell_config_t *config,
+                      iot_webshell_send_fn send, void *userdata) {
+    if (ws == NULL || send == NULL) {
+        return VOLC_ERR_NULL_POINTER;
+    }
+    memset(ws, 0, sizeof(iot_webshell_t));
+    if (config != NULL) {
+        ws->config = *config;
+    }
+    if (ws->config.shell == NULL) {
+        ws->config.shell = "/bin/sh";
+    }
+    if (ws->config.idle_timeout_ms == 0) {
+        ws->config.idle_timeout_ms = IOT_WEBSHELL_DEFAULT_IDLE_TIMEOUT_MS;
+    }
+    if (ws->config.chunk_bytes == 0) {
+        ws->config.chunk_bytes = IOT_WEBSHELL_DEFAULT_CHUNK_BYTES;
+    }
+    if (ws->config.chunk_interval_ms == 0) {
+        ws->config.chunk_interval_ms = IOT_WEBSHELL_DEFAULT_CHUNK_INTERVAL_MS;
+    }
+    if (ws->config.max_sessions == 0) {
+        ws->config.max_sessions = IOT_WEBSHELL_DEFAULT_MAX_SESSIONS;
+    }
+    if (ws->config.max_buffer_bytes == 0) {
+        ws->config.max_buffer_bytes = IOT_WEBSHELL_DEFAULT_MAX_BUFFER_BYTES;
+    }
+    if (ws->config.max_buffer_bytes < ws->config.chunk_bytes) {
+        ws->config.max_buffer_bytes = ws->config.chunk_bytes;
+    }
+    ws->sessions = (iot_webshell_session_t **) calloc(ws->config.max_sessions, sizeof(iot_webshell_session_t *));
+    if (ws->sessions == NULL) {
+        return VOLC_ERR_MALLOC;
+    }
+    ws->send = send;
+    ws->send_userdata = userdata;
+    platform_mutex_init(ws->mutex);
+    ws->inited = true;
+    return VOLC_OK;
+}
+
+void iot_webshell_deinit(iot_webshell_t *ws) {
+    if (ws == NULL || !ws->inited) {
+        return;
+    }
+    platform_mutex_lock(ws->mutex);
+    for (size_t i = 0; i < ws->config.max_sessions; i++) {
+        iot_webshell_session_t *s = ws->sessions[i];
+        if (s == NULL) {
+            continue;
+        }
+        if (!s->exited) {
+            _ws_signal(s, SIGKILL);
+            waitpid(s->pid, NULL, 0);
+        }
+        _ws_session_free(s);
+    }
+    platform_mutex_unlock(ws->mutex);
+    free(ws->sessions);
+    platform_mutex_destroy(ws->mutex);
+    memset(ws, 0, sizeof(iot_webshell_t));
+}
+
+int iot_webshell_input(iot_webshell_t *ws, const char *uid, const uint8_t *data, size_t len, uint64_t now_ms) {
+    if (ws == NULL || !ws->inited || uid == NULL || (data == NULL && len > 0)) {
+        return VOLC_ERR_NULL_POINTER;
+    }
+    if (uid[0] == '\0' || strlen(uid) >= IOT_WEBSHELL_UID_MAX) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    int ret = VOLC_OK;
+    platform_mutex_lock(ws->mutex);
+    iot_webshell_session_t *s = _ws_find(ws, uid, NULL);
+    if (s == NULL) {
+        s = _ws_spawn(ws, uid, now_ms, &ret);
+    } else if (s->terminating || s->exited) {
+        ret = VOLC_ERR_INVALID_PARAM;
+    }
+    if (ret == VOLC_OK) {
+        s->last_active_ms = now_ms;
+        if (ws->config.allowed_commands != NULL) {
+            ret = _ws_input_filtered(ws, s, data, len);
+        } else {
+            ret = _ws_write(ws, s, data, len);
+        }
+    }
+    platform_mutex_unlock(ws->mutex);
+    return ret;
+}
+
+int iot_webshell_resize(iot_webshell_t *ws, const char *uid, uint16_t rows, uint16_t columns) {
+    if (ws == NULL || !ws->inited || uid == NULL) {
+        return VOLC_ERR_NULL_POINTER;
+    }
+    if (rows == 0 || columns == 0) {
+        return VOLC_ERR_INVALID_PARAM;
+    }
+    int ret = VOLC_ERR_INVALID_PARAM;
+    platform_mutex_lock(ws->mutex);
+    iot_webshell_session_t *s = _ws_find(ws, uid, NULL);
+    if (s != NULL) {
+        struct winsize size = {0};
+        size.ws_row = rows;
+        size.ws_col = columns;
+        // 终端会向前台进程组发SIGWINCH
+        ret = ioctl(s->master_fd, TIOCSWINSZ, &size) == 0 ? VOLC_OK : VOLC_ERR_INVALID_PARAM;
+    }
+    platform_mutex_unlock(ws->mutex);
+    return ret;
+}
+
+int iot_webshell_kill(iot_webshell_t *ws, const char *uid) {
+    if (ws == NULL || !ws->inited || uid == NULL) {
+        return VOLC_ERR_NULL_POINTER;
+    }
+    int ret = VOLC_ERR_INVALID_PARAM;
+    platform_mutex_lock(ws->mutex);
+    iot_webshell_session_t *s = _ws_find(ws, uid, NULL);
+    if (s != NULL) {
+        if (!s->exited) {
+            _ws_signal(s, SIGKILL);
+        }
+        if (!s->terminating) {
+            s->terminating = true;
+            s->reason = IOT_WEBSHELL_EXIT_KILLED;
+        }
+        ret = VOLC_OK;
+    }
+    platform_mutex_unlock(ws->mutex);
+    return ret;
+}
+
+static void _ws_read(iot_webshell_t *ws, iot_webshell_session_t *s, uint64_t now_ms) {
+    // 暂存满时不再读取，终端缓冲随之填满，子进程的写入被阻塞
+    while (!s->eof && s->buf_len < ws->config.max_buffer_bytes) {
+        ssize_t n = read(s->master_fd, s->buf + s->buf_len, ws->config.max_buffer_bytes - s->buf_len);
+        if (n > 0) {
+            s->buf_len += (size_t) n;
+            s->last_active_ms = now_ms;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && errno == EAGAIN) {
+            break;
+        } else {
+            // Linux上子进程一侧全部关闭后返回EIO
+            s->eof = true;
+        }
+    }
+}
+
+static void _ws_reap(iot_webshell_session_t *s, uint64_t now_ms) {
+    int status = 0;
+    if (s->exited || waitpid(s->pid, &status, WNOHANG) != s->pid) {
+        return;
+    }
+    s->exited = true;
+    s->exit_ms = now_ms;
+    if (WIFEXITED(status)) {
+        s->exit_code = WEXITSTATUS(status);
+    } else if (WIFSIGNALED(status)) {
+        s->exit_code = 128 + WTERMSIG(status);
+    }
+}
+
+static void _ws_check_timeout(iot_webshell_t *ws, iot_webshell_session_t *s, uint64_t now_ms) {
+    if (s->exited) {
+        return;
+    }
+    if (!s->terminating) {
+        bool idle = now_ms - s->last_active_ms >= ws->config.idle_timeout_ms;
+        bool expired = ws->config.max_lifetime_ms != 0 && now_ms - s->created_ms >= ws->config.max_lifetime_ms;
+        if (idle || expired) {
+            s->terminating = true;
+            s->reason = IOT_WEBSHELL_EXIT_TIMEOUT;
+            s->term_ms = now_ms;
+            _ws_signal(s, SIGHUP);
+        }
+    } else if (s->reason == IOT_WEBSHELL_EXIT_TIMEOUT && now_ms - s->term_ms >= IOT_WEBSHELL_KILL_GRACE_MS) {
+        _ws_signal(s, SIGKILL);
+    }
+}
+
+static void _ws_send_chunk(iot_webshell_t *ws, iot_webshell_session_t *s, uint64_t now_ms) {
+    if (s->buf_len == 0 || (s->chunk_sent && now_ms - s->last_chunk_ms < ws->config.chunk_interval_ms)) {
+        return;
+    }
+    iot_webshell_frame_t frame = {0};
+    frame.type = IOT_WEBSHELL_FRAME_OUTPUT;
+    frame.uid = s->uid;
+    frame.seq = s->seq;
+    frame.data = s->buf;
+    frame.len = s->buf_len < ws->config.chunk_bytes ? s->buf_len : ws->config.chunk_bytes;
+    if (ws->send(&frame, ws->send_userdata) != VOLC_OK) {
+        return;
+    }
+    memmove(s->buf, s->buf + frame.len, s->buf_len - frame.len);
+    s->buf_len -= frame.len;
+    s->seq++;
+    s->chunk_sent = true;
+    s->last_chunk_ms = now_ms;
+    ws->frames++;
+}
+
+// 输出发完后发出退出帧，返回true时会话可以释放
+static bool _ws_finish(iot_webshell_t *ws, iot_webshell_session_t *s, uint64_t now_ms) {
+    if (!s->exited || s->buf_len > 0) {
+        return false;
+    }
+    // 后台进程仍持有终端时收不到EOF，退出后等待一段时间即结束
+    if (!s->eof && now_ms - s->exit_ms < IOT_WEBSHELL_KILL_GRACE_MS) {
+        return false;
+    }
+    iot_webshell_frame_t frame = {0};
+    frame.type = IOT_WEBSHELL_FRAME_EXIT;
+    frame.uid = s->uid;
+    frame.seq = s->seq;
+    frame.exit_code = s->exit_code;
+    frame.reason = s->terminating ? s->reason : IOT_WEBSHELL_EXIT_NORMAL;
+    return ws->send(&frame, ws->send_userdata) == VOLC_OK;
+}
+
+int32_t iot_webshell_poll(iot_webshell_t *ws, uint64_t now_ms) {
+    if (ws == NULL || !ws->inited) {
+        return -1;
+    }
+    int32_t next = -1;
+    platform_mutex_lock(ws->mutex);
+    for (size_t i = 0; i < ws->config.max_sessions; i++) {
+        iot_webshell_session_t *s = ws->sessions[i];
+        if (s == NULL) {
+            continue;
+        }
+        // 先确认退出再读取，退出前写入终端的输出都能在本轮读到
+        _ws_reap(s, now_ms);
+        if (!s->exited) {
+            _ws_flush_input(s);
+        }
+        _ws_read(ws, s, now_ms);
+        _ws_check_timeout(ws, s, now_ms);
+        _ws_send_chunk(ws, s, now_ms);
+        if (s->buf_len > 0 && s->buf_len < ws->config.max_buffer_bytes) {
+            // 腾出空间后继续读取
+            _ws_read(ws, s, now_ms);
+        }
+        if (_ws_finish(ws, s, now_ms)) {
+            ws->sessions[i] = NULL;
+            _ws_session_free(s);
+            continue;
+        }
+        int32_t wait_ms = IOT_WEBSHELL_POLL_INTERVAL_MS;
+        if (s->buf_len > 0) {
+            uint64_t due = s->last_chunk_ms + ws->config.chunk_interval_ms;
+            int32_t chunk_wait = due > now_ms ? (int32_t) (due - now_ms) : 0;
+            if (chunk_wait < wait_ms) {
+                wait_ms = chunk_wait;
+            }
+        }
+        if (next < 0 || wait_ms < next) {
+            next = wait_ms;
+        }
+    }
+    platform_mutex_unlock(ws->mutex);
+    return next;
+}
+
+size_t iot_webshell_session_count(iot_webshell_t *ws) {
+    if (ws == NULL || !ws->inited) {
+        return 0;
+    }
+    size_t count = 0;
+    platform_mutex_lock(ws->mutex);
+    for (size_t i = 0; i < ws->config.max_sessions; i++) {
+        if (ws->sessions[i] != NULL) {
+            count++;
+        }
+    }
+    platform_mutex_unlock(ws->mutex);
+    return count;
+}
+
+#else
+
+// 没有伪终端的平台
+
+int iot_webshell_init(iot_webshell_t *ws, const iot_webshell_config_t *config,
+                      iot_webshell_send_fn send, void *userdata) {
+    if (ws != NULL) {
+        memset(ws, 0, sizeof(iot_webshell_t));
+    }
+    return VOLC_ERR_TM_WEBSHELL_UNSUPPORTED;
+}
+
+void iot_webshell_deinit(iot_webshell_t *ws) {
+}
+
+int iot_webshell_input(iot_webshell_t *ws, const char *uid, const uint8_t *data, size_t len, uint64_t now_ms) {
+    return VOLC_ERR_TM_WEBSHELL_UNSUPPORTED;
+}
+
+int iot_webshell_resize(iot_webshell_t *ws, const char *uid, uint16_t rows, uint16_t columns) {
+    return VOLC_ERR_TM_WEBSHELL_UNSUPPORTED;
+}
+
+int iot_webshell_kill(iot_webshell_t *ws, const char *uid) {
+    return VOLC_ERR_TM_WEBSHELL_UNSUPPORTED;
+}
+
+int32_t iot_webshell_poll(iot_webshell_t *ws, uint64_t now_ms) {
+    return -1;
+}
+
+size_t iot_webshell_session_count(iot_webshell_t *ws) {
+    return 0;
+}
+
+#endif
+
+#endif //ONESDK_ENABLE_IOT
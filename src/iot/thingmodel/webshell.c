@@ -24,7 +24,8 @@
 #include "thing_model/iot_tm_header.h"
 #include "util/util.h"
 #include "error_code.h"
-#include "iot/iot_popen.h"
+#include "util/json_writer.h"
+#include "aws/common/encoding.h"
 
 void __send_webshell_command_reply(void* handle, const char* id) {
     iot_tm_handler_t* dm_handle = (iot_tm_handler_t*) handle;
@@ -38,6 +39,85 @@ void __send_webshell_command_reply(void* handle, const char* id) {
 }
 
 
+// 会话的一帧输出或退出通知发往post_reply topic：
+// 输出 '1' + {"Seq":0,"Data":"<base64>"}，退出 '4' + {"Seq":9,"Code":0,"Reason":0}
+int _tm_webshell_send(const iot_webshell_frame_t *frame, void *userdata) {
+    iot_tm_handler_t *dm_handle = (iot_tm_handler_t *) userdata;
+    struct aws_byte_buf encoded = {0};
+    if (frame->type == IOT_WEBSHELL_FRAME_OUTPUT) {
+        size_t encoded_len = 0;
+        struct aws_byte_cursor data_cur = aws_byte_cursor_from_array(frame->data, frame->len);
+        if (aws_base64_compute_encoded_len(frame->len, &encoded_len) != AWS_OP_SUCCESS ||
+            aws_byte_buf_init(&encoded, dm_handle->allocator, encoded_len) != AWS_OP_SUCCESS) {
+            return VOLC_ERR_MALLOC;
+        }
+        // 编码结果以'\0'结尾，不计入len
+        if (aws_base64_encode(&data_cur, &encoded) != AWS_OP_SUCCESS) {
+            aws_byte_buf_clean_up(&encoded);
+            return VOLC_ERR_MALLOC;
+        }
+    }
+
+    struct aws_byte_buf payload_buf;
+    if (aws_byte_buf_init(&payload_buf, dm_handle->allocator, encoded.len + 64) != AWS_OP_SUCCESS) {
+        aws_byte_buf_clean_up(&encoded);
+        return VOLC_ERR_MALLOC;
+    }
+    aws_byte_buf_append_byte_dynamic(&payload_buf, frame->type == IOT_WEBSHELL_FRAME_OUTPUT ? '1' : '4');
+    json_writer_t w;
+    json_writer_init(&w, &payload_buf);
+    json_writer_begin_object(&w);
+    json_writer_kv_int(&w, "Seq", frame->seq);
+    if (frame->type == IOT_WEBSHELL_FRAME_OUTPUT) {
+        json_writer_kv_string(&w, "Data", (const char *) encoded.buffer);
+    } else {
+        json_writer_kv_int(&w, "Code", frame->exit_code);
+        json_writer_kv_int(&w, "Reason", frame->reason);
+    }
+    json_writer_end_object(&w);
+    int ret = json_writer_finish(&w);
+    aws_byte_buf_clean_up(&encoded);
+
+    char scratch[IOT_TM_TOPIC_SCRATCH_SIZE];
+    char *heap = NULL;
+    const char *topic = NULL;
+    if (ret == VOLC_OK) {
+        const iot_basic_config_t *config = dm_handle->mqtt_handle->config->basic_config;
+        topic = iot_tm_topic_format(scratch, sizeof(scratch), &heap, "sys/%s/%s/webshell/cmd/%s/post_reply",
+                                    config->product_key, config->device_name, frame->uid, NULL, NULL);
+        ret = topic == NULL ? VOLC_ERR_MALLOC : VOLC_OK;
+    }
+    if (ret == VOLC_OK) {
+        int pub_ret = iot_mqtt_publish(dm_handle->mqtt_handle, topic, payload_buf.buffer, payload_buf.len,
+                                       IOT_MQTT_QOS1);
+        // 发送队列满时保留该帧，下次再发
+        ret = pub_ret < 0 ? pub_ret : VOLC_OK;
+    }
+    free(heap);
+    aws_byte_buf_clean_up(&payload_buf);
+    return ret;
+}
+
+static void _tm_webshell_resize(iot_tm_handler_t *dm_handle, const char *uid, const uint8_t *data, size_t len) {
+    // {"Rows":40,"Columns":120}
+    struct aws_json_value *root = aws_json_value_new_from_string(dm_handle->allocator,
+                                                                 aws_byte_cursor_from_array(data, len));
+    if (root == NULL) {
+        LOGE(TAG_IOT_MQTT, "webshell resize payload is not json");
+        return;
+    }
+    double rows = 0;
+    double columns = 0;
+    struct aws_json_value *rows_json = aws_json_value_get_from_object(root, aws_byte_cursor_from_c_str("Rows"));
+    struct aws_json_value *columns_json = aws_json_value_get_from_object(root, aws_byte_cursor_from_c_str("Columns"));
+    if (rows_json != NULL && columns_json != NULL && aws_json_value_get_number(rows_json, &rows) == AWS_OP_SUCCESS &&
+        aws_json_value_get_number(columns_json, &columns) == AWS_OP_SUCCESS && rows > 0 && rows <= UINT16_MAX &&
+        columns > 0 && columns <= UINT16_MAX) {
+        iot_webshell_resize(dm_handle->webshell, uid, (uint16_t) rows, (uint16_t) columns);
+    }
+    aws_json_value_destroy(root);
+}
+
 // recv server webshell cmd  's msg
 void _tm_recv_webshell_command_handler(const char* topic, const uint8_t *payload, size_t len, void *pUserData) {
     struct aws_byte_cursor topic_byte_cursor = aws_byte_cursor_from_array(topic, strlen(topic));
@@ -50,54 +130,47 @@ void _tm_recv_webshell_command_handler(const char* topic, const uint8_t *payload
     if (dm_handle == NULL) {
         return;
     }
-    if (NULL == dm_handle->recv_handler) {
-        return;
-    }
-    iot_tm_recv_t recv;
-    AWS_ZERO_STRUCT(recv);
-    recv.type = IOT_TM_RECV_WEBSHELL_COMMAND;
 
-    //parse topic for uid
+    //parse topic for uid: sys/{pk}/{dn}/webshell/cmd/{uid}/post
     struct aws_array_list topic_split_data_list;
     aws_array_list_init_dynamic(&topic_split_data_list, dm_handle->allocator, 8,sizeof(struct aws_byte_cursor));
     aws_byte_cursor_split_on_char(&topic_byte_cursor, '/',&topic_split_data_list);
     struct aws_byte_cursor uid_cur = {0};
-    aws_array_list_get_at(&topic_split_data_list, &uid_cur, 5);
+    if (aws_array_list_get_at(&topic_split_data_list, &uid_cur, 5) != AWS_OP_SUCCESS || uid_cur.len == 0) {
+        aws_array_list_clean_up(&topic_split_data_list);
+        return;
+    }
+    char *uid = aws_cur_to_char_str(dm_handle->allocator, &uid_cur);
+    aws_array_list_clean_up(&topic_split_data_list);
 
     // reply service
-    struct aws_string* uid_aws_string = aws_string_new_from_cursor(dm_handle->allocator, &uid_cur);
-    __send_webshell_command_reply(dm_handle, aws_string_c_str(uid_aws_string));
-    aws_mem_release(dm_handle->allocator, uid_aws_string);
-
-    // exec this command (in payload)
-    const char* command = aws_cur_to_char_str(dm_handle->allocator, &payload_byte_cursor);
-    char type = command[0];
-    if (type == '1') {
-        // write
-        iot_popen((const char *) (command + 1), "w", NULL, 0);
-
-    } else if (type == '2') {
-        // ping, try send pong
-        __send_webshell_command_pong(dm_handle, aws_string_c_str(uid_aws_string), "2");
+    __send_webshell_command_reply(dm_handle, uid);
 
+    // 首字节为命令类型，其后为数据
+    char type = len > 0 ? (char) payload[0] : '\0';
+    const uint8_t *data = len > 0 ? payload + 1 : payload;
+    size_t data_len = len > 0 ? len - 1 : 0;
+    if (type == '2') {
+        // ping, try send pong
+        __send_webshell_command_pong(dm_handle, uid, "2");
+    } else if (type != '1' && type != '3' && type != '4') {
+        LOGE(TAG_IOT_MQTT, "webshell type is unknown !!");
+    } else if (dm_handle->webshell == NULL) {
+        LOGE(TAG_IOT_MQTT, "webshell is not enabled, call iot_tm_webshell_enable first");
+    } else if (type == '1') {
+        // 终端输入，会话不存在时创建
+        int32_t ret = iot_webshell_input(dm_handle->webshell, uid, data, data_len, _tm_now_ms());
+        if (ret != VOLC_OK) {
+            LOGE(TAG_IOT_MQTT, "webshell input failed, uid = %s, ret = %d", uid, ret);
+        }
     } else if (type == '3') {
         // resize terminal
-        struct aws_json_value* resize_terminal_json = aws_json_value_new_from_string(dm_handle->allocator,
-                                                                                     aws_byte_cursor_from_c_str((const char*)(command + 1)));
-        // parse params
-        int rows = aws_json_get_num_val(resize_terminal_json, "Rows");
-        int columns = aws_json_get_num_val(resize_terminal_json, "Columns");
-        char resize_cmd[64] = {0};
-        sprintf(resize_cmd, "resize -s %d %d", rows, columns);
-        iot_popen(resize_cmd, "w", NULL, 0);
-
+        _tm_webshell_resize(dm_handle, uid, data, data_len);
     } else {
-        LOGE(TAG_IOT_MQTT, "webshell type is unknown !!");
-        return;
+        // 服务端关闭终端
+        iot_webshell_kill(dm_handle->webshell, uid);
     }
-
-
-
+    aws_mem_release(dm_handle->allocator, uid);
 }
 
 void iot_webshell_command_reply_init(iot_tm_recv_webshell_command_reply_t** pty, const char* uid) {
@@ -118,7 +191,7 @@ void iot_webshell_command_reply_free(iot_tm_recv_webshell_command_reply_t* pty)
     if (pty == NULL) {
         return;
     }
-    aws_mem_release(aws_alloc(), pty);
+    free(pty);
 }
 
 int32_t _tm_send_webshell_command_reply(void* handler, const char* topic, const void* msg_p) {
@@ -146,6 +219,7 @@ void __send_webshell_command_pong(void* handle, const char* uid, const char* pon
     dm_msg.type = IOT_TM_MSG_WEBSHELL_COMMAND_PONG;
     iot_tm_msg_webshell_command_pong_t* webshell_command_pong;
     iot_webshell_command_pong_init(&webshell_command_pong,uid, pong);
+    dm_msg.data.webshell_command_pong = webshell_command_pong;
     iot_tm_send(dm_handle, &dm_msg);
     iot_webshell_command_pong_free(webshell_command_pong);
 
@@ -167,7 +241,7 @@ void iot_webshell_command_pong_free(iot_tm_msg_webshell_command_pong_t* pty) {
     if (pty == NULL) {
         return;
     }
-    aws_mem_release(aws_alloc(), pty);
+    free(pty);
 }
 
 int32_t _tm_send_webshell_command_pong(void* handler, const char* topic, const void* msg_p) {
@@ -18,6 +18,7 @@
 #include "iot_basic.h"
 #include "iot/dynreg.h"
 #include "aigw/llm.h"
+#include "aigw/auth.h"
 
 iot_basic_config_t* iot_config_dup(const iot_basic_config_t* src);
 void iot_config_free(iot_basic_config_t* config);
@@ -28,6 +29,11 @@ int onesdk_iot_basic_init(iot_basic_ctx_t *ctx, const iot_basic_config_t *config
     if (ret != 0) {
         return VOLC_ERR_INVALID_PARAM;
     }
+    // 硬件ID和签名在后续HTTP/WS请求中复用
+    ctx->auth_cache = aigw_auth_cache_new();
+    if (ctx->auth_cache == NULL) {
+        return VOLC_ERR_MALLOC;
+    }
 
     return VOLC_OK;
 }
@@ -38,6 +44,8 @@ int onesdk_iot_basic_deinit(iot_basic_ctx_t *ctx) {
     }
     iot_config_free(ctx->config);
     ctx->config = NULL;
+    aigw_auth_cache_free(ctx->auth_cache);
+    ctx->auth_cache = NULL;
     free(ctx);
     ctx = NULL;
     return VOLC_OK;
@@ -102,6 +102,11 @@ int onesdk_init(onesdk_ctx_t * ctx, onesdk_config_t *config) {
     if (config->ping_interval_s <= 0) {
         aigw_ws_config->ping_interval_s = PING_INTERVAL_S;
     }
+    aigw_ws_config->pong_timeout_s = config->pong_timeout_s;
+    if (config->pong_timeout_s == 0) {
+        aigw_ws_config->pong_timeout_s = PONG_TIMEOUT_S;
+    }
+    aigw_ws_config->loop = config->rt_loop;
 
     // init ws ctx
     aigw_ws_ctx_t *aigw_ws_ctx = malloc(sizeof(aigw_ws_ctx_t));
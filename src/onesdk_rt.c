@@ -162,6 +162,20 @@ int onesdk_rt_session_keepalive(onesdk_ctx_t *ctx) {
     return ret;
 }
 
+int onesdk_rt_service_once(onesdk_ctx_t *ctx, int timeout_ms) {
+    if (NULL == ctx || NULL == ctx->aigw_ws_ctx) {
+        return VOLC_ERR_INIT;
+    }
+    return aigw_ws_loop_service_once(ctx->aigw_ws_ctx->loop, timeout_ms);
+}
+
+int onesdk_rt_service_fd(onesdk_ctx_t *ctx, int fd, short revents) {
+    if (NULL == ctx || NULL == ctx->aigw_ws_ctx) {
+        return VOLC_ERR_INIT;
+    }
+    return aigw_ws_loop_service_fd(ctx->aigw_ws_ctx->loop, fd, revents);
+}
+
 int onesdk_rt_audio_send(onesdk_ctx_t *ctx, const char *audio_data, size_t len, bool commit) {
     int ret = VOLC_OK;
     if (NULL == ctx || NULL == ctx->aigw_ws_ctx) {
@@ -189,6 +203,13 @@ int onesdk_rt_audio_response_cancel(onesdk_ctx_t *ctx) {
     return aigw_ws_response_cancel(ctx->aigw_ws_ctx);
 }
 
+int onesdk_rt_function_output(onesdk_ctx_t *ctx, const char *call_id, const char *output_json) {
+    if (NULL == ctx || NULL == ctx->aigw_ws_ctx) {
+        return VOLC_ERR_INIT;
+    }
+    return aigw_ws_conversation_item_create_function_output(ctx->aigw_ws_ctx, call_id, output_json);
+}
+
 int onesdk_rt_translation_session_update(onesdk_ctx_t *ctx, aigw_ws_translation_session_t *session) {
     int ret = VOLC_OK;
     if (NULL == ctx || NULL == ctx->aigw_ws_ctx) {
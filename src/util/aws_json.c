@@ -18,6 +18,7 @@
 #include "aws_json.h"
 #include "aws/common/json.h"
 #include "aws/common/math.h"
+#include "cJSON.h"
 // #include "iot/iot_utils.h"
 
 struct aws_json_value *
@@ -126,6 +127,13 @@ struct aws_byte_buf aws_json_obj_to_byte_buf(struct aws_allocator *allocator, st
 }
 
 
+bool aws_json_obj_print_to(struct aws_json_value *data_json, char *buf, size_t cap) {
+    if (data_json == NULL || buf == NULL || cap > INT32_MAX) {
+        return false;
+    }
+    return cJSON_PrintPreallocated((cJSON *)data_json, buf, (int)cap, false) != 0;
+}
+
 char *aws_json_get_str(struct aws_allocator *allocator, struct aws_json_value *data_json, const char *key) {
     struct aws_byte_cursor cur_val = aws_json_get_str_byte_cur_val(data_json, key);
     return aws_cur_to_char_str(allocator, &cur_val);
@@ -42,6 +42,9 @@ struct aws_json_value* aws_json_get_json_obj(struct  aws_allocator* allocator, s
 
 struct aws_byte_buf aws_json_obj_to_byte_buf(struct aws_allocator *allocator, struct aws_json_value *data_json);
 
+// 序列化到调用方缓冲（含结尾'\0'），缓冲不足返回false
+bool aws_json_obj_print_to(struct aws_json_value *data_json, char *buf, size_t cap);
+
 
 char *aws_json_get_str(struct aws_allocator *allocator, struct aws_json_value *data_json, const char *key);
 
@@ -12,14 +12,6 @@
 
  /* LOCAL FUNCTIONS */
 
- // Concatenate X & Y, return hash.
- static void* H(const void* x,
-                const size_t xlen,
-                const void* y,
-                const size_t ylen,
-                void* out,
-                const size_t outlen);
-
  // Wrapper for sha256
  static void* sha256(const void* data,
                      const size_t datalen,
@@ -27,18 +19,12 @@
                      const size_t outlen);
 
  // Declared in hmac_sha256.h
- size_t onesdk_hmac_sha256(const void* key,
-                    const size_t keylen,
-                    const void* data,
-                    const size_t datalen,
-                    void* out,
-                    const size_t outlen) {
+ void onesdk_hmac_sha256_init(onesdk_hmac_sha256_ctx_t* ctx,
+                              const void* key,
+                              const size_t keylen) {
    uint8_t k[SHA256_BLOCK_SIZE];
    uint8_t k_ipad[SHA256_BLOCK_SIZE];
    uint8_t k_opad[SHA256_BLOCK_SIZE];
-   uint8_t ihash[SHA256_HASH_SIZE];
-   uint8_t ohash[SHA256_HASH_SIZE];
-   size_t sz;
    int i;
 
    memset(k, 0, sizeof(k));
@@ -58,32 +44,55 @@
      k_opad[i] ^= k[i];
    }
 
+   // Absorb the padded keys once, signing only copies these states.
+   Sha256Initialise(&ctx->inner);
+   Sha256Update(&ctx->inner, k_ipad, sizeof(k_ipad));
+   Sha256Initialise(&ctx->outer);
+   Sha256Update(&ctx->outer, k_opad, sizeof(k_opad));
+
+   memset(k, 0, sizeof(k));
+   memset(k_ipad, 0, sizeof(k_ipad));
+   memset(k_opad, 0, sizeof(k_opad));
+ }
+
+ // Declared in hmac_sha256.h
+ size_t onesdk_hmac_sha256_sign(const onesdk_hmac_sha256_ctx_t* ctx,
+                                const void* data,
+                                const size_t datalen,
+                                void* out,
+                                const size_t outlen) {
+   Sha256Context inner = ctx->inner;
+   Sha256Context outer = ctx->outer;
+   SHA256_HASH ihash;
+   SHA256_HASH ohash;
+   size_t sz;
+
    // Perform HMAC algorithm: ( https://tools.ietf.org/html/rfc2104 )
    //      `H(K XOR opad, H(K XOR ipad, data))`
-   H(k_ipad, sizeof(k_ipad), data, datalen, ihash, sizeof(ihash));
-   H(k_opad, sizeof(k_opad), ihash, sizeof(ihash), ohash, sizeof(ohash));
+   Sha256Update(&inner, data, datalen);
+   Sha256Finalise(&inner, &ihash);
+   Sha256Update(&outer, ihash.bytes, sizeof(ihash.bytes));
+   Sha256Finalise(&outer, &ohash);
 
    sz = (outlen > SHA256_HASH_SIZE) ? SHA256_HASH_SIZE : outlen;
-   memcpy(out, ohash, sz);
+   memcpy(out, ohash.bytes, sz);
    return sz;
  }
 
- static void* H(const void* x,
-                const size_t xlen,
-                const void* y,
-                const size_t ylen,
-                void* out,
-                const size_t outlen) {
-   void* result;
-   size_t buflen = (xlen + ylen);
-   uint8_t* buf = (uint8_t*)malloc(buflen);
-
-   memcpy(buf, x, xlen);
-   memcpy(buf + xlen, y, ylen);
-   result = sha256(buf, buflen, out, outlen);
-
-   free(buf);
-   return result;
+ // Declared in hmac_sha256.h
+ size_t onesdk_hmac_sha256(const void* key,
+                    const size_t keylen,
+                    const void* data,
+                    const size_t datalen,
+                    void* out,
+                    const size_t outlen) {
+   onesdk_hmac_sha256_ctx_t ctx;
+   size_t sz;
+
+   onesdk_hmac_sha256_init(&ctx, key, keylen);
+   sz = onesdk_hmac_sha256_sign(&ctx, data, datalen, out, outlen);
+   memset(&ctx, 0, sizeof(ctx));
+   return sz;
  }
 
  static void* sha256(const void* data,
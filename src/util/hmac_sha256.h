@@ -11,6 +11,37 @@ extern "C" {
 #endif  // __cplusplus
 
 #include <stddef.h>
+#include "sha256.h"
+
+  // Keyed HMAC state: SHA-256 contexts that have already absorbed
+  // `K XOR ipad` / `K XOR opad`. Build it once per key, then sign any
+  // number of messages without touching the key again.
+  typedef struct {
+    Sha256Context inner;
+    Sha256Context outer;
+  } onesdk_hmac_sha256_ctx_t;
+
+  void
+  onesdk_hmac_sha256_init (
+      // [out]: The keyed state.
+      onesdk_hmac_sha256_ctx_t* ctx,
+
+      // [in]: The key and its length.
+      const void* key,
+      const size_t keylen);
+
+  size_t  // Returns the number of bytes written to `out`
+  onesdk_hmac_sha256_sign (
+      // [in]: Keyed state from onesdk_hmac_sha256_init(), left untouched.
+      const onesdk_hmac_sha256_ctx_t* ctx,
+
+      // [in]: The data to hash.
+      const void* data,
+      const size_t datalen,
+
+      // [out]: The output hash, truncated to `outlen` if shorter than 32 bytes.
+      void* out,
+      const size_t outlen);
 
   size_t  // Returns the number of bytes written to `out`
   onesdk_hmac_sha256 (
@@ -0,0 +1,351 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_writer.h"
+#include "error_code.h"
+
+static void jw_append(json_writer_t *w, const char *data, size_t len) {
+    if (w->error != VOLC_OK || len == 0) {
+        return;
+    }
+    if (w->buf->allocator == NULL) {
+        // 定长缓冲
+        if (!aws_byte_buf_write(w->buf, (const uint8_t *)data, len)) {
+            w->error = VOLC_ERR_INVALID_PARAM;
+        }
+        return;
+    }
+    struct aws_byte_cursor cur = aws_byte_cursor_from_array(data, len);
+    if (aws_byte_buf_append_dynamic(w->buf, &cur) != AWS_OP_SUCCESS) {
+        w->error = VOLC_ERR_MALLOC;
+    }
+}
+
+static void jw_append_char(json_writer_t *w, char c) {
+    // 裁剪版aws-common未实现append_byte_dynamic
+    jw_append(w, &c, 1);
+}
+
+// 写值之前处理逗号分隔
+static void jw_before_value(json_writer_t *w) {
+    if (w->after_key) {
+        w->after_key = false;
+        return;
+    }
+    if (w->depth > 0) {
+        if (w->has_elem[w->depth - 1]) {
+            jw_append_char(w, ',');
+        }
+        w->has_elem[w->depth - 1] = true;
+    }
+}
+
+static void jw_append_escaped(json_writer_t *w, const char *str) {
+    static const char hex[] = "0123456789abcdef";
+    const char *start = str;
+    const char *p = str;
+    jw_append_char(w, '"');
+    for (; *p; p++) {
+        unsigned char c = (unsigned char)*p;
+        const char *esc = NULL;
+        char ubuf[7];
+        switch (c) {
+            case '"': esc = "\\\""; break;
+            case '\\': esc = "\\\\"; break;
+            case '\b': esc = "\\b"; break;
+            case '\f': esc = "\\f"; break;
+            case '\n': esc = "\\n"; break;
+            case '\r': esc = "\\r"; break;
+            case '\t': esc = "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    memcpy(ubuf, "\\u00", 4);
+                    ubuf[4] = hex[c >> 4];
+                    ubuf[5] = hex[c & 0x0f];
+                    ubuf[6] = '\0';
+                    esc = ubuf;
+                }
+                break;
+        }
+        if (esc) {
+            // 先整段写入无需转义的部分，UTF-8多字节原样输出
+            jw_append(w, start, (size_t)(p - start));
+            jw_append(w, esc, strlen(esc));
+            start = p + 1;
+        }
+    }
+    jw_append(w, start, (size_t)(p - start));
+    jw_append_char(w, '"');
+}
+
+static void jw_push(json_writer_t *w, char open) {
+    jw_before_value(w);
+    if (w->depth >= JSON_WRITER_MAX_DEPTH) {
+        w->error = VOLC_ERR_INVALID_PARAM;
+        return;
+    }
+    jw_append_char(w, open);
+    w->has_elem[w->depth++] = false;
+}
+
+static void jw_pop(json_writer_t *w, char close) {
+    if (w->depth == 0 || w->after_key) {
+        w->error = VOLC_ERR_INVALID_PARAM;
+        return;
+    }
+    w->depth--;
+    jw_append_char(w, close);
+}
+
+// 无符号整数写到out末尾之前，返回起始位置
+static char *jw_format_u64_rev(uint64_t v, char *end) {
+    char *p = end;
+    do {
+        *--p = (char)('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+    return p;
+}
+
+static size_t jw_format_int(int64_t value, char *out) {
+    char tmp[24];
+    char *end = tmp + sizeof(tmp);
+    // 取绝对值时避开INT64_MIN溢出
+    uint64_t mag = value < 0 ? (uint64_t)0 - (uint64_t)value : (uint64_t)value;
+    char *p = jw_format_u64_rev(mag, end);
+    if (value < 0) {
+        *--p = '-';
+    }
+    memcpy(out, p, (size_t)(end - p));
+    return (size_t)(end - p);
+}
+
+// 10^0 ~ 10^22 均可由double精确表示
+static const double jw_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+size_t json_writer_format_double(double value, char *out) {
+    if (value == 0) {
+        // cJSON把-0按整数0输出
+        out[0] = '0';
+        return 1;
+    }
+    double mag = fabs(value);
+    // 快速路径：%g不使用指数的范围内，找最少的小数位k，使整数m满足 m / 10^k 还原为原值。
+    // m与10^k都可精确表示，除法正确舍入，结果等于strtod对同一十进制串的解析结果；
+    // 限制m < 10^15，即不超过15位有效数字，此时与cJSON的"%1.15g"输出一致
+    if (mag >= 1e-4 && mag < 1e15) {
+        for (size_t k = 0; k < sizeof(jw_pow10) / sizeof(jw_pow10[0]); k++) {
+            double scaled = mag * jw_pow10[k];
+            if (scaled >= 1e15) {
+                break;
+            }
+            uint64_t m = (uint64_t)(scaled + 0.5);
+            if (m >= 1000000000000000ULL || (double)m / jw_pow10[k] != mag) {
+                continue;
+            }
+            char digits[24];
+            char *end = digits + sizeof(digits);
+            char *d = jw_format_u64_rev(m, end);
+            size_t nd = (size_t)(end - d);
+            char *p = out;
+            if (value < 0) {
+                *p++ = '-';
+            }
+            if (k == 0) {
+                memcpy(p, d, nd);
+                p += nd;
+            } else if (nd > k) {
+                memcpy(p, d, nd - k);
+                p += nd - k;
+                *p++ = '.';
+                memcpy(p, d + nd - k, k);
+                p += k;
+            } else {
+                // 0.00ddd
+                *p++ = '0';
+                *p++ = '.';
+                memset(p, '0', k - nd);
+                p += k - nd;
+                memcpy(p, d, nd);
+                p += nd;
+            }
+            return (size_t)(p - out);
+        }
+    }
+    // 指数形式或需要16、17位有效数字：依次尝试15~17位，取第一个能精确还原的
+    int n = 0;
+    for (int precision = 15; precision <= 17; precision++) {
+        n = snprintf(out, JSON_WRITER_NUM_SIZE, "%1.*g", precision, value);
+        if (strtod(out, NULL) == value) {
+            break;
+        }
+    }
+    return (size_t)n;
+}
+
+void json_writer_init(json_writer_t *w, struct aws_byte_buf *buf) {
+    memset(w, 0, sizeof(json_writer_t));
+    w->buf = buf;
+    w->error = VOLC_OK;
+}
+
+void json_writer_init_members(json_writer_t *w, struct aws_byte_buf *buf) {
+    json_writer_init(w, buf);
+    // 处在一个不写括号的对象内
+    w->depth = 1;
+    w->has_elem[0] = false;
+}
+
+void json_writer_begin_object(json_writer_t *w) {
+    jw_push(w, '{');
+}
+
+void json_writer_end_object(json_writer_t *w) {
+    jw_pop(w, '}');
+}
+
+void json_writer_begin_array(json_writer_t *w) {
+    jw_push(w, '[');
+}
+
+void json_writer_end_array(json_writer_t *w) {
+    jw_pop(w, ']');
+}
+
+void json_writer_key(json_writer_t *w, const char *key) {
+    if (w->depth == 0 || w->after_key || key == NULL) {
+        w->error = VOLC_ERR_INVALID_PARAM;
+        return;
+    }
+    jw_before_value(w);
+    jw_append_escaped(w, key);
+    jw_append_char(w, ':');
+    w->after_key = true;
+}
+
+void json_writer_string(json_writer_t *w, const char *value) {
+    if (value == NULL) {
+        json_writer_null(w);
+        return;
+    }
+    jw_before_value(w);
+    jw_append_escaped(w, value);
+}
+
+void json_writer_int(json_writer_t *w, int64_t value) {
+    char num[24];
+    size_t n = jw_format_int(value, num);
+    jw_before_value(w);
+    jw_append(w, num, n);
+}
+
+void json_writer_double(json_writer_t *w, double value) {
+    char num[JSON_WRITER_NUM_SIZE];
+    if (!isfinite(value)) {
+        // JSON没有NaN/Inf
+        json_writer_null(w);
+        return;
+    }
+    size_t n = json_writer_format_double(value, num);
+    jw_before_value(w);
+    jw_append(w, num, n);
+}
+
+void json_writer_bool(json_writer_t *w, bool value) {
+    jw_before_value(w);
+    if (value) {
+        jw_append(w, "true", 4);
+    } else {
+        jw_append(w, "false", 5);
+    }
+}
+
+void json_writer_null(json_writer_t *w) {
+    jw_before_value(w);
+    jw_append(w, "null", 4);
+}
+
+void json_writer_raw(json_writer_t *w, const char *json, size_t len) {
+    if (json == NULL || len == 0) {
+        json_writer_null(w);
+        return;
+    }
+    jw_before_value(w);
+    jw_append(w, json, len);
+}
+
+void json_writer_members(json_writer_t *w, const char *members, size_t len) {
+    jw_before_value(w);
+    jw_append_char(w, '{');
+    jw_append(w, members, len);
+    jw_append_char(w, '}');
+}
+
+void json_writer_kv_string(json_writer_t *w, const char *key, const char *value) {
+    json_writer_key(w, key);
+    json_writer_string(w, value);
+}
+
+void json_writer_kv_int(json_writer_t *w, const char *key, int64_t value) {
+    json_writer_key(w, key);
+    json_writer_int(w, value);
+}
+
+void json_writer_kv_double(json_writer_t *w, const char *key, double value) {
+    json_writer_key(w, key);
+    json_writer_double(w, value);
+}
+
+void json_writer_kv_bool(json_writer_t *w, const char *key, bool value) {
+    json_writer_key(w, key);
+    json_writer_bool(w, value);
+}
+
+void json_writer_kv_null(json_writer_t *w, const char *key) {
+    json_writer_key(w, key);
+    json_writer_null(w);
+}
+
+void json_writer_kv_raw(json_writer_t *w, const char *key, const char *json) {
+    json_writer_key(w, key);
+    json_writer_raw(w, json, json ? strlen(json) : 0);
+}
+
+int json_writer_finish(json_writer_t *w) {
+    if (w->error == VOLC_OK && (w->depth != 0 || w->after_key)) {
+        w->error = VOLC_ERR_INVALID_PARAM;
+    }
+    if (w->error != VOLC_OK) {
+        return w->error;
+    }
+    if (w->buf->allocator == NULL) {
+        if (w->buf->capacity - w->buf->len < 1) {
+            w->error = VOLC_ERR_INVALID_PARAM;
+            return w->error;
+        }
+    } else if (aws_byte_buf_reserve_relative(w->buf, 1) != AWS_OP_SUCCESS) {
+        w->error = VOLC_ERR_MALLOC;
+        return w->error;
+    }
+    w->buf->buffer[w->buf->len] = '\0';
+    return VOLC_OK;
+}
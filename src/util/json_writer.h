@@ -0,0 +1,96 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _UTIL_JSON_WRITER_H
+#define _UTIL_JSON_WRITER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "aws/common/byte_buf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JSON_WRITER_MAX_DEPTH 16
+#define JSON_WRITER_NUM_SIZE 32     // json_writer_format_double输出缓冲的最小长度
+
+/**
+ * @brief 紧凑JSON写入器，直接追加到aws_byte_buf，不构建中间对象树
+ * @note buf由aws_byte_buf_init初始化时空间不足自动扩容；由aws_byte_buf_from_empty_array初始化
+ *       （allocator为NULL）时为定长缓冲，写满后出错。出错后后续写入均被忽略
+ */
+typedef struct json_writer {
+    struct aws_byte_buf *buf;
+    uint32_t depth;
+    bool has_elem[JSON_WRITER_MAX_DEPTH];   // 当前层是否已有元素，决定是否写逗号
+    bool after_key;
+    int error;
+} json_writer_t;
+
+void json_writer_init(json_writer_t *w, struct aws_byte_buf *buf);
+
+/**
+ * @brief 只写对象成员 "k":v,"k2":v2 ，不写外层括号，用于逐个追加成员、最后整体嵌入另一个对象
+ * 初始化后直接调用key/value接口，不调用begin/end_object，也不调用finish
+ */
+void json_writer_init_members(json_writer_t *w, struct aws_byte_buf *buf);
+
+void json_writer_begin_object(json_writer_t *w);
+void json_writer_end_object(json_writer_t *w);
+void json_writer_begin_array(json_writer_t *w);
+void json_writer_end_array(json_writer_t *w);
+
+void json_writer_key(json_writer_t *w, const char *key);
+
+// 值，NULL字符串写为null
+void json_writer_string(json_writer_t *w, const char *value);
+void json_writer_int(json_writer_t *w, int64_t value);
+void json_writer_double(json_writer_t *w, double value);
+void json_writer_bool(json_writer_t *w, bool value);
+void json_writer_null(json_writer_t *w);
+// 已序列化的JSON值原样写入，调用方保证合法
+void json_writer_raw(json_writer_t *w, const char *json, size_t len);
+
+// json_writer_init_members写出的成员包上括号作为对象值写入
+void json_writer_members(json_writer_t *w, const char *members, size_t len);
+
+// key + value 便捷接口
+void json_writer_kv_string(json_writer_t *w, const char *key, const char *value);
+void json_writer_kv_int(json_writer_t *w, const char *key, int64_t value);
+void json_writer_kv_double(json_writer_t *w, const char *key, double value);
+void json_writer_kv_bool(json_writer_t *w, const char *key, bool value);
+void json_writer_kv_null(json_writer_t *w, const char *key);
+void json_writer_kv_raw(json_writer_t *w, const char *key, const char *json);
+
+/**
+ * @brief 结束写入，校验嵌套完整并在末尾补'\0'（不计入len）
+ * @return VOLC_OK 成功，其他为错误码
+ */
+int json_writer_finish(json_writer_t *w);
+
+/**
+ * @brief 格式化有限的double，输出能精确还原该值的最短十进制表示，不写'\0'
+ * 不超过15位有效数字的值与cJSON输出逐字节一致（含整数、毫秒时间戳），-0写为0；
+ * 需要16、17位有效数字的值输出最短可还原的位数，cJSON在这种情况下可能多输出位数或丢失精度
+ * @param out 至少JSON_WRITER_NUM_SIZE字节
+ * @return 写入的长度
+ */
+size_t json_writer_format_double(double value, char *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _UTIL_JSON_WRITER_H
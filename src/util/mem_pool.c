@@ -0,0 +1,88 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem_pool.h"
+
+static const size_t k_class_size[MEM_POOL_NUM_CLASSES] = {64, 256, 1024, 4096, 16384};
+
+// 块头记录所属级别，保持payload按max_align_t对齐
+typedef union mem_pool_hdr {
+    struct {
+        uint32_t cls;
+        union mem_pool_hdr *next;   // 仅在空闲链表中使用
+    } h;
+    max_align_t align;
+} mem_pool_hdr_t;
+
+static uint32_t _mem_pool_class(size_t size) {
+    uint32_t cls = 0;
+    while (cls < MEM_POOL_NUM_CLASSES && size > k_class_size[cls]) {
+        cls++;
+    }
+    return cls;
+}
+
+void mem_pool_init(mem_pool_t *pool, uint32_t max_cached) {
+    memset(pool, 0, sizeof(mem_pool_t));
+    pool->max_cached = max_cached;
+}
+
+void mem_pool_deinit(mem_pool_t *pool) {
+    for (uint32_t cls = 0; cls < MEM_POOL_NUM_CLASSES; cls++) {
+        mem_pool_hdr_t *hdr = pool->free_list[cls];
+        while (hdr) {
+            mem_pool_hdr_t *next = hdr->h.next;
+            free(hdr);
+            hdr = next;
+        }
+        pool->free_list[cls] = NULL;
+        pool->cached[cls] = 0;
+    }
+}
+
+void *mem_pool_alloc(mem_pool_t *pool, size_t size) {
+    uint32_t cls = _mem_pool_class(size);
+    mem_pool_hdr_t *hdr;
+    if (cls < MEM_POOL_NUM_CLASSES && pool->free_list[cls]) {
+        hdr = pool->free_list[cls];
+        pool->free_list[cls] = hdr->h.next;
+        pool->cached[cls]--;
+        return hdr + 1;
+    }
+    hdr = malloc(sizeof(mem_pool_hdr_t) + (cls < MEM_POOL_NUM_CLASSES ? k_class_size[cls] : size));
+    if (hdr == NULL) {
+        return NULL;
+    }
+    pool->sys_allocs++;
+    hdr->h.cls = cls;
+    return hdr + 1;
+}
+
+void mem_pool_free(mem_pool_t *pool, void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    mem_pool_hdr_t *hdr = (mem_pool_hdr_t *)ptr - 1;
+    uint32_t cls = hdr->h.cls;
+    if (cls >= MEM_POOL_NUM_CLASSES || pool->cached[cls] >= pool->max_cached) {
+        free(hdr);
+        return;
+    }
+    hdr->h.next = pool->free_list[cls];
+    pool->free_list[cls] = hdr;
+    pool->cached[cls]++;
+}
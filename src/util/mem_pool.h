@@ -0,0 +1,51 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _UTIL_MEM_POOL_H
+#define _UTIL_MEM_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MEM_POOL_NUM_CLASSES 5  // 64/256/1K/4K/16K，更大的块直接malloc
+
+/**
+ * @brief 按大小分级的块缓存，释放的块挂回对应级别的空闲链表供下次复用
+ * @note 非线程安全，由调用方加锁
+ */
+typedef struct mem_pool {
+    void *free_list[MEM_POOL_NUM_CLASSES];
+    uint32_t cached[MEM_POOL_NUM_CLASSES];
+    uint32_t max_cached;        // 每级最多缓存的空闲块数
+    uint64_t sys_allocs;        // 实际调用malloc的次数，用于观测命中率
+} mem_pool_t;
+
+void mem_pool_init(mem_pool_t *pool, uint32_t max_cached);
+
+void mem_pool_deinit(mem_pool_t *pool);
+
+// 返回至少size字节的块，失败返回NULL
+void *mem_pool_alloc(mem_pool_t *pool, size_t size);
+
+void mem_pool_free(mem_pool_t *pool, void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _UTIL_MEM_POOL_H
@@ -19,6 +19,7 @@ extern "C"
 {
   #include "CppUTest/TestHarness_c.h"
   #include "aigw/auth.h"
+  #include "util/hmac_sha256.h"
   #include "protocols/http.h"
 }
 
@@ -59,4 +60,93 @@ TEST(auth, test_auth) {
     http_request_context_t *client = device_auth_client(NULL, basic_ctx);
     CHECK(client != NULL);
     http_ctx_release(client);
-}
\ No newline at end of file
+}
+
+TEST_GROUP(auth_cache) {
+    iot_basic_config_t config;
+    aigw_auth_cache_t *cache;
+    void setup() {
+        memset(&config, 0, sizeof(config));
+        config.product_key = (char *)SAMPLE_PRODUCT_KEY;
+        config.device_name = (char *)SAMPLE_DEVICE_NAME;
+        config.device_secret = (char *)SAMPLE_DEVICE_SECRET;
+        config.auth_type = ONESDK_AUTH_DEVICE_SECRET;
+        cache = aigw_auth_cache_new();
+    }
+
+    void teardown() {
+        aigw_auth_cache_free(cache);
+    }
+};
+
+TEST(auth_cache, test_hmac_ctx_matches_oneshot) {
+    const char *key = "key";
+    const char *data = "The quick brown fox jumps over the lazy dog";
+    uint8_t want[32];
+    uint8_t got[32];
+    onesdk_hmac_sha256(key, strlen(key), data, strlen(data), want, sizeof(want));
+
+    onesdk_hmac_sha256_ctx_t ctx;
+    onesdk_hmac_sha256_init(&ctx, key, strlen(key));
+    // 同一密钥状态可重复签名
+    onesdk_hmac_sha256_sign(&ctx, data, strlen(data), got, sizeof(got));
+    MEMCMP_EQUAL(want, got, sizeof(want));
+    onesdk_hmac_sha256_sign(&ctx, data, strlen(data), got, sizeof(got));
+    MEMCMP_EQUAL(want, got, sizeof(want));
+    BYTES_EQUAL(0xf7, got[0]);
+    BYTES_EQUAL(0xd8, got[31]);
+}
+
+TEST(auth_cache, test_reuse_within_window) {
+    aigw_auth_token_t t1, t2;
+    const uint64_t now = 1700000000;
+    CHECK(cache != NULL);
+    CHECK(aigw_auth_cache_hardware_id(cache) != NULL);
+    LONGS_EQUAL(0, aigw_auth_cache_get(cache, &config, now, &t1));
+    STRCMP_EQUAL("1700000000", t1.timestamp);
+    LONGS_EQUAL(44, strlen(t1.signature));
+
+    // 最后一个复用时刻仍然命中缓存
+    uint64_t last_hit = now + AIGW_AUTH_TOKEN_TTL_S - AIGW_AUTH_TOKEN_REFRESH_AHEAD_S - 1;
+    LONGS_EQUAL(0, aigw_auth_cache_get(cache, &config, last_hit, &t2));
+    STRCMP_EQUAL(t1.timestamp, t2.timestamp);
+    STRCMP_EQUAL(t1.random_num, t2.random_num);
+    STRCMP_EQUAL(t1.signature, t2.signature);
+}
+
+TEST(auth_cache, test_refresh_ahead_of_expiry) {
+    aigw_auth_token_t t1, t2;
+    const uint64_t now = 1700000000;
+    LONGS_EQUAL(0, aigw_auth_cache_get(cache, &config, now, &t1));
+
+    // 到达提前刷新点即重新签名，而不是等到窗口结束
+    uint64_t refresh_at = now + AIGW_AUTH_TOKEN_TTL_S - AIGW_AUTH_TOKEN_REFRESH_AHEAD_S;
+    LONGS_EQUAL(0, aigw_auth_cache_get(cache, &config, refresh_at, &t2));
+    STRCMP_EQUAL("1700000270", t2.timestamp);
+    CHECK(strcmp(t1.signature, t2.signature) != 0);
+}
+
+TEST(auth_cache, test_refresh_on_clock_rollback) {
+    aigw_auth_token_t t1, t2;
+    LONGS_EQUAL(0, aigw_auth_cache_get(cache, &config, 1700000000, &t1));
+    LONGS_EQUAL(0, aigw_auth_cache_get(cache, &config, 1699999999, &t2));
+    STRCMP_EQUAL("1699999999", t2.timestamp);
+}
+
+TEST(auth_cache, test_refresh_on_device_change) {
+    aigw_auth_token_t t1, t2;
+    LONGS_EQUAL(0, aigw_auth_cache_get(cache, &config, 1700000000, &t1));
+    config.device_secret = (char *)"another-device-secret";
+    LONGS_EQUAL(0, aigw_auth_cache_get(cache, &config, 1700000001, &t2));
+    STRCMP_EQUAL("1700000001", t2.timestamp);
+    // 换回原设备同样重新签名
+    config.device_secret = (char *)SAMPLE_DEVICE_SECRET;
+    LONGS_EQUAL(0, aigw_auth_cache_get(cache, &config, 1700000002, &t1));
+    STRCMP_EQUAL("1700000002", t1.timestamp);
+}
+
+TEST(auth_cache, test_missing_secret) {
+    aigw_auth_token_t t;
+    config.device_secret = NULL;
+    CHECK(aigw_auth_cache_get(cache, &config, 1700000000, &t) != 0);
+}
@@ -0,0 +1,590 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+  #include "CppUTest/TestHarness_c.h"
+  #include "infer_realtime_ws.h"
+  #include "iot_basic.h"
+  #include "error_code.h"
+  #include "util/util.h"
+  #include "cJSON.h"
+}
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#define SERVER_MAX_MESSAGES 512
+#define SERVER_MESSAGE_SIZE 1024
+#define MAX_POLL_FDS 16
+#define LATENCY_MESSAGES 200
+#define SHARED_SESSIONS 100
+#define SERVER_GREETING "{\"type\":\"session.created\"}"
+
+static int64_t now_us() {
+    return (int64_t) std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 本地WS服务端：在独立线程中服务，按到达顺序记录消息及所在的连接序号
+struct test_ws_server_t {
+    struct lws_context *context;
+    int port;
+    std::atomic<bool> stopping;
+    std::atomic<bool> paused;       // 暂停服务，模拟对端失去响应
+    std::thread thread;
+    std::mutex lock;
+    int connections;
+    int count;
+    char messages[SERVER_MAX_MESSAGES][SERVER_MESSAGE_SIZE];
+    int message_conn[SERVER_MAX_MESSAGES];
+    int64_t message_us[SERVER_MAX_MESSAGES];
+};
+
+static int test_server_callback(struct lws *wsi, enum lws_callback_reasons reason, void *user, void *in, size_t len) {
+    test_ws_server_t *s = (test_ws_server_t *) lws_context_user(lws_get_context(wsi));
+    (void) user;
+    switch (reason) {
+        case LWS_CALLBACK_ESTABLISHED: {
+            std::lock_guard<std::mutex> guard(s->lock);
+            s->connections++;
+            lws_callback_on_writable(wsi);
+            break;
+        }
+        case LWS_CALLBACK_SERVER_WRITEABLE: {
+            // 连接建立后下发一条消息
+            unsigned char buf[LWS_PRE + sizeof(SERVER_GREETING)];
+            memcpy(buf + LWS_PRE, SERVER_GREETING, sizeof(SERVER_GREETING) - 1);
+            if (lws_write(wsi, buf + LWS_PRE, sizeof(SERVER_GREETING) - 1, LWS_WRITE_TEXT) < 0) {
+                return -1;
+            }
+            break;
+        }
+        case LWS_CALLBACK_RECEIVE: {
+            std::lock_guard<std::mutex> guard(s->lock);
+            if (s->count < SERVER_MAX_MESSAGES) {
+                snprintf(s->messages[s->count], SERVER_MESSAGE_SIZE, "%.*s", (int) len, (const char *) in);
+                s->message_conn[s->count] = s->connections;
+                s->message_us[s->count] = now_us();
+                s->count++;
+            }
+            // 模拟服务端断开连接
+            if (len >= 9 && memmem(in, len, "test.drop", 9)) {
+                return -1;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    return 0;
+}
+
+static const struct lws_protocols test_server_protocols[] = {
+    {"ws_realtime", test_server_callback, 0, 4096, 0, NULL, 0},
+    LWS_PROTOCOL_LIST_TERM
+};
+
+static void test_server_start(test_ws_server_t *s) {
+    s->connections = 0;
+    s->count = 0;
+    s->stopping = false;
+    s->paused = false;
+    struct lws_context_creation_info info;
+    memset(&info, 0, sizeof(info));
+    info.port = 0;                  // 系统分配端口
+    info.iface = "127.0.0.1";
+    info.protocols = test_server_protocols;
+    info.user = s;
+    s->context = lws_create_context(&info);
+    CHECK(s->context != NULL);
+    s->port = lws_get_vhost_listen_port(lws_get_vhost_by_name(s->context, "default"));
+    CHECK(s->port > 0);
+    s->thread = std::thread([s]() {
+        while (!s->stopping) {
+            if (s->paused) {
+                usleep(1000);
+                continue;
+            }
+            lws_service(s->context, 0);
+        }
+    });
+}
+
+static void test_server_stop(test_ws_server_t *s) {
+    s->stopping = true;
+    lws_cancel_service(s->context);
+    s->thread.join();
+    lws_context_destroy(s->context);
+    s->context = NULL;
+}
+
+static int test_server_count(test_ws_server_t *s) {
+    std::lock_guard<std::mutex> guard(s->lock);
+    return s->count;
+}
+
+// 外部事件循环按poll_cb维护的监听表
+struct poll_table_t {
+    struct pollfd fds[MAX_POLL_FDS];
+    int count;
+    int adds;
+};
+
+static void record_poll(aigw_ws_poll_op_t op, int fd, short events, void *userdata) {
+    poll_table_t *t = (poll_table_t *) userdata;
+    int i = 0;
+    while (i < t->count && t->fds[i].fd != fd) {
+        i++;
+    }
+    switch (op) {
+        case AIGW_WS_POLL_ADD:
+            if (i == t->count) {
+                if (t->count == MAX_POLL_FDS) {
+                    return;
+                }
+                t->count++;
+            }
+            t->fds[i].fd = fd;
+            t->fds[i].events = events;
+            t->adds++;
+            break;
+        case AIGW_WS_POLL_CHANGE:
+            if (i < t->count) {
+                t->fds[i].events = events;
+            }
+            break;
+        case AIGW_WS_POLL_DEL:
+            if (i < t->count) {
+                t->fds[i] = t->fds[--t->count];
+            }
+            break;
+    }
+}
+
+// 只用poll_cb通知的fd等待，就绪的交给aigw_ws_loop_service_fd，再处理一次定时器
+static void external_poll_once(aigw_ws_loop_t *loop, poll_table_t *t, int timeout_ms) {
+    struct pollfd fds[MAX_POLL_FDS];
+    int n = t->count;
+    memcpy(fds, t->fds, n * sizeof(struct pollfd));
+    if (poll(fds, n, timeout_ms) > 0) {
+        for (int i = 0; i < n; i++) {
+            if (fds[i].revents) {
+                aigw_ws_loop_service_fd(loop, fds[i].fd, fds[i].revents);
+            }
+        }
+    }
+    aigw_ws_loop_service_fd(loop, -1, 0);
+}
+
+// 在当前线程服务循环，直到条件成立或超时
+template <typename F>
+static bool service_until(aigw_ws_loop_t *loop, int timeout_ms, F done) {
+    int64_t deadline = now_us() + (int64_t) timeout_ms * 1000;
+    while (!done()) {
+        if (now_us() > deadline) {
+            return false;
+        }
+        aigw_ws_loop_service_once(loop, -1);
+        usleep(1000);
+    }
+    return true;
+}
+
+// 按最近秩取分位
+static int64_t percentile(std::vector<int64_t> values, double p) {
+    std::sort(values.begin(), values.end());
+    size_t rank = (size_t) (p / 100.0 * values.size() + 0.5);
+    rank = std::max<size_t>(1, std::min(rank, values.size()));
+    return values[rank - 1];
+}
+
+// 应用自己的事件循环线程：阻塞在lws_service中，入队的消息靠lws_cancel_service唤醒
+struct loop_thread_t {
+    std::atomic<bool> stopping;
+    std::thread thread;
+
+    void start(aigw_ws_loop_t *loop) {
+        stopping = false;
+        thread = std::thread([this, loop]() {
+            while (!stopping) {
+                aigw_ws_loop_service_once(loop, 1000);
+            }
+        });
+    }
+
+    void stop(aigw_ws_loop_t *loop) {
+        stopping = true;
+        lws_cancel_service(loop->lws_ctx);
+        thread.join();
+    }
+};
+
+struct received_t {
+    std::mutex lock;
+    std::vector<std::string> messages;
+};
+
+static void record_message(const char *message, size_t len, void *userdata) {
+    received_t *r = (received_t *) userdata;
+    std::lock_guard<std::mutex> guard(r->lock);
+    r->messages.push_back(std::string(message, len));
+}
+
+TEST_GROUP(realtime_ws) {
+    test_ws_server_t server;
+
+    void setup() {
+        test_server_start(&server);
+    }
+
+    void teardown() {
+        test_server_stop(&server);
+    }
+
+    aigw_ws_ctx_t *open_session(aigw_ws_loop_t *loop, int reconnect_interval_ms,
+                                int ping_interval_s = 0, int pong_timeout_s = 0) {
+        char url[64];
+        snprintf(url, sizeof(url), "ws://127.0.0.1:%d", server.port);
+        aigw_ws_config_t config;
+        memset(&config, 0, sizeof(config));
+        config.url = url;
+        config.path = "/";
+        config.api_key = "test";
+        config.reconnect_interval_ms = reconnect_interval_ms;
+        config.send_ping = ping_interval_s > 0;
+        config.ping_interval_s = ping_interval_s;
+        config.pong_timeout_s = pong_timeout_s;
+        config.loop = loop;
+        aigw_ws_ctx_t *ctx = (aigw_ws_ctx_t *) malloc(sizeof(aigw_ws_ctx_t));
+        LONGS_EQUAL(VOLC_OK, aigw_ws_init(ctx, &config));
+        iot_basic_config_t device;
+        memset(&device, 0, sizeof(device));
+        device.product_key = (char *) "pk";
+        device.device_name = (char *) "dn";
+        device.device_secret = (char *) "secret";
+        aigw_ws_set_option(ctx, AIGW_WS_IOT_CONFIG, &device);
+        return ctx;
+    }
+};
+
+// 外部事件循环只靠poll_cb通知的fd驱动：会话的socket被通知，连接建立并发出排队的消息
+TEST(realtime_ws, test_external_poll_reports_session_fd) {
+    poll_table_t table;
+    memset(&table, 0, sizeof(table));
+    aigw_ws_loop_t *loop = aigw_ws_loop_create(record_poll, &table);
+    CHECK(loop != NULL);
+    aigw_ws_ctx_t *ctx = open_session(loop, 0);
+    LONGS_EQUAL(VOLC_OK, aigw_ws_connect(ctx));
+    LONGS_EQUAL(VOLC_OK, aigw_ws_send_request(ctx, "{\"type\":\"test.hello\"}"));
+    for (int i = 0; i < 1000 && test_server_count(&server) < 1; i++) {
+        external_poll_once(loop, &table, 5);
+    }
+    CHECK(ctx->connected);
+    LONGS_EQUAL(1, test_server_count(&server));
+    STRCMP_EQUAL("{\"type\":\"test.hello\"}", server.messages[0]);
+
+    // 通知的fd中有连到服务端的socket
+    CHECK(table.adds > 0);
+    bool found = false;
+    for (int i = 0; i < table.count; i++) {
+        struct sockaddr_in peer;
+        socklen_t len = sizeof(peer);
+        if (getpeername(table.fds[i].fd, (struct sockaddr *) &peer, &len) == 0 && ntohs(peer.sin_port) == server.port) {
+            found = true;
+        }
+    }
+    CHECK(found);
+
+    aigw_ws_deinit(ctx);
+    aigw_ws_loop_release(loop);
+}
+
+// 重连等待按初始间隔的2的幂增长并封顶，随机部分落在[delay/2, delay]
+TEST(realtime_ws, test_reconnect_backoff) {
+    LONGS_EQUAL(AIGW_WS_RECONNECT_BASE_MS / 2, aigw_ws_reconnect_delay_ms(0, 0, 0));
+    LONGS_EQUAL(AIGW_WS_RECONNECT_BASE_MS, aigw_ws_reconnect_delay_ms(-1, 0, AIGW_WS_RECONNECT_BASE_MS / 2));
+    uint32_t delay = 100;
+    for (uint16_t retry = 0; retry < 20; retry++) {
+        LONGS_EQUAL(delay / 2, aigw_ws_reconnect_delay_ms(100, retry, 0));
+        LONGS_EQUAL(delay, aigw_ws_reconnect_delay_ms(100, retry, delay / 2));
+        for (uint32_t random = 0; random < 1000; random += 7) {
+            uint32_t d = aigw_ws_reconnect_delay_ms(100, retry, random * 7919);
+            CHECK(d >= delay / 2 && d <= delay);
+        }
+        delay = delay * 2 < AIGW_WS_RECONNECT_MAX_MS ? delay * 2 : AIGW_WS_RECONNECT_MAX_MS;
+    }
+    LONGS_EQUAL(AIGW_WS_RECONNECT_MAX_MS, aigw_ws_reconnect_delay_ms(100, UINT16_MAX, AIGW_WS_RECONNECT_MAX_MS / 2));
+    LONGS_EQUAL(AIGW_WS_RECONNECT_MAX_MS, aigw_ws_reconnect_delay_ms(INT32_MAX, 0, AIGW_WS_RECONNECT_MAX_MS / 2));
+}
+
+// 服务端断开后自动重连：新连接上先重放session.update，再发送断连期间排队的消息，调用方不阻塞
+TEST(realtime_ws, test_reconnect_replays_session) {
+    aigw_ws_ctx_t *ctx = open_session(NULL, 20);
+    aigw_ws_loop_t *loop = ctx->loop;
+    aigw_ws_session_t session = DEFAULT_SESSION;
+    session.instructions = "replay";
+    LONGS_EQUAL(VOLC_OK, aigw_ws_connect(ctx));
+    LONGS_EQUAL(VOLC_OK, aigw_ws_session_update(ctx, &session));
+    CHECK(service_until(loop, 5000, [&]() { return test_server_count(&server) >= 1; }));
+
+    LONGS_EQUAL(VOLC_OK, aigw_ws_send_request(ctx, "{\"type\":\"test.drop\"}"));
+    CHECK(service_until(loop, 5000, [&]() { return !ctx->connected; }));
+    int64_t start = now_us();
+    LONGS_EQUAL(VOLC_OK, aigw_ws_send_request(ctx, "{\"type\":\"test.queued\"}"));
+    CHECK(now_us() - start < 10000);
+
+    CHECK(service_until(loop, 5000, [&]() { return test_server_count(&server) >= 4; }));
+    CHECK(ctx->connected);
+    LONGS_EQUAL(0, ctx->retry_count);
+    LONGS_EQUAL(4, test_server_count(&server));
+    CHECK(strstr(server.messages[0], "\"session.update\"") != NULL);
+    CHECK(strstr(server.messages[0], "\"replay\"") != NULL);
+    LONGS_EQUAL(1, server.message_conn[0]);
+    STRCMP_EQUAL("{\"type\":\"test.drop\"}", server.messages[1]);
+    STRCMP_EQUAL(server.messages[0], server.messages[2]);
+    LONGS_EQUAL(2, server.message_conn[2]);
+    STRCMP_EQUAL("{\"type\":\"test.queued\"}", server.messages[3]);
+    LONGS_EQUAL(2, server.message_conn[3]);
+
+    aigw_ws_deinit(ctx);
+}
+
+// 共享循环上的会话在连接中销毁，连接随后在循环上异步关闭，不再访问已释放的会话
+TEST(realtime_ws, test_deinit_while_connected_on_shared_loop) {
+    aigw_ws_loop_t *loop = aigw_ws_loop_create(NULL, NULL);
+    CHECK(loop != NULL);
+    aigw_ws_ctx_t *ctx = open_session(loop, 0);
+    aigw_ws_ctx_t *other = open_session(loop, 0);
+    LONGS_EQUAL(VOLC_OK, aigw_ws_connect(ctx));
+    LONGS_EQUAL(VOLC_OK, aigw_ws_connect(other));
+    CHECK(service_until(loop, 5000, [&]() { return ctx->connected && other->connected; }));
+
+    aigw_ws_deinit(ctx);
+    LONGS_EQUAL(VOLC_OK, aigw_ws_send_request(other, "{\"type\":\"test.after\"}"));
+    CHECK(service_until(loop, 5000, [&]() { return test_server_count(&server) >= 1; }));
+    STRCMP_EQUAL("{\"type\":\"test.after\"}", server.messages[0]);
+    aigw_ws_loop_service_once(loop, -1);
+
+    aigw_ws_deinit(other);
+    aigw_ws_loop_release(loop);
+}
+
+// 事件循环线程阻塞等待时入队的消息立即写出，入队到服务端收到的p99小于5ms
+TEST(realtime_ws, test_enqueue_to_wire_latency) {
+    aigw_ws_ctx_t *ctx = open_session(NULL, 0);
+    aigw_ws_loop_t *loop = ctx->loop;
+    received_t received;
+    aigw_ws_register_callback(ctx, record_message, &received);
+    LONGS_EQUAL(VOLC_OK, aigw_ws_connect(ctx));
+    CHECK(service_until(loop, 5000, [&]() {
+        std::lock_guard<std::mutex> guard(received.lock);
+        return ctx->connected && !received.messages.empty();
+    }));
+    STRCMP_EQUAL(SERVER_GREETING, received.messages[0].c_str());
+
+    loop_thread_t loop_thread;
+    loop_thread.start(loop);
+    std::vector<int64_t> enqueue_us(LATENCY_MESSAGES);
+    for (int i = 0; i < LATENCY_MESSAGES; i++) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "{\"type\":\"test.latency\",\"seq\":%d}", i);
+        enqueue_us[i] = now_us();
+        LONGS_EQUAL(VOLC_OK, aigw_ws_send_request(ctx, msg));
+        // 间隔发送，保证每条消息都在循环线程阻塞时入队
+        usleep(2000);
+    }
+    for (int i = 0; i < 1000 && test_server_count(&server) < LATENCY_MESSAGES; i++) {
+        usleep(5000);
+    }
+    loop_thread.stop(loop);
+
+    LONGS_EQUAL(LATENCY_MESSAGES, test_server_count(&server));
+    std::vector<int64_t> latency(LATENCY_MESSAGES);
+    for (int i = 0; i < LATENCY_MESSAGES; i++) {
+        char expected[64];
+        snprintf(expected, sizeof(expected), "{\"type\":\"test.latency\",\"seq\":%d}", i);
+        STRCMP_EQUAL(expected, server.messages[i]);
+        latency[i] = server.message_us[i] - enqueue_us[i];
+    }
+    int64_t p50 = percentile(latency, 50);
+    int64_t p99 = percentile(latency, 99);
+    UT_PRINT(StringFromFormat("enqueue to wire: p50 %lldus, p99 %lldus, max %lldus", (long long) p50,
+                              (long long) p99, (long long) percentile(latency, 100)).asCharString());
+    CHECK(p99 < 5000);
+
+    aigw_ws_deinit(ctx);
+}
+
+// 对端正常回pong时连接保持；对端失去响应后在ping间隔加pong超时内断开并开始重连
+TEST(realtime_ws, test_pong_timeout_drops_dead_connection) {
+    aigw_ws_ctx_t *ctx = open_session(NULL, 20, 1, 1);
+    aigw_ws_loop_t *loop = ctx->loop;
+    LONGS_EQUAL(VOLC_OK, aigw_ws_connect(ctx));
+    CHECK(service_until(loop, 5000, [&]() { return ctx->connected; }));
+
+    // 经过两轮ping仍在同一连接上
+    CHECK(!service_until(loop, 2500, [&]() { return !ctx->connected; }));
+    LONGS_EQUAL(1, server.connections);
+
+    server.paused = true;
+    int64_t start = now_us();
+    CHECK(service_until(loop, 4000, [&]() { return !ctx->connected; }));
+    int64_t elapsed_ms = (now_us() - start) / 1000;
+    CHECK(elapsed_ms <= 2000 + 500);
+    UT_PRINT(StringFromFormat("dead connection detected in %lldms", (long long) elapsed_ms).asCharString());
+
+    server.paused = false;
+    CHECK(service_until(loop, 5000, [&]() { return ctx->connected; }));
+    CHECK(server.connections >= 2);
+
+    aigw_ws_deinit(ctx);
+}
+
+// 新的session.update序列化经真实连接往返：服务端收到的帧与序列化结果一致，且能被解析出各字段
+TEST(realtime_ws, test_session_update_round_trip) {
+    aigw_ws_session_tools_t tools[2];
+    memset(tools, 0, sizeof(tools));
+    tools[0].name = (char *) "open_light";
+    tools[0].description = (char *) "开灯";
+    tools[0].parameters = (char *) "{\"type\":\"object\"}";
+    tools[1].name = (char *) "get_weather";
+    tools[1].parameters = (char *) "{\"type\":\"object\",\"required\":[\"city\"]}";
+    aigw_ws_turn_detection_t vad;
+    memset(&vad, 0, sizeof(vad));
+    vad.type = "server_vad";
+    vad.silence_duration_ms = 500;
+    aigw_ws_session_t session = DEFAULT_SESSION;
+    session.instructions = "say \"hi\"\n";
+    session.tools = tools;
+    session.num_tools = 2;
+    session.turn_detection = &vad;
+
+    struct aws_byte_buf expected;
+    aws_byte_buf_init(&expected, aws_alloc(), 512);
+    LONGS_EQUAL(VOLC_OK, aigw_ws_session_update_to_json(&session, &expected));
+
+    aigw_ws_ctx_t *ctx = open_session(NULL, 0);
+    LONGS_EQUAL(VOLC_OK, aigw_ws_connect(ctx));
+    LONGS_EQUAL(VOLC_OK, aigw_ws_session_update(ctx, &session));
+    CHECK(service_until(ctx->loop, 5000, [&]() { return test_server_count(&server) >= 1; }));
+    STRCMP_EQUAL((const char *) expected.buffer, server.messages[0]);
+
+    cJSON *root = cJSON_Parse(server.messages[0]);
+    CHECK(root != NULL);
+    STRCMP_EQUAL("session.update", cJSON_GetObjectItem(root, "type")->valuestring);
+    cJSON *body = cJSON_GetObjectItem(root, "session");
+    STRCMP_EQUAL("say \"hi\"\n", cJSON_GetObjectItem(body, "instructions")->valuestring);
+    LONGS_EQUAL(500, cJSON_GetObjectItem(cJSON_GetObjectItem(body, "turn_detection"), "silence_duration_ms")->valueint);
+    cJSON *tool_list = cJSON_GetObjectItem(body, "tools");
+    LONGS_EQUAL(2, cJSON_GetArraySize(tool_list));
+    cJSON *required = cJSON_GetObjectItem(cJSON_GetObjectItem(cJSON_GetArrayItem(tool_list, 1), "parameters"), "required");
+    STRCMP_EQUAL("city", cJSON_GetArrayItem(required, 0)->valuestring);
+    cJSON_Delete(root);
+
+    aws_byte_buf_clean_up(&expected);
+    aigw_ws_deinit(ctx);
+}
+
+// 空闲时service_once最多阻塞timeout_ms，<=0 不等待；lws自身会一直等到下一个事件或定时器
+TEST(realtime_ws, test_service_once_bounded_wait) {
+    aigw_ws_ctx_t *ctx = open_session(NULL, 0);
+    aigw_ws_loop_t *loop = ctx->loop;
+    LONGS_EQUAL(VOLC_OK, aigw_ws_connect(ctx));
+    CHECK(service_until(loop, 5000, [&]() { return ctx->connected && test_server_count(&server) == 0; }));
+    // 处理完连接建立后的欢迎消息
+    for (int i = 0; i < 10; i++) {
+        aigw_ws_loop_service_once(loop, 0);
+    }
+
+    int64_t start = now_us();
+    aigw_ws_loop_service_once(loop, 0);
+    CHECK(now_us() - start < 20000);
+    start = now_us();
+    CHECK(aigw_ws_loop_service_once(loop, 50) >= 0);
+    int64_t waited_us = now_us() - start;
+    // lws自身的秒级定时器可能让它提前返回，这里只检查上限
+    CHECK(waited_us < 200000);
+
+    aigw_ws_deinit(ctx);
+}
+
+// 外部循环用fd<0驱动定时器：服务端断开后的重连只靠定时器触发
+TEST(realtime_ws, test_service_fd_runs_timers) {
+    poll_table_t table;
+    memset(&table, 0, sizeof(table));
+    aigw_ws_loop_t *loop = aigw_ws_loop_create(record_poll, &table);
+    aigw_ws_ctx_t *ctx = open_session(loop, 20);
+    LONGS_EQUAL(VOLC_OK, aigw_ws_connect(ctx));
+    LONGS_EQUAL(VOLC_OK, aigw_ws_send_request(ctx, "{\"type\":\"test.drop\"}"));
+    for (int i = 0; i < 1000 && (server.connections < 2 || !ctx->connected); i++) {
+        external_poll_once(loop, &table, 5);
+    }
+    CHECK(ctx->connected);
+    CHECK(server.connections >= 2);
+
+    aigw_ws_deinit(ctx);
+    aigw_ws_loop_release(loop);
+}
+
+// 100个会话共享一个循环，由单个线程服务，全部连接并各自发出消息
+TEST(realtime_ws, test_many_sessions_single_thread) {
+    aigw_ws_loop_t *loop = aigw_ws_loop_create(NULL, NULL);
+    CHECK(loop != NULL);
+    std::vector<aigw_ws_ctx_t *> sessions;
+    for (int i = 0; i < SHARED_SESSIONS; i++) {
+        aigw_ws_ctx_t *ctx = open_session(loop, 0);
+        LONGS_EQUAL(VOLC_OK, aigw_ws_connect(ctx));
+        sessions.push_back(ctx);
+    }
+    for (int i = 0; i < SHARED_SESSIONS; i++) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "{\"type\":\"test.session\",\"id\":%d}", i);
+        LONGS_EQUAL(VOLC_OK, aigw_ws_send_request(sessions[i], msg));
+    }
+    int64_t start = now_us();
+    CHECK(service_until(loop, 10000, [&]() { return test_server_count(&server) >= SHARED_SESSIONS; }));
+    UT_PRINT(StringFromFormat("%d sessions on one thread delivered in %lldms", SHARED_SESSIONS,
+                              (long long) ((now_us() - start) / 1000)).asCharString());
+
+    LONGS_EQUAL(SHARED_SESSIONS, test_server_count(&server));
+    LONGS_EQUAL(SHARED_SESSIONS, server.connections);
+    std::vector<bool> seen(SHARED_SESSIONS, false);
+    for (int i = 0; i < SHARED_SESSIONS; i++) {
+        int id = -1;
+        CHECK(sscanf(server.messages[i], "{\"type\":\"test.session\",\"id\":%d}", &id) == 1);
+        CHECK(id >= 0 && id < SHARED_SESSIONS && !seen[id]);
+        seen[id] = true;
+    }
+    for (aigw_ws_ctx_t *ctx : sessions) {
+        CHECK(ctx->connected);
+        aigw_ws_deinit(ctx);
+    }
+    aigw_ws_loop_release(loop);
+}
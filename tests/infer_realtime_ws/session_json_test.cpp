@@ -0,0 +1,131 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+  #include "CppUTest/TestHarness_c.h"
+  #include "infer_realtime_ws.h"
+  #include "util/util.h"
+  #include "error_code.h"
+}
+
+// golden：与网关约定的session.update字段顺序
+#define GOLDEN_DEFAULT_SESSION \
+    "{\"type\":\"session.update\",\"session\":{\"modalities\":[\"audio\"]," \
+    "\"instructions\":\"hi\",\"voice\":\"v1\",\"input_audio_format\":\"pcm16\",\"output_audio_format\":\"pcm16\"," \
+    "\"tool_choice\":\"auto\",\"turn_detection\":null,\"input_audio_transcription\":{\"model\":\"any\"}," \
+    "\"tools\":[],\"temperature\":0.8}}"
+
+#define GOLDEN_FULL_SESSION \
+    "{\"type\":\"session.update\",\"session\":{\"modalities\":[\"audio\",\"text\"]," \
+    "\"instructions\":\"say \\\"hi\\\"\\n\",\"tool_choice\":\"required\"," \
+    "\"turn_detection\":{\"type\":\"server_vad\",\"threshold\":0.5,\"prefix_padding_ms\":300,\"silence_duration_ms\":500}," \
+    "\"input_audio_transcription\":null," \
+    "\"tools\":[{\"type\":\"function\",\"name\":\"open_light\",\"description\":\"开灯\",\"parameters\":{\"type\":\"object\"}}," \
+    "{\"type\":\"function\",\"name\":\"get_weather\",\"parameters\":{\"type\":\"object\",\"required\":[\"city\"]}}]," \
+    "\"temperature\":1.1,\"max_response_output_tokens\":256}}"
+
+#define GOLDEN_FUNCTION_OUTPUT \
+    "{\"type\":\"conversation_item.create\",\"item\":{\"call_id\":\"call_1\",\"type\":\"function_call_output\"," \
+    "\"output\":{\"temp\":21.5}}}"
+
+TEST_GROUP(realtime_session) {
+    struct aws_byte_buf buf;
+    void setup() {
+        aws_byte_buf_init(&buf, aws_alloc(), 16);
+    }
+
+    void teardown() {
+        aws_byte_buf_clean_up(&buf);
+    }
+};
+
+TEST(realtime_session, test_default_session) {
+    aigw_ws_session_t session = DEFAULT_SESSION;
+    session.instructions = "hi";
+    session.voice = "v1";
+    LONGS_EQUAL(0, aigw_ws_session_update_to_json(&session, &buf));
+    STRCMP_EQUAL(GOLDEN_DEFAULT_SESSION, (const char *)buf.buffer);
+}
+
+TEST(realtime_session, test_full_session) {
+    aigw_ws_session_tools_t tools[2];
+    memset(tools, 0, sizeof(tools));
+    tools[0].type = (char *)"function";
+    tools[0].name = (char *)"open_light";
+    tools[0].description = (char *)"开灯";
+    tools[0].parameters = (char *)"{\"type\":\"object\"}";
+    tools[1].name = (char *)"get_weather";
+    tools[1].parameters = (char *)"{\"type\":\"object\",\"required\":[\"city\"]}";
+
+    aigw_ws_turn_detection_t vad;
+    memset(&vad, 0, sizeof(vad));
+    vad.type = "server_vad";
+    vad.threshold = 0.5;
+    vad.prefix_padding_ms = 300;
+    vad.silence_duration_ms = 500;
+
+    aigw_ws_session_t session;
+    memset(&session, 0, sizeof(session));
+    session.instructions = "say \"hi\"\n";
+    session.modality_audio_enabled = true;
+    session.modality_text_enabled = true;
+    session.tools = tools;
+    session.num_tools = 2;
+    session.tool_choice = "required";
+    session.turn_detection = &vad;
+    session.temperature = 1.1;
+    session.max_response_output_tokens = 256;
+    LONGS_EQUAL(0, aigw_ws_session_update_to_json(&session, &buf));
+    STRCMP_EQUAL(GOLDEN_FULL_SESSION, (const char *)buf.buffer);
+}
+
+TEST(realtime_session, test_function_output) {
+    LONGS_EQUAL(0, aigw_ws_function_output_to_json("call_1", "{\"temp\":21.5}", &buf));
+    STRCMP_EQUAL(GOLDEN_FUNCTION_OUTPUT, (const char *)buf.buffer);
+}
+
+TEST(realtime_session, test_function_output_without_call_id) {
+    CHECK(aigw_ws_function_output_to_json(NULL, "{}", &buf) != 0);
+}
+
+// 原样下发的JSON片段不合法时拒绝，不产生残缺的帧
+TEST(realtime_session, test_reject_invalid_raw_json) {
+    aigw_ws_session_tools_t tools[2];
+    memset(tools, 0, sizeof(tools));
+    tools[0].name = (char *)"ok";
+    tools[0].parameters = (char *)"{\"type\":\"object\"}";
+    tools[1].name = (char *)"broken";
+    tools[1].parameters = (char *)"{\"type\":\"object\"";
+    aigw_ws_session_t session = DEFAULT_SESSION;
+    session.tools = tools;
+    session.num_tools = 2;
+    LONGS_EQUAL(VOLC_ERR_INVALID_PARAM, aigw_ws_session_update_to_json(&session, &buf));
+    tools[1].parameters = (char *)"{} trailing";
+    LONGS_EQUAL(VOLC_ERR_INVALID_PARAM, aigw_ws_session_update_to_json(&session, &buf));
+    tools[1].parameters = NULL;
+    LONGS_EQUAL(VOLC_OK, aigw_ws_session_update_to_json(&session, &buf));
+
+    LONGS_EQUAL(VOLC_ERR_INVALID_PARAM, aigw_ws_function_output_to_json("call_1", "{\"temp\":", &buf));
+}
+
+// 关闭输入转写时下发null
+TEST(realtime_session, test_transcription_disabled) {
+    aigw_ws_session_t session = DEFAULT_SESSION;
+    session.input_audio_transcription = false;
+    LONGS_EQUAL(VOLC_OK, aigw_ws_session_update_to_json(&session, &buf));
+    CHECK(strstr((const char *)buf.buffer, "\"input_audio_transcription\":null") != NULL);
+}
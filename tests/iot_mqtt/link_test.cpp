@@ -0,0 +1,246 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+  #include "CppUTest/TestHarness_c.h"
+  #include "onesdk_config.h"
+  #include "iot_mqtt.h"
+  #include "error_code.h"
+}
+
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#define SEC_US(s) ((int64_t) (s) * 1000000)
+
+#define HOOK_DEADLINE_MS 50
+
+static int64_t now_ms() {
+    return (int64_t) std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+typedef struct {
+    std::atomic<int> calls;
+    int32_t first_next_ms;      // 第一次调用返回的到期时间，之后返回-1
+} hook_state_t;
+
+static int32_t counting_hook(void *user_data) {
+    hook_state_t *state = (hook_state_t *) user_data;
+    return state->calls++ == 0 ? state->first_next_ms : -1;
+}
+
+static struct lws_context *create_idle_context() {
+    struct lws_context_creation_info info;
+    memset(&info, 0, sizeof(info));
+    info.port = CONTEXT_PORT_NO_LISTEN;
+    return lws_create_context(&info);
+}
+
+static void record_suspect(iot_mqtt_link_suspect_reason_t reason, void *user_data) {
+    ((std::vector<iot_mqtt_link_suspect_reason_t> *) user_data)->push_back(reason);
+}
+
+TEST_GROUP(mqtt_link) {
+    iot_mqtt_config_t config;
+    iot_mqtt_ctx_t ctx;
+    std::vector<iot_mqtt_link_suspect_reason_t> reasons;
+
+    void setup() {
+        memset(&config, 0, sizeof(config));
+        memset(&ctx, 0, sizeof(ctx));
+        ctx.config = &config;
+        lws_pthread_mutex_init(&ctx.rtt_mutex);
+        reasons.clear();
+    }
+
+    void teardown() {
+        free(ctx.rtt_hist);
+        lws_pthread_mutex_destroy(&ctx.rtt_mutex);
+    }
+
+    // 模拟连接建立：回到配置的ping间隔
+    void establish(int64_t now_us) {
+        ctx.is_connected = true;
+        iot_mqtt_on_broker_rx(&ctx, now_us);
+        ctx.ping_adapted_us = now_us;
+        iot_mqtt_apply_ping_interval(&ctx, (uint16_t) config.ping_interval);
+    }
+};
+
+// lws的ping与挂断时限跟随当前ping间隔，挂断时限为间隔加PINGRESP时限
+TEST(mqtt_link, test_retry_policy_follows_ping_interval) {
+    iot_mqtt_apply_ping_interval(&ctx, 30);
+    LONGS_EQUAL(30, ctx.ping_interval_s);
+    LONGS_EQUAL(30, ctx.retry.secs_since_valid_ping);
+    LONGS_EQUAL(30 + IOT_MQTT_DEFAULT_PINGRESP_TIMEOUT_S, ctx.retry.secs_since_valid_hangup);
+
+    config.pingresp_timeout_s = 3;
+    iot_mqtt_apply_ping_interval(&ctx, 120);
+    LONGS_EQUAL(120, ctx.retry.secs_since_valid_ping);
+    LONGS_EQUAL(123, ctx.retry.secs_since_valid_hangup);
+
+    // RTT得到的下限更大时使用下限
+    ctx.rtt_pingresp_timeout_s = 9;
+    iot_mqtt_apply_ping_interval(&ctx, 120);
+    LONGS_EQUAL(129, ctx.retry.secs_since_valid_hangup);
+}
+
+// 持续收到broker报文时每个间隔加倍，不超过keep_alive；空闲一个间隔后回到ping_interval
+TEST(mqtt_link, test_ping_interval_adapts_to_traffic) {
+    config.ping_interval = 10;
+    config.ping_interval_max_s = 80;
+    config.keep_alive = 60;
+    config.pingresp_timeout_s = 5;
+    establish(0);
+    LONGS_EQUAL(10, ctx.ping_interval_s);
+
+    // 不足一个间隔不调整
+    iot_mqtt_on_broker_rx(&ctx, SEC_US(5));
+    iot_mqtt_adapt_ping_interval(&ctx, SEC_US(9));
+    LONGS_EQUAL(10, ctx.ping_interval_s);
+
+    iot_mqtt_adapt_ping_interval(&ctx, SEC_US(10));
+    LONGS_EQUAL(20, ctx.ping_interval_s);
+    LONGS_EQUAL(20, ctx.retry.secs_since_valid_ping);
+    LONGS_EQUAL(25, ctx.retry.secs_since_valid_hangup);
+
+    int64_t now = SEC_US(10);
+    const uint16_t expected[] = {40, 60, 60};
+    for (uint16_t interval : expected) {
+        iot_mqtt_on_broker_rx(&ctx, now + SEC_US(1));
+        now += SEC_US(ctx.ping_interval_s);
+        iot_mqtt_adapt_ping_interval(&ctx, now);
+        LONGS_EQUAL(interval, ctx.ping_interval_s);
+    }
+    LONGS_EQUAL(65, ctx.retry.secs_since_valid_hangup);
+
+    // 一个间隔内没有broker报文
+    now += SEC_US(ctx.ping_interval_s);
+    iot_mqtt_adapt_ping_interval(&ctx, now);
+    LONGS_EQUAL(10, ctx.ping_interval_s);
+    LONGS_EQUAL(15, ctx.retry.secs_since_valid_hangup);
+}
+
+// 未设置ping_interval_max_s或不大于ping_interval时间隔固定
+TEST(mqtt_link, test_ping_interval_fixed_without_max) {
+    config.ping_interval = 30;
+    establish(0);
+    iot_mqtt_on_broker_rx(&ctx, SEC_US(10));
+    iot_mqtt_adapt_ping_interval(&ctx, SEC_US(30));
+    LONGS_EQUAL(30, ctx.ping_interval_s);
+
+    config.ping_interval_max_s = 30;
+    iot_mqtt_on_broker_rx(&ctx, SEC_US(40));
+    iot_mqtt_adapt_ping_interval(&ctx, SEC_US(60));
+    LONGS_EQUAL(30, ctx.ping_interval_s);
+
+    // keep_alive不大于ping_interval时同样不加倍
+    config.ping_interval_max_s = 120;
+    config.keep_alive = 20;
+    iot_mqtt_on_broker_rx(&ctx, SEC_US(70));
+    iot_mqtt_adapt_ping_interval(&ctx, SEC_US(90));
+    LONGS_EQUAL(30, ctx.ping_interval_s);
+}
+
+// PUBACK超时在链路恢复前只回调一次；已建立的连接断开时回调，未建立的连接失败不回调
+TEST(mqtt_link, test_link_suspect_callback) {
+    config.ping_interval = 30;
+    establish(0);
+    // 未设置回调
+    iot_mqtt_on_puback_timeout(&ctx);
+    CHECK(ctx.link_suspect);
+    iot_mqtt_on_broker_rx(&ctx, SEC_US(1));
+    CHECK(!ctx.link_suspect);
+
+    iot_mqtt_set_link_suspect_callback(&ctx, record_suspect, &reasons);
+    iot_mqtt_on_puback_timeout(&ctx);
+    iot_mqtt_on_puback_timeout(&ctx);
+    LONGS_EQUAL(1, reasons.size());
+    LONGS_EQUAL(IOT_MQTT_LINK_PUBACK_TIMEOUT, reasons[0]);
+
+    iot_mqtt_on_broker_rx(&ctx, SEC_US(2));
+    iot_mqtt_on_puback_timeout(&ctx);
+    LONGS_EQUAL(2, reasons.size());
+
+    iot_mqtt_on_link_closed(&ctx);
+    CHECK(!ctx.is_connected);
+    LONGS_EQUAL(3, reasons.size());
+    LONGS_EQUAL(IOT_MQTT_LINK_LOST, reasons[2]);
+
+    // 重连失败的连接关闭不再上报
+    iot_mqtt_on_link_closed(&ctx);
+    LONGS_EQUAL(3, reasons.size());
+}
+
+// lws_service不按超时参数返回，钩子的到期时间由定时器保证
+TEST(mqtt_link, test_loop_hook_runs_at_deadline) {
+    ctx.context = create_idle_context();
+    CHECK(ctx.context != NULL);
+    hook_state_t state;
+    state.calls = 0;
+    state.first_next_ms = HOOK_DEADLINE_MS;
+    iot_mqtt_set_loop_hook(&ctx, counting_hook, &state);
+
+    int64_t start = now_ms();
+    while (state.calls < 2 && now_ms() - start < 1000) {
+        iot_mqtt_run_event_loop(&ctx, 0);
+    }
+    int64_t elapsed = now_ms() - start;
+    CHECK(state.calls >= 2);
+    CHECK(elapsed >= HOOK_DEADLINE_MS - 5);
+    CHECK(elapsed < 500);
+
+    iot_mqtt_set_loop_hook(&ctx, NULL, NULL);
+    iot_mqtt_run_event_loop(&ctx, -1);
+    lws_context_destroy(ctx.context);
+}
+
+// 钩子没有待办任务时服务线程一直等待，其他线程唤醒后立即返回并重新运行钩子
+TEST(mqtt_link, test_wakeup_reruns_loop_hook) {
+    ctx.context = create_idle_context();
+    CHECK(ctx.context != NULL);
+    hook_state_t state;
+    state.calls = 0;
+    state.first_next_ms = -1;
+    iot_mqtt_set_loop_hook(&ctx, counting_hook, &state);
+    // 消耗设置钩子时的唤醒
+    iot_mqtt_run_event_loop(&ctx, 0);
+
+    std::atomic<bool> woken(false);
+    std::thread waker([this, &woken]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(HOOK_DEADLINE_MS));
+        woken = true;
+        iot_mqtt_wakeup(&ctx);
+    });
+    int64_t start = now_ms();
+    while (!woken && now_ms() - start < 1000) {
+        iot_mqtt_run_event_loop(&ctx, 0);
+    }
+    int calls = state.calls;
+    iot_mqtt_run_event_loop(&ctx, -1);
+    waker.join();
+    CHECK(now_ms() - start < 500);
+    CHECK(state.calls > calls);
+
+    iot_mqtt_set_loop_hook(&ctx, NULL, NULL);
+    iot_mqtt_run_event_loop(&ctx, -1);
+    lws_context_destroy(ctx.context);
+}
@@ -0,0 +1,342 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+  #include "CppUTest/TestHarness_c.h"
+  #include "iot/iot_mqtt_pub_queue.h"
+  #include "error_code.h"
+}
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TEST_TOPIC "sys/pk/dn/thingmodel/property/post"
+#define TEST_PAYLOAD "{\"temp\":21.5}"
+
+// 模拟lws按发送顺序分配packet_id，跳过0
+static uint16_t next_packet_id(uint16_t id) {
+    return id == 0xffff ? 1 : id + 1;
+}
+
+// 发送待发布队列头部的消息，转入在途
+static iot_mqtt_msg_t *send_next(iot_mqtt_pub_queue_t *q, uint16_t *packet_id) {
+    iot_mqtt_msg_t *msg = iot_mqtt_pub_queue_peek(q);
+    if (msg == NULL || iot_mqtt_pub_queue_window_full(q)) {
+        return NULL;
+    }
+    *packet_id = next_packet_id(*packet_id);
+    msg->pub.packet_id = *packet_id;
+    LONGS_EQUAL(0, iot_mqtt_pub_queue_inflight_add(q, msg));
+    return msg;
+}
+
+TEST_GROUP(mqtt_pub_queue) {
+    iot_mqtt_pub_queue_t q;
+    uint16_t packet_id;
+
+    void setup() {
+        packet_id = 0;
+        LONGS_EQUAL(0, iot_mqtt_pub_queue_init(&q, 32, 10000, IOT_MQTT_OVERFLOW_REJECT));
+    }
+
+    void teardown() {
+        iot_mqtt_pub_queue_deinit(&q);
+    }
+
+    void reinit(uint16_t window, uint32_t capacity, iot_mqtt_overflow_policy_t overflow) {
+        iot_mqtt_pub_queue_deinit(&q);
+        LONGS_EQUAL(0, iot_mqtt_pub_queue_init(&q, window, capacity, overflow));
+    }
+
+    int push_one(const char *payload) {
+        iot_mqtt_msg_t *msg = NULL;
+        int ret = iot_mqtt_pub_queue_alloc(&q, TEST_TOPIC, (const uint8_t *)payload, strlen(payload), 1, &msg);
+        if (ret == VOLC_OK) {
+            iot_mqtt_pub_queue_push(&q, msg);
+        }
+        return ret;
+    }
+
+    void push(size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            LONGS_EQUAL(VOLC_OK, push_one(TEST_PAYLOAD));
+        }
+    }
+};
+
+TEST(mqtt_pub_queue, test_msg_copies_topic_and_payload) {
+    char topic[] = TEST_TOPIC;
+    iot_mqtt_msg_t *msg = NULL;
+    LONGS_EQUAL(VOLC_OK, iot_mqtt_pub_queue_alloc(&q, topic, (const uint8_t *)TEST_PAYLOAD,
+        strlen(TEST_PAYLOAD), 1, &msg));
+    topic[0] = 'x';
+    STRCMP_EQUAL(TEST_TOPIC, msg->pub.topic);
+    LONGS_EQUAL(strlen(TEST_TOPIC), msg->pub.topic_len);
+    MEMCMP_EQUAL(TEST_PAYLOAD, msg->pub.payload, strlen(TEST_PAYLOAD));
+    iot_mqtt_pub_queue_release(&q, msg);
+}
+
+TEST(mqtt_pub_queue, test_overflow_reject) {
+    reinit(1, 4, IOT_MQTT_OVERFLOW_REJECT);
+    push(4);
+    LONGS_EQUAL(VOLC_ERR_MQTT_PUB_QUEUE_FULL, push_one(TEST_PAYLOAD));
+    // 在途消息同样占用容量
+    send_next(&q, &packet_id);
+    LONGS_EQUAL(VOLC_ERR_MQTT_PUB_QUEUE_FULL, push_one(TEST_PAYLOAD));
+    iot_mqtt_pub_queue_release(&q, iot_mqtt_pub_queue_ack_oldest(&q));
+    LONGS_EQUAL(VOLC_OK, push_one(TEST_PAYLOAD));
+}
+
+TEST(mqtt_pub_queue, test_overflow_drop_oldest) {
+    char payload[8];
+    reinit(1, 4, IOT_MQTT_OVERFLOW_DROP_OLDEST);
+    for (int i = 0; i < 6; i++) {
+        snprintf(payload, sizeof(payload), "%d", i);
+        LONGS_EQUAL(VOLC_OK, push_one(payload));
+    }
+    LONGS_EQUAL(2, q.dropped);
+    LONGS_EQUAL(4, q.pending.count);
+    MEMCMP_EQUAL("2", iot_mqtt_pub_queue_peek(&q)->pub.payload, 1);
+
+    // 在途消息不会被丢弃，全部在途时仍返回队列满
+    reinit(2, 2, IOT_MQTT_OVERFLOW_DROP_OLDEST);
+    push(2);
+    send_next(&q, &packet_id);
+    send_next(&q, &packet_id);
+    LONGS_EQUAL(VOLC_ERR_MQTT_PUB_QUEUE_FULL, push_one(TEST_PAYLOAD));
+}
+
+TEST(mqtt_pub_queue, test_window_limits_inflight) {
+    push(40);
+    uint16_t sent = 0;
+    while (send_next(&q, &packet_id)) {
+        sent++;
+    }
+    LONGS_EQUAL(32, sent);
+    LONGS_EQUAL(32, q.inflight.count);
+    LONGS_EQUAL(8, q.pending.count);
+    CHECK(iot_mqtt_pub_queue_window_full(&q));
+
+    iot_mqtt_pub_queue_release(&q, iot_mqtt_pub_queue_ack_oldest(&q));
+    CHECK_FALSE(iot_mqtt_pub_queue_window_full(&q));
+    CHECK(send_next(&q, &packet_id) != NULL);
+    LONGS_EQUAL(33, packet_id);
+}
+
+// 按发送顺序确认，没有在途消息时返回NULL
+TEST(mqtt_pub_queue, test_ack_follows_send_order) {
+    push(3);
+    iot_mqtt_msg_t *first = send_next(&q, &packet_id);
+    iot_mqtt_msg_t *second = send_next(&q, &packet_id);
+    send_next(&q, &packet_id);
+    POINTERS_EQUAL(first, iot_mqtt_pub_queue_oldest(&q));
+    POINTERS_EQUAL(first, iot_mqtt_pub_queue_ack_oldest(&q));
+    iot_mqtt_pub_queue_release(&q, first);
+    POINTERS_EQUAL(second, iot_mqtt_pub_queue_oldest(&q));
+    iot_mqtt_pub_queue_release(&q, iot_mqtt_pub_queue_ack_oldest(&q));
+    LONGS_EQUAL(3, iot_mqtt_pub_queue_oldest(&q)->pub.packet_id);
+    iot_mqtt_pub_queue_release(&q, iot_mqtt_pub_queue_ack_oldest(&q));
+    LONGS_EQUAL(0, q.inflight.count);
+    POINTERS_EQUAL(NULL, iot_mqtt_pub_queue_ack_oldest(&q));
+}
+
+TEST(mqtt_pub_queue, test_mark_resend) {
+    push(2);
+    send_next(&q, &packet_id);
+    send_next(&q, &packet_id);
+    iot_mqtt_pub_queue_mark_resend(&q);
+    CHECK(iot_mqtt_pub_queue_oldest(&q)->resend);
+    iot_mqtt_msg_t *msg = iot_mqtt_pub_queue_ack_oldest(&q);
+    LONGS_EQUAL(1, msg->pub.packet_id);
+    CHECK(msg->resend);
+    iot_mqtt_pub_queue_release(&q, msg);
+}
+
+// 10k条排队消息以窗口32按序确认，验证确认开销与队列长度无关
+TEST(mqtt_pub_queue, test_10k_queued_messages) {
+    const size_t total = 10000;
+    size_t acked = 0;
+    push(total);
+    clock_t start = clock();
+    while (acked < total) {
+        size_t n = 0;
+        iot_mqtt_msg_t *msg;
+        while ((msg = send_next(&q, &packet_id)) != NULL) {
+            n++;
+        }
+        for (size_t i = 0; i < n; i++) {
+            msg = iot_mqtt_pub_queue_ack_oldest(&q);
+            CHECK(msg != NULL);
+            iot_mqtt_pub_queue_release(&q, msg);
+            acked++;
+        }
+    }
+    double ms = (double)(clock() - start) * 1000 / CLOCKS_PER_SEC;
+    LONGS_EQUAL(0, q.pending.count);
+    LONGS_EQUAL(0, q.inflight.count);
+    UT_PRINT(StringFromFormat("10k publishes acked in %.2f ms", ms).asCharString());
+}
+
+// 稳态突发发布：队列预热后每条消息不再向系统申请内存
+TEST(mqtt_pub_queue, test_burst_allocs_per_publish) {
+    const size_t total = 100000;
+    size_t published = 0;
+    reinit(32, 256, IOT_MQTT_OVERFLOW_REJECT);
+    push(256);
+    uint64_t warm_allocs = q.pool.sys_allocs;
+    while (published < total) {
+        iot_mqtt_msg_t *msg;
+        while (send_next(&q, &packet_id) != NULL) {
+            // 发满窗口
+        }
+        // 按序确认整个窗口后补满队列
+        while ((msg = iot_mqtt_pub_queue_ack_oldest(&q)) != NULL) {
+            iot_mqtt_pub_queue_release(&q, msg);
+            LONGS_EQUAL(VOLC_OK, push_one(TEST_PAYLOAD));
+            published++;
+        }
+    }
+    double per_publish = (double)(q.pool.sys_allocs - warm_allocs) / published;
+    LONGS_EQUAL(warm_allocs, q.pool.sys_allocs);
+    UT_PRINT(StringFromFormat("%zu publishes, %.4f allocs per publish", published, per_publish).asCharString());
+}
+
+// 记录release回调的顺序
+static int s_release_order[8];
+static int s_release_count = 0;
+
+static void record_release(iot_mqtt_buf_t *buf, void *userdata) {
+    (void)buf;
+    s_release_order[s_release_count++] = *(int *)userdata;
+}
+
+// 零拷贝发布：QoS1在PUBACK后、QoS0在写出后归还，最后一个引用归还时才回调release
+TEST(mqtt_pub_queue, test_buf_release_ordering) {
+    uint8_t storage[3][LWS_PRE + 64];
+    iot_mqtt_buf_t bufs[3];
+    int ids[3] = {0, 1, 2};
+    iot_mqtt_msg_t *msgs[4];
+    s_release_count = 0;
+    for (int i = 0; i < 3; i++) {
+        LONGS_EQUAL(VOLC_OK, iot_mqtt_buf_init(&bufs[i], storage[i], sizeof(storage[i]), record_release, &ids[i]));
+        bufs[i].len = strlen(TEST_PAYLOAD);
+        memcpy(bufs[i].data, TEST_PAYLOAD, bufs[i].len);
+    }
+    LONGS_EQUAL(VOLC_ERR_INVALID_PARAM, iot_mqtt_buf_init(&bufs[0], storage[0], LWS_PRE - 1, NULL, NULL));
+
+    // buf0与buf1为QoS1，buf2同时发往两个topic（QoS0）
+    LONGS_EQUAL(VOLC_OK, iot_mqtt_pub_queue_alloc_buf(&q, TEST_TOPIC, &bufs[0], 1, &msgs[0]));
+    LONGS_EQUAL(VOLC_OK, iot_mqtt_pub_queue_alloc_buf(&q, TEST_TOPIC, &bufs[1], 1, &msgs[1]));
+    LONGS_EQUAL(VOLC_OK, iot_mqtt_pub_queue_alloc_buf(&q, "a/b", &bufs[2], 0, &msgs[2]));
+    LONGS_EQUAL(VOLC_OK, iot_mqtt_pub_queue_alloc_buf(&q, "a/c", &bufs[2], 0, &msgs[3]));
+    POINTERS_EQUAL(bufs[0].data, msgs[0]->pub.payload);
+    LONGS_EQUAL(3, bufs[2].refcount);
+    for (int i = 0; i < 4; i++) {
+        iot_mqtt_pub_queue_push(&q, msgs[i]);
+    }
+    // 调用方发布后归还自己的引用，消息仍在队列中不回调
+    for (int i = 0; i < 3; i++) {
+        iot_mqtt_buf_unref(&bufs[i]);
+    }
+    LONGS_EQUAL(0, s_release_count);
+
+    send_next(&q, &packet_id);
+    send_next(&q, &packet_id);
+    // QoS0写出后归还，buf2仍被另一条消息引用
+    iot_mqtt_msg_t *qos0 = iot_mqtt_pub_queue_peek(&q);
+    lws_dll2_remove(&qos0->list);
+    iot_mqtt_pub_queue_release(&q, qos0);
+    LONGS_EQUAL(0, s_release_count);
+
+    // 重发期间payload保持有效
+    MEMCMP_EQUAL(TEST_PAYLOAD, iot_mqtt_pub_queue_oldest(&q)->pub.payload, strlen(TEST_PAYLOAD));
+    POINTERS_EQUAL(msgs[0], iot_mqtt_pub_queue_ack_oldest(&q));
+    iot_mqtt_pub_queue_release(&q, msgs[0]);
+    qos0 = iot_mqtt_pub_queue_peek(&q);
+    lws_dll2_remove(&qos0->list);
+    iot_mqtt_pub_queue_release(&q, qos0);
+    POINTERS_EQUAL(msgs[1], iot_mqtt_pub_queue_ack_oldest(&q));
+    iot_mqtt_pub_queue_release(&q, msgs[1]);
+
+    LONGS_EQUAL(3, s_release_count);
+    LONGS_EQUAL(0, s_release_order[0]);
+    LONGS_EQUAL(2, s_release_order[1]);
+    LONGS_EQUAL(1, s_release_order[2]);
+}
+
+// 未送达就销毁队列或被DROP_OLDEST丢弃时同样归还引用
+TEST(mqtt_pub_queue, test_buf_released_on_drop_and_deinit) {
+    int ids[2] = {0, 1};
+    iot_mqtt_msg_t *msg;
+    s_release_count = 0;
+    reinit(1, 1, IOT_MQTT_OVERFLOW_DROP_OLDEST);
+    iot_mqtt_buf_t *buf0 = iot_mqtt_buf_new(16);
+    iot_mqtt_buf_t *buf1 = iot_mqtt_buf_new(16);
+    buf0->release = record_release;
+    buf0->userdata = &ids[0];
+    buf1->release = record_release;
+    buf1->userdata = &ids[1];
+
+    LONGS_EQUAL(VOLC_OK, iot_mqtt_pub_queue_alloc_buf(&q, TEST_TOPIC, buf0, 1, &msg));
+    iot_mqtt_pub_queue_push(&q, msg);
+    iot_mqtt_buf_unref(buf0);
+    LONGS_EQUAL(VOLC_OK, iot_mqtt_pub_queue_alloc_buf(&q, TEST_TOPIC, buf1, 1, &msg));
+    iot_mqtt_pub_queue_push(&q, msg);
+    iot_mqtt_buf_unref(buf1);
+    LONGS_EQUAL(1, s_release_count);
+    LONGS_EQUAL(0, s_release_order[0]);
+    free(buf0);
+
+    iot_mqtt_pub_queue_deinit(&q);
+    LONGS_EQUAL(2, s_release_count);
+    LONGS_EQUAL(1, s_release_order[1]);
+    free(buf1);
+    LONGS_EQUAL(0, iot_mqtt_pub_queue_init(&q, 1, 1, IOT_MQTT_OVERFLOW_REJECT));
+}
+
+// 每条发布入队时拷贝的字节数：拷贝接口为topic+payload，零拷贝接口只有topic
+TEST(mqtt_pub_queue, test_bytes_copied_per_publish) {
+    const size_t payload_sizes[] = {64, 1024, 8192};
+    const int rounds = 1000;
+    for (size_t s = 0; s < sizeof(payload_sizes) / sizeof(payload_sizes[0]); s++) {
+        size_t len = payload_sizes[s];
+        iot_mqtt_buf_t *buf = iot_mqtt_buf_new(len);
+        buf->len = len;
+        memset(buf->data, 'x', len);
+        uint64_t copied[2];
+        for (int zero_copy = 0; zero_copy < 2; zero_copy++) {
+            reinit(32, 64, IOT_MQTT_OVERFLOW_REJECT);
+            for (int r = 0; r < rounds; r++) {
+                iot_mqtt_msg_t *msg = NULL;
+                if (zero_copy) {
+                    LONGS_EQUAL(VOLC_OK, iot_mqtt_pub_queue_alloc_buf(&q, TEST_TOPIC, buf, 1, &msg));
+                } else {
+                    LONGS_EQUAL(VOLC_OK, iot_mqtt_pub_queue_alloc(&q, TEST_TOPIC, buf->data, len, 1, &msg));
+                }
+                iot_mqtt_pub_queue_release(&q, msg);
+            }
+            copied[zero_copy] = q.copied_bytes / rounds;
+        }
+        LONGS_EQUAL(strlen(TEST_TOPIC) + 1 + len, copied[0]);
+        LONGS_EQUAL(strlen(TEST_TOPIC) + 1, copied[1]);
+        LONGS_EQUAL(1, buf->refcount);
+        iot_mqtt_buf_unref(buf);
+        UT_PRINT(StringFromFormat("payload %zu: %llu bytes copied per publish, %llu zero-copy", len,
+            (unsigned long long)copied[0], (unsigned long long)copied[1]).asCharString());
+    }
+}
@@ -0,0 +1,315 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+  #include "CppUTest/TestHarness_c.h"
+  #include "onesdk_config.h"
+  #include "iot/iot_latency_hist.h"
+  #include "iot_mqtt.h"
+  #include "iot_basic.h"
+  #include "thing_model/iot_ntp.h"
+  #include "thing_model/iot_tm_api.h"
+  #include "thing_model/iot_tm_header.h"
+  #include "thing_model/tm_pending.h"
+  #include "aws/common/common.h"
+  #include "util/util.h"
+  #include "error_code.h"
+}
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#define PROBES 40
+#define PROXY_DELAY_MS 15           // 每个方向注入的延迟
+
+static int64_t now_us() {
+    return (int64_t) std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 最近秩法的精确分位
+static uint32_t exact_percentile(std::vector<uint32_t> sorted, double percentile) {
+    std::sort(sorted.begin(), sorted.end());
+    size_t rank = (size_t) (percentile / 100.0 * sorted.size() + 0.5);
+    rank = std::max<size_t>(1, std::min(rank, sorted.size()));
+    return sorted[rank - 1];
+}
+
+static int listen_loopback(uint16_t *port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (fd < 0 || bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0 || listen(fd, 1) != 0 ||
+        getsockname(fd, (struct sockaddr *) &addr, &len) != 0) {
+        return -1;
+    }
+    *port = ntohs(addr.sin_port);
+    return fd;
+}
+
+static int connect_loopback(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// 帧为4字节长度加内容，模拟MQTT上PUBLISH的边界
+static bool recv_frame(int fd, std::string *frame) {
+    uint32_t len = 0;
+    if (recv(fd, &len, sizeof(len), MSG_WAITALL) != (ssize_t) sizeof(len)) {
+        return false;
+    }
+    frame->resize(len);
+    return len == 0 || recv(fd, &(*frame)[0], len, MSG_WAITALL) == (ssize_t) len;
+}
+
+static bool send_frame(int fd, const std::string &frame) {
+    uint32_t len = (uint32_t) frame.size();
+    return send(fd, &len, sizeof(len), 0) == (ssize_t) sizeof(len) &&
+           send(fd, frame.data(), frame.size(), 0) == (ssize_t) frame.size();
+}
+
+// 模拟服务端：对每个NTP请求按ID回复，收发时间相同
+static void ntp_server(int listen_fd) {
+    int fd = accept(listen_fd, NULL, NULL);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    std::string request;
+    while (recv_frame(fd, &request)) {
+        size_t id_start = request.find("\"ID\":\"") + 6;
+        std::string id = request.substr(id_start, request.find('"', id_start) - id_start);
+        long long server_ms = (long long) std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        char reply[256];
+        snprintf(reply, sizeof(reply),
+                 "{\"ID\":\"%s\",\"Code\":0,\"Data\":{\"ServerRecvTime\":%lld,\"ServerSendTime\":%lld}}",
+                 id.c_str(), server_ms, server_ms);
+        if (!send_frame(fd, reply)) {
+            break;
+        }
+    }
+    close(fd);
+}
+
+// 注入延迟的TCP代理：请求与回复各延迟PROXY_DELAY_MS后转发
+static void delay_proxy(int listen_fd, uint16_t upstream_port) {
+    int client = accept(listen_fd, NULL, NULL);
+    int one = 1;
+    setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    int upstream = connect_loopback(upstream_port);
+    std::string frame;
+    while (recv_frame(client, &frame)) {
+        usleep(PROXY_DELAY_MS * 1000);
+        if (!send_frame(upstream, frame) || !recv_frame(upstream, &frame)) {
+            break;
+        }
+        usleep(PROXY_DELAY_MS * 1000);
+        send_frame(client, frame);
+    }
+    close(upstream);
+    close(client);
+}
+
+TEST_GROUP(mqtt_rtt) {
+    iot_mqtt_config_t config;
+    iot_mqtt_ctx_t ctx;
+
+    void setup() {
+        memset(&config, 0, sizeof(config));
+        memset(&ctx, 0, sizeof(ctx));
+        ctx.config = &config;
+        lws_pthread_mutex_init(&ctx.rtt_mutex);
+    }
+
+    void teardown() {
+        free(ctx.rtt_hist);
+        lws_pthread_mutex_destroy(&ctx.rtt_mutex);
+    }
+};
+
+// 分位与精确值的相对误差不超过1/32，跨越多个数量级
+TEST(mqtt_rtt, test_histogram_percentiles_match_exact) {
+    iot_latency_hist_t *hist = (iot_latency_hist_t *) malloc(sizeof(iot_latency_hist_t));
+    iot_latency_hist_reset(hist);
+    LONGS_EQUAL(0, iot_latency_hist_percentile(hist, 50));
+    std::vector<uint32_t> values;
+    srand(7);
+    for (int i = 0; i < 20000; i++) {
+        // 大部分在几十毫秒，少量长尾到数秒
+        uint32_t v = 20000 + (uint32_t) (rand() % 30000);
+        if (i % 100 == 0) {
+            v = 500000 + (uint32_t) (rand() % 3000000);
+        } else if (i % 37 == 0) {
+            v = (uint32_t) (rand() % 64);
+        }
+        values.push_back(v);
+        iot_latency_hist_record(hist, v);
+    }
+    const double percentiles[] = {0, 1, 50, 90, 99, 99.9, 100};
+    for (double p : percentiles) {
+        uint32_t exact = exact_percentile(values, p);
+        uint32_t approx = iot_latency_hist_percentile(hist, p);
+        CHECK(approx >= exact);
+        CHECK(approx - exact <= exact / 32);
+    }
+    LONGS_EQUAL(values.size(), hist->total);
+    LONGS_EQUAL(*std::min_element(values.begin(), values.end()), hist->min_us);
+    LONGS_EQUAL(*std::max_element(values.begin(), values.end()), iot_latency_hist_percentile(hist, 100));
+    uint64_t sum = 0;
+    for (uint32_t v : values) {
+        sum += v;
+    }
+    LONGS_EQUAL(sum / values.size(), iot_latency_hist_mean(hist));
+
+    // 超出范围按上限记录
+    iot_latency_hist_reset(hist);
+    iot_latency_hist_record(hist, 1ULL << 40);
+    LONGS_EQUAL(UINT32_MAX, iot_latency_hist_percentile(hist, 50));
+    free(hist);
+}
+
+// 样本足够后PINGRESP时限不小于p99的4倍，连接重建后回到配置值
+TEST(mqtt_rtt, test_pingresp_timeout_follows_p99) {
+    config.pingresp_timeout_s = 3;
+    iot_mqtt_rtt_stats_t stats;
+    LONGS_EQUAL(VOLC_ERR_NULL_POINTER, iot_mqtt_get_rtt_stats(&ctx, NULL));
+    LONGS_EQUAL(VOLC_OK, iot_mqtt_get_rtt_stats(&ctx, &stats));
+    LONGS_EQUAL(0, stats.count);
+    LONGS_EQUAL(3, stats.pingresp_timeout_s);
+
+    // 慢链路：RTT约2秒，样本不足时不生效
+    for (int i = 0; i < IOT_MQTT_RTT_MIN_SAMPLES - 1; i++) {
+        iot_mqtt_record_rtt(&ctx, 2000000 + i * 10000);
+    }
+    LONGS_EQUAL(0, ctx.rtt_pingresp_timeout_s);
+    iot_mqtt_record_rtt(&ctx, 2100000);
+    iot_mqtt_record_rtt_loss(&ctx);
+    LONGS_EQUAL(VOLC_OK, iot_mqtt_get_rtt_stats(&ctx, &stats));
+    LONGS_EQUAL(IOT_MQTT_RTT_MIN_SAMPLES, stats.count);
+    LONGS_EQUAL(1, stats.lost);
+    // 4 * 2.1s向上取整
+    LONGS_EQUAL(9, stats.pingresp_timeout_s);
+    LONGS_EQUAL(ctx.ping_interval_s + 9, ctx.retry.secs_since_valid_hangup);
+    CHECK(stats.srtt_us >= 2000000 && stats.srtt_us <= 2100000);
+
+    // 快链路上仍使用配置值
+    ctx.rtt_pingresp_timeout_s = 0;
+    iot_latency_hist_reset(ctx.rtt_hist);
+    for (int i = 0; i < 50; i++) {
+        iot_mqtt_record_rtt(&ctx, 40000);
+    }
+    iot_mqtt_record_rtt(&ctx, 600000000);   // 极端值不超过上限
+    LONGS_EQUAL(VOLC_OK, iot_mqtt_get_rtt_stats(&ctx, &stats));
+    LONGS_EQUAL(3, stats.pingresp_timeout_s);
+    LONGS_EQUAL(ctx.ping_interval_s + 3, ctx.retry.secs_since_valid_hangup);
+    for (int i = 0; i < 5; i++) {
+        iot_mqtt_record_rtt(&ctx, 600000000);
+    }
+    LONGS_EQUAL(VOLC_OK, iot_mqtt_get_rtt_stats(&ctx, &stats));
+    LONGS_EQUAL(IOT_MQTT_RTT_MAX_PINGRESP_TIMEOUT_S, stats.pingresp_timeout_s);
+}
+
+// 真实的探测路径：NTP请求经请求表登记后发布，经注入延迟的代理收到回复后按ID完成，p50接近两个方向的延迟之和
+TEST(mqtt_rtt, test_probes_through_delay_proxy) {
+    char product_key[] = "pk";
+    char device_name[] = "dn";
+    iot_basic_config_t basic;
+    memset(&basic, 0, sizeof(basic));
+    basic.product_key = product_key;
+    basic.device_name = device_name;
+    config.basic_config = &basic;
+    // 与iot_mqtt_init一样初始化aws库，回复按JSON解析
+    aws_common_library_init(aws_alloc());
+    lws_pthread_mutex_init(&ctx.pub_topic_mutex);
+    LONGS_EQUAL(VOLC_OK, iot_mqtt_pub_queue_init(&ctx.pub_queue, IOT_MQTT_MAX_INFLIGHT, 16, IOT_MQTT_OVERFLOW_REJECT));
+    iot_tm_handler_t *handle = iot_tm_init();
+    CHECK(handle != NULL);
+    handle->mqtt_handle = &ctx;
+
+    uint16_t server_port = 0;
+    uint16_t proxy_port = 0;
+    int server_fd = listen_loopback(&server_port);
+    int proxy_fd = listen_loopback(&proxy_port);
+    CHECK(server_fd >= 0 && proxy_fd >= 0);
+    std::thread server(ntp_server, server_fd);
+    std::thread proxy(delay_proxy, proxy_fd, server_port);
+    int fd = connect_loopback(proxy_port);
+    CHECK(fd >= 0);
+
+    for (int i = 0; i < PROBES; i++) {
+        LONGS_EQUAL(VOLC_OK, tm_send_device_npt_request(handle));
+        LONGS_EQUAL(1, iot_tm_pending_count(handle->pending));
+        // 代替服务线程发出排队的PUBLISH，broker立即确认
+        iot_mqtt_msg_t *msg = iot_mqtt_pub_queue_peek(&ctx.pub_queue);
+        CHECK(msg != NULL);
+        STRCMP_EQUAL("sys/pk/dn/ntp/request", msg->pub.topic);
+        std::string request((const char *) msg->pub.payload, msg->pub.payload_len);
+        LONGS_EQUAL(0, iot_mqtt_pub_queue_inflight_add(&ctx.pub_queue, msg));
+        CHECK(send_frame(fd, request));
+        iot_mqtt_pub_queue_release(&ctx.pub_queue, iot_mqtt_pub_queue_ack_oldest(&ctx.pub_queue));
+        std::string reply;
+        CHECK(recv_frame(fd, &reply));
+        _tm_recv_device_ntp_info("sys/pk/dn/ntp/response", (const uint8_t *) reply.data(), reply.size(), handle);
+        LONGS_EQUAL(0, iot_tm_pending_count(handle->pending));
+    }
+    close(fd);
+    proxy.join();
+    server.join();
+    close(proxy_fd);
+    close(server_fd);
+
+    iot_mqtt_rtt_stats_t stats;
+    LONGS_EQUAL(VOLC_OK, iot_mqtt_get_rtt_stats(&ctx, &stats));
+    LONGS_EQUAL(PROBES, stats.count);
+    LONGS_EQUAL(0, stats.lost);
+    const uint32_t injected_us = 2 * PROXY_DELAY_MS * 1000;
+    CHECK(stats.min_us >= injected_us);
+    CHECK(stats.p50_us >= injected_us && stats.p50_us < injected_us + 10000);
+    CHECK(stats.p50_us <= stats.p90_us && stats.p90_us <= stats.p99_us && stats.p99_us <= stats.max_us);
+    LONGS_EQUAL(IOT_MQTT_DEFAULT_PINGRESP_TIMEOUT_S, stats.pingresp_timeout_s);
+    UT_PRINT(StringFromFormat("rtt via %dms proxy: p50 %uus, p90 %uus, p99 %uus, srtt %uus",
+                              2 * PROXY_DELAY_MS, stats.p50_us, stats.p90_us, stats.p99_us,
+                              stats.srtt_us).asCharString());
+
+    iot_tm_deinit(handle);
+    iot_mqtt_pub_queue_deinit(&ctx.pub_queue);
+    lws_pthread_mutex_destroy(&ctx.pub_topic_mutex);
+}
@@ -0,0 +1,261 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+  #include "CppUTest/TestHarness_c.h"
+  #include "iot/iot_mqtt_spool.h"
+  #include "error_code.h"
+}
+
+#include <stdio.h>
+#include <string.h>
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#define SPOOL_TEST_PATH "./mqtt_spool_test.bin"
+#define TEST_TOPIC "sys/pk/dn/thingmodel/property/post"
+
+static uint32_t s_fake_now = 1700000000;
+
+static uint32_t fake_now(void) {
+    return s_fake_now;
+}
+
+TEST_GROUP(mqtt_spool) {
+    iot_mqtt_spool_t spool;
+    iot_mqtt_spool_config_t config;
+
+    void setup() {
+        remove(SPOOL_TEST_PATH);
+        memset(&config, 0, sizeof(config));
+        config.path = SPOOL_TEST_PATH;
+        config.now = fake_now;
+        LONGS_EQUAL(VOLC_OK, iot_mqtt_spool_open(&spool, &config));
+    }
+
+    void teardown() {
+        iot_mqtt_spool_close(&spool);
+        remove(SPOOL_TEST_PATH);
+    }
+
+    void reopen() {
+        iot_mqtt_spool_close(&spool);
+        LONGS_EQUAL(VOLC_OK, iot_mqtt_spool_open(&spool, &config));
+    }
+
+    void append(int i, int qos) {
+        char payload[32];
+        snprintf(payload, sizeof(payload), "{\"i\":%d}", i);
+        LONGS_EQUAL(VOLC_OK, iot_mqtt_spool_append(&spool, TEST_TOPIC, (const uint8_t *)payload,
+            strlen(payload), qos, NULL));
+    }
+
+    // 取下一条并检查payload序号，返回seq
+    uint32_t expect_next(int i) {
+        uint32_t seq;
+        const char *topic;
+        const uint8_t *payload;
+        size_t len;
+        int qos;
+        char expected[32];
+        LONGS_EQUAL(VOLC_OK, iot_mqtt_spool_next(&spool, &seq, &topic, &payload, &len, &qos));
+        snprintf(expected, sizeof(expected), "{\"i\":%d}", i);
+        STRCMP_EQUAL(TEST_TOPIC, topic);
+        LONGS_EQUAL(strlen(expected), len);
+        MEMCMP_EQUAL(expected, payload, len);
+        return seq;
+    }
+};
+
+TEST(mqtt_spool, test_survives_reopen_until_consumed) {
+    for (int i = 0; i < 5; i++) {
+        append(i, 1);
+    }
+    uint32_t seq0 = expect_next(0);
+    uint32_t seq1 = expect_next(1);
+    LONGS_EQUAL(3, iot_mqtt_spool_pending(&spool));
+    LONGS_EQUAL(VOLC_OK, iot_mqtt_spool_consume(&spool, seq0));
+
+    // 已取出但未确认的seq1在重启后重新补发
+    reopen();
+    LONGS_EQUAL(4, iot_mqtt_spool_pending(&spool));
+    LONGS_EQUAL(seq1, expect_next(1));
+    for (int i = 2; i < 5; i++) {
+        LONGS_EQUAL(VOLC_OK, iot_mqtt_spool_consume(&spool, expect_next(i)));
+    }
+    LONGS_EQUAL(VOLC_OK, iot_mqtt_spool_consume(&spool, seq1));
+    LONGS_EQUAL(VOLC_ERR_INVALID_PARAM, iot_mqtt_spool_consume(&spool, seq1));
+    reopen();
+    LONGS_EQUAL(0, iot_mqtt_spool_pending(&spool));
+    LONGS_EQUAL(0, spool.file_size);
+}
+
+TEST(mqtt_spool, test_torn_tail_is_discarded) {
+    append(0, 1);
+    append(1, 1);
+    uint32_t good_size = spool.file_size;
+    append(2, 1);
+    iot_mqtt_spool_close(&spool);
+
+    // 模拟写到一半时掉电：截断最后一条记录
+    char buf[1024];
+    FILE *fp = fopen(SPOOL_TEST_PATH, "rb");
+    CHECK(fp != NULL);
+    size_t n = fread(buf, 1, sizeof(buf), fp);
+    fclose(fp);
+    CHECK(n > good_size + 7);
+    fp = fopen(SPOOL_TEST_PATH, "wb");
+    fwrite(buf, 1, good_size + 7, fp);
+    fclose(fp);
+
+    LONGS_EQUAL(VOLC_OK, iot_mqtt_spool_open(&spool, &config));
+    LONGS_EQUAL(2, iot_mqtt_spool_pending(&spool));
+    LONGS_EQUAL(good_size, spool.file_size);
+    // 残尾截掉后继续追加的记录可以正常恢复
+    append(3, 1);
+    reopen();
+    expect_next(0);
+    expect_next(1);
+    expect_next(3);
+}
+
+TEST(mqtt_spool, test_crc_mismatch_stops_replay) {
+    append(0, 1);
+    uint32_t first_size = spool.file_size;
+    append(1, 1);
+    iot_mqtt_spool_close(&spool);
+
+    FILE *fp = fopen(SPOOL_TEST_PATH, "r+b");
+    fseek(fp, first_size + 30, SEEK_SET);
+    fputc('X', fp);
+    fclose(fp);
+
+    LONGS_EQUAL(VOLC_OK, iot_mqtt_spool_open(&spool, &config));
+    LONGS_EQUAL(1, iot_mqtt_spool_pending(&spool));
+    expect_next(0);
+}
+
+TEST(mqtt_spool, test_bounded_size_drops_oldest_pending) {
+    config.max_bytes = 600;
+    reopen();
+    for (int i = 0; i < 40; i++) {
+        append(i, 1);
+    }
+    CHECK(spool.file_size <= 600);
+    CHECK(spool.dropped > 0);
+    // 最新的消息保留，最早的被丢弃
+    size_t pending = iot_mqtt_spool_pending(&spool);
+    LONGS_EQUAL(40, pending + spool.dropped);
+    expect_next(40 - (int)pending);
+
+    // 已交给发送队列的消息不丢，全部占满时拒绝
+    while (iot_mqtt_spool_pending(&spool) > 0) {
+        uint32_t seq;
+        const char *topic;
+        const uint8_t *payload;
+        size_t len;
+        int qos;
+        iot_mqtt_spool_next(&spool, &seq, &topic, &payload, &len, &qos);
+    }
+    char big[200];
+    memset(big, 'x', sizeof(big));
+    LONGS_EQUAL(VOLC_ERR_MQTT_PUB_QUEUE_FULL, iot_mqtt_spool_append(&spool, TEST_TOPIC,
+        (const uint8_t *)big, sizeof(big), 1, NULL));
+    LONGS_EQUAL(VOLC_ERR_INVALID_PARAM, iot_mqtt_spool_append(&spool, TEST_TOPIC,
+        (const uint8_t *)big, 700, 1, NULL));
+}
+
+TEST(mqtt_spool, test_retention_per_qos) {
+    config.retention_s[0] = 60;
+    config.retention_s[1] = 3600;
+    reopen();
+    append(0, 0);
+    append(1, 1);
+    append(2, 0);
+    s_fake_now += 120;
+    append(3, 0);
+    // QoS0超过60秒的丢弃，QoS1保留
+    expect_next(1);
+    expect_next(3);
+    LONGS_EQUAL(2, spool.dropped);
+    s_fake_now -= 120;
+}
+
+// 取出后未能放入发送队列的消息退回，下次重新取出且不丢失
+TEST(mqtt_spool, test_unget_redelivers_message) {
+    append(0, 1);
+    append(1, 1);
+    uint32_t seq0 = expect_next(0);
+    LONGS_EQUAL(VOLC_ERR_INVALID_PARAM, iot_mqtt_spool_unget(&spool, seq0 + 1));
+    LONGS_EQUAL(VOLC_OK, iot_mqtt_spool_unget(&spool, seq0));
+    LONGS_EQUAL(2, iot_mqtt_spool_pending(&spool));
+    LONGS_EQUAL(VOLC_ERR_INVALID_PARAM, iot_mqtt_spool_unget(&spool, seq0));
+    LONGS_EQUAL(seq0, expect_next(0));
+    uint32_t seq1 = expect_next(1);
+    LONGS_EQUAL(VOLC_OK, iot_mqtt_spool_unget(&spool, seq1));
+    // 重启后同样补发
+    reopen();
+    expect_next(0);
+    expect_next(1);
+    LONGS_EQUAL(0, spool.dropped);
+}
+
+TEST(mqtt_spool, test_consumed_records_are_compacted) {
+    config.max_bytes = 4096;
+    reopen();
+    for (int i = 0; i < 500; i++) {
+        append(i, 1);
+        LONGS_EQUAL(VOLC_OK, iot_mqtt_spool_consume(&spool, expect_next(i)));
+    }
+    CHECK(spool.file_size <= 4096);
+    LONGS_EQUAL(0, spool.dropped);
+}
+
+#ifndef _WIN32
+// 子进程持续追加时被kill -9，重新打开后记录连续且全部校验通过
+TEST(mqtt_spool, test_kill9_crash_recovery) {
+    iot_mqtt_spool_close(&spool);
+    remove(SPOOL_TEST_PATH);
+    config.max_bytes = 16 * 1024 * 1024;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        iot_mqtt_spool_t child;
+        iot_mqtt_spool_open(&child, &config);
+        for (int i = 0; ; i++) {
+            char payload[32];
+            snprintf(payload, sizeof(payload), "{\"i\":%d}", i);
+            iot_mqtt_spool_append(&child, TEST_TOPIC, (const uint8_t *)payload, strlen(payload), 1, NULL);
+        }
+    }
+    CHECK(pid > 0);
+    usleep(50 * 1000);
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+
+    LONGS_EQUAL(VOLC_OK, iot_mqtt_spool_open(&spool, &config));
+    size_t recovered = iot_mqtt_spool_pending(&spool);
+    CHECK(recovered > 0);
+    for (size_t i = 0; i < recovered; i++) {
+        expect_next((int)i);
+    }
+    UT_PRINT(StringFromFormat("recovered %zu records after SIGKILL", recovered).asCharString());
+}
+#endif
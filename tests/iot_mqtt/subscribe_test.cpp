@@ -0,0 +1,126 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+  #include "CppUTest/TestHarness_c.h"
+  #include "onesdk_config.h"
+  #include "iot_mqtt.h"
+  #include "error_code.h"
+}
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define SUBSCRIBE_THREADS 4
+#define TOPICS_PER_THREAD 50
+
+static void on_message(const char *topic, const uint8_t *payload, size_t len, void *user_data) {
+    (void) topic;
+    (void) payload;
+    (void) len;
+    (void) user_data;
+}
+
+TEST_GROUP(mqtt_subscribe) {
+    iot_mqtt_config_t config;
+    iot_mqtt_ctx_t ctx;
+
+    void setup() {
+        memset(&config, 0, sizeof(config));
+        memset(&ctx, 0, sizeof(ctx));
+        ctx.config = &config;
+        LONGS_EQUAL(VOLC_OK, iot_mqtt_topic_trie_init(&ctx.sub_topics));
+        lws_pthread_mutex_init(&ctx.sub_topic_mutex);
+    }
+
+    void teardown() {
+        if (ctx.pending_sub_list != NULL) {
+            for (size_t i = 0; i < ctx.pending_sub_list->count; i++) {
+                free((void *) ctx.pending_sub_list->topic_maps[i].topic);
+            }
+            free(ctx.pending_sub_list->topic_maps);
+            free(ctx.pending_sub_list);
+        }
+        iot_mqtt_topic_trie_deinit(&ctx.sub_topics, NULL, NULL);
+        lws_pthread_mutex_destroy(&ctx.sub_topic_mutex);
+    }
+
+    int subscribe(const char *topic) {
+        iot_mqtt_topic_map_t map;
+        memset(&map, 0, sizeof(map));
+        map.topic = topic;
+        map.message_callback = on_message;
+        map.qos = IOT_MQTT_QOS1;
+        return iot_mqtt_subscribe(&ctx, &map);
+    }
+};
+
+// 每包不超过7个topic，且不超过包大小上限；单个超长topic单独成批
+TEST(mqtt_subscribe, test_batch_size) {
+    std::vector<std::string> names;
+    for (int i = 0; i < 10; i++) {
+        names.push_back("sys/pk/dn/thing/property/" + std::to_string(i));    // 每个topic占2+26+1字节
+    }
+    std::vector<iot_mqtt_topic_map_t> maps(names.size());
+    for (size_t i = 0; i < names.size(); i++) {
+        memset(&maps[i], 0, sizeof(maps[i]));
+        maps[i].topic = names[i].c_str();
+    }
+    iot_mqtt_pending_sub_list_t list = {maps.data(), maps.size()};
+    LONGS_EQUAL(IOT_MQTT_MAX_TOPICS_PER_SUBSCRIBE, iot_mqtt_sub_batch_size(&list, IOT_MQTT_DEFAULT_SUB_PACKET_MAX_BYTES));
+    // 7字节头部加3个topic正好放满
+    LONGS_EQUAL(3, iot_mqtt_sub_batch_size(&list, 7 + 3 * 29));
+    LONGS_EQUAL(2, iot_mqtt_sub_batch_size(&list, 7 + 3 * 29 - 1));
+    LONGS_EQUAL(1, iot_mqtt_sub_batch_size(&list, 1));
+    list.count = 2;
+    LONGS_EQUAL(2, iot_mqtt_sub_batch_size(&list, IOT_MQTT_DEFAULT_SUB_PACKET_MAX_BYTES));
+    list.count = 0;
+    LONGS_EQUAL(0, iot_mqtt_sub_batch_size(&list, IOT_MQTT_DEFAULT_SUB_PACKET_MAX_BYTES));
+}
+
+// 已在sub_topics中的topic不再入队，非法的过滤器被拒绝
+TEST(mqtt_subscribe, test_skip_subscribed_and_invalid) {
+    static iot_mqtt_topic_map_t existing;
+    LONGS_EQUAL(VOLC_OK, iot_mqtt_topic_trie_insert(&ctx.sub_topics, "a/b", &existing));
+    LONGS_EQUAL(VOLC_OK, subscribe("a/b"));
+    CHECK(ctx.pending_sub_list == NULL);
+    LONGS_EQUAL(VOLC_ERR_INVALID_PARAM, subscribe("a/#/b"));
+    LONGS_EQUAL(VOLC_OK, subscribe("a/+"));
+    LONGS_EQUAL(1, ctx.pending_sub_list->count);
+    STRCMP_EQUAL("a/+", ctx.pending_sub_list->topic_maps[0].topic);
+}
+
+// 多个应用线程同时订阅，在锁内查找并入队，不丢失也不损坏待订阅列表
+TEST(mqtt_subscribe, test_concurrent_subscribe) {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < SUBSCRIBE_THREADS; t++) {
+        threads.push_back(std::thread([this, t]() {
+            for (int i = 0; i < TOPICS_PER_THREAD; i++) {
+                char topic[64];
+                snprintf(topic, sizeof(topic), "thread/%d/topic/%d", t, i);
+                LONGS_EQUAL(VOLC_OK, subscribe(topic));
+            }
+        }));
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    LONGS_EQUAL(SUBSCRIBE_THREADS * TOPICS_PER_THREAD, ctx.pending_sub_list->count);
+}
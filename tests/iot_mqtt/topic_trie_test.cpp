@@ -0,0 +1,182 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+  #include "CppUTest/TestHarness_c.h"
+  #include "iot/iot_mqtt_topic_trie.h"
+  #include "error_code.h"
+}
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static void count_hit(void *value, void *userdata) {
+    (void)value;
+    (*(int *)userdata)++;
+}
+
+static void free_value(void *value, void *userdata) {
+    (void)userdata;
+    free(value);
+}
+
+TEST_GROUP(mqtt_topic_trie) {
+    iot_mqtt_topic_trie_t trie;
+
+    void setup() {
+        LONGS_EQUAL(VOLC_OK, iot_mqtt_topic_trie_init(&trie));
+    }
+
+    void teardown() {
+        iot_mqtt_topic_trie_deinit(&trie, NULL, NULL);
+    }
+
+    // 只订阅filter一个过滤器，返回topic命中的次数
+    int matches(const char *filter, const char *topic) {
+        int hits = 0;
+        iot_mqtt_topic_trie_deinit(&trie, NULL, NULL);
+        iot_mqtt_topic_trie_init(&trie);
+        LONGS_EQUAL(VOLC_OK, iot_mqtt_topic_trie_insert(&trie, filter, (void *)filter));
+        iot_mqtt_topic_trie_match(&trie, topic, strlen(topic), count_hit, &hits);
+        return hits;
+    }
+};
+
+// MQTT 3.1.1 4.7.1 通配符示例
+TEST(mqtt_topic_trie, test_spec_multi_level_wildcard) {
+    LONGS_EQUAL(1, matches("sport/tennis/player1/#", "sport/tennis/player1"));
+    LONGS_EQUAL(1, matches("sport/tennis/player1/#", "sport/tennis/player1/ranking"));
+    LONGS_EQUAL(1, matches("sport/tennis/player1/#", "sport/tennis/player1/score/wimbledon"));
+    LONGS_EQUAL(1, matches("sport/#", "sport"));
+    LONGS_EQUAL(1, matches("#", "sport/tennis"));
+    LONGS_EQUAL(1, matches("sport/tennis/#", "sport/tennis/"));
+    LONGS_EQUAL(0, matches("sport/tennis/#", "sport/tenn"));
+}
+
+TEST(mqtt_topic_trie, test_spec_single_level_wildcard) {
+    LONGS_EQUAL(1, matches("sport/tennis/+", "sport/tennis/player1"));
+    LONGS_EQUAL(1, matches("sport/tennis/+", "sport/tennis/player2"));
+    LONGS_EQUAL(0, matches("sport/tennis/+", "sport/tennis/player1/ranking"));
+    LONGS_EQUAL(0, matches("sport/+", "sport"));
+    LONGS_EQUAL(1, matches("sport/+", "sport/"));
+    LONGS_EQUAL(1, matches("+", "sport"));
+    LONGS_EQUAL(1, matches("+/+", "/finance"));
+    LONGS_EQUAL(1, matches("/+", "/finance"));
+    LONGS_EQUAL(0, matches("+", "/finance"));
+    LONGS_EQUAL(1, matches("+/tennis/#", "sport/tennis/player1"));
+    LONGS_EQUAL(1, matches("sport/+/player1", "sport/tennis/player1"));
+    LONGS_EQUAL(1, matches("sys/+/+/thingmodel/service/+/+/post/+", "sys/pk/dn/thingmodel/service/s1/call/post/123"));
+}
+
+TEST(mqtt_topic_trie, test_spec_dollar_topics) {
+    LONGS_EQUAL(0, matches("#", "$SYS/broker/clients"));
+    LONGS_EQUAL(0, matches("+/monitor/Clients", "$SYS/monitor/Clients"));
+    LONGS_EQUAL(1, matches("$SYS/#", "$SYS/monitor/Clients"));
+    LONGS_EQUAL(1, matches("$SYS/monitor/+", "$SYS/monitor/Clients"));
+}
+
+TEST(mqtt_topic_trie, test_exact_match_is_not_prefix_match) {
+    LONGS_EQUAL(0, matches("sys/pk/dn/custom/abc", "sys/pk/dn/custom/ab"));
+    LONGS_EQUAL(0, matches("sys/pk/dn/custom/ab", "sys/pk/dn/custom/abc"));
+    LONGS_EQUAL(0, matches("a/b", "a/b/c"));
+    LONGS_EQUAL(1, matches("a//b", "a//b"));
+}
+
+TEST(mqtt_topic_trie, test_filter_validation) {
+    CHECK(iot_mqtt_topic_filter_valid("sport/tennis/#"));
+    CHECK(iot_mqtt_topic_filter_valid("+/+"));
+    CHECK(iot_mqtt_topic_filter_valid("/"));
+    CHECK_FALSE(iot_mqtt_topic_filter_valid(""));
+    CHECK_FALSE(iot_mqtt_topic_filter_valid("sport/tennis#"));
+    CHECK_FALSE(iot_mqtt_topic_filter_valid("sport/tennis/#/ranking"));
+    CHECK_FALSE(iot_mqtt_topic_filter_valid("sport+"));
+    LONGS_EQUAL(VOLC_ERR_INVALID_PARAM, iot_mqtt_topic_trie_insert(&trie, "a/#/b", NULL));
+}
+
+TEST(mqtt_topic_trie, test_overlapping_filters_all_dispatched) {
+    int hits = 0;
+    const char *topic = "sport/tennis/player1";
+    iot_mqtt_topic_trie_insert(&trie, "sport/tennis/player1", NULL);
+    iot_mqtt_topic_trie_insert(&trie, "sport/tennis/+", NULL);
+    iot_mqtt_topic_trie_insert(&trie, "sport/#", NULL);
+    iot_mqtt_topic_trie_insert(&trie, "+/+/+", NULL);
+    iot_mqtt_topic_trie_insert(&trie, "sport/+/player2", NULL);
+    // 同一过滤器上挂两个处理函数
+    iot_mqtt_topic_trie_insert(&trie, "sport/tennis/+", NULL);
+    LONGS_EQUAL(5, iot_mqtt_topic_trie_match(&trie, topic, strlen(topic), count_hit, &hits));
+    LONGS_EQUAL(5, hits);
+}
+
+TEST(mqtt_topic_trie, test_find_and_remove) {
+    int a = 1;
+    int b = 2;
+    int hits = 0;
+    iot_mqtt_topic_trie_insert(&trie, "a/+/c", &a);
+    iot_mqtt_topic_trie_insert(&trie, "a/+/c", &b);
+    POINTERS_EQUAL(&a, iot_mqtt_topic_trie_find(&trie, "a/+/c"));
+    POINTERS_EQUAL(NULL, iot_mqtt_topic_trie_find(&trie, "a/b/c"));
+
+    LONGS_EQUAL(VOLC_OK, iot_mqtt_topic_trie_remove(&trie, "a/+/c", &a));
+    POINTERS_EQUAL(&b, iot_mqtt_topic_trie_find(&trie, "a/+/c"));
+    LONGS_EQUAL(VOLC_ERR_INVALID_PARAM, iot_mqtt_topic_trie_remove(&trie, "a/+/c", &a));
+    LONGS_EQUAL(VOLC_OK, iot_mqtt_topic_trie_remove(&trie, "a/+/c", &b));
+    LONGS_EQUAL(0, trie.count);
+    LONGS_EQUAL(0, iot_mqtt_topic_trie_match(&trie, "a/b/c", 5, count_hit, &hits));
+}
+
+TEST(mqtt_topic_trie, test_deinit_frees_values) {
+    int visited = 0;
+    iot_mqtt_topic_trie_insert(&trie, "a/b", strdup("x"));
+    iot_mqtt_topic_trie_insert(&trie, "a/#", strdup("y"));
+    iot_mqtt_topic_trie_insert(&trie, "+", strdup("z"));
+    iot_mqtt_topic_trie_foreach(&trie, count_hit, &visited);
+    LONGS_EQUAL(3, visited);
+    iot_mqtt_topic_trie_deinit(&trie, free_value, NULL);
+    iot_mqtt_topic_trie_init(&trie);
+}
+
+// 10/100/1000个订阅下的匹配耗时，应基本不随订阅数增长
+TEST(mqtt_topic_trie, test_match_benchmark) {
+    const size_t sizes[] = {10, 100, 1000};
+    const int rounds = 100000;
+    char filter[128];
+    char topic[128];
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        iot_mqtt_topic_trie_deinit(&trie, NULL, NULL);
+        iot_mqtt_topic_trie_init(&trie);
+        // 物模型、自定义topic与OTA订阅的混合
+        for (size_t i = 0; i < sizes[s]; i++) {
+            switch (i % 3) {
+                case 0: snprintf(filter, sizeof(filter), "sys/pk/dn/custom/topic%zu", i); break;
+                case 1: snprintf(filter, sizeof(filter), "sys/pk/dn/thingmodel/service/s%zu/+/post/+", i); break;
+                default: snprintf(filter, sizeof(filter), "sys/pk/dn%zu/ota/#", i); break;
+            }
+            LONGS_EQUAL(VOLC_OK, iot_mqtt_topic_trie_insert(&trie, filter, NULL));
+        }
+        snprintf(topic, sizeof(topic), "sys/pk/dn/thingmodel/service/s%zu/call/post/42", sizes[s] - 3);
+        int hits = 0;
+        clock_t start = clock();
+        for (int r = 0; r < rounds; r++) {
+            iot_mqtt_topic_trie_match(&trie, topic, strlen(topic), count_hit, &hits);
+        }
+        double ns = (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / rounds;
+        LONGS_EQUAL(rounds, hits);
+        UT_PRINT(StringFromFormat("%zu subscriptions: %.1f ns per match", sizes[s], ns).asCharString());
+    }
+}
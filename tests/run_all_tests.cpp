@@ -17,11 +17,30 @@
 #define ENABLE_AI_REALTIME
 
 // IMPORT_TEST_GROUP(auth); // onesdk_new_http_ctx leaks
+IMPORT_TEST_GROUP(auth_cache);
 // IMPORT_TEST_GROUP(util); // ok
 // IMPORT_TEST_GROUP(iot_basic); // ok
 // IMPORT_TEST_GROUP(llm_config); // ok
 IMPORT_TEST_GROUP(dynreg);
 IMPORT_TEST_GROUP(hardware_id);
+IMPORT_TEST_GROUP(realtime_session);
+IMPORT_TEST_GROUP(realtime_ws);
+IMPORT_TEST_GROUP(mqtt_pub_queue);
+IMPORT_TEST_GROUP(mqtt_topic_trie);
+IMPORT_TEST_GROUP(mqtt_spool);
+IMPORT_TEST_GROUP(mqtt_rtt);
+IMPORT_TEST_GROUP(mqtt_link);
+IMPORT_TEST_GROUP(mqtt_subscribe);
+IMPORT_TEST_GROUP(tm_coalescer);
+IMPORT_TEST_GROUP(tm_topic_table);
+IMPORT_TEST_GROUP(tm_payload);
+IMPORT_TEST_GROUP(tm_property_cache);
+IMPORT_TEST_GROUP(tm_shadow_cache);
+IMPORT_TEST_GROUP(tm_gateway);
+IMPORT_TEST_GROUP(tm_pending);
+IMPORT_TEST_GROUP(tm_ntp);
+IMPORT_TEST_GROUP(tm_webshell);
+IMPORT_TEST_GROUP(tm_custom_router);
 
 int main(int argc, char** argv)
 {
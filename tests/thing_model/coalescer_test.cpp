@@ -0,0 +1,200 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+  #include "CppUTest/TestHarness_c.h"
+  #include "thing_model/tm_coalescer.h"
+  #include "error_code.h"
+}
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#define PROPERTY_TOPIC "sys/pk/dn/thingmodel/property/post"
+// 物模型属性上报在params外的封装，与_tm_send_property_post一致
+#define ENVELOPE "{\"id\":\"1234567890123456\",\"version\":\"1.0.0\",\"params\":}"
+
+struct sent_t {
+    std::string topic;
+    std::string params;
+    uint32_t members;
+};
+
+static std::vector<sent_t> s_sent;
+static uint64_t s_wire_bytes = 0;
+
+// MQTT 3.1.1 QoS1 PUBLISH在线路上的字节数
+static size_t publish_wire_size(size_t topic_len, size_t payload_len) {
+    size_t remaining = 2 + topic_len + 2 + payload_len;
+    size_t len_bytes = remaining < 128 ? 1 : remaining < 16384 ? 2 : remaining < 2097152 ? 3 : 4;
+    return 1 + len_bytes + remaining;
+}
+
+static int s_wakes = 0;
+
+static void record_wake(void *userdata) {
+    (void)userdata;
+    s_wakes++;
+}
+
+static int record_send(const char *topic, const char *params, size_t len, uint32_t members, void *userdata) {
+    (void)userdata;
+    sent_t sent = {topic, std::string(params, len), members};
+    s_sent.push_back(sent);
+    s_wire_bytes += publish_wire_size(strlen(topic), strlen(ENVELOPE) + len);
+    return VOLC_OK;
+}
+
+TEST_GROUP(tm_coalescer) {
+    iot_tm_coalescer_t c;
+
+    void setup() {
+        s_sent.clear();
+        s_wire_bytes = 0;
+        s_wakes = 0;
+        LONGS_EQUAL(VOLC_OK, iot_tm_coalescer_init(&c, record_send, NULL));
+        iot_tm_coalescer_set_wake(&c, record_wake);
+    }
+
+    void teardown() {
+        iot_tm_coalescer_deinit(&c);
+    }
+
+    void enable(uint32_t window_ms, uint32_t max_bytes) {
+        iot_tm_coalesce_policy_t policy = {window_ms, max_bytes};
+        LONGS_EQUAL(VOLC_OK, iot_tm_coalescer_set_policy(&c, PROPERTY_TOPIC, &policy));
+    }
+
+    void add(const char *key, const char *value, uint64_t now_ms) {
+        LONGS_EQUAL(VOLC_OK, iot_tm_coalescer_add(&c, PROPERTY_TOPIC, key, strlen(key), value, strlen(value), now_ms));
+    }
+};
+
+TEST(tm_coalescer, test_disabled_topic_sends_immediately) {
+    add("temp", "{\"value\":21.5,\"time\":1}", 0);
+    LONGS_EQUAL(1, s_sent.size());
+    STRCMP_EQUAL("{\"temp\":{\"value\":21.5,\"time\":1}}", s_sent[0].params.c_str());
+    CHECK_FALSE(iot_tm_coalescer_enabled(&c, PROPERTY_TOPIC));
+    LONGS_EQUAL(-1, iot_tm_coalescer_poll(&c, 0));
+}
+
+TEST(tm_coalescer, test_window_merges_distinct_keys) {
+    enable(100, 0);
+    CHECK(iot_tm_coalescer_enabled(&c, PROPERTY_TOPIC));
+    add("temp", "1", 1000);
+    add("hum", "2", 1050);
+    LONGS_EQUAL(0, s_sent.size());
+    LONGS_EQUAL(50, iot_tm_coalescer_poll(&c, 1050));
+    LONGS_EQUAL(-1, iot_tm_coalescer_poll(&c, 1100));
+    LONGS_EQUAL(1, s_sent.size());
+    STRCMP_EQUAL("{\"temp\":1,\"hum\":2}", s_sent[0].params.c_str());
+    LONGS_EQUAL(2, s_sent[0].members);
+}
+
+// 没有待发的批时事件循环不需要定时唤醒，空批加入首个成员时唤醒一次
+TEST(tm_coalescer, test_idle_poll_and_wake_on_first_member) {
+    enable(100, 0);
+    LONGS_EQUAL(-1, iot_tm_coalescer_poll(&c, 0));
+    LONGS_EQUAL(0, s_wakes);
+    add("temp", "1", 1000);
+    LONGS_EQUAL(1, s_wakes);
+    add("hum", "2", 1010);
+    LONGS_EQUAL(1, s_wakes);
+    LONGS_EQUAL(90, iot_tm_coalescer_poll(&c, 1010));
+    LONGS_EQUAL(-1, iot_tm_coalescer_poll(&c, 1100));
+    LONGS_EQUAL(1, s_sent.size());
+    add("temp", "3", 2000);
+    LONGS_EQUAL(2, s_wakes);
+    // 未开启合并的topic直接发出，不唤醒
+    LONGS_EQUAL(VOLC_OK, iot_tm_coalescer_add(&c, "sys/pk/dn/thingmodel/event/post", "e", 1, "1", 1, 2000));
+    LONGS_EQUAL(2, s_wakes);
+}
+
+// 同一属性再次上报时先发出当前批，每个采样点都保留且保持顺序
+TEST(tm_coalescer, test_repeated_key_flushes_batch) {
+    enable(1000, 0);
+    add("temp", "1", 0);
+    add("hum", "2", 0);
+    add("temp", "3", 10);
+    LONGS_EQUAL(1, s_sent.size());
+    STRCMP_EQUAL("{\"temp\":1,\"hum\":2}", s_sent[0].params.c_str());
+    iot_tm_coalescer_flush(&c, NULL);
+    LONGS_EQUAL(2, s_sent.size());
+    STRCMP_EQUAL("{\"temp\":3}", s_sent[1].params.c_str());
+}
+
+TEST(tm_coalescer, test_max_bytes_flushes_batch) {
+    enable(1000, 32);
+    add("a", "\"0123456789\"", 0);
+    add("b", "\"0123456789\"", 0);
+    LONGS_EQUAL(1, s_sent.size());
+    STRCMP_EQUAL("{\"a\":\"0123456789\"}", s_sent[0].params.c_str());
+    // 单个成员超过上限时单独发出
+    add("c", "\"0123456789012345678901234567890123456789\"", 0);
+    LONGS_EQUAL(3, s_sent.size());
+    CHECK(s_sent[1].params.size() <= 32);
+}
+
+// 事件等消息发送前调用flush，已合并的属性先于事件发出
+TEST(tm_coalescer, test_flush_and_disable) {
+    enable(1000, 0);
+    add("temp", "1", 0);
+    LONGS_EQUAL(VOLC_OK, iot_tm_coalescer_flush(&c, "sys/pk/dn/other"));
+    LONGS_EQUAL(0, s_sent.size());
+    LONGS_EQUAL(VOLC_OK, iot_tm_coalescer_flush(&c, PROPERTY_TOPIC));
+    LONGS_EQUAL(1, s_sent.size());
+    add("temp", "2", 0);
+    enable(0, 0);
+    LONGS_EQUAL(2, s_sent.size());
+    CHECK_FALSE(iot_tm_coalescer_enabled(&c, PROPERTY_TOPIC));
+}
+
+// 100Hz采样、20个属性逐个上报，对比合并前后的消息数与线路字节数
+TEST(tm_coalescer, test_benchmark_100hz_20_properties) {
+    const int seconds = 10;
+    const int hz = 100;
+    const int properties = 20;
+    const uint32_t windows[] = {0, 10, 1000};
+    char key[16];
+    char value[64];
+    for (size_t w = 0; w < sizeof(windows) / sizeof(windows[0]); w++) {
+        iot_tm_coalescer_deinit(&c);
+        setup();
+        enable(windows[w], 16 * 1024);
+        for (int tick = 0; tick < seconds * hz; tick++) {
+            uint64_t now_ms = (uint64_t)tick * 1000 / hz;
+            iot_tm_coalescer_poll(&c, now_ms);
+            for (int p = 0; p < properties; p++) {
+                snprintf(key, sizeof(key), "sensor%d", p);
+                snprintf(value, sizeof(value), "{\"value\":%d.%d,\"time\":%llu}", tick % 100, p,
+                    (unsigned long long)(1700000000000ULL + now_ms));
+                add(key, value, now_ms);
+            }
+        }
+        iot_tm_coalescer_flush(&c, NULL);
+        LONGS_EQUAL(seconds * hz * properties, c.members_in);
+        LONGS_EQUAL(s_sent.size(), c.messages_out);
+        if (windows[w] > 0) {
+            // 同一属性每个采样周期出现一次，每周期合并为一条
+            LONGS_EQUAL(seconds * hz, c.messages_out);
+        }
+        UT_PRINT(StringFromFormat("window %u ms: %llu messages/s, %llu bytes/s on the wire", windows[w],
+            (unsigned long long)(c.messages_out / seconds), (unsigned long long)(s_wire_bytes / seconds)).asCharString());
+    }
+}
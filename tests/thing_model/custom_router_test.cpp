@@ -0,0 +1,311 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+  #include "CppUTest/TestHarness_c.h"
+  #include "onesdk_config.h"
+  #include "thing_model/tm_custom_router.h"
+  #include "aws/common/json.h"
+  #include "error_code.h"
+}
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <time.h>
+#include <vector>
+
+#define PREFIX "sys/pk_0123456789/dn_0123456789/custom/"
+#define BENCH_TOPICS 500
+#define BENCH_MESSAGES 100000
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+struct call_t {
+    int handler;
+    std::string suffix;
+};
+
+struct handler_ctx_t {
+    int id;
+    std::vector<call_t> *calls;
+};
+
+static void record_handler(const iot_tm_custom_topic_msg_t *msg, void *userdata) {
+    handler_ctx_t *ctx = (handler_ctx_t *) userdata;
+    ctx->calls->push_back({ctx->id, std::string(msg->suffix, msg->suffix_len)});
+}
+
+struct mqtt_deliver_t {
+    const std::string *topic;
+    const uint8_t *payload;
+    size_t len;
+    size_t called;
+};
+
+static void deliver_to_sub(void *value, void *userdata) {
+    mqtt_deliver_t *d = (mqtt_deliver_t *) userdata;
+    d->called += iot_tm_custom_router_dispatch((iot_tm_custom_sub_t *) value, d->topic->c_str(), d->topic->size(),
+                                               d->payload, d->len);
+}
+
+TEST_GROUP(tm_custom_router) {
+    iot_tm_custom_router_t router;
+    iot_mqtt_topic_trie_t mqtt;         // 模拟MQTT层：订阅的完整过滤器 -> 路由的订阅
+    std::vector<call_t> calls;
+
+    void setup() {
+        LONGS_EQUAL(VOLC_OK, iot_tm_custom_router_init(&router));
+        LONGS_EQUAL(VOLC_OK, iot_mqtt_topic_trie_init(&mqtt));
+        calls.clear();
+    }
+
+    void teardown() {
+        iot_mqtt_topic_trie_deinit(&mqtt, NULL, NULL);
+        iot_tm_custom_router_deinit(&router);
+    }
+
+    int add(const char *pattern, void *ctx, uint32_t flags = 0,
+            iot_tm_custom_topic_handler_t handler = record_handler) {
+        iot_tm_custom_sub_t *sub = NULL;
+        int ret = iot_tm_custom_router_add(&router, pattern, flags, handler, ctx, &sub);
+        if (ret == VOLC_OK && sub != NULL) {
+            // 与iot_tm_custom_topic_register一样，每个过滤器只订阅一次
+            std::string filter = std::string(PREFIX) + pattern;
+            LONGS_EQUAL(VOLC_OK, iot_mqtt_topic_trie_insert(&mqtt, filter.c_str(), sub));
+        }
+        return ret;
+    }
+
+    // 与MQTT层一样把消息交给每个匹配的订阅
+    size_t deliver(const char *suffix, const char *payload = "{}") {
+        std::string topic = std::string(PREFIX) + suffix;
+        mqtt_deliver_t d = {&topic, (const uint8_t *) payload, strlen(payload), 0};
+        iot_mqtt_topic_trie_match(&mqtt, topic.c_str(), topic.size(), deliver_to_sub, &d);
+        return d.called;
+    }
+
+    std::string handlers() {
+        std::string s;
+        for (auto &c : calls) {
+            s += std::to_string(c.handler);
+        }
+        calls.clear();
+        return s;
+    }
+};
+
+// MQTT层把一个PUBLISH交给每个重叠的订阅，每个命中的处理函数调用一次，按注册顺序
+TEST(tm_custom_router, test_overlapping_patterns) {
+    handler_ctx_t h1 = {1, &calls}, h2 = {2, &calls}, h3 = {3, &calls}, h4 = {4, &calls}, h5 = {5, &calls};
+    LONGS_EQUAL(VOLC_OK, add("a/+/c", &h1));
+    LONGS_EQUAL(VOLC_OK, add("a/b/+", &h2));
+    LONGS_EQUAL(VOLC_OK, add("a/#", &h3));
+    LONGS_EQUAL(VOLC_OK, add("a/b/c", &h4));
+    // 同一过滤器的第二个处理函数不再订阅
+    iot_tm_custom_sub_t *sub = (iot_tm_custom_sub_t *) 1;
+    LONGS_EQUAL(VOLC_OK, iot_tm_custom_router_add(&router, "a/+/c", 0, record_handler, &h5, &sub));
+    POINTERS_EQUAL(NULL, sub);
+    STRCMP_EQUAL("a/+/c", iot_tm_custom_sub_pattern(iot_tm_custom_router_find(&router, "a/+/c")));
+    POINTERS_EQUAL(NULL, iot_tm_custom_router_find(&router, "a/+"));
+    LONGS_EQUAL(4, router.sub_count);
+
+    LONGS_EQUAL(5, deliver("a/b/c"));
+    STRCMP_EQUAL("12345", handlers().c_str());
+    LONGS_EQUAL(3, deliver("a/x/c"));
+    STRCMP_EQUAL("135", handlers().c_str());
+    LONGS_EQUAL(2, deliver("a/b/x"));
+    STRCMP_EQUAL("23", handlers().c_str());
+    // '#'也匹配上一级
+    LONGS_EQUAL(1, deliver("a"));
+    STRCMP_EQUAL("3", handlers().c_str());
+    LONGS_EQUAL(0, deliver("b/b/c"));
+    LONGS_EQUAL(1, deliver("a/b/c/d/e"));
+    STRCMP_EQUAL("3", handlers().c_str());
+    LONGS_EQUAL(5, router.dispatched);
+    // broker为每个重叠的订阅各发一份时，每一份都是独立的PUBLISH，各分发一次
+    LONGS_EQUAL(3, deliver("a/x/c"));
+    LONGS_EQUAL(3, deliver("a/x/c"));
+    STRCMP_EQUAL("135135", handlers().c_str());
+    LONGS_EQUAL(7, router.dispatched);
+
+    LONGS_EQUAL(VOLC_ERR_INVALID_PARAM, add("a/#/c", &h1));
+    LONGS_EQUAL(VOLC_ERR_INVALID_PARAM, add("a/b+", &h1));
+    LONGS_EQUAL(VOLC_ERR_INVALID_PARAM, add("$sys", &h1));
+    LONGS_EQUAL(VOLC_ERR_NULL_POINTER, add("a", NULL, 0, NULL));
+    LONGS_EQUAL(4, router.sub_count);
+}
+
+// MQTT订阅失败时撤销路由：处理函数不再被调用，同一过滤器可以重新注册并订阅
+TEST(tm_custom_router, test_remove_sub_after_failed_subscribe) {
+    handler_ctx_t h1 = {1, &calls}, h2 = {2, &calls}, h3 = {3, &calls};
+    LONGS_EQUAL(VOLC_OK, add("a/+", &h1));
+    // 中间的订阅失败，撤销后不影响之前与之后注册的过滤器
+    iot_tm_custom_sub_t *failed = NULL;
+    LONGS_EQUAL(VOLC_OK, iot_tm_custom_router_add(&router, "b/#", 0, record_handler, &h2, &failed));
+    CHECK(failed != NULL);
+    LONGS_EQUAL(VOLC_OK, add("c", &h3));
+    iot_tm_custom_router_remove_sub(&router, failed);
+    POINTERS_EQUAL(NULL, iot_tm_custom_router_find(&router, "b/#"));
+    LONGS_EQUAL(1, deliver("a/x"));
+    LONGS_EQUAL(1, deliver("c"));
+    STRCMP_EQUAL("13", handlers().c_str());
+
+    iot_tm_custom_sub_t *sub = NULL;
+    LONGS_EQUAL(VOLC_OK, iot_tm_custom_router_add(&router, "b/#", 0, record_handler, &h2, &sub));
+    CHECK(sub != NULL);
+    // 最后注册的订阅撤销时回收其序号
+    size_t subs = router.sub_count;
+    iot_tm_custom_router_remove_sub(&router, sub);
+    LONGS_EQUAL(subs - 1, router.sub_count);
+    POINTERS_EQUAL(NULL, iot_tm_custom_router_find(&router, "b/#"));
+    LONGS_EQUAL(VOLC_OK, add("b/#", &h2));
+    LONGS_EQUAL(1, deliver("b/y"));
+    STRCMP_EQUAL("2", handlers().c_str());
+}
+
+struct zero_copy_ctx_t {
+    const uint8_t *payload;
+    const char *topic;
+    int calls;
+    int with_json;
+    double value;
+};
+
+static void zero_copy_handler(const iot_tm_custom_topic_msg_t *msg, void *userdata) {
+    zero_copy_ctx_t *ctx = (zero_copy_ctx_t *) userdata;
+    ctx->calls++;
+    ctx->payload = msg->payload;
+    ctx->topic = msg->topic;
+    if (msg->json != NULL) {
+        ctx->with_json++;
+        struct aws_json_value *v = aws_json_value_get_from_object(msg->json, aws_byte_cursor_from_c_str("Temp"));
+        if (v != NULL) {
+            aws_json_value_get_number(v, &ctx->value);
+        }
+    }
+}
+
+// payload与topic不拷贝；只有要求预解析的处理函数拿到JSON，同一条消息只解析一次
+TEST(tm_custom_router, test_zero_copy_and_json) {
+    zero_copy_ctx_t raw = {0}, parsed = {0};
+    LONGS_EQUAL(VOLC_OK, add("sensor/+/temp", &raw, 0, zero_copy_handler));
+    LONGS_EQUAL(VOLC_OK, add("sensor/#", &parsed, IOT_TM_CUSTOM_TOPIC_PARSE_JSON, zero_copy_handler));
+
+    const char payload[] = "{\"Temp\":21.5}";
+    std::string topic = std::string(PREFIX) + "sensor/kitchen/temp";
+    iot_tm_custom_sub_t *sub = iot_tm_custom_router_find(&router, "sensor/+/temp");
+    LONGS_EQUAL(2, iot_tm_custom_router_dispatch(sub, topic.c_str(), topic.size(), (const uint8_t *) payload,
+                                                 strlen(payload)));
+    POINTERS_EQUAL(payload, raw.payload);
+    POINTERS_EQUAL(topic.c_str(), raw.topic);
+    LONGS_EQUAL(0, raw.with_json);
+    LONGS_EQUAL(1, parsed.with_json);
+    DOUBLES_EQUAL(21.5, parsed.value, 0.001);
+
+    // 不是合法JSON时照常分发，json为NULL
+    LONGS_EQUAL(2, deliver("sensor/kitchen/temp", "not json"));
+    LONGS_EQUAL(2, raw.calls);
+    LONGS_EQUAL(2, parsed.calls);
+    LONGS_EQUAL(1, parsed.with_json);
+    LONGS_EQUAL(1, router.json_errors);
+
+    // 不是自定义topic的格式
+    LONGS_EQUAL(0, iot_tm_custom_router_dispatch(sub, "sys/pk", 6, NULL, 0));
+}
+
+static size_t s_bench_hits = 0;
+
+static void count_handler(const iot_tm_custom_topic_msg_t *msg, void *userdata) {
+    s_bench_hits++;
+}
+
+// 500个自定义topic：改造前一个回调逐个比较后缀，改造后经前缀树一次匹配
+TEST(tm_custom_router, test_bench_500_topics) {
+    std::vector<std::string> patterns;
+    for (int i = 0; i < BENCH_TOPICS; i++) {
+        char buf[64];
+        if (i % 5 == 4) {
+            snprintf(buf, sizeof(buf), "group/%03d/+/event", i);
+        } else {
+            snprintf(buf, sizeof(buf), "device/%03d/cmd", i);
+        }
+        patterns.push_back(buf);
+        LONGS_EQUAL(VOLC_OK, add(buf, NULL, 0, count_handler));
+    }
+    std::vector<std::string> topics;
+    for (int i = 0; i < BENCH_TOPICS; i++) {
+        char buf[64];
+        if (i % 5 == 4) {
+            snprintf(buf, sizeof(buf), PREFIX "group/%03d/dev%d/event", i, i % 7);
+        } else {
+            snprintf(buf, sizeof(buf), PREFIX "device/%03d/cmd", i);
+        }
+        topics.push_back(buf);
+    }
+    const uint8_t payload[] = "{}";
+
+    // 改造前：取出后缀后与每个订阅的后缀按MQTT规则逐个比较
+    size_t legacy_hits = 0;
+    uint64_t t0 = now_ns();
+    for (int n = 0; n < BENCH_MESSAGES; n++) {
+        const std::string &topic = topics[(size_t) (n * 7919) % topics.size()];
+        const char *suffix = topic.c_str() + strlen(PREFIX);
+        for (auto &p : patterns) {
+            const char *s = suffix;
+            const char *f = p.c_str();
+            while (*f != '\0' && *s != '\0') {
+                if (*f == '+') {
+                    while (*s != '\0' && *s != '/') {
+                        s++;
+                    }
+                    f++;
+                } else if (*f == *s) {
+                    f++;
+                    s++;
+                } else {
+                    break;
+                }
+            }
+            if (*f == '\0' && *s == '\0') {
+                legacy_hits++;
+                break;
+            }
+        }
+    }
+    uint64_t legacy_ns = now_ns() - t0;
+
+    s_bench_hits = 0;
+    t0 = now_ns();
+    for (int n = 0; n < BENCH_MESSAGES; n++) {
+        const std::string &topic = topics[(size_t) (n * 7919) % topics.size()];
+        mqtt_deliver_t d = {&topic, payload, 2, 0};
+        iot_mqtt_topic_trie_match(&mqtt, topic.c_str(), topic.size(), deliver_to_sub, &d);
+    }
+    uint64_t trie_ns = now_ns() - t0;
+
+    LONGS_EQUAL(BENCH_MESSAGES, legacy_hits);
+    LONGS_EQUAL(BENCH_MESSAGES, s_bench_hits);
+    UT_PRINT(StringFromFormat("custom topic %d filters, %d msgs: linear %.0f ns/msg, trie %.0f ns/msg",
+                              BENCH_TOPICS, BENCH_MESSAGES, (double) legacy_ns / BENCH_MESSAGES,
+                              (double) trie_ns / BENCH_MESSAGES).asCharString());
+}
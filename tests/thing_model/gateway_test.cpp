@@ -0,0 +1,375 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+  #include "CppUTest/TestHarness_c.h"
+  #include "onesdk_config.h"
+  #include "thing_model/gateway.h"
+  #include "aws/common/json.h"
+  #include "util/aws_json.h"
+  #include "util/util.h"
+  #include "error_code.h"
+}
+
+#include <stdio.h>
+#include <string.h>
+#include <deque>
+#include <set>
+#include <string>
+#include <vector>
+
+#define PRODUCT_KEY "pk"
+
+struct request_t {
+    iot_gateway_op_t op;
+    std::string id;
+    std::vector<std::string> devices;   // "product_key/device_name"
+    size_t bytes;
+    bool signed_items;
+    uint64_t sent_ms;
+};
+
+struct result_t {
+    iot_gateway_op_t op;
+    int32_t code;
+    size_t count;
+};
+
+static std::vector<request_t> s_sent;
+static std::vector<result_t> s_results;
+static uint64_t s_now_ms = 0;
+
+static int record_send(iot_gateway_op_t op, const char *payload, size_t len, void *userdata) {
+    (void)userdata;
+    request_t r = {op, "", {}, len, true, s_now_ms};
+    struct aws_json_value *root = aws_json_value_new_from_string(aws_alloc(), aws_byte_cursor_from_array(payload, len));
+    CHECK(root != NULL);
+    struct aws_byte_cursor id = aws_json_get_str_byte_cur_val(root, "ID");
+    r.id.assign((const char *)id.ptr, id.len);
+    struct aws_json_value *params = aws_json_get_json_obj(aws_alloc(), root, "params");
+    for (size_t i = 0; i < aws_json_get_array_size(params); i++) {
+        struct aws_json_value *item = aws_json_get_array_element(params, i);
+        struct aws_byte_cursor pk = aws_json_get_str_byte_cur_val(item, "ProductKey");
+        struct aws_byte_cursor dn = aws_json_get_str_byte_cur_val(item, "DeviceName");
+        r.devices.push_back(std::string((const char *)pk.ptr, pk.len) + "/" + std::string((const char *)dn.ptr, dn.len));
+        r.signed_items = r.signed_items && aws_json_get_str_byte_cur_val(item, "signature").len > 0;
+    }
+    aws_json_value_destroy(root);
+    s_sent.push_back(r);
+    return VOLC_OK;
+}
+
+static void record_result(iot_gateway_op_t op, const char *id, int32_t code, const iot_gateway_device_id_t *devices,
+                          size_t count, void *userdata) {
+    (void)id;
+    (void)devices;
+    (void)userdata;
+    result_t r = {op, code, count};
+    s_results.push_back(r);
+}
+
+static std::deque<std::string> s_names;     // 扩容时不移动已有元素，返回的名字一直有效
+
+// 子设备名 dev0001 ...
+static const char *device_name(int i) {
+    while ((int)s_names.size() <= i) {
+        char name[16];
+        snprintf(name, sizeof(name), "dev%04d", (int)s_names.size());
+        s_names.push_back(name);
+    }
+    return s_names[i].c_str();
+}
+
+static std::vector<iot_gateway_sub_device_t> devices(int from, int count, const char *device_secret = "secret") {
+    std::vector<iot_gateway_sub_device_t> out;
+    for (int i = from; i < from + count; i++) {
+        iot_gateway_sub_device_t d = {PRODUCT_KEY, device_name(i), device_secret, NULL};
+        out.push_back(d);
+    }
+    return out;
+}
+
+TEST_GROUP(tm_gateway) {
+    iot_gateway_t gw;
+
+    void setup() {
+        s_sent.clear();
+        s_results.clear();
+        s_now_ms = 0;
+    }
+
+    void teardown() {
+        iot_gateway_deinit(&gw);
+    }
+
+    void init(uint32_t batch_devices, uint32_t batch_bytes, uint32_t inflight, uint32_t interval_ms,
+              uint32_t timeout_ms, uint32_t attempts) {
+        iot_gateway_limits_t limits = {batch_devices, batch_bytes, inflight, interval_ms, timeout_ms, attempts};
+        LONGS_EQUAL(VOLC_OK, iot_gateway_init(&gw, &limits, NULL, record_send, record_result, NULL));
+    }
+
+    int request(iot_gateway_op_t op, const std::vector<iot_gateway_sub_device_t> &d) {
+        return iot_gateway_request(&gw, op, d.data(), d.size());
+    }
+
+    int32_t poll(uint64_t now_ms) {
+        s_now_ms = now_ms;
+        return iot_gateway_poll(&gw, now_ms);
+    }
+
+    int reply(const request_t &r, int code) {
+        char payload[128];
+        int n = snprintf(payload, sizeof(payload), "{\"ID\":\"%s\",\"Code\":%d,\"Data\":[]}", r.id.c_str(), code);
+        return iot_gateway_on_reply(&gw, r.op, payload, (size_t)n);
+    }
+
+    iot_gateway_sub_state_t state(int i) {
+        return iot_gateway_sub_state(&gw, PRODUCT_KEY, device_name(i));
+    }
+};
+
+// 按批大小、在途数与发送间隔分批发出
+TEST(tm_gateway, test_batches_respect_limits) {
+    init(10, 0, 2, 100, 1000, 0);
+    LONGS_EQUAL(VOLC_OK, request(IOT_GATEWAY_OP_LOGIN, devices(0, 25)));
+    LONGS_EQUAL(IOT_GATEWAY_SUB_LOGGING_IN, state(24));
+    LONGS_EQUAL(100, poll(0));
+    LONGS_EQUAL(1, s_sent.size());
+    LONGS_EQUAL(10, s_sent[0].devices.size());
+    CHECK(s_sent[0].signed_items);
+    STRCMP_EQUAL("pk/dev0000", s_sent[0].devices[0].c_str());
+    LONGS_EQUAL(900, poll(100));
+    LONGS_EQUAL(2, s_sent.size());
+    // 在途已满，等第一批回复或超时
+    LONGS_EQUAL(800, poll(200));
+    LONGS_EQUAL(2, s_sent.size());
+    LONGS_EQUAL(VOLC_OK, reply(s_sent[0], 0));
+    LONGS_EQUAL(IOT_GATEWAY_SUB_ONLINE, state(0));
+    LONGS_EQUAL(IOT_GATEWAY_SUB_LOGGING_IN, state(10));
+    poll(200);
+    LONGS_EQUAL(3, s_sent.size());
+    LONGS_EQUAL(5, s_sent[2].devices.size());
+    LONGS_EQUAL(VOLC_OK, reply(s_sent[1], 0));
+    LONGS_EQUAL(VOLC_OK, reply(s_sent[2], 0));
+    LONGS_EQUAL(VOLC_ERR_INVALID_PARAM, reply(s_sent[2], 0));
+    LONGS_EQUAL(-1, poll(300));
+    LONGS_EQUAL(25, iot_gateway_online_count(&gw));
+    LONGS_EQUAL(3, s_results.size());
+
+    // 字节上限：每条请求不超过上限，超出的子设备留到下一批
+    iot_gateway_deinit(&gw);
+    s_sent.clear();
+    init(50, 400, 1, 1, 1000, 0);
+    LONGS_EQUAL(VOLC_OK, request(IOT_GATEWAY_OP_LOGOUT, devices(0, 20)));
+    size_t sent_devices = 0;
+    for (uint64_t t = 0; s_sent.size() == 0 || sent_devices < 20; t++) {
+        size_t before = s_sent.size();
+        poll(t);
+        if (s_sent.size() > before) {
+            CHECK(s_sent.back().bytes <= 400);
+            sent_devices += s_sent.back().devices.size();
+            LONGS_EQUAL(VOLC_OK, reply(s_sent.back(), 0));
+        }
+    }
+    CHECK(s_sent.size() > 1);
+    LONGS_EQUAL(IOT_GATEWAY_SUB_OFFLINE, state(19));
+}
+
+// 未发出的反向请求互相取消，重复请求不重复发送，不合法的整批不排队
+TEST(tm_gateway, test_cancel_and_dedupe) {
+    init(10, 0, 2, 100, 1000, 0);
+    LONGS_EQUAL(VOLC_ERR_INVALID_PARAM, request(IOT_GATEWAY_OP_LOGIN, {{PRODUCT_KEY, "bad name", "s", NULL}}));
+    LONGS_EQUAL(VOLC_ERR_TM_GATEWAY_NO_SECRET, request(IOT_GATEWAY_OP_LOGIN, devices(0, 2, NULL)));
+    LONGS_EQUAL(IOT_GATEWAY_SUB_UNKNOWN, state(0));
+    LONGS_EQUAL(-1, poll(0));
+
+    LONGS_EQUAL(VOLC_OK, request(IOT_GATEWAY_OP_LOGIN, devices(0, 2)));
+    LONGS_EQUAL(VOLC_OK, request(IOT_GATEWAY_OP_LOGOUT, devices(0, 1)));
+    LONGS_EQUAL(IOT_GATEWAY_SUB_LOGGING_OUT, state(0));
+    poll(0);
+    LONGS_EQUAL(1, s_sent.size());
+    LONGS_EQUAL(IOT_GATEWAY_OP_LOGIN, s_sent[0].op);
+    LONGS_EQUAL(1, s_sent[0].devices.size());
+    STRCMP_EQUAL("pk/dev0001", s_sent[0].devices[0].c_str());
+    // 在途的登录不重复发送；之前保存的密钥可以继续使用
+    LONGS_EQUAL(VOLC_OK, request(IOT_GATEWAY_OP_LOGIN, devices(1, 1, NULL)));
+    poll(100);
+    LONGS_EQUAL(2, s_sent.size());
+    LONGS_EQUAL(IOT_GATEWAY_OP_LOGOUT, s_sent[1].op);
+    STRCMP_EQUAL("pk/dev0000", s_sent[1].devices[0].c_str());
+    // 登录在途时登出排队，回复后再发出
+    LONGS_EQUAL(VOLC_OK, request(IOT_GATEWAY_OP_LOGOUT, devices(1, 1)));
+    LONGS_EQUAL(800, poll(200));
+    LONGS_EQUAL(2, s_sent.size());
+    LONGS_EQUAL(VOLC_OK, reply(s_sent[0], 0));
+    LONGS_EQUAL(IOT_GATEWAY_SUB_LOGGING_OUT, state(1));
+    LONGS_EQUAL(1, iot_gateway_online_count(&gw));
+    poll(200);
+    LONGS_EQUAL(3, s_sent.size());
+    LONGS_EQUAL(IOT_GATEWAY_OP_LOGOUT, s_sent[2].op);
+    LONGS_EQUAL(VOLC_OK, reply(s_sent[2], 0));
+    LONGS_EQUAL(IOT_GATEWAY_SUB_OFFLINE, state(1));
+    LONGS_EQUAL(0, iot_gateway_online_count(&gw));
+    // 已离线的子设备再登出不发送
+    LONGS_EQUAL(VOLC_OK, request(IOT_GATEWAY_OP_LOGOUT, devices(1, 1)));
+    LONGS_EQUAL(IOT_GATEWAY_SUB_OFFLINE, state(1));
+}
+
+// 超时后重发，超过次数按失败回调；旧请求晚到的回复被忽略
+TEST(tm_gateway, test_timeout_retries_then_fails) {
+    init(10, 0, 1, 100, 1000, 2);
+    LONGS_EQUAL(VOLC_OK, request(IOT_GATEWAY_OP_ADD_TOPO, devices(0, 3)));
+    LONGS_EQUAL(1000, poll(0));
+    LONGS_EQUAL(1000, poll(1000));
+    LONGS_EQUAL(2, s_sent.size());
+    CHECK(s_sent[0].id != s_sent[1].id);
+    LONGS_EQUAL(3, s_sent[1].devices.size());
+    LONGS_EQUAL(VOLC_ERR_INVALID_PARAM, reply(s_sent[0], 0));
+    LONGS_EQUAL(-1, poll(2000));
+    LONGS_EQUAL(1, s_results.size());
+    LONGS_EQUAL(VOLC_ERR_TM_GATEWAY_REPLY_TIMEOUT, s_results[0].code);
+    LONGS_EQUAL(3, s_results[0].count);
+    LONGS_EQUAL(2, gw.timeouts);
+
+    // 服务端返回错误时不改变状态
+    LONGS_EQUAL(VOLC_OK, request(IOT_GATEWAY_OP_LOGIN, devices(0, 1)));
+    poll(3000);
+    LONGS_EQUAL(VOLC_OK, reply(s_sent.back(), 400));
+    LONGS_EQUAL(400, s_results.back().code);
+    LONGS_EQUAL(IOT_GATEWAY_SUB_UNKNOWN, state(0));
+}
+
+// 重连后在线的子设备按批重新登录，等待登出的只标记离线
+TEST(tm_gateway, test_reconnect_relogins_online_sub_devices) {
+    init(10, 0, 2, 100, 1000, 0);
+    LONGS_EQUAL(0, iot_gateway_on_reconnect(&gw));
+    LONGS_EQUAL(VOLC_OK, request(IOT_GATEWAY_OP_LOGIN, devices(0, 3)));
+    poll(0);
+    LONGS_EQUAL(VOLC_OK, reply(s_sent[0], 0));
+    LONGS_EQUAL(3, iot_gateway_online_count(&gw));
+    LONGS_EQUAL(VOLC_OK, request(IOT_GATEWAY_OP_LOGOUT, devices(2, 1)));
+    LONGS_EQUAL(IOT_GATEWAY_SUB_LOGGING_OUT, state(2));
+
+    LONGS_EQUAL(2, iot_gateway_on_reconnect(&gw));
+    LONGS_EQUAL(0, iot_gateway_online_count(&gw));
+    LONGS_EQUAL(IOT_GATEWAY_SUB_LOGGING_IN, state(0));
+    LONGS_EQUAL(IOT_GATEWAY_SUB_LOGGING_IN, state(1));
+    LONGS_EQUAL(IOT_GATEWAY_SUB_OFFLINE, state(2));
+    // 重复通知不重复排队
+    LONGS_EQUAL(0, iot_gateway_on_reconnect(&gw));
+    LONGS_EQUAL(1000, poll(100));
+    LONGS_EQUAL(2, s_sent.size());
+    LONGS_EQUAL(IOT_GATEWAY_OP_LOGIN, s_sent[1].op);
+    LONGS_EQUAL(2, s_sent[1].devices.size());
+    CHECK(s_sent[1].signed_items);
+    LONGS_EQUAL(VOLC_OK, reply(s_sent[1], 0));
+    LONGS_EQUAL(2, iot_gateway_online_count(&gw));
+    LONGS_EQUAL(IOT_GATEWAY_SUB_ONLINE, state(1));
+    LONGS_EQUAL(-1, poll(200));
+}
+
+// 1000个子设备经同一网关添加拓扑并登录，模拟服务端回复有延迟且偶尔丢失
+TEST(tm_gateway, test_simulated_thousand_sub_devices) {
+    const int subs = 1000;
+    const uint32_t batch_devices = 50, batch_bytes = 8192, max_inflight = 2, interval_ms = 200;
+    init(batch_devices, batch_bytes, max_inflight, interval_ms, 3000, 3);
+    struct pending_t {
+        uint64_t due_ms;
+        size_t index;
+    };
+    std::vector<pending_t> pending;
+    std::set<std::string> added;
+    uint32_t seed = 2024;
+    size_t dropped = 0;
+    size_t replied = 0;
+    size_t max_seen_inflight = 0;
+    uint64_t min_gap_ms = UINT64_MAX;
+
+    LONGS_EQUAL(VOLC_OK, request(IOT_GATEWAY_OP_ADD_TOPO, devices(0, subs)));
+    LONGS_EQUAL(VOLC_OK, request(IOT_GATEWAY_OP_LOGIN, devices(0, subs)));
+    bool logout_sent = false;
+    uint64_t t = 0;
+    for (; t < 120000; t += 10) {
+        // 回复到期的请求
+        for (size_t i = 0; i < pending.size();) {
+            if (pending[i].due_ms > t) {
+                i++;
+                continue;
+            }
+            const request_t &r = s_sent[pending[i].index];
+            if (r.op == IOT_GATEWAY_OP_ADD_TOPO) {
+                added.insert(r.devices.begin(), r.devices.end());
+            }
+            reply(r, 0);
+            replied++;
+            pending.erase(pending.begin() + i);
+        }
+        size_t before = s_sent.size();
+        int32_t next = poll(t);
+        CHECK(gw.inflight_count <= max_inflight);
+        if (gw.inflight_count > max_seen_inflight) {
+            max_seen_inflight = gw.inflight_count;
+        }
+        for (size_t i = before; i < s_sent.size(); i++) {
+            const request_t &r = s_sent[i];
+            CHECK(r.devices.size() <= batch_devices);
+            CHECK(r.bytes <= batch_bytes);
+            std::set<std::string> unique(r.devices.begin(), r.devices.end());
+            LONGS_EQUAL(r.devices.size(), unique.size());
+            if (r.op == IOT_GATEWAY_OP_LOGIN) {
+                // 同一子设备先添加拓扑再登录
+                for (size_t j = 0; j < r.devices.size(); j++) {
+                    CHECK(added.count(r.devices[j]) == 1);
+                }
+            }
+            if (i > 0 && r.sent_ms - s_sent[i - 1].sent_ms < min_gap_ms) {
+                min_gap_ms = r.sent_ms - s_sent[i - 1].sent_ms;
+            }
+            seed = seed * 1103515245 + 12345;
+            if ((seed >> 16) % 100 < 3) {
+                dropped++;
+                continue;
+            }
+            pending_t p = {t + 50 + (seed >> 8) % 350, i};
+            pending.push_back(p);
+        }
+        if (!logout_sent && iot_gateway_online_count(&gw) == (size_t)subs) {
+            LONGS_EQUAL(VOLC_OK, request(IOT_GATEWAY_OP_LOGOUT, devices(0, 300)));
+            logout_sent = true;
+            continue;
+        }
+        if (logout_sent && next < 0 && pending.empty()) {
+            break;
+        }
+    }
+    CHECK(logout_sent);
+    LONGS_EQUAL(subs - 300, iot_gateway_online_count(&gw));
+    LONGS_EQUAL(IOT_GATEWAY_SUB_OFFLINE, state(0));
+    LONGS_EQUAL(IOT_GATEWAY_SUB_ONLINE, state(subs - 1));
+    CHECK(min_gap_ms >= interval_ms);
+    for (size_t i = 0; i < s_results.size(); i++) {
+        LONGS_EQUAL(VOLC_OK, s_results[i].code);
+    }
+    // 丢失回复的请求都在超时后重发
+    LONGS_EQUAL(dropped, gw.timeouts);
+    LONGS_EQUAL(gw.requests_out, replied + gw.timeouts);
+    UT_PRINT(StringFromFormat("%d sub-devices: add topo + login + 300 logout in %llu requests (%llu device entries, "
+        "%llu timeouts after %zu dropped replies), max %zu in flight, min gap %llu ms, done at %.1f s",
+        subs, (unsigned long long)gw.requests_out, (unsigned long long)gw.devices_out,
+        (unsigned long long)gw.timeouts, dropped, max_seen_inflight, (unsigned long long)min_gap_ms,
+        t / 1000.0).asCharString());
+}
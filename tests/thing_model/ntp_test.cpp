@@ -0,0 +1,117 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+  #include "CppUTest/TestHarness_c.h"
+  #include "onesdk_config.h"
+  #include "thing_model/iot_ntp.h"
+  #include "error_code.h"
+}
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// 服务端时间 = 单调时钟 + TRUE_OFFSET
+#define TRUE_OFFSET 1700000000000LL
+
+TEST_GROUP(tm_ntp) {
+    iot_ntp_clock_t clock;
+    uint64_t mono;          // 本地单调时钟
+    int64_t server_offset;  // 本地应答方的时钟偏差，可以跳变
+
+    void setup() {
+        iot_ntp_clock_init(&clock);
+        mono = 5000;
+        server_offset = TRUE_OFFSET;
+    }
+
+    // 本地应答方：上行、下行延迟分别为up_ms、down_ms，服务端处理耗时2ms
+    int exchange(uint64_t up_ms, uint64_t down_ms) {
+        uint64_t t1 = mono;
+        uint64_t t2 = (uint64_t) ((int64_t) (t1 + up_ms) + server_offset);
+        uint64_t t3 = t2 + 2;
+        mono = t1 + up_ms + 2 + down_ms;
+        int ret = iot_ntp_clock_add_sample(&clock, t1, t2, t3, mono);
+        mono += 1000;
+        return ret;
+    }
+
+    int64_t error_ms() {
+        return iot_ntp_clock_offset(&clock, mono) - server_offset;
+    }
+};
+
+TEST(tm_ntp, test_offset_and_delay_from_four_timestamps) {
+    LONGS_EQUAL(VOLC_OK, exchange(40, 40));
+    CHECK(clock.synced);
+    LONGS_EQUAL(0, error_ms());
+    LONGS_EQUAL(80, clock.last_delay_ms);
+    // 上下行不对称时误差为两者之差的一半
+    iot_ntp_clock_init(&clock);
+    LONGS_EQUAL(VOLC_OK, exchange(100, 20));
+    LONGS_EQUAL(40, error_ms());
+    // 回复早于请求的时间戳不合法
+    LONGS_EQUAL(VOLC_ERR_INVALID_PARAM, iot_ntp_clock_add_sample(&clock, 100, 10, 12, 50));
+    LONGS_EQUAL(VOLC_ERR_INVALID_PARAM, iot_ntp_clock_add_sample(&clock, 100, 10, 200, 150));
+}
+
+// 个别采样的上行或下行被严重拖慢，中位数不受影响
+TEST(tm_ntp, test_median_rejects_asymmetric_delays) {
+    uint64_t up[] = {30, 900, 32, 28, 31, 30, 25, 1500};
+    uint64_t down[] = {30, 20, 29, 31, 30, 1200, 26, 30};
+    for (size_t i = 0; i < sizeof(up) / sizeof(up[0]); i++) {
+        LONGS_EQUAL(VOLC_OK, exchange(up[i], down[i]));
+        CHECK(labs((long) error_ms()) <= 3);
+    }
+    LONGS_EQUAL(1, clock.steps);
+    UT_PRINT(StringFromFormat("ntp: samples=%llu steps=%llu error=%lldms",
+                              (unsigned long long) clock.samples, (unsigned long long) clock.steps,
+                              (long long) error_ms()).asCharString());
+}
+
+// 服务端时钟跳变：偏差超过阈值，多数采样一致后直接跳变；小的变化按速率缓慢调整，时间不回退
+TEST(tm_ntp, test_clock_step_and_slew) {
+    for (int i = 0; i < IOT_NTP_FILTER_SIZE; i++) {
+        exchange(20, 20);
+    }
+    server_offset += 5000;
+    exchange(20, 20);
+    exchange(20, 20);
+    LONGS_EQUAL(-5000, error_ms());
+    exchange(20, 20);
+    LONGS_EQUAL(0, error_ms());
+    LONGS_EQUAL(2, clock.steps);
+
+    for (int i = 0; i < IOT_NTP_FILTER_SIZE; i++) {
+        exchange(20, 20);
+    }
+    server_offset -= 300;
+    for (int i = 0; i < IOT_NTP_FILTER_SIZE; i++) {
+        exchange(20, 20);
+    }
+    LONGS_EQUAL(2, clock.steps);
+    int64_t prev_now = (int64_t) mono + iot_ntp_clock_offset(&clock, mono);
+    CHECK(error_ms() > 0);
+    // 每经过IOT_NTP_SLEW_RATE_DIVISOR毫秒调整1ms
+    for (int i = 0; i < 700; i++) {
+        mono += 1000;
+        int64_t now = (int64_t) mono + iot_ntp_clock_offset(&clock, mono);
+        CHECK(now > prev_now);
+        prev_now = now;
+    }
+    LONGS_EQUAL(0, error_ms());
+}
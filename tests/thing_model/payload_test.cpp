@@ -0,0 +1,342 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+  #include "CppUTest/TestHarness_c.h"
+  #include "aws/common/json.h"
+  #include "util/aws_json.h"
+  #include "util/json_writer.h"
+  #include "util/util.h"
+  #include "iot/iot_utils.h"
+  #include "thing_model/iot_tm_header.h"
+  #include "error_code.h"
+}
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static std::string format_double(double value) {
+    char num[JSON_WRITER_NUM_SIZE];
+    size_t n = json_writer_format_double(value, num);
+    return std::string(num, n);
+}
+
+// 时间戳每次不同，比较前把 "key":数字 的数字替换为0
+static std::string mask_number(std::string s, const char *key) {
+    std::string pattern = std::string("\"") + key + "\":";
+    size_t pos = 0;
+    while ((pos = s.find(pattern, pos)) != std::string::npos) {
+        size_t start = pos + pattern.size();
+        size_t end = start;
+        while (end < s.size() && s[end] >= '0' && s[end] <= '9') {
+            end++;
+        }
+        if (end > start) {
+            s.replace(start, end - start, "0");
+        }
+        pos = start;
+    }
+    return s;
+}
+
+static std::string buf_str(iot_mqtt_buf_t *buf) {
+    std::string s((const char *)buf->data, buf->len);
+    iot_mqtt_buf_unref(buf);
+    return s;
+}
+
+static std::string json_str(struct aws_json_value *json) {
+    struct aws_byte_buf buf = aws_json_obj_to_byte_buf(aws_alloc(), json);
+    std::string s((const char *)buf.buffer, buf.len);
+    aws_byte_buf_clean_up(&buf);
+    return s;
+}
+
+// 改造前的做法：每个值一个aws_json对象，最后整树序列化
+static void legacy_add(struct aws_json_value *obj, const char *key, struct aws_json_value *value) {
+    if (value == NULL) {
+        return;
+    }
+    if (aws_json_value_add_to_object(obj, aws_byte_cursor_from_c_str(key), value) != AWS_OP_SUCCESS) {
+        aws_json_value_destroy(value);
+    }
+}
+
+static struct aws_json_value *legacy_property(struct aws_json_value *value) {
+    struct aws_json_value *node = aws_json_value_new_object(aws_alloc());
+    legacy_add(node, "value", value);
+    aws_json_add_num_val(node, "time", (double)unix_timestamp_ms());
+    return node;
+}
+
+static struct aws_json_value *legacy_envelope(const char *id_key, const char *id, const char *version_key,
+                                              const char *params_key, struct aws_json_value *params) {
+    struct aws_json_value *root = aws_json_value_new_object(aws_alloc());
+    aws_json_add_str_val(root, id_key, id);
+    aws_json_add_str_val(root, version_key, SDK_VERSION);
+    legacy_add(root, params_key, params);
+    return root;
+}
+
+TEST_GROUP(tm_payload) {
+  void setup()
+  {
+  }
+
+  void teardown()
+  {
+  }
+};
+
+TEST(tm_payload, test_double_matches_cjson) {
+    // 右侧为cJSON对同一值的输出
+    static const struct {
+        double value;
+        const char *want;
+    } cases[] = {
+        {0, "0"}, {-0.0, "0"}, {1, "1"}, {-1, "-1"}, {42, "42"},
+        {23.5, "23.5"}, {0.1, "0.1"}, {-12.25, "-12.25"}, {3.14159, "3.14159"}, {36.6, "36.6"},
+        {0.05, "0.05"}, {0.001, "0.001"}, {0.0001, "0.0001"}, {0.00001, "1e-05"}, {1.5e-7, "1.5e-07"},
+        {65535.5, "65535.5"}, {2147483648.0, "2147483648"}, {-2147483649.0, "-2147483649"},
+        {1729300000000.0, "1729300000000"}, {123456789012345.0, "123456789012345"},
+        {1e15, "1e+15"}, {1e21, "1e+21"}, {1e300, "1e+300"}, {-4.9e-324, "-4.94065645841247e-324"},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        STRCMP_EQUAL(cases[i].want, format_double(cases[i].value).c_str());
+    }
+}
+
+TEST(tm_payload, test_double_shortest_roundtrip) {
+    // cJSON在这两种情况下分别输出17位与有损的15位
+    STRCMP_EQUAL("0.3333333333333333", format_double(1.0 / 3.0).c_str());
+    STRCMP_EQUAL("0.30000000000000004", format_double(0.1 + 0.2).c_str());
+
+    uint64_t state = 88172645463325252ULL;
+    for (int i = 0; i < 200000; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        double value;
+        memcpy(&value, &state, sizeof(value));
+        if (value != value || value - value != 0) {
+            continue;
+        }
+        std::string s = format_double(value);
+        CHECK(strtod(s.c_str(), NULL) == value);
+    }
+}
+
+TEST(tm_payload, test_writer_fixed_buffer) {
+    uint8_t storage[16];
+    struct aws_byte_buf buf = aws_byte_buf_from_empty_array(storage, sizeof(storage));
+    json_writer_t w;
+    json_writer_init(&w, &buf);
+    json_writer_begin_object(&w);
+    json_writer_kv_string(&w, "key", "a value that does not fit");
+    json_writer_end_object(&w);
+    LONGS_EQUAL(VOLC_ERR_INVALID_PARAM, json_writer_finish(&w));
+    CHECK(buf.len <= sizeof(storage));
+
+    buf = aws_byte_buf_from_empty_array(storage, sizeof(storage));
+    json_writer_init(&w, &buf);
+    json_writer_begin_object(&w);
+    json_writer_kv_int(&w, "k", 12);
+    json_writer_end_object(&w);
+    LONGS_EQUAL(VOLC_OK, json_writer_finish(&w));
+    STRCMP_EQUAL("{\"k\":12}", (const char *)storage);
+}
+
+TEST(tm_payload, test_members_spans_and_duplicates) {
+    iot_tm_members_t *m = iot_tm_members_new();
+    json_writer_t *w = iot_tm_members_begin(m, "a");
+    json_writer_int(w, 1);
+    iot_tm_members_end(m);
+    w = iot_tm_members_begin(m, "b\"q");
+    json_writer_string(w, "x");
+    iot_tm_members_end(m);
+    // 与cJSON一致，key不区分大小写
+    POINTERS_EQUAL(NULL, iot_tm_members_begin(m, "A"));
+    LONGS_EQUAL(2, m->count);
+    STRCMP_EQUAL("b\\\"q", std::string((const char *)m->buf.buffer + m->members[1].key_off, m->members[1].key_len).c_str());
+    STRCMP_EQUAL("\"x\"", std::string((const char *)m->buf.buffer + m->members[1].value_off, m->members[1].value_len).c_str());
+
+    iot_mqtt_buf_t *out;
+    json_writer_t pw;
+    struct aws_byte_buf view;
+    out = iot_tm_payload_begin(&pw, &view, m->buf.len + 2);
+    iot_tm_members_write(m, &pw);
+    out = iot_tm_payload_finish(&pw, &view, out);
+    CHECK(out != NULL);
+    STRCMP_EQUAL("{\"a\":1,\"b\\\"q\":\"x\"}", buf_str(out).c_str());
+
+    iot_tm_members_reset(m);
+    LONGS_EQUAL(VOLC_OK, iot_tm_members_set_json_str(m, "{ \"n\" : 1.50, \"arr\": [1, 2] }"));
+    LONGS_EQUAL(2, m->count);
+    LONGS_EQUAL(VOLC_ERR_INVALID_PARAM, iot_tm_members_set_json_str(m, "[1]"));
+    LONGS_EQUAL(0, m->count);
+    iot_tm_members_destroy(m);
+}
+
+TEST(tm_payload, test_property_post_matches_aws_json) {
+    iot_tm_msg_property_post_t *post;
+    iot_property_post_init(&post);
+    iot_property_post_add_param_num(post, "default:Temp", 23.5);
+    iot_property_post_add_param_num(post, "Count", 42);
+    iot_property_post_add_param_string(post, "Name", "line\n\"x\"");
+    iot_property_post_add_param_json_str(post, "Geo", "{ \"lat\": 39.9, \"lng\" : 116.40 }");
+    iot_property_post_add_param_num(post, "default:temp", 1);
+    iot_property_post_add_param_string(post, "Null", NULL);
+    iot_property_post_add_param_json_str(post, "Bad", "{oops");
+    std::string got = mask_number(buf_str(_tm_property_post_payload_buf(post)), "time");
+
+    struct aws_json_value *params = aws_json_value_new_object(aws_alloc());
+    legacy_add(params, "default:Temp", legacy_property(aws_json_value_new_number(aws_alloc(), 23.5)));
+    legacy_add(params, "Count", legacy_property(aws_json_value_new_number(aws_alloc(), 42)));
+    legacy_add(params, "Name", legacy_property(aws_json_value_new_string(aws_alloc(), aws_byte_cursor_from_c_str("line\n\"x\""))));
+    legacy_add(params, "Geo", legacy_property(aws_json_value_new_from_string(aws_alloc(),
+        aws_byte_cursor_from_c_str("{ \"lat\": 39.9, \"lng\" : 116.40 }"))));
+    legacy_add(params, "default:temp", legacy_property(aws_json_value_new_number(aws_alloc(), 1)));
+    legacy_add(params, "Null", legacy_property(NULL));
+    legacy_add(params, "Bad", legacy_property(aws_json_value_new_from_string(aws_alloc(), aws_byte_cursor_from_c_str("{oops"))));
+    struct aws_json_value *root = legacy_envelope("id", post->id, "version", "params", params);
+    std::string want = mask_number(json_str(root), "time");
+    aws_json_value_destroy(root);
+
+    STRCMP_EQUAL(want.c_str(), got.c_str());
+    std::string golden = std::string("{\"id\":\"") + post->id + "\",\"version\":\"" SDK_VERSION "\",\"params\":{"
+        "\"default:Temp\":{\"value\":23.5,\"time\":0},\"Count\":{\"value\":42,\"time\":0},"
+        "\"Name\":{\"value\":\"line\\n\\\"x\\\"\",\"time\":0},\"Geo\":{\"value\":{\"lat\":39.9,\"lng\":116.4},\"time\":0},"
+        "\"Null\":{\"time\":0},\"Bad\":{\"time\":0}}}";
+    STRCMP_EQUAL(golden.c_str(), got.c_str());
+    iot_property_post_free(post);
+}
+
+TEST(tm_payload, test_event_post_matches_aws_json) {
+    iot_tm_msg_event_post_t *event;
+    iot_tm_msg_event_post_init(&event, "default", "Alarm");
+    iot_tm_msg_event_post_param_add_num(event, (char *)"Level", 3);
+    iot_tm_msg_event_post_param_add_num(event, (char *)"Ratio", 0.75);
+    iot_tm_msg_event_post_param_add_string(event, (char *)"Msg", (char *)"over\tflow");
+    std::string got = mask_number(buf_str(_tm_event_post_payload_buf(event)), "Time");
+
+    struct aws_json_value *value = aws_json_value_new_object(aws_alloc());
+    aws_json_add_num_val(value, "Level", 3);
+    aws_json_add_num_val(value, "Ratio", 0.75);
+    aws_json_add_str_val(value, "Msg", "over\tflow");
+    struct aws_json_value *params = aws_json_value_new_object(aws_alloc());
+    aws_json_add_num_val(params, "Time", (double)get_current_time_mil());
+    legacy_add(params, "Value", value);
+    struct aws_json_value *root = legacy_envelope("ID", event->id, "Version", "Params", params);
+    std::string want = mask_number(json_str(root), "Time");
+    aws_json_value_destroy(root);
+    STRCMP_EQUAL(want.c_str(), got.c_str());
+
+    // 整体设置的参数
+    iot_tm_msg_event_post_set_prams_json_str(event, (char *)"{\"a\": 1.50, \"b\": [1, 2]}");
+    got = mask_number(buf_str(_tm_event_post_payload_buf(event)), "Time");
+    std::string golden = std::string("{\"ID\":\"") + event->id + "\",\"Version\":\"" SDK_VERSION "\","
+        "\"Params\":{\"Time\":0,\"Value\":{\"a\":1.5,\"b\":[1,2]}}}";
+    STRCMP_EQUAL(golden.c_str(), got.c_str());
+    aws_mem_release(aws_alloc(), (void *)event->id);
+    iot_tm_msg_event_post_free(event);
+}
+
+TEST(tm_payload, test_shadow_post_matches_aws_json) {
+    iot_tm_msg_shadow_post_t *shadow;
+    iot_shadow_post_init(&shadow);
+    iot_shadow_post_add_param_num(shadow, "temp", 21.5);
+    iot_shadow_post_add_param_string(shadow, "mode", "auto");
+    iot_shadow_post_add_param_json_str(shadow, "cfg", "{\"on\": true, \"level\": 2}");
+    std::string got = mask_number(buf_str(_tm_shadow_post_payload_buf(shadow)), "version");
+
+    struct aws_json_value *report = aws_json_value_new_object(aws_alloc());
+    aws_json_add_num_val(report, "temp", 21.5);
+    aws_json_add_str_val(report, "mode", "auto");
+    legacy_add(report, "cfg", aws_json_value_new_from_string(aws_alloc(), aws_byte_cursor_from_c_str("{\"on\": true, \"level\": 2}")));
+    struct aws_json_value *params = aws_json_value_new_object(aws_alloc());
+    aws_json_add_num_val(params, "version", (double)get_current_time_mil());
+    legacy_add(params, "report", report);
+    struct aws_json_value *root = legacy_envelope("id", shadow->id, "version", "params", params);
+    std::string want = mask_number(json_str(root), "version");
+    aws_json_value_destroy(root);
+
+    STRCMP_EQUAL(want.c_str(), got.c_str());
+    iot_shadow_post_free(shadow);
+}
+
+// 50个属性的一次上报：改造前每个值建aws_json节点再整树序列化，改造后直接写入
+TEST(tm_payload, test_benchmark_50_property_post) {
+    const int props = 50;
+    const int rounds = 2000;
+    char keys[props][32];
+    for (int i = 0; i < props; i++) {
+        snprintf(keys[i], sizeof(keys[i]), "default:Property%02d", i);
+    }
+    size_t bytes = 0;
+    std::string legacy_out;
+    std::string direct_out;
+
+    uint64_t start = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        struct aws_json_value *params = aws_json_value_new_object(aws_alloc());
+        for (int i = 0; i < props; i++) {
+            legacy_add(params, keys[i], legacy_property(aws_json_value_new_number(aws_alloc(), i * 1.25 + r)));
+        }
+        struct aws_json_value *root = legacy_envelope("id", "1234567890", "version", "params", params);
+        struct aws_byte_buf buf = aws_json_obj_to_byte_buf(aws_alloc(), root);
+        bytes += buf.len;
+        if (r == 0) {
+            legacy_out.assign((const char *)buf.buffer, buf.len);
+        }
+        aws_byte_buf_clean_up(&buf);
+        aws_json_value_destroy(root);
+    }
+    uint64_t legacy_ns = now_ns() - start;
+
+    start = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        iot_tm_msg_property_post_t *post;
+        char *id = (char *)aws_mem_acquire(aws_alloc(), 11);
+        memcpy(id, "1234567890", 11);
+        iot_property_post_init_with_id(&post, id);
+        for (int i = 0; i < props; i++) {
+            iot_property_post_add_param_num(post, keys[i], i * 1.25 + r);
+        }
+        iot_mqtt_buf_t *buf = _tm_property_post_payload_buf(post);
+        bytes += buf->len;
+        if (r == 0) {
+            direct_out.assign((const char *)buf->data, buf->len);
+        }
+        iot_mqtt_buf_unref(buf);
+        iot_property_post_free(post);
+    }
+    uint64_t direct_ns = now_ns() - start;
+
+    STRCMP_EQUAL(mask_number(legacy_out, "time").c_str(), mask_number(direct_out, "time").c_str());
+    UT_PRINT(StringFromFormat("50-property post: aws_json %.1f us/op, json_writer %.1f us/op, %d bytes/op",
+        (double)legacy_ns / 1000 / rounds, (double)direct_ns / 1000 / rounds,
+        (int)(bytes / (2 * (size_t)rounds))).asCharString());
+}
@@ -0,0 +1,181 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+  #include "CppUTest/TestHarness_c.h"
+  #include "thing_model/tm_pending.h"
+  #include "error_code.h"
+}
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#define THREADS 8
+#define REQUESTS_PER_THREAD 500
+
+struct request_t {
+    std::string id;
+    int32_t expected_code;
+    std::atomic<int> calls;
+    std::atomic<int32_t> code;
+    std::atomic<bool> payload_ok;
+};
+
+static void on_reply(const char *msg_id, int32_t code, const char *payload, size_t len, void *userdata) {
+    request_t *req = (request_t *) userdata;
+    req->code = code;
+    // 回复payload里的ID与回调的ID都应是这个请求的
+    std::string expected = "{\"ID\":\"" + req->id + "\"";
+    req->payload_ok = req->id == msg_id &&
+                      (payload == NULL || std::string(payload, len).compare(0, expected.size(), expected) == 0);
+    req->calls++;
+}
+
+TEST_GROUP(tm_pending) {
+    iot_tm_pending_t p;
+
+    void setup() {
+        LONGS_EQUAL(VOLC_OK, iot_tm_pending_init(&p));
+    }
+
+    void teardown() {
+        iot_tm_pending_deinit(&p);
+    }
+};
+
+// 多个线程并发发出请求，本地应答方把回复打乱顺序后送回，每个请求恰好收到自己的回复
+TEST(tm_pending, test_concurrent_requests_with_reordered_replies) {
+    std::vector<request_t> requests(THREADS * REQUESTS_PER_THREAD);
+    std::mutex inbox_mutex;
+    std::vector<size_t> inbox;
+    std::atomic<int> finished_threads(0);
+    // 断言只在主线程做，其他线程只计数
+    std::atomic<int> errors(0);
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < THREADS; t++) {
+        workers.emplace_back([&, t]() {
+            for (int i = 0; i < REQUESTS_PER_THREAD; i++) {
+                size_t index = (size_t) t * REQUESTS_PER_THREAD + i;
+                request_t &req = requests[index];
+                req.id = "req-" + std::to_string(t) + "-" + std::to_string(i);
+                req.expected_code = (int32_t) (index % 7);
+                req.calls = 0;
+                if (iot_tm_pending_add(&p, req.id.c_str(), UINT64_MAX - 1, on_reply, &req) != VOLC_OK) {
+                    errors++;
+                    req.calls = 1;
+                    continue;
+                }
+                std::lock_guard<std::mutex> lock(inbox_mutex);
+                inbox.push_back(index);
+            }
+            // 等待本线程的请求全部完成
+            for (int i = 0; i < REQUESTS_PER_THREAD; i++) {
+                while (requests[(size_t) t * REQUESTS_PER_THREAD + i].calls.load() == 0) {
+                    usleep(100);
+                }
+            }
+            finished_threads++;
+        });
+    }
+
+    std::thread responder([&]() {
+        std::mt19937 rng(20250101);
+        size_t answered = 0;
+        while (answered < requests.size()) {
+            std::vector<size_t> batch;
+            {
+                std::lock_guard<std::mutex> lock(inbox_mutex);
+                batch.swap(inbox);
+            }
+            std::shuffle(batch.begin(), batch.end(), rng);
+            for (size_t index : batch) {
+                request_t &req = requests[index];
+                std::string payload = "{\"ID\":\"" + req.id + "\",\"Code\":" + std::to_string(req.expected_code) + "}";
+                if (!iot_tm_pending_complete(&p, req.id.c_str(), req.expected_code, payload.c_str(), payload.size())) {
+                    errors++;
+                }
+                // 重复的回复找不到请求
+                if (iot_tm_pending_complete(&p, req.id.c_str(), 0, NULL, 0)) {
+                    errors++;
+                }
+                answered++;
+            }
+            usleep(50);
+        }
+    });
+
+    for (auto &w : workers) {
+        w.join();
+    }
+    responder.join();
+
+    LONGS_EQUAL(0, errors.load());
+    LONGS_EQUAL(THREADS, finished_threads.load());
+    for (auto &req : requests) {
+        LONGS_EQUAL(1, req.calls.load());
+        LONGS_EQUAL(req.expected_code, req.code.load());
+        CHECK(req.payload_ok.load());
+    }
+    LONGS_EQUAL(0, iot_tm_pending_count(&p));
+    LONGS_EQUAL(requests.size(), p.registered);
+    LONGS_EQUAL(requests.size(), p.completed);
+    UT_PRINT(StringFromFormat("pending: %d threads, registered=%llu completed=%llu timeouts=%llu",
+                              THREADS, (unsigned long long) p.registered, (unsigned long long) p.completed,
+                              (unsigned long long) p.timeouts).asCharString());
+}
+
+// 到期的请求按超时回调，poll返回距下一个到期的时间
+TEST(tm_pending, test_timeout_and_cancel) {
+    request_t a, b, c;
+    a.id = "a"; b.id = "b"; c.id = "c";
+    a.calls = 0; b.calls = 0; c.calls = 0;
+    LONGS_EQUAL(-1, iot_tm_pending_poll(&p, 0));
+    LONGS_EQUAL(VOLC_OK, iot_tm_pending_add(&p, "a", 1000, on_reply, &a));
+    LONGS_EQUAL(VOLC_OK, iot_tm_pending_add(&p, "b", 3000, on_reply, &b));
+    LONGS_EQUAL(VOLC_ERR_INVALID_PARAM, iot_tm_pending_add(&p, "a", 5000, on_reply, &a));
+    LONGS_EQUAL(VOLC_OK, iot_tm_pending_add(&p, "c", 9000, on_reply, &c));
+
+    LONGS_EQUAL(600, iot_tm_pending_poll(&p, 400));
+    LONGS_EQUAL(0, a.calls.load());
+    LONGS_EQUAL(2000, iot_tm_pending_poll(&p, 1000));
+    LONGS_EQUAL(1, a.calls.load());
+    LONGS_EQUAL(VOLC_ERR_TM_REPLY_TIMEOUT, a.code.load());
+    // 超时之后到达的回复不再回调
+    CHECK_FALSE(iot_tm_pending_complete(&p, "a", 0, NULL, 0));
+    LONGS_EQUAL(1, a.calls.load());
+
+    iot_tm_pending_remove(&p, "b");
+    LONGS_EQUAL(5000, iot_tm_pending_poll(&p, 4000));
+    LONGS_EQUAL(0, b.calls.load());
+    LONGS_EQUAL(1, p.timeouts);
+
+    // 释放时仍在等待的请求按取消回调
+    iot_tm_pending_deinit(&p);
+    LONGS_EQUAL(1, c.calls.load());
+    LONGS_EQUAL(VOLC_ERR_TM_REPLY_CANCELLED, c.code.load());
+    LONGS_EQUAL(VOLC_OK, iot_tm_pending_init(&p));
+}
@@ -0,0 +1,236 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+  #include "CppUTest/TestHarness_c.h"
+  #include "thing_model/tm_property_cache.h"
+  #include "error_code.h"
+}
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#define PROPERTY_TOPIC "sys/pk/dn/thingmodel/property/post"
+#define BASE_TIME 1700000000000LL
+
+struct sent_t {
+    std::string topic;
+    std::string params;
+    size_t members;
+};
+
+static std::vector<sent_t> s_sent;
+static uint64_t s_payload_bytes = 0;
+
+static int record_send(const char *topic, const iot_tm_members_t *params, void *userdata) {
+    (void)userdata;
+    sent_t sent = {topic, "{" + std::string((const char *)params->buf.buffer, params->buf.len) + "}", params->count};
+    s_sent.push_back(sent);
+    s_payload_bytes += sent.params.size();
+    return VOLC_OK;
+}
+
+TEST_GROUP(tm_property_cache) {
+    iot_tm_property_cache_t c;
+    iot_tm_members_t *params;
+
+    void setup() {
+        s_sent.clear();
+        s_payload_bytes = 0;
+        LONGS_EQUAL(VOLC_OK, iot_tm_property_cache_init(&c, record_send, NULL));
+        params = iot_tm_members_new();
+    }
+
+    void teardown() {
+        iot_tm_members_destroy(params);
+        iot_tm_property_cache_deinit(&c);
+    }
+
+    void policy(const char *identifier, double abs, double pct, uint32_t min_ms, uint32_t max_ms, uint32_t hb_ms) {
+        iot_tm_property_policy_t p = {abs, pct, min_ms, max_ms, hb_ms};
+        LONGS_EQUAL(VOLC_OK, iot_tm_property_cache_set_policy(&c, identifier, &p));
+    }
+
+    // 属性上报格式的成员，time为采样时刻
+    void sample(const char *key, const char *value, uint64_t now_ms) {
+        char member[128];
+        snprintf(member, sizeof(member), "{\"value\":%s,\"time\":%lld}", value, (long long)(BASE_TIME + (int64_t)now_ms));
+        LONGS_EQUAL(VOLC_OK, iot_tm_members_add_raw(params, key, strlen(key), member, strlen(member)));
+    }
+
+    void post(uint64_t now_ms) {
+        LONGS_EQUAL(VOLC_OK, iot_tm_property_cache_post(&c, PROPERTY_TOPIC, params, now_ms));
+        iot_tm_members_reset(params);
+    }
+
+    void post1(const char *key, const char *value, uint64_t now_ms) {
+        sample(key, value, now_ms);
+        post(now_ms);
+    }
+};
+
+TEST(tm_property_cache, test_no_policy_passes_through) {
+    CHECK_FALSE(iot_tm_property_cache_enabled(&c));
+    post1("temp", "21.5", 0);
+    post1("temp", "21.5", 10);
+    LONGS_EQUAL(2, s_sent.size());
+    STRCMP_EQUAL("{\"temp\":{\"value\":21.5,\"time\":1700000000000}}", s_sent[0].params.c_str());
+    LONGS_EQUAL(-1, iot_tm_property_cache_poll(&c, 20));
+}
+
+TEST(tm_property_cache, test_deadband_abs_and_pct) {
+    policy("temp", 0.5, 0, 0, 0, 0);
+    policy("hum", 0, 10, 0, 0, 0);
+    CHECK(iot_tm_property_cache_enabled(&c));
+    post1("temp", "20", 0);
+    post1("temp", "20.4", 1);
+    post1("temp", "19.6", 2);
+    post1("temp", "20.6", 3);
+    LONGS_EQUAL(2, s_sent.size());
+    STRCMP_EQUAL("{\"temp\":{\"value\":20.6,\"time\":1700000000003}}", s_sent[1].params.c_str());
+    // 百分比死区相对上次上报值
+    post1("hum", "50", 4);
+    post1("hum", "54", 5);
+    post1("hum", "56", 6);
+    LONGS_EQUAL(4, s_sent.size());
+    STRCMP_EQUAL("{\"hum\":{\"value\":56,\"time\":1700000000006}}", s_sent[3].params.c_str());
+    // 非数值属性按内容比较
+    policy("mode", 100, 0, 0, 0, 0);
+    post1("mode", "\"auto\"", 7);
+    post1("mode", "\"auto\"", 8);
+    post1("mode", "\"manual\"", 9);
+    LONGS_EQUAL(6, s_sent.size());
+}
+
+// 最短间隔内的变化暂存，到期后上报最新值
+TEST(tm_property_cache, test_min_interval_holds_latest) {
+    policy("temp", 0, 0, 1000, 0, 0);
+    post1("temp", "1", 0);
+    post1("temp", "2", 100);
+    post1("temp", "3", 200);
+    LONGS_EQUAL(1, s_sent.size());
+    LONGS_EQUAL(800, iot_tm_property_cache_poll(&c, 200));
+    LONGS_EQUAL(-1, iot_tm_property_cache_poll(&c, 1000));
+    LONGS_EQUAL(2, s_sent.size());
+    STRCMP_EQUAL("{\"temp\":{\"value\":3,\"time\":1700000000200}}", s_sent[1].params.c_str());
+    LONGS_EQUAL(900, c.max_staleness_ms);
+    // 回到上次上报的值，暂存的变化不再上报
+    post1("temp", "4", 1100);
+    post1("temp", "3", 1200);
+    LONGS_EQUAL(-1, iot_tm_property_cache_poll(&c, 2000));
+    LONGS_EQUAL(2, s_sent.size());
+}
+
+// 死区内的变化最迟在max_interval后上报，心跳在没有上报时重发当前值
+TEST(tm_property_cache, test_max_interval_and_heartbeat) {
+    policy("temp", 1, 0, 0, 5000, 0);
+    policy("volt", 0, 0, 0, 0, 3000);
+    post1("temp", "20", 0);
+    post1("temp", "20.3", 1000);
+    LONGS_EQUAL(4000, iot_tm_property_cache_poll(&c, 1000));
+    LONGS_EQUAL(-1, iot_tm_property_cache_poll(&c, 5000));
+    LONGS_EQUAL(2, s_sent.size());
+    STRCMP_EQUAL("{\"temp\":{\"value\":20.3,\"time\":1700000001000}}", s_sent[1].params.c_str());
+    LONGS_EQUAL(4000, c.max_staleness_ms);
+
+    post1("volt", "220", 5000);
+    LONGS_EQUAL(3000, iot_tm_property_cache_poll(&c, 5000));
+    LONGS_EQUAL(3000, iot_tm_property_cache_poll(&c, 8000));
+    LONGS_EQUAL(4, s_sent.size());
+    STRCMP_EQUAL("{\"volt\":{\"value\":220,\"time\":1700000008000}}", s_sent[3].params.c_str());
+    // 心跳发出时，死区内暂存的变化一起上报
+    post1("temp", "20.6", 9000);
+    iot_tm_property_cache_poll(&c, 11000);
+    LONGS_EQUAL(5, s_sent.size());
+    STRCMP_EQUAL("{\"temp\":{\"value\":20.6,\"time\":1700000009000},\"volt\":{\"value\":220,\"time\":1700000011000}}",
+                 s_sent[4].params.c_str());
+}
+
+// 需要上报时，其他过了最短间隔的暂存属性一起发出；没有策略的属性直接上报
+TEST(tm_property_cache, test_due_properties_combined) {
+    policy(NULL, 5, 0, 0, 60000, 0);
+    policy("alarm", 0, 0, 0, 0, 0);
+    sample("temp", "20", 0);
+    sample("hum", "50", 0);
+    post(0);
+    post1("temp", "21", 100);
+    post1("hum", "51", 200);
+    LONGS_EQUAL(1, s_sent.size());
+    post1("alarm", "1", 300);
+    LONGS_EQUAL(2, s_sent.size());
+    LONGS_EQUAL(3, s_sent[1].members);
+    iot_tm_property_cache_set_policy(&c, NULL, NULL);
+    post1("temp", "22", 400);
+    LONGS_EQUAL(3, s_sent.size());
+    STRCMP_EQUAL("{\"temp\":{\"value\":22,\"time\":1700000000400}}", s_sent[2].params.c_str());
+    // 其他格式的成员直接上报
+    LONGS_EQUAL(VOLC_OK, iot_tm_members_add_raw(params, "alarm", 5, "1", 1));
+    post(500);
+    LONGS_EQUAL(4, s_sent.size());
+    STRCMP_EQUAL("{\"alarm\":1}", s_sent[3].params.c_str());
+}
+
+TEST(tm_property_cache, test_flush_on_deinit) {
+    policy("temp", 10, 0, 0, 0, 0);
+    post1("temp", "20", 0);
+    post1("temp", "21", 100);
+    LONGS_EQUAL(1, s_sent.size());
+    iot_tm_property_cache_deinit(&c);
+    LONGS_EQUAL(2, s_sent.size());
+    STRCMP_EQUAL("{\"temp\":{\"value\":21,\"time\":1700000000100}}", s_sent[1].params.c_str());
+    iot_tm_property_cache_init(&c, record_send, NULL);
+}
+
+// 模拟1Hz采样一小时的传感器：缓慢变化带噪声的温湿度、偶尔切换的开关、几乎不变的电压
+TEST(tm_property_cache, test_simulated_sensor_stream) {
+    const int seconds = 3600;
+    uint32_t seed = 12345;
+    char value[32];
+    policy("default:Temperature", 0.2, 0, 1000, 60000, 300000);
+    policy("default:Humidity", 0, 2, 1000, 60000, 300000);
+    policy("default:Switch", 0, 0, 0, 0, 300000);
+    policy("default:Voltage", 1, 0, 1000, 60000, 300000);
+    uint64_t baseline_bytes = 0;
+    for (int t = 0; t < seconds; t++) {
+        uint64_t now_ms = (uint64_t)t * 1000;
+        iot_tm_property_cache_poll(&c, now_ms);
+        seed = seed * 1103515245 + 12345;
+        double noise = ((seed >> 16) % 1000) / 1000.0 - 0.5;
+        snprintf(value, sizeof(value), "%.2f", 20 + 2 * sin(t * 2 * M_PI / seconds) + noise * 0.1);
+        sample("default:Temperature", value, now_ms);
+        snprintf(value, sizeof(value), "%.1f", 50 + 5 * sin(t * 2 * M_PI / 1800) + noise * 0.6);
+        sample("default:Humidity", value, now_ms);
+        sample("default:Switch", (t / 600) % 2 ? "\"on\"" : "\"off\"", now_ms);
+        snprintf(value, sizeof(value), "%.2f", 220 + noise * 0.02);
+        sample("default:Voltage", value, now_ms);
+        baseline_bytes += params->buf.len + 2;
+        post(now_ms);
+    }
+    iot_tm_property_cache_flush(&c, (uint64_t)seconds * 1000);
+    LONGS_EQUAL(seconds * 4, c.samples_in);
+    LONGS_EQUAL(s_sent.size(), c.messages_out);
+    CHECK(c.messages_out < (uint64_t)seconds / 4);
+    CHECK(c.max_staleness_ms <= 60000);
+    UT_PRINT(StringFromFormat("%d posts, %d samples -> %llu messages (%.1f%% fewer), %llu properties, "
+        "%llu -> %llu params bytes, worst staleness %llu ms", seconds, seconds * 4,
+        (unsigned long long)c.messages_out, 100.0 * (1 - (double)c.messages_out / seconds),
+        (unsigned long long)c.members_out, (unsigned long long)baseline_bytes,
+        (unsigned long long)s_payload_bytes, (unsigned long long)c.max_staleness_ms).asCharString());
+}
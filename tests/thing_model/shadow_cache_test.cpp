@@ -0,0 +1,170 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+  #include "CppUTest/TestHarness_c.h"
+  #include "onesdk_config.h"
+  #include "thing_model/tm_shadow_cache.h"
+  #include "iot/iot_kv.h"
+  #include "util/util.h"
+  #include "error_code.h"
+}
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#define DEVICE "pk/dn"
+#define KV_DIR "./"
+#define KV_FILE "shadow_cache_test.kv"
+
+TEST_GROUP(tm_shadow_cache) {
+    iot_tm_shadow_cache_t c;
+
+    void setup() {
+        LONGS_EQUAL(VOLC_OK, iot_tm_shadow_cache_init(&c, NULL));
+    }
+
+    void teardown() {
+        iot_tm_shadow_cache_deinit(&c);
+        remove(KV_DIR KV_FILE);
+    }
+
+    int apply(int64_t version, const char *desired, bool replace) {
+        return iot_tm_shadow_cache_apply_desired(&c, DEVICE, version, desired, strlen(desired), replace);
+    }
+
+    std::string desired(int64_t *version = NULL) {
+        char *json = NULL;
+        LONGS_EQUAL(VOLC_OK, iot_tm_shadow_cache_get_desired(&c, DEVICE, &json, version));
+        std::string result(json);
+        free(json);
+        return result;
+    }
+
+    // 以id上报，返回增量 {"k":v,...}，没有变化时为空串；不结束上报
+    std::string report_pending(const char *id, const char *members) {
+        iot_tm_members_t *report = iot_tm_members_new();
+        iot_tm_members_t *delta = iot_tm_members_new();
+        LONGS_EQUAL(VOLC_OK, iot_tm_members_set_json_str(report, members));
+        int added = iot_tm_shadow_cache_diff_reported(&c, DEVICE, id, report, delta);
+        CHECK(added >= 0);
+        LONGS_EQUAL(added, delta->count);
+        std::string result = added > 0 ? "{" + std::string((const char *)delta->buf.buffer, delta->buf.len) + "}" : "";
+        iot_tm_members_destroy(report);
+        iot_tm_members_destroy(delta);
+        return result;
+    }
+
+    // 上报并收到成功回复
+    std::string report(const char *members) {
+        std::string result = report_pending("ok", members);
+        iot_tm_shadow_cache_end_report(&c, DEVICE, "ok", true);
+        return result;
+    }
+};
+
+// 按服务端可能的到达顺序回放set与get回复：旧版本、重复消息都被丢弃
+TEST(tm_shadow_cache, test_out_of_order_set_and_get_reply) {
+    char *json = NULL;
+    LONGS_EQUAL(VOLC_ERR_INVALID_PARAM, iot_tm_shadow_cache_get_desired(&c, DEVICE, &json, NULL));
+    LONGS_EQUAL(VOLC_OK, apply(2, "{\"light\":1}", false));
+    // 在set之前发出的get，回复晚到
+    LONGS_EQUAL(VOLC_ERR_TM_SHADOW_STALE_VERSION, apply(1, "{\"light\":0,\"fan\":0}", true));
+    LONGS_EQUAL(VOLC_OK, apply(3, "{\"fan\":2}", false));
+    LONGS_EQUAL(VOLC_ERR_TM_SHADOW_STALE_VERSION, apply(2, "{\"light\":1}", false));
+    STRCMP_EQUAL("{\"light\":1,\"fan\":2}", desired().c_str());
+    // get回复整体替换
+    LONGS_EQUAL(VOLC_OK, apply(5, "{\"light\":0,\"mode\":{\"speed\":3}}", true));
+    LONGS_EQUAL(VOLC_ERR_TM_SHADOW_STALE_VERSION, apply(4, "{\"fan\":9}", false));
+    // null删除字段
+    LONGS_EQUAL(VOLC_OK, apply(6, "{\"light\":null,\"fan\":1}", false));
+    int64_t version = 0;
+    STRCMP_EQUAL("{\"mode\":{\"speed\":3},\"fan\":1}", desired(&version).c_str());
+    LONGS_EQUAL(6, version);
+    LONGS_EQUAL(VOLC_ERR_INVALID_PARAM, apply(7, "[1]", false));
+}
+
+TEST(tm_shadow_cache, test_report_sends_delta) {
+    STRCMP_EQUAL("{\"light\":1,\"name\":\"lamp\"}", report("{\"light\":1,\"name\":\"lamp\"}").c_str());
+    STRCMP_EQUAL("", report("{\"light\":1,\"name\":\"lamp\"}").c_str());
+    STRCMP_EQUAL("{\"name\":\"desk\"}", report("{\"light\":1,\"name\":\"desk\"}").c_str());
+    STRCMP_EQUAL("{\"color\":[1,2]}", report("{\"color\":[1,2],\"light\":1}").c_str());
+}
+
+// 上报值在服务端确认后才记为已上报：发送失败、服务端拒绝或没有回复时下次重新上报
+TEST(tm_shadow_cache, test_report_committed_on_reply) {
+    STRCMP_EQUAL("{\"light\":1}", report_pending("1", "{\"light\":1}").c_str());
+    // 回复之前再次上报同样的值，仍作为增量发出
+    STRCMP_EQUAL("{\"light\":1}", report_pending("2", "{\"light\":1}").c_str());
+    iot_tm_shadow_cache_end_report(&c, DEVICE, "1", false);
+    iot_tm_shadow_cache_end_report(&c, DEVICE, "unknown", true);
+    STRCMP_EQUAL("{\"light\":1}", report_pending("3", "{\"light\":1}").c_str());
+    iot_tm_shadow_cache_end_report(&c, DEVICE, "2", true);
+    STRCMP_EQUAL("", report_pending("4", "{\"light\":1}").c_str());
+    // 重复的回复不再生效
+    iot_tm_shadow_cache_end_report(&c, DEVICE, "2", true);
+    STRCMP_EQUAL("{\"light\":2}", report_pending("5", "{\"light\":2}").c_str());
+    iot_tm_shadow_cache_end_report(&c, DEVICE, "5", false);
+    STRCMP_EQUAL("{\"light\":2}", report_pending("6", "{\"light\":2}").c_str());
+
+    // 等待回复的上报有上限，最早的被放弃
+    char id[16];
+    for (int i = 0; i < IOT_TM_SHADOW_MAX_PENDING_REPORTS + 2; i++) {
+        snprintf(id, sizeof(id), "p%d", i);
+        report_pending(id, "{\"fan\":1}");
+    }
+    iot_tm_shadow_cache_end_report(&c, DEVICE, "p0", true);
+    STRCMP_EQUAL("{\"fan\":1}", report_pending("7", "{\"fan\":1}").c_str());
+    snprintf(id, sizeof(id), "p%d", IOT_TM_SHADOW_MAX_PENDING_REPORTS + 1);
+    iot_tm_shadow_cache_end_report(&c, DEVICE, id, true);
+    STRCMP_EQUAL("", report_pending("8", "{\"fan\":1}").c_str());
+    CHECK(c.docs[0]->pending_count <= IOT_TM_SHADOW_MAX_PENDING_REPORTS);
+}
+
+// 缓存写入kv，重启后无需shadow get即可取得desired，上报增量也延续
+TEST(tm_shadow_cache, test_persist_through_kv) {
+    remove(KV_DIR KV_FILE);
+    struct iot_kv_ctx *kv = iot_kv_init((char *)KV_DIR, (char *)KV_FILE);
+    iot_tm_shadow_cache_deinit(&c);
+    iot_tm_shadow_cache_init(&c, kv);
+    LONGS_EQUAL(VOLC_OK, apply(10, "{\"light\":1,\"label\":\"a\\\"b\"}", true));
+    report("{\"light\":1,\"temp\":21.5}");
+    // 未确认的上报不写入kv
+    report_pending("lost", "{\"temp\":30}");
+    iot_tm_shadow_cache_deinit(&c);
+    iot_kv_deinit(kv);
+    aws_mem_release(aws_alloc(), kv);
+
+    kv = iot_kv_init((char *)KV_DIR, (char *)KV_FILE);
+    iot_tm_shadow_cache_init(&c, kv);
+    int64_t version = 0;
+    STRCMP_EQUAL("{\"light\":1,\"label\":\"a\\\"b\"}", desired(&version).c_str());
+    LONGS_EQUAL(10, version);
+    STRCMP_EQUAL("{\"temp\":22}", report("{\"light\":1,\"temp\":22}").c_str());
+    STRCMP_EQUAL("{\"temp\":30}", report("{\"temp\":30}").c_str());
+    // 服务端重置影子后版本回退，恢复的版本以服务端为准，之后仍按版本丢弃旧消息
+    LONGS_EQUAL(VOLC_OK, apply(2, "{\"light\":0}", false));
+    STRCMP_EQUAL("{\"light\":0,\"label\":\"a\\\"b\"}", desired(&version).c_str());
+    LONGS_EQUAL(2, version);
+    LONGS_EQUAL(VOLC_ERR_TM_SHADOW_STALE_VERSION, apply(1, "{\"light\":1}", false));
+    iot_tm_shadow_cache_deinit(&c);
+    iot_kv_deinit(kv);
+    aws_mem_release(aws_alloc(), kv);
+    iot_tm_shadow_cache_init(&c, NULL);
+}
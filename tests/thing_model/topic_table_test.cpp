@@ -0,0 +1,137 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+  #include "CppUTest/TestHarness_c.h"
+  #include "thing_model/tm_topic_table.h"
+  #include "error_code.h"
+}
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PK "pk_0123456789"
+#define DN "dn_0123456789"
+
+static const char *const s_fmts[] = {
+    "sys/%s/%s/thingmodel/property/post",
+    "sys/%s/%s/thingmodel/event/%s/%s/post",
+    NULL,
+    "sys/%s/%s/shadow/report",
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static size_t s_allocs = 0;
+
+// 改造前每次发送的做法：product_key、device_name各复制一份，再按长度分配并格式化topic
+static char *legacy_topic(const char *fmt, const char *pk, const char *dn, const char *p1, const char *p2) {
+    char *pk_copy = strdup(pk);
+    char *dn_copy = strdup(dn);
+    size_t size = strlen(fmt) + strlen(pk_copy) + strlen(dn_copy) + (p1 ? strlen(p1) : 0) + (p2 ? strlen(p2) : 0);
+    char *topic = (char *)calloc(1, size + 1);
+    sprintf(topic, fmt, pk_copy, dn_copy, p1, p2);
+    free(pk_copy);
+    free(dn_copy);
+    s_allocs += 3;
+    return topic;
+}
+
+TEST_GROUP(tm_topic_table) {
+    iot_tm_topic_table_t table;
+
+    void setup() {
+        s_allocs = 0;
+        LONGS_EQUAL(VOLC_OK, iot_tm_topic_table_build(&table, s_fmts, 4, PK, DN));
+    }
+
+    void teardown() {
+        iot_tm_topic_table_free(&table);
+    }
+};
+
+TEST(tm_topic_table, test_static_and_parametrised) {
+    STRCMP_EQUAL("sys/" PK "/" DN "/thingmodel/property/post", iot_tm_topic_table_get(&table, 0));
+    STRCMP_EQUAL("sys/" PK "/" DN "/shadow/report", iot_tm_topic_table_get(&table, 3));
+    POINTERS_EQUAL(NULL, iot_tm_topic_table_get(&table, 1));
+    POINTERS_EQUAL(NULL, iot_tm_topic_table_get(&table, 2));
+    POINTERS_EQUAL(NULL, iot_tm_topic_table_get(&table, 4));
+    POINTERS_EQUAL(NULL, iot_tm_topic_table_get(NULL, 0));
+    STRCMP_EQUAL(PK, table.product_key);
+    STRCMP_EQUAL(DN, table.device_name);
+}
+
+TEST(tm_topic_table, test_format_scratch_and_heap) {
+    char scratch[64];
+    char *heap = NULL;
+    const char *topic = iot_tm_topic_format(scratch, sizeof(scratch), &heap, s_fmts[1], PK, DN, "m", "alarm", NULL);
+    POINTERS_EQUAL(scratch, topic);
+    POINTERS_EQUAL(NULL, heap);
+    STRCMP_EQUAL("sys/" PK "/" DN "/thingmodel/event/m/alarm/post", topic);
+
+    // 放不下时分配
+    char small[16];
+    topic = iot_tm_topic_format(small, sizeof(small), &heap, s_fmts[1], PK, DN, "m", "alarm", NULL);
+    CHECK(heap != NULL);
+    POINTERS_EQUAL(heap, topic);
+    STRCMP_EQUAL("sys/" PK "/" DN "/thingmodel/event/m/alarm/post", topic);
+    free(heap);
+}
+
+// 每次发送取topic的开销：改造前逐次分配格式化，改造后固定topic查表、参数化topic格式化到栈上缓冲
+TEST(tm_topic_table, test_benchmark_topic_per_send) {
+    const int iterations = 200000;
+    volatile size_t sink = 0;
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        char *topic = legacy_topic(s_fmts[i & 1], PK, DN, "module", "identifier");
+        sink += topic[4];
+        free(topic);
+    }
+    uint64_t legacy_ns = now_ns() - start;
+    size_t legacy_allocs = s_allocs;
+
+    size_t allocs = 0;
+    start = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        const char *topic = iot_tm_topic_table_get(&table, (size_t)(i & 1));
+        char scratch[IOT_TM_TOPIC_SCRATCH_SIZE];
+        char *heap = NULL;
+        if (topic == NULL) {
+            topic = iot_tm_topic_format(scratch, sizeof(scratch), &heap, s_fmts[1], PK, DN, "module", "identifier", NULL);
+        }
+        if (heap != NULL) {
+            allocs++;
+        }
+        sink += topic[4];
+        free(heap);
+    }
+    uint64_t table_ns = now_ns() - start;
+
+    LONGS_EQUAL(0, allocs);
+    UT_PRINT(StringFromFormat("topic per send: before %.1f ns/op %.1f allocs/op, after %.1f ns/op %.1f allocs/op",
+        (double)legacy_ns / iterations, (double)legacy_allocs / iterations,
+        (double)table_ns / iterations, (double)allocs / iterations).asCharString());
+    (void)sink;
+}
@@ -0,0 +1,294 @@
+// Copyright (2025) Beijing Volcano Engine Technology Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CppUTest/TestHarness.h"
+
+extern "C"
+{
+  #include "CppUTest/TestHarness_c.h"
+  #include "onesdk_config.h"
+  #include "thing_model/tm_webshell.h"
+  #include "error_code.h"
+}
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+struct frame_t {
+    iot_webshell_frame_type_t type;
+    std::string uid;
+    uint32_t seq;
+    std::string data;
+    int32_t exit_code;
+    iot_webshell_exit_reason_t reason;
+    uint64_t at_ms;
+};
+
+static uint64_t now_ms() {
+    return (uint64_t) std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int capture_frame(const iot_webshell_frame_t *frame, void *userdata) {
+    std::vector<frame_t> *frames = (std::vector<frame_t> *) userdata;
+    frame_t f;
+    f.type = frame->type;
+    f.uid = frame->uid;
+    f.seq = frame->seq;
+    f.data.assign((const char *) frame->data, frame->len);
+    f.exit_code = frame->exit_code;
+    f.reason = frame->reason;
+    f.at_ms = now_ms();
+    frames->push_back(f);
+    return VOLC_OK;
+}
+
+// 在子进程中只能调用async-signal-safe的函数，直接写到终端
+static int mark_child(void *userdata) {
+    const char *mark = (const char *) userdata;
+    return write(STDOUT_FILENO, mark, strlen(mark)) < 0;
+}
+
+TEST_GROUP(tm_webshell) {
+    iot_webshell_t ws;
+    iot_webshell_config_t config;
+    std::vector<frame_t> frames;
+
+    void setup() {
+        memset(&config, 0, sizeof(config));
+        frames.clear();
+    }
+
+    void teardown() {
+        iot_webshell_deinit(&ws);
+    }
+
+    void start() {
+        LONGS_EQUAL(VOLC_OK, iot_webshell_init(&ws, &config, capture_frame, &frames));
+    }
+
+    int input(const char *uid, const char *text) {
+        return iot_webshell_input(&ws, uid, (const uint8_t *) text, strlen(text), now_ms());
+    }
+
+    // 驱动poll直到收到uid的退出帧
+    const frame_t *wait_exit(const char *uid, uint64_t timeout_ms) {
+        uint64_t deadline = now_ms() + timeout_ms;
+        while (now_ms() < deadline) {
+            iot_webshell_poll(&ws, now_ms());
+            for (auto &f : frames) {
+                if (f.type == IOT_WEBSHELL_FRAME_EXIT && f.uid == uid) {
+                    return &f;
+                }
+            }
+            usleep(2000);
+        }
+        return NULL;
+    }
+
+    static size_t count(const std::string &s, const char *needle) {
+        size_t n = 0;
+        for (size_t pos = s.find(needle); pos != std::string::npos; pos = s.find(needle, pos + 1)) {
+            n++;
+        }
+        return n;
+    }
+
+    std::string output(const char *uid) {
+        std::string out;
+        for (auto &f : frames) {
+            if (f.type == IOT_WEBSHELL_FRAME_OUTPUT && f.uid == uid) {
+                out += f.data;
+            }
+        }
+        return out;
+    }
+};
+
+// 大量输出按序号连续、不超过分帧大小、按间隔限速发出，子进程的限制钩子在exec前生效
+TEST(tm_webshell, test_large_output_in_ordered_rate_limited_chunks) {
+    config.chunk_bytes = 1024;
+    config.chunk_interval_ms = 5;
+    config.max_buffer_bytes = 8192;
+    config.restrict_child = mark_child;
+    config.userdata = (void *) "hook=ok\r\n";
+    start();
+    LONGS_EQUAL(VOLC_OK, iot_webshell_input(&ws, "u1", NULL, 0, now_ms()));
+    LONGS_EQUAL(VOLC_OK, iot_webshell_resize(&ws, "u1", 40, 120));
+    LONGS_EQUAL(VOLC_ERR_INVALID_PARAM, iot_webshell_resize(&ws, "nobody", 40, 120));
+    uint64_t begin = now_ms();
+    // 回显的命令行里没有Z，输出中的Z都来自命令
+    LONGS_EQUAL(VOLC_OK, input("u1", "stty size; echo term=$TERM; head -c 200000 /dev/zero | tr '\\000' '\\132'; exit 3\n"));
+
+    const frame_t *exit_frame = wait_exit("u1", 20000);
+    CHECK(exit_frame != NULL);
+    LONGS_EQUAL(3, exit_frame->exit_code);
+    LONGS_EQUAL(IOT_WEBSHELL_EXIT_NORMAL, exit_frame->reason);
+    LONGS_EQUAL(0, iot_webshell_session_count(&ws));
+
+    uint32_t expect_seq = 0;
+    const frame_t *prev = NULL;
+    for (auto &f : frames) {
+        LONGS_EQUAL(expect_seq, f.seq);
+        expect_seq++;
+        if (f.type != IOT_WEBSHELL_FRAME_OUTPUT) {
+            continue;
+        }
+        CHECK(f.data.size() > 0 && f.data.size() <= 1024);
+        if (prev != NULL) {
+            CHECK(f.at_ms - prev->at_ms >= 4);
+        }
+        prev = &f;
+    }
+    CHECK(frames.back().type == IOT_WEBSHELL_FRAME_EXIT);
+    std::string out = output("u1");
+    LONGS_EQUAL(200000, (long) std::count(out.begin(), out.end(), 'Z'));
+    CHECK(out.find("40 120") != std::string::npos);
+    CHECK(out.find("hook=ok") != std::string::npos);
+    CHECK(out.find("term=xterm") != std::string::npos);
+    UT_PRINT(StringFromFormat("webshell: %u frames, %u bytes in %llums",
+                              (unsigned) frames.size(), (unsigned) out.size(),
+                              (unsigned long long) (now_ms() - begin)).asCharString());
+}
+
+// 断续的慢输出依次到达，之后空闲超时结束会话
+TEST(tm_webshell, test_slow_output_then_idle_timeout) {
+    config.idle_timeout_ms = 400;
+    start();
+    uint64_t begin = now_ms();
+    LONGS_EQUAL(VOLC_OK, input("u1", "for i in 1 2 3; do echo tick$i; sleep 0.2; done\n"));
+
+    const frame_t *exit_frame = wait_exit("u1", 10000);
+    CHECK(exit_frame != NULL);
+    LONGS_EQUAL(IOT_WEBSHELL_EXIT_TIMEOUT, exit_frame->reason);
+    std::string out = output("u1");
+    size_t t1 = out.find("tick1\r\n");
+    size_t t2 = out.find("tick2\r\n");
+    size_t t3 = out.find("tick3\r\n");
+    CHECK(t1 != std::string::npos && t2 != std::string::npos && t3 != std::string::npos);
+    CHECK(t1 < t2 && t2 < t3);
+    // 输出期间不算空闲
+    CHECK(exit_frame->at_ms - begin >= 400 + 400);
+    // 退出帧发出后会话已释放
+    LONGS_EQUAL(0, iot_webshell_session_count(&ws));
+}
+
+// 子进程不读取输入时写入不阻塞：写不下的部分排队由poll写入，排队也放不下时丢弃并返回错误
+TEST(tm_webshell, test_input_backpressure_does_not_block) {
+    config.max_buffer_bytes = 16 * 1024;
+    start();
+    LONGS_EQUAL(VOLC_OK, input("u1", "stty -echo; sleep 1\n"));
+    std::string line = ": " + std::string(1021, 'x') + "\n";
+    int full = 0;
+    uint64_t slowest_ms = 0;
+    for (int i = 0; i < 512 && full == 0; i++) {
+        uint64_t begin = now_ms();
+        int ret = input("u1", line.c_str());
+        slowest_ms = std::max(slowest_ms, now_ms() - begin);
+        if (ret == VOLC_ERR_TM_WEBSHELL_INPUT_FULL) {
+            full++;
+        } else {
+            LONGS_EQUAL(VOLC_OK, ret);
+        }
+    }
+    LONGS_EQUAL(1, full);
+    CHECK(ws.input_dropped > 0 && ws.input_dropped <= line.size());
+    CHECK(slowest_ms < 100);
+
+    // shell恢复读取后排队的输入由poll写入，之后的输入照常执行
+    uint64_t deadline = now_ms() + 10000;
+    int ret = VOLC_ERR_TM_WEBSHELL_INPUT_FULL;
+    while (ret == VOLC_ERR_TM_WEBSHELL_INPUT_FULL && now_ms() < deadline) {
+        iot_webshell_poll(&ws, now_ms());
+        ret = input("u1", "\necho drained-$((40+2))\n");
+        usleep(2000);
+    }
+    LONGS_EQUAL(VOLC_OK, ret);
+    while (output("u1").find("drained-42") == std::string::npos && now_ms() < deadline) {
+        iot_webshell_poll(&ws, now_ms());
+        usleep(2000);
+    }
+    CHECK(output("u1").find("drained-42") != std::string::npos);
+}
+
+// 白名单外的命令与组合命令被拒绝，会话数有上限，kill结束整个会话
+TEST(tm_webshell, test_allowlist_limit_and_kill) {
+    const char *allowed[] = {"echo", "sleep", NULL};
+    config.allowed_commands = allowed;
+    config.max_sessions = 1;
+    start();
+    LONGS_EQUAL(VOLC_OK, input("u1", "cat /etc/hostname\n"));
+    LONGS_EQUAL(VOLC_OK, input("u1", "echo a; id\n"));
+    LONGS_EQUAL(VOLC_OK, input("u1", "echo $(id)\n"));
+    // 退格修正后的行才是要检查的命令
+    LONGS_EQUAL(VOLC_OK, input("u1", "ecxx\x7f\x7fho allowed-ok\n"));
+    LONGS_EQUAL(VOLC_OK, input("u1", "sleep 30\n"));
+    LONGS_EQUAL(VOLC_ERR_TM_WEBSHELL_SESSION_LIMIT, input("u2", "echo hi\n"));
+
+    // 回显的命令行与命令的输出各一次
+    uint64_t deadline = now_ms() + 5000;
+    while (count(output("u1"), "allowed-ok\r\n") < 2 && now_ms() < deadline) {
+        iot_webshell_poll(&ws, now_ms());
+        usleep(2000);
+    }
+    std::string out = output("u1");
+    LONGS_EQUAL(2, count(out, "allowed-ok\r\n"));
+    LONGS_EQUAL(3, count(out, "command not allowed"));
+    LONGS_EQUAL(3, ws.denied);
+    CHECK(out.find("uid=") == std::string::npos);
+
+    LONGS_EQUAL(VOLC_OK, iot_webshell_kill(&ws, "u1"));
+    LONGS_EQUAL(VOLC_ERR_INVALID_PARAM, input("u1", "echo late\n"));
+    const frame_t *exit_frame = wait_exit("u1", 5000);
+    CHECK(exit_frame != NULL);
+    LONGS_EQUAL(IOT_WEBSHELL_EXIT_KILLED, exit_frame->reason);
+    LONGS_EQUAL(128 + 9, exit_frame->exit_code);
+    LONGS_EQUAL(0, iot_webshell_session_count(&ws));
+    LONGS_EQUAL(VOLC_OK, input("u2", "echo hi\n"));
+    LONGS_EQUAL(1, iot_webshell_session_count(&ws));
+}
+
+// 终端会把控制字符当作行编辑键，含控制字符的行整行拒绝，不能借此改写已检查过的行
+TEST(tm_webshell, test_allowlist_rejects_control_bytes) {
+    const char *allowed[] = {"echo", NULL};
+    config.allowed_commands = allowed;
+    start();
+    const char *bypasses[] = {
+        "echo a\x15id\n",           // ^U 删除整行
+        "echo a\x17id\n",           // ^W 删除前一个词
+        "echo a\x16\x15id\n",       // ^V 转义下一个字符
+        "echo a\x1b[2K id\n",       // ESC 序列
+        "ec\tid\n",                 // Tab 补全
+        "\tid\n",
+    };
+    for (const char *line : bypasses) {
+        LONGS_EQUAL(VOLC_OK, input("u1", line));
+    }
+    LONGS_EQUAL(VOLC_OK, input("u1", "echo allowed-ok\n"));
+
+    uint64_t deadline = now_ms() + 5000;
+    while (count(output("u1"), "allowed-ok\r\n") < 2 && now_ms() < deadline) {
+        iot_webshell_poll(&ws, now_ms());
+        usleep(2000);
+    }
+    std::string out = output("u1");
+    LONGS_EQUAL(2, count(out, "allowed-ok\r\n"));
+    LONGS_EQUAL(sizeof(bypasses) / sizeof(bypasses[0]), ws.denied);
+    CHECK(out.find("uid=") == std::string::npos);
+}